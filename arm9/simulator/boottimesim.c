@@ -0,0 +1,246 @@
+/*
+*   This file is part of Luma3DS
+*   Copyright (C) 2016-2020 Aurora Wright, TuxSH
+*
+*   This program is free software: you can redistribute it and/or modify
+*   it under the terms of the GNU General Public License as published by
+*   the Free Software Foundation, either version 3 of the License, or
+*   (at your option) any later version.
+*
+*   This program is distributed in the hope that it will be useful,
+*   but WITHOUT ANY WARRANTY; without even the implied warranty of
+*   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*   GNU General Public License for more details.
+*
+*   You should have received a copy of the GNU General Public License
+*   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*
+*   Additional Terms 7.b and 7.c of GPLv3 apply to this file:
+*       * Requiring preservation of specified reasonable legal notices or
+*         author attributions in that material or in the Appropriate Legal
+*         Notices displayed by works containing it.
+*       * Prohibiting misrepresentation of the origin of that material,
+*         or requiring that modified versions of such material be marked in
+*         reasonable ways as different from the original version.
+*/
+
+/* Boot timeline simulator: runs boottime.c against a scripted timer and an in-memory
+   boottime.bin, for two boots with the section copy of the first one handed over by the
+   chainloader (in raw timer ticks, like everything else in the log). Checks the records
+   written, then decodes the file with boottime.py (usage: boottimesim <file> <boottime.py>)
+   and checks the durations it prints, in ms.
+
+   Built natively, like hashsim: boottime.c is included here. */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include "../source/boottime.c"
+
+#define QUARTER_SEC     (TICKS_PER_SEC / 4)
+#define SIM_START_TICKS (2 * QUARTER_SEC) // since startChrono
+
+static u32 numFailures;
+
+#define CHECK(cond) do { if(!(cond)) { printf("    %s:%d: %s: FAILED\n", __FILE__, __LINE__, #cond); numFailures++; } } while(0)
+
+/* What the rest of boottime.c needs */
+
+CfgData configData;
+bool isSdMode = true;
+BootType bootType = B9S;
+BootTimeLaunch bootTimeLaunch;
+
+static u64 simTicks;
+
+void simRecordResult(unsigned int record, unsigned int result)
+{
+    (void)record;
+    (void)result;
+}
+
+void startChrono(void)
+{
+}
+
+u64 chronoTicks(void)
+{
+    return simTicks;
+}
+
+/* boottime.bin */
+
+static u8 fileData[sizeof(BootTimeFileHeader) + BOOTTIME_NUM_SLOTS * sizeof(BootTimeSlot)];
+static u32 fileSize, filePos;
+
+FRESULT f_open(FIL *fp, const TCHAR *path, BYTE mode)
+{
+    (void)fp;
+    (void)path;
+    (void)mode;
+    filePos = 0;
+    return FR_OK;
+}
+
+FRESULT f_close(FIL *fp)
+{
+    (void)fp;
+    return FR_OK;
+}
+
+FRESULT f_read(FIL *fp, void *buff, UINT btr, UINT *br)
+{
+    (void)fp;
+    *br = filePos >= fileSize ? 0 : btr < fileSize - filePos ? btr : fileSize - filePos;
+    memcpy(buff, fileData + filePos, *br);
+    filePos += *br;
+    return FR_OK;
+}
+
+FRESULT f_write(FIL *fp, const void *buff, UINT btw, UINT *bw)
+{
+    (void)fp;
+    if(filePos + btw > sizeof(fileData)) return FR_DENIED;
+    memcpy(fileData + filePos, buff, btw);
+    filePos += btw;
+    if(filePos > fileSize) fileSize = filePos;
+    *bw = btw;
+    return FR_OK;
+}
+
+FRESULT f_lseek(FIL *fp, FSIZE_t ofs)
+{
+    (void)fp;
+    if(ofs > sizeof(fileData)) return FR_DENIED;
+    if(ofs > fileSize) memset(fileData + fileSize, 0, ofs - fileSize);
+    filePos = ofs;
+    return FR_OK;
+}
+
+FRESULT f_truncate(FIL *fp)
+{
+    (void)fp;
+    fileSize = filePos;
+    return FR_OK;
+}
+
+/* Boots */
+
+// What main does with the timeline, with the firmType to flush and the chainloader's section copy
+static void boot(u32 firmType, u32 sectionCopyTicks)
+{
+    memset(&currentBoot, 0, sizeof(currentBoot));
+    simTicks = SIM_START_TICKS;
+    bootTimeInit();
+
+    u32 mount = bootTimeBegin(BOOTPHASE_STORAGE_MOUNT, NULL);
+    simTicks += QUARTER_SEC;
+    bootTimeEnd(mount);
+
+    u32 patch = bootTimeBegin(BOOTPHASE_PATCH, "patchSignatureChecks(process9Offset, process9Size)");
+    simTicks += 2 * QUARTER_SEC;
+    bootTimeEnd(patch);
+
+    simTicks += QUARTER_SEC;
+    bootTimeFlush(firmType, FIRMWARE_SYSNAND);
+
+    // The chainloader, after the log was written
+    if(bootTimeLaunch.magic == BOOTTIME_LAUNCH_MAGIC)
+        bootTimeLaunch.ticks = sectionCopyTicks;
+}
+
+static const BootTimeSlot *slot(u32 i)
+{
+    return (const BootTimeSlot *)(fileData + sizeof(BootTimeFileHeader)) + i;
+}
+
+static void checkLog(void)
+{
+    const BootTimeFileHeader *header = (const BootTimeFileHeader *)fileData;
+
+    printf("Log:\n");
+    CHECK(fileSize == sizeof(BootTimeFileHeader) + 2 * sizeof(BootTimeSlot));
+    CHECK(header->magic == BOOTTIME_MAGIC && header->version == BOOTTIME_VERSION);
+    CHECK(header->ticksPerSec == (u32)TICKS_PER_SEC);
+    CHECK(header->sequence == 2 && header->nextSlot == 2);
+
+    for(u32 i = 0; i < 2; i++)
+    {
+        const BootTimeSlot *s = slot(i);
+
+        CHECK(s->sequence == i + 1);
+        CHECK(s->numRecords == 3 && s->numDropped == 0);
+        CHECK(s->totalTicks == (u32)(SIM_START_TICKS + 4 * QUARTER_SEC));
+        CHECK(s->records[0].phase == BOOTPHASE_STORAGE_MOUNT && s->records[0].start == SIM_START_TICKS);
+        CHECK(s->records[0].duration == QUARTER_SEC);
+        CHECK(s->records[1].phase == BOOTPHASE_PATCH && strcmp(s->records[1].name, "SignatureChecks") == 0);
+        CHECK(s->records[1].duration == 2 * QUARTER_SEC);
+        CHECK(s->records[2].phase == BOOTPHASE_SECTION_COPY);
+    }
+
+    // Only known once the next boot has run
+    CHECK(slot(0)->records[2].duration == QUARTER_SEC);
+    CHECK(slot(1)->records[2].duration == BOOTTIME_UNKNOWN);
+}
+
+static void checkDecoder(const char *path, const char *decoder)
+{
+    static const char *expected[] = {
+        "\"total\": 1500.0",
+        "\"phase\": \"storage mount\"",
+        "\"start\": 500.0",
+        "\"name\": \"SignatureChecks\"",
+        "\"duration\": 250.0",
+        "\"duration\": 500.0",
+        "\"duration\": null",
+    };
+    static char output[0x10000];
+    char command[0x400];
+    FILE *f;
+
+    printf("boottime.py:\n");
+
+    f = fopen(path, "wb");
+    if(f == NULL || fwrite(fileData, 1, fileSize, f) != fileSize || fclose(f) != 0)
+    {
+        printf("    can't write %s: FAILED\n", path);
+        numFailures++;
+        return;
+    }
+
+    snprintf(command, sizeof(command), "python3 '%s' --json '%s'", decoder, path);
+    f = popen(command, "r");
+    size_t size = f != NULL ? fread(output, 1, sizeof(output) - 1, f) : 0;
+    output[size] = 0;
+    CHECK(f != NULL && pclose(f) == 0);
+
+    for(u32 i = 0; i < sizeof(expected) / sizeof(*expected); i++)
+        if(strstr(output, expected[i]) == NULL)
+        {
+            printf("    %s: FAILED\n", expected[i]);
+            numFailures++;
+        }
+
+    // Both mounts and the section copy of the first boot
+    u32 count = 0;
+    for(const char *p = output; (p = strstr(p, "\"duration\": 250.0")) != NULL; p++) count++;
+    CHECK(count == 3);
+}
+
+int main(int argc, char **argv)
+{
+    if(argc != 3)
+    {
+        fprintf(stderr, "usage: %s <file> <boottime.py>\n", argv[0]);
+        return 2;
+    }
+
+    configData.config = 1u << BOOTTIMELOG;
+
+    boot(NATIVE_FIRM, QUARTER_SEC);
+    boot(NATIVE_FIRM, 3 * QUARTER_SEC);
+    checkLog();
+    checkDecoder(argv[1], argv[2]);
+
+    printf(numFailures == 0 ? "ok\n" : "FAILED\n");
+    return numFailures == 0 ? 0 : 1;
+}
@@ -0,0 +1,602 @@
+/*
+*   This file is part of Luma3DS
+*   Copyright (C) 2016-2020 Aurora Wright, TuxSH
+*
+*   This program is free software: you can redistribute it and/or modify
+*   it under the terms of the GNU General Public License as published by
+*   the Free Software Foundation, either version 3 of the License, or
+*   (at your option) any later version.
+*
+*   This program is distributed in the hope that it will be useful,
+*   but WITHOUT ANY WARRANTY; without even the implied warranty of
+*   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*   GNU General Public License for more details.
+*
+*   You should have received a copy of the GNU General Public License
+*   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*
+*   Additional Terms 7.b and 7.c of GPLv3 apply to this file:
+*       * Requiring preservation of specified reasonable legal notices or
+*         author attributions in that material or in the Appropriate Legal
+*         Notices displayed by works containing it.
+*       * Prohibiting misrepresentation of the origin of that material,
+*         or requiring that modified versions of such material be marked in
+*         reasonable ways as different from the original version.
+*/
+
+/* Disk cache simulator: runs the Arm9 FatFs (ff.c) and sector cache (diskcache.c) unmodified on
+   a Linux host, with the SD card and CTRNAND backed by disk image files instead of diskio.c.
+   It can create a test SD image, run the file accesses of a boot against it, and replay raw
+   disk_read traces (e.g. captured on a console, or with --trace), printing the number of
+   device commands with and without the cache and the cache hit rate. "check" does all of
+   this on a fresh image and also checks that moving CTRNAND drops its cached sectors. */
+
+#include <string.h>
+#include <unistd.h>
+#include "../source/types.h"
+#include "../source/fatfs/ff.h"
+#include "../source/fatfs/diskio.h"
+#include "../source/fatfs/diskcache.h"
+
+#define SIM_SD_IMAGE_SECTORS    (256 * 1024 * 2)    // 256 MiB, the smallest FAT32 volume with 4 KiB clusters
+#define SIM_NAND_IMAGE_SECTORS  (64 * 1024 * 2)
+#define SIM_FILE_SIZE           0x180000
+#define SIM_MAX_READ            0x400000
+#define SIM_NUM_PAYLOADS        24
+#define SIM_NUM_TITLE_DIRS      300
+
+typedef struct SimDrive
+{
+    FILE *image;
+    u32 numSectors;
+    u32 commands;   // read commands sent to the "device"
+    u32 sectorsRead;
+    u32 writes;
+} SimDrive;
+
+static SimDrive drives[DISKCACHE_NUM_DRIVES];
+static bool useCache = true;
+static FILE *traceFile;
+static u32 numFailures;
+static DiskCacheStats statsBase;  // SD card cache stats at the last resetCounts
+
+static FATFS sdFs, nandFs;
+static u8 buffer[SIM_MAX_READ];
+
+#define CHECK(cond) do { if(!(cond)) { printf("    %s:%d: %s: FAILED\n", __FILE__, __LINE__, #cond); numFailures++; } } while(0)
+
+/* diskio.c replacement */
+
+static int readDevice(SimDrive *drive, u32 sector, u32 count, u8 *out)
+{
+    drive->commands++;
+    drive->sectorsRead += count;
+
+    if(drive->image == NULL || sector + count > drive->numSectors || sector + count < sector)
+        return 1;
+
+    return fseek(drive->image, (long)sector * DISKCACHE_SECTOR_SIZE, SEEK_SET) != 0 ||
+           fread(out, DISKCACHE_SECTOR_SIZE, count, drive->image) != count;
+}
+
+static int readSdCard(u32 sector, u32 count, u8 *out)
+{
+    return readDevice(&drives[DISKCACHE_DRIVE_SDCARD], sector, count, out);
+}
+
+static int readCtrNand(u32 sector, u32 count, u8 *out)
+{
+    return readDevice(&drives[DISKCACHE_DRIVE_CTRNAND], sector, count, out);
+}
+
+DSTATUS disk_status(BYTE pdrv)
+{
+    (void)pdrv;
+    return RES_OK;
+}
+
+DSTATUS disk_initialize(BYTE pdrv)
+{
+    if(pdrv >= DISKCACHE_NUM_DRIVES)
+        return STA_NOINIT;
+
+    diskCacheInvalidate(pdrv);
+    return drives[pdrv].image != NULL ? 0 : STA_NOINIT;
+}
+
+DRESULT disk_read(BYTE pdrv, BYTE *buff, LBA_t sector, UINT count)
+{
+    if(pdrv >= DISKCACHE_NUM_DRIVES)
+        return RES_PARERR;
+
+    if(traceFile != NULL && pdrv == DISKCACHE_DRIVE_SDCARD)
+        fprintf(traceFile, "R %u %u\n", (u32)sector, count);
+
+    int res;
+    if(useCache)
+        res = diskCacheRead(pdrv, pdrv == DISKCACHE_DRIVE_SDCARD ? readSdCard : readCtrNand, sector, count, buff);
+    else
+        res = readDevice(&drives[pdrv], sector, count, buff);
+
+    return res == 0 ? RES_OK : RES_PARERR;
+}
+
+DRESULT disk_write(BYTE pdrv, const BYTE *buff, LBA_t sector, UINT count)
+{
+    if(pdrv >= DISKCACHE_NUM_DRIVES)
+        return RES_PARERR;
+
+    SimDrive *drive = &drives[pdrv];
+    drive->writes++;
+
+    bool success = drive->image != NULL && sector + count <= drive->numSectors &&
+                   fseek(drive->image, (long)sector * DISKCACHE_SECTOR_SIZE, SEEK_SET) == 0 &&
+                   fwrite(buff, DISKCACHE_SECTOR_SIZE, count, drive->image) == count;
+
+    if(useCache)
+        diskCacheWrite(pdrv, sector, count, buff, success);
+
+    return success ? RES_OK : RES_PARERR;
+}
+
+DRESULT disk_ioctl(BYTE pdrv, BYTE cmd, void *buff)
+{
+    if(pdrv >= DISKCACHE_NUM_DRIVES)
+        return RES_PARERR;
+
+    switch(cmd)
+    {
+        case CTRL_SYNC:
+            return RES_OK;
+        case GET_SECTOR_COUNT:
+            *(LBA_t *)buff = drives[pdrv].numSectors;
+            return RES_OK;
+        case GET_BLOCK_SIZE:
+            *(DWORD *)buff = 1;
+            return RES_OK;
+        default:
+            return RES_PARERR;
+    }
+}
+
+DWORD get_fattime(void)
+{
+    return ((2020 - 1980) << 25) | (1 << 21) | (1 << 16);
+}
+
+/* Images */
+
+static bool openImage(u32 drv, const char *path, u32 createSectors)
+{
+    SimDrive *drive = &drives[drv];
+
+    if(drive->image != NULL)
+        fclose(drive->image);
+
+    drive->image = fopen(path, createSectors != 0 ? "w+b" : "r+b");
+    if(drive->image == NULL)
+    {
+        perror(path);
+        return false;
+    }
+
+    if(createSectors != 0)
+    {
+        // Sparse, the FAT and the test files only use a few MiB
+        if(ftruncate(fileno(drive->image), (off_t)createSectors * DISKCACHE_SECTOR_SIZE) != 0)
+            return false;
+        drive->numSectors = createSectors;
+    }
+    else
+    {
+        fseek(drive->image, 0, SEEK_END);
+        drive->numSectors = (u32)(ftell(drive->image) / DISKCACHE_SECTOR_SIZE);
+    }
+
+    return true;
+}
+
+static void resetCounts(void)
+{
+    for(u32 i = 0; i < DISKCACHE_NUM_DRIVES; i++)
+    {
+        drives[i].commands = drives[i].sectorsRead = drives[i].writes = 0;
+        diskCacheInvalidate(i);
+    }
+
+    statsBase = *diskCacheGetStats(DISKCACHE_DRIVE_SDCARD);
+}
+
+// Contents of the test files, so that reads can be checked
+static u8 fileByte(u32 id, u32 offset)
+{
+    return (u8)(id * 131 + offset * 7 + (offset >> 9));
+}
+
+static bool checkContents(const u8 *data, u32 id, u32 offset, u32 size)
+{
+    for(u32 i = 0; i < size; i++)
+    {
+        if(data[i] != fileByte(id, offset + i))
+            return false;
+    }
+
+    return true;
+}
+
+static bool writeFile(const char *path, u32 id, u32 size)
+{
+    FIL file;
+    UINT written;
+
+    if(f_open(&file, path, FA_WRITE | FA_CREATE_ALWAYS) != FR_OK)
+        return false;
+
+    for(u32 i = 0; i < size; i++)
+        buffer[i] = fileByte(id, i);
+
+    bool res = f_write(&file, buffer, size, &written) == FR_OK && written == size;
+    return f_close(&file) == FR_OK && res;
+}
+
+// Appends to the files in turn, so that their cluster chains are fragmented like on a used SD card
+static bool writeFragmentedFiles(const char **paths, u32 numFiles, u32 firstId, u32 size, u32 chunkSize)
+{
+    FIL files[4];
+    UINT written;
+    bool res = true;
+
+    for(u32 i = 0; i < numFiles; i++)
+        res = res && f_open(&files[i], paths[i], FA_WRITE | FA_CREATE_ALWAYS) == FR_OK;
+
+    for(u32 offset = 0; res && offset < size; offset += chunkSize)
+    {
+        for(u32 i = 0; res && i < numFiles; i++)
+        {
+            for(u32 j = 0; j < chunkSize; j++)
+                buffer[j] = fileByte(firstId + i, offset + j);
+            res = f_write(&files[i], buffer, chunkSize, &written) == FR_OK && written == chunkSize;
+        }
+    }
+
+    for(u32 i = 0; i < numFiles; i++)
+        f_close(&files[i]);
+
+    return res;
+}
+
+static bool makeSdImage(const char *path)
+{
+    static BYTE work[FF_MAX_SS * 4];
+    static const MKFS_PARM opt = {FM_FAT32, 0, 0, 0, 8};
+    static const char *fragmentedFiles[] = {"sdmc:/boot.firm", "sdmc:/luma/sysmodules/0004013000001702.cxi",
+                                            "sdmc:/luma/sysmodules/0004013000003202.cxi", "sdmc:/3ds/hbldr.3dsx"};
+    char name[128];
+
+    if(!openImage(DISKCACHE_DRIVE_SDCARD, path, SIM_SD_IMAGE_SECTORS) || f_mkfs("sdmc:", &opt, work, sizeof(work)) != FR_OK ||
+       f_mount(&sdFs, "sdmc:", 1) != FR_OK)
+        return false;
+
+    bool res = f_mkdir("sdmc:/luma") == FR_OK && f_mkdir("sdmc:/luma/payloads") == FR_OK &&
+               f_mkdir("sdmc:/luma/sysmodules") == FR_OK && f_mkdir("sdmc:/3ds") == FR_OK &&
+               f_mkdir("sdmc:/Nintendo 3DS") == FR_OK && writeFile("sdmc:/luma/config.ini", 1, 3000);
+
+    for(u32 i = 0; res && i < SIM_NUM_TITLE_DIRS; i++)
+    {
+        sprintf(name, "sdmc:/Nintendo 3DS/some long directory name %u", i);
+        res = f_mkdir(name) == FR_OK;
+    }
+
+    for(u32 i = 0; res && i < SIM_NUM_PAYLOADS; i++)
+    {
+        sprintf(name, "sdmc:/luma/payloads/payload with a long name %02u.firm", i);
+        res = writeFile(name, 10 + i, 0x1000 + 0x200 * i);
+    }
+
+    res = res && writeFragmentedFiles(fragmentedFiles, 4, 100, SIM_FILE_SIZE, 0x2000);
+    return f_unmount("sdmc:") == FR_OK && res;
+}
+
+static u32 readWholeFile(const char *path, u32 maxSize)
+{
+    FIL file;
+    UINT read = 0;
+
+    if(f_open(&file, path, FA_READ) != FR_OK)
+        return 0;
+
+    if(f_size(&file) <= maxSize)
+        f_read(&file, buffer, (UINT)f_size(&file), &read);
+
+    f_close(&file);
+    return read;
+}
+
+/* Boot */
+
+// The SD card accesses of an Arm9 boot with the payload menu, sysmodule overrides and a homebrew
+// launch, reading a test image made by makeSdImage
+static void runBoot(void)
+{
+    FIL file;
+    DIR dir;
+    FILINFO info;
+    UINT read;
+    char name[128];
+    u32 count;
+
+    CHECK(f_mount(&sdFs, "sdmc:", 1) == FR_OK);
+    CHECK(f_chdir("sdmc:/luma") == FR_OK);
+    CHECK(readWholeFile("config.ini", 0x2000) == 3000 && checkContents(buffer, 1, 0, 3000));
+
+    // Payload menu
+    count = 0;
+    CHECK(f_findfirst(&dir, &info, "payloads", "*.firm") == FR_OK);
+    while(info.fname[0] != 0 && count < 2 * SIM_NUM_PAYLOADS)
+    {
+        count++;
+        f_findnext(&dir, &info);
+    }
+    f_closedir(&dir);
+    CHECK(count == SIM_NUM_PAYLOADS);
+
+    sprintf(name, "payloads/payload with a long name %02u.firm", 17);
+    CHECK(readWholeFile(name, SIM_MAX_READ) == 0x1000 + 0x200 * 17 && checkContents(buffer, 10 + 17, 0, 0x1000 + 0x200 * 17));
+
+    // Firmware and sysmodule overrides, most of which don't exist
+    static const char *firmwareFiles[] = {"firmware_native.bin", "firmware_twl.bin", "firmware_agb.bin", "cetk"};
+    for(u32 i = 0; i < sizeof(firmwareFiles) / sizeof(firmwareFiles[0]); i++)
+        CHECK(readWholeFile(firmwareFiles[i], SIM_MAX_READ) == 0);
+
+    for(u32 i = 0; i < 16; i++)
+    {
+        sprintf(name, "sysmodules/00040130000%02X02.cxi", i * 0x11);
+        readWholeFile(name, SIM_MAX_READ);
+    }
+    CHECK(readWholeFile("sysmodules/0004013000001702.cxi", SIM_MAX_READ) == SIM_FILE_SIZE && checkContents(buffer, 101, 0, SIM_FILE_SIZE));
+
+    // Homebrew loaded in small, unaligned chunks
+    u32 offset = 0;
+    CHECK(f_open(&file, "/3ds/hbldr.3dsx", FA_READ) == FR_OK);
+    while(f_read(&file, buffer, 700, &read) == FR_OK && read != 0)
+    {
+        CHECK(checkContents(buffer, 103, offset, read));
+        offset += read;
+    }
+    f_close(&file);
+    CHECK(offset == SIM_FILE_SIZE);
+
+    // Title directory scan
+    count = 0;
+    CHECK(f_opendir(&dir, "/Nintendo 3DS") == FR_OK);
+    while(f_readdir(&dir, &info) == FR_OK && info.fname[0] != 0)
+        count++;
+    f_closedir(&dir);
+    CHECK(count == SIM_NUM_TITLE_DIRS);
+
+    // A log file updated a few times, written sectors must be read back from the cache
+    for(u32 i = 0; i < 3; i++)
+    {
+        static u8 log[0x2000];
+
+        CHECK(f_open(&file, "boottime.bin", FA_READ | FA_WRITE | FA_OPEN_ALWAYS) == FR_OK);
+        memset(log, 0, sizeof(log));
+        f_read(&file, log, sizeof(log), &read);
+        CHECK(read == (i == 0 ? 0 : sizeof(log)) && log[sizeof(log) - 1] == (i == 0 ? 0 : 0x40 + i - 1));
+        memset(log, 0x40 + i, sizeof(log));
+        CHECK(f_lseek(&file, 0) == FR_OK && f_write(&file, log, sizeof(log), &read) == FR_OK && read == sizeof(log));
+        f_close(&file);
+    }
+
+    CHECK(readWholeFile("/boot.firm", SIM_MAX_READ) == SIM_FILE_SIZE && checkContents(buffer, 100, 0, SIM_FILE_SIZE));
+    CHECK(f_unmount("sdmc:") == FR_OK);
+}
+
+// Raw "R <sector> <count>" lines
+static bool runTrace(const char *path)
+{
+    FILE *trace = fopen(path, "r");
+    if(trace == NULL)
+    {
+        perror(path);
+        return false;
+    }
+
+    char op;
+    u32 sector, count;
+    while(fscanf(trace, " %c %u %u", &op, &sector, &count) == 3)
+    {
+        if(op == 'R' && count <= SIM_MAX_READ / DISKCACHE_SECTOR_SIZE)
+            disk_read(DISKCACHE_DRIVE_SDCARD, buffer, sector, count);
+    }
+
+    fclose(trace);
+    return true;
+}
+
+static void printCounts(const char *name)
+{
+    const SimDrive *drive = &drives[DISKCACHE_DRIVE_SDCARD];
+    printf("%s: %u device read commands, %u sectors read, %u writes\n", name, drive->commands, drive->sectorsRead, drive->writes);
+
+    if(useCache)
+    {
+        const DiskCacheStats *stats = diskCacheGetStats(DISKCACHE_DRIVE_SDCARD);
+        u32 hits = stats->hits - statsBase.hits, misses = stats->misses - statsBase.misses;
+
+        printf("        %u disk_read calls (%u sectors), %u hits, %u misses, %u bypassed, %u read ahead (%u used), hit rate %.1f%%\n",
+               stats->reads - statsBase.reads, stats->sectorsRequested - statsBase.sectorsRequested, hits, misses,
+               stats->bypassed - statsBase.bypassed, stats->readAheadSectors - statsBase.readAheadSectors,
+               stats->readAheadHits - statsBase.readAheadHits, hits + misses != 0 ? 100.0 * hits / (hits + misses) : 0.0);
+    }
+}
+
+/* Checks */
+
+// Same boot without, then with the cache: same data, fewer commands. Also records the trace.
+static void checkBoot(const char *imagePath, const char *tracePath)
+{
+    u32 uncachedCommands, cachedCommands;
+
+    printf("Boot:\n");
+    if(!makeSdImage(imagePath))
+    {
+        printf("    image creation: FAILED\n");
+        numFailures++;
+        return;
+    }
+
+    useCache = false;
+    resetCounts();
+    runBoot();
+    printCounts("    without cache");
+    uncachedCommands = drives[DISKCACHE_DRIVE_SDCARD].commands;
+
+    // The log file now exists, start again from the same state
+    CHECK(makeSdImage(imagePath));
+
+    useCache = true;
+    resetCounts();
+    traceFile = fopen(tracePath, "w");
+    CHECK(traceFile != NULL);
+    runBoot();
+    if(traceFile != NULL)
+        fclose(traceFile);
+    traceFile = NULL;
+    printCounts("    with cache");
+    cachedCommands = drives[DISKCACHE_DRIVE_SDCARD].commands;
+
+    CHECK(cachedCommands < uncachedCommands);
+
+    printf("Trace replay:\n");
+    useCache = false;
+    resetCounts();
+    CHECK(runTrace(tracePath));
+    printCounts("    without cache");
+    CHECK(drives[DISKCACHE_DRIVE_SDCARD].commands == uncachedCommands);
+
+    useCache = true;
+    resetCounts();
+    CHECK(runTrace(tracePath));
+    printCounts("    with cache");
+    CHECK(diskCacheGetStats(DISKCACHE_DRIVE_SDCARD)->reads - statsBase.reads == uncachedCommands);
+    CHECK(drives[DISKCACHE_DRIVE_SDCARD].commands <= cachedCommands);
+}
+
+static bool makeNandImage(const char *path, u32 id)
+{
+    static BYTE work[FF_MAX_SS * 4];
+    static const MKFS_PARM opt = {FM_FAT, 0, 0, 0, 0};
+
+    bool res = openImage(DISKCACHE_DRIVE_CTRNAND, path, SIM_NAND_IMAGE_SECTORS) && f_mkfs("nand:", &opt, work, sizeof(work)) == FR_OK &&
+               f_mount(&nandFs, "nand:", 1) == FR_OK && f_mkdir("nand:/rw") == FR_OK && f_mkdir("nand:/rw/luma") == FR_OK &&
+               writeFile("nand:/rw/luma/config.ini", id, 3000 + id);
+
+    return f_unmount("nand:") == FR_OK && res;
+}
+
+// main.c switches CTRNAND between SysNAND and EmuNAND (ctrNandLocation, emuOffset) without going through
+// disk_initialize. The cached sectors of the previous NAND must not be returned after that.
+static void checkCtrNandMove(const char *sysNandPath, const char *emuNandPath)
+{
+    printf("CTRNAND location change:\n");
+    useCache = true;
+    resetCounts();
+
+    CHECK(makeNandImage(emuNandPath, 2));
+    CHECK(makeNandImage(sysNandPath, 1));
+
+    // Mounted and read from SysNAND
+    FIL file;
+    CHECK(f_mount(&nandFs, "nand:", 1) == FR_OK);
+    CHECK(f_open(&file, "nand:/rw/luma/config.ini", FA_READ) == FR_OK);
+    u32 dataSector = nandFs.database + (file.obj.sclust - 2) * nandFs.csize;
+    f_close(&file);
+    CHECK(readWholeFile("nand:/rw/luma/config.ini", SIM_MAX_READ) == 3001 && checkContents(buffer, 1, 0, 3001));
+
+    // Both images have the same layout. Reading the file data again after moving to EmuNAND
+    // returns the SysNAND sectors without the invalidation.
+    u8 sector[DISKCACHE_SECTOR_SIZE], expected[DISKCACHE_SECTOR_SIZE];
+    CHECK(openImage(DISKCACHE_DRIVE_CTRNAND, emuNandPath, 0));
+    CHECK(readCtrNand(dataSector, 1, expected) == 0 && checkContents(expected, 2, 0, sizeof(expected)));
+    CHECK(disk_read(DISKCACHE_DRIVE_CTRNAND, sector, dataSector, 1) == RES_OK && checkContents(sector, 1, 0, sizeof(sector)));
+
+    // What main.c and emunand.c do
+    diskCacheInvalidate(DISKCACHE_DRIVE_CTRNAND);
+    CHECK(disk_read(DISKCACHE_DRIVE_CTRNAND, sector, dataSector, 1) == RES_OK && memcmp(sector, expected, sizeof(sector)) == 0);
+
+    // FatFs itself rereads the volume when remounting
+    CHECK(f_mount(&nandFs, "nand:", 1) == FR_OK);
+    CHECK(readWholeFile("nand:/rw/luma/config.ini", SIM_MAX_READ) == 3002 && checkContents(buffer, 2, 0, 3002));
+    CHECK(f_unmount("nand:") == FR_OK);
+
+    CHECK(diskCacheGetStats(DISKCACHE_DRIVE_CTRNAND)->hits != 0);
+}
+
+static void usage(void)
+{
+    fprintf(stderr,
+            "Usage: disksim mkimage <sd image>\n"
+            "       disksim boot <sd image> [--no-cache] [--trace <output>]\n"
+            "       disksim replay <trace> <sd image> [--no-cache]\n"
+            "       disksim check <directory for the images>\n");
+    exit(2);
+}
+
+int main(int argc, char **argv)
+{
+    if(argc < 3)
+        usage();
+
+    const char *args[2] = {argv[2], NULL}, *tracePath = NULL;
+    u32 numArgs = 1;
+    for(int i = 3; i < argc; i++)
+    {
+        if(strcmp(argv[i], "--no-cache") == 0)
+            useCache = false;
+        else if(strcmp(argv[i], "--trace") == 0 && i + 1 < argc)
+            tracePath = argv[++i];
+        else if(argv[i][0] != '-' && numArgs < 2)
+            args[numArgs++] = argv[i];
+        else
+            usage();
+    }
+
+    if(strcmp(argv[1], "mkimage") == 0)
+        return makeSdImage(args[0]) ? 0 : 1;
+
+    if(strcmp(argv[1], "boot") == 0)
+    {
+        if(!openImage(DISKCACHE_DRIVE_SDCARD, args[0], 0))
+            return 1;
+
+        traceFile = tracePath != NULL ? fopen(tracePath, "w") : NULL;
+        runBoot();
+        if(traceFile != NULL)
+            fclose(traceFile);
+        printCounts("boot");
+    }
+    else if(strcmp(argv[1], "replay") == 0)
+    {
+        if(numArgs < 2 || !openImage(DISKCACHE_DRIVE_SDCARD, args[1], 0) || !runTrace(args[0]))
+            return 1;
+        printCounts("replay");
+    }
+    else if(strcmp(argv[1], "check") == 0)
+    {
+        char sdPath[256], tracePath[256], sysNandPath[256], emuNandPath[256];
+
+        snprintf(sdPath, sizeof(sdPath), "%s/sd.img", args[0]);
+        snprintf(tracePath, sizeof(tracePath), "%s/boot.trace", args[0]);
+        snprintf(sysNandPath, sizeof(sysNandPath), "%s/sysnand.img", args[0]);
+        snprintf(emuNandPath, sizeof(emuNandPath), "%s/emunand.img", args[0]);
+
+        checkBoot(sdPath, tracePath);
+        checkCtrNandMove(sysNandPath, emuNandPath);
+        printf(numFailures == 0 ? "ok\n" : "FAILED\n");
+    }
+    else
+        usage();
+
+    return numFailures == 0 ? 0 : 1;
+}
@@ -0,0 +1,982 @@
+/*
+*   This file is part of Luma3DS
+*   Copyright (C) 2016-2020 Aurora Wright, TuxSH
+*
+*   This program is free software: you can redistribute it and/or modify
+*   it under the terms of the GNU General Public License as published by
+*   the Free Software Foundation, either version 3 of the License, or
+*   (at your option) any later version.
+*
+*   This program is distributed in the hope that it will be useful,
+*   but WITHOUT ANY WARRANTY; without even the implied warranty of
+*   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*   GNU General Public License for more details.
+*
+*   You should have received a copy of the GNU General Public License
+*   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*
+*   Additional Terms 7.b and 7.c of GPLv3 apply to this file:
+*       * Requiring preservation of specified reasonable legal notices or
+*         author attributions in that material or in the Appropriate Legal
+*         Notices displayed by works containing it.
+*       * Prohibiting misrepresentation of the origin of that material,
+*         or requiring that modified versions of such material be marked in
+*         reasonable ways as different from the original version.
+*/
+
+/* FIRM patching simulator: loads a decrypted FIRM (or a bare Process9 .code or Kernel11
+   section), runs the same patch pipeline as the Arm9 payload and prints a JSON report with,
+   for each patch function and boot phase, its result, the bytes it changed and the time it
+   took. The report can be compared between FIRM versions or Luma3DS builds (--no-timing
+   makes it deterministic), and --runs benchmarks the pattern searches. */
+
+#include <setjmp.h>
+#include <signal.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include "../source/types.h"
+#include "../source/firm.h"
+#include "../source/patches.h"
+#include "../source/emunand.h"
+#include "../source/boottime.h"
+#include "../source/config.h"
+#include "firmsim.h"
+
+#ifndef MAP_FIXED_NOREPLACE
+#define MAP_FIXED_NOREPLACE 0x100000
+#endif
+
+#define SIM_FCRAM_ADDR          0x20000000
+#define SIM_FCRAM_SIZE          0x01000000
+#define SIM_FIRM_ADDR           0x20001000 // see firm.c
+#define SIM_FIRM_MAX_SIZE       0x00800000
+#define SIM_VRAM_ADDR           0x18000000
+#define SIM_VRAM_SIZE           0x00600000
+#define SIM_K11EXT_VA           0x70000000
+#define SIM_PLACEHOLDER_K11EXT  0x4000
+
+#define SIM_MAX_RECORDS         64
+#define SIM_MAX_SITES           64
+#define SIM_MAX_SITE_BYTES      32
+#define SIM_MAX_RUNS            1000
+#define SIM_SITE_MERGE_GAP      4
+#define SIM_TIMEOUT_SECS        10
+#define SIM_NO_RECORD           0xFFFFFFFF
+#define SIM_NO_RESULT           0xFFFFFFFF
+
+typedef enum SimInput
+{
+    SIM_INPUT_FIRM = 0,
+    SIM_INPUT_PROCESS9,
+    SIM_INPUT_KERNEL11,
+} SimInput;
+
+typedef enum SimRegionId
+{
+    SIM_REGION_IMAGE = 0,   // the input, at the address firm.c expects the FIRM
+    SIM_REGION_SECTION0,    // where mergeSection0 copies the sysmodules
+    SIM_REGION_K11EXT,      // the k11 extension in VRAM, installK11Extension fills its parameters
+
+    SIM_NUM_REGIONS,
+} SimRegionId;
+
+typedef struct SimRegion
+{
+    const char *name;
+    u8 *addr;
+    u32 size;
+    u8 *pristine;
+    u8 *snapshot;
+} SimRegion;
+
+typedef struct SimSite
+{
+    u32 region;
+    u32 offset;
+    u32 size;
+    u8 before[SIM_MAX_SITE_BYTES];
+    u8 after[SIM_MAX_SITE_BYTES];
+} SimSite;
+
+typedef struct SimRecord
+{
+    char name[48];
+    BootPhase phase;
+    u32 result;
+    char error[160];
+    u64 times[SIM_MAX_RUNS];
+    u32 memsearchCalls;
+    u64 memsearchBytes;
+    u32 bytesChanged;
+    u32 numSites;
+    bool sitesTruncated;
+    SimSite sites[SIM_MAX_SITES];
+} SimRecord;
+
+typedef u32 (*SimPatchFunc)(u8 *pos, u32 size);
+
+typedef struct SimPatch
+{
+    const char *name;
+    SimPatchFunc func;
+} SimPatch;
+
+static struct
+{
+    SimInput input;
+    FirmwareType type;
+    u32 firmVersion;
+    FirmwareSource nandType;
+    bool n3ds, dev, firmProt, initSd, unitinfo, timing;
+    u32 codeAddr;
+    u32 runs;
+    const char *inputPath, *lumaPath, *dumpPath, *outPath;
+} opts;
+
+// Where the Process9 .code and Kernel11 are in the image, to give the virtual address of patch sites
+static struct
+{
+    Firm header;
+    bool hasProcess9, hasKernel11;
+    u32 process9Offset, process9Size, process9Addr;
+    u32 kernel11Offset, kernel11Size, kernel11VA;
+} layout;
+
+const char *simStorageDir;
+
+static SimRegion regions[SIM_NUM_REGIONS] = {
+    [SIM_REGION_IMAGE] = { .name = "image" },
+    [SIM_REGION_SECTION0] = { .name = "section0" },
+    [SIM_REGION_K11EXT] = { .name = "k11ext" },
+};
+
+static SimRecord records[SIM_MAX_RECORDS];
+static u32 numRecords, nextRecord, activeRecord = SIM_NO_RECORD, currentRun;
+static u64 recordStart;
+
+static sigjmp_buf *abortTarget;
+static char abortMessage[160];
+
+static const char *phaseNames[] = {"storage mount", "config read", "emunand locate", "splash", "firm read", "exefs decrypt",
+                                   "firm check", "arm9bin decrypt", "patch", "modules", "section copy"};
+
+static u64 now(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (u64)ts.tv_sec * 1000000000ull + (u64)ts.tv_nsec;
+}
+
+void simAbort(const char *msg)
+{
+    snprintf(abortMessage, sizeof(abortMessage), "%s", msg);
+
+    if(activeRecord != SIM_NO_RECORD)
+    {
+        snprintf(records[activeRecord].error, sizeof(records[activeRecord].error), "%s", msg);
+        activeRecord = SIM_NO_RECORD;
+    }
+
+    if(abortTarget == NULL)
+    {
+        fprintf(stderr, "firmsim: %s\n", msg);
+        exit(2);
+    }
+
+    siglongjmp(*abortTarget, 1);
+}
+
+// Broken patterns make the patch functions run off the image or loop forever
+static void onSignal(int sig, siginfo_t *info, void *context)
+{
+    char msg[64];
+    (void)context;
+
+    if(sig == SIGALRM)
+        snprintf(msg, sizeof(msg), "timed out after %u seconds", SIM_TIMEOUT_SECS);
+    else
+        snprintf(msg, sizeof(msg), "%s at address 0x%08lX", sig == SIGSEGV ? "SIGSEGV" : sig == SIGBUS ? "SIGBUS" : "SIGILL",
+                 (unsigned long)info->si_addr);
+
+    simAbort(msg);
+}
+
+static void mapRegion(u32 addr, u32 size)
+{
+    u32 start = addr & ~0xFFF,
+        end = (addr + size + 0xFFF) & ~0xFFF;
+
+    void *p = mmap((void *)start, end - start, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_FIXED_NOREPLACE, -1, 0);
+
+    if(p != (void *)start)
+    {
+        char msg[96];
+        snprintf(msg, sizeof(msg), "unable to map 0x%08lX-0x%08lX", (unsigned long)start, (unsigned long)end);
+        simAbort(msg);
+    }
+}
+
+static void setupRegion(SimRegionId id, u8 *addr, u32 size)
+{
+    SimRegion *region = &regions[id];
+
+    region->addr = addr;
+    region->size = size;
+    region->pristine = malloc(size);
+    region->snapshot = malloc(size);
+    if(region->pristine == NULL || region->snapshot == NULL) simAbort("out of memory");
+
+    memcpy(region->pristine, addr, size);
+}
+
+static void restoreRegions(void)
+{
+    for(u32 i = 0; i < SIM_NUM_REGIONS; i++)
+    {
+        if(regions[i].size != 0)
+            memcpy(regions[i].addr, regions[i].pristine, regions[i].size);
+    }
+}
+
+static u32 readFile(const char *path, void *dest, u32 maxSize)
+{
+    FILE *f = fopen(path, "rb");
+    if(f == NULL) return 0;
+
+    u32 size = (u32)fread(dest, 1, maxSize, f);
+    bool tooLarge = fgetc(f) != EOF;
+
+    fclose(f);
+    return tooLarge ? 0 : size;
+}
+
+static void diffRegions(SimRecord *record)
+{
+    for(u32 id = 0; id < SIM_NUM_REGIONS; id++)
+    {
+        const SimRegion *region = &regions[id];
+        const u8 *cur = region->addr, *old = region->snapshot;
+
+        for(u32 off = 0; off < region->size;)
+        {
+            if(cur[off] == old[off])
+            {
+                // Skip the unchanged parts quickly
+                if((off & 63) == 0 && off + 64 <= region->size && memcmp(cur + off, old + off, 64) == 0)
+                    off += 64;
+                else
+                    off++;
+                continue;
+            }
+
+            // Changed bytes close to each other (e.g. in the same instruction) make a single site
+            u32 start = off, last = off;
+            for(off++; off < region->size && off - last <= SIM_SITE_MERGE_GAP; off++)
+            {
+                if(cur[off] != old[off])
+                {
+                    last = off;
+                    record->bytesChanged++;
+                }
+            }
+            record->bytesChanged++;
+            off = last + 1;
+
+            if(record->numSites == SIM_MAX_SITES)
+            {
+                record->sitesTruncated = true;
+                continue;
+            }
+
+            SimSite *site = &record->sites[record->numSites++];
+            u32 size = last + 1 - start;
+            site->region = id;
+            site->offset = start;
+            site->size = size;
+            memcpy(site->before, old + start, size < SIM_MAX_SITE_BYTES ? size : SIM_MAX_SITE_BYTES);
+            memcpy(site->after, cur + start, size < SIM_MAX_SITE_BYTES ? size : SIM_MAX_SITE_BYTES);
+        }
+    }
+}
+
+/*
+    Instrumentation, called by firm.c (and BOOTTIME_PATCH, see simulator.h) around each boot phase
+    and patch function. Regions are diffed on the first run only, it doesn't count in the timings.
+*/
+
+u32 bootTimeBegin(BootPhase phase, const char *name)
+{
+    if(nextRecord == SIM_MAX_RECORDS) simAbort("too many patch functions");
+
+    u32 id = nextRecord++;
+    SimRecord *record = &records[id];
+
+    if(currentRun == 0)
+    {
+        if(name == NULL) name = phaseNames[phase];
+
+        u32 len;
+        for(len = 0; name[len] != 0 && name[len] != '(' && len < sizeof(record->name) - 1; len++);
+        memcpy(record->name, name, len);
+        record->name[len] = 0;
+        record->phase = phase;
+        record->result = SIM_NO_RESULT;
+        numRecords = nextRecord;
+
+        for(u32 i = 0; i < SIM_NUM_REGIONS; i++)
+        {
+            if(regions[i].size != 0)
+                memcpy(regions[i].snapshot, regions[i].addr, regions[i].size);
+        }
+    }
+    else if(id >= numRecords || records[id].phase != phase)
+        simAbort("the patch pipeline changed between runs");
+
+    activeRecord = id;
+    recordStart = now();
+    return id;
+}
+
+void bootTimeEnd(u32 id)
+{
+    u64 end = now();
+
+    records[id].times[currentRun] = end - recordStart;
+    activeRecord = SIM_NO_RECORD;
+
+    if(currentRun == 0)
+        diffRegions(&records[id]);
+}
+
+void simRecordResult(unsigned int id, unsigned int result)
+{
+    records[id].result = result;
+}
+
+u8 *__real_memsearch(u8 *startPos, const void *pattern, u32 size, u32 patternSize);
+
+// Linked with --wrap=memsearch, counts the searches of each patch function
+u8 *__wrap_memsearch(u8 *startPos, const void *pattern, u32 size, u32 patternSize)
+{
+    u8 *ret = __real_memsearch(startPos, pattern, size, patternSize);
+
+    if(activeRecord != SIM_NO_RECORD && currentRun == 0)
+    {
+        records[activeRecord].memsearchCalls++;
+        records[activeRecord].memsearchBytes += ret != NULL ? (u32)(ret - startPos) + patternSize : size;
+    }
+
+    return ret;
+}
+
+/*
+    Pipelines
+*/
+
+static u32 simPatchFirmlaunches(u8 *pos, u32 size)
+{
+    return patchFirmlaunches(pos, size, opts.codeAddr);
+}
+
+static u32 simPatchEmuNand(u8 *pos, u32 size)
+{
+    return patchEmuNand(pos, size, opts.firmVersion, false);
+}
+
+static u32 simPatchTitleInstallMinVersionChecks(u8 *pos, u32 size)
+{
+    return patchTitleInstallMinVersionChecks(pos, size, opts.firmVersion);
+}
+
+static u32 simPatchP9AMTicketWrapperZeroKeyIV(u8 *pos, u32 size)
+{
+    return patchP9AMTicketWrapperZeroKeyIV(pos, size, opts.firmVersion);
+}
+
+static u32 simPatchReadFileSHA256Vtab11(u8 *pos, u32 size)
+{
+    return patchReadFileSHA256Vtab11(pos, size, opts.codeAddr);
+}
+
+static u32 simPatchTwlFlashcartChecks(u8 *pos, u32 size)
+{
+    return patchTwlFlashcartChecks(pos, size, opts.firmVersion);
+}
+
+static u32 simPatchTwlEmuNand(u8 *pos, u32 size)
+{
+    return patchEmuNand(pos, size, opts.firmVersion, true);
+}
+
+// Every patch function that operates on Process9 alone, regardless of the settings
+static const SimPatch nativeProcess9Patches[] = {
+    { "patchSignatureChecks", patchSignatureChecks },
+    { "patchOldSignatureChecks", patchOldSignatureChecks },
+    { "nandTypoFix", nandTypoFix },
+    { "patchEmuNand", simPatchEmuNand },
+    { "patchFirmWrites", patchFirmWrites },
+    { "patchOldFirmWrites", patchOldFirmWrites },
+    { "patchNandInit", patchNandInit },
+    { "patchCidInit", patchCidInit },
+    { "patchFirmlaunches", simPatchFirmlaunches },
+    { "patchZeroKeyNcchEncryptionCheck", patchZeroKeyNcchEncryptionCheck },
+    { "patchNandNcchEncryptionCheck", patchNandNcchEncryptionCheck },
+    { "patchTitleInstallMinVersionChecks", simPatchTitleInstallMinVersionChecks },
+    { "patchP9AMTicketWrapperZeroKeyIV", simPatchP9AMTicketWrapperZeroKeyIV },
+    { "patchCheckForDevCommonKey", patchCheckForDevCommonKey },
+    { "patchP9AccessChecks", patchP9AccessChecks },
+    { "patchReadFileSHA256Vtab11", simPatchReadFileSHA256Vtab11 },
+    { NULL, NULL },
+};
+
+static const SimPatch twlProcess9Patches[] = {
+    { "patchLgySignatureChecks", patchLgySignatureChecks },
+    { "patchTwlInvalidSignatureChecks", patchTwlInvalidSignatureChecks },
+    { "patchTwlNintendoLogoChecks", patchTwlNintendoLogoChecks },
+    { "patchTwlWhitelistChecks", patchTwlWhitelistChecks },
+    { "patchTwlFlashcartChecks", simPatchTwlFlashcartChecks },
+    { "patchOldTwlFlashcartChecks", patchOldTwlFlashcartChecks },
+    { "patchTwlShaHashChecks", patchTwlShaHashChecks },
+    { "patchEmuNand", simPatchTwlEmuNand },
+    { NULL, NULL },
+};
+
+static const SimPatch agbProcess9Patches[] = {
+    { "patchLgySignatureChecks", patchLgySignatureChecks },
+    { "patchAgbBootSplash", patchAgbBootSplash },
+    { NULL, NULL },
+};
+
+static u32 runFirm(void)
+{
+    switch(opts.type)
+    {
+        case NATIVE_FIRM:
+            return patchNativeFirm(opts.firmVersion, opts.nandType, simStorageDir != NULL, opts.firmProt, opts.initSd, opts.unitinfo);
+        case TWL_FIRM:
+            return patchTwlFirm(opts.firmVersion, opts.nandType, simStorageDir != NULL, opts.unitinfo);
+        case AGB_FIRM:
+            return patchAgbFirm(simStorageDir != NULL, opts.unitinfo);
+        default:
+            return patch1x2xNativeAndSafeFirm();
+    }
+}
+
+// Each patch function gets the original image, a broken one doesn't stop the others
+static u32 runProcess9(void)
+{
+    const SimPatch *patches = opts.type == TWL_FIRM ? twlProcess9Patches : opts.type == AGB_FIRM ? agbProcess9Patches : nativeProcess9Patches;
+    sigjmp_buf *outerTarget = abortTarget;
+    volatile u32 ret = 0;
+
+    for(const SimPatch *volatile patch = patches; patch->name != NULL; patch++)
+    {
+        sigjmp_buf patchTarget;
+        volatile u32 id = SIM_NO_RECORD;
+
+        restoreRegions();
+        abortTarget = &patchTarget;
+
+        if(sigsetjmp(patchTarget, 1) == 0)
+        {
+            id = bootTimeBegin(BOOTPHASE_PATCH, patch->name);
+            u32 res = patch->func(regions[SIM_REGION_IMAGE].addr, regions[SIM_REGION_IMAGE].size);
+            bootTimeEnd(id);
+            simRecordResult(id, res);
+            ret += res;
+        }
+        else
+        {
+            if(id != SIM_NO_RECORD) records[id].times[currentRun] = 0;
+            ret++;
+        }
+    }
+
+    abortTarget = outerTarget;
+    return ret;
+}
+
+static u32 runKernel11(void)
+{
+    u8 *pos = regions[SIM_REGION_IMAGE].addr;
+    u32 size = regions[SIM_REGION_IMAGE].size,
+        baseK11VA,
+        ret = 0;
+    u8 *freeK11Space;
+    u32 *arm11SvcHandler,
+        *arm11ExceptionsPage,
+        *arm11SvcTable = getKernel11Info(pos, size, &baseK11VA, &freeK11Space, &arm11SvcHandler, &arm11ExceptionsPage);
+
+    ret += BOOTTIME_PATCH(installK11Extension(pos, size, opts.initSd, baseK11VA, arm11ExceptionsPage, &freeK11Space));
+    ret += BOOTTIME_PATCH(patchKernel11(pos, size, baseK11VA, arm11SvcTable, arm11ExceptionsPage));
+
+    return ret;
+}
+
+/*
+    Setup
+*/
+
+static void loadLumaFirm(const char *path)
+{
+    static u8 buffer[SIM_VRAM_SIZE + 0x200];
+    u32 size = readFile(path, buffer, sizeof(buffer));
+    const Firm *lumaFirm = (const Firm *)buffer;
+
+    if(size < sizeof(Firm) || memcmp(lumaFirm->magic, "FIRM", 4) != 0) simAbort("the Luma3DS FIRM is invalid");
+
+    // The k11 extension and the sysmodules are in the section loaded to VRAM
+    for(u32 i = 0; i < 4; i++)
+    {
+        const FirmSection *section = &lumaFirm->section[i];
+        u32 addr = (u32)section->address;
+
+        if(section->size != 0 && addr >= SIM_VRAM_ADDR && addr + section->size <= SIM_VRAM_ADDR + SIM_VRAM_SIZE &&
+           section->offset + section->size <= size)
+            memcpy(section->address, buffer + section->offset, section->size);
+    }
+}
+
+static void setupK11Extension(void)
+{
+    vu32 *header = (vu32 *)SIM_VRAM_ADDR;
+
+    if(opts.lumaPath != NULL)
+        loadLumaFirm(opts.lumaPath);
+    else
+    {
+        // Just enough for installK11Extension: the size of the extension and where its parameters are
+        header[8] = SIM_K11EXT_VA + SIM_PLACEHOLDER_K11EXT;
+        header[9] = SIM_K11EXT_VA + 0x100;
+    }
+
+    u32 size = header[8] - SIM_K11EXT_VA;
+    if(size > SIM_VRAM_SIZE) simAbort("the k11 extension is invalid");
+
+    setupRegion(SIM_REGION_K11EXT, (u8 *)SIM_VRAM_ADDR, size);
+}
+
+static void probeLayout(void)
+{
+    sigjmp_buf probeTarget;
+    u8 *image = regions[SIM_REGION_IMAGE].addr;
+    u32 imageSize = regions[SIM_REGION_IMAGE].size;
+
+    abortTarget = &probeTarget;
+
+    if(opts.input == SIM_INPUT_PROCESS9)
+    {
+        layout.hasProcess9 = true;
+        layout.process9Size = imageSize;
+        layout.process9Addr = opts.codeAddr;
+    }
+    else if(opts.input == SIM_INPUT_FIRM && sigsetjmp(probeTarget, 1) == 0)
+    {
+        u32 i = opts.type == TWL_FIRM || opts.type == AGB_FIRM ? 3 : 2,
+            process9Size,
+            process9Addr;
+        u8 *process9 = getProcess9Info(image + layout.header.section[i].offset, layout.header.section[i].size, &process9Size, &process9Addr);
+
+        layout.process9Offset = (u32)(process9 - image);
+        layout.process9Size = process9Size;
+        layout.process9Addr = process9Addr;
+        layout.hasProcess9 = true;
+    }
+
+    bool nativeFirm = opts.type == NATIVE_FIRM || opts.type == SAFE_FIRM || opts.type == NATIVE_FIRM1X2X;
+    if((opts.input == SIM_INPUT_KERNEL11 || (opts.input == SIM_INPUT_FIRM && nativeFirm)) && sigsetjmp(probeTarget, 1) == 0)
+    {
+        u32 offset = opts.input == SIM_INPUT_FIRM ? layout.header.section[1].offset : 0,
+            size = opts.input == SIM_INPUT_FIRM ? layout.header.section[1].size : imageSize,
+            baseK11VA;
+        u8 *freeK11Space;
+        u32 *arm11SvcHandler,
+            *arm11ExceptionsPage;
+
+        getKernel11Info(image + offset, size, &baseK11VA, &freeK11Space, &arm11SvcHandler, &arm11ExceptionsPage);
+
+        layout.kernel11Offset = offset;
+        layout.kernel11Size = size;
+        layout.kernel11VA = baseK11VA;
+        layout.hasKernel11 = true;
+    }
+
+    abortTarget = NULL;
+}
+
+static void setup(void)
+{
+    struct sigaction sa;
+
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_sigaction = onSignal;
+    sa.sa_flags = SA_SIGINFO | SA_NODEFER;
+    sigaction(SIGSEGV, &sa, NULL);
+    sigaction(SIGBUS, &sa, NULL);
+    sigaction(SIGILL, &sa, NULL);
+    sigaction(SIGALRM, &sa, NULL);
+
+    // What the patching code reads from the console memory map
+    mapRegion(0x10010000, 0x3000);
+    mapRegion(0x10140000, 0x1000);
+    mapRegion(SIM_VRAM_ADDR, SIM_VRAM_SIZE);
+    mapRegion(SIM_FCRAM_ADDR, SIM_FCRAM_SIZE);
+
+    CFG11_SOCINFO = opts.n3ds ? 7 : 1;
+    CFG_UNITINFO = opts.dev ? 1 : 0;
+
+    const char *path = "sdmc:/boot.firm";
+    for(u32 i = 0; path[i] != 0; i++) launchedPath[i] = path[i];
+
+    u8 *image = (u8 *)SIM_FIRM_ADDR;
+    u32 size = readFile(opts.inputPath, image, SIM_FIRM_MAX_SIZE);
+    if(size == 0) simAbort("unable to read the input (missing, empty or too large)");
+
+    if(opts.input == SIM_INPUT_FIRM)
+    {
+        const Firm *firm = (const Firm *)image;
+
+        if(size < sizeof(Firm) || memcmp(firm->magic, "FIRM", 4) != 0) simAbort("the input isn't a FIRM");
+        for(u32 i = 0; i < 4; i++)
+        {
+            if(firm->section[i].size != 0 && firm->section[i].offset + firm->section[i].size > size)
+                simAbort("the input FIRM is truncated");
+        }
+
+        layout.header = *firm;
+
+        // Sysmodules are copied to the address of section 0
+        if(firm->section[0].size != 0)
+        {
+            u32 dst = (u32)firm->section[0].address,
+                dstSize = opts.type == TWL_FIRM || opts.type == AGB_FIRM ? 0x600000 : 0x80000;
+
+            if(dst < SIM_FCRAM_ADDR + SIM_FCRAM_SIZE && dst + dstSize > SIM_FCRAM_ADDR)
+            {
+                if(dst < SIM_FIRM_ADDR + size) simAbort("section 0 overlaps the FIRM");
+            }
+            else
+                mapRegion(dst, dstSize);
+
+            setupRegion(SIM_REGION_SECTION0, firm->section[0].address, dstSize);
+        }
+    }
+
+    setupRegion(SIM_REGION_IMAGE, image, size);
+
+    if(opts.input != SIM_INPUT_PROCESS9)
+        setupK11Extension();
+
+    probeLayout();
+}
+
+/*
+    Report
+*/
+
+static void writeString(FILE *out, const char *s)
+{
+    fputc('"', out);
+    for(; *s != 0; s++)
+    {
+        if(*s == '"' || *s == '\\')
+            fprintf(out, "\\%c", *s);
+        else if((u8)*s < 0x20)
+            fprintf(out, "\\u%04x", (u8)*s);
+        else
+            fputc(*s, out);
+    }
+    fputc('"', out);
+}
+
+static void writeHex(FILE *out, const u8 *data, u32 size)
+{
+    fputc('"', out);
+    for(u32 i = 0; i < size && i < SIM_MAX_SITE_BYTES; i++)
+        fprintf(out, "%02x", data[i]);
+    fputc('"', out);
+}
+
+static void writeSiteLocation(FILE *out, const SimSite *site)
+{
+    const SimRegion *region = &regions[site->region];
+    u32 off = site->offset;
+
+    fprintf(out, "\"region\": \"%s\", \"offset\": \"0x%08lX\"", region->name, (unsigned long)off);
+
+    if(site->region == SIM_REGION_IMAGE)
+    {
+        if(opts.input == SIM_INPUT_FIRM)
+        {
+            const FirmSection *sections = layout.header.section;
+            u32 i;
+
+            for(i = 0; i < 4 && (sections[i].size == 0 || off < sections[i].offset || off >= sections[i].offset + sections[i].size); i++);
+
+            if(i == 4)
+                fprintf(out, ", \"section\": null");
+            else
+                fprintf(out, ", \"section\": %lu, \"address\": \"0x%08lX\"", (unsigned long)i,
+                        (unsigned long)((u32)sections[i].address + off - sections[i].offset));
+        }
+
+        if(layout.hasProcess9 && off >= layout.process9Offset && off - layout.process9Offset < layout.process9Size)
+            fprintf(out, ", \"process9\": \"0x%08lX\"", (unsigned long)(layout.process9Addr + off - layout.process9Offset));
+        else if(layout.hasKernel11 && off >= layout.kernel11Offset && off - layout.kernel11Offset < layout.kernel11Size)
+            fprintf(out, ", \"kernel11\": \"0x%08lX\"", (unsigned long)(layout.kernel11VA + off - layout.kernel11Offset));
+    }
+    else
+    {
+        fprintf(out, ", \"address\": \"0x%08lX\"", (unsigned long)((u32)region->addr + off));
+        if(site->region == SIM_REGION_K11EXT)
+            fprintf(out, ", \"kernel11\": \"0x%08lX\"", (unsigned long)(SIM_K11EXT_VA + off));
+    }
+}
+
+static void sortTimes(u64 *times, u32 count)
+{
+    for(u32 i = 1; i < count; i++)
+    {
+        u64 t = times[i];
+        u32 j;
+        for(j = i; j > 0 && times[j - 1] > t; j--) times[j] = times[j - 1];
+        times[j] = t;
+    }
+}
+
+static void writeReport(FILE *out, u32 runsDone, bool aborted, u32 result)
+{
+    static const char *typeNames[] = {"NATIVE_FIRM", "TWL_FIRM", "AGB_FIRM", "SAFE_FIRM", "SYSUPDATER_FIRM", "NATIVE_FIRM1X2X"};
+    static const char *inputNames[] = {"firm", "process9", "kernel11"};
+    const SimRegion *image = &regions[SIM_REGION_IMAGE];
+
+    u32 hash = 0x811C9DC5;
+    for(u32 i = 0; i < image->size; i++) hash = (hash ^ image->pristine[i]) * 0x01000193;
+
+    fprintf(out, "{\n  \"input\": ");
+    writeString(out, opts.inputPath);
+    fprintf(out, ",\n  \"inputKind\": \"%s\",\n  \"inputSize\": %lu,\n  \"inputFnv1a\": \"0x%08lX\",\n", inputNames[opts.input],
+            (unsigned long)image->size, (unsigned long)hash);
+    fprintf(out, "  \"type\": \"%s\",\n  \"console\": \"%s\",\n  \"devUnit\": %s,\n  \"nand\": \"%s\",\n  \"firmVersion\": \"0x%lX\",\n",
+            typeNames[opts.type], opts.n3ds ? "n3ds" : "o3ds", opts.dev ? "true" : "false",
+            opts.nandType == FIRMWARE_SYSNAND ? "sysnand" : "emunand", (unsigned long)opts.firmVersion);
+
+    if(aborted)
+    {
+        fprintf(out, "  \"result\": null,\n  \"error\": ");
+        writeString(out, abortMessage);
+    }
+    else
+        fprintf(out, "  \"result\": %lu,\n  \"error\": null", (unsigned long)result);
+
+    u64 total = 0;
+    static u64 sorted[SIM_MAX_RUNS];
+
+    if(opts.timing)
+        fprintf(out, ",\n  \"runs\": %lu", (unsigned long)runsDone);
+
+    fprintf(out, ",\n  \"records\": [");
+    for(u32 i = 0; i < numRecords; i++)
+    {
+        const SimRecord *record = &records[i];
+
+        fprintf(out, "%s\n    {\n      \"name\": ", i == 0 ? "" : ",");
+        writeString(out, record->name);
+        fprintf(out, ",\n      \"phase\": \"%s\"", phaseNames[record->phase]);
+
+        if(record->result != SIM_NO_RESULT)
+            fprintf(out, ",\n      \"result\": %lu", (unsigned long)record->result);
+        if(record->error[0] != 0)
+        {
+            fprintf(out, ",\n      \"error\": ");
+            writeString(out, record->error);
+        }
+
+        if(opts.timing && runsDone != 0)
+        {
+            memcpy(sorted, record->times, runsDone * sizeof(u64));
+            sortTimes(sorted, runsDone);
+            total += sorted[runsDone / 2];
+            fprintf(out, ",\n      \"minNs\": %llu,\n      \"medianNs\": %llu,\n      \"maxNs\": %llu",
+                    (unsigned long long)sorted[0], (unsigned long long)sorted[runsDone / 2], (unsigned long long)sorted[runsDone - 1]);
+        }
+
+        fprintf(out, ",\n      \"memsearchCalls\": %lu,\n      \"memsearchBytes\": %llu,\n      \"bytesChanged\": %lu,\n      \"sites\": [",
+                (unsigned long)record->memsearchCalls, (unsigned long long)record->memsearchBytes, (unsigned long)record->bytesChanged);
+
+        for(u32 j = 0; j < record->numSites; j++)
+        {
+            const SimSite *site = &record->sites[j];
+
+            fprintf(out, "%s\n        { ", j == 0 ? "" : ",");
+            writeSiteLocation(out, site);
+            fprintf(out, ", \"size\": %lu, \"before\": ", (unsigned long)site->size);
+            writeHex(out, site->before, site->size);
+            fprintf(out, ", \"after\": ");
+            writeHex(out, site->after, site->size);
+            fprintf(out, " }");
+        }
+
+        fprintf(out, "%s]%s\n    }", record->numSites != 0 ? "\n      " : "", record->sitesTruncated ? ",\n      \"sitesTruncated\": true" : "");
+    }
+    fprintf(out, "%s]", numRecords != 0 ? "\n  " : "");
+
+    if(opts.timing && runsDone != 0)
+        fprintf(out, ",\n  \"totalMedianNs\": %llu", (unsigned long long)total);
+
+    fprintf(out, "\n}\n");
+}
+
+static void usage(void)
+{
+    fprintf(stderr,
+        "usage: firmsim [options] <input>\n"
+        "Runs the Luma3DS FIRM patches on a decrypted FIRM, Process9 or Kernel11 image and prints a JSON report.\n\n"
+        "  --type TYPE        native (default), twl, agb or safe\n"
+        "  --version VER      FIRM content version as found on CTRNAND (default: 0xFFFFFFFF, external FIRM)\n"
+        "  --n3ds             New 3DS FIRM (its arm9bin must already be decrypted)\n"
+        "  --dev              developer unit\n"
+        "  --emunand OFFSET   boot an EmuNAND located at this SD sector\n"
+        "  --no-firmprot      don't apply the FIRM0/1 write protection patch\n"
+        "  --init-sd          the k11 extension has to initialize the SD card\n"
+        "  --unitinfo         apply the UNITINFO patches\n"
+        "  --config VALUE     raw configuration bits (see config.h)\n"
+        "  --sd DIR           load external sysmodules and files from DIR (the /luma directory)\n"
+        "  --luma FILE        Luma3DS boot.firm providing the k11 extension and sysmodules\n"
+        "                     (default: a placeholder k11 extension and no sysmodules)\n"
+        "  --process9 ADDR    the input is a Process9 .code loaded at ADDR: run each Process9 patch on it\n"
+        "  --kernel11         the input is a Kernel11 section\n"
+        "  --runs N           run the pipeline N times and report min/median/max timings\n"
+        "  --no-timing        leave timings out of the report, e.g. to compare it with a golden one\n"
+        "  --dump FILE        write the patched image\n"
+        "  --sha-vectors      check the simulator's SHA-256 against the standard test vectors and exit\n"
+        "  -o FILE            write the report to FILE\n");
+    exit(2);
+}
+
+static void parseArgs(int argc, char **argv)
+{
+    opts.type = NATIVE_FIRM;
+    opts.firmVersion = 0xFFFFFFFF;
+    opts.nandType = FIRMWARE_SYSNAND;
+    opts.firmProt = true;
+    opts.timing = true;
+    opts.runs = 1;
+
+    for(int i = 1; i < argc; i++)
+    {
+        const char *arg = argv[i];
+        const char *value = i + 1 < argc ? argv[i + 1] : NULL;
+        bool hasValue = true;
+
+        if(strcmp(arg, "--type") == 0 && value != NULL)
+        {
+            if(strcmp(value, "native") == 0) opts.type = NATIVE_FIRM;
+            else if(strcmp(value, "twl") == 0) opts.type = TWL_FIRM;
+            else if(strcmp(value, "agb") == 0) opts.type = AGB_FIRM;
+            else if(strcmp(value, "safe") == 0) opts.type = SAFE_FIRM;
+            else usage();
+        }
+        else if(strcmp(arg, "--version") == 0 && value != NULL) opts.firmVersion = strtoul(value, NULL, 0);
+        else if(strcmp(arg, "--emunand") == 0 && value != NULL)
+        {
+            opts.nandType = FIRMWARE_EMUNAND;
+            emuOffset = strtoul(value, NULL, 0);
+        }
+        else if(strcmp(arg, "--config") == 0 && value != NULL) configData.config = strtoul(value, NULL, 0);
+        else if(strcmp(arg, "--sd") == 0 && value != NULL) simStorageDir = value;
+        else if(strcmp(arg, "--luma") == 0 && value != NULL) opts.lumaPath = value;
+        else if(strcmp(arg, "--process9") == 0 && value != NULL)
+        {
+            opts.input = SIM_INPUT_PROCESS9;
+            opts.codeAddr = strtoul(value, NULL, 0);
+        }
+        else if(strcmp(arg, "--runs") == 0 && value != NULL)
+        {
+            opts.runs = strtoul(value, NULL, 0);
+            if(opts.runs == 0 || opts.runs > SIM_MAX_RUNS) usage();
+        }
+        else if(strcmp(arg, "--dump") == 0 && value != NULL) opts.dumpPath = value;
+        else if(strcmp(arg, "-o") == 0 && value != NULL) opts.outPath = value;
+        else
+        {
+            hasValue = false;
+
+            if(strcmp(arg, "--n3ds") == 0) opts.n3ds = true;
+            else if(strcmp(arg, "--dev") == 0) opts.dev = true;
+            else if(strcmp(arg, "--no-firmprot") == 0) opts.firmProt = false;
+            else if(strcmp(arg, "--init-sd") == 0) opts.initSd = true;
+            else if(strcmp(arg, "--unitinfo") == 0) opts.unitinfo = true;
+            else if(strcmp(arg, "--kernel11") == 0) opts.input = SIM_INPUT_KERNEL11;
+            else if(strcmp(arg, "--no-timing") == 0) opts.timing = false;
+            else if(strcmp(arg, "--sha-vectors") == 0) exit(simShaVectors() ? 0 : 1);
+            else if(arg[0] != '-' && opts.inputPath == NULL) opts.inputPath = arg;
+            else usage();
+        }
+
+        if(hasValue) i++;
+    }
+
+    if(opts.inputPath == NULL) usage();
+}
+
+int main(int argc, char **argv)
+{
+    parseArgs(argc, argv);
+    setup();
+
+    FILE *out = stdout;
+    if(opts.outPath != NULL && (out = fopen(opts.outPath, "w")) == NULL) simAbort("unable to open the report file");
+
+    sigjmp_buf runTarget;
+    volatile u32 runsDone = 0, result = 0;
+    volatile bool aborted = false;
+
+    for(currentRun = 0; currentRun < opts.runs; currentRun++)
+    {
+        restoreRegions();
+        nextRecord = 0;
+        abortTarget = &runTarget;
+
+        if(sigsetjmp(runTarget, 1) != 0)
+        {
+            alarm(0);
+            aborted = true;
+            break;
+        }
+
+        alarm(SIM_TIMEOUT_SECS);
+        switch(opts.input)
+        {
+            case SIM_INPUT_FIRM:
+                result = runFirm();
+                break;
+            case SIM_INPUT_PROCESS9:
+                result = runProcess9();
+                break;
+            case SIM_INPUT_KERNEL11:
+                result = runKernel11();
+                break;
+        }
+        alarm(0);
+
+        runsDone++;
+    }
+
+    abortTarget = NULL;
+
+    if(opts.dumpPath != NULL && !aborted)
+    {
+        FILE *f = fopen(opts.dumpPath, "wb");
+        if(f == NULL || fwrite(regions[SIM_REGION_IMAGE].addr, 1, regions[SIM_REGION_IMAGE].size, f) != regions[SIM_REGION_IMAGE].size)
+            simAbort("unable to write the patched image");
+        fclose(f);
+    }
+
+    writeReport(out, runsDone, aborted, result);
+    if(out != stdout) fclose(out);
+
+    return aborted ? 2 : result != 0 ? 1 : 0;
+}
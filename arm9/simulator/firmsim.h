@@ -0,0 +1,43 @@
+/*
+*   This file is part of Luma3DS
+*   Copyright (C) 2016-2020 Aurora Wright, TuxSH
+*
+*   This program is free software: you can redistribute it and/or modify
+*   it under the terms of the GNU General Public License as published by
+*   the Free Software Foundation, either version 3 of the License, or
+*   (at your option) any later version.
+*
+*   This program is distributed in the hope that it will be useful,
+*   but WITHOUT ANY WARRANTY; without even the implied warranty of
+*   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*   GNU General Public License for more details.
+*
+*   You should have received a copy of the GNU General Public License
+*   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*
+*   Additional Terms 7.b and 7.c of GPLv3 apply to this file:
+*       * Requiring preservation of specified reasonable legal notices or
+*         author attributions in that material or in the Appropriate Legal
+*         Notices displayed by works containing it.
+*       * Prohibiting misrepresentation of the origin of that material,
+*         or requiring that modified versions of such material be marked in
+*         reasonable ways as different from the original version.
+*/
+
+#pragma once
+
+// Root of the simulated /luma directory, NULL when loading from storage is disabled
+extern const char *simStorageDir;
+
+// Aborts the current simulation run (error(), crashes, timeouts) with a message for the report
+void simAbort(const char *msg) __attribute__((noreturn));
+
+// SHA-256 engine model (shaengine.c): restarts the hash, processes a 64-byte block, pads the last
+// partial block of the totalSize bytes hashed and writes the big-endian hash
+void simShaEngineReset(void);
+void simShaEngineBlock(const u8 *block);
+void simShaEngineFinal(const u8 *partialBlock, u32 size, u64 totalSize, u8 *hash);
+
+// Checks sha_init/sha_update/sha_final (sha256.c in firmsim, crypto.c in hashsim) against the standard
+// test vectors, see --sha-vectors and hashsim.c
+bool simShaVectors(void);
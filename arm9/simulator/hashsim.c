@@ -0,0 +1,208 @@
+/*
+*   This file is part of Luma3DS
+*   Copyright (C) 2016-2020 Aurora Wright, TuxSH
+*
+*   This program is free software: you can redistribute it and/or modify
+*   it under the terms of the GNU General Public License as published by
+*   the Free Software Foundation, either version 3 of the License, or
+*   (at your option) any later version.
+*
+*   This program is distributed in the hope that it will be useful,
+*   but WITHOUT ANY WARRANTY; without even the implied warranty of
+*   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*   GNU General Public License for more details.
+*
+*   You should have received a copy of the GNU General Public License
+*   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*
+*   Additional Terms 7.b and 7.c of GPLv3 apply to this file:
+*       * Requiring preservation of specified reasonable legal notices or
+*         author attributions in that material or in the Appropriate Legal
+*         Notices displayed by works containing it.
+*       * Prohibiting misrepresentation of the origin of that material,
+*         or requiring that modified versions of such material be marked in
+*         reasonable ways as different from the original version.
+*/
+
+/* FIRM hashing simulator: checks the SHA-256 driver of crypto.c (its buffering of unaligned and
+   partial input, run against the register model of sharegs.c) with the standard test vectors,
+   then runs the section hashing of firm.c (firmHashFeed, checkFirm) on FIRM images
+   that arrive in chunks of many sizes, as fileReadWithProgress and decryptExeFs deliver them.
+   The images have out-of-order, empty and overlapping sections, and corrupted ones must be
+   rejected as soon as the bad section has landed.
+
+   Unlike firmsim, this is built natively: firm.c is included here and everything but its
+   hashing is discarded at link time. The FIRM header has pointers, so its layout isn't the
+   console's here; the images are built with the same structure, which is all the hashing sees. */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/mman.h>
+#include "../source/firm.c"
+#include "firmsim.h"
+
+#define SIM_FIRM_SIZE   0x7000
+
+static u32 numFailures;
+
+#define CHECK(cond) do { if(!(cond)) { printf("    %s:%d: %s: FAILED\n", __FILE__, __LINE__, #cond); numFailures++; } } while(0)
+
+/* What the rest of firm.c needs */
+
+void simAbort(const char *msg)
+{
+    fprintf(stderr, "%s\n", msg);
+    exit(2);
+}
+
+u32 bootTimeBegin(BootPhase phase, const char *name)
+{
+    (void)phase;
+    (void)name;
+    return 0;
+}
+
+void bootTimeEnd(u32 id)
+{
+    (void)id;
+}
+
+/* Images */
+
+// Sections 0 and 1 are out of order, 2 is empty and 3 overlaps 0 (left to checkFirm)
+static const FirmSection layout[4] = {
+    { .offset = 0x4000, .address = (u8 *)0x08006000, .size = 0x3000 },
+    { .offset = 0x200,  .address = (u8 *)0x08010000, .size = 0x1E00 },
+    { 0 },
+    { .offset = 0x4200, .address = (u8 *)0x1FF80000, .size = 0x400 },
+};
+
+static u8 image[SIM_FIRM_SIZE];
+
+static void buildImage(void)
+{
+    Firm *header = (Firm *)image;
+
+    for(u32 i = 0; i < SIM_FIRM_SIZE; i++)
+        image[i] = (u8)(i * 7 + 3);
+
+    memset(header, 0, 0x200);
+    memcpy(header->magic, "FIRM", 4);
+    header->arm9Entry = layout[0].address;
+    memcpy(header->section, layout, sizeof(layout));
+
+    for(u32 i = 0; i < 4; i++)
+    {
+        if(header->section[i].size != 0)
+            sha(header->section[i].hash, image + header->section[i].offset, header->section[i].size, SHA_256_MODE);
+    }
+}
+
+// What the read or decryption loop does: returns the loaded size at which firmHashFeed failed, 0 if it didn't
+static u32 stream(u32 chunkSize)
+{
+    firmHashInit();
+    memset(firm, 0xCC, SIM_FIRM_SIZE);
+
+    for(u32 done = 0; done < SIM_FIRM_SIZE;)
+    {
+        u32 size = SIM_FIRM_SIZE - done < chunkSize ? SIM_FIRM_SIZE - done : chunkSize;
+
+        memcpy((u8 *)firm + done, image + done, size);
+        done += size;
+
+        if(!firmHashFeed(done)) return done;
+    }
+
+    return 0;
+}
+
+/* Checks */
+
+static const u32 chunkSizes[] = { 1, 3, 64, 0x1FF, 0x200, 0x201, 0x3FC, 0x1001, 0x2580, SIM_FIRM_SIZE };
+
+static void checkStreaming(void)
+{
+    printf("Section streaming:\n");
+
+    for(u32 i = 0; i < sizeof(chunkSizes) / sizeof(chunkSizes[0]); i++)
+    {
+        CHECK(stream(chunkSizes[i]) == 0);
+        CHECK(!firmHashState.failed && firmHashState.verifiedSections == 3);
+        CHECK(checkFirm(SIM_FIRM_SIZE));
+    }
+
+    // The sections hashed while loading aren't hashed again, the overlapping one still is
+    stream(0x200);
+    ((u8 *)firm)[0x5000] ^= 1;
+    CHECK(checkFirm(SIM_FIRM_SIZE));
+
+    stream(0x200);
+    ((u8 *)firm)[0x4300] ^= 1;
+    CHECK(!checkFirm(SIM_FIRM_SIZE));
+}
+
+static void checkCorruption(void)
+{
+    printf("Corrupted section:\n");
+
+    // Section 1 ends at 0x2000, before section 0 is loaded
+    image[0x1000] ^= 1;
+    for(u32 i = 0; i < sizeof(chunkSizes) / sizeof(chunkSizes[0]); i++)
+    {
+        u32 failedAt = stream(chunkSizes[i]);
+
+        CHECK(failedAt >= 0x2000 && failedAt < 0x2000 + chunkSizes[i]);
+        CHECK(firmHashState.failed && firmHashState.verifiedSections == 0);
+    }
+    image[0x1000] ^= 1;
+
+    // Section 0 is the last one: section 1 is verified first
+    image[0x6FFF] ^= 1;
+    CHECK(stream(0x1001) == SIM_FIRM_SIZE);
+    CHECK(firmHashState.failed && firmHashState.verifiedSections == 2);
+    image[0x6FFF] ^= 1;
+
+    // Only checkFirm sees the overlapping section
+    ((Firm *)image)->section[3].hash[0] ^= 1;
+    CHECK(stream(0x201) == 0);
+    CHECK(!checkFirm(SIM_FIRM_SIZE));
+    ((Firm *)image)->section[3].hash[0] ^= 1;
+}
+
+static void checkNotFirm(void)
+{
+    printf("Not a FIRM:\n");
+
+    // Encrypted, or not a FIRM at all: nothing is hashed and checkFirm decides
+    memcpy(image, "NCCH", 4);
+    CHECK(stream(0x100) == 0);
+    CHECK(!firmHashState.failed && firmHashState.verifiedSections == 0);
+    CHECK(!checkFirm(SIM_FIRM_SIZE));
+    memcpy(image, "FIRM", 4);
+
+    // Header too short to be complete
+    firmHashInit();
+    memcpy(firm, image, 0x1FF);
+    CHECK(firmHashFeed(0x1FF) && !firmHashState.headerParsed);
+}
+
+int main(void)
+{
+    printf("SHA-256 vectors:\n");
+    if(!simShaVectors()) numFailures++;
+
+    if(mmap((void *)firm, SIM_FIRM_SIZE, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_FIXED_NOREPLACE, -1, 0) != (void *)firm)
+    {
+        perror("mmap");
+        return 2;
+    }
+
+    buildImage();
+    checkStreaming();
+    checkCorruption();
+    checkNotFirm();
+
+    printf(numFailures == 0 ? "ok\n" : "FAILED\n");
+    return numFailures == 0 ? 0 : 1;
+}
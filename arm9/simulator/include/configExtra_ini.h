@@ -0,0 +1,6 @@
+// Normally generated by bin2o from data/configExtra.ini, config.c isn't part of the simulator
+#pragma once
+
+extern const u8 configExtra_ini_end[];
+extern const u8 configExtra_ini[];
+extern const u32 configExtra_ini_size;
@@ -0,0 +1,6 @@
+// Normally generated by bin2o from data/config_template.ini, config.c isn't part of the simulator
+#pragma once
+
+extern const u8 config_template_ini_end[];
+extern const u8 config_template_ini[];
+extern const u32 config_template_ini_size;
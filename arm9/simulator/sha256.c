@@ -0,0 +1,80 @@
+/*
+*   This file is part of Luma3DS
+*   Copyright (C) 2016-2020 Aurora Wright, TuxSH
+*
+*   This program is free software: you can redistribute it and/or modify
+*   it under the terms of the GNU General Public License as published by
+*   the Free Software Foundation, either version 3 of the License, or
+*   (at your option) any later version.
+*
+*   This program is distributed in the hope that it will be useful,
+*   but WITHOUT ANY WARRANTY; without even the implied warranty of
+*   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*   GNU General Public License for more details.
+*
+*   You should have received a copy of the GNU General Public License
+*   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*
+*   Additional Terms 7.b and 7.c of GPLv3 apply to this file:
+*       * Requiring preservation of specified reasonable legal notices or
+*         author attributions in that material or in the Appropriate Legal
+*         Notices displayed by works containing it.
+*       * Prohibiting misrepresentation of the origin of that material,
+*         or requiring that modified versions of such material be marked in
+*         reasonable ways as different from the original version.
+*/
+
+/* Reference SHA-256 replacing the SHA engine driver of crypto.c in firmsim: same sha_init/sha_update/
+   sha_final interface on top of the engine model of shaengine.c, with the same single hash state (the
+   context only holds the pending partial block). */
+
+#include <string.h>
+#include "../source/types.h"
+#include "../source/crypto.h"
+#include "firmsim.h"
+
+void sha_init(ShaContext *ctx, u32 mode)
+{
+    if(mode != SHA_256_MODE) simAbort("only SHA-256 is available in the simulator");
+
+    ctx->mode = mode;
+    ctx->bufferedSize = 0;
+    ctx->totalSize = 0;
+    simShaEngineReset();
+}
+
+void sha_update(ShaContext *ctx, const void *src, u32 size)
+{
+    const u8 *src8 = (const u8 *)src;
+    ctx->totalSize += size;
+
+    while(size != 0)
+    {
+        u32 toCopy = 0x40 - ctx->bufferedSize < size ? 0x40 - ctx->bufferedSize : size;
+
+        memcpy(ctx->buffer + ctx->bufferedSize, src8, toCopy);
+        ctx->bufferedSize += toCopy;
+        src8 += toCopy;
+        size -= toCopy;
+
+        if(ctx->bufferedSize == 0x40)
+        {
+            simShaEngineBlock(ctx->buffer);
+            ctx->bufferedSize = 0;
+        }
+    }
+}
+
+void sha_final(ShaContext *ctx, void *res)
+{
+    simShaEngineFinal(ctx->buffer, ctx->bufferedSize, ctx->totalSize, (u8 *)res);
+}
+
+void sha(void *res, const void *src, u32 size, u32 mode)
+{
+    ShaContext ctx;
+
+    sha_init(&ctx, mode);
+    sha_update(&ctx, src, size);
+    sha_final(&ctx, res);
+}
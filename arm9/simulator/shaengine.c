@@ -0,0 +1,172 @@
+/*
+*   This file is part of Luma3DS
+*   Copyright (C) 2016-2020 Aurora Wright, TuxSH
+*
+*   This program is free software: you can redistribute it and/or modify
+*   it under the terms of the GNU General Public License as published by
+*   the Free Software Foundation, either version 3 of the License, or
+*   (at your option) any later version.
+*
+*   This program is distributed in the hope that it will be useful,
+*   but WITHOUT ANY WARRANTY; without even the implied warranty of
+*   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*   GNU General Public License for more details.
+*
+*   You should have received a copy of the GNU General Public License
+*   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*
+*   Additional Terms 7.b and 7.c of GPLv3 apply to this file:
+*       * Requiring preservation of specified reasonable legal notices or
+*         author attributions in that material or in the Appropriate Legal
+*         Notices displayed by works containing it.
+*       * Prohibiting misrepresentation of the origin of that material,
+*         or requiring that modified versions of such material be marked in
+*         reasonable ways as different from the original version.
+*/
+
+/* SHA-256 engine model: the compression function and the single running state of the console's SHA
+   engine, behind which sha256.c (firmsim) and crypto.c through sharegs.c (hashsim) implement
+   sha_init/sha_update/sha_final. Only SHA-256 is implemented, which is all the FIRM code uses.
+
+   simShaVectors checks whichever of them is linked against the FIPS 180-2 vectors (and the two-block
+   message of the SHA-512 ones, long enough to be fed a whole block at once), hashing each
+   message in many chunk sizes and from unaligned buffers, like the FIRM sections are hashed while
+   they are read or decrypted. */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "../source/types.h"
+#include "../source/crypto.h"
+#include "firmsim.h"
+
+static const u32 k[64] = {
+    0x428A2F98, 0x71374491, 0xB5C0FBCF, 0xE9B5DBA5, 0x3956C25B, 0x59F111F1, 0x923F82A4, 0xAB1C5ED5,
+    0xD807AA98, 0x12835B01, 0x243185BE, 0x550C7DC3, 0x72BE5D74, 0x80DEB1FE, 0x9BDC06A7, 0xC19BF174,
+    0xE49B69C1, 0xEFBE4786, 0x0FC19DC6, 0x240CA1CC, 0x2DE92C6F, 0x4A7484AA, 0x5CB0A9DC, 0x76F988DA,
+    0x983E5152, 0xA831C66D, 0xB00327C8, 0xBF597FC7, 0xC6E00BF3, 0xD5A79147, 0x06CA6351, 0x14292967,
+    0x27B70A85, 0x2E1B2138, 0x4D2C6DFC, 0x53380D13, 0x650A7354, 0x766A0ABB, 0x81C2C92E, 0x92722C85,
+    0xA2BFE8A1, 0xA81A664B, 0xC24B8B70, 0xC76C51A3, 0xD192E819, 0xD6990624, 0xF40E3585, 0x106AA070,
+    0x19A4C116, 0x1E376C08, 0x2748774C, 0x34B0BCB5, 0x391C0CB3, 0x4ED8AA4A, 0x5B9CCA4F, 0x682E6FF3,
+    0x748F82EE, 0x78A5636F, 0x84C87814, 0x8CC70208, 0x90BEFFFA, 0xA4506CEB, 0xBEF9A3F7, 0xC67178F2
+};
+
+// The running state
+static u32 engineState[8];
+
+#define ROR(x, n) (((x) >> (n)) | ((x) << (32 - (n))))
+
+void simShaEngineBlock(const u8 *block)
+{
+    u32 w[64], s[8];
+
+    for(u32 i = 0; i < 16; i++)
+        w[i] = (u32)block[4 * i] << 24 | (u32)block[4 * i + 1] << 16 | (u32)block[4 * i + 2] << 8 | block[4 * i + 3];
+    for(u32 i = 16; i < 64; i++)
+    {
+        u32 s0 = ROR(w[i - 15], 7) ^ ROR(w[i - 15], 18) ^ (w[i - 15] >> 3),
+            s1 = ROR(w[i - 2], 17) ^ ROR(w[i - 2], 19) ^ (w[i - 2] >> 10);
+        w[i] = w[i - 16] + s0 + w[i - 7] + s1;
+    }
+
+    memcpy(s, engineState, sizeof(s));
+    for(u32 i = 0; i < 64; i++)
+    {
+        u32 t1 = s[7] + (ROR(s[4], 6) ^ ROR(s[4], 11) ^ ROR(s[4], 25)) + ((s[4] & s[5]) ^ (~s[4] & s[6])) + k[i] + w[i],
+            t2 = (ROR(s[0], 2) ^ ROR(s[0], 13) ^ ROR(s[0], 22)) + ((s[0] & s[1]) ^ (s[0] & s[2]) ^ (s[1] & s[2]));
+
+        memmove(s + 1, s, 7 * sizeof(u32));
+        s[4] += t1;
+        s[0] = t1 + t2;
+    }
+
+    for(u32 i = 0; i < 8; i++)
+        engineState[i] += s[i];
+}
+
+void simShaEngineReset(void)
+{
+    static const u32 initialState[8] = {
+        0x6A09E667, 0xBB67AE85, 0x3C6EF372, 0xA54FF53A, 0x510E527F, 0x9B05688C, 0x1F83D9AB, 0x5BE0CD19
+    };
+
+    memcpy(engineState, initialState, sizeof(engineState));
+}
+
+void simShaEngineFinal(const u8 *partialBlock, u32 size, u64 totalSize, u8 *hash)
+{
+    u64 bitCount = totalSize * 8;
+    u8 blocks[0x80] = {0};
+    u32 numBlocks = size < 56 ? 1 : 2;
+
+    memcpy(blocks, partialBlock, size);
+    blocks[size] = 0x80;
+    for(u32 i = 0; i < 8; i++)
+        blocks[0x40 * numBlocks - 8 + i] = (u8)(bitCount >> (56 - 8 * i));
+    for(u32 i = 0; i < numBlocks; i++)
+        simShaEngineBlock(blocks + 0x40 * i);
+
+    for(u32 i = 0; i < 8; i++)
+    {
+        hash[4 * i] = (u8)(engineState[i] >> 24);
+        hash[4 * i + 1] = (u8)(engineState[i] >> 16);
+        hash[4 * i + 2] = (u8)(engineState[i] >> 8);
+        hash[4 * i + 3] = (u8)engineState[i];
+    }
+}
+
+static bool checkVector(const char *name, const u8 *msg, u32 size, const char *expectedHex, u32 maxChunkSize)
+{
+    u8 expected[SHA_256_HASH_SIZE], hash[SHA_256_HASH_SIZE];
+    u8 *copy = malloc(size + 4);
+    bool ok = true;
+
+    for(u32 i = 0; i < SHA_256_HASH_SIZE; i++)
+        sscanf(expectedHex + 2 * i, "%2hhx", &expected[i]);
+
+    // All misalignments of the input, for each chunk size
+    for(u32 misalignment = 0; misalignment < 4; misalignment++)
+    {
+        memcpy(copy + misalignment, msg, size);
+
+        for(u32 chunkSize = 1; chunkSize <= maxChunkSize && ok; chunkSize++)
+        {
+            ShaContext ctx;
+
+            sha_init(&ctx, SHA_256_MODE);
+            for(u32 pos = 0; pos < size; pos += chunkSize)
+                sha_update(&ctx, copy + misalignment + pos, size - pos < chunkSize ? size - pos : chunkSize);
+            sha_final(&ctx, hash);
+
+            if(memcmp(hash, expected, sizeof(hash)) != 0)
+            {
+                fprintf(stderr, "%s: mismatch with chunks of %u bytes at misalignment %u\n", name, chunkSize, misalignment);
+                ok = false;
+            }
+        }
+    }
+
+    free(copy);
+    printf("%-20s %s\n", name, ok ? "OK" : "FAILED");
+    return ok;
+}
+
+bool simShaVectors(void)
+{
+    static const char *abc448 = "abcdbcdecdefdefgefghfghighijhijkijkljklmklmnlmnomnopnopq";
+    static const char *abc896 = "abcdefghbcdefghicdefghijdefghijkefghijklfghijklmghijklmnhijklmnoijklmnopjklmnopqklmnopqrlmnopqrsmnopqrstnopqrstu";
+    u32 millionSize = 1000000;
+    u8 *million = malloc(millionSize);
+    bool ok = true;
+
+    memset(million, 'a', millionSize);
+
+    ok &= checkVector("empty", (const u8 *)"", 0, "e3b0c44298fc1c149afbf4c8996fb92427ae41e4649b934ca495991b7852b855", 1);
+    ok &= checkVector("abc", (const u8 *)"abc", 3, "ba7816bf8f01cfea414140de5dae2223b00361a396177a9cb410ff61f20015ad", 3);
+    ok &= checkVector("448 bits", (const u8 *)abc448, strlen(abc448), "248d6a61d20638b8e5c026930c3e6039a33ce45964ff2167f6ecedd419db06c1", 0x80);
+    ok &= checkVector("896 bits", (const u8 *)abc896, strlen(abc896), "cf5b16a778af8380036ce59e7b0492370b249b11e8f07a51afac45037afee9d1", 0x80);
+    ok &= checkVector("one million 'a'", million, millionSize, "cdc76e5c9914fb9281a1c7e284d73e67f1809a48a497200e046d39ccc7112cd0", 5);
+
+    free(million);
+    return ok;
+}
@@ -0,0 +1,137 @@
+/*
+*   This file is part of Luma3DS
+*   Copyright (C) 2016-2020 Aurora Wright, TuxSH
+*
+*   This program is free software: you can redistribute it and/or modify
+*   it under the terms of the GNU General Public License as published by
+*   the Free Software Foundation, either version 3 of the License, or
+*   (at your option) any later version.
+*
+*   This program is distributed in the hope that it will be useful,
+*   but WITHOUT ANY WARRANTY; without even the implied warranty of
+*   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*   GNU General Public License for more details.
+*
+*   You should have received a copy of the GNU General Public License
+*   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*
+*   Additional Terms 7.b and 7.c of GPLv3 apply to this file:
+*       * Requiring preservation of specified reasonable legal notices or
+*         author attributions in that material or in the Appropriate Legal
+*         Notices displayed by works containing it.
+*       * Prohibiting misrepresentation of the origin of that material,
+*         or requiring that modified versions of such material be marked in
+*         reasonable ways as different from the original version.
+*/
+
+/* crypto.c's SHA engine driver (sha_init, sha_update, sha_final), run by hashsim against a model of
+   the SHA register block: the registers are moved to simShaRegs, and the copies to the FIFO and from
+   the hash (alignedseqmemcpy, in assembly on the console) feed the engine model of shaengine.c.
+
+   The model enforces what the engine expects from the driver: word-aligned FIFO input, no more than
+   a block at a time, and nothing written before it has been seen idle: once a block is complete,
+   the control register reads busy once, then idle.
+
+   crypto.c is included here. Its Arm inline assembly is compiled out, and its AES and NAND code is
+   discarded at link time. */
+
+#include <stdio.h>
+#include <stdint.h>
+#include "../source/crypto.h"
+#include "firmsim.h"
+
+static struct
+{
+    u32 cnt;            // as last written by the driver or updated by the engine
+    u32 exposedCnt;     // as last seen by the driver, a write changes it
+    u32 blkcnt;
+    u8 hash[SHA_256_HASH_SIZE];
+    u8 fifo[0x40];
+    u32 fifoSize;
+    u64 totalSize;
+    bool busy;
+} simShaRegs;
+
+// Where the driver copies its input to: only the address matters
+static u32 simShaFifoPort[0x10];
+
+static void simShaSync(void)
+{
+    // What the driver wrote since the last access
+    if(simShaRegs.cnt != simShaRegs.exposedCnt)
+    {
+        if((simShaRegs.cnt & SHA_CNT_MODE) != SHA_256_MODE) simAbort("only SHA-256 is available in the simulator");
+
+        if(simShaRegs.cnt & SHA_NORMAL_ROUND)
+        {
+            simShaEngineReset();
+            simShaRegs.fifoSize = 0;
+            simShaRegs.totalSize = 0;
+            simShaRegs.busy = false;
+        }
+
+        if(simShaRegs.cnt & SHA_FINAL_ROUND)
+        {
+            u8 hash[SHA_256_HASH_SIZE];
+
+            simShaEngineFinal(simShaRegs.fifo, simShaRegs.fifoSize, simShaRegs.totalSize, hash);
+            for(u32 i = 0; i < SHA_256_HASH_SIZE; i++)
+                simShaRegs.hash[i] = (simShaRegs.cnt & SHA_CNT_OUTPUT_ENDIAN) ? hash[i] : hash[(i & ~3) + 3 - (i & 3)];
+            simShaRegs.fifoSize = 0;
+        }
+
+        simShaRegs.cnt &= ~SHA_CNT_STATE;
+    }
+    // Seen busy by this access, done by the next one
+    else if(simShaRegs.busy)
+        simShaRegs.busy = false;
+    else
+        simShaRegs.cnt &= ~SHA_NORMAL_ROUND;
+
+    simShaRegs.exposedCnt = simShaRegs.cnt;
+}
+
+static vu32 *simShaCnt(void)
+{
+    simShaSync();
+    return &simShaRegs.cnt;
+}
+
+#undef REG_SHA_CNT
+#undef REG_SHA_BLKCNT
+#undef REG_SHA_HASH
+#undef REG_SHA_INFIFO
+#define REG_SHA_CNT     (simShaCnt())
+#define REG_SHA_BLKCNT  ((vu32 *)&simShaRegs.blkcnt)
+#define REG_SHA_HASH    ((vu32 *)simShaRegs.hash)
+#define REG_SHA_INFIFO  ((vu32 *)simShaFifoPort)
+
+void *alignedseqmemcpy(void *dst, const void *src, u32 len)
+{
+    if(dst == (void *)simShaFifoPort)
+    {
+        if(((uintptr_t)src & 3) != 0) simAbort("unaligned SHA FIFO input");
+        if(simShaRegs.cnt & SHA_NORMAL_ROUND) simAbort("SHA FIFO written while the engine is busy");
+        if(simShaRegs.fifoSize + len > sizeof(simShaRegs.fifo)) simAbort("SHA FIFO overflow");
+
+        memcpy(simShaRegs.fifo + simShaRegs.fifoSize, src, len);
+        simShaRegs.fifoSize += len;
+        simShaRegs.totalSize += len;
+
+        if(simShaRegs.fifoSize == sizeof(simShaRegs.fifo))
+        {
+            simShaEngineBlock(simShaRegs.fifo);
+            simShaRegs.fifoSize = 0;
+            simShaRegs.busy = true;
+            simShaRegs.cnt |= SHA_NORMAL_ROUND;
+            simShaRegs.exposedCnt = simShaRegs.cnt;
+        }
+
+        return dst;
+    }
+
+    return memcpy(dst, src, len);
+}
+
+#define __asm__(...)
+#include "../source/crypto.c"
@@ -0,0 +1,39 @@
+/*
+*   This file is part of Luma3DS
+*   Copyright (C) 2016-2020 Aurora Wright, TuxSH
+*
+*   This program is free software: you can redistribute it and/or modify
+*   it under the terms of the GNU General Public License as published by
+*   the Free Software Foundation, either version 3 of the License, or
+*   (at your option) any later version.
+*
+*   This program is distributed in the hope that it will be useful,
+*   but WITHOUT ANY WARRANTY; without even the implied warranty of
+*   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*   GNU General Public License for more details.
+*
+*   You should have received a copy of the GNU General Public License
+*   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*
+*   Additional Terms 7.b and 7.c of GPLv3 apply to this file:
+*       * Requiring preservation of specified reasonable legal notices or
+*         author attributions in that material or in the Appropriate Legal
+*         Notices displayed by works containing it.
+*       * Prohibiting misrepresentation of the origin of that material,
+*         or requiring that modified versions of such material be marked in
+*         reasonable ways as different from the original version.
+*/
+
+#pragma once
+
+/* Included before every source file of the FIRM simulator (see the Makefile).
+
+   The simulator runs the Arm9 FIRM patching code (firm.c, patches.c, emunand.c, memory.c)
+   unmodified on a Linux host, against the stubs in stubs.c. The Arm9 code assumes 32-bit
+   pointers, hence the -m32 build, and fixed addresses: FCRAM, VRAM and the MMIO registers it
+   reads are mapped at their console addresses by firmsim.c. */
+
+// Also records what each patch function returned
+#define BOOTTIME_PATCH(call) ({ u32 record_ = bootTimeBegin(BOOTPHASE_PATCH, #call); u32 res_ = (call); bootTimeEnd(record_); simRecordResult(record_, res_); res_; })
+
+void simRecordResult(unsigned int record, unsigned int result);
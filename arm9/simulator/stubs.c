@@ -0,0 +1,247 @@
+/*
+*   This file is part of Luma3DS
+*   Copyright (C) 2016-2020 Aurora Wright, TuxSH
+*
+*   This program is free software: you can redistribute it and/or modify
+*   it under the terms of the GNU General Public License as published by
+*   the Free Software Foundation, either version 3 of the License, or
+*   (at your option) any later version.
+*
+*   This program is distributed in the hope that it will be useful,
+*   but WITHOUT ANY WARRANTY; without even the implied warranty of
+*   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*   GNU General Public License for more details.
+*
+*   You should have received a copy of the GNU General Public License
+*   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*
+*   Additional Terms 7.b and 7.c of GPLv3 apply to this file:
+*       * Requiring preservation of specified reasonable legal notices or
+*         author attributions in that material or in the Appropriate Legal
+*         Notices displayed by works containing it.
+*       * Prohibiting misrepresentation of the origin of that material,
+*         or requiring that modified versions of such material be marked in
+*         reasonable ways as different from the original version.
+*/
+
+/* Everything the patching code links against, besides the patch functions themselves:
+   storage, crypto, screens and chainloading either aren't needed to patch an already
+   decrypted FIRM or abort the simulation. */
+
+#include <stdarg.h>
+#include <string.h>
+#include "../source/types.h"
+#include "../source/config.h"
+#include "../source/crypto.h"
+#include "../source/fs.h"
+#include "../source/screen.h"
+#include "../source/utils.h"
+#include "../source/chainloader.h"
+#include "../source/boottime.h"
+#include "../source/arm9_exception_handlers.h"
+#include "../source/fatfs/sdmmc/sdmmc.h"
+#include "../source/fatfs/diskcache.h"
+#include "firmsim.h"
+
+CfgData configData;
+bool isSdMode = true;
+char launchedPathForFatfs[256];
+u16 launchedPath[80+1];
+u32 arm9ExceptionHandlerSvcBreakAddress;
+struct fb fbs[2];
+
+/* Placeholders for the Arm code of large_patches.s and emunand_patch.s, which only devkitARM
+   can assemble. The variables the patch functions fill in are laid out as in the real code,
+   so they end up at the right place in the patched Process9. */
+__asm__(
+    "    .data\n"
+    "    .balign 16\n"
+    "    .global rebootPatch, rebootPatchFopenPtr, rebootPatchFileName, rebootPatchSize\n"
+    "rebootPatch:\n"
+    "    .fill 0xF4, 1, 0\n"
+    "rebootPatchFopenPtr:\n"
+    "    .long 0\n"
+    "    .fill 0x1C, 1, 0\n"
+    "rebootPatchFileName:\n"
+    "    .fill 2 * (80 + 1), 1, 0\n"
+    "    .balign 4\n"
+    "    .fill 0x6C, 1, 0\n"
+    "rebootPatchEnd:\n"
+    "rebootPatchSize:\n"
+    "    .long rebootPatchEnd - rebootPatch\n"
+    "\n"
+    "    .balign 16\n"
+    "    .global readFileSHA256Vtab11Patch, readFileSHA256Vtab11PatchSize\n"
+    "    .global readFileSHA256Vtab11PatchCtorPtr, readFileSHA256Vtab11PatchInitPtr, readFileSHA256Vtab11PatchProcessPtr\n"
+    "readFileSHA256Vtab11Patch:\n"
+    "    .fill 0x50, 1, 0\n"
+    "readFileSHA256Vtab11PatchCtorPtr:\n"
+    "    .long 0\n"
+    "readFileSHA256Vtab11PatchInitPtr:\n"
+    "    .long 0\n"
+    "readFileSHA256Vtab11PatchProcessPtr:\n"
+    "    .long 0\n"
+    "readFileSHA256Vtab11PatchEnd:\n"
+    "readFileSHA256Vtab11PatchSize:\n"
+    "    .long readFileSHA256Vtab11PatchEnd - readFileSHA256Vtab11Patch\n"
+    "\n"
+    "    .balign 16\n"
+    "    .global emunandPatch, emunandPatchSize\n"
+    "    .global emunandPatchSdmmcStructPtr, emunandPatchNandOffset, emunandPatchNcsdHeaderOffset\n"
+    "emunandPatch:\n"
+    "    .fill 0x2C, 1, 0\n"
+    "emunandPatchSdmmcStructPtr:\n"
+    "    .long 0\n"
+    "emunandPatchNandOffset:\n"
+    "    .long 0\n"
+    "emunandPatchNcsdHeaderOffset:\n"
+    "    .long 0\n"
+    "emunandPatchEnd:\n"
+    "emunandPatchSize:\n"
+    "    .long emunandPatchEnd - emunandPatch\n"
+    "    .text\n"
+);
+
+void error(const char *fmt, ...)
+{
+    char buf[256];
+    va_list args;
+
+    va_start(args, fmt);
+    vsnprintf(buf, sizeof(buf), fmt, args);
+    va_end(args);
+
+    simAbort(buf);
+}
+
+// The files the patching code looks for (sysmodules, twl_upscaling_filter.bin) are read from --sd
+u32 fileRead(void *dest, const char *path, u32 maxSize)
+{
+    char hostPath[512];
+    u32 ret = 0;
+
+    if(simStorageDir == NULL) return 0;
+    snprintf(hostPath, sizeof(hostPath), "%s/%s", simStorageDir, path);
+
+    FILE *f = fopen(hostPath, "rb");
+    if(f == NULL) return 0;
+
+    fseek(f, 0, SEEK_END);
+    u32 size = (u32)ftell(f);
+    fseek(f, 0, SEEK_SET);
+
+    if(dest == NULL) ret = size;
+    else if(size <= maxSize && fread(dest, 1, size, f) == size) ret = size;
+
+    fclose(f);
+    return ret;
+}
+
+u32 fileReadWithProgress(void *dest, const char *path, u32 maxSize, bool (*onProgress)(u32 readSize))
+{
+    u32 size = fileRead(dest, path, maxSize);
+
+    // Same chunks as fs.c
+    for(u32 done = 0; dest != NULL && onProgress != NULL && done < size;)
+    {
+        done = size - done < 0x40000 ? size : done + 0x40000;
+        if(!onProgress(done)) return 0;
+    }
+
+    return size;
+}
+
+u32 getFileSize(const char *path)
+{
+    return fileRead(NULL, path, 0);
+}
+
+// The input N3DS FIRM must have its arm9bin decrypted already
+void kernel9Loader(Arm9Bin *arm9Section)
+{
+    (void)arm9Section;
+}
+
+u32 firmRead(void *dest, u32 firmType)
+{
+    (void)dest;
+    (void)firmType;
+    return 0xFFFFFFFF;
+}
+
+bool remountCtrNandPartition(bool switchMainDir)
+{
+    (void)switchMainDir;
+    return false;
+}
+
+bool findPayload(char *path, u32 pressed)
+{
+    (void)path;
+    (void)pressed;
+    return false;
+}
+
+bool payloadMenu(char *path, bool *hasDisplayedMenu)
+{
+    (void)path;
+    (void)hasDisplayedMenu;
+    return false;
+}
+
+u32 decryptExeFs(Cxi *cxi, bool (*onDecrypted)(u32 decryptedSize))
+{
+    (void)cxi;
+    (void)onDecrypted;
+    simAbort("decryptExeFs is not available in the simulator");
+}
+
+u32 decryptNusFirm(const Ticket *ticket, Cxi *cxi, u32 ncchSize, bool (*onDecrypted)(u32 decryptedSize))
+{
+    (void)ticket;
+    (void)cxi;
+    (void)ncchSize;
+    (void)onDecrypted;
+    simAbort("decryptNusFirm is not available in the simulator");
+}
+
+void initScreens(void)
+{
+}
+
+void prepareArm11ForFirmlaunch(void)
+{
+}
+
+void bootTimeFlush(u32 firmType, FirmwareSource nandType)
+{
+    (void)firmType;
+    (void)nandType;
+}
+
+void chainload(int argc, char **argv, Firm *firm)
+{
+    (void)argc;
+    (void)argv;
+    (void)firm;
+    simAbort("chainload is not available in the simulator");
+}
+
+mmcdevice *getMMCDevice(int drive)
+{
+    (void)drive;
+    return NULL;
+}
+
+int sdmmc_sdcard_readsectors(u32 sector_no, u32 numsectors, u8 *out)
+{
+    (void)sector_no;
+    (void)numsectors;
+    (void)out;
+    return 1;
+}
+
+void diskCacheInvalidate(u32 drive)
+{
+    (void)drive;
+}
@@ -0,0 +1,136 @@
+/*
+*   This file is part of Luma3DS
+*   Copyright (C) 2016-2020 Aurora Wright, TuxSH
+*
+*   This program is free software: you can redistribute it and/or modify
+*   it under the terms of the GNU General Public License as published by
+*   the Free Software Foundation, either version 3 of the License, or
+*   (at your option) any later version.
+*
+*   This program is distributed in the hope that it will be useful,
+*   but WITHOUT ANY WARRANTY; without even the implied warranty of
+*   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*   GNU General Public License for more details.
+*
+*   You should have received a copy of the GNU General Public License
+*   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*
+*   Additional Terms 7.b and 7.c of GPLv3 apply to this file:
+*       * Requiring preservation of specified reasonable legal notices or
+*         author attributions in that material or in the Appropriate Legal
+*         Notices displayed by works containing it.
+*       * Prohibiting misrepresentation of the origin of that material,
+*         or requiring that modified versions of such material be marked in
+*         reasonable ways as different from the original version.
+*/
+
+#include "boottime.h"
+#include "memory.h"
+#include "utils.h"
+#include "config.h"
+#include "fatfs/ff.h"
+
+static BootTimeSlot currentBoot;
+static BootTimeLaunch previousLaunch;
+
+void bootTimeInit(void)
+{
+    // Must be called before the ITCM sections are set up again
+    previousLaunch = bootTimeLaunch;
+    startChrono();
+}
+
+u32 bootTimeBegin(BootPhase phase, const char *name)
+{
+    if(currentBoot.numRecords == BOOTTIME_MAX_RECORDS)
+    {
+        currentBoot.numDropped++;
+        return BOOTTIME_MAX_RECORDS;
+    }
+
+    BootTimeRecord *record = &currentBoot.records[currentBoot.numRecords];
+
+    record->phase = (u8)phase;
+    record->start = (u32)chronoTicks();
+    record->duration = BOOTTIME_UNKNOWN;
+
+    if(name != NULL)
+    {
+        if(strncmp(name, "patch", 5) == 0) name += 5;
+
+        u32 i;
+        for(i = 0; i < sizeof(record->name) - 1 && name[i] != 0 && name[i] != '('; i++)
+            record->name[i] = name[i];
+        record->name[i] = 0;
+    }
+
+    return currentBoot.numRecords++;
+}
+
+void bootTimeEnd(u32 record)
+{
+    if(record < currentBoot.numRecords)
+        currentBoot.records[record].duration = (u32)chronoTicks() - currentBoot.records[record].start;
+}
+
+static bool writeAt(FIL *file, u32 offset, const void *buffer, u32 size)
+{
+    unsigned int written;
+    return f_lseek(file, offset) == FR_OK && f_write(file, buffer, size, &written) == FR_OK && written == size;
+}
+
+void bootTimeFlush(u32 firmType, FirmwareSource nandType)
+{
+    FIL file;
+    BootTimeFileHeader header;
+    unsigned int read;
+
+    // Never written to CTRNAND
+    if(!CONFIG(BOOTTIMELOG) || !isSdMode) return;
+
+    if(f_open(&file, BOOTTIME_PATH, FA_READ | FA_WRITE | FA_OPEN_ALWAYS) != FR_OK) return;
+
+    if(f_read(&file, &header, sizeof(header), &read) != FR_OK || read != sizeof(header) || header.magic != BOOTTIME_MAGIC ||
+       header.version != BOOTTIME_VERSION || header.numSlots != BOOTTIME_NUM_SLOTS || header.nextSlot >= BOOTTIME_NUM_SLOTS)
+    {
+        memset(&header, 0, sizeof(header));
+        header.magic = BOOTTIME_MAGIC;
+        header.version = BOOTTIME_VERSION;
+        header.numSlots = BOOTTIME_NUM_SLOTS;
+        f_lseek(&file, 0);
+        f_truncate(&file);
+    }
+
+    header.ticksPerSec = (u32)TICKS_PER_SEC;
+
+    // Complete the previous boot with the duration of its section copy, if it's still the last one in the file
+    if(previousLaunch.magic == BOOTTIME_LAUNCH_MAGIC && previousLaunch.sequence == header.sequence &&
+       previousLaunch.slot < BOOTTIME_NUM_SLOTS && previousLaunch.record < BOOTTIME_MAX_RECORDS)
+        writeAt(&file, sizeof(header) + previousLaunch.slot * sizeof(BootTimeSlot) + offsetof(BootTimeSlot, records) +
+                       previousLaunch.record * sizeof(BootTimeRecord) + offsetof(BootTimeRecord, duration),
+                &previousLaunch.ticks, sizeof(previousLaunch.ticks));
+
+    u32 copyRecord = bootTimeBegin(BOOTPHASE_SECTION_COPY, NULL),
+        slot = header.nextSlot;
+
+    currentBoot.sequence = header.sequence + 1 != 0 ? header.sequence + 1 : 1;
+    currentBoot.firmType = (u8)firmType;
+    currentBoot.nandType = (u8)nandType;
+    currentBoot.bootType = (u8)bootType;
+    currentBoot.totalTicks = (u32)chronoTicks();
+
+    header.sequence = currentBoot.sequence;
+    header.nextSlot = (slot + 1) % BOOTTIME_NUM_SLOTS;
+
+    bool ok = writeAt(&file, sizeof(header) + slot * sizeof(BootTimeSlot), &currentBoot, sizeof(currentBoot)) &&
+              writeAt(&file, 0, &header, sizeof(header));
+
+    if(f_close(&file) == FR_OK && ok && copyRecord < BOOTTIME_MAX_RECORDS)
+    {
+        bootTimeLaunch.sequence = currentBoot.sequence;
+        bootTimeLaunch.slot = slot;
+        bootTimeLaunch.record = copyRecord;
+        bootTimeLaunch.ticks = BOOTTIME_UNKNOWN;
+        bootTimeLaunch.magic = BOOTTIME_LAUNCH_MAGIC;
+    }
+}
@@ -0,0 +1,118 @@
+/*
+*   This file is part of Luma3DS
+*   Copyright (C) 2016-2020 Aurora Wright, TuxSH
+*
+*   This program is free software: you can redistribute it and/or modify
+*   it under the terms of the GNU General Public License as published by
+*   the Free Software Foundation, either version 3 of the License, or
+*   (at your option) any later version.
+*
+*   This program is distributed in the hope that it will be useful,
+*   but WITHOUT ANY WARRANTY; without even the implied warranty of
+*   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*   GNU General Public License for more details.
+*
+*   You should have received a copy of the GNU General Public License
+*   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*
+*   Additional Terms 7.b and 7.c of GPLv3 apply to this file:
+*       * Requiring preservation of specified reasonable legal notices or
+*         author attributions in that material or in the Appropriate Legal
+*         Notices displayed by works containing it.
+*       * Prohibiting misrepresentation of the origin of that material,
+*         or requiring that modified versions of such material be marked in
+*         reasonable ways as different from the original version.
+*/
+
+#pragma once
+
+#include "types.h"
+
+/* Boot timeline, recorded with the Arm9 timers (see startChrono) and appended to a
+   fixed ring of per-boot slots in /luma/boottime.bin right before the partitions are
+   unmounted, or before a payload is chainloaded. The final FIRM section copy runs from
+   ITCM after that point: the chainloader keeps its duration there and it is written to
+   the slot of the previous boot on the next one, if ITCM has survived the reboot. See
+   tools/boottime.py. The log is only written when enabled in the configuration, and only to
+   the SD card.
+
+   All the times are in raw timer ticks (ticksPerSec in the header), the only unit the
+   chainloader has; only their low 32 bits are kept, so they wrap after about 64 seconds. */
+
+#define BOOTTIME_PATH           "boottime.bin"
+#define BOOTTIME_MAGIC          0x454D4954 // 'TIME'
+#define BOOTTIME_VERSION        1
+#define BOOTTIME_NUM_SLOTS      32
+#define BOOTTIME_MAX_RECORDS    48
+#define BOOTTIME_LAUNCH_MAGIC   0x48434E4C // 'LNCH'
+#define BOOTTIME_UNKNOWN        0xFFFFFFFF
+#define BOOTTIME_FIRM_PAYLOAD   0xFF       // firmType of a chainloaded payload
+
+typedef enum BootPhase
+{
+    BOOTPHASE_STORAGE_MOUNT = 0,
+    BOOTPHASE_CONFIG_READ,
+    BOOTPHASE_EMUNAND_LOCATE,
+    BOOTPHASE_SPLASH,
+    BOOTPHASE_FIRM_READ,
+    BOOTPHASE_EXEFS_DECRYPT,
+    BOOTPHASE_FIRM_CHECK,
+    BOOTPHASE_ARM9BIN_DECRYPT,
+    BOOTPHASE_PATCH,
+    BOOTPHASE_MODULES,
+    BOOTPHASE_SECTION_COPY,
+} BootPhase;
+
+typedef struct BootTimeRecord
+{
+    u8 phase;
+    u8 reserved[3];
+    u32 start;      // timer ticks since the start of main
+    u32 duration;   // timer ticks, BOOTTIME_UNKNOWN if it couldn't be recorded
+    char name[20];  // e.g. the patch function, without its "patch" prefix
+} BootTimeRecord;
+
+typedef struct BootTimeSlot
+{
+    u32 sequence;   // 0 for an unused slot
+    u8 firmType;
+    u8 nandType;
+    u8 bootType;
+    u8 numRecords;
+    u32 totalTicks; // until the log was written
+    u32 numDropped;
+    BootTimeRecord records[BOOTTIME_MAX_RECORDS];
+} BootTimeSlot;
+
+typedef struct BootTimeFileHeader
+{
+    u32 magic;
+    u16 version;
+    u16 numSlots;
+    u32 ticksPerSec;
+    u32 sequence;   // of the last boot written
+    u32 nextSlot;
+    u32 reserved[3];
+} BootTimeFileHeader;
+
+// Filled by the chainloader in ITCM, read on the next boot
+typedef struct BootTimeLaunch
+{
+    u32 magic;
+    u32 sequence;
+    u32 slot;
+    u32 record;
+    u32 ticks;
+} BootTimeLaunch;
+
+extern BootTimeLaunch bootTimeLaunch;
+
+void bootTimeInit(void);
+u32 bootTimeBegin(BootPhase phase, const char *name);
+void bootTimeEnd(u32 record);
+void bootTimeFlush(u32 firmType, FirmwareSource nandType); // firmType: a FirmwareType or BOOTTIME_FIRM_PAYLOAD
+
+// Times a patch* call and returns its result. The FIRM simulator provides its own, to also record the result
+#ifndef BOOTTIME_PATCH
+#define BOOTTIME_PATCH(call) ({ u32 record_ = bootTimeBegin(BOOTPHASE_PATCH, #call); u32 res_ = (call); bootTimeEnd(record_); res_; })
+#endif
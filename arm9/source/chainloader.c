@@ -26,29 +26,67 @@
 
 #include "chainloader.h"
 #include "screen.h"
+#include "boottime.h"
+#include "utils.h"
 
 void disableMpuAndJumpToEntrypoints(int argc, char **argv, void *arm11Entry, void *arm9Entry);
 
+BootTimeLaunch bootTimeLaunch;
+
 #pragma GCC optimize (3)
 
-static void *xmemcpy(void *dst, const void *src, u32 len)
+// Everything outside of ITCM may be overwritten from here on, this must not become a memcpy call
+static __attribute__((optimize("no-tree-loop-distribute-patterns"))) void *xmemcpy(void *dst, const void *src, u32 len)
 {
-    const u8 *src8 = (const u8 *)src;
-    u8 *dst8 = (u8 *)dst;
+    //FIRM sections are always word-aligned
+    if((((u32)dst | (u32)src | len) & 3) == 0)
+    {
+        const u32 *src32 = (const u32 *)src;
+        u32 *dst32 = (u32 *)dst;
 
-    for (u32 i = 0; i < len; i++) {
-        dst8[i] = src8[i];
+        for (u32 i = 0; i < len / 4; i++) {
+            dst32[i] = src32[i];
+        }
+    }
+    else
+    {
+        const u8 *src8 = (const u8 *)src;
+        u8 *dst8 = (u8 *)dst;
+
+        for (u32 i = 0; i < len; i++) {
+            dst8[i] = src8[i];
+        }
     }
 
     return dst;
 }
 
+// Low 32 bits of the chained timers started by startChrono
+static u32 readTimer(void)
+{
+    u16 hi, lo;
+
+    do
+    {
+        hi = REG_TIMER_VAL(1);
+        lo = REG_TIMER_VAL(0);
+    }
+    while(hi != REG_TIMER_VAL(1));
+
+    return ((u32)hi << 16) | lo;
+}
+
 static void doLaunchFirm(Firm *firm, int argc, char **argv)
 {
+    u32 copyStart = readTimer();
+
     //Copy FIRM sections to respective memory locations
     for(u32 sectionNum = 0; sectionNum < 4; sectionNum++)
         xmemcpy(firm->section[sectionNum].address, (u8 *)firm + firm->section[sectionNum].offset, firm->section[sectionNum].size);
 
+    if(bootTimeLaunch.magic == BOOTTIME_LAUNCH_MAGIC)
+        bootTimeLaunch.ticks = readTimer() - copyStart;
+
     disableMpuAndJumpToEntrypoints(argc, argv, firm->arm9Entry, firm->arm11Entry);
 
     __builtin_unreachable();
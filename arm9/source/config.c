@@ -77,6 +77,7 @@ static const char *singleOptionIniNamesBoot[] = {
 static const char *singleOptionIniNamesMisc[] = {
     "show_advanced_settings",
     "patch_hardware_crypto",
+    "enable_boot_time_log",
 };
 
 static const char *keyNames[] = {
@@ -696,7 +697,8 @@ static size_t saveLumaIniConfigToStr(char *out)
         cfg->volumeSliderOverride,
         
         (int)CONFIG(SHOWADVANCEDSETTINGS),
-        (int)CONFIG(HARDWAREPATCHING)
+        (int)CONFIG(HARDWAREPATCHING),
+        (int)CONFIG(BOOTTIMELOG)
     );
 
     return n < 0 ? 0 : (size_t)n;
@@ -78,6 +78,7 @@ enum singleOptions
     NOERRDISPINSTANTREBOOT,
     SHOWADVANCEDSETTINGS,
     HARDWAREPATCHING,
+    BOOTTIMELOG,
 };
 
 typedef enum ConfigurationStatus
@@ -285,23 +285,65 @@ static void sha_wait_idle()
     while(*REG_SHA_CNT & 1);
 }
 
-void sha(void *res, const void *src, u32 size, u32 mode)
+void sha_init(ShaContext *ctx, u32 mode)
 {
+    ctx->mode = mode;
+    ctx->bufferedSize = 0;
+    ctx->totalSize = 0;
+
     sha_wait_idle();
     *REG_SHA_CNT = mode | SHA_CNT_OUTPUT_ENDIAN | SHA_NORMAL_ROUND;
+}
 
+void sha_update(ShaContext *ctx, const void *src, u32 size)
+{
     const u8 *src8 = (const u8 *)src;
+    ctx->totalSize += size;
+
+    //Complete the pending block first
+    if(ctx->bufferedSize != 0)
+    {
+        u32 toCopy = 0x40 - ctx->bufferedSize;
+        if(toCopy > size) toCopy = size;
+
+        memcpy(ctx->buffer + ctx->bufferedSize, src8, toCopy);
+        ctx->bufferedSize += toCopy;
+        src8 += toCopy;
+        size -= toCopy;
+
+        if(ctx->bufferedSize < 0x40) return;
+
+        sha_wait_idle();
+        alignedseqmemcpy((void *)REG_SHA_INFIFO, ctx->buffer, 0x40);
+        ctx->bufferedSize = 0;
+    }
+
+    //The FIFO is fed with word copies, unaligned input goes through the context buffer
+    bool aligned = ((u32)src8 & 3) == 0;
     while(size >= 0x40)
     {
+        const void *block = src8;
+        if(!aligned)
+        {
+            memcpy(ctx->buffer, src8, 0x40);
+            block = ctx->buffer;
+        }
+
         sha_wait_idle();
-        alignedseqmemcpy((void *)REG_SHA_INFIFO, src8, 0x40);
+        alignedseqmemcpy((void *)REG_SHA_INFIFO, block, 0x40);
 
         src8 += 0x40;
         size -= 0x40;
     }
 
+    memcpy(ctx->buffer, src8, size);
+    ctx->bufferedSize = size;
+}
+
+void sha_final(ShaContext *ctx, void *res)
+{
     sha_wait_idle();
-    alignedseqmemcpy((void *)REG_SHA_INFIFO, src8, size);
+    alignedseqmemcpy((void *)REG_SHA_INFIFO, ctx->buffer, ctx->bufferedSize);
 
     *REG_SHA_CNT = (*REG_SHA_CNT & ~SHA_NORMAL_ROUND) | SHA_FINAL_ROUND;
 
@@ -309,14 +351,23 @@ void sha(void *res, const void *src, u32 size, u32 mode)
     sha_wait_idle();
 
     u32 hashSize = SHA_256_HASH_SIZE;
-    if(mode == SHA_224_MODE)
+    if(ctx->mode == SHA_224_MODE)
         hashSize = SHA_224_HASH_SIZE;
-    else if(mode == SHA_1_MODE)
+    else if(ctx->mode == SHA_1_MODE)
         hashSize = SHA_1_HASH_SIZE;
 
     alignedseqmemcpy(res, (void *)REG_SHA_HASH, hashSize);
 }
 
+void sha(void *res, const void *src, u32 size, u32 mode)
+{
+    ShaContext ctx;
+
+    sha_init(&ctx, mode);
+    sha_update(&ctx, src, size);
+    sha_final(&ctx, res);
+}
+
 /*****************************************************************/
 
 __attribute__((aligned(4))) static u8 nandCtr[AES_BLOCK_SIZE];
@@ -426,7 +477,7 @@ int ctrNandWrite(u32 sector, u32 sectorCount, const u8 *inbuf)
     return result;
 }
 
-u32 decryptExeFs(Cxi *cxi)
+u32 decryptExeFs(Cxi *cxi, bool (*onDecrypted)(u32 decryptedSize))
 {
     if(memcmp(cxi->ncch.magic, "NCCH", 4) != 0) return 0;
 
@@ -446,12 +497,23 @@ u32 decryptExeFs(Cxi *cxi)
     aes_setkey(0x2C, cxi, AES_KEYY, AES_INPUT_BE | AES_INPUT_NORMAL);
     aes_advctr(ncchCtr, 0x200 / AES_BLOCK_SIZE, AES_INPUT_BE | AES_INPUT_NORMAL);
     aes_use_keyslot(0x2C);
-    aes(cxi, exeFsOffset, exeFsSize / AES_BLOCK_SIZE, ncchCtr, AES_CTR_MODE, AES_INPUT_BE | AES_INPUT_NORMAL);
+
+    //Decrypt in chunks so that the caller can work on the decrypted data (e.g. hash it) while it's still cached.
+    //aes() advances the counter
+    for(u32 done = 0; done < exeFsSize;)
+    {
+        u32 chunkSize = exeFsSize - done < 0x20000 ? exeFsSize - done : 0x20000;
+
+        aes((u8 *)cxi + done, exeFsOffset + done, chunkSize / AES_BLOCK_SIZE, ncchCtr, AES_CTR_MODE, AES_INPUT_BE | AES_INPUT_NORMAL);
+        done += chunkSize;
+
+        if(onDecrypted != NULL && !onDecrypted(done)) return 0;
+    }
 
     return memcmp(cxi, "FIRM", 4) == 0 ? exeFsSize : 0;
 }
 
-u32 decryptNusFirm(const Ticket *ticket, Cxi *cxi, u32 ncchSize)
+u32 decryptNusFirm(const Ticket *ticket, Cxi *cxi, u32 ncchSize, bool (*onDecrypted)(u32 decryptedSize))
 {
     if(memcmp(ticket->sigIssuer, "Root", 4) != 0) return 0;
 
@@ -471,7 +533,7 @@ u32 decryptNusFirm(const Ticket *ticket, Cxi *cxi, u32 ncchSize)
     aes_use_keyslot(0x16);
     aes(cxi, cxi, ncchSize / AES_BLOCK_SIZE, ncchIv, AES_CBC_DECRYPT_MODE, AES_INPUT_BE | AES_INPUT_NORMAL);
 
-    return decryptExeFs(cxi);
+    return decryptExeFs(cxi, onDecrypted);
 }
 
 static inline void twlConsoleInfoInit(void)
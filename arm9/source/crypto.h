@@ -113,16 +113,31 @@
 #define SHA_224_HASH_SIZE   (224 / 8)
 #define SHA_1_HASH_SIZE     (160 / 8)
 
+//Incremental hashing. The engine holds the running state, so only one hash can be in progress at a time:
+//the context only keeps the input that doesn't fill a block yet
+typedef struct ShaContext
+{
+    u32 mode;
+    u32 bufferedSize;
+    u32 totalSize;
+    __attribute__((aligned(4))) u8 buffer[0x40];
+} ShaContext;
+
 extern FirmwareSource ctrNandLocation;
 extern bool nandcid;
 
 void sha(void *res, const void *src, u32 size, u32 mode);
+void sha_init(ShaContext *ctx, u32 mode);
+void sha_update(ShaContext *ctx, const void *src, u32 size);
+void sha_final(ShaContext *ctx, void *res);
 
 int ctrNandInit(void);
 int ctrNandRead(u32 sector, u32 sectorCount, u8 *outbuf);
 int ctrNandWrite(u32 sector, u32 sectorCount, const u8 *inbuf);
-u32 decryptExeFs(Cxi *cxi);
-u32 decryptNusFirm(const Ticket *ticket, Cxi *cxi, u32 ncchSize);
+//onDecrypted (can be NULL) is called whenever more of the ExeFS has been decrypted to the start of the buffer,
+//decryption stops if it returns false
+u32 decryptExeFs(Cxi *cxi, bool (*onDecrypted)(u32 decryptedSize));
+u32 decryptNusFirm(const Ticket *ticket, Cxi *cxi, u32 ncchSize, bool (*onDecrypted)(u32 decryptedSize));
 void setupKeyslots(void);
 void kernel9Loader(Arm9Bin *arm9Section);
 void computePinHash(u8 *outbuf, const u8 *inbuf);
@@ -37,6 +37,7 @@
 #include "fmt.h"
 #include "font.h"
 #include "config.h"
+#include "boottime.h"
 
 bool loadSplash(void)
 {
@@ -49,14 +50,19 @@ bool loadSplash(void)
     //Don't delay boot nor init the screens if no splash images or invalid splash images are on the SD
     if(!isTopSplashValid && !isBottomSplashValid) return false;
 
+    //The display duration itself isn't recorded
+    u32 record = bootTimeBegin(BOOTPHASE_SPLASH, NULL);
+
     initScreens();
 
     if(isTopSplashValid) isTopSplashValid = fileRead(fbs[1].top_left, topSplashFile, SCREEN_TOP_FBSIZE) == SCREEN_TOP_FBSIZE;
     if(isBottomSplashValid) isBottomSplashValid = fileRead(fbs[1].bottom, bottomSplashFile, SCREEN_BOTTOM_FBSIZE) == SCREEN_BOTTOM_FBSIZE;
 
-    if(!isTopSplashValid && !isBottomSplashValid) return false;
+    if(isTopSplashValid || isBottomSplashValid) swapFramebuffers(true);
 
-    swapFramebuffers(true);
+    bootTimeEnd(record);
+
+    if(!isTopSplashValid && !isBottomSplashValid) return false;
 
     wait(configData.splashDurationMsec);
 
@@ -33,6 +33,7 @@
 #include "memory.h"
 #include "utils.h"
 #include "fatfs/sdmmc/sdmmc.h"
+#include "fatfs/diskcache.h"
 #include "large_patches.h"
 
 u32 emuOffset,
@@ -83,6 +84,7 @@ void locateEmuNand(FirmwareSource *nandType, u32 *emunandIndex, bool configureCt
                 {
                     emuOffset = nandOffset + 1;
                     emuHeader = 0;
+                    diskCacheInvalidate(DISKCACHE_DRIVE_CTRNAND);
                 }
                 return;
             }
@@ -94,6 +96,7 @@ void locateEmuNand(FirmwareSource *nandType, u32 *emunandIndex, bool configureCt
                 {
                     emuOffset = nandOffset;
                     emuHeader = nandSize;
+                    diskCacheInvalidate(DISKCACHE_DRIVE_CTRNAND);
                 }
                 return;
             }
@@ -0,0 +1,211 @@
+/*
+*   This file is part of Luma3DS
+*   Copyright (C) 2016-2020 Aurora Wright, TuxSH
+*
+*   This program is free software: you can redistribute it and/or modify
+*   it under the terms of the GNU General Public License as published by
+*   the Free Software Foundation, either version 3 of the License, or
+*   (at your option) any later version.
+*
+*   This program is distributed in the hope that it will be useful,
+*   but WITHOUT ANY WARRANTY; without even the implied warranty of
+*   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*   GNU General Public License for more details.
+*
+*   You should have received a copy of the GNU General Public License
+*   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*
+*   Additional Terms 7.b and 7.c of GPLv3 apply to this file:
+*       * Requiring preservation of specified reasonable legal notices or
+*         author attributions in that material or in the Appropriate Legal
+*         Notices displayed by works containing it.
+*       * Prohibiting misrepresentation of the origin of that material,
+*         or requiring that modified versions of such material be marked in
+*         reasonable ways as different from the original version.
+*/
+
+#include "diskcache.h"
+#include "../memory.h"
+
+typedef struct DiskCacheEntry
+{
+    u32 sector;
+    u32 lastUse;
+    u8 drive;
+    bool valid;
+    bool readAhead; // read ahead and not requested yet
+} DiskCacheEntry;
+
+typedef struct DiskCacheRun
+{
+    u32 nextSector;
+    u32 length;     // consecutive sequential reads, 0 before the first read
+    u32 window;     // next read-ahead size
+} DiskCacheRun;
+
+static DiskCacheEntry entries[DISKCACHE_NUM_ENTRIES];
+static u8 __attribute__((aligned(4))) entryData[DISKCACHE_NUM_ENTRIES][DISKCACHE_SECTOR_SIZE];
+static u8 __attribute__((aligned(4))) readBuffer[(DISKCACHE_MAX_CACHED_READ + DISKCACHE_MAX_READAHEAD) * DISKCACHE_SECTOR_SIZE];
+
+static DiskCacheRun runs[DISKCACHE_NUM_DRIVES];
+static DiskCacheStats stats[DISKCACHE_NUM_DRIVES];
+static u32 useCounter;
+
+static DiskCacheEntry *findEntry(u32 drive, u32 sector)
+{
+    for(u32 i = 0; i < DISKCACHE_NUM_ENTRIES; i++)
+    {
+        if(entries[i].valid && entries[i].sector == sector && entries[i].drive == drive)
+            return &entries[i];
+    }
+
+    return NULL;
+}
+
+static void insertEntry(u32 drive, u32 sector, const u8 *data, bool readAhead)
+{
+    DiskCacheEntry *entry = findEntry(drive, sector);
+
+    if(entry == NULL)
+    {
+        // Take a free entry, or the least recently used one
+        entry = &entries[0];
+        for(u32 i = 1; i < DISKCACHE_NUM_ENTRIES && entry->valid; i++)
+        {
+            if(!entries[i].valid || entries[i].lastUse < entry->lastUse)
+                entry = &entries[i];
+        }
+
+        entry->sector = sector;
+        entry->drive = (u8)drive;
+        entry->valid = true;
+        entry->readAhead = readAhead;
+        entry->lastUse = 0;
+    }
+
+    memcpy(entryData[entry - entries], data, DISKCACHE_SECTOR_SIZE);
+
+    if(!readAhead)
+        entry->lastUse = ++useCounter;
+    else if(entry->readAhead)
+    {
+        // Sectors nobody asked for yet are inserted halfway through the LRU order, so that
+        // streaming a file doesn't push the FAT and directory sectors out of the cache
+        entry->lastUse = useCounter > DISKCACHE_NUM_ENTRIES / 2 ? useCounter - DISKCACHE_NUM_ENTRIES / 2 : 0;
+    }
+}
+
+void diskCacheInvalidate(u32 drive)
+{
+    for(u32 i = 0; i < DISKCACHE_NUM_ENTRIES; i++)
+    {
+        if(entries[i].drive == drive)
+            entries[i].valid = false;
+    }
+
+    runs[drive].length = 0;
+}
+
+int diskCacheRead(u32 drive, DiskCacheReadFunc readSectors, u32 sector, u32 count, u8 *out)
+{
+    DiskCacheStats *st = &stats[drive];
+    DiskCacheRun *run = &runs[drive];
+
+    run->length = run->length != 0 && sector == run->nextSector ? run->length + 1 : 1;
+    if(run->length == 1) run->window = DISKCACHE_MIN_READAHEAD;
+    run->nextSector = sector + count;
+
+    st->reads++;
+    st->sectorsRequested += count;
+
+    if(count > DISKCACHE_MAX_CACHED_READ)
+    {
+        // The cache only holds clean sectors, the device has the same data
+        st->bypassed++;
+        st->commands++;
+        st->sectorsRead += count;
+        return readSectors(sector, count, out);
+    }
+
+    u32 firstMiss = count, lastMiss = 0;
+    for(u32 i = 0; i < count; i++)
+    {
+        DiskCacheEntry *entry = findEntry(drive, sector + i);
+
+        if(entry == NULL)
+        {
+            if(firstMiss == count) firstMiss = i;
+            lastMiss = i;
+            st->misses++;
+            continue;
+        }
+
+        memcpy(out + i * DISKCACHE_SECTOR_SIZE, entryData[entry - entries], DISKCACHE_SECTOR_SIZE);
+        entry->lastUse = ++useCounter;
+        if(entry->readAhead)
+        {
+            entry->readAhead = false;
+            st->readAheadHits++;
+        }
+        st->hits++;
+    }
+
+    if(firstMiss == count) return 0;
+
+    // Read the missing sectors with a single command, followed by the read-ahead window
+    // when the read continues a sequential run
+    u32 numSectors = lastMiss + 1 - firstMiss, readAhead = 0;
+    if(lastMiss == count - 1 && run->length >= DISKCACHE_RUN_THRESHOLD)
+    {
+        readAhead = run->window;
+        run->window = 2 * run->window < DISKCACHE_MAX_READAHEAD ? 2 * run->window : DISKCACHE_MAX_READAHEAD;
+    }
+
+    int res = readSectors(sector + firstMiss, numSectors + readAhead, readBuffer);
+    st->commands++;
+
+    if(res != 0 && readAhead != 0)
+    {
+        // Most likely past the end of the device
+        readAhead = 0;
+        run->window = DISKCACHE_MIN_READAHEAD;
+        res = readSectors(sector + firstMiss, numSectors, readBuffer);
+        st->commands++;
+    }
+
+    if(res != 0) return res;
+
+    st->sectorsRead += numSectors + readAhead;
+    st->readAheadSectors += readAhead;
+
+    memcpy(out + firstMiss * DISKCACHE_SECTOR_SIZE, readBuffer, numSectors * DISKCACHE_SECTOR_SIZE);
+    for(u32 i = 0; i < numSectors + readAhead; i++)
+        insertEntry(drive, sector + firstMiss + i, readBuffer + i * DISKCACHE_SECTOR_SIZE, i >= numSectors);
+
+    return 0;
+}
+
+void diskCacheWrite(u32 drive, u32 sector, u32 count, const u8 *in, bool success)
+{
+    stats[drive].writes++;
+    stats[drive].sectorsWritten += count;
+
+    for(u32 i = 0; i < DISKCACHE_NUM_ENTRIES; i++)
+    {
+        DiskCacheEntry *entry = &entries[i];
+
+        if(!entry->valid || entry->drive != drive || entry->sector < sector || entry->sector - sector >= count)
+            continue;
+
+        // After a failed write, the device may hold either version
+        if(success)
+            memcpy(entryData[i], in + (entry->sector - sector) * DISKCACHE_SECTOR_SIZE, DISKCACHE_SECTOR_SIZE);
+        else
+            entry->valid = false;
+    }
+}
+
+const DiskCacheStats *diskCacheGetStats(u32 drive)
+{
+    return &stats[drive];
+}
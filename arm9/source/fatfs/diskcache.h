@@ -0,0 +1,84 @@
+/*
+*   This file is part of Luma3DS
+*   Copyright (C) 2016-2020 Aurora Wright, TuxSH
+*
+*   This program is free software: you can redistribute it and/or modify
+*   it under the terms of the GNU General Public License as published by
+*   the Free Software Foundation, either version 3 of the License, or
+*   (at your option) any later version.
+*
+*   This program is distributed in the hope that it will be useful,
+*   but WITHOUT ANY WARRANTY; without even the implied warranty of
+*   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*   GNU General Public License for more details.
+*
+*   You should have received a copy of the GNU General Public License
+*   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*
+*   Additional Terms 7.b and 7.c of GPLv3 apply to this file:
+*       * Requiring preservation of specified reasonable legal notices or
+*         author attributions in that material or in the Appropriate Legal
+*         Notices displayed by works containing it.
+*       * Prohibiting misrepresentation of the origin of that material,
+*         or requiring that modified versions of such material be marked in
+*         reasonable ways as different from the original version.
+*/
+
+#pragma once
+
+#include "../types.h"
+
+/* Sector cache under the FatFs diskio layer. FatFs only keeps one sector per file and the
+   FAT window, so the FAT chain walks and small directory reads done during boot turn into
+   separate SD/NAND commands. Sectors read through small disk_read calls are kept in a
+   shared LRU cache. When several reads in a row are sequential, the read-ahead window
+   (doubled on each miss of the run) is read in the same command. Large reads go straight
+   to the device. The cache only holds clean data: writes go to the device first and
+   then update the cached copies. */
+
+#ifndef DISKCACHE_NUM_ENTRIES
+#define DISKCACHE_NUM_ENTRIES       64  // sectors, shared by all drives
+#endif
+#ifndef DISKCACHE_MAX_CACHED_READ
+#define DISKCACHE_MAX_CACHED_READ   8   // larger reads bypass the cache
+#endif
+#ifndef DISKCACHE_RUN_THRESHOLD
+#define DISKCACHE_RUN_THRESHOLD     2   // sequential reads before read-ahead starts
+#endif
+#ifndef DISKCACHE_MIN_READAHEAD
+#define DISKCACHE_MIN_READAHEAD     4
+#endif
+#ifndef DISKCACHE_MAX_READAHEAD
+#define DISKCACHE_MAX_READAHEAD     16
+#endif
+
+#define DISKCACHE_NUM_DRIVES        2
+#define DISKCACHE_DRIVE_SDCARD      0   // FatFs physical drive numbers, see diskio.c
+#define DISKCACHE_DRIVE_CTRNAND     1
+#define DISKCACHE_SECTOR_SIZE       0x200
+
+typedef int (*DiskCacheReadFunc)(u32 sector, u32 count, u8 *out);
+
+typedef struct DiskCacheStats
+{
+    u32 reads;              // disk_read calls
+    u32 sectorsRequested;
+    u32 hits;               // requested sectors found in the cache
+    u32 misses;
+    u32 bypassed;           // reads too large to be cached
+    u32 commands;           // read commands sent to the device
+    u32 sectorsRead;        // sectors read from the device, read-ahead included
+    u32 readAheadSectors;
+    u32 readAheadHits;      // read-ahead sectors requested afterwards
+    u32 writes;
+    u32 sectorsWritten;
+} DiskCacheStats;
+
+// Drops the cached sectors of a drive, e.g. when it is (re)initialized or CTRNAND moves to another NAND
+void diskCacheInvalidate(u32 drive);
+
+int diskCacheRead(u32 drive, DiskCacheReadFunc readSectors, u32 sector, u32 count, u8 *out);
+// To be called after a write, updates the cached copies (or drops them if the write failed)
+void diskCacheWrite(u32 drive, u32 sector, u32 count, const u8 *in, bool success);
+
+const DiskCacheStats *diskCacheGetStats(u32 drive);
@@ -9,13 +9,14 @@
 
 #include "ff.h"			/* Obtains integer types */
 #include "diskio.h"		/* Declarations of disk functions */
+#include "diskcache.h"
 #include "sdmmc/sdmmc.h"
 #include "../crypto.h"
 #include "../i2c.h"
 
 /* Definitions of physical drive number for each drive */
-#define SDCARD        0
-#define CTRNAND       1
+#define SDCARD        DISKCACHE_DRIVE_SDCARD
+#define CTRNAND       DISKCACHE_DRIVE_CTRNAND
 
 /*-----------------------------------------------------------------------*/
 /* Get Drive Status                                                      */
@@ -45,6 +46,10 @@ DSTATUS disk_initialize (
     if(sdmmcInitResult == 4)
         sdmmcInitResult = sdmmc_sdcard_init();
 
+    // Remounting CTRNAND can change its location and keys
+    if(pdrv < DISKCACHE_NUM_DRIVES)
+        diskCacheInvalidate(pdrv);
+
     // Check physical drive initialized status
     switch (pdrv)
     {
@@ -81,10 +86,10 @@ DRESULT disk_read (
     switch (pdrv)
     {
         case SDCARD:
-            res = sdmmc_sdcard_readsectors(sector, count, buff) == 0 ? RES_OK : RES_PARERR;
+            res = diskCacheRead(pdrv, sdmmc_sdcard_readsectors, sector, count, buff) == 0 ? RES_OK : RES_PARERR;
             break;
         case CTRNAND:
-            res = ctrNandRead(sector, count, buff) == 0 ? RES_OK : RES_PARERR;
+            res = diskCacheRead(pdrv, ctrNandRead, sector, count, buff) == 0 ? RES_OK : RES_PARERR;
             break;
         default:
             res = RES_NOTRDY;
@@ -118,11 +123,15 @@ DRESULT disk_write (
             if ((*(vu16 *)(SDMMC_BASE + REG_SDSTATUS0) & TMIO_STAT0_WRPROTECT) == 0) // why == 0?
                 res = RES_WRPRT;
             else
+            {
                 res = sdmmc_sdcard_writesectors(sector, count, buff) == 0 ? RES_OK : RES_PARERR;
+                diskCacheWrite(pdrv, sector, count, buff, res == RES_OK);
+            }
             break;
         }
         case CTRNAND:
             res = ctrNandWrite(sector, count, buff) == 0 ? RES_OK : RES_PARERR;
+            diskCacheWrite(pdrv, sector, count, buff, res == RES_OK);
             break;
         default:
             res = RES_NOTRDY;
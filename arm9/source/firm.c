@@ -37,6 +37,7 @@
 #include "screen.h"
 #include "fmt.h"
 #include "chainloader.h"
+#include "boottime.h"
 
 static Firm *firm = (Firm *)0x20001000;
 
@@ -56,7 +57,100 @@ static __attribute__((noinline)) bool inRange(u32 as, u32 ae, u32 bs, u32 be)
    return false;
 }
 
-static bool checkFirm(u32 firmSize)
+//Section hashes computed while the FIRM is being read or decrypted, so that checkFirm doesn't need another pass
+//over the whole image, and so that a corrupted image is rejected as soon as a bad section has been loaded
+static struct
+{
+    ShaContext sha;
+    u32 order[4]; //Non-empty sections, sorted by offset
+    u32 sectionCount;
+    u32 currentSection;
+    u32 hashedSize;
+    u32 verifiedSections; //Bitmask
+    bool headerParsed;
+    bool failed;
+} firmHashState;
+
+static void firmHashInit(void)
+{
+    memset(&firmHashState, 0, sizeof(firmHashState));
+}
+
+static void firmHashParseHeader(void)
+{
+    firmHashState.headerParsed = true;
+
+    //Not a FIRM (yet), checkFirm deals with it
+    if(memcmp(firm->magic, "FIRM", 4) != 0) return;
+
+    for(u32 i = 0; i < 4; i++)
+    {
+        const FirmSection *section = &firm->section[i];
+        if(section->size == 0 || section->offset + section->size < section->offset) continue;
+
+        u32 j;
+        for(j = firmHashState.sectionCount; j > 0 && firm->section[firmHashState.order[j - 1]].offset > section->offset; j--)
+            firmHashState.order[j] = firmHashState.order[j - 1];
+        firmHashState.order[j] = i;
+        firmHashState.sectionCount++;
+    }
+
+    //The engine can only hash one section at a time: overlapping sections are left to checkFirm
+    u32 count = 0,
+        previousEnd = 0x200;
+    for(u32 i = 0; i < firmHashState.sectionCount; i++)
+    {
+        const FirmSection *section = &firm->section[firmHashState.order[i]];
+        if(section->offset < previousEnd) continue;
+
+        firmHashState.order[count++] = firmHashState.order[i];
+        previousEnd = section->offset + section->size;
+    }
+    firmHashState.sectionCount = count;
+}
+
+//The first loadedSize bytes of the FIRM are final. Returns false as soon as a section doesn't match its hash
+static bool firmHashFeed(u32 loadedSize)
+{
+    if(!firmHashState.headerParsed)
+    {
+        if(loadedSize < 0x200) return true;
+        firmHashParseHeader();
+    }
+
+    while(firmHashState.currentSection < firmHashState.sectionCount)
+    {
+        u32 index = firmHashState.order[firmHashState.currentSection];
+        const FirmSection *section = &firm->section[index];
+        u32 start = section->offset + firmHashState.hashedSize,
+            end = section->offset + section->size < loadedSize ? section->offset + section->size : loadedSize;
+
+        if(end <= start) break;
+
+        if(firmHashState.hashedSize == 0) sha_init(&firmHashState.sha, SHA_256_MODE);
+        sha_update(&firmHashState.sha, (u8 *)firm + start, end - start);
+        firmHashState.hashedSize += end - start;
+
+        if(firmHashState.hashedSize < section->size) break;
+
+        __attribute__((aligned(4))) u8 hash[0x20];
+
+        sha_final(&firmHashState.sha, hash);
+        if(memcmp(hash, section->hash, 0x20) != 0)
+        {
+            firmHashState.failed = true;
+            return false;
+        }
+
+        firmHashState.verifiedSections |= 1 << index;
+        firmHashState.currentSection++;
+        firmHashState.hashedSize = 0;
+    }
+
+    return true;
+}
+
+static bool checkFirmImpl(u32 firmSize)
 {
     if(memcmp(firm->magic, "FIRM", 4) != 0 || firm->arm9Entry == NULL) //Allow for the Arm11 entrypoint to be zero in which case nothing is done on the Arm11 side
         return false;
@@ -88,12 +182,16 @@ static bool checkFirm(u32 firmSize)
             (!inRange((u32)section->address, (u32)section->address + section->size, 0x20000000, 0x20000000 + 0x8000000))))
             return false;
 
-        __attribute__((aligned(4))) u8 hash[0x20];
+        //Already hashed while loading
+        if(!(firmHashState.verifiedSections & (1 << i)))
+        {
+            __attribute__((aligned(4))) u8 hash[0x20];
 
-        sha(hash, (u8 *)firm + section->offset, section->size, SHA_256_MODE);
+            sha(hash, (u8 *)firm + section->offset, section->size, SHA_256_MODE);
 
-        if(memcmp(hash, section->hash, 0x20) != 0)
-            return false;
+            if(memcmp(hash, section->hash, 0x20) != 0)
+                return false;
+        }
 
         if(firm->arm9Entry >= section->address && firm->arm9Entry < (section->address + section->size))
             arm9EpFound = true;
@@ -105,6 +203,15 @@ static bool checkFirm(u32 firmSize)
     return arm9EpFound && (firm->arm11Entry == NULL || arm11EpFound);
 }
 
+static bool checkFirm(u32 firmSize)
+{
+    u32 record = bootTimeBegin(BOOTPHASE_FIRM_CHECK, NULL);
+    bool ret = checkFirmImpl(firmSize);
+    bootTimeEnd(record);
+
+    return ret;
+}
+
 static inline u32 loadFirmFromStorage(FirmwareType firmType)
 {
     static const char *firmwareFiles[] = {
@@ -122,11 +229,17 @@ static inline u32 loadFirmFromStorage(FirmwareType firmType)
         "cetk_sysupdater"
     };
 
-    u32 firmSize = fileRead(firm, firmwareFiles[(u32)firmType], 0x400000 + sizeof(Cxi) + 0x200);
+    static const char *extFirmError = "The external FIRM is not valid.",
+                      *invalidFirmError = "The external FIRM is invalid or corrupted.";
 
-    if(!firmSize) return 0;
+    firmHashInit();
+
+    u32 record = bootTimeBegin(BOOTPHASE_FIRM_READ, firmwareFiles[(u32)firmType]);
+    u32 firmSize = fileReadWithProgress(firm, firmwareFiles[(u32)firmType], 0x400000 + sizeof(Cxi) + 0x200, firmHashFeed);
+    bootTimeEnd(record);
 
-    static const char *extFirmError = "The external FIRM is not valid.";
+    if(firmHashState.failed) error(invalidFirmError);
+    if(!firmSize) return 0;
 
     if(firmSize <= sizeof(Cxi) + 0x200) error(extFirmError);
 
@@ -139,12 +252,17 @@ static inline u32 loadFirmFromStorage(FirmwareType firmType)
         if(fileRead(cetk, cetkFiles[(u32)firmType], sizeof(cetk)) != sizeof(cetk))
             error("The cetk is missing or corrupted.");
 
-        firmSize = decryptNusFirm((Ticket *)(cetk + 0x140), (Cxi *)firm, firmSize);
+        firmHashInit();
 
+        record = bootTimeBegin(BOOTPHASE_EXEFS_DECRYPT, "nus");
+        firmSize = decryptNusFirm((Ticket *)(cetk + 0x140), (Cxi *)firm, firmSize, firmHashFeed);
+        bootTimeEnd(record);
+
+        if(firmHashState.failed) error(invalidFirmError);
         if(!firmSize) error("Unable to decrypt the external FIRM.");
     }
 
-    if(!checkFirm(firmSize)) error("The external FIRM is invalid or corrupted.");
+    if(!checkFirm(firmSize)) error(invalidFirmError);
 
     return firmSize;
 }
@@ -154,17 +272,25 @@ u32 loadNintendoFirm(FirmwareType *firmType, FirmwareSource nandType, bool loadF
     u32 firmVersion = 0xFFFFFFFF,
         firmSize;
 
+    u32 record = bootTimeBegin(BOOTPHASE_STORAGE_MOUNT, "ctrnand");
     bool ctrNandError = isSdMode && !remountCtrNandPartition(false);
+    bootTimeEnd(record);
 
     if(!ctrNandError)
     {
         //Load FIRM from CTRNAND
+        record = bootTimeBegin(BOOTPHASE_FIRM_READ, "ctrnand");
         firmVersion = firmRead(firm, (u32)*firmType);
+        bootTimeEnd(record);
 
         if(firmVersion == 0xFFFFFFFF) ctrNandError = true;
         else
         {
-            firmSize = decryptExeFs((Cxi *)firm);
+            firmHashInit();
+
+            record = bootTimeBegin(BOOTPHASE_EXEFS_DECRYPT, NULL);
+            firmSize = decryptExeFs((Cxi *)firm, firmHashFeed);
+            bootTimeEnd(record);
 
             if(!firmSize || !checkFirm(firmSize)) ctrNandError = true;
         }
@@ -245,8 +371,12 @@ void loadHomebrewFirm(u32 pressed)
 
     if(!found) return;
 
-    u32 maxPayloadSize = (u32)((u8 *)0x27FFE000 - (u8 *)firm),
-        payloadSize = fileRead(firm, path, maxPayloadSize);
+    firmHashInit();
+
+    u32 record = bootTimeBegin(BOOTPHASE_FIRM_READ, path + sizeof("payloads/") - 1),
+        maxPayloadSize = (u32)((u8 *)0x27FFE000 - (u8 *)firm),
+        payloadSize = fileReadWithProgress(firm, path, maxPayloadSize, firmHashFeed);
+    bootTimeEnd(record);
 
     if(payloadSize <= 0x200 || !checkFirm(payloadSize)) error("The payload is invalid or corrupted.");
 
@@ -261,6 +391,7 @@ void loadHomebrewFirm(u32 pressed)
     if(!hasDisplayedMenu && wantsScreenInit)
         initScreens(); // Don't init the screens unless we have to, if not already done
 
+    bootTimeFlush(BOOTTIME_FIRM_PAYLOAD, FIRMWARE_SYSNAND);
     launchFirm(wantsScreenInit ? 2 : 1, argv);
 }
 
@@ -515,7 +646,9 @@ u32 patchNativeFirm(u32 firmVersion, FirmwareSource nandType, bool loadFromStora
     if(ISN3DS)
     {
         //Decrypt Arm9Bin and patch Arm9 entrypoint to skip kernel9loader
+        u32 record = bootTimeBegin(BOOTPHASE_ARM9BIN_DECRYPT, NULL);
         kernel9Loader((Arm9Bin *)arm9Section);
+        bootTimeEnd(record);
         firm->arm9Entry = (u8 *)0x801B01C;
     }
 
@@ -539,67 +672,69 @@ u32 patchNativeFirm(u32 firmVersion, FirmwareSource nandType, bool loadFromStora
             *arm11ExceptionsPage,
             *arm11SvcTable = getKernel11Info(arm11Section1, firm->section[1].size, &baseK11VA, &freeK11Space, &arm11SvcHandler, &arm11ExceptionsPage);
 
-        ret += installK11Extension(arm11Section1, firm->section[1].size, needToInitSd, baseK11VA, arm11ExceptionsPage, &freeK11Space);
-        ret += patchKernel11(arm11Section1, firm->section[1].size, baseK11VA, arm11SvcTable, arm11ExceptionsPage);
+        ret += BOOTTIME_PATCH(installK11Extension(arm11Section1, firm->section[1].size, needToInitSd, baseK11VA, arm11ExceptionsPage, &freeK11Space));
+        ret += BOOTTIME_PATCH(patchKernel11(arm11Section1, firm->section[1].size, baseK11VA, arm11SvcTable, arm11ExceptionsPage));
     }
 #else
     (void)needToInitSd;
 #endif
 
     // Apply signature patches
-    ret += patchSignatureChecks(process9Offset, process9Size);
+    ret += BOOTTIME_PATCH(patchSignatureChecks(process9Offset, process9Size));
     
     // fix typo 
-    ret += nandTypoFix(process9Offset, process9Size);
+    ret += BOOTTIME_PATCH(nandTypoFix(process9Offset, process9Size));
     
     // Apply EmuNAND patches
-    if(nandType != FIRMWARE_SYSNAND) ret += patchEmuNand(process9Offset, process9Size, firmVersion, false);
+    if(nandType != FIRMWARE_SYSNAND) ret += BOOTTIME_PATCH(patchEmuNand(process9Offset, process9Size, firmVersion, false));
     
     // Apply FIRM0/1 writes patches on SysNAND to protect A9LH
-    else if(isFirmProtEnabled) ret += patchFirmWrites(process9Offset, process9Size);
+    else if(isFirmProtEnabled) ret += BOOTTIME_PATCH(patchFirmWrites(process9Offset, process9Size));
     
     // Apply nand init patches on emunand 
-    if((nandType != FIRMWARE_SYSNAND) && (CONFIG(HARDWAREPATCHING))) ret += patchNandInit(process9Offset, process9Size);
+    if((nandType != FIRMWARE_SYSNAND) && (CONFIG(HARDWAREPATCHING))) ret += BOOTTIME_PATCH(patchNandInit(process9Offset, process9Size));
     
     // Apply cid patch on sysnand
-    else if(CONFIG(HARDWAREPATCHING)) ret += patchCidInit(process9Offset, process9Size);
+    else if(CONFIG(HARDWAREPATCHING)) ret += BOOTTIME_PATCH(patchCidInit(process9Offset, process9Size));
 
 #ifndef BUILD_FOR_EXPLOIT_DEV
     //Apply firmlaunch patches
-    ret += patchFirmlaunches(process9Offset, process9Size, process9MemAddr);
+    ret += BOOTTIME_PATCH(patchFirmlaunches(process9Offset, process9Size, process9MemAddr));
 #endif
 
     //Apply dev unit check patches related to NCCH encryption
     if(!ISDEVUNIT)
     {
-        ret += patchZeroKeyNcchEncryptionCheck(process9Offset, process9Size);
-        ret += patchNandNcchEncryptionCheck(process9Offset, process9Size);
+        ret += BOOTTIME_PATCH(patchZeroKeyNcchEncryptionCheck(process9Offset, process9Size));
+        ret += BOOTTIME_PATCH(patchNandNcchEncryptionCheck(process9Offset, process9Size));
     }
 
     //Apply anti-anti-DG patches on 11.0+
-    if(firmVersion >= (ISN3DS ? 0x21 : 0x52)) ret += patchTitleInstallMinVersionChecks(process9Offset, process9Size, firmVersion);
+    if(firmVersion >= (ISN3DS ? 0x21 : 0x52)) ret += BOOTTIME_PATCH(patchTitleInstallMinVersionChecks(process9Offset, process9Size, firmVersion));
 
     //Patch P9 AM ticket wrapper on 11.8+ to use 0 Key and IV, only with UNITINFO patch on to prevent NIM from actually sending any
-    if(doUnitinfoPatch && firmVersion >= (ISN3DS ? 0x35 : 0x64)) ret += patchP9AMTicketWrapperZeroKeyIV(process9Offset, process9Size, firmVersion);
+    if(doUnitinfoPatch && firmVersion >= (ISN3DS ? 0x35 : 0x64)) ret += BOOTTIME_PATCH(patchP9AMTicketWrapperZeroKeyIV(process9Offset, process9Size, firmVersion));
 
     //Apply UNITINFO patches
     if(doUnitinfoPatch)
     {
-        ret += patchUnitInfoValueSet(arm9Section, kernel9Size);
-        if(!ISDEVUNIT) ret += patchCheckForDevCommonKey(process9Offset, process9Size);
+        ret += BOOTTIME_PATCH(patchUnitInfoValueSet(arm9Section, kernel9Size));
+        if(!ISDEVUNIT) ret += BOOTTIME_PATCH(patchCheckForDevCommonKey(process9Offset, process9Size));
     }
 
     //Arm9 exception handlers
-    ret += patchArm9ExceptionHandlersInstall(arm9Section, kernel9Size);
-    ret += patchSvcBreak9(arm9Section, kernel9Size, (u32)firm->section[2].address);
-    ret += patchKernel9Panic(arm9Section, kernel9Size);
+    ret += BOOTTIME_PATCH(patchArm9ExceptionHandlersInstall(arm9Section, kernel9Size));
+    ret += BOOTTIME_PATCH(patchSvcBreak9(arm9Section, kernel9Size, (u32)firm->section[2].address));
+    ret += BOOTTIME_PATCH(patchKernel9Panic(arm9Section, kernel9Size));
 
-    ret += patchP9AccessChecks(process9Offset, process9Size);
+    ret += BOOTTIME_PATCH(patchP9AccessChecks(process9Offset, process9Size));
 
     //Patch stubbed vtable function 11 of an FSPXI:ReadFileSHA256 auxiliary object
-    ret += patchReadFileSHA256Vtab11(process9Offset, process9Size, process9MemAddr);
+    ret += BOOTTIME_PATCH(patchReadFileSHA256Vtab11(process9Offset, process9Size, process9MemAddr));
 
+    u32 modulesRecord = bootTimeBegin(BOOTPHASE_MODULES, NULL);
     mergeSection0(NATIVE_FIRM, firmVersion, loadFromStorage);
+    bootTimeEnd(modulesRecord);
     firm->section[0].size = 0;
 
     return ret;
@@ -621,7 +756,9 @@ u32 patchTwlFirm(u32 firmVersion, FirmwareSource nandType, bool loadFromStorage,
     //On N3DS, decrypt Arm9Bin and patch Arm9 entrypoint to skip kernel9loader
     if(ISN3DS)
     {
+        u32 record = bootTimeBegin(BOOTPHASE_ARM9BIN_DECRYPT, NULL);
         kernel9Loader((Arm9Bin *)arm9Section);
+        bootTimeEnd(record);
         firm->arm9Entry = (u8 *)0x801301C;
     }
 
@@ -633,29 +770,31 @@ u32 patchTwlFirm(u32 firmVersion, FirmwareSource nandType, bool loadFromStorage,
     u32 kernel9Size = (u32)(process9Offset - arm9Section) - sizeof(Cxi) - 0x200,
         ret = 0;
 
-    ret += patchLgySignatureChecks(process9Offset, process9Size);
-    ret += patchTwlInvalidSignatureChecks(process9Offset, process9Size);
-    ret += patchTwlNintendoLogoChecks(process9Offset, process9Size);
-    ret += patchTwlWhitelistChecks(process9Offset, process9Size);
-    if(ISN3DS || firmVersion > 0x11) ret += patchTwlFlashcartChecks(process9Offset, process9Size, firmVersion);
-    else if(!ISN3DS && firmVersion == 0x11) ret += patchOldTwlFlashcartChecks(process9Offset, process9Size);
-    ret += patchTwlShaHashChecks(process9Offset, process9Size);
+    ret += BOOTTIME_PATCH(patchLgySignatureChecks(process9Offset, process9Size));
+    ret += BOOTTIME_PATCH(patchTwlInvalidSignatureChecks(process9Offset, process9Size));
+    ret += BOOTTIME_PATCH(patchTwlNintendoLogoChecks(process9Offset, process9Size));
+    ret += BOOTTIME_PATCH(patchTwlWhitelistChecks(process9Offset, process9Size));
+    if(ISN3DS || firmVersion > 0x11) ret += BOOTTIME_PATCH(patchTwlFlashcartChecks(process9Offset, process9Size, firmVersion));
+    else if(!ISN3DS && firmVersion == 0x11) ret += BOOTTIME_PATCH(patchOldTwlFlashcartChecks(process9Offset, process9Size));
+    ret += BOOTTIME_PATCH(patchTwlShaHashChecks(process9Offset, process9Size));
     
     //Apply EmuNAND patches
-    if(nandType != FIRMWARE_SYSNAND) ret += patchEmuNand(process9Offset, process9Size, firmVersion, true);
+    if(nandType != FIRMWARE_SYSNAND) ret += BOOTTIME_PATCH(patchEmuNand(process9Offset, process9Size, firmVersion, true));
 
     //Apply UNITINFO patch
-    if(doUnitinfoPatch) ret += patchUnitInfoValueSet(arm9Section, kernel9Size);
+    if(doUnitinfoPatch) ret += BOOTTIME_PATCH(patchUnitInfoValueSet(arm9Section, kernel9Size));
     
     //Arm9 exception handlers
-    ret += patchTwlArm9ExceptionHandlersInstall(arm9Section, kernel9Size);
-    ret += patchSvcBreak9(arm9Section, kernel9Size, (u32)firm->section[3].address);
-    ret += patchTwlKernel9Panic(arm9Section, kernel9Size);
+    ret += BOOTTIME_PATCH(patchTwlArm9ExceptionHandlersInstall(arm9Section, kernel9Size));
+    ret += BOOTTIME_PATCH(patchSvcBreak9(arm9Section, kernel9Size, (u32)firm->section[3].address));
+    ret += BOOTTIME_PATCH(patchTwlKernel9Panic(arm9Section, kernel9Size));
 
-    ret += patchLgyK11(section1, section1Size, section2, section2Size);
+    ret += BOOTTIME_PATCH(patchLgyK11(section1, section1Size, section2, section2Size));
 
     // Also patch TwlBg here
+    u32 modulesRecord = bootTimeBegin(BOOTPHASE_MODULES, NULL);
     mergeSection0(TWL_FIRM, 0, loadFromStorage);
+    bootTimeEnd(modulesRecord);
     firm->section[0].size = 0;
 
     return ret;
@@ -673,7 +812,9 @@ u32 patchAgbFirm(bool loadFromStorage, bool doUnitinfoPatch)
     //On N3DS, decrypt Arm9Bin and patch Arm9 entrypoint to skip kernel9loader
     if(ISN3DS)
     {
+        u32 record = bootTimeBegin(BOOTPHASE_ARM9BIN_DECRYPT, NULL);
         kernel9Loader((Arm9Bin *)arm9Section);
+        bootTimeEnd(record);
         firm->arm9Entry = (u8 *)0x801301C;
     }
 
@@ -685,16 +826,18 @@ u32 patchAgbFirm(bool loadFromStorage, bool doUnitinfoPatch)
     u32 kernel9Size = (u32)(process9Offset - arm9Section) - sizeof(Cxi) - 0x200,
         ret = 0;
 
-    ret += patchLgySignatureChecks(process9Offset, process9Size);
-    if(CONFIG(SHOWGBABOOT)) ret += patchAgbBootSplash(process9Offset, process9Size);
-    ret += patchLgyK11(section1, section1Size, section2, section2Size);
+    ret += BOOTTIME_PATCH(patchLgySignatureChecks(process9Offset, process9Size));
+    if(CONFIG(SHOWGBABOOT)) ret += BOOTTIME_PATCH(patchAgbBootSplash(process9Offset, process9Size));
+    ret += BOOTTIME_PATCH(patchLgyK11(section1, section1Size, section2, section2Size));
 
     //Apply UNITINFO patch
-    if(doUnitinfoPatch) ret += patchUnitInfoValueSet(arm9Section, kernel9Size);
+    if(doUnitinfoPatch) ret += BOOTTIME_PATCH(patchUnitInfoValueSet(arm9Section, kernel9Size));
 
     if(loadFromStorage)
     {
+        u32 modulesRecord = bootTimeBegin(BOOTPHASE_MODULES, NULL);
         mergeSection0(AGB_FIRM, 0, true);
+        bootTimeEnd(modulesRecord);
         firm->section[0].size = 0;
     }
 
@@ -708,7 +851,9 @@ u32 patch1x2xNativeAndSafeFirm(void)
     if(ISN3DS)
     {
         //Decrypt Arm9Bin and patch Arm9 entrypoint to skip kernel9loader
+        u32 record = bootTimeBegin(BOOTPHASE_ARM9BIN_DECRYPT, NULL);
         kernel9Loader((Arm9Bin *)arm9Section);
+        bootTimeEnd(record);
         firm->arm9Entry = (u8 *)0x801B01C;
     }
 
@@ -720,17 +865,17 @@ u32 patch1x2xNativeAndSafeFirm(void)
     u32 kernel9Size = (u32)(process9Offset - arm9Section) - sizeof(Cxi) - 0x200,
         ret = 0;
 
-    ret += ISN3DS ? patchFirmWrites(process9Offset, process9Size) : patchOldFirmWrites(process9Offset, process9Size);
+    ret += ISN3DS ? BOOTTIME_PATCH(patchFirmWrites(process9Offset, process9Size)) : BOOTTIME_PATCH(patchOldFirmWrites(process9Offset, process9Size));
 
-    ret += ISN3DS ? patchSignatureChecks(process9Offset, process9Size) : patchOldSignatureChecks(process9Offset, process9Size);
+    ret += ISN3DS ? BOOTTIME_PATCH(patchSignatureChecks(process9Offset, process9Size)) : BOOTTIME_PATCH(patchOldSignatureChecks(process9Offset, process9Size));
 
     //Arm9 exception handlers
-    ret += patchArm9ExceptionHandlersInstall(arm9Section, kernel9Size);
-    ret += patchSvcBreak9(arm9Section, kernel9Size, (u32)firm->section[2].address);
+    ret += BOOTTIME_PATCH(patchArm9ExceptionHandlersInstall(arm9Section, kernel9Size));
+    ret += BOOTTIME_PATCH(patchSvcBreak9(arm9Section, kernel9Size, (u32)firm->section[2].address));
 
     //Apply firmlaunch patches
     //Doesn't work here if Luma is on SD. If you want to use SAFE_FIRM on 1.0, use Luma from NAND & uncomment this line:
-    ret += patchFirmlaunches(process9Offset, process9Size, process9MemAddr);
+    ret += BOOTTIME_PATCH(patchFirmlaunches(process9Offset, process9Size, process9MemAddr));
 
     if(ISN3DS && CONFIG(ENABLESAFEFIRMROSALINA))
     {
@@ -742,15 +887,17 @@ u32 patch1x2xNativeAndSafeFirm(void)
             *arm11ExceptionsPage,
             *arm11SvcTable = getKernel11Info(arm11Section1, firm->section[1].size, &baseK11VA, &freeK11Space, &arm11SvcHandler, &arm11ExceptionsPage);
 
-        ret += installK11Extension(arm11Section1, firm->section[1].size, false, baseK11VA, arm11ExceptionsPage, &freeK11Space);
-        ret += patchKernel11(arm11Section1, firm->section[1].size, baseK11VA, arm11SvcTable, arm11ExceptionsPage);
+        ret += BOOTTIME_PATCH(installK11Extension(arm11Section1, firm->section[1].size, false, baseK11VA, arm11ExceptionsPage, &freeK11Space));
+        ret += BOOTTIME_PATCH(patchKernel11(arm11Section1, firm->section[1].size, baseK11VA, arm11SvcTable, arm11ExceptionsPage));
 
         // Add some other patches to the mix, as we can now launch homebrew on SAFE_FIRM:
 
-        ret += patchKernel9Panic(arm9Section, kernel9Size);
-        ret += patchP9AccessChecks(process9Offset, process9Size);
+        ret += BOOTTIME_PATCH(patchKernel9Panic(arm9Section, kernel9Size));
+        ret += BOOTTIME_PATCH(patchP9AccessChecks(process9Offset, process9Size));
 
+        u32 modulesRecord = bootTimeBegin(BOOTPHASE_MODULES, NULL);
         mergeSection0(NATIVE_FIRM, 0x45, false); // may change in the future
+        bootTimeEnd(modulesRecord);
         firm->section[0].size = 0;
     }
 
@@ -98,7 +98,7 @@ void unmountPartitions(void)
     f_unmount("sdmc:");
 }
 
-u32 fileRead(void *dest, const char *path, u32 maxSize)
+u32 fileReadWithProgress(void *dest, const char *path, u32 maxSize, bool (*onProgress)(u32 readSize))
 {
     FIL file;
     FRESULT result = FR_OK;
@@ -109,12 +109,31 @@ u32 fileRead(void *dest, const char *path, u32 maxSize)
     u32 size = f_size(&file);
     if(dest == NULL) ret = size;
     else if(size <= maxSize)
-        result = f_read(&file, dest, size, (unsigned int *)&ret);
+    {
+        if(onProgress == NULL)
+            result = f_read(&file, dest, size, (unsigned int *)&ret);
+        else while(result == FR_OK && ret < size)
+        {
+            unsigned int chunkSize = size - ret < 0x40000 ? size - ret : 0x40000,
+                         read;
+
+            result = f_read(&file, (u8 *)dest + ret, chunkSize, &read);
+            ret += read;
+
+            if(result == FR_OK && read != chunkSize) break;
+            if(result == FR_OK && !onProgress(ret)) result = FR_INT_ERR;
+        }
+    }
     result |= f_close(&file);
 
     return result == FR_OK ? ret : 0;
 }
 
+u32 fileRead(void *dest, const char *path, u32 maxSize)
+{
+    return fileReadWithProgress(dest, path, maxSize, NULL);
+}
+
 u32 getFileSize(const char *path)
 {
     return fileRead(NULL, path, 0);
@@ -35,6 +35,8 @@ bool remountCtrNandPartition(bool switchMainDir);
 void unmountPartitions(void);
 
 u32 fileRead(void *dest, const char *path, u32 maxSize);
+//Reads in chunks, onProgress is called with the size read so far after each of them. Fails if it returns false
+u32 fileReadWithProgress(void *dest, const char *path, u32 maxSize, bool (*onProgress)(u32 readSize));
 u32 getFileSize(const char *path);
 bool fileWrite(const void *buffer, const char *path, u32 size);
 bool fileDelete(const char *path);
@@ -40,8 +40,10 @@
 #include "i2c.h"
 #include "fmt.h"
 #include "fatfs/sdmmc/sdmmc.h"
+#include "fatfs/diskcache.h"
 #include "itcm.h"
 #include "fatfs/ff.h"
+#include "boottime.h"
 
 extern u8 __itcm_start__[], __itcm_lma__[], __itcm_bss_start__[], __itcm_end__[];
 
@@ -73,6 +75,8 @@ void main(int argc, char **argv, u32 magicWord)
     const vu32 *bootPartitionsStatus = (const vu32 *)0x1FFFE010;
     u32 firmlaunchTidLow = 0;
 
+    bootTimeInit();
+
     //Shell closed, no error booting NTRCARD, NAND paritions not even considered
     isNtrBoot = bootMediaStatus[3] == 2 && !bootMediaStatus[1] && !bootPartitionsStatus[0] && !bootPartitionsStatus[1];
 
@@ -147,6 +151,8 @@ void main(int argc, char **argv, u32 magicWord)
 
     installArm9Handlers();
 
+    u32 mountRecord = bootTimeBegin(BOOTPHASE_STORAGE_MOUNT, NULL);
+
     if(memcmp(launchedPath, u"sdmc", 8) == 0)
     {
         if(!mountSdCardPartition(true)) error("Failed to mount SD.");
@@ -182,6 +188,8 @@ void main(int argc, char **argv, u32 magicWord)
         error("Launched from an unsupported location: %s.", mountPoint);
     }
 
+    bootTimeEnd(mountRecord);
+
     detectAndProcessExceptionDumps();
     
     // Writes plaintext OTP to ITCM, if OTP exists
@@ -197,7 +205,9 @@ void main(int argc, char **argv, u32 magicWord)
     }
 
     //Attempt to read the configuration file
+    u32 configRecord = bootTimeBegin(BOOTPHASE_CONFIG_READ, NULL);
     needConfig = readConfig() ? MODIFY_CONFIGURATION : CREATE_CONFIGURATION;
+    bootTimeEnd(configRecord);
 
     //Determine if this is a firmlaunch boot
     if(bootType == FIRMLAUNCH)
@@ -365,12 +375,15 @@ boot:
     //If we need to boot EmuNAND, make sure it exists
     if(nandType != FIRMWARE_SYSNAND)
     {
+        u32 emuNandRecord = bootTimeBegin(BOOTPHASE_EMUNAND_LOCATE, NULL);
         locateEmuNand(&nandType, &emunandIndex, true);
+        bootTimeEnd(emuNandRecord);
         if(nandType == FIRMWARE_EMUNAND && (*(vu16 *)(SDMMC_BASE + REG_SDSTATUS0) & TMIO_STAT0_WRPROTECT) == 0) //Make sure the SD card isn't write protected
             error("The SD card is locked, EmuNAND can not be used.\nPlease turn the write protection switch off.");
     }
 
     ctrNandLocation = nandType; // for CTRNAND partition
+    diskCacheInvalidate(DISKCACHE_DRIVE_CTRNAND); // it may have been read from the other NAND
 
     if(bootType != FIRMLAUNCH)
     {
@@ -405,6 +418,7 @@ boot:
 
     if(res != 0) error("Failed to apply %u FIRM patch(es).", res);
 
+    bootTimeFlush(firmType, nandType);
     unmountPartitions();
     if(bootType != FIRMLAUNCH) deinitScreens();
     launchFirm(0, NULL);
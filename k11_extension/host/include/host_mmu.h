@@ -0,0 +1,8 @@
+// Force-included in the host build of mmu.c (see Makefile): L2 tables live in host memory, at fake physical addresses
+#pragma once
+
+#include <stdint.h>
+
+uint32_t *hostL2Table(uint32_t pa);
+
+#define MMU_L2_TABLE_FROM_PA(pa)    hostL2Table(pa)
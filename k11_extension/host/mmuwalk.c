@@ -0,0 +1,203 @@
+/*
+Checks L1MMUTable__GetPhysicalRuns (mmu.c) against synthetic L1/L2 tables made of sections, supersections,
+large and small pages, translation faults and attribute changes. Every run list is also cross-checked page
+by page against L1MMUTable__GetPAFromVA and L1MMUTable__GetAddressUserPerm.
+
+Exits with status 1 if anything doesn't match.
+*/
+
+#include <stdio.h>
+#include <string.h>
+#include "types.h"
+#include "mmu.h"
+
+#define L2_TABLES_PA    0x1FF80000
+#define NUM_L2_TABLES   4
+
+#define ATTR_NORMAL_RW_SHARED   (MEMPERM_RW | 7 << 8 | 1 << 16) // TEX=1, C=1, B=1
+#define ATTR_NORMAL_R_SHARED    (MEMPERM_R | 7 << 8 | 1 << 16)
+#define ATTR_STRONGLY_ORDERED   MEMPERM_RWX
+#define ATTR_DEVICE_RW          (MEMPERM_RW | 1 << 8)           // B=1
+
+static u32 l1Table[0x400];
+static u32 l2Tables[NUM_L2_TABLES][0x100] __attribute__((aligned(0x400)));
+static bool failed;
+
+u32 *hostL2Table(u32 pa)
+{
+    if (pa < L2_TABLES_PA || pa >= L2_TABLES_PA + sizeof(l2Tables) || (pa & 0x3FF) != 0)
+    {
+        printf("bad L2 table PA 0x%08X\n", pa);
+        failed = true;
+        return l2Tables[0];
+    }
+
+    return l2Tables[(pa - L2_TABLES_PA) / 0x400];
+}
+
+static u32 makeSection(u32 pa, u32 ap, u32 apx, u32 xn, u32 tex, u32 c, u32 b, u32 s)
+{
+    return 0b10 | b << 2 | c << 3 | xn << 4 | ap << 10 | tex << 12 | apx << 15 | s << 16 | (pa & 0xFFF00000);
+}
+
+static void mapSupersection(u32 va, u32 pa, u32 ap, u32 xn, u32 tex, u32 c, u32 b)
+{
+    for (u32 i = 0; i < 16; i++)
+        l1Table[(va >> 20) + i] = 0b10 | b << 2 | c << 3 | xn << 4 | ap << 10 | tex << 12 | 1 << 18 | (pa & 0xFF000000);
+}
+
+static void mapCoarseTable(u32 va, u32 l2TableId)
+{
+    l1Table[va >> 20] = 0b01 | ((L2_TABLES_PA + 0x400 * l2TableId) & ~0x3FF);
+}
+
+static u32 makeSmallPage(u32 pa, u32 ap, u32 apx, u32 xn, u32 tex, u32 c, u32 b, u32 s)
+{
+    return xn | 1 << 1 | b << 2 | c << 3 | ap << 4 | tex << 6 | apx << 9 | s << 10 | (pa & 0xFFFFF000);
+}
+
+static void mapLargePage(u32 *l2Table, u32 va, u32 pa, u32 ap, u32 apx, u32 xn, u32 tex, u32 c, u32 b, u32 s)
+{
+    u32 descriptor = 0b01 | b << 2 | c << 3 | ap << 4 | apx << 9 | s << 10 | tex << 12 | xn << 15 | (pa & 0xFFFF0000);
+
+    for (u32 i = 0; i < 16; i++)
+        l2Table[((va >> 12) & 0xF0) + i] = descriptor;
+}
+
+static void buildTables(void)
+{
+    u32 *l2Table = l2Tables[1];
+
+    // Two physically contiguous sections with the same attributes, then a contiguous one with different ones
+    l1Table[0x001] = makeSection(0x20000000, 3, 0, 1, 1, 1, 1, 1);
+    l1Table[0x002] = makeSection(0x20100000, 3, 0, 1, 1, 1, 1, 1);
+    l1Table[0x003] = makeSection(0x20200000, 2, 0, 1, 1, 1, 1, 1);
+
+    mapSupersection(0x01000000, 0x30000000, 3, 0, 0, 0, 0);
+
+    mapCoarseTable(0x02000000, 1);
+    for (u32 i = 0; i < 4; i++)
+        l2Table[i] = makeSmallPage(0x18000000 + 0x1000 * i, 3, 0, 1, 0, 0, 1, 0);
+    l2Table[5] = makeSmallPage(0x18010000, 3, 0, 1, 0, 0, 1, 0);
+    l2Table[6] = makeSmallPage(0x18011000, 3, 0, 1, 0, 0, 1, 0);
+    mapLargePage(l2Table, 0x02010000, 0x18020000, 3, 0, 1, 0, 0, 1, 0);
+    mapLargePage(l2Table, 0x02020000, 0x18030000, 3, 0, 1, 0, 0, 1, 0);
+    l2Table[0x30] = makeSmallPage(0x18040000, 3, 0, 1, 0, 0, 1, 0);
+}
+
+static void crossCheck(const char *name, const PhysicalRun *runs, u32 numRuns, u32 va, u32 size)
+{
+    for (u32 pageVa = va & ~0xFFF; pageVa < va + size; pageVa += 0x1000)
+    {
+        u32 checkVa = pageVa < va ? va : pageVa;
+        u32 expectedPa = 0, expectedPerm = 0;
+
+        for (u32 i = 0; i < numRuns; i++)
+        {
+            if (checkVa >= runs[i].va && checkVa - runs[i].va < runs[i].size)
+            {
+                expectedPa = runs[i].pa + (checkVa - runs[i].va);
+                expectedPerm = runs[i].attributes & 7;
+            }
+        }
+
+        u32 pa = L1MMUTable__GetPAFromVA(l1Table, checkVa);
+        u32 perm = L1MMUTable__GetAddressUserPerm(l1Table, checkVa);
+        if (pa != expectedPa || perm != expectedPerm)
+        {
+            printf("%s: FAILED at va 0x%08X: pa 0x%08X perm %u, runs say pa 0x%08X perm %u\n", name, checkVa, pa, perm, expectedPa, expectedPerm);
+            failed = true;
+            return;
+        }
+    }
+}
+
+static void expectRuns(const char *name, u32 va, u32 size, u32 maxRuns, const PhysicalRun *expected, u32 numExpected, u32 expectedWalkedSize)
+{
+    PhysicalRun runs[32];
+    u32 walkedSize = 0xDEADBEEF;
+    u32 numRuns = L1MMUTable__GetPhysicalRuns(l1Table, runs, maxRuns, va, size, &walkedSize);
+    bool ok = numRuns == numExpected && walkedSize == expectedWalkedSize && memcmp(runs, expected, numRuns * sizeof(PhysicalRun)) == 0;
+
+    printf("%s: %s\n", name, ok ? "ok" : "FAILED");
+    for (u32 i = 0; i < numRuns; i++)
+        printf("    va 0x%08X pa 0x%08X size 0x%08X attributes 0x%05X\n", runs[i].va, runs[i].pa, runs[i].size, runs[i].attributes);
+    if (!ok)
+    {
+        printf("    walked 0x%08X, expected:\n", walkedSize);
+        for (u32 i = 0; i < numExpected; i++)
+            printf("    va 0x%08X pa 0x%08X size 0x%08X attributes 0x%05X\n", expected[i].va, expected[i].pa, expected[i].size, expected[i].attributes);
+        failed = true;
+    }
+
+    crossCheck(name, runs, numRuns, va, walkedSize);
+}
+
+static void expectContinuation(const char *name, u32 va, u32 size, u32 maxRuns, const PhysicalRun *expected, u32 numExpected)
+{
+    PhysicalRun runs[32];
+    u32 numRuns = 0, numCalls = 0;
+
+    // Like a caller of svcConvertVARangeToPA with a small buffer: carry on after the last run while the buffer gets filled
+    for (;;)
+    {
+        u32 walkedSize;
+        u32 n = L1MMUTable__GetPhysicalRuns(l1Table, runs + numRuns, maxRuns, va, size, &walkedSize);
+
+        numRuns += n;
+        numCalls++;
+        if (n < maxRuns || walkedSize == size)
+            break;
+
+        u32 next = runs[numRuns - 1].va + runs[numRuns - 1].size;
+        size -= next - va;
+        va = next;
+    }
+
+    bool ok = numRuns == numExpected && memcmp(runs, expected, numRuns * sizeof(PhysicalRun)) == 0;
+    printf("%s: %s (%u calls)\n", name, ok ? "ok" : "FAILED", numCalls);
+    failed |= !ok;
+}
+
+int main(void)
+{
+    static const PhysicalRun all[] = {
+        { 0x00100000, 0x20000000, 0x00200000, ATTR_NORMAL_RW_SHARED },
+        { 0x00300000, 0x20200000, 0x00100000, ATTR_NORMAL_R_SHARED },
+        { 0x01000000, 0x30000000, 0x01000000, ATTR_STRONGLY_ORDERED },
+        { 0x02000000, 0x18000000, 0x00004000, ATTR_DEVICE_RW },
+        { 0x02005000, 0x18010000, 0x00002000, ATTR_DEVICE_RW },
+        { 0x02010000, 0x18020000, 0x00021000, ATTR_DEVICE_RW },
+    };
+    static const PhysicalRun unalignedSection[] = {
+        { 0x00180800, 0x20080800, 0x00100000, ATTR_NORMAL_RW_SHARED },
+    };
+    static const PhysicalRun unalignedPages[] = {
+        { 0x02001234, 0x18001234, 0x00002DCC, ATTR_DEVICE_RW },
+        { 0x02005000, 0x18010000, 0x00000234, ATTR_DEVICE_RW },
+    };
+    static const PhysicalRun insideSupersection[] = {
+        { 0x01234000, 0x30234000, 0x00100000, ATTR_STRONGLY_ORDERED },
+    };
+    static const PhysicalRun insideLargePages[] = {
+        { 0x0201F000, 0x1802F000, 0x00002000, ATTR_DEVICE_RW },
+    };
+
+    buildTables();
+
+    expectRuns("whole range", 0, 0x02100000, 32, all, 6, 0x02100000);
+    expectRuns("unaligned range within merged sections", 0x00180800, 0x00100000, 32, unalignedSection, 1, 0x00100000);
+    expectRuns("unaligned range over small pages and a fault", 0x02001234, 0x4000, 32, unalignedPages, 2, 0x4000);
+    expectRuns("range within a supersection", 0x01234000, 0x00100000, 32, insideSupersection, 1, 0x00100000);
+    expectRuns("range over two large pages", 0x0201F000, 0x2000, 32, insideLargePages, 1, 0x2000);
+    expectRuns("unmapped range", 0x00400000, 0x00C00000, 32, NULL, 0, 0x00C00000);
+    expectRuns("full buffer", 0, 0x02100000, 3, all, 3, 0x02000000);
+    expectRuns("no room at all", 0, 0x02100000, 0, NULL, 0, 0x00100000);
+    expectRuns("end of the user address space", 0x3FF00000, 0x00100000, 32, NULL, 0, 0x00100000);
+
+    expectContinuation("continuation, one run at a time", 0, 0x02100000, 1, all, 6);
+    expectContinuation("continuation, two runs at a time", 0, 0x02100000, 2, all, 6);
+    expectContinuation("continuation, big enough buffer", 0, 0x02100000, 16, all, 6);
+
+    return failed ? 1 : 0;
+}
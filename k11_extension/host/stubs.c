@@ -0,0 +1,18 @@
+// What mmu.c references besides the page table walker
+
+#include "types.h"
+#include "kernel.h"
+
+bool isN3DS;
+u32 kernelVersion;
+u8 svcSignalingEnabled;
+
+void KObjectMutex__Acquire(KObjectMutex *this)
+{
+    (void)this;
+}
+
+void KObjectMutex__Release(KObjectMutex *this)
+{
+    (void)this;
+}
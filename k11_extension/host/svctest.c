@@ -0,0 +1,159 @@
+/*
+Runs the real svcConvertVARangeToPA handler (svc/ConvertVARangeToPA.c) on the host: range and handle checks,
+reference counting of the process, copy failures, and ranges with more runs than are translated per MMU walk.
+
+The kernel objects it reads are faked: the core context is mapped at its fixed address (0xFFFF1000), the
+process is a zeroed buffer with an L1 table of sections, and the kernel functions it calls are stubs.
+
+Exits with status 1 if anything doesn't match.
+*/
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+#include "types.h"
+#include "kernel.h"
+#include "svc/ConvertVARangeToPA.h"
+
+#define NUM_SECTIONS    40
+#define FAKE_HANDLE     0x1234
+#define BAD_USER_PTR    ((PhysicalRun *)0x10)
+
+#define ERR_INVALID_ADDRESS 0xE0E01BF5
+#define ERR_INVALID_HANDLE  0xD8E007F7
+
+u32 pidOffsetKProcess, hwInfoOffsetKProcess, codeSetOffsetKProcess, handleTableOffsetKProcess, debugOffsetKProcess, flagsKProcess;
+
+static u32 l1Table[0x1000] __attribute__((aligned(0x4000)));
+static u8 processBuf[0x400] __attribute__((aligned(8)));
+static KProcess *const process = (KProcess *)processBuf;
+static int refCount, numCopies;
+static bool failed;
+
+u32 *hostL2Table(u32 pa)
+{
+    printf("unexpected L2 table at 0x%08X\n", pa);
+    failed = true;
+    return l1Table;
+}
+
+static void addReference(KAutoObject *this)
+{
+    (void)this;
+    refCount++;
+}
+
+static KAutoObject *decrementReferenceCount(KAutoObject *this)
+{
+    refCount--;
+    return this;
+}
+
+static KProcess *toKProcess(KProcessHandleTable *this, Handle processHandle)
+{
+    (void)this;
+    if (processHandle != FAKE_HANDLE)
+        return NULL;
+
+    refCount++;
+    return process;
+}
+
+static bool copyToUser(void *dst, const void *src, u32 len)
+{
+    if (dst == BAD_USER_PTR)
+        return false;
+
+    memcpy(dst, src, len);
+    numCopies++;
+    return true;
+}
+
+void (*KAutoObject__AddReference)(KAutoObject *this) = addReference;
+KProcess * (*KProcessHandleTable__ToKProcess)(KProcessHandleTable *this, Handle processHandle) = toKProcess;
+bool (*kernelToUsrMemcpy8)(void *dst, const void *src, u32 len) = copyToUser;
+
+// Sections alternating between two memory types, so that none of them merge
+static void buildProcess(void)
+{
+    static Vtable__KAutoObject vtable = { .DecrementReferenceCount = decrementReferenceCount };
+
+    for (u32 i = 0; i < NUM_SECTIONS; i++)
+        l1Table[1 + i] = 0b10 | 3 << 10 | (i & 1) << 2 | (0x20000000 + 0x100000 * i);
+
+    ((KAutoObject *)process)->vtable = &vtable;
+    hwInfoOffsetKProcess = 0x100;
+    handleTableOffsetKProcess = 0x300;
+    kernelVersion = SYSTEM_VERSION(2, 46, 0);
+    KPROCESSHWINFO_GET_RVALUE(hwInfoOfProcess(process), mmuTableVA) = l1Table;
+
+    currentCoreContext->objectContext.currentProcess = process;
+}
+
+static void expectCall(const char *name, PhysicalRun *out, u32 maxRuns, Handle handle, u32 va, u32 size, Result expected, int expectedCopies)
+{
+    numCopies = 0;
+    refCount = 0;
+
+    Result res = ConvertVARangeToPA(out, maxRuns, handle, va, size);
+    bool ok = res == expected && refCount == 0 && (expectedCopies < 0 || numCopies == expectedCopies);
+
+    printf("%s: %s\n", name, ok ? "ok" : "FAILED");
+    if (!ok)
+    {
+        printf("    returned 0x%08X (expected 0x%08X), %d references left, %d copies\n", (u32)res, (u32)expected, refCount, numCopies);
+        failed = true;
+    }
+}
+
+static void expectSections(const char *name, const PhysicalRun *runs, u32 first, u32 count)
+{
+    for (u32 i = 0; i < count; i++)
+    {
+        const PhysicalRun *run = &runs[i];
+        u32 s = first + i;
+
+        if (run->va != 0x100000 * (1 + s) || run->pa != 0x20000000 + 0x100000 * s || run->size != 0x100000 || ((run->attributes >> 8) & 1) != (s & 1))
+        {
+            printf("%s: FAILED, run %u is va 0x%08X pa 0x%08X size 0x%08X attributes 0x%05X\n", name, i, run->va, run->pa, run->size, run->attributes);
+            failed = true;
+            return;
+        }
+    }
+}
+
+int main(void)
+{
+    static PhysicalRun runs[64];
+
+    if (mmap(currentCoreContext, sizeof(KCoreContext), PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_FIXED_NOREPLACE, -1, 0) != currentCoreContext)
+    {
+        perror("can't map the core context at its kernel address");
+        return 2;
+    }
+
+    buildProcess();
+
+    expectCall("range wrapping around", runs, 64, CUR_PROCESS_HANDLE, 0xFFF00000, 0x200000, ERR_INVALID_ADDRESS, 0);
+    expectCall("range past the user address space", runs, 64, CUR_PROCESS_HANDLE, 0x3FF00000, 0x200000, ERR_INVALID_ADDRESS, 0);
+    expectCall("invalid handle", runs, 64, 0xDEAD, 0x100000, 0x100000, ERR_INVALID_HANDLE, 0);
+    expectCall("no room for runs", runs, 0, CUR_PROCESS_HANDLE, 0x100000, 0x100000, 0, 0);
+    expectCall("empty range", runs, 64, CUR_PROCESS_HANDLE, 0x100000, 0, 0, 0);
+    expectCall("unmapped range", runs, 64, FAKE_HANDLE, 0x10000000, 0x100000, 0, 0);
+    expectCall("copy to an invalid buffer", BAD_USER_PTR, 64, CUR_PROCESS_HANDLE, 0x100000, 0x100000, ERR_INVALID_ADDRESS, 0);
+
+    memset(runs, 0, sizeof(runs));
+    expectCall("more runs than per walk, through a handle", runs, 64, FAKE_HANDLE, 0, 0x100000 * (NUM_SECTIONS + 8), NUM_SECTIONS, 3);
+    expectSections("more runs than per walk, through a handle", runs, 0, NUM_SECTIONS);
+
+    memset(runs, 0, sizeof(runs));
+    expectCall("buffer smaller than the range", runs, 20, CUR_PROCESS_HANDLE, 0x100000, 0x100000 * NUM_SECTIONS, 20, 2);
+    expectSections("buffer smaller than the range", runs, 0, 20);
+
+    memset(runs, 0, sizeof(runs));
+    expectCall("continuation after the last run", runs, 64, CUR_PROCESS_HANDLE, 0x100000 * 21, 0x100000 * (NUM_SECTIONS - 20), NUM_SECTIONS - 20, 2);
+    expectSections("continuation after the last run", runs, 20, NUM_SECTIONS - 20);
+
+    return failed ? 1 : 0;
+}
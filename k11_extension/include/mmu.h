@@ -3,6 +3,14 @@
 #include "types.h"
 #include "kernel.h"
 
+// Kernel VA of the L2 table at the given PA (as found in coarse page table descriptors)
+#ifndef MMU_L2_TABLE_FROM_PA
+#define MMU_L2_TABLE_FROM_PA(pa)    ((u32 *)((pa) - 0x40000000))
+#endif
+
+// Process MMU tables only cover the user address space
+#define MMU_USER_SPACE_END          0x40000000
+
 typedef struct
 {
     u32     bits1_0 : 2;    ///< 0b00
@@ -117,13 +125,24 @@ typedef enum
     Descriptor_SmallPage
 }   DescType;
 
+/// Physically contiguous part of a VA range, with the same attributes all along
+typedef struct PhysicalRun
+{
+    u32     va;
+    u32     pa;
+    u32     size;
+    u32     attributes; ///< Bits 0-2: user permissions (like L1MMUTable__GetAddressUserPerm), bits 8-12: memory type (TEX[2:0], C, B), bit 16: shared
+}   PhysicalRun;
+
 void    L1MMUTable__RWXForAll(u32 *table);
 void    L2MMUTable__RWXForAll(u32 *table);
 u32     L1MMUTable__GetPAFromVA(u32 *table, u32 va);
 u32     L2MMUTable__GetPAFromVA(u32 *table, u32 va);
 u32     L1MMUTable__GetAddressUserPerm(u32 *table, u32 va);
 u32     L2MMUTable__GetAddressUserPerm(u32 *table, u32 va);
+u32     L1MMUTable__GetPhysicalRuns(u32 *table, PhysicalRun *out, u32 maxRuns, u32 va, u32 size, u32 *outWalkedSize);
 
 void    KProcessHwInfo__SetMMUTableToRWX(KProcessHwInfo *hwInfo);
 u32     KProcessHwInfo__GetPAFromVA(KProcessHwInfo *hwInfo, u32 va);
 u32     KProcessHwInfo__GetAddressUserPerm(KProcessHwInfo *hwInfo, u32 va);
+u32     KProcessHwInfo__GetPhysicalRuns(KProcessHwInfo *hwInfo, PhysicalRun *out, u32 maxRuns, u32 va, u32 size, u32 *outWalkedSize);
@@ -41,7 +41,7 @@ void    L1MMUTable__RWXForAll(u32 *table)
         {
             case Descriptor_CoarsePageTable:
             {
-                u32     *l2table = (u32 *)((descriptor.coarsePageTable.addr << 10) - 0x40000000);
+                u32     *l2table = MMU_L2_TABLE_FROM_PA(descriptor.coarsePageTable.addr << 10);
 
                 L2MMUTable__RWXForAll(l2table);
                 break;
@@ -108,7 +108,7 @@ u32     L1MMUTable__GetPAFromVA(u32 *table, u32 va)
     {
         case Descriptor_CoarsePageTable:
         {
-            u32     *l2table = (u32 *)((descriptor.coarsePageTable.addr << 10) - 0x40000000);
+            u32     *l2table = MMU_L2_TABLE_FROM_PA(descriptor.coarsePageTable.addr << 10);
 
             pa = L2MMUTable__GetPAFromVA(l2table, va);
             break;
@@ -168,7 +168,7 @@ u32     L1MMUTable__GetAddressUserPerm(u32 *table, u32 va)
     {
         case Descriptor_CoarsePageTable:
         {
-            u32     *l2table = (u32 *)((descriptor.coarsePageTable.addr << 10) - 0x40000000);
+            u32     *l2table = MMU_L2_TABLE_FROM_PA(descriptor.coarsePageTable.addr << 10);
 
             perm = L2MMUTable__GetAddressUserPerm(l2table, va);
             break;
@@ -237,6 +237,124 @@ u32     L2MMUTable__GetAddressUserPerm(u32 *table, u32 va)
     return perm;
 }
 
+static u32  PhysicalRun__MakeAttributes(u32 ap, u32 apx, u32 xn, u32 tex, u32 c, u32 b, u32 s)
+{
+    u32     perm = ap >> 1;
+
+    if (perm)
+    {
+        perm |= (!apx && (ap & 1)) << 1;
+        perm |= (!xn) << 2;
+    }
+
+    return perm | ((tex << 2 | c << 1 | b) << 8) | (s << 16);
+}
+
+// Returns whether va is mapped, and the size of the (aligned) block of the descriptor it belongs to, mapped or not
+static bool L1MMUTable__GetMapping(u32 *table, u32 va, u32 *outBlockSize, u32 *outPa, u32 *outAttributes)
+{
+    L1Descriptor    descriptor = {table[va >> 20]};
+
+    *outBlockSize = 1 << 20;
+
+    switch (L1Descriptor__GetType(descriptor.raw))
+    {
+        case Descriptor_CoarsePageTable:
+        {
+            u32             *l2table = MMU_L2_TABLE_FROM_PA(descriptor.coarsePageTable.addr << 10);
+            L2Descriptor    l2descriptor = {l2table[(va << 12) >> 24]};
+
+            *outBlockSize = 1 << 12;
+
+            switch (L2Descriptor__GetType(l2descriptor.raw))
+            {
+                case Descriptor_LargePage:
+                {
+                    Desc_LargePage  *page = &l2descriptor.largePage;
+
+                    *outBlockSize = 1 << 16;
+                    *outPa = (page->addr << 16) | (va & 0xFFFF);
+                    *outAttributes = PhysicalRun__MakeAttributes(page->ap, page->apx, page->xn, page->tex, page->c, page->b, page->s);
+                    return true;
+                }
+                case Descriptor_SmallPage:
+                {
+                    Desc_SmallPage  *page = &l2descriptor.smallPage;
+
+                    *outPa = (page->addr << 12) | (va & 0xFFF);
+                    *outAttributes = PhysicalRun__MakeAttributes(page->ap, page->apx, page->xn, page->tex, page->c, page->b, page->s);
+                    return true;
+                }
+                default:
+                    return false;
+            }
+        }
+        case Descriptor_Section:
+        {
+            Desc_Section    *section = &descriptor.section;
+
+            *outPa = (section->addr << 20) | ((va << 12) >> 12);
+            *outAttributes = PhysicalRun__MakeAttributes(section->ap, section->apx, section->xn, section->tex, section->c, section->b, section->s);
+            return true;
+        }
+        case Descriptor_Supersection:
+        {
+            Desc_Supersection   *supersection = &descriptor.supersection;
+
+            // Like L1MMUTable__GetAddressUserPerm, ignore APX and S (sbz here)
+            *outBlockSize = 1 << 24;
+            *outPa = (supersection->addr << 24) | ((va << 8) >> 8);
+            *outAttributes = PhysicalRun__MakeAttributes(supersection->ap, 0, supersection->xn, supersection->tex, supersection->c, supersection->b, 0);
+            return true;
+        }
+        default:
+            return false;
+    }
+}
+
+// Translates [va, va + size) (within the user address space) into at most maxRuns runs, unmapped parts being skipped.
+// Stops early when a new run doesn't fit, so that the last run is always complete: the rest of the range starts at va + *outWalkedSize
+u32     L1MMUTable__GetPhysicalRuns(u32 *table, PhysicalRun *out, u32 maxRuns, u32 va, u32 size, u32 *outWalkedSize)
+{
+    u32     numRuns = 0;
+    u32     walked = 0;
+
+    while (walked < size)
+    {
+        u32     curVa = va + walked;
+        u32     blockSize = 0, pa = 0, attributes = 0;
+        bool    mapped = L1MMUTable__GetMapping(table, curVa, &blockSize, &pa, &attributes);
+        u32     chunkSize = blockSize - (curVa & (blockSize - 1));
+
+        if (chunkSize > size - walked)
+            chunkSize = size - walked;
+
+        if (mapped)
+        {
+            PhysicalRun *last = numRuns != 0 ? &out[numRuns - 1] : NULL;
+
+            if (last != NULL && last->va + last->size == curVa && last->pa + last->size == pa && last->attributes == attributes)
+                last->size += chunkSize;
+            else if (numRuns == maxRuns)
+                break;
+            else
+            {
+                out[numRuns].va = curVa;
+                out[numRuns].pa = pa;
+                out[numRuns].size = chunkSize;
+                out[numRuns].attributes = attributes;
+                ++numRuns;
+            }
+        }
+
+        walked += chunkSize;
+    }
+
+    *outWalkedSize = walked;
+
+    return numRuns;
+}
+
 void    KProcessHwInfo__SetMMUTableToRWX(KProcessHwInfo *hwInfo)
 {
     KObjectMutex    *mutex = KPROCESSHWINFO_GET_PTR(hwInfo, mutex);
@@ -277,6 +395,20 @@ u32     KProcessHwInfo__GetAddressUserPerm(KProcessHwInfo *hwInfo, u32 va)
     return perm;
 }
 
+u32     KProcessHwInfo__GetPhysicalRuns(KProcessHwInfo *hwInfo, PhysicalRun *out, u32 maxRuns, u32 va, u32 size, u32 *outWalkedSize)
+{
+    KObjectMutex    *mutex = KPROCESSHWINFO_GET_PTR(hwInfo, mutex);
+    u32             *table = KPROCESSHWINFO_GET_RVALUE(hwInfo, mmuTableVA);
+
+    KObjectMutex__Acquire(mutex);
+
+    u32 numRuns = L1MMUTable__GetPhysicalRuns(table, out, maxRuns, va, size, outWalkedSize);
+
+    KObjectMutex__Release(mutex);
+
+    return numRuns;
+}
+
 static union
 {
     u32     raw;
@@ -49,6 +49,7 @@
 #include "svc/CopyHandle.h"
 #include "svc/TranslateHandle.h"
 #include "svc/ControlMemoryUnsafe.h"
+#include "svc/ConvertVARangeToPA.h"
 
 void *officialSVCs[0x7E] = {NULL};
 void *alteredSvcTable[0x100] = {NULL};
@@ -93,6 +94,7 @@ void buildAlteredSvcTable(void)
     alteredSvcTable[0x92] = flushEntireDataCache;
     alteredSvcTable[0x93] = invalidateInstructionCacheRange;
     alteredSvcTable[0x94] = invalidateEntireInstructionCache;
+    alteredSvcTable[0x95] = ConvertVARangeToPAWrapper;
 
     alteredSvcTable[0xA0] = MapProcessMemoryExWrapper;
     alteredSvcTable[0xA1] = UnmapProcessMemoryEx;
@@ -0,0 +1,77 @@
+/*
+*   This file is part of Luma3DS
+*   Copyright (C) 2016-2020 Aurora Wright, TuxSH
+*
+*   This program is free software: you can redistribute it and/or modify
+*   it under the terms of the GNU General Public License as published by
+*   the Free Software Foundation, either version 3 of the License, or
+*   (at your option) any later version.
+*
+*   This program is distributed in the hope that it will be useful,
+*   but WITHOUT ANY WARRANTY; without even the implied warranty of
+*   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*   GNU General Public License for more details.
+*
+*   You should have received a copy of the GNU General Public License
+*   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*
+*   Additional Terms 7.b and 7.c of GPLv3 apply to this file:
+*       * Requiring preservation of specified reasonable legal notices or
+*         author attributions in that material or in the Appropriate Legal
+*         Notices displayed by works containing it.
+*       * Prohibiting misrepresentation of the origin of that material,
+*         or requiring that modified versions of such material be marked in
+*         reasonable ways as different from the original version.
+*/
+
+#include "svc/ConvertVARangeToPA.h"
+
+// Number of runs translated per acquisition of the MMU table mutex, also bounds the stack usage
+#define RUNS_PER_WALK   16
+
+// Returns the number of runs written; fewer than maxRuns means the whole range was translated,
+// otherwise the translation of the rest of the range starts after the last run
+Result  ConvertVARangeToPA(PhysicalRun *out, u32 maxRuns, Handle processHandle, u32 va, u32 size)
+{
+    Result              res = 0;
+    KProcess            *process;
+    KProcessHandleTable *handleTable = handleTableOfProcess(currentCoreContext->objectContext.currentProcess);
+    PhysicalRun         runs[RUNS_PER_WALK];
+    u32                 numRuns = 0;
+
+    if (va + size < va || va + size > MMU_USER_SPACE_END)
+        return 0xE0E01BF5; // invalid address
+
+    if (processHandle == CUR_PROCESS_HANDLE)
+    {
+        process = currentCoreContext->objectContext.currentProcess;
+        KAutoObject__AddReference((KAutoObject *)process);
+    }
+    else
+        process = KProcessHandleTable__ToKProcess(handleTable, processHandle);
+
+    if (process == NULL)
+        return 0xD8E007F7; // invalid handle
+
+    while (size != 0 && numRuns < maxRuns)
+    {
+        u32 walkedSize;
+        u32 maxWalkRuns = maxRuns - numRuns < RUNS_PER_WALK ? maxRuns - numRuns : RUNS_PER_WALK;
+        u32 walkRuns = KProcessHwInfo__GetPhysicalRuns(hwInfoOfProcess(process), runs, maxWalkRuns, va, size, &walkedSize);
+
+        // Copied outside of the MMU table lock (the output buffer may belong to the same process)
+        if (walkRuns != 0 && !kernelToUsrMemcpy8(out + numRuns, runs, walkRuns * sizeof(PhysicalRun)))
+        {
+            res = 0xE0E01BF5; // invalid address
+            break;
+        }
+
+        numRuns += walkRuns;
+        va += walkedSize;
+        size -= walkedSize;
+    }
+
+    ((KAutoObject *)process)->vtable->DecrementReferenceCount((KAutoObject *)process);
+
+    return res < 0 ? res : (Result)numRuns;
+}
@@ -115,6 +115,15 @@ ControlMemoryUnsafeWrapper:
     add sp, #4
     pop {pc}
 
+.global ConvertVARangeToPAWrapper
+.type   ConvertVARangeToPAWrapper, %function
+ConvertVARangeToPAWrapper:
+    push {lr}
+    str r4, [sp, #-4]!
+    bl ConvertVARangeToPA
+    add sp, #4
+    pop {pc}
+
 .global MapProcessMemoryExWrapper
 .type   MapProcessMemoryExWrapper, %function
 MapProcessMemoryExWrapper:
@@ -0,0 +1,496 @@
+/*
+Runs the real 3DSX loader (3dsx.c) of hbldr on real-sized homebrew: small, medium and large (emulator or port sized)
+generated files, one without a BSS (too little scratch space to buffer its relocations at once), and any 3DSX files
+given on the command line. Each file is loaded from the in-memory SD card into code pages at hbldr's address, by
+the current loader and by the one it replaced (kept below), and both must produce the same memory image and codeset.
+
+Also covered: truncated files, and an unsupported relocation subtype.
+
+Prints the number of file reads and the time taken by each loader. Exits with status 1 if anything doesn't match.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "stubs.h"
+#include "patcher.h"
+#include "3dsx.h"
+
+#define CODE_PAGES      0x10000000  // See hbldr.c
+#define BASE_ADDRESS    0x00100000
+#define RUNS            5
+
+static bool failed;
+
+static void expect(const char *name, bool ok)
+{
+    if (!ok)
+    {
+        printf("    %s: FAILED\n", name);
+        failed = true;
+    }
+}
+
+static double elapsedMs(const struct timespec *start)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (now.tv_sec - start->tv_sec) * 1e3 + (now.tv_nsec - start->tv_nsec) / 1e6;
+}
+
+/* The loader as it was before it read the file in a few large requests */
+
+#define MAXRELOCS 512
+static _3DSX_Reloc s_relocBuf[MAXRELOCS];
+
+typedef struct
+{
+    void* segPtrs[3]; // code, rodata & data
+    u32 segAddrs[3];
+    u32 segSizes[3];
+} _3DSX_LoadInfo;
+
+static inline u32 TranslateAddr(u32 off, _3DSX_LoadInfo* d, u32* offsets)
+{
+    if (off < offsets[0])
+        return d->segAddrs[0] + off;
+    if (off < offsets[1])
+        return d->segAddrs[1] + off - offsets[0];
+    return d->segAddrs[2] + off - offsets[1];
+}
+
+static Handle Ldr_CodesetFrom3dsxBefore(const char* name, u32* codePages, u32 baseAddr, IFile *file, u64 tid)
+{
+    u32 i,j,k,m;
+    Result res;
+    _3DSX_Header hdr;
+    IFile_Read2(file, &hdr, sizeof(hdr), 0);
+
+    _3DSX_LoadInfo d;
+    d.segSizes[0] = (hdr.codeSegSize+0xFFF) &~ 0xFFF;
+    d.segSizes[1] = (hdr.rodataSegSize+0xFFF) &~ 0xFFF;
+    d.segSizes[2] = (hdr.dataSegSize+0xFFF) &~ 0xFFF;
+    d.segPtrs[0] = codePages;
+    d.segPtrs[1] = (char*)d.segPtrs[0] + d.segSizes[0];
+    d.segPtrs[2] = (char*)d.segPtrs[1] + d.segSizes[1];
+    d.segAddrs[0] = baseAddr;
+    d.segAddrs[1] = d.segAddrs[0] + d.segSizes[0];
+    d.segAddrs[2] = d.segAddrs[1] + d.segSizes[1];
+
+    u32 offsets[2] = { d.segSizes[0], d.segSizes[0] + d.segSizes[1] };
+    u32* segLimit = d.segPtrs[2] + d.segSizes[2];
+
+    u32 readOffset = hdr.headerSize;
+
+    u32 nRelocTables = hdr.relocHdrSize/4;
+    if ((3*4*nRelocTables) > 0x1000)
+        return 0;
+    u32* extraPage = (u32*)((char*)d.segPtrs[2] + d.segSizes[2]);
+    u32 extraPageAddr = d.segAddrs[2] + d.segSizes[2];
+
+    // Read the relocation headers
+    for (i = 0; i < 3; i ++)
+    {
+        if (IFile_Read2(file, &extraPage[i*nRelocTables], hdr.relocHdrSize, readOffset) != hdr.relocHdrSize)
+            return 0;
+        readOffset += hdr.relocHdrSize;
+    }
+
+    // Read the code segment
+    if (IFile_Read2(file, d.segPtrs[0], hdr.codeSegSize, readOffset) != hdr.codeSegSize)
+        return 0;
+    readOffset += hdr.codeSegSize;
+
+    // Read the rodata segment
+    if (IFile_Read2(file, d.segPtrs[1], hdr.rodataSegSize, readOffset) != hdr.rodataSegSize)
+        return 0;
+    readOffset += hdr.rodataSegSize;
+
+    // Read the data segment
+    u32 dataLoadSegSize = hdr.dataSegSize - hdr.bssSize;
+    if (IFile_Read2(file, d.segPtrs[2], dataLoadSegSize, readOffset) != dataLoadSegSize)
+        return 0;
+    readOffset += dataLoadSegSize;
+
+    // Relocate the segments
+    for (i = 0; i < 3; i ++)
+    {
+        for (j = 0; j < nRelocTables; j ++)
+        {
+            int nRelocs = extraPage[i*nRelocTables + j];
+            if (j >= (sizeof(_3DSX_RelocHdr)/4))
+            {
+                // Not using this header
+                readOffset += nRelocs;
+                continue;
+            }
+
+            u32* pos = (u32*)d.segPtrs[i];
+            u32* endPos = pos + (d.segSizes[i]/4);
+            if (endPos > segLimit)
+                return 0;
+
+            while (nRelocs)
+            {
+                u32 toDo = nRelocs > MAXRELOCS ? MAXRELOCS : nRelocs;
+                nRelocs -= toDo;
+
+                u32 readSize = toDo*sizeof(_3DSX_Reloc);
+                if (IFile_Read2(file, s_relocBuf, readSize, readOffset) != readSize)
+                    return 0;
+                readOffset += readSize;
+
+                for (k = 0; k < toDo && pos < endPos; k ++)
+                {
+                    pos += s_relocBuf[k].skip;
+                    u32 nPatches = s_relocBuf[k].patch;
+                    for (m = 0; m < nPatches && pos < endPos; m ++)
+                    {
+                        u32 inAddr = baseAddr + 4*(pos - codePages);
+                        u32 origData = *pos;
+                        u32 subType = origData >> (32-4);
+                        u32 addr = TranslateAddr(origData &~ 0xF0000000, &d, offsets);
+                        switch (j)
+                        {
+                            case 0:
+                            {
+                                if (subType != 0)
+                                    return 0;
+                                *pos = addr;
+                                break;
+                            }
+                            case 1:
+                            {
+                                u32 data = addr - inAddr;
+                                switch (subType)
+                                {
+                                    case 0: *pos = data;            break; // 32-bit signed offset
+                                    case 1: *pos = data &~ BIT(31); break; // 31-bit signed offset
+                                    default:
+                                        return 0;
+                                }
+                                break;
+                            }
+                        }
+                        pos++;
+                    }
+                }
+            }
+        }
+    }
+
+    // Detect and fill _prm structure
+    PrmStruct* pst = (PrmStruct*) &codePages[1];
+    if (pst->magic == _PRM_MAGIC)
+    {
+        memset(extraPage, 0, 0x1000);
+        memcpy(extraPage, ldrArgvBuf, sizeof(ldrArgvBuf));
+        pst->pSrvOverride = extraPageAddr + 0xFFC;
+        pst->pArgList = extraPageAddr;
+        pst->runFlags |= RUNFLAG_APTCHAINLOAD;
+        s64 dummy;
+        bool isN3DS = svcGetSystemInfo(&dummy, 0x10001, 0) == 0;
+        if (isN3DS)
+        {
+            pst->heapSize = 48*1024*1024;
+            pst->linearHeapSize = 64*1024*1024;
+        } else
+        {
+            pst->heapSize = 24*1024*1024;
+            pst->linearHeapSize = 32*1024*1024;
+        }
+    }
+
+    // Create the codeset
+    CodeSetHeader csh;
+    memset(&csh, 0, sizeof(csh));
+    memcpy(csh.name, name, 8);
+    csh.program_id      = tid;
+    csh.text_addr       = d.segAddrs[0];
+    csh.text_size       = d.segSizes[0] >> 12;
+    csh.ro_addr         = d.segAddrs[1];
+    csh.ro_size         = d.segSizes[1] >> 12;
+    csh.rw_addr         = d.segAddrs[2];
+    csh.rw_size         = (d.segSizes[2] >> 12) + 1; // One extra page reserved for settings/etc
+    csh.text_size_total = csh.text_size;
+    csh.ro_size_total   = csh.ro_size;
+    csh.rw_size_total   = csh.rw_size;
+    Handle hCodeset = 0;
+    res = svcCreateCodeSet(&hCodeset, &csh, (u32)d.segPtrs[0], (u32)d.segPtrs[1], (u32)d.segPtrs[2]);
+    if (res)
+        return 0;
+
+    return hCodeset;
+}
+
+/* Generated files */
+
+typedef struct Preset
+{
+    const char *name;
+    u32 sizes[3];           ///< Code, rodata, data (including the BSS)
+    u32 bssSize;
+    u32 densities[3];       ///< Absolute relocations per KiB of each segment
+} Preset;
+
+// As many relocations as the homebrew built with devkitARM, relative ones being rare (a few per 64 KiB of code)
+static const Preset presets[] = {
+    { "small",  { 0x40000,  0x10000,  0x28000  }, 0x20000,  { 2, 24, 24 } },
+    { "medium", { 0x200000, 0x80000,  0x140000 }, 0x100000, { 2, 24, 24 } },
+    { "large",  { 0xA00000, 0x300000, 0x980000 }, 0x800000, { 3, 32, 32 } },
+    { "no BSS", { 0x200000, 0x80000,  0x140000 }, 0,        { 2, 24, 24 } },
+};
+
+#define RELATIVE_SKIP   0x1000  ///< Average number of words between two relative relocations
+
+static u32 rngState;
+
+static u32 rng(void)
+{
+    rngState = rngState * 1103515245 + 12345;
+    return rngState >> 8;
+}
+
+// Writes relocation entries for a segment of numWords words (the first firstSkip untouched), meanSkip words apart
+// on average, and sets the patched words to offsets below total. Returns the number of entries.
+static u32 generateRelocs(_3DSX_Reloc *out, u8 *seg, u32 numWords, u32 meanSkip, u32 firstSkip, u32 total)
+{
+    static const u16 patchCounts[] = { 1, 1, 1, 2, 4 };
+    u32 numRelocs = 0;
+
+    for (u32 pos = 0; ; )
+    {
+        u32 skip = rng() % (2 * meanSkip + 1) + (numRelocs == 0 ? firstSkip : 0);
+        u32 patch = patchCounts[rng() % 5];
+
+        skip = skip > 0xFFFF ? 0xFFFF : skip;
+        if (pos + skip + patch > numWords)
+            return numRelocs;
+
+        pos += skip;
+        out[numRelocs++] = (_3DSX_Reloc){ (u16)skip, (u16)patch };
+        for (u32 i = 0; i < patch; i++, pos++)
+        {
+            u32 target = (((rng() << 8) ^ rng()) % total) &~ 3;
+            memcpy(seg + 4 * pos, &target, 4);
+        }
+    }
+}
+
+// Builds a 3DSX file with a _prm structure, absolute relocations in every segment and relative ones in the code
+static u8 *generate(const Preset *preset, u32 *outSize)
+{
+    u32 loadSizes[3] = { preset->sizes[0], preset->sizes[1], preset->sizes[2] - preset->bssSize };
+    u32 total = 0;
+    for (u32 i = 0; i < 3; i++)
+        total += (preset->sizes[i] + 0xFFF) &~ 0xFFF;
+
+    u32 loadSize = loadSizes[0] + loadSizes[1] + loadSizes[2];
+    u8 *file = calloc(1, sizeof(_3DSX_Header) + 3 * sizeof(_3DSX_RelocHdr) + loadSize + loadSize / 4 * sizeof(_3DSX_Reloc));
+    _3DSX_Header *hdr = (_3DSX_Header *)file;
+    _3DSX_RelocHdr *relocHdrs = (_3DSX_RelocHdr *)(file + sizeof(_3DSX_Header));
+    u8 *segs[3];
+
+    rngState = 1;
+    *hdr = (_3DSX_Header){ _3DSX_MAGIC, sizeof(_3DSX_Header), sizeof(_3DSX_RelocHdr), 0, 0,
+        preset->sizes[0], preset->sizes[1], preset->sizes[2], preset->bssSize };
+
+    for (u32 i = 0; i < 3; i++)
+    {
+        segs[i] = i == 0 ? (u8 *)(relocHdrs + 3) : segs[i - 1] + loadSizes[i - 1];
+        for (u32 j = 0; j < loadSizes[i] / 4; j++)
+        {
+            u32 word = rng();
+            memcpy(segs[i] + 4 * j, &word, 4);
+        }
+    }
+
+    PrmStruct prm = { .magic = _PRM_MAGIC };
+    memcpy(segs[0] + 4, &prm, sizeof(prm));
+
+    // Each segment's absolute then relative table; the code's first words hold the entry point and _prm
+    _3DSX_Reloc *relocs = (_3DSX_Reloc *)(segs[2] + loadSizes[2]);
+    for (u32 i = 0; i < 3; i++)
+    {
+        u32 firstSkip = i == 0 ? 8 : 0;
+        relocHdrs[i].cAbsolute = generateRelocs(relocs, segs[i], loadSizes[i] / 4, 256 / preset->densities[i], firstSkip, total);
+        relocs += relocHdrs[i].cAbsolute;
+        relocHdrs[i].cRelative = i == 0 ? generateRelocs(relocs, segs[i], loadSizes[i] / 4, RELATIVE_SKIP, firstSkip, total) : 0;
+        relocs += relocHdrs[i].cRelative;
+    }
+
+    *outSize = (u8 *)relocs - file;
+    return file;
+}
+
+/* Loading */
+
+typedef struct Load
+{
+    Handle codeset;
+    CodeSetHeader codeSetHeader;
+    u32 numReads;
+    double ms;      ///< Fastest of the runs
+    u8 *image;
+} Load;
+
+static Load load(Handle (*loader)(const char *, u32 *, u32, IFile *, u64), const char *path)
+{
+    Load res = { .ms = 1e9 };
+    IFile file;
+    u32 size = 0, addr;
+
+    for (u32 run = 0; run < RUNS; run++)
+    {
+        if (R_FAILED(IFile_Open(&file, ARCHIVE_SDMC, fsMakePath(PATH_EMPTY, ""), fsMakePath(PATH_ASCII, path), FS_OPEN_READ)))
+            break;
+        if (!Ldr_Get3dsxSize(&size, &file))
+        {
+            IFile_Close(&file);
+            break;
+        }
+
+        svcControlMemory(&addr, CODE_PAGES, 0, size, MEMOP_ALLOC | MEMOP_REGION_APP, MEMPERM_READ | MEMPERM_WRITE);
+        memset(&g_simCodeSet, 0, sizeof(g_simCodeSet));
+        u32 numReads = g_simFsCounts.fileReads;
+
+        struct timespec start;
+        clock_gettime(CLOCK_MONOTONIC, &start);
+        res.codeset = loader("3dsxtest", (u32 *)(uintptr_t)addr, BASE_ADDRESS, &file, 0x000400000D921E00ULL);
+        double ms = elapsedMs(&start);
+
+        res.numReads = g_simFsCounts.fileReads - numReads;
+        res.ms = ms < res.ms ? ms : res.ms;
+        res.codeSetHeader = g_simCodeSet;
+        IFile_Close(&file);
+
+        if (run == RUNS - 1)
+        {
+            res.image = malloc(size);
+            memcpy(res.image, (void *)(uintptr_t)addr, size);
+        }
+        svcControlMemory(&addr, CODE_PAGES, 0, size, MEMOP_FREE, 0);
+    }
+
+    return res;
+}
+
+static void compare(const char *name, u32 fileSize)
+{
+    char path[SIM_MAX_PATH];
+    IFile file;
+    u32 size = 0;
+
+    snprintf(path, sizeof(path), "/3ds/%s.3dsx", name);
+    IFile_Open(&file, ARCHIVE_SDMC, fsMakePath(PATH_EMPTY, ""), fsMakePath(PATH_ASCII, path), FS_OPEN_READ);
+    bool valid = Ldr_Get3dsxSize(&size, &file);
+    IFile_Close(&file);
+
+    const SimFile *simFile = simFsFind(ARCHIVE_SDMC, path);
+    const _3DSX_Header *hdr = (const _3DSX_Header *)simFile->data;
+    u32 numRelocs = 0;
+    for (u32 i = 0; valid && i < 3 * hdr->relocHdrSize / 4; i++)
+        numRelocs += ((const u32 *)(simFile->data + hdr->headerSize))[i];
+
+    Load before = load(Ldr_CodesetFrom3dsxBefore, path), now = load(Ldr_CodesetFrom3dsx, path);
+
+    printf("%s: %u KiB, %u relocations, before: %u reads, %.2f ms, now: %u reads, %.2f ms\n", name, fileSize / 1024,
+        numRelocs, before.numReads, before.ms, now.numReads, now.ms);
+
+    expect("loaded", valid && before.codeset != 0 && now.codeset != 0);
+    expect("same codeset", memcmp(&before.codeSetHeader, &now.codeSetHeader, sizeof(CodeSetHeader)) == 0);
+    expect("same image", before.image != NULL && now.image != NULL && memcmp(before.image, now.image, size) == 0);
+
+    free(before.image);
+    free(now.image);
+}
+
+static void generated(void)
+{
+    for (u32 i = 0; i < sizeof(presets) / sizeof(presets[0]); i++)
+    {
+        char path[SIM_MAX_PATH];
+        u32 size;
+        u8 *file = generate(&presets[i], &size);
+
+        snprintf(path, sizeof(path), "/3ds/%s.3dsx", presets[i].name);
+        simFsAddFile(ARCHIVE_SDMC, path, file, size);
+        compare(presets[i].name, size);
+        free(file);
+    }
+}
+
+static void given(const char *hostPath)
+{
+    FILE *f = fopen(hostPath, "rb");
+    if (f == NULL)
+    {
+        perror(hostPath);
+        failed = true;
+        return;
+    }
+
+    fseek(f, 0, SEEK_END);
+    u32 size = ftell(f);
+    u8 *data = malloc(size);
+    rewind(f);
+    bool ok = fread(data, 1, size, f) == size;
+    fclose(f);
+
+    const char *name = strrchr(hostPath, '/') != NULL ? strrchr(hostPath, '/') + 1 : hostPath;
+    char simName[64], path[SIM_MAX_PATH];
+    snprintf(simName, sizeof(simName), "%.*s", (int)(strlen(name) > 5 ? strlen(name) - 5 : strlen(name)), name);
+    snprintf(path, sizeof(path), "/3ds/%s.3dsx", simName);
+
+    if (ok)
+    {
+        simFsAddFile(ARCHIVE_SDMC, path, data, size);
+        compare(simName, size);
+    }
+    free(data);
+}
+
+static void invalid(void)
+{
+    u32 size;
+    u8 *file = generate(&presets[0], &size);
+    _3DSX_Header *hdr = (_3DSX_Header *)file;
+
+    printf("Invalid files:\n");
+
+    // Cut in the middle of the segments, then of the relocations
+    static const u32 cuts[] = { 0x20000, 0 };
+    for (u32 i = 0; i < 2; i++)
+    {
+        simFsAddFile(ARCHIVE_SDMC, "/3ds/cut.3dsx", file, cuts[i] != 0 ? cuts[i] : size - 6);
+        expect("truncated", load(Ldr_CodesetFrom3dsx, "/3ds/cut.3dsx").codeset == 0);
+    }
+
+    // Absolute relocation with a subtype
+    u32 relocsOffset = sizeof(_3DSX_Header) + 3 * sizeof(_3DSX_RelocHdr) + hdr->codeSegSize + hdr->rodataSegSize + hdr->dataSegSize - hdr->bssSize;
+    _3DSX_Reloc first;
+    memcpy(&first, file + relocsOffset, sizeof(first));
+    file[sizeof(_3DSX_Header) + 3 * sizeof(_3DSX_RelocHdr) + 4 * first.skip + 3] |= 0x20;
+    simFsAddFile(ARCHIVE_SDMC, "/3ds/subtype.3dsx", file, size);
+    expect("unsupported subtype", load(Ldr_CodesetFrom3dsx, "/3ds/subtype.3dsx").codeset == 0 &&
+        load(Ldr_CodesetFrom3dsxBefore, "/3ds/subtype.3dsx").codeset == 0);
+
+    free(file);
+}
+
+int main(int argc, char **argv)
+{
+    simFsReset();
+    isN3DS = true;
+    ldrArgvBuf[0] = 1;
+    strcpy((char *)&ldrArgvBuf[1], "sdmc:/3ds/test.3dsx");
+
+    generated();
+    for (int i = 1; i < argc; i++)
+        given(argv[i]);
+    invalid();
+
+    printf(failed ? "FAILED\n" : "ok\n");
+    return failed ? 1 : 0;
+}
@@ -0,0 +1,241 @@
+#pragma once
+
+// Just what patcher.c, bps_patcher.cpp, patch_cache.c, title_index.c, title_settings.c, ifile.c, 3dsx.c, paslr.c and
+// loader.c use, see stubs.c
+
+#include <3ds/types.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define R_SUCCEEDED(res)            ((res) >= 0)
+#define R_FAILED(res)               ((res) < 0)
+
+#define MAKERESULT(level, summary, module, description) \
+    ((((level) & 0x1F) << 27) | (((summary) & 0x3F) << 21) | (((module) & 0xFF) << 10) | ((description) & 0x3FF))
+#define R_LEVEL(res)                (((res) >> 27) & 0x1F)
+#define RL_SUCCESS                  0
+#define RL_PERMANENT                27
+#define RS_INVALIDARG               7
+#define RM_KERNEL                   1
+
+#define SYSCLOCK_ARM11              268111856
+
+#define USERBREAK_PANIC             0
+#define USERBREAK_ASSERT            1
+
+// The shared config page, see stubs.c
+extern u8 g_sharedConfigPage[0x1000];
+#define OS_SHAREDCFG_VADDR          ((uintptr_t)g_sharedConfigPage)
+
+typedef enum {
+    ARCHIVE_SDMC                = 9,
+    ARCHIVE_NAND_RW             = 0x1234567D,
+    ARCHIVE_SAVEDATA_AND_CONTENT2 = 0x2345678E,
+} FS_ArchiveID;
+
+typedef enum {
+    MEDIATYPE_NAND              = 0,
+    MEDIATYPE_SD                = 1,
+    MEDIATYPE_GAME_CARD         = 2,
+} FS_MediaType;
+
+typedef struct {
+    u64 programId;
+    FS_MediaType mediaType : 8;
+    u8 padding[7];
+} FS_ProgramInfo;
+
+typedef u64 FS_Archive;
+typedef struct {
+    u32 type;
+    u32 size;
+    const void *data;
+} FS_Path;
+
+#define PATH_EMPTY                  1
+#define PATH_BINARY                 2
+#define PATH_ASCII                  3
+
+#define FS_OPEN_READ                BIT(0)
+#define FS_OPEN_WRITE               BIT(1)
+#define FS_OPEN_CREATE              BIT(2)
+#define FS_WRITE_FLUSH              BIT(0)
+
+#define FS_ATTRIBUTE_DIRECTORY      BIT(0)
+
+typedef struct {
+    u16 name[0x106];
+    char shortName[0x0A];
+    char shortExt[0x04];
+    u8 valid;
+    u8 reserved;
+    u32 attributes;
+    u64 fileSize;
+} FS_DirectoryEntry;
+
+typedef struct {
+    u32 address;
+    u32 num_pages;
+    u32 size;
+} ExHeader_CodeSectionInfo;
+
+typedef struct {
+    u8 reserved[5];
+    bool compress_exefs_code : 1;
+    bool is_sd_application : 1;
+    u16 remaster_version;
+} ExHeader_SystemInfoFlags;
+
+typedef struct {
+    char name[8];
+    ExHeader_SystemInfoFlags flags;
+    ExHeader_CodeSectionInfo text;
+    u32 stack_size;
+    ExHeader_CodeSectionInfo rodata;
+    u32 reserved;
+    ExHeader_CodeSectionInfo data;
+    u32 bss_size;
+} ExHeader_CodeSetInfo;
+
+typedef struct {
+    u32 core_version;
+    bool use_cpu_clockrate_804MHz : 1;
+    bool enable_l2c : 1;
+    u8 flags1_unused : 6;
+    u8 n3ds_system_mode : 4;
+    u8 flags2_unused : 4;
+    u8 ideal_processor : 2;
+    u8 affinity_mask : 2;
+    u8 o3ds_system_mode : 4;
+    s8 priority;
+} ExHeader_Arm11CoreInfo;
+
+// The dependencies, storage info, service access list etc. are left out
+typedef struct {
+    ExHeader_CodeSetInfo codeset_info;
+    u8 reserved[0x1C0];
+} ExHeader_SystemControlInfo;
+
+typedef struct {
+    u64 title_id;
+    ExHeader_Arm11CoreInfo core_info;
+    u8 reserved[0x160];
+} ExHeader_Arm11SystemLocalCapabilities;
+
+typedef struct {
+    u32 descriptors[28];
+    u8 reserved[0x10];
+} ExHeader_Arm11KernelCapabilities;
+
+typedef struct {
+    ExHeader_Arm11SystemLocalCapabilities local_caps;
+    ExHeader_Arm11KernelCapabilities kernel_caps;
+    u8 access_control[0x10];
+} ExHeader_AccessControlInfo;
+
+typedef struct {
+    ExHeader_SystemControlInfo sci;
+    ExHeader_AccessControlInfo aci;
+} ExHeader_Info;
+
+// Only used as an opaque type
+
+typedef struct {
+    u8 data[0x800];
+} ExHeader;
+
+typedef enum {
+    MEMOP_FREE                  = 1,
+    MEMOP_ALLOC                 = 3,
+    MEMOP_REGION_APP            = 0x100,
+} MemOp;
+
+typedef enum {
+    MEMPERM_READ                = 1,
+    MEMPERM_WRITE               = 2,
+    MEMPERM_READWRITE           = 3,
+    MEMPERM_DONTCARE            = 0x10000000,
+} MemPerm;
+
+typedef enum {
+    MEMREGION_APPLICATION       = 1,
+} MemRegion;
+
+s64 osGetMemRegionFree(MemRegion region);
+Result svcControlMemory(u32 *addrOut, u32 addr0, u32 addr1, u32 size, MemOp op, MemPerm perm);
+
+FS_Path fsMakePath(u32 type, const void *path);
+
+Result FSUSER_OpenArchive(FS_Archive *archive, FS_ArchiveID id, FS_Path path);
+Result FSUSER_CloseArchive(FS_Archive archive);
+Result FSUSER_OpenFileDirectly(Handle *out, FS_ArchiveID archiveId, FS_Path archivePath, FS_Path filePath, u32 openFlags, u32 attributes);
+Result FSUSER_OpenFile(Handle *out, FS_Archive archive, FS_Path path, u32 openFlags, u32 attributes);
+Result FSUSER_OpenDirectory(Handle *out, FS_Archive archive, FS_Path path);
+Result FSUSER_DeleteFile(FS_Archive archive, FS_Path path);
+Result FSUSER_RenameFile(FS_Archive srcArchive, FS_Path srcPath, FS_Archive dstArchive, FS_Path dstPath);
+
+Result FSFILE_Read(Handle handle, u32 *bytesRead, u64 offset, void *buffer, u32 size);
+Result FSFILE_Write(Handle handle, u32 *bytesWritten, u64 offset, const void *buffer, u32 size, u32 flags);
+Result FSFILE_GetSize(Handle handle, u64 *size);
+Result FSFILE_SetSize(Handle handle, u64 size);
+Result FSFILE_Close(Handle handle);
+
+Result FSDIR_Read(Handle handle, u32 *entriesRead, u32 entryCount, FS_DirectoryEntry *entries);
+Result FSDIR_Close(Handle handle);
+
+void svcBreak(u32 breakReason);
+Result svcKernelSetState(u32 type, ...);
+Result svcGetSystemInfo(s64 *out, u32 type, s32 param);
+
+#define RUNFLAG_APTCHAINLOAD        BIT(2)
+
+typedef struct {
+    u8 name[8];
+    u16 version;
+    u16 padding[3];
+    u32 text_addr;
+    u32 text_size;
+    u32 ro_addr;
+    u32 ro_size;
+    u32 rw_addr;
+    u32 rw_size;
+    u32 text_size_total;
+    u32 ro_size_total;
+    u32 rw_size_total;
+    u32 padding2;
+    u64 program_id;
+} CodeSetHeader;
+
+Result svcCreateCodeSet(Handle *out, const CodeSetHeader *info, u32 code_ptr, u32 ro_ptr, u32 data_ptr);
+Result svcCreateProcess(Handle *out, Handle codeset, const u32 *arm11KernelCaps, s32 numArm11KernelCaps);
+Result svcGetProcessId(u32 *out, Handle handle);
+Result svcCloseHandle(Handle handle);
+Result svcConnectToPort(Handle *out, const char *portName);
+Result svcSendSyncRequest(Handle session);
+void svcSleepThread(s64 ns);
+u64 svcGetSystemTick(void);
+
+#define AtomicPostIncrement(ptr)    __atomic_fetch_add((u32 *)(ptr), 1, __ATOMIC_SEQ_CST)
+#define AtomicDecrement(ptr)        __atomic_sub_fetch((u32 *)(ptr), 1, __ATOMIC_SEQ_CST)
+
+#define IPC_MakeHeader(command_id, normal_params, translate_params) \
+    (((u32)(command_id) << 16) | (((u32)(normal_params) & 0x3F) << 6) | ((u32)(translate_params) & 0x3F))
+#define IPC_Desc_MoveHandles(number)            ((((u32)(number) - 1) << 26) | 0x10)
+#define IPC_Desc_StaticBuffer(size, buffer_id)  (((u32)(size) << 14) | (((u32)(buffer_id) & 0xF) << 10) | 0x2)
+
+u32 *getThreadCommandBuffer(void);
+
+Result FSREG_CheckHostLoadId(u64 prog_handle);
+Result FSREG_LoadProgram(u64 *prog_handle, const FS_ProgramInfo *title);
+Result FSREG_UnloadProgram(u64 prog_handle);
+Result FSREG_GetProgramInfo(ExHeader_Info *exheaderInfos, u32 num_entries, u64 prog_handle);
+
+Result PXIPM_RegisterProgram(u64 *programHandle, const FS_ProgramInfo *programInfo, const FS_ProgramInfo *programInfoUpdate);
+Result PXIPM_UnregisterProgram(u64 programHandle);
+Result PXIPM_GetProgramInfo(ExHeader_Info *exheaderInfo, u64 programHandle);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,4 @@
+#pragma once
+
+// Everything is declared in 3ds.h
+#include <3ds.h>
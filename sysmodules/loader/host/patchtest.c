@@ -0,0 +1,713 @@
+/*
+Runs the real patchCode (patcher.c, bps_patcher.cpp) and patch site cache (patch_cache.c) on sample code binaries:
+home menu, NS and CFG with each setting their patches depend on, an application with LayeredFS and IPS or BPS patches,
+and RO. Each launch is checked against the expected patched code, whether its sites come from the cache or not.
+
+Also covered: a corrupted cache file, sites that moved without changing the text hash, searches that failed on
+a previous launch, a failed launch, and more sites and titles than the cache holds.
+
+Prints the number of signature searches (memsearch calls) and the time taken by each launch.
+Exits with status 1 if anything doesn't match.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "stubs.h"
+#include "patcher.h"
+#include "patch_cache.h"
+#include "title_index.h"
+#include "romfsredir.h"
+
+#define TEXT_SIZE       0xFFE00
+#define RO_SIZE         0x1FFC0
+#define DATA_SIZE       0xF000
+#define RO_START        0x100000
+#define CODE_SIZE       0x130000
+#define RO_ADDRESS      0x200000
+#define DATA_ADDRESS    0x220000
+
+#define HOME_MENU_ID    0x0004003000008F02ULL
+#define NS_ID           0x0004013000008002ULL
+#define CFG_ID          0x0004013000001702ULL
+#define RO_ID           0x0004013000003702ULL
+#define APP_ID          0x0004000000055D00ULL
+#define APP_DIR         "/luma/titles/0004000000055D00"
+
+static u8 sample[CODE_SIZE], code[CODE_SIZE], expected[CODE_SIZE];
+static bool failed;
+
+static u32 numSearches;
+static u64 bytesSearched;
+
+u8 *__real_memsearch(u8 *startPos, const void *pattern, u32 size, u32 patternSize);
+
+u8 *__wrap_memsearch(u8 *startPos, const void *pattern, u32 size, u32 patternSize)
+{
+    numSearches++;
+    bytesSearched += size;
+    return __real_memsearch(startPos, pattern, size, patternSize);
+}
+
+static void expect(const char *name, bool ok)
+{
+    if (!ok)
+    {
+        printf("    %s: FAILED\n", name);
+        failed = true;
+    }
+}
+
+static void putWord(u8 *buf, u32 offset, u32 word)
+{
+    memcpy(buf + offset, &word, 4);
+}
+
+static u32 getWord(const u8 *buf, u32 offset)
+{
+    u32 word;
+    memcpy(&word, buf + offset, 4);
+    return word;
+}
+
+// "add" instructions in .text, none of them part of a signature, and no zero bytes in .rodata and .data
+static void fillSample(void)
+{
+    for (u32 i = 0; i < TEXT_SIZE / 4; i++)
+        putWord(sample, 4 * i, 0xE0800000 | ((i * 2654435761u) >> 16));
+
+    memset(sample + TEXT_SIZE, 0, RO_START - TEXT_SIZE);
+    memset(sample + RO_START, 0x55, RO_SIZE);
+    memset(sample + RO_START + RO_SIZE, 0, 0x20000 - RO_SIZE);
+    memset(sample + 0x120000, 0x66, DATA_SIZE);
+    memset(sample + 0x120000 + DATA_SIZE, 0, CODE_SIZE - 0x120000 - DATA_SIZE);
+}
+
+static const PatchCacheEntry *cacheEntry(u64 progId)
+{
+    SimFile *file = simFsFind(ARCHIVE_SDMC, PATCH_CACHE_PATH);
+    if (file == NULL)
+        return NULL;
+
+    const PatchCacheHeader *header = (const PatchCacheHeader *)file->data;
+    const PatchCacheEntry *entries = (const PatchCacheEntry *)(header + 1);
+
+    for (u32 i = 0; i < header->numEntries; i++)
+    {
+        if (entries[i].progId == progId)
+            return &entries[i];
+    }
+
+    return NULL;
+}
+
+static u32 cacheWrites(void)
+{
+    SimFile *file = simFsFind(ARCHIVE_SDMC, PATCH_CACHE_PATH);
+    return file != NULL ? file->numWrites : 0;
+}
+
+typedef struct Launch {
+    u32 searches;
+    bool cacheWritten;
+    bool broke;
+} Launch;
+
+// A launch of the sample, as loader.c does it. The title index is rebuilt as if the title had just been registered.
+static Launch launch(const char *name, u64 progId, u16 progVer)
+{
+    Launch result;
+    struct timespec start, end;
+    u32 writes = cacheWrites(), breaks = g_simNumBreaks;
+
+    titleIndexInvalidate();
+    memcpy(code, sample, CODE_SIZE);
+    numSearches = 0;
+    bytesSearched = 0;
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    patchCode(progId, progVer, code, CODE_SIZE, TEXT_SIZE, RO_SIZE, DATA_SIZE, RO_ADDRESS, DATA_ADDRESS);
+    clock_gettime(CLOCK_MONOTONIC, &end);
+
+    result.searches = numSearches;
+    result.cacheWritten = cacheWrites() != writes;
+    result.broke = g_simNumBreaks != breaks;
+
+    printf("    %s: %u searches (%llu KiB), %ld us%s%s\n", name, numSearches, (unsigned long long)(bytesSearched >> 10),
+           (end.tv_sec - start.tv_sec) * 1000000 + (end.tv_nsec - start.tv_nsec) / 1000,
+           result.cacheWritten ? ", cache written" : "", result.broke ? ", failed" : "");
+    return result;
+}
+
+static void expectCode(const char *name)
+{
+    if (memcmp(code, expected, CODE_SIZE) != 0)
+    {
+        u32 i;
+        for (i = 0; code[i] == expected[i]; i++);
+        printf("    %s: FAILED, first difference at 0x%X: 0x%08X instead of 0x%08X\n", name, i, getWord(code, i & ~3), getWord(expected, i & ~3));
+        failed = true;
+    }
+}
+
+// A launch that must be answered entirely from the cache
+static void expectCachedLaunch(const char *name, u64 progId, u16 progVer, u32 expectedSearches)
+{
+    Launch result = launch(name, progId, progVer);
+
+    expect("cached launch succeeded", !result.broke);
+    expect("cached launch has only the searches that failed before", result.searches == expectedSearches);
+    expect("cached launch didn't update the cache", !result.cacheWritten);
+    expectCode(name);
+}
+
+/* Home menu */
+
+#define HOME_REGION_CHECK   0xC0040
+#define HOME_MANUAL_CHECK   0xD0000
+#define HOME_FUNC           0xE0000
+#define HOME_MOVED_FUNC     0xE0160
+#define HOME_WHITELIST      0xE0141
+#define HOME_MOVED_WHITELIST 0xE0181
+
+static const u8 homeRegionCheck[] = { 0x0A, 0x0C, 0x00, 0x10 },
+                homeRegionPatch[] = { 0x01, 0x00, 0xA0, 0xE3, 0x1E, 0xFF, 0x2F, 0xE1 },
+                homeWhitelist[] = { 0x10, 0xD1, 0xE5, 0x08, 0x00, 0x8D };
+
+// moved: the whitelist check is in another function, without changing any of the words the text hash is made of
+static void buildHomeMenu(bool moved)
+{
+    fillSample();
+    memcpy(sample + HOME_REGION_CHECK, homeRegionCheck, sizeof(homeRegionCheck));
+    putWord(sample, HOME_MANUAL_CHECK - 4, 0xE1110012);
+    putWord(sample, HOME_MANUAL_CHECK, 0x0A000005);
+    putWord(sample, HOME_MANUAL_CHECK + 4, 0xE1A0000D);
+    putWord(sample, HOME_FUNC, 0xE92D4070);
+
+    if (moved)
+    {
+        putWord(sample, HOME_MOVED_FUNC, 0xE92D4010);
+        memcpy(sample + HOME_MOVED_WHITELIST, homeWhitelist, sizeof(homeWhitelist));
+    }
+    else
+        memcpy(sample + HOME_WHITELIST, homeWhitelist, sizeof(homeWhitelist));
+
+    memcpy(expected, sample, CODE_SIZE);
+    memcpy(expected + HOME_REGION_CHECK - 31, homeRegionPatch, sizeof(homeRegionPatch));
+    putWord(expected, HOME_MANUAL_CHECK, 0xE320F000);
+    putWord(expected, moved ? HOME_MOVED_FUNC : HOME_FUNC, 0xE3A00000);
+    putWord(expected, (moved ? HOME_MOVED_FUNC : HOME_FUNC) + 4, 0xE12FFF1E);
+}
+
+static void corruptedCache(void)
+{
+    struct {
+        PatchCacheHeader header;
+        PatchCacheEntry entry;
+    } file;
+
+    printf("home menu, cache file with a corrupted entry\n");
+    buildHomeMenu(false);
+
+    memset(&file, 0xA5, sizeof(file));
+    file.header.magic = PATCH_CACHE_MAGIC;
+    file.header.version = PATCH_CACHE_VERSION;
+    file.header.numEntries = 1;
+    file.header.nextEntry = 0;
+    file.entry.progId = HOME_MENU_ID;
+    file.entry.progVer = 10;
+    file.entry.numSites = 0xFFFF;
+    file.entry.textSize = TEXT_SIZE;
+    file.entry.textHash = patchCacheHashText(sample, TEXT_SIZE);
+    simFsAddFile(ARCHIVE_SDMC, PATCH_CACHE_PATH, &file, sizeof(file));
+
+    Launch result = launch("first launch", HOME_MENU_ID, 10);
+    const PatchCacheEntry *entry = cacheEntry(HOME_MENU_ID);
+
+    expect("launch succeeded", !result.broke);
+    expect("every pattern searched", result.searches == 2);
+    expect("entry rewritten", result.cacheWritten && entry != NULL && entry->numSites == 3);
+    expectCode("patched code");
+}
+
+static void homeMenu(void)
+{
+    printf("home menu\n");
+    buildHomeMenu(false);
+    expectCachedLaunch("second launch", HOME_MENU_ID, 10, 0);
+
+    printf("home menu, whitelist check moved to another function\n");
+    u32 hash = patchCacheHashText(sample, TEXT_SIZE);
+    buildHomeMenu(true);
+    expect("same text hash", patchCacheHashText(sample, TEXT_SIZE) == hash);
+
+    Launch result = launch("first launch", HOME_MENU_ID, 10);
+    expect("launch succeeded", !result.broke);
+    expect("only the moved pattern searched", result.searches == 1);
+    expect("site updated", result.cacheWritten);
+    expectCode("patched code");
+
+    expectCachedLaunch("second launch", HOME_MENU_ID, 10, 0);
+}
+
+/* NS, whose searches depend on isN3DS and the New 3DS CPU setting */
+
+#define NS_CART_CHECK_1     0x80000
+#define NS_CART_CHECK_2     0x90000
+#define NS_CPU_SETTING      0xA0010
+#define NS_RO_TABLE         (RO_START + 0xFFF) // the table itself is aligned
+
+static const u8 nsCartCheck[] = { 0x0C, 0x18, 0xE1, 0xD8 },
+                nsCartPatch[] = { 0x0B, 0x18, 0x21, 0xC8 },
+                nsRoTable[] = { 0x00, 0xB1, 0x15, 0x00 };
+static const u32 nsCpuWords[8] = { 0xE3A01001, 0xE3A02002, 0xE3A03003, 0xE3A04004, 0x1594000C, 0xE3A05005, 0xE3A06006, 0xE3A07007 };
+
+static void buildNs(bool n3ds, u32 cpuSetting)
+{
+    fillSample();
+    memcpy(sample + NS_CART_CHECK_1, nsCartCheck, sizeof(nsCartCheck));
+    memcpy(sample + NS_CART_CHECK_2, nsCartCheck, sizeof(nsCartCheck));
+    for (u32 i = 0; i < 8; i++)
+        putWord(sample, NS_CPU_SETTING - 16 + 4 * i, nsCpuWords[i]);
+    memcpy(sample + NS_RO_TABLE, nsRoTable, sizeof(nsRoTable));
+    memset(sample + NS_RO_TABLE + 4, 0x77, 40);
+    putWord(sample, NS_RO_TABLE + 41, 0xCC010000);
+
+    memcpy(expected, sample, CODE_SIZE);
+    memcpy(expected + NS_CART_CHECK_1, nsCartPatch, sizeof(nsCartPatch));
+    memcpy(expected + NS_CART_CHECK_2, nsCartPatch, sizeof(nsCartPatch));
+    if (n3ds && cpuSetting != 0)
+    {
+        const u32 *w = nsCpuWords + 4;
+        u32 patched[8] = { w[-3], w[-1], w[-2], w[0], w[1], w[2], w[3], 0xE3800000 | cpuSetting };
+
+        for (u32 i = 0; i < 8; i++)
+            putWord(expected, NS_CPU_SETTING - 16 + 4 * i, patched[i]);
+    }
+    memset(expected + NS_RO_TABLE + 1, 0, 40);
+
+    isN3DS = n3ds;
+    multiConfig = cpuSetting << (2 * NEWCPU);
+}
+
+static void ns(void)
+{
+    static const struct {
+        bool n3ds;
+        u32 cpuSetting;
+        u32 firstSearches; // without the sites of the previous settings
+    } settings[] = {
+        { false, 0, 3 },
+        { true, 3, 1 },
+        { true, 0, 0 },
+        { true, 1, 0 },
+        { false, 0, 0 },
+    };
+
+    for (u32 i = 0; i < sizeof(settings) / sizeof(settings[0]); i++)
+    {
+        printf("NS, %s, CPU setting %u\n", settings[i].n3ds ? "New 3DS" : "Old 3DS", settings[i].cpuSetting);
+        buildNs(settings[i].n3ds, settings[i].cpuSetting);
+
+        Launch result = launch("first launch", NS_ID, 0x13);
+        expect("launch succeeded", !result.broke);
+        expect("only the new patterns searched", result.searches == settings[i].firstSearches);
+        expectCode("patched code");
+
+        expectCachedLaunch("second launch", NS_ID, 0x13, 0);
+    }
+
+    isN3DS = false;
+    multiConfig = 0;
+}
+
+/* CFG, whose searches depend on SecureInfo_C */
+
+#define CFG_SIG_CHECK       0x30000
+#define CFG_SECURE_INFO_1   (RO_START + 0x2000)
+#define CFG_SECURE_INFO_2   (RO_START + 0x3000)
+
+static void buildCfg(bool secureInfoC)
+{
+    static const u8 sigCheck[] = { 0x06, 0x46, 0x10, 0x48 }, sigPatch[] = { 0x00, 0x26 };
+
+    fillSample();
+    memcpy(sample + CFG_SIG_CHECK, sigCheck, sizeof(sigCheck));
+    memcpy(sample + CFG_SECURE_INFO_1, u"Sec", 6);
+    memcpy(sample + CFG_SECURE_INFO_2, u"Sec", 6);
+
+    memcpy(expected, sample, CODE_SIZE);
+    memcpy(expected + CFG_SIG_CHECK, sigPatch, sizeof(sigPatch));
+    if (secureInfoC)
+    {
+        memcpy(expected + CFG_SECURE_INFO_1 + 22, u"C", 2);
+        memcpy(expected + CFG_SECURE_INFO_2 + 22, u"C", 2);
+        simFsAddFile(ARCHIVE_NAND_RW, "/sys/SecureInfo_C", "", 0);
+    }
+}
+
+static void cfg(void)
+{
+    for (u32 i = 0; i < 2; i++)
+    {
+        printf("CFG, %s SecureInfo_C\n", i == 0 ? "without" : "with");
+        buildCfg(i != 0);
+
+        Launch result = launch("first launch", CFG_ID, 0);
+        expect("launch succeeded", !result.broke);
+        expect("only the new patterns searched", result.searches == (i == 0 ? 1 : 2));
+        expectCode("patched code");
+
+        expectCachedLaunch("second launch", CFG_ID, 0, 0);
+    }
+}
+
+/* Application with LayeredFS, and IPS or BPS patches moving the functions it hooks */
+
+enum {
+    APP_MOUNT_ARCHIVE = 0,
+    APP_REGISTER_ARCHIVE,
+    APP_TRY_OPEN_FILE,
+    APP_OPEN_FILE_DIRECTLY,
+};
+
+enum {
+    APP_PLAIN = 0,
+    APP_IPS_1,
+    APP_IPS_2,
+    APP_BPS,
+};
+
+static void putSignature(u8 *buf, u32 symbol, u32 offset)
+{
+    putWord(buf, offset - 0x100, 0xE92D4FF0);
+
+    switch (symbol)
+    {
+        case APP_MOUNT_ARCHIVE:
+            putWord(buf, offset, 0xE5970010);
+            putWord(buf, offset + 4, 0xE1CD20D8);
+            putWord(buf, offset + 8, 0xE58D0000);
+            break;
+        case APP_REGISTER_ARCHIVE:
+            putWord(buf, offset, 0xE3500008);
+            putWord(buf, offset + 4, 0xE1810400);
+            putWord(buf, offset + 8, 0xE1810FC0);
+            break;
+        case APP_TRY_OPEN_FILE:
+            putWord(buf, offset, 0xE351003A);
+            putWord(buf, offset + 4, 0x1AFFFFFC);
+            putWord(buf, offset + 0x34, 0xE590C000);
+            putWord(buf, offset + 0x3C, 0xE12FFF3C);
+            break;
+        case APP_OPEN_FILE_DIRECTLY:
+            putWord(buf, offset, 0x08030204);
+            break;
+    }
+}
+
+static void writeIpsPatch(const u8 *from, const u8 *to)
+{
+    static u8 ips[0x1000];
+    u32 size = 5;
+
+    memcpy(ips, "PATCH", 5);
+    for (u32 offset = 0; offset < TEXT_SIZE; offset += 4)
+    {
+        if (getWord(from, offset) == getWord(to, offset))
+            continue;
+
+        u8 record[] = { offset >> 16, offset >> 8, offset, 0, 4 };
+        memcpy(ips + size, record, 5);
+        memcpy(ips + size + 5, to + offset, 4);
+        size += 9;
+    }
+    memcpy(ips + size, "EOF", 3);
+
+    simFsAddFile(ARCHIVE_SDMC, APP_DIR "/code.ips", ips, size + 3);
+}
+
+static u32 crc32(const u8 *data, u32 size)
+{
+    u32 crc = 0xFFFFFFFF;
+
+    for (u32 i = 0; i < size; i++)
+    {
+        crc ^= data[i];
+        for (u32 j = 0; j < 8; j++)
+            crc = (crc >> 1) ^ (0xEDB88320 & -(crc & 1));
+    }
+
+    return ~crc;
+}
+
+static u32 putBpsNumber(u8 *out, u32 number)
+{
+    u32 size = 0;
+
+    while (true)
+    {
+        u8 x = number & 0x7F;
+        number >>= 7;
+        if (number == 0)
+        {
+            out[size++] = 0x80 | x;
+            return size;
+        }
+        out[size++] = x;
+        number--;
+    }
+}
+
+// SourceRead for the unchanged words, TargetRead for the others
+static void writeBpsPatch(const u8 *from, const u8 *to)
+{
+    static u8 bps[0x1000];
+    u32 size = 4, offset = 0;
+
+    memcpy(bps, "BPS1", 4);
+    size += putBpsNumber(bps + size, CODE_SIZE);
+    size += putBpsNumber(bps + size, CODE_SIZE);
+    size += putBpsNumber(bps + size, 0);
+
+    while (offset < CODE_SIZE)
+    {
+        bool same = getWord(from, offset) == getWord(to, offset);
+        u32 length = 0;
+
+        while (offset + length < CODE_SIZE && (getWord(from, offset + length) == getWord(to, offset + length)) == same)
+            length += 4;
+
+        size += putBpsNumber(bps + size, (length - 1) << 2 | (same ? 0 : 1));
+        if (!same)
+        {
+            memcpy(bps + size, to + offset, length);
+            size += length;
+        }
+        offset += length;
+    }
+
+    u32 footer[] = { crc32(from, CODE_SIZE), crc32(to, CODE_SIZE) };
+    memcpy(bps + size, footer, 8);
+    size += 8;
+    u32 patchCrc = crc32(bps, size);
+    memcpy(bps + size, &patchCrc, 4);
+
+    simFsAddFile(ARCHIVE_SDMC, APP_DIR "/code.bps", bps, size + 4);
+}
+
+// rexMount: an update RomFS mount name the previous launches didn't find
+static void buildApp(u32 variant, bool rexMount)
+{
+    static u8 patched[CODE_SIZE];
+    u32 symbols[4] = { 0x3FF00, 0x4FF00, 0x5FF00, 0x6FF00 };
+    const char *mount = rexMount ? "rex:" : "patc";
+    static const char path[] = "lf:" APP_DIR "/romfs";
+
+    fillSample();
+    for (u32 i = 0; i < 4; i++)
+        putSignature(sample, i, symbols[i] + 0x100);
+    memcpy(sample + RO_START + 0x4000, "\0patch:", 7);
+    if (rexMount)
+        memcpy(sample + RO_START + 0x5000, "\0rex:", 5);
+
+    simFsRemove(ARCHIVE_SDMC, APP_DIR "/code.ips");
+    simFsRemove(ARCHIVE_SDMC, APP_DIR "/code.bps");
+    simFsAddDirectory(ARCHIVE_SDMC, APP_DIR "/romfs");
+
+    // The patches add earlier matches, which the patched code must use
+    memcpy(patched, sample, CODE_SIZE);
+    switch (variant)
+    {
+        case APP_IPS_1:
+            symbols[APP_MOUNT_ARCHIVE] = 0x1FF00;
+            putSignature(patched, APP_MOUNT_ARCHIVE, 0x20000);
+            writeIpsPatch(sample, patched);
+            break;
+        case APP_IPS_2:
+            symbols[APP_MOUNT_ARCHIVE] = 0x2FF00;
+            putSignature(patched, APP_MOUNT_ARCHIVE, 0x30000);
+            writeIpsPatch(sample, patched);
+            break;
+        case APP_BPS:
+            symbols[APP_TRY_OPEN_FILE] = 0xFF00;
+            putSignature(patched, APP_TRY_OPEN_FILE, 0x10000);
+            writeBpsPatch(sample, patched);
+            break;
+    }
+
+    memcpy(expected, patched, CODE_SIZE);
+    putWord(expected, symbols[APP_OPEN_FILE_DIRECTLY], MAKE_BRANCH(symbols[APP_OPEN_FILE_DIRECTLY], TEXT_SIZE));
+    putWord(expected, symbols[APP_TRY_OPEN_FILE], MAKE_BRANCH(symbols[APP_TRY_OPEN_FILE], TEXT_SIZE + 12));
+    memcpy(expected + RO_START + RO_SIZE, path, sizeof(path));
+
+    // What the payload must have been set up with
+    romfsRedirPatchSubstituted1 = getWord(patched, symbols[APP_OPEN_FILE_DIRECTLY]);
+    romfsRedirPatchHook1 = MAKE_BRANCH(TEXT_SIZE + 8, symbols[APP_OPEN_FILE_DIRECTLY] + 4);
+    romfsRedirPatchSubstituted2 = getWord(patched, symbols[APP_TRY_OPEN_FILE]);
+    romfsRedirPatchHook2 = MAKE_BRANCH(TEXT_SIZE + 20, symbols[APP_TRY_OPEN_FILE] + 4);
+    romfsRedirPatchCustomPath = RO_ADDRESS + RO_SIZE;
+    romfsRedirPatchFsMountArchive = 0x100000 + symbols[APP_MOUNT_ARCHIVE];
+    romfsRedirPatchFsRegisterArchive = 0x100000 + symbols[APP_REGISTER_ARCHIVE];
+    romfsRedirPatchArchiveId = ARCHIVE_SDMC;
+    memcpy(&romfsRedirPatchUpdateRomFsMount, mount, 4);
+    memcpy(expected + TEXT_SIZE, romfsRedirPatch, romfsRedirPatchSize);
+}
+
+static void app(void)
+{
+    static const struct {
+        const char *name;
+        u32 variant;
+        bool rexMount;
+        u32 firstSearches, failedSearches;
+    } launches[] = {
+        { "application with LayeredFS", APP_PLAIN, false, 4, 3 },
+        { "application with LayeredFS and an IPS patch", APP_IPS_1, false, 4, 3 },
+        { "application with LayeredFS and another IPS patch", APP_IPS_2, false, 4, 3 },
+        { "application with LayeredFS, without the IPS patch", APP_PLAIN, false, 3, 3 },
+        { "application with LayeredFS and a BPS patch", APP_BPS, false, 4, 3 },
+        { "application with LayeredFS, update RomFS name found this time", APP_PLAIN, true, 3, 2 },
+    };
+
+    config |= BIT(PATCHGAMES);
+
+    for (u32 i = 0; i < sizeof(launches) / sizeof(launches[0]); i++)
+    {
+        printf("%s\n", launches[i].name);
+        buildApp(launches[i].variant, launches[i].rexMount);
+
+        Launch result = launch("first launch", APP_ID, 0);
+        expect("launch succeeded", !result.broke);
+        expect("only the failed and new patterns searched", result.searches == launches[i].firstSearches);
+        expectCode("patched code");
+
+        // The names of the update RomFS mounts that come before the one that is there are always searched for
+        expectCachedLaunch("second launch", APP_ID, 0, launches[i].failedSearches);
+    }
+
+    config &= ~BIT(PATCHGAMES);
+}
+
+/* RO, with a launch failing because a pattern is missing */
+
+#define RO_CRR_CHECK        0x20000
+#define RO_HASH_CHECK_1     0x21000
+#define RO_HASH_CHECK_2     0x22041
+
+static void buildRo(bool complete)
+{
+    static const u8 pattern[] = { 0x20, 0xA0, 0xE1, 0x8B }, pattern2[] = { 0xE1, 0x30, 0x40, 0x2D }, pattern3[] = { 0x2D, 0xE9, 0x01, 0x70 },
+                    patch[] = { 0x00, 0x00, 0xA0, 0xE3, 0x1E, 0xFF, 0x2F, 0xE1 };
+
+    fillSample();
+    memcpy(sample + RO_CRR_CHECK, pattern, sizeof(pattern));
+    memcpy(sample + RO_HASH_CHECK_1, pattern2, sizeof(pattern2));
+    if (complete)
+        memcpy(sample + RO_HASH_CHECK_2, pattern3, sizeof(pattern3));
+
+    memcpy(expected, sample, CODE_SIZE);
+    memcpy(expected + RO_CRR_CHECK - 9, patch, sizeof(patch));
+    memcpy(expected + RO_HASH_CHECK_1 + 1, patch, sizeof(patch));
+    memcpy(expected + RO_HASH_CHECK_2 - 2, patch, sizeof(patch));
+}
+
+static void ro(void)
+{
+    printf("RO, a pattern missing\n");
+    buildRo(false);
+    u32 hash = patchCacheHashText(sample, TEXT_SIZE);
+
+    Launch result = launch("first launch", RO_ID, 1);
+    expect("launch failed", result.broke);
+    expect("nothing cached", !result.cacheWritten && cacheEntry(RO_ID) == NULL);
+
+    printf("RO, the pattern added\n");
+    buildRo(true);
+    expect("same text hash", patchCacheHashText(sample, TEXT_SIZE) == hash);
+
+    result = launch("first launch", RO_ID, 1);
+    expect("launch succeeded", !result.broke);
+    expect("every pattern searched", result.searches == 3);
+    expectCode("patched code");
+
+    expectCachedLaunch("second launch", RO_ID, 1, 0);
+}
+
+/* Limits of the cache file */
+
+static void manySites(void)
+{
+    static const u64 progId = 0x0004013000ABCD02ULL;
+
+    printf("more sites than an entry holds\n");
+    fillSample();
+    for (u32 i = 0; i < 40; i++)
+        putWord(sample, 0x1000 * i + 0x800, 0xABCD0000 + i);
+
+    for (u32 run = 0; run < 2; run++)
+    {
+        numSearches = 0;
+        patchCacheBegin(progId, 0, sample, TEXT_SIZE);
+        for (u32 i = 0; i < 40; i++)
+        {
+            u32 pattern = 0xABCD0000 + i;
+            expect("pattern found", patchCacheMemsearch(sample, &pattern, TEXT_SIZE, 4) == sample + 0x1000 * i + 0x800);
+        }
+        patchCacheEnd(true);
+
+        const PatchCacheEntry *entry = cacheEntry(progId);
+        expect("entry full", entry != NULL && entry->numSites == PATCH_CACHE_MAX_SITES);
+        expect(run == 0 ? "every pattern searched" : "the cached ones not searched again",
+               numSearches == (run == 0 ? 40 : 40 - PATCH_CACHE_MAX_SITES));
+    }
+
+    // Its neighbours must be intact
+    buildHomeMenu(true);
+    expectCachedLaunch("home menu launch", HOME_MENU_ID, 10, 0);
+}
+
+static void manyTitles(void)
+{
+    printf("more titles than the cache holds\n");
+    fillSample();
+    putWord(sample, 0x800, 0xABCD0000);
+
+    for (u32 i = 0; i < PATCH_CACHE_MAX_ENTRIES + 6; i++)
+    {
+        u32 pattern = 0xABCD0000;
+
+        patchCacheBegin(0x0004013000B00002ULL + ((u64)i << 8), 0, sample, TEXT_SIZE);
+        patchCacheMemsearch(sample, &pattern, TEXT_SIZE, 4);
+        patchCacheEnd(true);
+    }
+
+    SimFile *file = simFsFind(ARCHIVE_SDMC, PATCH_CACHE_PATH);
+    const PatchCacheHeader *header = (const PatchCacheHeader *)file->data;
+
+    expect("cache full", header->numEntries == PATCH_CACHE_MAX_ENTRIES &&
+           file->size == sizeof(PatchCacheHeader) + PATCH_CACHE_MAX_ENTRIES * sizeof(PatchCacheEntry));
+    expect("oldest entries replaced", cacheEntry(HOME_MENU_ID) == NULL && cacheEntry(0x0004013000B00002ULL) == NULL &&
+           cacheEntry(0x0004013000B00002ULL + ((u64)(PATCH_CACHE_MAX_ENTRIES + 5) << 8)) != NULL);
+}
+
+int main(void)
+{
+    simFsReset();
+    isSdMode = true;
+    simFsAddDirectory(ARCHIVE_SDMC, "/luma");
+
+    // Must come first, the cache file is only read once per boot
+    corruptedCache();
+    homeMenu();
+    ns();
+    cfg();
+    app();
+    ro();
+    manySites();
+    manyTitles();
+
+    printf("%s\n", failed ? "FAILED" : "ok");
+    return failed ? 1 : 0;
+}
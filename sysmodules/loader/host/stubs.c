@@ -0,0 +1,537 @@
+#define _GNU_SOURCE
+#include <3ds.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <time.h>
+#include "stubs.h"
+
+// Everything the loader gets from the kernel and FS: in-memory archives, the shared config page, etc.
+
+#define SIM_MAX_FILES       64
+#define SIM_MAX_HANDLES     16
+#define SIM_ERR_NOT_FOUND   ((Result)0xC8804478)
+#define SIM_ERR_INVALID     ((Result)0xE0E046BE)
+
+u32 config, multiConfig, bootConfig;
+bool isN3DS, isSdMode, nextGamePatchDisabled;
+
+u8 g_sharedConfigPage[0x1000] __attribute__((aligned(0x1000)));
+
+SimFsCounts g_simFsCounts;
+u32 g_simNumBreaks;
+CodeSetHeader g_simCodeSet;
+ExHeader_Info g_simExheaderInfo;
+u32 g_simNumPrograms;
+u32 g_simLocaleState;
+
+static u32 simCommandBuffer[0x40];
+static u64 simNextProgramHandle = 0x1000;
+
+static SimFile simFiles[SIM_MAX_FILES];
+static u32 simNumFiles;
+
+static struct {
+    bool used;
+    bool isDirectory;
+    u32 file; // index into simFiles
+    u32 position; // directories: number of entries already read
+} simHandles[SIM_MAX_HANDLES];
+
+// Same layout as romfsredir.s (.long being the x86 .word), only its data matters here
+__asm__(
+    ".data\n"
+    ".balign 16\n"
+    ".global romfsRedirPatch\n"
+    "romfsRedirPatch:\n"
+    "    .long 0xEA000004\n"
+    ".global romfsRedirPatchSubstituted1\n"
+    "romfsRedirPatchSubstituted1: .long 0xdead0000\n"
+    ".global romfsRedirPatchHook1\n"
+    "romfsRedirPatchHook1: .long 0xdead0001\n"
+    "    .long 0xEA000010\n"
+    ".global romfsRedirPatchSubstituted2\n"
+    "romfsRedirPatchSubstituted2: .long 0xdead0002\n"
+    ".global romfsRedirPatchHook2\n"
+    "romfsRedirPatchHook2: .long 0xdead0003\n"
+    "    .fill 16, 4, 0xE1A00000\n"
+    ".global romfsRedirPatchArchiveName\n"
+    "romfsRedirPatchArchiveName: .ascii \"lf:\\0\"\n"
+    ".global romfsRedirPatchFsMountArchive\n"
+    "romfsRedirPatchFsMountArchive: .long 0xdead0005\n"
+    ".global romfsRedirPatchFsRegisterArchive\n"
+    "romfsRedirPatchFsRegisterArchive: .long 0xdead0006\n"
+    ".global romfsRedirPatchArchiveId\n"
+    "romfsRedirPatchArchiveId: .long 0xdead0007\n"
+    ".global romfsRedirPatchRomFsMount\n"
+    "romfsRedirPatchRomFsMount: .ascii \"rom:\"\n"
+    ".global romfsRedirPatchUpdateRomFsMount\n"
+    "romfsRedirPatchUpdateRomFsMount: .long 0xdead0008\n"
+    ".global romfsRedirPatchCustomPath\n"
+    "romfsRedirPatchCustomPath: .long 0xdead0004\n"
+    "romfsRedirPatchEnd:\n"
+    ".balign 4\n"
+    ".global romfsRedirPatchSize\n"
+    "romfsRedirPatchSize: .long romfsRedirPatchEnd - romfsRedirPatch\n"
+    ".text\n"
+);
+
+void simFsReset(void)
+{
+    for (u32 i = 0; i < simNumFiles; i++)
+        free(simFiles[i].data);
+
+    simNumFiles = 0;
+    memset(simHandles, 0, sizeof(simHandles));
+    memset(&g_simFsCounts, 0, sizeof(g_simFsCounts));
+    memset(g_sharedConfigPage, 0, sizeof(g_sharedConfigPage));
+}
+
+SimFile *simFsFind(FS_ArchiveID archiveId, const char *path)
+{
+    for (u32 i = 0; i < simNumFiles; i++)
+    {
+        if (simFiles[i].archiveId == archiveId && strcasecmp(simFiles[i].path, path) == 0)
+            return &simFiles[i];
+    }
+
+    return NULL;
+}
+
+static SimFile *simFsAdd(FS_ArchiveID archiveId, const char *path, bool isDirectory)
+{
+    SimFile *file = simFsFind(archiveId, path);
+
+    if (file == NULL)
+    {
+        if (simNumFiles == SIM_MAX_FILES || strlen(path) >= SIM_MAX_PATH)
+        {
+            fprintf(stderr, "can't add %s\n", path);
+            exit(2);
+        }
+
+        // Parents first
+        char parent[SIM_MAX_PATH];
+        strcpy(parent, path);
+        char *slash = strrchr(parent, '/');
+        if (slash != NULL && slash != parent)
+        {
+            *slash = 0;
+            simFsAdd(archiveId, parent, true);
+        }
+
+        file = &simFiles[simNumFiles++];
+        memset(file, 0, sizeof(SimFile));
+        file->archiveId = archiveId;
+        strcpy(file->path, path);
+    }
+
+    file->isDirectory = isDirectory;
+    return file;
+}
+
+SimFile *simFsAddFile(FS_ArchiveID archiveId, const char *path, const void *data, u32 size)
+{
+    SimFile *file = simFsAdd(archiveId, path, false);
+
+    free(file->data);
+    file->data = malloc(size != 0 ? size : 1);
+    if (size != 0)
+        memcpy(file->data, data, size);
+    file->size = size;
+
+    return file;
+}
+
+SimFile *simFsAddDirectory(FS_ArchiveID archiveId, const char *path)
+{
+    return simFsAdd(archiveId, path, true);
+}
+
+void simFsRemove(FS_ArchiveID archiveId, const char *path)
+{
+    SimFile *file = simFsFind(archiveId, path);
+
+    if (file != NULL)
+    {
+        u32 idx = file - simFiles;
+
+        free(file->data);
+        memmove(&simFiles[idx], &simFiles[idx + 1], (simNumFiles - idx - 1) * sizeof(SimFile));
+        simNumFiles--;
+    }
+}
+
+static bool isChildOf(const SimFile *file, FS_ArchiveID archiveId, const char *dir)
+{
+    size_t len = strlen(dir);
+
+    return file->archiveId == archiveId && strncasecmp(file->path, dir, len) == 0 && file->path[len] == '/' &&
+           strchr(file->path + len + 1, '/') == NULL;
+}
+
+static Result allocHandle(Handle *out, const SimFile *file, bool isDirectory)
+{
+    for (u32 i = 0; i < SIM_MAX_HANDLES; i++)
+    {
+        if (!simHandles[i].used)
+        {
+            simHandles[i].used = true;
+            simHandles[i].isDirectory = isDirectory;
+            simHandles[i].file = file - simFiles;
+            simHandles[i].position = 0;
+            *out = 0x100 + i;
+            return 0;
+        }
+    }
+
+    fprintf(stderr, "out of handles\n");
+    exit(2);
+}
+
+static SimFile *handleFile(Handle handle, bool isDirectory)
+{
+    u32 i = handle - 0x100;
+
+    if (i >= SIM_MAX_HANDLES || !simHandles[i].used || simHandles[i].isDirectory != isDirectory)
+    {
+        fprintf(stderr, "invalid handle 0x%X\n", handle);
+        exit(2);
+    }
+
+    return &simFiles[simHandles[i].file];
+}
+
+static Result closeHandle(Handle handle, bool isDirectory)
+{
+    handleFile(handle, isDirectory);
+    simHandles[handle - 0x100].used = false;
+    return 0;
+}
+
+FS_Path fsMakePath(u32 type, const void *path)
+{
+    FS_Path p = { type, type == PATH_ASCII ? strlen((const char *)path) + 1 : 1, path };
+    return p;
+}
+
+Result FSUSER_OpenArchive(FS_Archive *archive, FS_ArchiveID id, FS_Path path)
+{
+    (void)path;
+    *archive = id;
+    return 0;
+}
+
+Result FSUSER_CloseArchive(FS_Archive archive)
+{
+    (void)archive;
+    return 0;
+}
+
+Result FSUSER_OpenFile(Handle *out, FS_Archive archive, FS_Path path, u32 openFlags, u32 attributes)
+{
+    (void)attributes;
+    SimFile *file = simFsFind((FS_ArchiveID)archive, path.data);
+
+    g_simFsCounts.fileOpens++;
+    if (file == NULL && (openFlags & FS_OPEN_CREATE) != 0)
+        file = simFsAddFile((FS_ArchiveID)archive, path.data, NULL, 0);
+
+    if (file == NULL || file->isDirectory)
+        return SIM_ERR_NOT_FOUND;
+
+    return allocHandle(out, file, false);
+}
+
+Result FSUSER_OpenFileDirectly(Handle *out, FS_ArchiveID archiveId, FS_Path archivePath, FS_Path filePath, u32 openFlags, u32 attributes)
+{
+    (void)archivePath;
+
+    // Whatever the program, its ExeFS .code
+    if (filePath.type == PATH_BINARY)
+        filePath = fsMakePath(PATH_ASCII, SIM_CODE_PATH);
+
+    return FSUSER_OpenFile(out, archiveId, filePath, openFlags, attributes);
+}
+
+Result FSUSER_OpenDirectory(Handle *out, FS_Archive archive, FS_Path path)
+{
+    SimFile *file = simFsFind((FS_ArchiveID)archive, path.data);
+
+    g_simFsCounts.directoryOpens++;
+    if (file == NULL || !file->isDirectory)
+        return SIM_ERR_NOT_FOUND;
+
+    return allocHandle(out, file, true);
+}
+
+Result FSUSER_DeleteFile(FS_Archive archive, FS_Path path)
+{
+    SimFile *file = simFsFind((FS_ArchiveID)archive, path.data);
+
+    if (file == NULL || file->isDirectory)
+        return SIM_ERR_NOT_FOUND;
+
+    simFsRemove((FS_ArchiveID)archive, path.data);
+    return 0;
+}
+
+Result FSUSER_RenameFile(FS_Archive srcArchive, FS_Path srcPath, FS_Archive dstArchive, FS_Path dstPath)
+{
+    SimFile *file = simFsFind((FS_ArchiveID)srcArchive, srcPath.data);
+
+    if (file == NULL || file->isDirectory || srcArchive != dstArchive || simFsFind((FS_ArchiveID)dstArchive, dstPath.data) != NULL)
+        return SIM_ERR_INVALID;
+
+    strcpy(file->path, dstPath.data);
+    return 0;
+}
+
+Result FSFILE_Read(Handle handle, u32 *bytesRead, u64 offset, void *buffer, u32 size)
+{
+    SimFile *file = handleFile(handle, false);
+
+    g_simFsCounts.fileReads++;
+    *bytesRead = offset >= file->size ? 0 : (u32)(file->size - offset < size ? file->size - offset : size);
+    memcpy(buffer, file->data + offset, *bytesRead);
+    return 0;
+}
+
+Result FSFILE_SetSize(Handle handle, u64 size)
+{
+    SimFile *file = handleFile(handle, false);
+
+    file->data = realloc(file->data, size != 0 ? size : 1);
+    if (size > file->size)
+        memset(file->data + file->size, 0, size - file->size);
+    file->size = size;
+    return 0;
+}
+
+Result FSFILE_Write(Handle handle, u32 *bytesWritten, u64 offset, const void *buffer, u32 size, u32 flags)
+{
+    (void)flags;
+    SimFile *file = handleFile(handle, false);
+
+    g_simFsCounts.fileWrites++;
+    file->numWrites++;
+    if (offset + size > file->size)
+        FSFILE_SetSize(handle, offset + size);
+
+    memcpy(file->data + offset, buffer, size);
+    *bytesWritten = size;
+    return 0;
+}
+
+Result FSFILE_GetSize(Handle handle, u64 *size)
+{
+    *size = handleFile(handle, false)->size;
+    return 0;
+}
+
+Result FSFILE_Close(Handle handle)
+{
+    return closeHandle(handle, false);
+}
+
+Result FSDIR_Read(Handle handle, u32 *entriesRead, u32 entryCount, FS_DirectoryEntry *entries)
+{
+    SimFile *dir = handleFile(handle, true);
+    u32 *position = &simHandles[handle - 0x100].position;
+    u32 skipped = 0;
+
+    g_simFsCounts.directoryReads++;
+    *entriesRead = 0;
+    for (u32 i = 0; i < simNumFiles && *entriesRead < entryCount; i++)
+    {
+        if (!isChildOf(&simFiles[i], dir->archiveId, dir->path) || skipped++ < *position)
+            continue;
+
+        FS_DirectoryEntry *entry = &entries[(*entriesRead)++];
+        const char *name = strrchr(simFiles[i].path, '/') + 1;
+
+        memset(entry, 0, sizeof(FS_DirectoryEntry));
+        for (u32 j = 0; name[j] != 0; j++)
+            entry->name[j] = (u8)name[j];
+        entry->attributes = simFiles[i].isDirectory ? FS_ATTRIBUTE_DIRECTORY : 0;
+        entry->fileSize = simFiles[i].size;
+    }
+
+    *position += *entriesRead;
+    return 0;
+}
+
+Result FSDIR_Close(Handle handle)
+{
+    return closeHandle(handle, true);
+}
+
+void svcBreak(u32 breakReason)
+{
+    (void)breakReason;
+    g_simNumBreaks++;
+}
+
+Result svcKernelSetState(u32 type, ...)
+{
+    if (type == 0x10001)
+    {
+        va_list args;
+        va_start(args, type);
+        g_simLocaleState = va_arg(args, u32);
+        va_end(args);
+    }
+
+    return 0;
+}
+
+// Only the New 3DS check of 3dsx.c
+Result svcGetSystemInfo(s64 *out, u32 type, s32 param)
+{
+    (void)param;
+    *out = 0;
+    return type == 0x10001 && isN3DS ? 0 : SIM_ERR_INVALID;
+}
+
+Result svcCreateCodeSet(Handle *out, const CodeSetHeader *info, u32 code_ptr, u32 ro_ptr, u32 data_ptr)
+{
+    (void)code_ptr;
+    (void)ro_ptr;
+    (void)data_ptr;
+    g_simCodeSet = *info;
+    *out = 0x300;
+    return 0;
+}
+
+Result svcCreateProcess(Handle *out, Handle codeset, const u32 *arm11KernelCaps, s32 numArm11KernelCaps)
+{
+    (void)codeset;
+    (void)arm11KernelCaps;
+    (void)numArm11KernelCaps;
+    *out = 0x301;
+    return 0;
+}
+
+Result svcGetProcessId(u32 *out, Handle handle)
+{
+    (void)handle;
+    *out = 0x30;
+    return 0;
+}
+
+Result svcCloseHandle(Handle handle)
+{
+    (void)handle;
+    return 0;
+}
+
+Result svcConnectToPort(Handle *out, const char *portName)
+{
+    (void)portName;
+    *out = 0x302;
+    return 0;
+}
+
+// Only plg:ldr requests, which have nothing to do here
+Result svcSendSyncRequest(Handle session)
+{
+    (void)session;
+    return 0;
+}
+
+void svcSleepThread(s64 ns)
+{
+    (void)ns;
+}
+
+u64 svcGetSystemTick(void)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return ((u64)now.tv_sec * 1000000000 + now.tv_nsec) * (SYSCLOCK_ARM11 / 1000000) / 1000;
+}
+
+u32 *getThreadCommandBuffer(void)
+{
+    return simCommandBuffer;
+}
+
+// No HIO (host-loaded) titles
+Result FSREG_CheckHostLoadId(u64 prog_handle)
+{
+    (void)prog_handle;
+    return SIM_ERR_NOT_FOUND;
+}
+
+Result FSREG_LoadProgram(u64 *prog_handle, const FS_ProgramInfo *title)
+{
+    (void)prog_handle;
+    (void)title;
+    return SIM_ERR_INVALID;
+}
+
+Result FSREG_UnloadProgram(u64 prog_handle)
+{
+    (void)prog_handle;
+    return SIM_ERR_INVALID;
+}
+
+Result FSREG_GetProgramInfo(ExHeader_Info *exheaderInfos, u32 num_entries, u64 prog_handle)
+{
+    (void)exheaderInfos;
+    (void)num_entries;
+    (void)prog_handle;
+    return SIM_ERR_INVALID;
+}
+
+// Every program registered has g_simExheaderInfo as its exheader
+Result PXIPM_RegisterProgram(u64 *programHandle, const FS_ProgramInfo *programInfo, const FS_ProgramInfo *programInfoUpdate)
+{
+    (void)programInfo;
+    (void)programInfoUpdate;
+    *programHandle = simNextProgramHandle++;
+    g_simNumPrograms++;
+    return 0;
+}
+
+Result PXIPM_UnregisterProgram(u64 programHandle)
+{
+    (void)programHandle;
+    g_simNumPrograms--;
+    return 0;
+}
+
+Result PXIPM_GetProgramInfo(ExHeader_Info *exheaderInfo, u64 programHandle)
+{
+    (void)programHandle;
+    *exheaderInfo = g_simExheaderInfo;
+    return 0;
+}
+
+s64 osGetMemRegionFree(MemRegion region)
+{
+    (void)region;
+    return 0x1000000;
+}
+
+// The BPS patcher uses the application region as scratch memory, at its fixed address
+Result svcControlMemory(u32 *addrOut, u32 addr0, u32 addr1, u32 size, MemOp op, MemPerm perm)
+{
+    (void)addr1;
+    (void)perm;
+    void *addr = (void *)(uintptr_t)addr0;
+
+    if ((op & 0xFF) == MEMOP_FREE)
+        return munmap(addr, size) == 0 ? 0 : SIM_ERR_INVALID;
+
+    if (mmap(addr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_FIXED_NOREPLACE, -1, 0) != addr)
+    {
+        perror("can't map the application region");
+        exit(2);
+    }
+
+    *addrOut = addr0;
+    return 0;
+}
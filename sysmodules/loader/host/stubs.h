@@ -0,0 +1,41 @@
+#pragma once
+
+#include <3ds.h>
+
+// In-memory archives standing in for the SD card and CTRNAND, see stubs.c
+
+#define SIM_MAX_PATH    128
+#define SIM_CODE_PATH   "/.code"    // The ExeFS .code of the program being loaded, in ARCHIVE_SAVEDATA_AND_CONTENT2
+
+typedef struct SimFile {
+    FS_ArchiveID archiveId;
+    char path[SIM_MAX_PATH];
+    bool isDirectory;
+    u8 *data;
+    u32 size;
+    u32 numWrites;
+} SimFile;
+
+typedef struct SimFsCounts {
+    u32 fileOpens;
+    u32 directoryOpens;
+    u32 directoryReads;
+    u32 fileReads;
+    u32 fileWrites;
+} SimFsCounts;
+
+extern SimFsCounts g_simFsCounts;
+extern u32 g_simNumBreaks;
+extern CodeSetHeader g_simCodeSet; // Of the last svcCreateCodeSet
+extern ExHeader_Info g_simExheaderInfo; // Of every program PXIPM registers
+extern u32 g_simNumPrograms; // Registered with PXIPM and not unregistered
+extern u32 g_simLocaleState; // Of the last svcKernelSetState(0x10001), 0 if none
+
+// Removes everything, and resets the shared config page and the counts
+void simFsReset(void);
+
+// Adds or replaces a file, creating its parent directories
+SimFile *simFsAddFile(FS_ArchiveID archiveId, const char *path, const void *data, u32 size);
+SimFile *simFsAddDirectory(FS_ArchiveID archiveId, const char *path);
+void simFsRemove(FS_ArchiveID archiveId, const char *path);
+SimFile *simFsFind(FS_ArchiveID archiveId, const char *path);
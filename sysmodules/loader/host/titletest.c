@@ -0,0 +1,313 @@
+/*
+Runs real launches through the loader commands (loader.c): RegisterProgram, GetProgramInfo, LoadProcess and
+UnregisterProgram, as PM sends them, with the per-title overrides of /luma/titles/<tid> looked up through the title
+index (title_index.c). The directory must be enumerated once per launch whatever the number of overrides, files and
+checks, the overrides found must be the ones used, and changes on the SD card must be picked up by the next launch.
+A locale.txt must be moved into the title's settings record (title_settings.c) the first time it is read.
+
+Prints the number of override checks made by each launch and the number of FS requests they took, from the launch
+traces (GetLaunchTraces). Exits with status 1 if anything doesn't match.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "stubs.h"
+#include "patcher.h"
+#include "loader.h"
+#include "title_index.h"
+#include "title_settings.h"
+
+#define APP_ID          0x0004000000055D00ULL
+#define APP_DIR         "/luma/titles/0004000000055D00"
+#define OTHER_APP_ID    0x0004000000030800ULL
+
+#define SECTION_SIZE    0x1000
+
+static u8 code[3 * SECTION_SIZE];
+static bool failed;
+
+static u32 numChecks;
+
+u32 __real_titleIndexGetOverrides(u64 progId);
+
+// Each of these used to be a file (or directory) opened on the SD card
+u32 __wrap_titleIndexGetOverrides(u64 progId)
+{
+    numChecks++;
+    return __real_titleIndexGetOverrides(progId);
+}
+
+static void expect(const char *name, bool ok)
+{
+    if (!ok)
+    {
+        printf("    %s: FAILED\n", name);
+        failed = true;
+    }
+}
+
+/* What the rest of loader.c needs: hbldr.c isn't built, 3DSX titles aren't launched here */
+
+Result hbldrLoadProcess(Handle *outProcessHandle, const ExHeader_Info *exhi)
+{
+    (void)outProcessHandle;
+    (void)exhi;
+    return -1;
+}
+
+void hbldrPatchExHeaderInfo(ExHeader_Info *exhi)
+{
+    (void)exhi;
+}
+
+/* Commands */
+
+static void setExheader(ExHeader_Info *exhi, u64 titleId, const char *name)
+{
+    ExHeader_CodeSetInfo *csi = &exhi->sci.codeset_info;
+
+    memset(exhi, 0, sizeof(ExHeader_Info));
+    memcpy(csi->name, name, strnlen(name, sizeof(csi->name)));
+    csi->text = (ExHeader_CodeSectionInfo){ 0x100000, 1, SECTION_SIZE };
+    csi->rodata = (ExHeader_CodeSectionInfo){ 0x100000 + SECTION_SIZE, 1, SECTION_SIZE };
+    csi->data = (ExHeader_CodeSectionInfo){ 0x100000 + 2 * SECTION_SIZE, 1, SECTION_SIZE };
+    exhi->aci.local_caps.title_id = titleId;
+    for (u32 i = 0; i < 28; i++)
+        exhi->aci.kernel_caps.descriptors[i] = 0xFFFFFFFF;
+    exhi->aci.kernel_caps.descriptors[0] = 0x1FE << 23 | MEMOP_REGION_APP;
+}
+
+static u32 *command(u32 header, const void *params, u32 size)
+{
+    u32 *cmdbuf = getThreadCommandBuffer();
+    cmdbuf[0] = header;
+    memcpy(&cmdbuf[1], params, size);
+    loaderHandleCommands(NULL);
+    return cmdbuf;
+}
+
+static u64 registerProgram(u64 titleId)
+{
+    FS_ProgramInfo infos[2] = { { titleId, MEDIATYPE_SD, { 0 } }, { titleId, MEDIATYPE_SD, { 0 } } };
+    u64 programHandle;
+
+    setExheader(&g_simExheaderInfo, titleId, "title");
+    u32 *cmdbuf = command(IPC_MakeHeader(2, 8, 0), infos, sizeof(infos));
+
+    expect("registered", cmdbuf[1] == 0);
+    memcpy(&programHandle, &cmdbuf[2], 8);
+    return programHandle;
+}
+
+static void unregisterProgram(u64 programHandle)
+{
+    expect("unregistered", command(IPC_MakeHeader(3, 2, 0), &programHandle, 8)[1] == 0);
+}
+
+static const ExHeader_Info *getProgramInfo(u64 programHandle)
+{
+    u32 *cmdbuf = command(IPC_MakeHeader(4, 2, 0), &programHandle, 8);
+    expect("program info", cmdbuf[1] == 0);
+    return (const ExHeader_Info *)(uintptr_t)cmdbuf[3];
+}
+
+static void loadProcess(u64 programHandle)
+{
+    expect("loaded", command(IPC_MakeHeader(1, 2, 0), &programHandle, 8)[1] == 0);
+}
+
+static LaunchTrace lastLaunchTrace(void)
+{
+    u32 *cmdbuf = command(IPC_MakeHeader(0x103, 0, 0), NULL, 0);
+    const LaunchTrace *traces = (const LaunchTrace *)(uintptr_t)cmdbuf[4];
+    return traces[(cmdbuf[2] - 1) % LAUNCH_TRACE_COUNT];
+}
+
+/* Launches */
+
+typedef struct Launch {
+    LaunchTrace trace;
+    SimFsCounts fs;     ///< FS requests of the whole launch
+    u32 checks;
+} Launch;
+
+// A launch as PM does it, the title exiting right after
+static Launch launch(const char *name, u64 titleId)
+{
+    Launch result;
+    SimFsCounts fs = g_simFsCounts;
+
+    numChecks = 0;
+
+    u64 programHandle = registerProgram(titleId);
+    getProgramInfo(programHandle);
+    loadProcess(programHandle);
+    unregisterProgram(programHandle);
+
+    result.trace = lastLaunchTrace();
+    result.checks = numChecks;
+    result.fs.fileOpens = g_simFsCounts.fileOpens - fs.fileOpens;
+    result.fs.directoryOpens = g_simFsCounts.directoryOpens - fs.directoryOpens;
+    result.fs.directoryReads = g_simFsCounts.directoryReads - fs.directoryReads;
+
+    printf("    %s: %u override checks, %u FS requests (%u directory reads), %u files opened, %u us\n", name, result.checks,
+           result.trace.fsRequests, result.fs.directoryReads, result.fs.fileOpens, result.trace.totalUs);
+    expect("trace", result.trace.titleId == titleId && g_simNumPrograms == 0);
+    return result;
+}
+
+static void addTitleFile(const char *name, const void *data, u32 size)
+{
+    char path[SIM_MAX_PATH];
+    snprintf(path, sizeof(path), APP_DIR "/%s", name);
+    simFsAddFile(ARCHIVE_SDMC, path, data, size);
+}
+
+static void removeTitleFiles(void)
+{
+    static const char *names[] = {
+        "code.bin", "exheader.bin", "code.ips", "CODE.IPS", "locale.txt", "banner.bin", "icon.bin", "cheats.txt", "notes",
+    };
+    char path[SIM_MAX_PATH];
+
+    for (u32 i = 0; i < sizeof(names) / sizeof(names[0]); i++)
+    {
+        snprintf(path, sizeof(path), APP_DIR "/%s", names[i]);
+        simFsRemove(ARCHIVE_SDMC, path);
+    }
+    simFsRemove(ARCHIVE_SDMC, APP_DIR);
+}
+
+/* Checks */
+
+static void noOverrides(void)
+{
+    printf("No overrides:\n");
+
+    // A failed directory open, nothing else
+    Launch l = launch("no directory", APP_ID);
+    expect("one lookup", l.fs.directoryOpens == 1 && l.fs.directoryReads == 0 && l.trace.fsRequests == 2);
+    expect("only .code opened", l.fs.fileOpens == 1 && l.trace.overrides == 0 && l.checks == 6);
+
+    // An empty directory: one read
+    simFsAddDirectory(ARCHIVE_SDMC, APP_DIR);
+    l = launch("empty directory", APP_ID);
+    expect("one enumeration", l.fs.directoryOpens == 1 && l.fs.directoryReads == 1 && l.trace.fsRequests == 3);
+    expect("only .code opened", l.fs.fileOpens == 1 && l.trace.overrides == 0);
+    removeTitleFiles();
+}
+
+static void overrides(void)
+{
+    static const char ips[] = "PATCHEOF", locale[] = "USA EN";
+    ExHeader_Info exhi;
+
+    printf("Overrides:\n");
+
+    setExheader(&exhi, APP_ID, "override");
+    addTitleFile("exheader.bin", &exhi, sizeof(exhi));
+    addTitleFile("code.bin", code, sizeof(code));
+    addTitleFile("CODE.IPS", ips, sizeof(ips) - 1);
+    addTitleFile("locale.txt", locale, sizeof(locale) - 1);
+    addTitleFile("banner.bin", code, 16);
+    addTitleFile("icon.bin", code, 16);
+    addTitleFile("cheats.txt", code, 16);
+    simFsAddDirectory(ARCHIVE_SDMC, APP_DIR "/notes");
+
+    // Eight entries, enumerated once whatever the number of checks; only the overrides present are opened, and
+    // the title settings file the locale is moved to is written
+    Launch l = launch("four overrides", APP_ID);
+    expect("one enumeration", l.fs.directoryOpens == 1 && l.fs.directoryReads == 3 && l.trace.fsRequests == 5);
+    expect("found", l.trace.overrides == (TITLE_OVERRIDE_CODE_BIN | TITLE_OVERRIDE_EXHEADER | TITLE_OVERRIDE_CODE_IPS | TITLE_OVERRIDE_LOCALE));
+    expect("opened instead of .code", l.fs.fileOpens == 5 && l.checks == 6);
+    expect("exheader used", memcmp(g_simCodeSet.name, "override", 8) == 0);
+
+    // USA (1) EN (1), region and language set
+    const volatile LumaTitleSettings *settings = titleSettingsGet(APP_ID);
+    expect("locale applied", g_simLocaleState == (1 << 8 | 1 << 4 | 3));
+    expect("locale moved", settings != NULL && (settings->flags & LUMA_TITLE_SETTING_LOCALE) && settings->locale_mask == 3 &&
+           settings->region_id == 1 && settings->language_id == 1 && simFsFind(ARCHIVE_SDMC, APP_DIR "/locale.txt") == NULL &&
+           simFsFind(ARCHIVE_SDMC, LUMA_TITLE_SETTINGS_PATH) != NULL);
+
+    // Another title's launch in between doesn't see them
+    l = launch("other title", OTHER_APP_ID);
+    expect("other title", l.trace.overrides == 0 && l.fs.directoryOpens == 1 && l.fs.fileOpens == 1);
+    expect("exheader not used", memcmp(g_simCodeSet.name, "title", 6) == 0);
+
+    // GetProgramInfo twice: the index built for the first one is used. The locale now comes from the record
+    SimFsCounts fs = g_simFsCounts;
+    g_simLocaleState = 0;
+    numChecks = 0;
+    u64 programHandle = registerProgram(APP_ID);
+    getProgramInfo(programHandle);
+    getProgramInfo(programHandle);
+    loadProcess(programHandle);
+    expect("enumerated once", g_simFsCounts.directoryOpens == fs.directoryOpens + 1 && lastLaunchTrace().fsRequests == 4);
+    expect("locale from the record", g_simLocaleState == (1 << 8 | 1 << 4 | 3) && numChecks == 5 &&
+           g_simFsCounts.fileOpens == fs.fileOpens + 3 && g_simFsCounts.fileWrites == fs.fileWrites);
+
+    // Forgotten on UnregisterProgram
+    expect("indexed", titleIndexGetCachedOverrides(APP_ID) != 0);
+    unregisterProgram(programHandle);
+    expect("forgotten on unregister", titleIndexGetCachedOverrides(APP_ID) == 0);
+}
+
+static void sdChanges(void)
+{
+    static const char ips[] = "PATCHEOF";
+
+    printf("SD card changes:\n");
+
+    // The same title launched again picks up the changes
+    removeTitleFiles();
+    Launch l = launch("removed", APP_ID);
+    expect("removal seen", l.trace.overrides == 0 && l.fs.directoryOpens == 1 && l.fs.fileOpens == 1);
+
+    addTitleFile("code.ips", ips, sizeof(ips) - 1);
+    l = launch("added", APP_ID);
+    expect("addition seen", l.trace.overrides == TITLE_OVERRIDE_CODE_IPS && l.fs.directoryOpens == 1 && l.fs.fileOpens == 2);
+
+    // Launched again while still registered: only RegisterProgram is there to make its index rebuilt
+    SimFsCounts fs = g_simFsCounts;
+    u64 programHandles[2];
+    programHandles[0] = registerProgram(APP_ID);
+    getProgramInfo(programHandles[0]);
+    loadProcess(programHandles[0]);
+    simFsRemove(ARCHIVE_SDMC, APP_DIR "/code.ips");
+    programHandles[1] = registerProgram(APP_ID);
+    getProgramInfo(programHandles[1]);
+    loadProcess(programHandles[1]);
+    expect("changed while registered", lastLaunchTrace().overrides == 0 && g_simFsCounts.directoryOpens == fs.directoryOpens + 2);
+    unregisterProgram(programHandles[0]);
+    unregisterProgram(programHandles[1]);
+
+    // Changed between RegisterProgram and GetProgramInfo: the index is only built when first needed
+    addTitleFile("code.ips", ips, sizeof(ips) - 1);
+    fs = g_simFsCounts;
+    u64 programHandle = registerProgram(APP_ID);
+    removeTitleFiles();
+    getProgramInfo(programHandle);
+    loadProcess(programHandle);
+    unregisterProgram(programHandle);
+    expect("changed after registering", lastLaunchTrace().overrides == 0 && g_simFsCounts.fileOpens == fs.fileOpens + 1);
+}
+
+int main(void)
+{
+    simFsReset();
+    isSdMode = true;
+    config |= BIT(PATCHGAMES);
+    simFsAddDirectory(ARCHIVE_SDMC, "/luma/titles");
+    simFsAddFile(ARCHIVE_SAVEDATA_AND_CONTENT2, SIM_CODE_PATH, code, sizeof(code));
+
+    // The patch cache and title settings are read on the first launch only
+    launch("first launch", OTHER_APP_ID);
+
+    noOverrides();
+    overrides();
+    sdChanges();
+
+    printf("%s\n", failed ? "FAILED" : "ok");
+    return failed ? 1 : 0;
+}
@@ -32,8 +32,6 @@
 
 #define Log_PrintP(...) ((void)0)
 
-#define MAXRELOCS 512
-static _3DSX_Reloc s_relocBuf[MAXRELOCS];
 u32 ldrArgvBuf[ARGVBUF_SIZE/4];
 
 #define SEC_ASSERT(x) do { if (!(x)) { Log_PrintP("Assertion failed: %s", #x); return false; } } while (0)
@@ -45,13 +43,122 @@ typedef struct
     u32 segSizes[3];
 } _3DSX_LoadInfo;
 
-static inline u32 TranslateAddr(u32 off, _3DSX_LoadInfo* d, u32* offsets)
+// Maps the pre-relocation layout (page-aligned segments back to back) to the final addresses
+typedef struct
+{
+    u32 limit;
+    u32 delta;
+} _3DSX_SegXlat;
+
+// Sequential reader over the relocation tables, which are read into scratch memory as few times as possible
+typedef struct
+{
+    IFile* file;
+    u32 offset;
+    u32 remaining; // not yet read from the file
+    _3DSX_Reloc* buf;
+    u32 capacity;
+    u32 pos, count;
+} _3DSX_RelocReader;
+
+static inline u32 TranslateAddr(u32 off, const _3DSX_SegXlat* xlat)
+{
+    if (off < xlat[0].limit)
+        return off + xlat[0].delta;
+    if (off < xlat[1].limit)
+        return off + xlat[1].delta;
+    return off + xlat[2].delta;
+}
+
+static const _3DSX_Reloc* NextRelocs(_3DSX_RelocReader* r, u32 maxCount, u32* outCount)
+{
+    if (r->pos == r->count)
+    {
+        u32 toRead = r->remaining < r->capacity ? r->remaining : r->capacity;
+        u32 readSize = toRead * sizeof(_3DSX_Reloc);
+        if (toRead == 0 || IFile_Read2(r->file, r->buf, readSize, r->offset) != readSize)
+            return NULL;
+        r->offset += readSize;
+        r->remaining -= toRead;
+        r->pos = 0;
+        r->count = toRead;
+    }
+
+    u32 n = r->count - r->pos;
+    *outCount = n < maxCount ? n : maxCount;
+    r->pos += *outCount;
+    return &r->buf[r->pos - *outCount];
+}
+
+static void SkipRelocs(_3DSX_RelocReader* r, u32 count)
 {
-    if (off < offsets[0])
-        return d->segAddrs[0] + off;
-    if (off < offsets[1])
-        return d->segAddrs[1] + off - offsets[0];
-    return d->segAddrs[2] + off - offsets[1];
+    u32 n = r->count - r->pos;
+    n = n < count ? n : count;
+    r->pos += n;
+    count -= n;
+
+    // What isn't buffered yet doesn't need to be read at all
+    count = count < r->remaining ? count : r->remaining;
+    r->offset += count * sizeof(_3DSX_Reloc);
+    r->remaining -= count;
+}
+
+// Applies one relocation table to a segment, one buffered batch of entries at a time
+static bool ApplyRelocs(_3DSX_RelocReader* r, u32 nRelocs, bool isRelative, u32* pos, u32* endPos, u32 addrDelta, const _3DSX_SegXlat* xlat)
+{
+    while (nRelocs != 0)
+    {
+        u32 n;
+        const _3DSX_Reloc* relocs = NextRelocs(r, nRelocs, &n);
+        if (relocs == NULL)
+        {
+            Log_PrintP("Cannot read reloc table");
+            return false;
+        }
+        nRelocs -= n;
+
+        for (u32 k = 0; k < n && pos < endPos; k++)
+        {
+            pos += relocs[k].skip;
+            if (pos >= endPos)
+                break;
+
+            u32* patchEnd = (u32)(endPos - pos) < relocs[k].patch ? endPos : pos + relocs[k].patch;
+
+            if (!isRelative)
+            {
+                for (; pos < patchEnd; pos++)
+                {
+                    u32 origData = *pos;
+                    if (origData >> (32-4) != 0)
+                    {
+                        Log_PrintP("Unsupported absolute reloc subtype (%lu)", origData >> (32-4));
+                        return false;
+                    }
+                    *pos = TranslateAddr(origData, xlat);
+                }
+            }
+            else
+            {
+                for (; pos < patchEnd; pos++)
+                {
+                    u32 origData = *pos;
+                    u32 subType = origData >> (32-4);
+                    u32 data = TranslateAddr(origData &~ 0xF0000000, xlat) - ((u32)pos + addrDelta);
+                    switch (subType)
+                    {
+                        case 0: *pos = data;            break; // 32-bit signed offset
+                        case 1: *pos = data &~ BIT(31); break; // 31-bit signed offset
+                        default:
+                            Log_PrintP("Unsupported relative reloc subtype (%lu)", subType);
+                            return false;
+                    }
+                }
+            }
+        }
+    }
+
+    return true;
 }
 
 bool Ldr_Get3dsxSize(u32* pSize, IFile *file)
@@ -84,17 +191,16 @@ bool Ldr_Get3dsxSize(u32* pSize, IFile *file)
     return true;
 }
 
-static inline u32 min(u32 a, u32 b)
-{
-    return a < b ? a : b;
-}
-
 Handle Ldr_CodesetFrom3dsx(const char* name, u32* codePages, u32 baseAddr, IFile *file, u64 tid)
 {
-    u32 i,j,k,m;
+    u32 i,j;
     Result res;
     _3DSX_Header hdr;
-    IFile_Read2(file, &hdr, sizeof(hdr), 0);
+    if (IFile_Read2(file, &hdr, sizeof(hdr), 0) != sizeof(hdr))
+    {
+        Log_PrintP("Cannot read 3DSX header");
+        return 0;
+    }
 
     _3DSX_LoadInfo d;
     d.segSizes[0] = (hdr.codeSegSize+0xFFF) &~ 0xFFF;
@@ -107,8 +213,13 @@ Handle Ldr_CodesetFrom3dsx(const char* name, u32* codePages, u32 baseAddr, IFile
     d.segAddrs[1] = d.segAddrs[0] + d.segSizes[0];
     d.segAddrs[2] = d.segAddrs[1] + d.segSizes[1];
 
-    u32 offsets[2] = { d.segSizes[0], d.segSizes[0] + d.segSizes[1] };
-    u32* segLimit = d.segPtrs[2] + d.segSizes[2];
+    _3DSX_SegXlat xlat[3] = {
+        { d.segSizes[0],                                   d.segAddrs[0] },
+        { d.segSizes[0] + d.segSizes[1],                   d.segAddrs[1] - d.segSizes[0] },
+        { d.segSizes[0] + d.segSizes[1] + d.segSizes[2],   d.segAddrs[2] - d.segSizes[0] - d.segSizes[1] },
+    };
+
+    u32* segLimit = (u32*)((char*)d.segPtrs[2] + d.segSizes[2]);
 
     u32 readOffset = hdr.headerSize;
 
@@ -117,116 +228,92 @@ Handle Ldr_CodesetFrom3dsx(const char* name, u32* codePages, u32 baseAddr, IFile
     u32* extraPage = (u32*)((char*)d.segPtrs[2] + d.segSizes[2]);
     u32 extraPageAddr = d.segAddrs[2] + d.segSizes[2];
 
-    // Read the relocation headers
-    for (i = 0; i < 3; i ++)
-    {
-        if (IFile_Read2(file, &extraPage[i*nRelocTables], hdr.relocHdrSize, readOffset) != hdr.relocHdrSize)
-        {
-            Log_PrintP("Cannot read relheader %d", i);
-            return 0;
-        }
-        readOffset += hdr.relocHdrSize;
-    }
-
-    // Read the code segment
-    if (IFile_Read2(file, d.segPtrs[0], hdr.codeSegSize, readOffset) != hdr.codeSegSize)
+    // Read the relocation headers, all at once
+    u32 relocHdrsSize = 3 * hdr.relocHdrSize;
+    if (IFile_Read2(file, extraPage, relocHdrsSize, readOffset) != relocHdrsSize)
     {
-        Log_PrintP("Cannot read code segment");
+        Log_PrintP("Cannot read relheaders");
         return 0;
     }
-    readOffset += hdr.codeSegSize;
+    readOffset += relocHdrsSize;
 
-    // Read the rodata segment
-    if (IFile_Read2(file, d.segPtrs[1], hdr.rodataSegSize, readOffset) != hdr.rodataSegSize)
+    // Keep the counts we use, as the extra page is about to be used as scratch memory
+    u32 relocCounts[3][sizeof(_3DSX_RelocHdr)/4] = {{ 0 }};
+    u32 relocSkipCounts[3] = { 0 };
+    u32 nRelocsTotal = 0;
+    for (i = 0; i < 3; i ++)
     {
-        Log_PrintP("Cannot read rodata segment");
-        return 0;
+        for (j = 0; j < nRelocTables; j ++)
+        {
+            u32 nRelocs = extraPage[i*nRelocTables + j];
+            SEC_ASSERT(nRelocs <= 0x10000000 && nRelocsTotal + nRelocs <= 0x10000000);
+            nRelocsTotal += nRelocs;
+            if (j < (sizeof(_3DSX_RelocHdr)/4))
+                relocCounts[i][j] = nRelocs;
+            else
+                relocSkipCounts[i] += nRelocs; // not using this header
+        }
     }
-    readOffset += hdr.rodataSegSize;
 
-    // Read the data segment
+    // Read each segment straight to its page: the data segment is followed in the file by the relocation
+    // tables, so the first batch of them is read along with it when it ends where the scratch buffer starts
+    SEC_ASSERT(hdr.bssSize <= hdr.dataSegSize);
     u32 dataLoadSegSize = hdr.dataSegSize - hdr.bssSize;
-    if (IFile_Read2(file, d.segPtrs[2], dataLoadSegSize, readOffset) != dataLoadSegSize)
+    u32 loadSizes[3] = { hdr.codeSegSize, hdr.rodataSegSize, dataLoadSegSize };
+
+    // The BSS, the page padding and the extra page are free until the process starts: buffer the
+    // relocation tables there (in one go for almost every file). Relocations never target the BSS.
+    u32* scratch = (u32*)(((u32)d.segPtrs[2] + dataLoadSegSize + 3) &~ 3);
+    _3DSX_RelocReader reader = {
+        .file       = file,
+        .offset     = readOffset + hdr.codeSegSize + hdr.rodataSegSize + dataLoadSegSize,
+        .remaining  = nRelocsTotal,
+        .buf        = (_3DSX_Reloc*)scratch,
+        .capacity   = (u32)((char*)extraPage + 0x1000 - (char*)scratch) / sizeof(_3DSX_Reloc),
+        .pos        = 0,
+        .count      = 0,
+    };
+
+    if ((dataLoadSegSize & 3) == 0)
     {
-        Log_PrintP("Cannot read data segment");
-        return 0;
+        reader.count = nRelocsTotal < reader.capacity ? nRelocsTotal : reader.capacity;
+        reader.remaining -= reader.count;
+        reader.offset += reader.count * sizeof(_3DSX_Reloc);
+        loadSizes[2] += reader.count * sizeof(_3DSX_Reloc);
     }
-    readOffset += dataLoadSegSize;
 
-    // Relocate the segments
     for (i = 0; i < 3; i ++)
     {
-        for (j = 0; j < nRelocTables; j ++)
+        if (loadSizes[i] != 0 && IFile_Read2(file, d.segPtrs[i], loadSizes[i], readOffset) != loadSizes[i])
         {
-            int nRelocs = extraPage[i*nRelocTables + j];
-            if (j >= (sizeof(_3DSX_RelocHdr)/4))
-            {
-                // Not using this header
-                readOffset += nRelocs;
-                continue;
-            }
-
-            u32* pos = (u32*)d.segPtrs[i];
-            u32* endPos = pos + (d.segSizes[i]/4);
-            SEC_ASSERT(endPos <= segLimit);
+            Log_PrintP("Cannot read segments");
+            return 0;
+        }
+        readOffset += loadSizes[i];
+    }
 
-            while (nRelocs)
-            {
-                u32 toDo = nRelocs > MAXRELOCS ? MAXRELOCS : nRelocs;
-                nRelocs -= toDo;
+    memset((char*)d.segPtrs[0] + hdr.codeSegSize, 0, d.segSizes[0] - hdr.codeSegSize);
+    memset((char*)d.segPtrs[1] + hdr.rodataSegSize, 0, d.segSizes[1] - hdr.rodataSegSize);
 
-                u32 readSize = toDo*sizeof(_3DSX_Reloc);
-                if (IFile_Read2(file, s_relocBuf, readSize, readOffset) != readSize)
-                {
-                    Log_PrintP("Cannot read reloc table (%d,%d)", i, j);
-                    return 0;
-                }
-                readOffset += readSize;
+    // Relocate the segments
+    for (i = 0; i < 3; i ++)
+    {
+        u32* endPos = (u32*)d.segPtrs[i] + (d.segSizes[i]/4);
+        SEC_ASSERT(endPos <= segLimit);
+        if (i == 2)
+            endPos = scratch;
 
-                for (k = 0; k < toDo && pos < endPos; k ++)
-                {
-                    pos += s_relocBuf[k].skip;
-                    u32 nPatches = s_relocBuf[k].patch;
-                    for (m = 0; m < nPatches && pos < endPos; m ++)
-                    {
-                        u32 inAddr = baseAddr + 4*(pos - codePages);
-                        u32 origData = *pos;
-                        u32 subType = origData >> (32-4);
-                        u32 addr = TranslateAddr(origData &~ 0xF0000000, &d, offsets);
-                        //Log_PrintP("%08lX<-%08lX", inAddr, addr);
-                        switch (j)
-                        {
-                            case 0:
-                            {
-                                if (subType != 0)
-                                {
-                                    Log_PrintP("Unsupported absolute reloc subtype (%lu)", subType);
-                                    return 0;
-                                }
-                                *pos = addr;
-                                break;
-                            }
-                            case 1:
-                            {
-                                u32 data = addr - inAddr;
-                                switch (subType)
-                                {
-                                    case 0: *pos = data;            break; // 32-bit signed offset
-                                    case 1: *pos = data &~ BIT(31); break; // 31-bit signed offset
-                                    default:
-                                        Log_PrintP("Unsupported relative reloc subtype (%lu)", subType);
-                                        return 0;
-                                }
-                                break;
-                            }
-                        }
-                        pos++;
-                    }
-                }
-            }
+        for (j = 0; j < nRelocTables && j < (sizeof(_3DSX_RelocHdr)/4); j ++)
+        {
+            if (!ApplyRelocs(&reader, relocCounts[i][j], j == 1, (u32*)d.segPtrs[i], endPos, baseAddr - (u32)codePages, xlat))
+                return 0;
         }
+        SkipRelocs(&reader, relocSkipCounts[i]);
     }
 
+    // Only what the largest batch of relocations covered needs to be cleared again
+    memset(scratch, 0, (nRelocsTotal < reader.capacity ? nRelocsTotal : reader.capacity) * sizeof(_3DSX_Reloc));
+
     // Detect and fill _prm structure
     PrmStruct* pst = (PrmStruct*) &codePages[1];
     if (pst->magic == _PRM_MAGIC)
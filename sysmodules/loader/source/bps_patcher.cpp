@@ -14,7 +14,9 @@ extern "C"
 #include <3ds/svc.h>
 
 #include "patcher.h"
+#include "patch_cache.h"
 #include "strings.h"
+#include "title_index.h"
 }
 
 #include "file_util.h"
@@ -262,7 +264,7 @@ static inline bool ApplyCodeBpsPatch(u64 prog_id, u8 *code, u32 size)
     {
         char bps_path[] = "/luma/titles/0000000000000000/code.bps";
         progIdToStr(bps_path + 28, prog_id);
-        if(!patch_file.Open(bps_path, FS_OPEN_READ))
+        if(!(titleIndexGetOverrides(prog_id) & TITLE_OVERRIDE_CODE_BPS) || !patch_file.Open(bps_path, FS_OPEN_READ))
             return true;
     }
 
@@ -277,6 +279,9 @@ static inline bool ApplyCodeBpsPatch(u64 prog_id, u8 *code, u32 size)
     if(!patch_file.Read(patch_data, patch_size, 0))
         return false;
 
+    // Searches made after the patch are only answered from the cache for the same patch
+    patchCacheCodeChanged(patch_data, patch_size);
+
     Bps::Stream<const u8> source_stream{source_data, size};
     Bps::Stream target_stream{code, size};
     Bps::Stream<const u8> patch_stream{patch_data, patch_size};
@@ -6,6 +6,7 @@
 #include "util.h"
 #include "hbldr.h"
 #include "loader.h"
+#include "title_index.h"
 
 #define SYSMODULE_CXI_COOKIE_MASK 0xEEEE000000000000ull
 
@@ -29,6 +30,11 @@ static ExHeader_Info g_exheaderInfo;
 // Last application exheader info, for use with custom cmd 0x102
 static ExHeader_Info g_lastAppExheaderInfo;
 
+// Ring buffer of the last launches, newest at (g_launchTraceCount - 1) % LAUNCH_TRACE_COUNT
+static LaunchTrace g_launchTraces[LAUNCH_TRACE_COUNT];
+static u32 g_launchTraceCount;
+static LaunchTrace g_currentLaunchTrace;
+
 static IFile g_cached_sysmoduleCxiFile;
 static u64 g_cached_sysmoduleCxiCookie;
 static Ncch g_cached_sysmoduleCxiNcch;
@@ -120,6 +126,11 @@ static int lzss_decompress(u8 *end)
     return ret;
 }
 
+static inline u32 ticksToUs(u64 ticks)
+{
+    return (u32)(ticks * 1000000 / SYSCLOCK_ARM11);
+}
+
 static inline bool IsSysmoduleId(u64 tid)
 {
     return (tid >> 32) == 0x00040130;
@@ -184,6 +195,7 @@ static Result loadCode(const ExHeader_Info *exhi, u64 programHandle, const prog_
         return 0;
     }
 
+    u64 startTick = svcGetSystemTick();
     bool codeLoadedExternally = false;
     if (CONFIG(PATCHGAMES))
     {
@@ -226,8 +238,12 @@ static Result loadCode(const ExHeader_Info *exhi, u64 programHandle, const prog_
             lzss_decompress((u8 *)mapped->text_addr + size);
     }
 
+    u64 patchStartTick = svcGetSystemTick();
+    g_currentLaunchTrace.codeLoadUs = ticksToUs(patchStartTick - startTick);
+
     patchCode(titleId, csi->flags.remaster_version, (u8 *)mapped->text_addr, mapped->total_size << 12, csi->text.size, csi->rodata.size, csi->data.size, csi->rodata.address, csi->data.address);
 
+    g_currentLaunchTrace.patchUs = ticksToUs(svcGetSystemTick() - patchStartTick);
     return 0;
 }
 
@@ -388,9 +404,11 @@ static Result GetProgramInfoImpl(ExHeader_Info *exheaderInfo, u64 programHandle)
             exheaderInfo->aci.local_caps.core_info.n3ds_system_mode = g_memoryOverrideConfig.n3ds_mode;
     }
     
-        if(isN3DS)
+    if(isN3DS)
     {
-        exheaderInfo->aci.local_caps.core_info.enable_l2c |= useN3dsSettings(exheaderInfo->aci.local_caps.title_id);
+        u8 n3dsMode = titleN3dsMode(exheaderInfo->aci.local_caps.title_id);
+        exheaderInfo->aci.local_caps.core_info.enable_l2c |= (n3dsMode & LUMA_N3DS_MODE_L2_CACHE) != 0;
+        exheaderInfo->aci.local_caps.core_info.use_cpu_clockrate_804MHz |= (n3dsMode & LUMA_N3DS_MODE_CLOCK_804MHZ) != 0;
     }
 
     return res;
@@ -403,7 +421,13 @@ static Result GetProgramInfo(u64 programHandle)
 
     if (programHandle != g_cached_programHandle || hbldrIs3dsxTitle(cachedTitleId))
     {
+        // Start a new launch trace
+        memset(&g_currentLaunchTrace, 0, sizeof(g_currentLaunchTrace));
+        titleIndexTakeFsRequestCount();
+        u64 startTick = svcGetSystemTick();
+
         res = GetProgramInfoImpl(&g_exheaderInfo, programHandle);
+        g_currentLaunchTrace.programInfoUs = ticksToUs(svcGetSystemTick() - startTick);
         g_cached_programHandle = R_SUCCEEDED(res) ? programHandle : 0;
         if (R_SUCCEEDED(res) && (u32)((g_exheaderInfo.aci.local_caps.title_id >> 0x20) & 0xFFFFFFEDULL) == 0x00040000) {
             memcpy(&g_lastAppExheaderInfo, &g_exheaderInfo, sizeof(g_lastAppExheaderInfo));
@@ -495,16 +519,33 @@ static Result LoadProcessImpl(Handle *outProcessHandle, const ExHeader_Info *exh
     return res;
 }
 
+static void CommitLaunchTrace(u64 titleId, u64 startTick)
+{
+    LaunchTrace *trace = &g_currentLaunchTrace;
+    trace->titleId = titleId;
+    trace->totalUs = ticksToUs(svcGetSystemTick() - startTick);
+    trace->fsRequests = titleIndexTakeFsRequestCount();
+    trace->overrides = titleIndexGetCachedOverrides(titleId);
+
+    g_launchTraces[g_launchTraceCount++ % LAUNCH_TRACE_COUNT] = *trace;
+    memset(trace, 0, sizeof(LaunchTrace));
+}
+
 static Result LoadProcess(Handle *process, u64 programHandle)
 {
     Result res = 0;
+    u64 startTick = svcGetSystemTick();
     TRY(GetProgramInfo(programHandle));
 
-    if (hbldrIs3dsxTitle(g_exheaderInfo.aci.local_caps.title_id))
-        return assertSuccess(hbldrLoadProcess(process, &g_exheaderInfo));
+    u64 titleId = g_exheaderInfo.aci.local_caps.title_id;
+    if (hbldrIs3dsxTitle(titleId))
+        res = assertSuccess(hbldrLoadProcess(process, &g_exheaderInfo));
     else
         // Break on failure, even here (if GetProgramInfo succeeds we shouldn't be here anyway)
-        return assertSuccess(LoadProcessImpl(process, &g_exheaderInfo, programHandle));
+        res = assertSuccess(LoadProcessImpl(process, &g_exheaderInfo, programHandle));
+
+    CommitLaunchTrace(titleId, startTick);
+    return res;
 }
 
 static Result RegisterProgram(u64 *programHandle, FS_ProgramInfo *title, FS_ProgramInfo *update)
@@ -513,6 +554,10 @@ static Result RegisterProgram(u64 *programHandle, FS_ProgramInfo *title, FS_Prog
     u64 titleId;
 
     titleId = title->programId;
+
+    // New launch: rebuild the override index, the SD card may have been modified since the last one
+    titleIndexInvalidate();
+
     if (IsHioId(titleId))
     {
         if ((title->mediaType != update->mediaType) || (titleId != update->programId))
@@ -560,6 +605,8 @@ static Result UnregisterProgram(u64 programHandle)
     if (g_cached_programHandle == programHandle)
         g_cached_programHandle = 0;
 
+    titleIndexInvalidate();
+
     if (IsSysmoduleCxiCookie(programHandle))
     {
         if (programHandle == g_cached_sysmoduleCxiCookie)
@@ -635,6 +682,13 @@ void loaderHandleCommands(void *ctx)
             cmdbuf[2] = IPC_Desc_StaticBuffer(sizeof(ExHeader_Info), 0);
             cmdbuf[3] = (u32)&g_lastAppExheaderInfo;
             break;
+        case 0x103: // GetLaunchTraces
+            cmdbuf[0] = IPC_MakeHeader(0x103, 2, 2);
+            cmdbuf[1] = (Result)0;
+            cmdbuf[2] = g_launchTraceCount;
+            cmdbuf[3] = IPC_Desc_StaticBuffer(sizeof(g_launchTraces), 0);
+            cmdbuf[4] = (u32)g_launchTraces;
+            break;
         default: // error
             cmdbuf[0] = IPC_MakeHeader(0, 1, 0);
             cmdbuf[1] = 0xD900182F;
@@ -3,4 +3,17 @@
 #include <3ds/types.h>
 #include "util.h"
 
+#define LAUNCH_TRACE_COUNT 8
+
+// Launch latency trace, retrieved with the custom command 0x103 (GetLaunchTraces) and shown by Rosalina (Miscellaneous options)
+typedef struct LaunchTrace {
+    u64 titleId;
+    u32 programInfoUs;  //< GetProgramInfo, including the exheader override
+    u32 codeLoadUs;     //< Reading (and decompressing) the code
+    u32 patchUs;        //< patchCode, including the per-title override files
+    u32 totalUs;        //< Whole LoadProcess
+    u32 fsRequests;     //< FS requests issued to look up per-title overrides
+    u32 overrides;      //< titleOverrides found
+} LaunchTrace;
+
 void loaderHandleCommands(void *ctx);
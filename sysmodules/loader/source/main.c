@@ -74,6 +74,8 @@ static inline void loadCFWInfo(void)
     Luma_SharedConfig->hbldr_3dsx_tid = hbldrTid;
     Luma_SharedConfig->selected_hbldr_3dsx_tid = hbldrTid;
     Luma_SharedConfig->use_hbldr = true;
+    Luma_SharedConfig->title_settings_loaded = false;
+    Luma_SharedConfig->num_title_settings = 0;
 }
 
 void __ctru_exit(int rc) { (void)rc; } // needed to avoid linking error
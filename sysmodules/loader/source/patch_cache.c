@@ -0,0 +1,264 @@
+#include <3ds.h>
+#include "patch_cache.h"
+#include "patcher.h"
+#include "memory.h"
+#include "ifile.h"
+
+static struct {
+    PatchCacheHeader header;
+    PatchCacheEntry entries[PATCH_CACHE_MAX_ENTRIES];
+} g_patchCache;
+
+static bool g_patchCacheLoaded = false;
+
+static PatchCacheEntry g_currentEntry; // sites used or found during this launch
+static const PatchCacheEntry *g_cachedEntry;
+static bool g_cachedEntryLooked;
+static bool g_currentDirty;
+static bool g_active = false;
+
+static u8 *g_code;
+static u32 g_codeState; // changes with each IPS/BPS patch applied
+static u32 g_searchKeys[PATCH_CACHE_MAX_SEARCHES]; // without the occurrence number
+static u32 g_numSearches;
+
+static Result patchCacheOpen(IFile *file, u32 flags)
+{
+    FS_ArchiveID archiveId = isSdMode ? ARCHIVE_SDMC : ARCHIVE_NAND_RW;
+    return IFile_Open(file, archiveId, fsMakePath(PATH_EMPTY, ""), fsMakePath(PATH_ASCII, PATCH_CACHE_PATH), flags);
+}
+
+// Only read once per boot, the loader is the only writer
+static void patchCacheLoad(void)
+{
+    IFile file;
+    u64 total;
+
+    g_patchCacheLoaded = true;
+    memset(&g_patchCache.header, 0, sizeof(g_patchCache.header));
+
+    if(R_FAILED(patchCacheOpen(&file, FS_OPEN_READ))) return;
+
+    if(R_FAILED(IFile_Read(&file, &total, &g_patchCache, sizeof(g_patchCache))) || total < sizeof(PatchCacheHeader) ||
+       g_patchCache.header.magic != PATCH_CACHE_MAGIC || g_patchCache.header.version != PATCH_CACHE_VERSION ||
+       g_patchCache.header.numEntries > PATCH_CACHE_MAX_ENTRIES || g_patchCache.header.nextEntry >= PATCH_CACHE_MAX_ENTRIES ||
+       total < sizeof(PatchCacheHeader) + g_patchCache.header.numEntries * sizeof(PatchCacheEntry))
+        memset(&g_patchCache.header, 0, sizeof(g_patchCache.header));
+
+    for(u32 i = 0; i < g_patchCache.header.numEntries; i++)
+    {
+        if(g_patchCache.entries[i].numSites > PATCH_CACHE_MAX_SITES)
+            g_patchCache.entries[i].numSites = 0;
+    }
+
+    IFile_Close(&file);
+}
+
+static void patchCacheSave(void)
+{
+    IFile file;
+    u64 total;
+    u32 size = sizeof(PatchCacheHeader) + g_patchCache.header.numEntries * sizeof(PatchCacheEntry);
+
+    if(R_FAILED(patchCacheOpen(&file, FS_OPEN_CREATE | FS_OPEN_WRITE))) return;
+
+    if(R_SUCCEEDED(IFile_SetSize(&file, size)))
+        IFile_Write(&file, &total, &g_patchCache, size, FS_WRITE_FLUSH);
+
+    IFile_Close(&file);
+}
+
+static inline u32 patchCacheHashBytes(u32 hash, const void *data, u32 size)
+{
+    const u8 *bytes = (const u8 *)data;
+
+    for(u32 i = 0; i < size; i++)
+    {
+        hash ^= bytes[i];
+        hash *= 16777619u;
+    }
+
+    return hash;
+}
+
+static inline u32 patchCacheHashWord(u32 hash, u32 word)
+{
+    return patchCacheHashBytes(hash, &word, 4);
+}
+
+u32 patchCacheHashText(const u8 *code, u32 textSize)
+{
+    // FNV-1a over one word every 256 bytes: enough to tell builds apart, as sites are verified individually anyway
+    u32 hash = 2166136261u ^ textSize;
+
+    for(u32 i = 0; i + 4 <= textSize; i += 256)
+    {
+        hash ^= *(const u32 *)(code + i);
+        hash *= 16777619u;
+    }
+
+    return hash;
+}
+
+void patchCacheBegin(u64 progId, u16 progVer, u8 *code, u32 textSize)
+{
+    memset(&g_currentEntry, 0, sizeof(g_currentEntry));
+    g_currentEntry.progId = progId;
+    g_currentEntry.progVer = progVer;
+    g_currentEntry.textSize = textSize;
+    g_currentEntry.textHash = patchCacheHashText(code, textSize);
+
+    g_cachedEntry = NULL;
+    g_cachedEntryLooked = false;
+    g_currentDirty = false;
+    g_active = true;
+
+    g_code = code;
+    g_codeState = 2166136261u;
+    g_numSearches = 0;
+}
+
+static const PatchCacheEntry *patchCacheFind(void)
+{
+    if(!g_patchCacheLoaded) patchCacheLoad();
+
+    for(u32 i = 0; i < g_patchCache.header.numEntries; i++)
+    {
+        const PatchCacheEntry *entry = &g_patchCache.entries[i];
+        if(entry->progId == g_currentEntry.progId && entry->progVer == g_currentEntry.progVer &&
+           entry->textSize == g_currentEntry.textSize && entry->textHash == g_currentEntry.textHash)
+            return entry;
+    }
+
+    return NULL;
+}
+
+u32 patchCacheSearchKey(const u8 *start, u32 size, const void *what, u32 whatSize)
+{
+    if(!g_active || g_numSearches >= PATCH_CACHE_MAX_SEARCHES) return 0;
+
+    u32 key = patchCacheHashBytes(g_codeState, what, whatSize);
+    key = patchCacheHashWord(key, whatSize);
+    key = patchCacheHashWord(key, (u32)(start - g_code));
+    key = patchCacheHashWord(key, size);
+
+    // The same search may run again once the code has been patched, e.g. by patchMemory with the same region
+    u32 occurrence = 0;
+    for(u32 i = 0; i < g_numSearches; i++)
+        occurrence += g_searchKeys[i] == key;
+    g_searchKeys[g_numSearches++] = key;
+
+    key = patchCacheHashWord(key, occurrence);
+    return key != 0 ? key : 1;
+}
+
+static s32 patchCacheFindSite(const PatchCacheSite *sites, u32 numSites, u32 key)
+{
+    for(u32 i = 0; i < numSites; i++)
+    {
+        if(sites[i].key == key) return (s32)i;
+    }
+
+    return -1;
+}
+
+// Keeps a site in the entry written back, returns false when it is full
+static bool patchCacheKeepSite(u32 key, u32 offset)
+{
+    s32 idx = patchCacheFindSite(g_currentEntry.sites, g_currentEntry.numSites, key);
+
+    if(idx < 0)
+    {
+        if(g_currentEntry.numSites >= PATCH_CACHE_MAX_SITES) return false;
+        idx = g_currentEntry.numSites++;
+        g_currentEntry.sites[idx].key = key;
+    }
+
+    g_currentEntry.sites[idx].offset = offset;
+    return true;
+}
+
+bool patchCacheLookup(u32 key, u32 *offset)
+{
+    if(!g_active || key == 0) return false;
+
+    // The cache file is only looked at once a title actually needs a site
+    if(!g_cachedEntryLooked)
+    {
+        g_cachedEntry = patchCacheFind();
+        g_cachedEntryLooked = true;
+    }
+
+    if(g_cachedEntry == NULL) return false;
+
+    s32 idx = patchCacheFindSite(g_cachedEntry->sites, g_cachedEntry->numSites, key);
+    if(idx < 0) return false;
+
+    // Kept in the entry unless the caller records another site for the search
+    *offset = g_cachedEntry->sites[idx].offset;
+    patchCacheKeepSite(key, *offset);
+    return true;
+}
+
+void patchCacheRecord(u32 key, u32 offset)
+{
+    if(!g_active || key == 0) return;
+
+    if(patchCacheKeepSite(key, offset)) g_currentDirty = true;
+}
+
+void patchCacheCodeChanged(const void *data, u32 size)
+{
+    g_codeState = patchCacheHashWord(patchCacheHashBytes(g_codeState, data, size), size);
+}
+
+u8 *patchCacheMemsearch(u8 *start, const void *pattern, u32 size, u32 patternSize)
+{
+    u32 key = patchCacheSearchKey(start, size, pattern, patternSize),
+        at;
+
+    if(patchCacheLookup(key, &at) && patternSize <= size && at <= size - patternSize && memcmp(start + at, pattern, patternSize) == 0)
+        return start + at;
+
+    u8 *found = memsearch(start, pattern, size, patternSize);
+    if(found != NULL) patchCacheRecord(key, (u32)(found - start));
+
+    return found;
+}
+
+void patchCacheEnd(bool success)
+{
+    if(g_active && success && g_currentDirty)
+    {
+        if(!g_cachedEntryLooked) g_cachedEntry = patchCacheFind();
+
+        PatchCacheEntry *entry = (PatchCacheEntry *)g_cachedEntry;
+
+        if(entry == NULL)
+        {
+            if(g_patchCache.header.numEntries < PATCH_CACHE_MAX_ENTRIES)
+                entry = &g_patchCache.entries[g_patchCache.header.numEntries++];
+            else
+            {
+                entry = &g_patchCache.entries[g_patchCache.header.nextEntry];
+                g_patchCache.header.nextEntry = (g_patchCache.header.nextEntry + 1) % PATCH_CACHE_MAX_ENTRIES;
+            }
+        }
+        else
+        {
+            // Keep the sites of the searches made with other settings, as long as there is room
+            for(u32 i = 0; i < entry->numSites && g_currentEntry.numSites < PATCH_CACHE_MAX_SITES; i++)
+            {
+                if(patchCacheFindSite(g_currentEntry.sites, g_currentEntry.numSites, entry->sites[i].key) < 0)
+                    g_currentEntry.sites[g_currentEntry.numSites++] = entry->sites[i];
+            }
+        }
+
+        g_patchCache.header.magic = PATCH_CACHE_MAGIC;
+        g_patchCache.header.version = PATCH_CACHE_VERSION;
+        *entry = g_currentEntry;
+        patchCacheSave();
+    }
+
+    g_active = false;
+}
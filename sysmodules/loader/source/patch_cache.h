@@ -0,0 +1,64 @@
+#pragma once
+
+#include <3ds/types.h>
+
+/* Persistent database of patch sites, so that the signature searches of patchCode
+   only run on the first launch of a given build of a title. Entries are keyed by
+   (progId, progVer, hash of the .text section). Within an entry, each site is keyed
+   by what was searched for: the pattern, the searched region, how many times the same
+   search already ran during the launch, and the IPS/BPS patches applied before it.
+   Sites are only hints: callers check that what they search for is still there before
+   using one, and search again otherwise. Unsuccessful searches are never cached. */
+
+#define PATCH_CACHE_PATH        "/luma/patchcache.bin"
+#define PATCH_CACHE_MAGIC       0x48435450 // 'PTCH'
+#define PATCH_CACHE_VERSION     2
+
+#define PATCH_CACHE_MAX_ENTRIES 24
+#define PATCH_CACHE_MAX_SITES   16
+#define PATCH_CACHE_MAX_SEARCHES 32 // per launch; later searches aren't cached
+
+typedef struct PatchCacheSite {
+    u32 key;
+    u32 offset; //< From the start of the searched region
+} PatchCacheSite;
+
+typedef struct PatchCacheEntry {
+    u64 progId;
+    u16 progVer;
+    u16 numSites;
+    u32 textSize;
+    u32 textHash;
+    PatchCacheSite sites[PATCH_CACHE_MAX_SITES];
+} PatchCacheEntry;
+
+typedef struct PatchCacheHeader {
+    u32 magic;
+    u32 version;
+    u32 numEntries;
+    u32 nextEntry; //< Next one to be replaced once the cache is full
+} PatchCacheHeader;
+
+// Starts looking up the sites of a title, must be called on the unpatched code
+void patchCacheBegin(u64 progId, u16 progVer, u8 *code, u32 textSize);
+
+// Identifies a search for what (whatSize bytes, a pattern or a tag naming a custom search) in [start, start + size).
+// Returns 0 when the search can't be cached.
+u32 patchCacheSearchKey(const u8 *start, u32 size, const void *what, u32 whatSize);
+
+// Fetches the cached site of a search, which the caller must still check (and record another site for if it is wrong)
+bool patchCacheLookup(u32 key, u32 *offset);
+
+// Records the site a search found
+void patchCacheRecord(u32 key, u32 offset);
+
+// Makes the sites of later searches depend on patch data (IPS/BPS) just applied to the code
+void patchCacheCodeChanged(const void *data, u32 size);
+
+// Writes the entry back if any site had to be searched for
+void patchCacheEnd(bool success);
+
+u32 patchCacheHashText(const u8 *code, u32 textSize);
+
+// memsearch, answered from the cache when the pattern is still at the cached site
+u8 *patchCacheMemsearch(u8 *start, const void *pattern, u32 size, u32 patternSize);
@@ -5,8 +5,9 @@
 #include "strings.h"
 #include "romfsredir.h"
 #include "util.h"
-
-config_extra configExtra = { .suppressLeds = true, .cutSlotPower = false, .cutSleepWifi = false, .homeToRosalina = false, .toggleBottomLcd = false, .turnLedsOffStandby = false, .perGamePlugin = false };
+#include "title_index.h"
+#include "patch_cache.h"
+#include "title_settings.h"
 
 static u32 patchMemory(u8 *start, u32 size, const void *pattern, u32 patSize, s32 offset, const void *replace, u32 repSize, u32 count)
 {
@@ -14,7 +15,7 @@ static u32 patchMemory(u8 *start, u32 size, const void *pattern, u32 patSize, s3
 
     for(i = 0; i < count; i++)
     {
-        u8 *found = memsearch(start, pattern, size, patSize);
+        u8 *found = patchCacheMemsearch(start, pattern, size, patSize);
 
         if(found == NULL) break;
 
@@ -150,49 +151,110 @@ static u32 findFunctionStart(u8 *code, u32 pos)
     return 0xFFFFFFFF;
 }
 
-static inline bool findLayeredFsSymbols(u8 *code, u32 size, u32 *fsMountArchive, u32 *fsRegisterArchive, u32 *fsTryOpenFile, u32 *fsOpenFileDirectly)
+enum
+{
+    LAYEREDFS_FS_MOUNT_ARCHIVE = 0,
+    LAYEREDFS_FS_REGISTER_ARCHIVE,
+    LAYEREDFS_FS_TRY_OPEN_FILE,
+    LAYEREDFS_FS_OPEN_FILE_DIRECTLY,
+    LAYEREDFS_NUM_SYMBOLS,
+};
+
+// Which LayeredFS symbol the instructions at addr belong to, if any
+static inline s32 matchLayeredFsSignature(u8 *code, u32 size, u32 addr)
 {
-    u32 found = 0,
-        *temp = NULL;
+    u32 *addr32 = (u32 *)(code + addr);
 
-    for(u32 addr = 0; addr <= size - 4; addr += 4)
+    switch(*addr32)
     {
-        u32 *addr32 = (u32 *)(code + addr);
+        case 0xE5970010:
+            if(addr <= size - 12 && addr32[1] == 0xE1CD20D8 && (addr32[2] & 0xFFFFFF) == 0x008D0000) return LAYEREDFS_FS_MOUNT_ARCHIVE;
+            break;
+        case 0xE24DD028:
+            if(addr <= size - 16 && addr32[1] == 0xE1A04000 && addr32[2] == 0xE59F60A8 && addr32[3] == 0xE3A0C001) return LAYEREDFS_FS_MOUNT_ARCHIVE;
+            break;
+        case 0xE3500008:
+            if(addr <= size - 12 && (addr32[1] & 0xFFF00FF0) == 0xE1800400 && (addr32[2] & 0xFFF00FF0) == 0xE1800FC0) return LAYEREDFS_FS_REGISTER_ARCHIVE;
+            break;
+        case 0xE351003A:
+            if(addr <= size - 0x40 && addr32[1] == 0x1AFFFFFC && addr32[0xD] == 0xE590C000 && addr32[0xF] == 0xE12FFF3C) return LAYEREDFS_FS_TRY_OPEN_FILE;
+            break;
+        case 0x08030204:
+            return LAYEREDFS_FS_OPEN_FILE_DIRECTLY;
+    }
+
+    return -1;
+}
+
+// Finds the symbols that are still 0xFFFFFFFF, from the first instructions that match their signature
+static inline bool findLayeredFsSymbols(u8 *code, u32 size, u32 *symbols, u32 *signatures)
+{
+    u32 found = 0;
+
+    for(u32 i = 0; i < LAYEREDFS_NUM_SYMBOLS; i++)
+        found += symbols[i] != 0xFFFFFFFF;
 
-        switch(*addr32)
+    for(u32 addr = 0; found < LAYEREDFS_NUM_SYMBOLS && addr <= size - 4; addr += 4)
+    {
+        s32 symbol = matchLayeredFsSignature(code, size, addr);
+
+        if(symbol < 0 || symbols[symbol] != 0xFFFFFFFF) continue;
+
+        symbols[symbol] = findFunctionStart(code, addr);
+
+        if(symbols[symbol] != 0xFFFFFFFF)
         {
-            case 0xE5970010:
-                if(addr <= size - 12 && *fsMountArchive == 0xFFFFFFFF && addr32[1] == 0xE1CD20D8 && (addr32[2] & 0xFFFFFF) == 0x008D0000) temp = fsMountArchive;
-                break;
-            case 0xE24DD028:
-                if(addr <= size - 16 && *fsMountArchive == 0xFFFFFFFF && addr32[1] == 0xE1A04000 && addr32[2] == 0xE59F60A8 && addr32[3] == 0xE3A0C001) temp = fsMountArchive;
-                break;
-            case 0xE3500008:
-                if(addr <= size - 12 && *fsRegisterArchive == 0xFFFFFFFF && (addr32[1] & 0xFFF00FF0) == 0xE1800400 && (addr32[2] & 0xFFF00FF0) == 0xE1800FC0) temp = fsRegisterArchive;
-                break;
-            case 0xE351003A:
-                if(addr <= size - 0x40 && *fsTryOpenFile == 0xFFFFFFFF && addr32[1] == 0x1AFFFFFC && addr32[0xD] == 0xE590C000 && addr32[0xF] == 0xE12FFF3C) temp = fsTryOpenFile;
-                break;
-            case 0x08030204:
-                if(*fsOpenFileDirectly == 0xFFFFFFFF) temp = fsOpenFileDirectly;
-                break;
+            signatures[symbol] = addr;
+            found++;
         }
+    }
 
-        if(temp != NULL)
-        {
-            *temp = findFunctionStart(code, addr);
+    return found == LAYEREDFS_NUM_SYMBOLS;
+}
 
-            if(*temp != 0xFFFFFFFF)
-            {
-                found++;
-                if(found == 4) break;
-            }
+// The signature addresses are cached, a cached one is used if it still matches the same symbol
+static inline bool findLayeredFsSymbolsCached(u8 *code, u32 size, u32 *fsMountArchive, u32 *fsRegisterArchive, u32 *fsTryOpenFile, u32 *fsOpenFileDirectly)
+{
+    static const char *const names[LAYEREDFS_NUM_SYMBOLS] = { "fsMountArchive", "fsRegisterArchive", "fsTryOpenFile", "fsOpenFileDirectly" };
+    u32 symbols[LAYEREDFS_NUM_SYMBOLS],
+        signatures[LAYEREDFS_NUM_SYMBOLS],
+        keys[LAYEREDFS_NUM_SYMBOLS];
+    bool missing = false;
+
+    for(u32 i = 0; i < LAYEREDFS_NUM_SYMBOLS; i++)
+    {
+        u32 addr;
+
+        keys[i] = patchCacheSearchKey(code, size, names[i], strlen(names[i]));
+        symbols[i] = 0xFFFFFFFF;
+
+        if(patchCacheLookup(keys[i], &addr) && addr <= size - 4 && (addr & 3) == 0 && matchLayeredFsSignature(code, size, addr) == (s32)i)
+            symbols[i] = findFunctionStart(code, addr);
+
+        missing = missing || symbols[i] == 0xFFFFFFFF;
+    }
+
+    if(missing)
+    {
+        bool cached[LAYEREDFS_NUM_SYMBOLS];
 
-            temp = NULL;
+        for(u32 i = 0; i < LAYEREDFS_NUM_SYMBOLS; i++)
+            cached[i] = symbols[i] != 0xFFFFFFFF;
+
+        if(!findLayeredFsSymbols(code, size, symbols, signatures)) return false;
+
+        for(u32 i = 0; i < LAYEREDFS_NUM_SYMBOLS; i++)
+        {
+            if(!cached[i]) patchCacheRecord(keys[i], signatures[i]);
         }
     }
 
-    return found == 4;
+    *fsMountArchive = symbols[LAYEREDFS_FS_MOUNT_ARCHIVE];
+    *fsRegisterArchive = symbols[LAYEREDFS_FS_REGISTER_ARCHIVE];
+    *fsTryOpenFile = symbols[LAYEREDFS_FS_TRY_OPEN_FILE];
+    *fsOpenFileDirectly = symbols[LAYEREDFS_FS_OPEN_FILE_DIRECTLY];
+
+    return true;
 }
 
 static inline bool findLayeredFsPayloadOffset(u8 *code, u32 size, u32 roSize, u32 dataSize, u32 roAddress, u32 dataAddress, u32 *payloadOffset, u32 *pathOffset, u32 *pathAddress)
@@ -281,7 +343,7 @@ static inline bool applyCodeIpsPatch(u64 progId, u8 *code, u32 size)
     {
         char path[] = "/luma/titles/0000000000000000/code.ips";
         progIdToStr(path + 28, progId);
-        if(!openLumaFile(&file, path)) return true;
+        if(!(titleIndexGetOverrides(progId) & TITLE_OVERRIDE_CODE_IPS) || !openLumaFile(&file, path)) return true;
     }
 
     bool ret = false;
@@ -317,12 +379,18 @@ static inline bool applyCodeIpsPatch(u64 progId, u8 *code, u32 size)
             for(u32 i = 0; i < rleSize; i++)
                 code[offset + i] = buffer[0];
 
+            u32 record[] = { offset, rleSize, buffer[0] };
+            patchCacheCodeChanged(record, sizeof(record));
+
             continue;
         }
 
         if(offset + patchSize > size) break;
 
         if(R_FAILED(IFile_Read(&file, &total, code + offset, patchSize)) || total != patchSize) break;
+
+        patchCacheCodeChanged(&offset, sizeof(offset));
+        patchCacheCodeChanged(code + offset, patchSize);
     }
 
 exit:
@@ -333,91 +401,19 @@ exit:
 
 bool usePerGamePluginSetting(void)
 {
-    IFile file;
-    FS_ArchiveID archiveId;
-    s64 out;
-    bool isSdMode;
-    Result res = 0;
-
-    if (R_FAILED(svcGetSystemInfo(&out, 0x10000, 0x203)))
-        svcBreak(USERBREAK_ASSERT);
-        
-    isSdMode = (bool)out;
-    
-    archiveId = isSdMode ? ARCHIVE_SDMC : ARCHIVE_NAND_RW;
-    
-    res = IFile_Open(&file, archiveId, fsMakePath(PATH_EMPTY, ""),
-            fsMakePath(PATH_ASCII, "/luma/configExtra.bin"), FS_OPEN_READ);
-
-    if(R_SUCCEEDED(res))
-    {
-        u64 total;
-        res = IFile_Read(&file, &total, &configExtra, sizeof(configExtra));
-        if(R_SUCCEEDED(res))
-        {
-            IFile_Close(&file);
-        }
-    }
-
-    return configExtra.perGamePlugin;
+    return Luma_SharedConfig->per_game_plugin;
 }
 
 bool enablePluginForTitle(u64 progId)
 {
-    IFile file;
-    FS_ArchiveID archiveId;
-    s64 out;
-    bool isSdMode;
-    Result res = 0;
-
-    if (R_FAILED(svcGetSystemInfo(&out, 0x10000, 0x203)))
-        svcBreak(USERBREAK_ASSERT);
-        
-    isSdMode = (bool)out;
-    
-    archiveId = isSdMode ? ARCHIVE_SDMC : ARCHIVE_NAND_RW;
-    
-    char path[] = "/luma/plugins/PerGame/0000000000000000.bin";
-    progIdToStr(path + 26, progId);
-
-    res = IFile_Open(&file, archiveId, fsMakePath(PATH_EMPTY, ""), fsMakePath(PATH_ASCII, path), FS_OPEN_READ);
-
-    if(R_SUCCEEDED(res))
-    {
-        IFile_Close(&file);
-
-        return true;
-    }
-    return false;
+    const volatile LumaTitleSettings *settings = titleSettingsGet(progId);
+    return settings != NULL && (settings->flags & LUMA_TITLE_SETTING_PLUGIN) != 0;
 }
 
-bool useN3dsSettings(u64 progId)
+u8 titleN3dsMode(u64 progId)
 {
-    IFile file;
-    FS_ArchiveID archiveId;
-    s64 out;
-    bool isSdMode;
-    Result res = 0;
-
-    if (R_FAILED(svcGetSystemInfo(&out, 0x10000, 0x203)))
-        svcBreak(USERBREAK_ASSERT);
-        
-    isSdMode = (bool)out;
-    
-    archiveId = isSdMode ? ARCHIVE_SDMC : ARCHIVE_NAND_RW;
-    
-    char path[] = "/luma/n3ds/0000000000000000.bin";
-    progIdToStr(path + 26, progId);
-
-    res = IFile_Open(&file, archiveId, fsMakePath(PATH_EMPTY, ""), fsMakePath(PATH_ASCII, path), FS_OPEN_READ);
-
-    if(R_SUCCEEDED(res))
-    {
-        IFile_Close(&file);
-
-        return true;
-    }
-    return false;
+    const volatile LumaTitleSettings *settings = titleSettingsGet(progId);
+    return settings != NULL && (settings->flags & LUMA_TITLE_SETTING_N3DS) != 0 ? settings->n3ds_mode : 0;
 }
 
 Result openSysmoduleCxi(IFile *outFile, u64 progId)
@@ -489,6 +485,8 @@ bool loadTitleCodeSection(u64 progId, u8 *code, u32 size)
     /* Here we look for "/luma/titles/[u64 titleID in hex, uppercase]/code.bin"
        If it exists it should be a decrypted and decompressed binary code file */
 
+    if(!(titleIndexGetOverrides(progId) & TITLE_OVERRIDE_CODE_BIN)) return false;
+
     char path[] = "/luma/titles/0000000000000000/code.bin";
     progIdToStr(path + 28, progId);
 
@@ -522,6 +520,8 @@ bool loadTitleExheaderInfo(u64 progId, ExHeader_Info *exheaderInfo)
     /* Here we look for "/luma/titles/[u64 titleID in hex, uppercase]/exheader.bin"
        If it exists it should be a decrypted exheader / exheader info */
 
+    if(!(titleIndexGetOverrides(progId) & TITLE_OVERRIDE_EXHEADER)) return false;
+
     char path[] = "/luma/titles/0000000000000000/exheader.bin";
     progIdToStr(path + 28, progId);
 
@@ -559,9 +559,20 @@ static inline bool loadTitleLocaleConfig(u64 progId, u8 *mask, u8 *regionId, u8
     progIdToStr(path + 28, progId);
     *mask = *regionId = *languageId = *countryId = *stateId = 0;
 
+    const volatile LumaTitleSettings *settings = titleSettingsGet(progId);
+    if(settings != NULL && (settings->flags & LUMA_TITLE_SETTING_LOCALE) != 0)
+    {
+        *mask = settings->locale_mask;
+        *regionId = settings->region_id;
+        *languageId = settings->language_id;
+        *countryId = settings->country_id;
+        *stateId = settings->state_id;
+        return true;
+    }
+
     IFile file;
 
-    if(!openLumaFile(&file, path)) return false;
+    if(!(titleIndexGetOverrides(progId) & TITLE_OVERRIDE_LOCALE) || !openLumaFile(&file, path)) return false;
 
     bool ret = false;
     u64 fileSize;
@@ -644,6 +655,9 @@ static inline bool loadTitleLocaleConfig(u64 progId, u8 *mask, u8 *regionId, u8
 exit:
     IFile_Close(&file);
 
+    if(ret && *mask != 0)
+        titleSettingsImportLocale(progId, path, *mask, *regionId, *languageId, *countryId, *stateId);
+
     return ret;
 }
 
@@ -657,7 +671,8 @@ static inline bool patchLayeredFs(u64 progId, u8 *code, u32 size, u32 textSize,
     // Check for the existence of a layeredfs text file. If it doesn't exist or
     // cannot be opened, we will default to the romfs/ directory within the
     // game's luma directory.
-    bool hasFileRedirect = openLumaFile(&file, fileRedirect);
+    u32 overrides = titleIndexGetOverrides(progId);
+    bool hasFileRedirect = (overrides & TITLE_OVERRIDE_LAYEREDFS) != 0 && openLumaFile(&file, fileRedirect);
     if(hasFileRedirect)
     {
         if(R_FAILED(IFile_GetSize(&file, &pathSize)))
@@ -692,7 +707,9 @@ static inline bool patchLayeredFs(u64 progId, u8 *code, u32 size, u32 textSize,
         progIdToStr(path + 28, progId);
     }
     
-    u32 archiveId = checkLumaDir(path);
+    // The default romfs directory is known from the index, only a redirect needs to be checked
+    u32 defaultRomfsArchiveId = (overrides & TITLE_OVERRIDE_ROMFS) ? (isSdMode ? ARCHIVE_SDMC : ARCHIVE_NAND_RW) : 0;
+    u32 archiveId = hasFileRedirect ? checkLumaDir(path) : defaultRomfsArchiveId;
 
     if(!archiveId)
     {
@@ -703,8 +720,7 @@ static inline bool patchLayeredFs(u64 progId, u8 *code, u32 size, u32 textSize,
             pathSize = 36;
             memcpy(path, "/luma/titles/0000000000000000/romfs", pathSize);
             progIdToStr(path + 28, progId);
-            archiveId = checkLumaDir(path);
-            if (!(archiveId = checkLumaDir(path))) return true;
+            if (!(archiveId = defaultRomfsArchiveId)) return true;
         }
         else
         {
@@ -720,7 +736,7 @@ static inline bool patchLayeredFs(u64 progId, u8 *code, u32 size, u32 textSize,
         pathOffset = 0,
         pathAddress = 0xDEADCAFE;
 
-    if(!findLayeredFsSymbols(code, textSize, &fsMountArchive, &fsRegisterArchive, &fsTryOpenFile, &fsOpenFileDirectly) ||
+    if(!findLayeredFsSymbolsCached(code, textSize, &fsMountArchive, &fsRegisterArchive, &fsTryOpenFile, &fsOpenFileDirectly) ||
        !findLayeredFsPayloadOffset(code, textSize, roSize, dataSize, roAddress, dataAddress, &payloadOffset, &pathOffset, &pathAddress)) return false;
 
     static const char *updateRomFsMounts[] = { "ro2:",
@@ -755,7 +771,7 @@ static inline bool patchLayeredFs(u64 progId, u8 *code, u32 size, u32 textSize,
             u8 temp[7];
             temp[0] = 0;
             memcpy(temp + 1, updateRomFsMounts[updateRomFsIndex], patternSize);
-            if(memsearch(code, temp, size, patternSize + 1) != NULL) break;
+            if(patchCacheMemsearch(code, temp, size, patternSize + 1) != NULL) break;
         }
         updateRomFsMount = updateRomFsMounts[updateRomFsIndex];
     }
@@ -785,6 +801,11 @@ static inline bool patchLayeredFs(u64 progId, u8 *code, u32 size, u32 textSize,
     return true;
 }
 
+static inline bool isManualRegionCheck(const u32 *code32)
+{
+    return code32[1] == 0xE1A0000D && (*code32 & 0xFFFFFF00) == 0x0A000000 && (code32[-1] & 0xFFFFFF00) == 0xE1110000;
+}
+
 void patchCode(u64 progId, u16 progVer, u8 *code, u32 size, u32 textSize, u32 roSize, u32 dataSize, u32 roAddress, u32 dataAddress)
 {
     bool isHomeMenu = progId == 0x0004003000008F02LL || //USA Home Menu
@@ -798,6 +819,8 @@ void patchCode(u64 progId, u16 progVer, u8 *code, u32 size, u32 textSize, u32 ro
     bool isApplet = (progId >> 32) == 0x00040030;
     bool isSysmodule = (progId >> 32) == 0x00040130;
 
+    patchCacheBegin(progId, progVer, code, textSize);
+
     if(isHomeMenu)
     {
         bool applyRegionFreePatch = true;
@@ -833,25 +856,30 @@ void patchCode(u64 progId, u16 progVer, u8 *code, u32 size, u32 textSize, u32 ro
         }
 
         //Patch SMDH region check for manuals
-        u32 i;
-        for(i = 4; i < textSize; i += 4)
+        static const char manualRegionCheck[] = "manual region check";
+        u32 i,
+            key = patchCacheSearchKey(code, textSize, manualRegionCheck, sizeof(manualRegionCheck) - 1);
+
+        if(!patchCacheLookup(key, &i) || i < 4 || i >= textSize || (i & 3) != 0 || !isManualRegionCheck((u32 *)(code + i)))
         {
-            u32 *code32 = (u32 *)(code + i);
-            if(code32[1] == 0xE1A0000D && (*code32 & 0xFFFFFF00) == 0x0A000000 && (code32[-1] & 0xFFFFFF00) == 0xE1110000)
-                {
-                    *code32 = 0xE320F000;
-                    break;
-                }
+            for(i = 4; i < textSize; i += 4)
+            {
+                if(isManualRegionCheck((u32 *)(code + i))) break;
+            }
+
+            if(i != textSize) patchCacheRecord(key, i);
         }
 
         if(i == textSize) goto error;
 
+        *(u32 *)(code + i) = 0xE320F000;
+
         //Patch DS flashcart whitelist check
         static const u8 pattern[] = {
             0x10, 0xD1, 0xE5, 0x08, 0x00, 0x8D
         };
 
-        u8 *temp = memsearch(code, pattern, textSize, sizeof(pattern));
+        u8 *temp = patchCacheMemsearch(code, pattern, textSize, sizeof(pattern));
 
         if(temp == NULL) goto error;
 
@@ -931,7 +959,7 @@ void patchCode(u64 progId, u16 progVer, u8 *code, u32 size, u32 textSize, u32 ro
                     0x0C, 0x00, 0x94, 0x15
                 };
 
-                u32 *off = (u32 *)memsearch(code, pattern, textSize, sizeof(pattern));
+                u32 *off = (u32 *)patchCacheMemsearch(code, pattern, textSize, sizeof(pattern));
 
                 if(off == NULL) goto error;
 
@@ -950,7 +978,7 @@ void patchCode(u64 progId, u16 progVer, u8 *code, u32 size, u32 textSize, u32 ro
             };
 
             u8 *roStart = code + ((textSize + 4095) & 0xFFFFF000),
-               *start = memsearch(roStart, pattern, roSize, sizeof(pattern));
+               *start = patchCacheMemsearch(roStart, pattern, roSize, sizeof(pattern));
 
             if(start == NULL) goto error;
 
@@ -1059,7 +1087,7 @@ void patchCode(u64 progId, u16 progVer, u8 *code, u32 size, u32 textSize, u32 ro
             )) goto error;
 
         // Patch DLP client region check
-        u8 *found = memsearch(code, pattern2, textSize, sizeof(pattern2));
+        u8 *found = patchCacheMemsearch(code, pattern2, textSize, sizeof(pattern2));
 
         if (!patchMemory(found, textSize,
                pattern3,
@@ -1133,9 +1161,11 @@ void patchCode(u64 progId, u16 progVer, u8 *code, u32 size, u32 textSize, u32 ro
         }
     }
 
+    patchCacheEnd(true);
     nextGamePatchDisabled = false;
     return;
 
 error:
+    patchCacheEnd(false);
     svcBreak(USERBREAK_ASSERT);
 }
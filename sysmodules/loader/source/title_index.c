@@ -0,0 +1,113 @@
+#include <3ds.h>
+#include "title_index.h"
+#include "patcher.h"
+#include "strings.h"
+
+static u64 g_indexedTitleId;
+static u32 g_indexedOverrides;
+static bool g_indexValid = false;
+static u32 g_fsRequestCount = 0;
+
+static FS_DirectoryEntry g_dirEntries[4];
+
+static const struct
+{
+    const char *name;
+    u32 override;
+    bool isDirectory;
+} titleDirFiles[] = {
+    { "code.bin",       TITLE_OVERRIDE_CODE_BIN,    false },
+    { "exheader.bin",   TITLE_OVERRIDE_EXHEADER,    false },
+    { "code.bps",       TITLE_OVERRIDE_CODE_BPS,    false },
+    { "code.ips",       TITLE_OVERRIDE_CODE_IPS,    false },
+    { "locale.txt",     TITLE_OVERRIDE_LOCALE,      false },
+    { "layeredfs.txt",  TITLE_OVERRIDE_LAYEREDFS,   false },
+    { "romfs",          TITLE_OVERRIDE_ROMFS,       true  },
+};
+
+// FAT names are case-insensitive
+static bool entryNameEquals(const u16 *name, const char *expected)
+{
+    u32 i;
+    for(i = 0; expected[i] != 0; i++)
+    {
+        u16 c = name[i] >= 'A' && name[i] <= 'Z' ? name[i] + 0x20 : name[i];
+        if(c != (u8)expected[i]) return false;
+    }
+
+    return name[i] == 0;
+}
+
+static u32 indexTitleDirectory(FS_Archive archive, u64 progId)
+{
+    char path[] = "/luma/titles/0000000000000000";
+    progIdToStr(path + 28, progId);
+
+    Handle dirHandle;
+    u32 overrides = 0;
+
+    g_fsRequestCount++;
+    if(R_FAILED(FSUSER_OpenDirectory(&dirHandle, archive, fsMakePath(PATH_ASCII, path)))) return 0;
+
+    u32 numRead;
+    do
+    {
+        g_fsRequestCount++;
+        if(R_FAILED(FSDIR_Read(dirHandle, &numRead, sizeof(g_dirEntries) / sizeof(g_dirEntries[0]), g_dirEntries))) break;
+
+        for(u32 i = 0; i < numRead; i++)
+        {
+            bool isDirectory = (g_dirEntries[i].attributes & FS_ATTRIBUTE_DIRECTORY) != 0;
+
+            for(u32 j = 0; j < sizeof(titleDirFiles) / sizeof(titleDirFiles[0]); j++)
+            {
+                if(titleDirFiles[j].isDirectory == isDirectory && entryNameEquals(g_dirEntries[i].name, titleDirFiles[j].name))
+                    overrides |= titleDirFiles[j].override;
+            }
+        }
+    }
+    while(numRead == sizeof(g_dirEntries) / sizeof(g_dirEntries[0]));
+
+    FSDIR_Close(dirHandle);
+
+    return overrides;
+}
+
+u32 titleIndexGetOverrides(u64 progId)
+{
+    if(g_indexValid && g_indexedTitleId == progId) return g_indexedOverrides;
+
+    FS_Archive archive;
+    FS_ArchiveID archiveId = isSdMode ? ARCHIVE_SDMC : ARCHIVE_NAND_RW;
+    u32 overrides = 0;
+
+    g_fsRequestCount++;
+    if(R_SUCCEEDED(FSUSER_OpenArchive(&archive, archiveId, fsMakePath(PATH_EMPTY, ""))))
+    {
+        overrides = indexTitleDirectory(archive, progId);
+        FSUSER_CloseArchive(archive);
+    }
+
+    g_indexedTitleId = progId;
+    g_indexedOverrides = overrides;
+    g_indexValid = true;
+
+    return overrides;
+}
+
+u32 titleIndexGetCachedOverrides(u64 progId)
+{
+    return g_indexValid && g_indexedTitleId == progId ? g_indexedOverrides : 0;
+}
+
+void titleIndexInvalidate(void)
+{
+    g_indexValid = false;
+}
+
+u32 titleIndexTakeFsRequestCount(void)
+{
+    u32 count = g_fsRequestCount;
+    g_fsRequestCount = 0;
+    return count;
+}
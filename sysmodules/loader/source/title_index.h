@@ -0,0 +1,27 @@
+#pragma once
+
+#include <3ds/types.h>
+
+// Per-title override files and directories, looked up once per launch instead of being probed one at a time
+enum titleOverrides
+{
+    TITLE_OVERRIDE_CODE_BIN     = BIT(0), // /luma/titles/<tid>/code.bin
+    TITLE_OVERRIDE_EXHEADER     = BIT(1), // /luma/titles/<tid>/exheader.bin
+    TITLE_OVERRIDE_CODE_BPS     = BIT(2), // /luma/titles/<tid>/code.bps
+    TITLE_OVERRIDE_CODE_IPS     = BIT(3), // /luma/titles/<tid>/code.ips
+    TITLE_OVERRIDE_LOCALE       = BIT(4), // /luma/titles/<tid>/locale.txt
+    TITLE_OVERRIDE_LAYEREDFS    = BIT(5), // /luma/titles/<tid>/layeredfs.txt
+    TITLE_OVERRIDE_ROMFS        = BIT(6), // /luma/titles/<tid>/romfs/
+};
+
+// Returns the titleOverrides present for the title, building the index on first use
+u32 titleIndexGetOverrides(u64 progId);
+
+// Same, but without building the index: 0 if it hasn't been built for this title
+u32 titleIndexGetCachedOverrides(u64 progId);
+
+// Forgets the index, so that it is rebuilt (and picks up changes on the SD card) on the next launch
+void titleIndexInvalidate(void);
+
+// Number of FS requests issued to build the index since the last call
+u32 titleIndexTakeFsRequestCount(void);
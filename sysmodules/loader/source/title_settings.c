@@ -0,0 +1,213 @@
+#include <3ds.h>
+#include <string.h>
+#include "title_settings.h"
+#include "patcher.h"
+
+// Staging area, the shared page is only filled once the records are complete
+static LumaTitleSettings g_records[LUMA_TITLE_SETTINGS_MAX];
+static FS_DirectoryEntry g_dirEntries[4];
+
+// Returns -1 if the file doesn't exist, 0 if it isn't valid, 1 on success
+static int readSettingsFile(FS_Archive archive, const char *path, u32 *numRecords)
+{
+    Handle file;
+    LumaTitleSettingsHeader header;
+    u32 total;
+    int ret = 0;
+
+    if(R_FAILED(FSUSER_OpenFile(&file, archive, fsMakePath(PATH_ASCII, path), FS_OPEN_READ, 0))) return -1;
+
+    if(R_SUCCEEDED(FSFILE_Read(file, &total, 0, &header, sizeof(header))) && total == sizeof(header) &&
+       header.magic == LUMA_TITLE_SETTINGS_MAGIC && header.version == LUMA_TITLE_SETTINGS_VERSION &&
+       header.num_records <= LUMA_TITLE_SETTINGS_MAX)
+    {
+        u32 size = header.num_records * sizeof(LumaTitleSettings);
+
+        if(R_SUCCEEDED(FSFILE_Read(file, &total, sizeof(header), g_records, size)) && total == size)
+        {
+            ret = 1;
+            for(u32 i = 1; i < header.num_records; i++)
+            {
+                if(g_records[i - 1].title_id >= g_records[i].title_id) ret = 0;
+            }
+
+            *numRecords = header.num_records;
+        }
+    }
+
+    FSFILE_Close(file);
+
+    return ret;
+}
+
+static Result writeSettingsFile(FS_Archive archive, u32 numRecords)
+{
+    Handle file;
+    u32 total;
+    LumaTitleSettingsHeader header = { LUMA_TITLE_SETTINGS_MAGIC, LUMA_TITLE_SETTINGS_VERSION, (u16)numRecords };
+    FS_Path path = fsMakePath(PATH_ASCII, LUMA_TITLE_SETTINGS_PATH),
+            tmpPath = fsMakePath(PATH_ASCII, LUMA_TITLE_SETTINGS_TMP_PATH);
+
+    FSUSER_DeleteFile(archive, tmpPath);
+    Result res = FSUSER_OpenFile(&file, archive, tmpPath, FS_OPEN_CREATE | FS_OPEN_WRITE, 0);
+    if(R_FAILED(res)) return res;
+
+    res = FSFILE_Write(file, &total, 0, &header, sizeof(header), 0);
+    if(R_SUCCEEDED(res))
+        res = FSFILE_Write(file, &total, sizeof(header), g_records, numRecords * sizeof(LumaTitleSettings), FS_WRITE_FLUSH);
+
+    FSFILE_Close(file);
+
+    // FAT can't rename over an existing file
+    if(R_SUCCEEDED(res))
+    {
+        FSUSER_DeleteFile(archive, path);
+        res = FSUSER_RenameFile(archive, tmpPath, archive, path);
+    }
+
+    return res;
+}
+
+static LumaTitleSettings *findOrInsertRecord(u32 *numRecords, u64 titleId)
+{
+    u32 i;
+    for(i = *numRecords; i > 0 && g_records[i - 1].title_id > titleId; i--);
+
+    if(i > 0 && g_records[i - 1].title_id == titleId) return &g_records[i - 1];
+    if(*numRecords == LUMA_TITLE_SETTINGS_MAX) return NULL;
+
+    memmove(&g_records[i + 1], &g_records[i], (*numRecords - i) * sizeof(LumaTitleSettings));
+    memset(&g_records[i], 0, sizeof(LumaTitleSettings));
+    g_records[i].title_id = titleId;
+    (*numRecords)++;
+
+    return &g_records[i];
+}
+
+// "<16 hex digits>.bin", in any case
+static bool parseMarkerFileName(const u16 *name, u64 *titleId)
+{
+    u64 id = 0;
+
+    for(u32 i = 0; i < 16; i++)
+    {
+        u16 c = name[i] >= 'A' && name[i] <= 'Z' ? name[i] + 0x20 : name[i];
+
+        if(c >= '0' && c <= '9') id = (id << 4) | (c - '0');
+        else if(c >= 'a' && c <= 'f') id = (id << 4) | (c - 'a' + 10);
+        else return false;
+    }
+
+    for(u32 i = 0; i < 4; i++)
+    {
+        u16 c = name[16 + i] >= 'A' && name[16 + i] <= 'Z' ? name[16 + i] + 0x20 : name[16 + i];
+        if(c != (u8)".bin"[i]) return false;
+    }
+
+    *titleId = id;
+    return name[20] == 0;
+}
+
+static void migrateMarkerFiles(FS_Archive archive, const char *dirPath, u8 flag, u8 n3dsMode, u32 *numRecords)
+{
+    Handle dirHandle;
+    u32 numRead;
+
+    if(R_FAILED(FSUSER_OpenDirectory(&dirHandle, archive, fsMakePath(PATH_ASCII, dirPath)))) return;
+
+    do
+    {
+        if(R_FAILED(FSDIR_Read(dirHandle, &numRead, sizeof(g_dirEntries) / sizeof(g_dirEntries[0]), g_dirEntries))) break;
+
+        for(u32 i = 0; i < numRead; i++)
+        {
+            u64 titleId;
+            LumaTitleSettings *record;
+
+            if((g_dirEntries[i].attributes & FS_ATTRIBUTE_DIRECTORY) != 0 || !parseMarkerFileName(g_dirEntries[i].name, &titleId)) continue;
+            if((record = findOrInsertRecord(numRecords, titleId)) == NULL) continue;
+
+            record->flags |= flag;
+            record->n3ds_mode |= n3dsMode;
+        }
+    }
+    while(numRead == sizeof(g_dirEntries) / sizeof(g_dirEntries[0]));
+
+    FSDIR_Close(dirHandle);
+}
+
+static void titleSettingsLoad(void)
+{
+    FS_Archive archive;
+    FS_ArchiveID archiveId = isSdMode ? ARCHIVE_SDMC : ARCHIVE_NAND_RW;
+    u32 numRecords = 0;
+
+    // Retried on the next launch if the archive isn't available yet
+    if(R_FAILED(FSUSER_OpenArchive(&archive, archiveId, fsMakePath(PATH_EMPTY, "")))) return;
+
+    int res = readSettingsFile(archive, LUMA_TITLE_SETTINGS_PATH, &numRecords);
+    if(res < 0)
+    {
+        // Either a rewrite was interrupted between deleting the old file and renaming the new one, or this is the first boot using it
+        res = readSettingsFile(archive, LUMA_TITLE_SETTINGS_TMP_PATH, &numRecords);
+        if(res > 0)
+            FSUSER_RenameFile(archive, fsMakePath(PATH_ASCII, LUMA_TITLE_SETTINGS_TMP_PATH), archive, fsMakePath(PATH_ASCII, LUMA_TITLE_SETTINGS_PATH));
+        else
+        {
+            // The legacy marker files only ever enabled the L2 cache
+            numRecords = 0;
+            migrateMarkerFiles(archive, "/luma/n3ds", LUMA_TITLE_SETTING_N3DS, LUMA_N3DS_MODE_L2_CACHE, &numRecords);
+            migrateMarkerFiles(archive, "/luma/plugins/PerGame", LUMA_TITLE_SETTING_PLUGIN, 0, &numRecords);
+            writeSettingsFile(archive, numRecords);
+            res = 1;
+        }
+    }
+
+    FSUSER_CloseArchive(archive);
+
+    if(res <= 0) numRecords = 0;
+
+    memcpy((void *)Luma_SharedConfig->title_settings, g_records, numRecords * sizeof(LumaTitleSettings));
+    Luma_SharedConfig->num_title_settings = numRecords;
+    Luma_SharedConfig->title_settings_loaded = true;
+}
+
+const volatile LumaTitleSettings *titleSettingsGet(u64 progId)
+{
+    if(!Luma_SharedConfig->title_settings_loaded) titleSettingsLoad();
+
+    return lumaFindTitleSettings(progId);
+}
+
+void titleSettingsImportLocale(u64 progId, const char *path, u8 mask, u8 regionId, u8 languageId, u8 countryId, u8 stateId)
+{
+    FS_Archive archive;
+    FS_ArchiveID archiveId = isSdMode ? ARCHIVE_SDMC : ARCHIVE_NAND_RW;
+    u32 numRecords = Luma_SharedConfig->num_title_settings;
+    LumaTitleSettings *record;
+
+    // Rewriting the file before it has been read would lose the other records
+    if(!Luma_SharedConfig->title_settings_loaded || numRecords > LUMA_TITLE_SETTINGS_MAX) return;
+    if(R_FAILED(FSUSER_OpenArchive(&archive, archiveId, fsMakePath(PATH_EMPTY, "")))) return;
+
+    memcpy(g_records, (const void *)Luma_SharedConfig->title_settings, numRecords * sizeof(LumaTitleSettings));
+    if((record = findOrInsertRecord(&numRecords, progId)) != NULL)
+    {
+        record->flags |= LUMA_TITLE_SETTING_LOCALE;
+        record->locale_mask = mask;
+        record->region_id = regionId;
+        record->language_id = languageId;
+        record->country_id = countryId;
+        record->state_id = stateId;
+
+        // The file stays there until its locale has been saved
+        if(R_SUCCEEDED(writeSettingsFile(archive, numRecords)))
+        {
+            FSUSER_DeleteFile(archive, fsMakePath(PATH_ASCII, path));
+            memcpy((void *)Luma_SharedConfig->title_settings, g_records, numRecords * sizeof(LumaTitleSettings));
+            Luma_SharedConfig->num_title_settings = numRecords;
+        }
+    }
+
+    FSUSER_CloseArchive(archive);
+}
@@ -0,0 +1,18 @@
+#pragma once
+
+#include <3ds/types.h>
+#include "luma_shared_config.h"
+
+/* Per-title settings (New 3DS mode, per-game plugin, locale) live in a single sorted
+   record file, /luma/titlesettings.bin, which is loaded once per boot into the shared
+   config page: lookups are then a binary search, for both the loader and Rosalina.
+   Rosalina is the one updating it afterwards. When the file doesn't exist yet, it is
+   created from the legacy /luma/n3ds/<tid>.bin and /luma/plugins/PerGame/<tid>.bin
+   marker files. A /luma/titles/<tid>/locale.txt is moved into it the first time it
+   is read. */
+
+// Returns the settings record of the title, or NULL. Loads the file on first use
+const volatile LumaTitleSettings *titleSettingsGet(u64 progId);
+
+// Stores the locale read from the title's locale.txt (at path) in its record, then deletes the file
+void titleSettingsImportLocale(u64 progId, const char *path, u8 mask, u8 regionId, u8 languageId, u8 countryId, u8 stateId);
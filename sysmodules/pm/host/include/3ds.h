@@ -0,0 +1,127 @@
+#pragma once
+
+// Just what the termination code (termination.c, process_data.c, shutdown_trace.c) and resource_sampler.c use,
+// see stubs.c
+
+#include <3ds/types.h>
+
+#define R_SUCCEEDED(res)            ((res) >= 0)
+#define R_FAILED(res)               ((res) < 0)
+#define R_SUMMARY(res)              (((res) >> 21) & 0x3F)
+#define R_DESCRIPTION(res)          ((res) & 0x3FF)
+#define MAKERESULT(l, s, m, d)      ((((l) & 0x1F) << 27) | (((s) & 0x3F) << 21) | (((m) & 0xFF) << 10) | ((d) & 0x3FF))
+
+#define RL_TEMPORARY                5
+#define RS_NOTFOUND                 4
+#define RM_PM                       24
+#define RD_TIMEOUT                  1022
+
+#define SYSCLOCK_ARM11              268111856LL
+
+typedef enum {
+    RESLIMIT_PRIORITY = 0,
+    RESLIMIT_COMMIT,
+    RESLIMIT_THREAD,
+    RESLIMIT_EVENT,
+    RESLIMIT_MUTEX,
+    RESLIMIT_SEMAPHORE,
+    RESLIMIT_TIMER,
+    RESLIMIT_SHAREDMEMORY,
+    RESLIMIT_ADDRESSARBITER,
+    RESLIMIT_CPUTIME,
+    RESLIMIT_BIT = BIT(31),
+} ResourceLimitType;
+
+typedef enum {
+    MEDIATYPE_NAND      = 0,
+    MEDIATYPE_SD        = 1,
+    MEDIATYPE_GAME_CARD = 2,
+} FS_MediaType;
+
+typedef struct {
+    u64 programId;
+    FS_MediaType mediaType : 8;
+    u8 padding[7];
+} FS_ProgramInfo;
+
+typedef u64 FS_Archive;
+typedef struct {
+    u32 type;
+    u32 size;
+    const void *data;
+} FS_Path;
+
+#define ARCHIVE_SDMC                9
+#define PATH_EMPTY                  1
+#define PATH_ASCII                  3
+
+#define FS_OPEN_READ                BIT(0)
+#define FS_OPEN_WRITE               BIT(1)
+#define FS_OPEN_CREATE              BIT(2)
+#define FS_WRITE_FLUSH              BIT(0)
+
+enum {
+    RESLIMIT_CATEGORY_APPLICATION   = 0,
+    RESLIMIT_CATEGORY_SYS_APPLET    = 1,
+    RESLIMIT_CATEGORY_LIB_APPLET    = 2,
+    RESLIMIT_CATEGORY_OTHER         = 3,
+};
+
+enum {
+    PMLAUNCHFLAG_QUEUE_DEBUG_APPLICATION    = BIT(1),
+    PMLAUNCHFLAG_USE_UPDATE_TITLE           = BIT(16),
+};
+
+// Only used as an opaque type, see getAndListDependencies in stubs.c
+typedef struct {
+    u8 data[0x400];
+} ExHeader_Info;
+
+typedef struct {
+    u8 data[8];
+} ExHeader_Arm11CoreInfo;
+
+typedef struct {
+    u8 data[8];
+} ExHeader_SystemInfoFlags;
+
+// Process handles are the process IDs plus PROCESS_HANDLE_BASE, see termsim.c
+#define PROCESS_HANDLE_BASE         0x100
+
+typedef struct {
+    u32 lockCount;
+} RecursiveLock;
+
+typedef struct {
+    u32 state;
+} LightEvent;
+
+void RecursiveLock_Init(RecursiveLock *lock);
+void RecursiveLock_Lock(RecursiveLock *lock);
+void RecursiveLock_Unlock(RecursiveLock *lock);
+
+Result svcGetSystemInfo(s64 *out, u32 type, s32 param);
+u64 svcGetSystemTick(void);
+Result svcClearEvent(Handle handle);
+Result svcSignalEvent(Handle handle);
+Result svcWaitSynchronization(Handle handle, s64 nanoseconds);
+Result svcTerminateProcess(Handle process);
+Result svcCloseHandle(Handle handle);
+Result svcGetProcessInfo(s64 *out, Handle process, u32 type);
+Result svcGetHandleInfo(s64 *out, Handle handle, u32 param);
+Result svcGetResourceLimitCurrentValues(s64 *values, Handle resourceLimit, ResourceLimitType *names, s32 nameCount);
+Result svcGetResourceLimitLimitValues(s64 *values, Handle resourceLimit, ResourceLimitType *names, s32 nameCount);
+void svcSleepThread(s64 ns);
+
+Result srvPublishToSubscriber(u32 notificationId, u32 flags);
+Result SRVPM_PublishToProcess(u32 notificationId, Handle process);
+
+Result fsInit(void);
+FS_Path fsMakePath(u32 type, const void *path);
+Result FSUSER_OpenArchive(FS_Archive *archive, u32 id, FS_Path path);
+Result FSUSER_CloseArchive(FS_Archive archive);
+Result FSUSER_CreateDirectory(FS_Archive archive, FS_Path path, u32 attributes);
+Result FSUSER_OpenFile(Handle *out, FS_Archive archive, FS_Path path, u32 openFlags, u32 attributes);
+Result FSFILE_Read(Handle handle, u32 *bytesRead, u64 offset, void *buffer, u32 size);
+Result FSFILE_Write(Handle handle, u32 *bytesWritten, u64 offset, const void *buffer, u32 size, u32 flags);
+Result FSFILE_Close(Handle handle);
@@ -0,0 +1,345 @@
+/*
+Runs the resource sampler of pm (resource_sampler.c) against a scripted process list and reslimit values,
+in virtual time, with an in-memory SD card. One command per line (from a file or stdin, '#' starts a comment):
+
+    process PID TITLEID [app]           exit PID
+    usage PID MEMORY THREADS            (what svcGetProcessInfo returns for the process from now on)
+    reslimit CATEGORY COMMIT THREADS [CPUTIME]
+    limit COMMIT                        (RESLIMIT_COMMIT limit of the application category)
+    advance MS                          (runs ResourceSampler_Update whenever its timeout expires)
+    terminating 0|1                     (g_manager.waitingForTermination)
+    samples [COUNT]                     query PID                   file TITLEID
+    expect-samples COUNT                expect-peak PID MEMORY THREADS
+    expect-file TITLEID RUNS PEAK_MEMORY PEAK_THREADS
+
+"exit" does what the process monitor does. Failed expectations make the program exit with status 1.
+*/
+
+#include <3ds.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "../source/manager.h"
+#include "../source/resource_sampler.h"
+
+typedef struct SimProcess {
+    u32 pid;
+    s64 memory;
+    s64 threads;
+    u64 creationTick;
+} SimProcess;
+
+typedef struct SimFile {
+    char path[64];
+    u8 data[0x100];
+    u32 size;
+} SimFile;
+
+extern u64 g_simTick;
+
+static u8 processDataBuffer[0x40 * sizeof(ProcessData)];
+static SimProcess simProcesses[0x40];
+static u32 numSimProcesses;
+static s64 reslimitValues[4][3]; // commit, threads, cputime
+static s64 appMemoryLimit;
+static SimFile files[16];
+static u32 numFiles;
+static u64 nextUpdateTick;
+static u32 lineNumber;
+static bool expectationFailed;
+
+static SimProcess *findSimProcess(u32 pid)
+{
+    for (u32 i = 0; i < numSimProcesses; i++) {
+        if (simProcesses[i].pid == pid) {
+            return &simProcesses[i];
+        }
+    }
+
+    fprintf(stderr, "line %lu: unknown pid %lu\n", (unsigned long)lineNumber, (unsigned long)pid);
+    exit(1);
+}
+
+Result svcGetProcessInfo(s64 *out, Handle process, u32 type)
+{
+    SimProcess *sim = findSimProcess(process - PROCESS_HANDLE_BASE);
+    *out = type == 0 ? sim->memory : type == 7 ? sim->threads : 0;
+    return 0;
+}
+
+Result svcGetHandleInfo(s64 *out, Handle handle, u32 param)
+{
+    (void)param;
+    *out = findSimProcess(handle - PROCESS_HANDLE_BASE)->creationTick;
+    return 0;
+}
+
+Result svcGetResourceLimitCurrentValues(s64 *values, Handle resourceLimit, ResourceLimitType *names, s32 nameCount)
+{
+    for (s32 i = 0; i < nameCount; i++) {
+        values[i] = names[i] == RESLIMIT_COMMIT ? reslimitValues[resourceLimit][0] :
+                    names[i] == RESLIMIT_THREAD ? reslimitValues[resourceLimit][1] :
+                    names[i] == RESLIMIT_CPUTIME ? reslimitValues[resourceLimit][2] : 0;
+    }
+
+    return 0;
+}
+
+Result svcGetResourceLimitLimitValues(s64 *values, Handle resourceLimit, ResourceLimitType *names, s32 nameCount)
+{
+    (void)resourceLimit;
+    for (s32 i = 0; i < nameCount; i++) {
+        values[i] = names[i] == RESLIMIT_COMMIT ? appMemoryLimit : 0;
+    }
+
+    return 0;
+}
+
+// Unused, needed by process_data.c
+Result SRVPM_PublishToProcess(u32 notificationId, Handle process)
+{
+    (void)notificationId;
+    (void)process;
+    return 0;
+}
+
+Result FSUSER_CloseArchive(FS_Archive archive)
+{
+    (void)archive;
+    return 0;
+}
+
+Result FSUSER_CreateDirectory(FS_Archive archive, FS_Path path, u32 attributes)
+{
+    (void)archive;
+    (void)path;
+    (void)attributes;
+    return 0;
+}
+
+Result FSUSER_OpenFile(Handle *out, FS_Archive archive, FS_Path path, u32 openFlags, u32 attributes)
+{
+    (void)archive;
+    (void)attributes;
+
+    for (u32 i = 0; i < numFiles; i++) {
+        if (strcmp(files[i].path, path.data) == 0) {
+            *out = i;
+            return 0;
+        }
+    }
+
+    if (!(openFlags & FS_OPEN_CREATE) || numFiles == sizeof(files) / sizeof(files[0])) {
+        return 0xC8804478;
+    }
+
+    snprintf(files[numFiles].path, sizeof(files[numFiles].path), "%s", (const char *)path.data);
+    *out = numFiles++;
+    return 0;
+}
+
+Result FSFILE_Read(Handle handle, u32 *bytesRead, u64 offset, void *buffer, u32 size)
+{
+    SimFile *file = &files[handle];
+    *bytesRead = offset >= file->size ? 0 : (file->size - offset < size ? file->size - offset : size);
+    memcpy(buffer, file->data + offset, *bytesRead);
+    return 0;
+}
+
+Result FSFILE_Write(Handle handle, u32 *bytesWritten, u64 offset, const void *buffer, u32 size, u32 flags)
+{
+    (void)flags;
+    SimFile *file = &files[handle];
+    memcpy(file->data + offset, buffer, size);
+    file->size = offset + size > file->size ? offset + size : file->size;
+    *bytesWritten = size;
+    return 0;
+}
+
+Result FSFILE_Close(Handle handle)
+{
+    (void)handle;
+    return 0;
+}
+
+static u64 parseNumber(const char *token)
+{
+    char *end;
+    u64 value = strtoull(token, &end, 0);
+    if (*end != 0) {
+        fprintf(stderr, "line %lu: invalid number \"%s\"\n", (unsigned long)lineNumber, token);
+        exit(1);
+    }
+
+    return value;
+}
+
+static ProcessData *findProcess(u32 pid)
+{
+    ProcessData *process = ProcessList_FindProcessById(&g_manager.processList, pid);
+    if (process == NULL) {
+        fprintf(stderr, "line %lu: unknown pid %lu\n", (unsigned long)lineNumber, (unsigned long)pid);
+        exit(1);
+    }
+
+    return process;
+}
+
+static const TitleResourceStats *findTitleStats(u64 titleId)
+{
+    char path[64];
+    snprintf(path, sizeof(path), "/luma/titles/%016llX/resources.bin", (unsigned long long)titleId);
+
+    for (u32 i = 0; i < numFiles; i++) {
+        if (strcmp(files[i].path, path) == 0 && files[i].size == sizeof(TitleResourceStats)) {
+            return (const TitleResourceStats *)files[i].data;
+        }
+    }
+
+    return NULL;
+}
+
+static void expect(bool condition, const char *what)
+{
+    if (!condition) {
+        printf("line %lu: FAILED: %s\n", (unsigned long)lineNumber, what);
+        expectationFailed = true;
+    }
+}
+
+static void runCommand(char **tokens, u32 nbTokens)
+{
+    const char *cmd = tokens[0];
+    ProcessResourceUsage usage;
+    static ResourceSample samples[RESOURCE_SAMPLER_RING_SIZE];
+    u32 numSamples;
+
+    printf("> ");
+    for (u32 i = 0; i < nbTokens; i++) {
+        printf("%s%s", tokens[i], i + 1 < nbTokens ? " " : "\n");
+    }
+
+    if (strcmp(cmd, "process") == 0 && nbTokens >= 3) {
+        SimProcess *sim = &simProcesses[numSimProcesses++];
+        ProcessData *process = ProcessList_New(&g_manager.processList);
+        sim->pid = (u32)parseNumber(tokens[1]);
+        sim->creationTick = g_simTick;
+        process->pid = sim->pid;
+        process->handle = PROCESS_HANDLE_BASE + sim->pid;
+        process->titleId = parseNumber(tokens[2]);
+        if (nbTokens > 3 && strcmp(tokens[3], "app") == 0) {
+            process->flags |= PROCESSFLAG_NORMAL_APPLICATION;
+            g_manager.runningApplicationData = process;
+        }
+    } else if (strcmp(cmd, "exit") == 0 && nbTokens == 2) {
+        ProcessData *process = findProcess((u32)parseNumber(tokens[1]));
+        ResourceSampler_OnProcessExit(process);
+        if (g_manager.runningApplicationData == process) {
+            g_manager.runningApplicationData = NULL;
+        }
+        ProcessList_Delete(&g_manager.processList, process);
+    } else if (strcmp(cmd, "usage") == 0 && nbTokens == 4) {
+        SimProcess *sim = findSimProcess((u32)parseNumber(tokens[1]));
+        sim->memory = parseNumber(tokens[2]);
+        sim->threads = parseNumber(tokens[3]);
+    } else if (strcmp(cmd, "reslimit") == 0 && nbTokens >= 4) {
+        u32 category = (u32)parseNumber(tokens[1]) & 3;
+        reslimitValues[category][0] = parseNumber(tokens[2]);
+        reslimitValues[category][1] = parseNumber(tokens[3]);
+        reslimitValues[category][2] = nbTokens > 4 ? (s64)parseNumber(tokens[4]) : 0;
+    } else if (strcmp(cmd, "limit") == 0 && nbTokens == 2) {
+        appMemoryLimit = parseNumber(tokens[1]);
+    } else if (strcmp(cmd, "terminating") == 0 && nbTokens == 2) {
+        g_manager.waitingForTermination = parseNumber(tokens[1]) != 0;
+    } else if (strcmp(cmd, "advance") == 0 && nbTokens == 2) {
+        u64 endTick = g_simTick + parseNumber(tokens[1]) * SYSCLOCK_ARM11 / 1000;
+        while (nextUpdateTick <= endTick) {
+            g_simTick = nextUpdateTick;
+            nextUpdateTick = g_simTick + nsToTicks(ResourceSampler_Update());
+        }
+        g_simTick = endTick;
+    } else if (strcmp(cmd, "samples") == 0) {
+        GetResourceSamples(&numSamples, samples, nbTokens > 1 ? parseNumber(tokens[1]) * sizeof(ResourceSample) : sizeof(samples));
+        for (u32 i = 0; i < numSamples; i++) {
+            printf("  %8lu ms: app %lu bytes, %u threads, cputime %u; commit %lu %lu %lu %lu; threads %u %u %u %u; %u processes\n",
+                (unsigned long)samples[i].timeMs, (unsigned long)samples[i].appMemory, samples[i].appThreads, samples[i].appCpuTime,
+                (unsigned long)samples[i].commit[0], (unsigned long)samples[i].commit[1], (unsigned long)samples[i].commit[2],
+                (unsigned long)samples[i].commit[3], samples[i].threads[0], samples[i].threads[1], samples[i].threads[2],
+                samples[i].threads[3], samples[i].numProcesses);
+        }
+    } else if (strcmp(cmd, "query") == 0 && nbTokens == 2) {
+        Result res = GetProcessResourceUsage(&usage, (u32)parseNumber(tokens[1]));
+        // Not found is MAKERESULT(RL_TEMPORARY, ...), which isn't negative
+        if (res != 0) {
+            printf("  0x%08lX\n", (unsigned long)(u32)res);
+        } else {
+            printf("  memory %lu (peak %lu), threads %u (peak %u)\n", (unsigned long)usage.memory, (unsigned long)usage.peakMemory,
+                usage.threads, usage.peakThreads);
+        }
+    } else if (strcmp(cmd, "file") == 0 && nbTokens == 2) {
+        const TitleResourceStats *stats = findTitleStats(parseNumber(tokens[1]));
+        if (stats == NULL) {
+            printf("  no file\n");
+        } else {
+            printf("  %lu runs, peak memory %lu (last %lu, limit %lu), peak threads %u (last %u), run time %lu s (last %lu s)\n",
+                (unsigned long)stats->numRuns, (unsigned long)stats->peakMemory, (unsigned long)stats->lastPeakMemory,
+                (unsigned long)stats->memoryLimit, stats->peakThreads, stats->lastPeakThreads, (unsigned long)stats->totalRunTimeSec,
+                (unsigned long)stats->lastRunTimeSec);
+        }
+    } else if (strcmp(cmd, "expect-samples") == 0 && nbTokens == 2) {
+        GetResourceSamples(&numSamples, samples, sizeof(samples));
+        expect(numSamples == parseNumber(tokens[1]), "number of samples");
+    } else if (strcmp(cmd, "expect-peak") == 0 && nbTokens == 4) {
+        Result res = GetProcessResourceUsage(&usage, (u32)parseNumber(tokens[1]));
+        expect(res == 0 && usage.peakMemory == parseNumber(tokens[2]) && usage.peakThreads == parseNumber(tokens[3]), "peak usage");
+    } else if (strcmp(cmd, "expect-file") == 0 && nbTokens == 5) {
+        const TitleResourceStats *stats = findTitleStats(parseNumber(tokens[1]));
+        expect(stats != NULL && stats->magic == TITLE_RESOURCE_STATS_MAGIC && stats->numRuns == parseNumber(tokens[2]) &&
+            stats->peakMemory == parseNumber(tokens[3]) && stats->peakThreads == parseNumber(tokens[4]), "title stats file");
+    } else {
+        fprintf(stderr, "line %lu: invalid command \"%s\"\n", (unsigned long)lineNumber, cmd);
+        exit(1);
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    FILE *f = argc > 1 ? fopen(argv[1], "r") : stdin;
+    char line[512];
+
+    if (f == NULL) {
+        perror(argv[1]);
+        return 1;
+    }
+
+    ProcessList_Init(&g_manager.processList, processDataBuffer, 0x40);
+    for (u32 i = 0; i < 4; i++) {
+        g_manager.reslimits[i] = i;
+    }
+    ResourceSampler_Init();
+
+    while (fgets(line, sizeof(line), f) != NULL) {
+        char *tokens[16];
+        u32 nbTokens = 0;
+
+        char *comment = strchr(line, '#');
+        if (comment != NULL) {
+            *comment = 0;
+        }
+
+        lineNumber++;
+        for (char *token = strtok(line, " \t\r\n"); token != NULL && nbTokens < 16; token = strtok(NULL, " \t\r\n")) {
+            tokens[nbTokens++] = token;
+        }
+
+        if (nbTokens != 0) {
+            runCommand(tokens, nbTokens);
+        }
+    }
+
+    if (f != stdin) {
+        fclose(f);
+    }
+
+    return expectationFailed ? 1 : 0;
+}
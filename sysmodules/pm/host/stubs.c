@@ -0,0 +1,126 @@
+#include <3ds.h>
+#include <stdio.h>
+#include <string.h>
+#include "../source/manager.h"
+#include "../source/exheader_info_heap.h"
+#include "../source/task_runner.h"
+#include "../source/launch.h"
+#include "../source/reslimit.h"
+
+// Everything but the process list and the termination event (see termsim.c): virtual clock, locks, etc.
+
+Manager g_manager;
+TaskRunner g_taskRunner;
+u64 g_simTick;
+s64 g_simNumKips;
+
+static ExHeader_Info exheaderInfos[6];
+static bool exheaderInfosUsed[6];
+
+void RecursiveLock_Init(RecursiveLock *lock)
+{
+    lock->lockCount = 0;
+}
+
+void RecursiveLock_Lock(RecursiveLock *lock)
+{
+    lock->lockCount++;
+}
+
+void RecursiveLock_Unlock(RecursiveLock *lock)
+{
+    if (lock->lockCount-- == 0) {
+        fprintf(stderr, "unbalanced RecursiveLock_Unlock\n");
+        __builtin_trap();
+    }
+}
+
+Result svcGetSystemInfo(s64 *out, u32 type, s32 param)
+{
+    if (type == 26 && param == 0) {
+        *out = g_simNumKips;
+    } else {
+        *out = 0;
+    }
+
+    return 0;
+}
+
+u64 svcGetSystemTick(void)
+{
+    return g_simTick;
+}
+
+void svcSleepThread(s64 ns)
+{
+    g_simTick += nsToTicks(ns);
+}
+
+Result svcCloseHandle(Handle handle)
+{
+    (void)handle;
+    return 0;
+}
+
+Result srvPublishToSubscriber(u32 notificationId, u32 flags)
+{
+    (void)flags;
+    printf("%10.3f ms: notification 0x%lx published to subscribers\n", ticksToNs(g_simTick) / 1e6, (unsigned long)notificationId);
+    return 0;
+}
+
+Result fsInit(void)
+{
+    return 0;
+}
+
+FS_Path fsMakePath(u32 type, const void *path)
+{
+    return (FS_Path){ type, strlen(path) + 1, path };
+}
+
+Result FSUSER_OpenArchive(FS_Archive *archive, u32 id, FS_Path path)
+{
+    (void)path;
+    *archive = id;
+    return 0;
+}
+
+ExHeader_Info *ExHeaderInfoHeap_New(void)
+{
+    for (u32 i = 0; i < 6; i++) {
+        if (!exheaderInfosUsed[i]) {
+            exheaderInfosUsed[i] = true;
+            return &exheaderInfos[i];
+        }
+    }
+
+    return NULL;
+}
+
+void ExHeaderInfoHeap_Delete(ExHeader_Info *data)
+{
+    exheaderInfosUsed[data - exheaderInfos] = false;
+}
+
+void TaskRunner_RunTask(void (*task)(void *argdata), void *argdata, size_t argsize)
+{
+    // Tasks run synchronously on the host
+    (void)argsize;
+    task(argdata);
+}
+
+Result LaunchTitle(u32 *outPid, const FS_ProgramInfo *programInfo, u32 launchFlags, bool allowAsync)
+{
+    (void)outPid;
+    (void)launchFlags;
+    (void)allowAsync;
+    printf("%10.3f ms: LaunchTitle %016llx\n", ticksToNs(g_simTick) / 1e6, (unsigned long long)programInfo->programId);
+    return 0;
+}
+
+Result setAppCpuTimeLimit(s64 limit)
+{
+    (void)limit;
+    return 0;
+}
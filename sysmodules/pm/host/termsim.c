@@ -0,0 +1,444 @@
+/*
+Runs the termination code of pm (termination.c, process_data.c, shutdown_trace.c) against a scripted
+process list, in virtual time. One command per line (from a file or stdin, '#' starts a comment):
+
+    kip PID [OPTIONS]                   process PID TITLEID [OPTIONS]
+    terminate-all CALLER TIMEOUT_MS     (PrepareForReboot, CALLER -1 for a firmlaunch)
+    terminate-app TIMEOUT_MS            terminate-title TITLEID TIMEOUT_MS   (TIMEOUT_MS -1: no timeout)
+    trace                               reset
+    expect-wave PID WAVE                expect-forced PID 0|1
+
+Options: exit=MS (time taken to exit after notification 0x100) or exit=never, ack=US (time sm takes to
+queue the notification), fail (the notification fails), app, autoloaded, depsloaded, refcount=N and
+deps=TITLEID,TITLEID,... (listed in the exheader of the process).
+
+The process monitor is replaced by svcWaitSynchronization, which moves the clock to the next exit and
+does what processMonitor does for it. The clock starts well after 0, as it does on the console, so that
+deadlines computed from bogus timeouts land in the past. Failed expectations make the program exit with status 1.
+*/
+
+#include <3ds.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "../source/manager.h"
+#include "../source/termination.h"
+#include "../source/shutdown_trace.h"
+#include "../source/info.h"
+
+#define EVENT_HANDLE    0x80
+#define SIM_START_TICK  (5 * SYSCLOCK_ARM11)    // 5 seconds after boot
+
+typedef struct SimProcess {
+    u32 pid;
+    s64 exitDelay;      // in ticks, -1: never exits by itself
+    u64 ackDelay;       // in ticks
+    bool failNotification;
+    u64 dependencies[48];
+    u32 numDeps;
+    bool exiting;
+    bool exited;
+    u64 exitTick;
+} SimProcess;
+
+extern u64 g_simTick;
+extern s64 g_simNumKips;
+
+static u8 processDataBuffer[0x40 * sizeof(ProcessData)];
+static SimProcess simProcesses[0x40];
+static u32 numSimProcesses;
+static bool eventSignaled;
+static u32 lineNumber;
+static bool expectationFailed;
+
+static double nowMs(void)
+{
+    return ticksToNs(g_simTick) / 1e6;
+}
+
+static SimProcess *findSimProcess(u32 pid)
+{
+    for (u32 i = 0; i < numSimProcesses; i++) {
+        if (simProcesses[i].pid == pid) {
+            return &simProcesses[i];
+        }
+    }
+
+    return NULL;
+}
+
+static SimProcess *findSimProcessByHandle(Handle handle)
+{
+    SimProcess *sim = findSimProcess(handle - PROCESS_HANDLE_BASE);
+    if (sim == NULL) {
+        fprintf(stderr, "line %lu: invalid process handle 0x%lx\n", (unsigned long)lineNumber, (unsigned long)handle);
+        exit(1);
+    }
+
+    return sim;
+}
+
+Result svcClearEvent(Handle handle)
+{
+    (void)handle;
+    eventSignaled = false;
+    return 0;
+}
+
+Result svcSignalEvent(Handle handle)
+{
+    (void)handle;
+    eventSignaled = true;
+    return 0;
+}
+
+Result SRVPM_PublishToProcess(u32 notificationId, Handle process)
+{
+    SimProcess *sim = findSimProcessByHandle(process);
+
+    g_simTick += sim->ackDelay;
+    printf("%10.3f ms: notification 0x%lx sent to pid %lu%s\n", nowMs(), (unsigned long)notificationId, (unsigned long)sim->pid,
+        sim->failNotification ? " (failed)" : "");
+
+    if (sim->failNotification) {
+        return 0xC920181A;
+    } else if (notificationId == 0x100 && sim->exitDelay >= 0 && !sim->exiting) {
+        sim->exiting = true;
+        sim->exitTick = g_simTick + sim->exitDelay;
+    }
+
+    return 0;
+}
+
+Result svcTerminateProcess(Handle process)
+{
+    SimProcess *sim = findSimProcessByHandle(process);
+
+    printf("%10.3f ms: pid %lu terminated\n", nowMs(), (unsigned long)sim->pid);
+    if (!sim->exited && (!sim->exiting || sim->exitTick > g_simTick)) {
+        sim->exiting = true;
+        sim->exitTick = g_simTick;
+    }
+
+    return 0;
+}
+
+Result getAndListDependencies(u64 *dependencies, u32 *numDeps, ProcessData *process, ExHeader_Info *exheaderInfo)
+{
+    (void)exheaderInfo;
+    SimProcess *sim = findSimProcess(process->pid);
+    if (sim == NULL) {
+        return 0xD8E05802;
+    }
+
+    memcpy(dependencies, sim->dependencies, sizeof(u64) * sim->numDeps);
+    *numDeps = sim->numDeps;
+    return 0;
+}
+
+// What processMonitor does when a process handle is signaled
+static void processExited(SimProcess *sim)
+{
+    ProcessData *process;
+    ProcessData processBackup;
+
+    sim->exited = true;
+    printf("%10.3f ms: pid %lu exited\n", nowMs(), (unsigned long)sim->pid);
+
+    ProcessList_Lock(&g_manager.processList);
+    process = ProcessList_FindProcessById(&g_manager.processList, sim->pid);
+    if (process != NULL) {
+        process->terminationStatus = TERMSTATUS_TERMINATED;
+        ShutdownTrace_RecordExit(process);
+        if (process->flags & PROCESSFLAG_NOTIFY_TERMINATION) {
+            process->flags |= PROCESSFLAG_NOTIFY_TERMINATION_TERMINATED;
+        }
+
+        processBackup = *process;
+        if (!(process->flags & PROCESSFLAG_NOTIFY_TERMINATION_TERMINATED)) {
+            ProcessList_Delete(&g_manager.processList, process);
+        }
+    }
+    ProcessList_Unlock(&g_manager.processList);
+
+    if (process == NULL) {
+        return;
+    }
+
+    if (processBackup.flags & PROCESSFLAG_DEPENDENCIES_LOADED) {
+        ExHeader_Info exheaderInfo;
+        listAndTerminateDependencies(&processBackup, &exheaderInfo);
+    }
+
+    if (g_manager.runningApplicationData != NULL && processBackup.handle == g_manager.runningApplicationData->handle) {
+        g_manager.runningApplicationData = NULL;
+    }
+
+    // The monitor rebuilds its handle list, then signals the event if nothing is terminating anymore
+    bool atLeastOneTerminating = false;
+    ProcessList_Lock(&g_manager.processList);
+    FOREACH_PROCESS(&g_manager.processList, process) {
+        atLeastOneTerminating = atLeastOneTerminating || process->terminationStatus == TERMSTATUS_NOTIFICATION_SENT;
+    }
+    ProcessList_Unlock(&g_manager.processList);
+
+    if (g_manager.waitingForTermination && !atLeastOneTerminating) {
+        svcSignalEvent(g_manager.allNotifiedTerminationEvent);
+    }
+}
+
+Result svcWaitSynchronization(Handle handle, s64 nanoseconds)
+{
+    // Rounded up, as the clock only moves in here
+    u64 deadline = nanoseconds < 0 ? ~0ULL : g_simTick + (nanoseconds * SYSCLOCK_ARM11 + 1000 * 1000 * 1000LL - 1) / (1000 * 1000 * 1000LL);
+
+    if (handle != EVENT_HANDLE) {
+        fprintf(stderr, "line %lu: waiting on unknown handle 0x%lx\n", (unsigned long)lineNumber, (unsigned long)handle);
+        exit(1);
+    }
+
+    while (!eventSignaled) {
+        SimProcess *next = NULL;
+        for (u32 i = 0; i < numSimProcesses; i++) {
+            SimProcess *sim = &simProcesses[i];
+            if (sim->exiting && !sim->exited && (next == NULL || sim->exitTick < next->exitTick)) {
+                next = sim;
+            }
+        }
+
+        if (next == NULL || next->exitTick > deadline) {
+            if (nanoseconds < 0) {
+                fprintf(stderr, "line %lu: deadlock, waiting forever with no process exiting\n", (unsigned long)lineNumber);
+                exit(1);
+            }
+
+            g_simTick = deadline;
+            return 0x09401BFE;
+        }
+
+        g_simTick = next->exitTick > g_simTick ? next->exitTick : g_simTick;
+        processExited(next);
+    }
+
+    eventSignaled = false;
+    return 0;
+}
+
+static void reset(void)
+{
+    memset(&g_manager, 0, sizeof(Manager));
+    ProcessList_Init(&g_manager.processList, processDataBuffer, 0x40);
+    g_manager.allNotifiedTerminationEvent = EVENT_HANDLE;
+    memset(simProcesses, 0, sizeof(simProcesses));
+    numSimProcesses = 0;
+    g_simNumKips = 0;
+    eventSignaled = false;
+}
+
+static u64 parseNumber(const char *token)
+{
+    char *end;
+    u64 value = strtoull(token, &end, 0);
+    if (*end != 0) {
+        fprintf(stderr, "line %lu: invalid number \"%s\"\n", (unsigned long)lineNumber, token);
+        exit(1);
+    }
+
+    return value;
+}
+
+// TIMEOUT_MS arguments: negative for no timeout
+static s64 parseTimeout(const char *token)
+{
+    s64 ms = token[0] == '-' ? -(s64)parseNumber(token + 1) : (s64)parseNumber(token);
+    return ms < 0 ? -1LL : ms * 1000 * 1000LL;
+}
+
+static void addProcess(char **tokens, u32 nbTokens, bool kip)
+{
+    u32 pid = (u32)parseNumber(tokens[1]);
+    ProcessData *process;
+    SimProcess *sim;
+    u32 i = 2;
+
+    if (findSimProcess(pid) != NULL || (process = ProcessList_New(&g_manager.processList)) == NULL) {
+        fprintf(stderr, "line %lu: duplicate pid or too many processes\n", (unsigned long)lineNumber);
+        exit(1);
+    }
+
+    sim = &simProcesses[numSimProcesses++];
+
+    sim->pid = pid;
+    process->pid = pid;
+    process->handle = PROCESS_HANDLE_BASE + pid;
+    process->refcount = 1;
+    process->terminationStatus = TERMSTATUS_RUNNING;
+
+    if (kip) {
+        process->titleId = 0x0004000100001000ULL;
+        process->flags = PROCESSFLAG_KIP;
+        g_simNumKips = pid + 1 > g_simNumKips ? pid + 1 : g_simNumKips;
+    } else if (nbTokens > 2) {
+        process->titleId = parseNumber(tokens[i++]);
+    }
+
+    for (; i < nbTokens; i++) {
+        char *value = strchr(tokens[i], '=');
+        if (value != NULL) {
+            *value++ = 0;
+        }
+
+        if (strcmp(tokens[i], "exit") == 0 && value != NULL) {
+            sim->exitDelay = strcmp(value, "never") == 0 ? -1 : nsToTicks(parseNumber(value) * 1000 * 1000LL);
+        } else if (strcmp(tokens[i], "ack") == 0 && value != NULL) {
+            sim->ackDelay = nsToTicks(parseNumber(value) * 1000LL);
+        } else if (strcmp(tokens[i], "refcount") == 0 && value != NULL) {
+            process->refcount = (u8)parseNumber(value);
+        } else if (strcmp(tokens[i], "deps") == 0 && value != NULL) {
+            for (char *dep = strtok(value, ","); dep != NULL && sim->numDeps < 48; dep = strtok(NULL, ",")) {
+                sim->dependencies[sim->numDeps++] = parseNumber(dep);
+            }
+        } else if (strcmp(tokens[i], "fail") == 0) {
+            sim->failNotification = true;
+        } else if (strcmp(tokens[i], "app") == 0) {
+            g_manager.runningApplicationData = process;
+            process->flags |= PROCESSFLAG_NORMAL_APPLICATION;
+        } else if (strcmp(tokens[i], "autoloaded") == 0) {
+            process->flags |= PROCESSFLAG_AUTOLOADED;
+        } else if (strcmp(tokens[i], "depsloaded") == 0) {
+            process->flags |= PROCESSFLAG_DEPENDENCIES_LOADED;
+        } else {
+            fprintf(stderr, "line %lu: invalid option \"%s\"\n", (unsigned long)lineNumber, tokens[i]);
+            exit(1);
+        }
+    }
+}
+
+static const ShutdownTraceEntry *findTraceEntry(const ShutdownTrace *trace, u32 pid)
+{
+    for (u32 i = 0; i < trace->numEntries; i++) {
+        if (trace->entries[i].pid == pid) {
+            return &trace->entries[i];
+        }
+    }
+
+    fprintf(stderr, "line %lu: pid %lu not in the trace\n", (unsigned long)lineNumber, (unsigned long)pid);
+    exit(1);
+}
+
+static void printTrace(void)
+{
+    static const char *reasons[] = { "none", "application", "title", "process", "reboot", "firmlaunch", "chainload" };
+    ShutdownTrace trace;
+    GetShutdownTrace(&trace, sizeof(trace));
+
+    printf("trace: %s, caller %ld, %lu waves, %lu processes, %lu forced, %.3f ms\n", reasons[trace.reason], (long)(s32)trace.callerPid,
+        (unsigned long)trace.numWaves, (unsigned long)trace.numEntries, (unsigned long)trace.numForced, trace.totalUs / 1000.0);
+
+    for (u32 i = 0; i < trace.numEntries; i++) {
+        const ShutdownTraceEntry *entry = &trace.entries[i];
+        printf("  wave %u pid %-3lu %016llx notified at %9.3f ms, ack %6lu us, ", entry->wave, (unsigned long)entry->pid,
+            (unsigned long long)entry->titleId, entry->notifiedUs / 1000.0, (unsigned long)entry->ackUs);
+
+        if (entry->flags & SHUTDOWNTRACE_FLAG_EXITED) {
+            printf("exit %9.3f ms", entry->exitUs / 1000.0);
+        } else {
+            printf("still running");
+        }
+
+        printf("%s%s%s\n", (entry->flags & SHUTDOWNTRACE_FLAG_FORCED) ? " forced" : "",
+            (entry->flags & SHUTDOWNTRACE_FLAG_DEPENDENCY) ? " dependency" : "",
+            (entry->flags & SHUTDOWNTRACE_FLAG_NOTIFICATION_FAILED) ? " notification-failed" : "");
+    }
+}
+
+static void expect(bool condition, const char *what, u32 pid, u32 expected, u32 actual)
+{
+    if (!condition) {
+        printf("line %lu: FAILED: %s of pid %lu is %lu, expected %lu\n", (unsigned long)lineNumber, what, (unsigned long)pid,
+            (unsigned long)actual, (unsigned long)expected);
+        expectationFailed = true;
+    }
+}
+
+static void runCommand(char **tokens, u32 nbTokens)
+{
+    const char *cmd = tokens[0];
+    ShutdownTrace trace;
+
+    printf("> ");
+    for (u32 i = 0; i < nbTokens; i++) {
+        printf("%s%s", tokens[i], i + 1 < nbTokens ? " " : "\n");
+    }
+
+    if (strcmp(cmd, "kip") == 0 && nbTokens >= 2) {
+        addProcess(tokens, nbTokens, true);
+    } else if (strcmp(cmd, "process") == 0 && nbTokens >= 3) {
+        addProcess(tokens, nbTokens, false);
+    } else if (strcmp(cmd, "terminate-all") == 0 && nbTokens == 3) {
+        u32 callerPid = (u32)strtol(tokens[1], NULL, 0);
+        ProcessData *caller = terminateAllProcesses(callerPid, parseTimeout(tokens[2]));
+        if (caller != NULL) {
+            ProcessData_Notify(caller, 0x179);
+        }
+    } else if (strcmp(cmd, "terminate-app") == 0 && nbTokens == 2) {
+        TerminateApplication(parseTimeout(tokens[1]));
+    } else if (strcmp(cmd, "terminate-title") == 0 && nbTokens == 3) {
+        TerminateTitle(parseNumber(tokens[1]), parseTimeout(tokens[2]));
+    } else if (strcmp(cmd, "trace") == 0) {
+        printTrace();
+    } else if (strcmp(cmd, "reset") == 0) {
+        reset();
+    } else if (strcmp(cmd, "expect-wave") == 0 && nbTokens == 3) {
+        GetShutdownTrace(&trace, sizeof(trace));
+        u32 pid = (u32)parseNumber(tokens[1]);
+        u32 wave = findTraceEntry(&trace, pid)->wave;
+        expect(wave == parseNumber(tokens[2]), "wave", pid, parseNumber(tokens[2]), wave);
+    } else if (strcmp(cmd, "expect-forced") == 0 && nbTokens == 3) {
+        GetShutdownTrace(&trace, sizeof(trace));
+        u32 pid = (u32)parseNumber(tokens[1]);
+        u32 forced = (findTraceEntry(&trace, pid)->flags & SHUTDOWNTRACE_FLAG_FORCED) != 0;
+        expect(forced == parseNumber(tokens[2]), "forced", pid, parseNumber(tokens[2]), forced);
+    } else {
+        fprintf(stderr, "line %lu: invalid command \"%s\"\n", (unsigned long)lineNumber, cmd);
+        exit(1);
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    FILE *f = argc > 1 ? fopen(argv[1], "r") : stdin;
+    char line[512];
+
+    if (f == NULL) {
+        perror(argv[1]);
+        return 1;
+    }
+
+    g_simTick = SIM_START_TICK;
+    reset();
+    while (fgets(line, sizeof(line), f) != NULL) {
+        char *tokens[64];
+        u32 nbTokens = 0;
+
+        char *comment = strchr(line, '#');
+        if (comment != NULL) {
+            *comment = 0;
+        }
+
+        lineNumber++;
+        for (char *token = strtok(line, " \t\r\n"); token != NULL && nbTokens < 64; token = strtok(NULL, " \t\r\n")) {
+            tokens[nbTokens++] = token;
+        }
+
+        if (nbTokens != 0) {
+            runCommand(tokens, nbTokens);
+        }
+    }
+
+    if (f != stdin) {
+        fclose(f);
+    }
+
+    return expectationFailed ? 1 : 0;
+}
@@ -20,12 +20,82 @@
 #include "luma.h"
 #include "util.h"
 
+/// Per-title settings flags.
+enum
+{
+    LUMA_TITLE_SETTING_N3DS     = BIT(0),   ///< Run the title with the New 3DS clock/L2 mode below (was /luma/n3ds/<tid>.bin).
+    LUMA_TITLE_SETTING_PLUGIN   = BIT(1),   ///< Enable the plugin loader for the title (was /luma/plugins/PerGame/<tid>.bin).
+    LUMA_TITLE_SETTING_LOCALE   = BIT(2),   ///< Use the locale below instead of /luma/titles/<tid>/locale.txt.
+};
+
+/// New 3DS mode bits, same layout as the argument of svcKernelSetState(10).
+enum
+{
+    LUMA_N3DS_MODE_CLOCK_804MHZ = BIT(0),
+    LUMA_N3DS_MODE_L2_CACHE     = BIT(1),
+};
+
+/// Per-title settings record, as stored (sorted by title ID) in /luma/titlesettings.bin.
+typedef struct LumaTitleSettings {
+    u64 title_id;
+    u8 flags;                       ///< LUMA_TITLE_SETTING_* flags.
+    u8 n3ds_mode;                   ///< LUMA_N3DS_MODE_* bits, used with LUMA_TITLE_SETTING_N3DS.
+    u8 locale_mask;                 ///< Which of the following fields are set, same as the svcKernelSetState(0x10001) mask.
+    u8 region_id;
+    u8 language_id;
+    u8 country_id;
+    u8 state_id;
+    u8 reserved;
+} LumaTitleSettings;
+
+#define LUMA_TITLE_SETTINGS_MAX     120
+
+/// /luma/titlesettings.bin: magic, u16 version, u16 record count, then the records. Rewritten through a temporary file.
+#define LUMA_TITLE_SETTINGS_PATH        "/luma/titlesettings.bin"
+#define LUMA_TITLE_SETTINGS_TMP_PATH    "/luma/titlesettings.tmp"
+#define LUMA_TITLE_SETTINGS_MAGIC       0x54455354 // 'TSET'
+#define LUMA_TITLE_SETTINGS_VERSION     1
+
+typedef struct LumaTitleSettingsHeader {
+    u32 magic;
+    u16 version;
+    u16 num_records;
+} LumaTitleSettingsHeader;
+
 /// Luma shared config type (private!).
 typedef struct LumaSharedConfig {
     u64 hbldr_3dsx_tid;             ///< Title ID to use for 3DSX loading (current).
     u64 selected_hbldr_3dsx_tid;    ///< Title ID to use for 3DSX loading (to be moved to "current" when the current app closes).
     bool use_hbldr;                 ///< Whether or not Loader should use hb:ldr (reset to true).
+    bool per_game_plugin;           ///< Whether or not per-title plugin settings are enabled (set by Rosalina from its extra config).
+    bool title_settings_loaded;     ///< Whether or not Loader has loaded /luma/titlesettings.bin (once per boot).
+    u32 num_title_settings;         ///< Number of records in title_settings.
+    LumaTitleSettings title_settings[LUMA_TITLE_SETTINGS_MAX]; ///< Sorted by title ID, see lumaFindTitleSettings.
 } LumaSharedConfig;
 
 /// Luma shared config.
 #define Luma_SharedConfig ((volatile LumaSharedConfig *)(OS_SHAREDCFG_VADDR + 0x800))
+
+/// Returns the settings record of a title, or NULL if there is none.
+static inline volatile LumaTitleSettings *lumaFindTitleSettings(u64 titleId)
+{
+    u32 lo = 0, hi = Luma_SharedConfig->num_title_settings;
+
+    if (hi > LUMA_TITLE_SETTINGS_MAX)
+        return NULL;
+
+    while (lo < hi)
+    {
+        u32 mid = (lo + hi) / 2;
+        u64 midId = Luma_SharedConfig->title_settings[mid].title_id;
+
+        if (midId == titleId)
+            return &Luma_SharedConfig->title_settings[mid];
+        else if (midId < titleId)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+
+    return NULL;
+}
@@ -5,6 +5,8 @@
 #include "util.h"
 #include "manager.h"
 #include "pmdbg.h"
+#include "shutdown_trace.h"
+#include "resource_sampler.h"
 
 void pmDbgHandleCommands(void *ctx)
 {
@@ -16,6 +18,10 @@ void pmDbgHandleCommands(void *ctx)
     Handle debug;
     u32 pid;
     u32 launchFlags;
+    u32 size;
+    void *buf;
+    u32 numSamples;
+    ProcessResourceUsage usage;
 
     switch (cmdhdr >> 16) {
         case 1:
@@ -59,10 +65,43 @@ void pmDbgHandleCommands(void *ctx)
             cmdbuf[2] = IPC_Desc_MoveHandles(1);
             cmdbuf[3] = debug;
             break;
+        case 0x104:
+            if (cmdhdr != IPC_MakeHeader(0x104, 0, 2) || (cmdbuf[1] & 0xF) != 0xC) {
+                goto invalid_command;
+            }
+            size = cmdbuf[1] >> 4;
+            buf = (void *)cmdbuf[2];
+            cmdbuf[1] = GetShutdownTrace(buf, size);
+            cmdbuf[0] = IPC_MakeHeader(0x104, 1, 2);
+            cmdbuf[2] = IPC_Desc_Buffer(size, IPC_BUFFER_W);
+            cmdbuf[3] = (u32)buf;
+            break;
+        case 0x105:
+            if (cmdhdr != IPC_MakeHeader(0x105, 0, 2) || (cmdbuf[1] & 0xF) != 0xC) {
+                goto invalid_command;
+            }
+            size = cmdbuf[1] >> 4;
+            buf = (void *)cmdbuf[2];
+            cmdbuf[1] = GetResourceSamples(&numSamples, buf, size);
+            cmdbuf[0] = IPC_MakeHeader(0x105, 2, 2);
+            cmdbuf[2] = numSamples;
+            cmdbuf[3] = IPC_Desc_Buffer(size, IPC_BUFFER_W);
+            cmdbuf[4] = (u32)buf;
+            break;
+        case 0x106:
+            memset(&usage, 0, sizeof(usage));
+            cmdbuf[1] = GetProcessResourceUsage(&usage, cmdbuf[1]);
+            cmdbuf[0] = IPC_MakeHeader(0x106, 4, 0);
+            memcpy(cmdbuf + 2, &usage, sizeof(ProcessResourceUsage));
+            break;
         case 0x103: // PrepareToChainloadHomebrew (removed)
         default:
-            cmdbuf[0] = IPC_MakeHeader(0, 1, 0);
-            cmdbuf[1] = 0xD900182F;
-            break;
+            goto invalid_command;
     }
+
+    return;
+
+    invalid_command:
+    cmdbuf[0] = IPC_MakeHeader(0, 1, 0);
+    cmdbuf[1] = 0xD900182F;
 }
@@ -36,6 +36,7 @@ typedef struct ProcessData {
     TerminationStatus terminationStatus;
     u8 refcount;
     FS_MediaType mediaType;
+    u64 terminationDeadline; // in ticks, 0 for the timeout of the current termination. Not in official PM
 } ProcessData;
 
 typedef struct ProcessList {
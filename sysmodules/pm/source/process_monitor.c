@@ -4,12 +4,16 @@
 #include "exheader_info_heap.h"
 #include "termination.h"
 #include "reslimit.h"
+#include "shutdown_trace.h"
+#include "resource_sampler.h"
 #include "manager.h"
 #include "util.h"
 #include "luma_shared_config.h"
 
 static void cleanupProcess(ProcessData *process)
 {
+    ResourceSampler_OnProcessExit(process);
+
     if (process->flags & PROCESSFLAG_DEPENDENCIES_LOADED) {
         ExHeader_Info *exheaderInfo = ExHeaderInfoHeap_New();
 
@@ -57,6 +61,8 @@ void processMonitor(void *p)
 
     Handle handles[0x41] = { g_manager.newProcessEvent };
 
+    ResourceSampler_Init();
+
     for (;;) {
         u32 numProcesses = 0;
         bool atLeastOneTerminating = false;
@@ -64,6 +70,9 @@ void processMonitor(void *p)
         ProcessData processBackup;
         s32 id = -1;
 
+        // Also wakes the thread up periodically to sample resource usage
+        s64 timeout = ResourceSampler_Update();
+
         ProcessList_Lock(&g_manager.processList);
         FOREACH_PROCESS(&g_manager.processList, process) {
             // Rebuild the handle array
@@ -82,7 +91,7 @@ void processMonitor(void *p)
         }
 
         // Note: lack of assertSuccess is intentional.
-        svcWaitSynchronizationN(&id, handles, 1 + numProcesses, false, -1LL);
+        svcWaitSynchronizationN(&id, handles, 1 + numProcesses, false, timeout);
 
         if (id > 0) {
             // Note: official PM conditionally erases the process from the list, cleans up, then conditionally frees the process data
@@ -91,6 +100,7 @@ void processMonitor(void *p)
             process = ProcessList_FindProcessByHandle(&g_manager.processList, handles[id]);
             if (process != NULL) {
                 process->terminationStatus = TERMSTATUS_TERMINATED;
+                ShutdownTrace_RecordExit(process);
                 if (process->flags & PROCESSFLAG_NOTIFY_TERMINATION) {
                     process->flags |= PROCESSFLAG_NOTIFY_TERMINATION_TERMINATED;
                 }
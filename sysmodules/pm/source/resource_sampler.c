@@ -0,0 +1,269 @@
+#include <3ds.h>
+#include <string.h>
+#include "resource_sampler.h"
+#include "manager.h"
+#include "util.h"
+
+// Everything here is only used by the process monitor thread, except what pm:dbg reads under the process list lock
+
+typedef struct ProcessUsageSlot {
+    u32 pid;
+    bool used;
+    ProcessResourceUsage usage;
+} ProcessUsageSlot;
+
+typedef struct PendingTitleStats {
+    u64 titleId;
+    ProcessResourceUsage usage;
+    u32 memoryLimit;
+    u32 runTimeSec;
+} PendingTitleStats;
+
+static ResourceSample g_samples[RESOURCE_SAMPLER_RING_SIZE];
+static u32 g_sampleHead, g_numSamples;
+static ProcessUsageSlot g_processUsage[0x40];
+static PendingTitleStats g_pendingTitleStats[RESOURCE_SAMPLER_MAX_PENDING];
+static u32 g_numPendingTitleStats;
+static u64 g_nextSampleTick;
+static bool g_fsInitialized;
+
+static ProcessUsageSlot *findProcessUsageSlot(u32 pid, bool allocate)
+{
+    ProcessUsageSlot *freeSlot = NULL;
+
+    for (u32 i = 0; i < sizeof(g_processUsage) / sizeof(g_processUsage[0]); i++) {
+        if (g_processUsage[i].used && g_processUsage[i].pid == pid) {
+            return &g_processUsage[i];
+        } else if (!g_processUsage[i].used && freeSlot == NULL) {
+            freeSlot = &g_processUsage[i];
+        }
+    }
+
+    if (!allocate || freeSlot == NULL) {
+        return NULL;
+    }
+
+    memset(freeSlot, 0, sizeof(ProcessUsageSlot));
+    freeSlot->pid = pid;
+    freeSlot->used = true;
+    return freeSlot;
+}
+
+static u32 getProcessRunTimeSec(Handle handle)
+{
+    s64 creationTick = 0;
+    svcGetHandleInfo(&creationTick, handle, 0);
+    u64 elapsed = svcGetSystemTick() - (u64)creationTick;
+    return (u32)(elapsed / SYSCLOCK_ARM11);
+}
+
+static void takeSample(void)
+{
+    ResourceSample *sample = &g_samples[g_sampleHead];
+    ProcessData *process;
+    ResourceLimitType types[3] = { RESLIMIT_COMMIT, RESLIMIT_THREAD, RESLIMIT_CPUTIME };
+    s64 values[3];
+
+    memset(sample, 0, sizeof(ResourceSample));
+    sample->timeMs = (u32)(1000 * svcGetSystemTick() / SYSCLOCK_ARM11); // ticksToNs would overflow
+
+    for (u32 i = 0; i < 4; i++) {
+        if (R_SUCCEEDED(svcGetResourceLimitCurrentValues(values, g_manager.reslimits[i], types, 3))) {
+            sample->commit[i] = (u32)values[0];
+            sample->threads[i] = (u16)values[1];
+            if (i == RESLIMIT_CATEGORY_APPLICATION) {
+                sample->appCpuTime = (u8)values[2];
+            }
+        }
+    }
+
+    ProcessList_Lock(&g_manager.processList);
+    FOREACH_PROCESS(&g_manager.processList, process) {
+        s64 memory = 0, threads = 0;
+        ProcessUsageSlot *slot;
+
+        if (process->terminationStatus == TERMSTATUS_TERMINATED || (slot = findProcessUsageSlot(process->pid, true)) == NULL) {
+            continue;
+        }
+
+        svcGetProcessInfo(&memory, process->handle, 0);
+        svcGetProcessInfo(&threads, process->handle, 7);
+        if (process == g_manager.runningApplicationData) {
+            // Unlike svcGetProcessInfo, includes the linear heap
+            memory = sample->commit[RESLIMIT_CATEGORY_APPLICATION];
+        }
+
+        slot->usage.memory = (u32)memory;
+        slot->usage.threads = (u16)threads;
+        slot->usage.peakMemory = slot->usage.memory > slot->usage.peakMemory ? slot->usage.memory : slot->usage.peakMemory;
+        slot->usage.peakThreads = slot->usage.threads > slot->usage.peakThreads ? slot->usage.threads : slot->usage.peakThreads;
+
+        if (process == g_manager.runningApplicationData) {
+            sample->appMemory = slot->usage.memory;
+            sample->appThreads = slot->usage.threads;
+        }
+
+        sample->numProcesses++;
+    }
+
+    g_sampleHead = (g_sampleHead + 1) % RESOURCE_SAMPLER_RING_SIZE;
+    g_numSamples = g_numSamples < RESOURCE_SAMPLER_RING_SIZE ? g_numSamples + 1 : g_numSamples;
+    ProcessList_Unlock(&g_manager.processList);
+}
+
+static void formatTitleStatsPath(char *path, u64 titleId)
+{
+    static const char hexDigits[] = "0123456789ABCDEF";
+    static const char prefix[] = "/luma/titles/";
+
+    memcpy(path, prefix, sizeof(prefix) - 1);
+    path += sizeof(prefix) - 1;
+    for (u32 i = 0; i < 16; i++) {
+        path[i] = hexDigits[(titleId >> (60 - 4 * i)) & 0xF];
+    }
+    path[16] = '\0';
+}
+
+static Result writeTitleStats(const PendingTitleStats *pending)
+{
+    Result res = 0;
+    FS_Archive sdmcArchive;
+    Handle file;
+    TitleResourceStats stats;
+    u32 bytesRead = 0, bytesWritten = 0;
+    char path[] = "/luma/titles/0123456789ABCDEF/resources.bin";
+
+    if (!g_fsInitialized) {
+        TRY(fsInit());
+        g_fsInitialized = true;
+    }
+
+    TRY(FSUSER_OpenArchive(&sdmcArchive, ARCHIVE_SDMC, fsMakePath(PATH_EMPTY, "")));
+
+    // Failures are expected if the directories already exist
+    formatTitleStatsPath(path, pending->titleId);
+    FSUSER_CreateDirectory(sdmcArchive, fsMakePath(PATH_ASCII, "/luma/titles"), 0);
+    FSUSER_CreateDirectory(sdmcArchive, fsMakePath(PATH_ASCII, path), 0);
+    path[29] = '/';
+
+    TRYG(FSUSER_OpenFile(&file, sdmcArchive, fsMakePath(PATH_ASCII, path), FS_OPEN_READ | FS_OPEN_WRITE | FS_OPEN_CREATE, 0), end);
+
+    if (R_FAILED(FSFILE_Read(file, &bytesRead, 0, &stats, sizeof(stats))) || bytesRead != sizeof(stats) || stats.magic != TITLE_RESOURCE_STATS_MAGIC) {
+        memset(&stats, 0, sizeof(stats));
+        stats.magic = TITLE_RESOURCE_STATS_MAGIC;
+    }
+
+    ResourceSampler_MergeTitleStats(&stats, &pending->usage, pending->memoryLimit, pending->runTimeSec);
+    res = FSFILE_Write(file, &bytesWritten, 0, &stats, sizeof(stats), FS_WRITE_FLUSH);
+    FSFILE_Close(file);
+
+end:
+    FSUSER_CloseArchive(sdmcArchive);
+    return res;
+}
+
+void ResourceSampler_MergeTitleStats(TitleResourceStats *stats, const ProcessResourceUsage *usage, u32 memoryLimit, u32 runTimeSec)
+{
+    stats->numRuns++;
+    stats->peakMemory = usage->peakMemory > stats->peakMemory ? usage->peakMemory : stats->peakMemory;
+    stats->peakThreads = usage->peakThreads > stats->peakThreads ? usage->peakThreads : stats->peakThreads;
+    stats->lastPeakMemory = usage->peakMemory;
+    stats->lastPeakThreads = usage->peakThreads;
+    stats->memoryLimit = memoryLimit;
+    stats->lastRunTimeSec = runTimeSec;
+    stats->totalRunTimeSec = stats->totalRunTimeSec + runTimeSec < stats->totalRunTimeSec ? 0xFFFFFFFF : stats->totalRunTimeSec + runTimeSec;
+}
+
+void ResourceSampler_Init(void)
+{
+    g_nextSampleTick = svcGetSystemTick();
+}
+
+s64 ResourceSampler_Update(void)
+{
+    u64 now = svcGetSystemTick();
+
+    if (now >= g_nextSampleTick) {
+        takeSample();
+
+        // Don't slow terminations down, especially firmlaunches (which lose the stats anyway)
+        if (!g_manager.waitingForTermination && !g_manager.preparingForReboot) {
+            for (u32 i = 0; i < g_numPendingTitleStats; i++) {
+                writeTitleStats(&g_pendingTitleStats[i]);
+            }
+            g_numPendingTitleStats = 0;
+        }
+
+        now = svcGetSystemTick();
+        g_nextSampleTick = now + nsToTicks(RESOURCE_SAMPLER_PERIOD_MS * 1000 * 1000LL);
+    }
+
+    return ticksToNs(g_nextSampleTick - now);
+}
+
+void ResourceSampler_OnProcessExit(const ProcessData *process)
+{
+    s64 memoryLimit = 0;
+    ResourceLimitType category = RESLIMIT_COMMIT;
+
+    ProcessList_Lock(&g_manager.processList);
+    ProcessUsageSlot *slot = findProcessUsageSlot(process->pid, false);
+    if (slot == NULL) {
+        ProcessList_Unlock(&g_manager.processList);
+        return;
+    }
+
+    slot->used = false;
+    if ((process->flags & PROCESSFLAG_NORMAL_APPLICATION) && !g_manager.preparingForReboot) {
+        // Keep the most recent runs if too many titles exit before the next sample
+        if (g_numPendingTitleStats == RESOURCE_SAMPLER_MAX_PENDING) {
+            memmove(&g_pendingTitleStats[0], &g_pendingTitleStats[1], sizeof(PendingTitleStats) * (RESOURCE_SAMPLER_MAX_PENDING - 1));
+            g_numPendingTitleStats--;
+        }
+
+        PendingTitleStats *pending = &g_pendingTitleStats[g_numPendingTitleStats++];
+        svcGetResourceLimitLimitValues(&memoryLimit, g_manager.reslimits[RESLIMIT_CATEGORY_APPLICATION], &category, 1);
+        pending->titleId = process->titleId;
+        pending->usage = slot->usage;
+        pending->memoryLimit = (u32)memoryLimit;
+        pending->runTimeSec = getProcessRunTimeSec(process->handle);
+    }
+
+    ProcessList_Unlock(&g_manager.processList);
+}
+
+u32 ResourceSampler_GetSamples(ResourceSample *out, u32 maxSamples)
+{
+    u32 num = maxSamples < g_numSamples ? maxSamples : g_numSamples;
+
+    for (u32 i = 0; i < num; i++) {
+        out[i] = g_samples[(g_sampleHead + RESOURCE_SAMPLER_RING_SIZE - 1 - i) % RESOURCE_SAMPLER_RING_SIZE];
+    }
+
+    return num;
+}
+
+Result GetResourceSamples(u32 *outNumSamples, void *buf, u32 size)
+{
+    ProcessList_Lock(&g_manager.processList);
+    *outNumSamples = ResourceSampler_GetSamples((ResourceSample *)buf, size / sizeof(ResourceSample));
+    ProcessList_Unlock(&g_manager.processList);
+
+    return 0;
+}
+
+Result GetProcessResourceUsage(ProcessResourceUsage *outUsage, u32 pid)
+{
+    Result res = 0;
+
+    ProcessList_Lock(&g_manager.processList);
+    ProcessUsageSlot *slot = findProcessUsageSlot(pid, false);
+    if (slot != NULL) {
+        *outUsage = slot->usage;
+    } else {
+        res = MAKERESULT(RL_TEMPORARY, RS_NOTFOUND, RM_PM, 0x100);
+    }
+    ProcessList_Unlock(&g_manager.processList);
+
+    return res;
+}
@@ -0,0 +1,60 @@
+#pragma once
+
+#include <3ds/types.h>
+#include "process_data.h"
+#include "util.h"
+
+// Resource usage telemetry, sampled by the process monitor thread.
+// The samples (pm:dbg 0x105) and the per-title stats file layouts are shared with whatever reads them.
+
+#define RESOURCE_SAMPLER_PERIOD_MS      1000
+#define RESOURCE_SAMPLER_RING_SIZE      64
+#define RESOURCE_SAMPLER_MAX_PENDING    4
+
+#define TITLE_RESOURCE_STATS_MAGIC      0x53545352 // "RSTS"
+
+typedef struct ResourceSample {
+    u32 timeMs;                 // since boot
+    u32 commit[4];              // current RESLIMIT_COMMIT value of each reslimit category
+    u16 threads[4];             // current RESLIMIT_THREAD value of each reslimit category
+    u32 appMemory;              // commit[0] if an application is running, else 0
+    u16 appThreads;
+    u8 appCpuTime;              // current RESLIMIT_CPUTIME value of the application category
+    u8 numProcesses;
+} ResourceSample;
+
+typedef struct ProcessResourceUsage {
+    u32 memory;                 // svcGetProcessInfo type 0 (application: commit[0] instead), as of the last sample
+    u32 peakMemory;
+    u16 threads;
+    u16 peakThreads;
+} ProcessResourceUsage;
+
+// Stored as /luma/titles/<title ID>/resources.bin, for applications only
+typedef struct TitleResourceStats {
+    u32 magic;
+    u32 numRuns;
+    u32 peakMemory;             // over all runs
+    u32 lastPeakMemory;
+    u32 memoryLimit;            // of the application category, during the last run
+    u16 peakThreads;
+    u16 lastPeakThreads;
+    u32 lastRunTimeSec;
+    u32 totalRunTimeSec;
+} TitleResourceStats;
+
+void ResourceSampler_Init(void);
+
+// Samples if due, writes the pending title stats when no termination is in progress,
+// then returns the timeout to use until the next sample, in ns
+s64 ResourceSampler_Update(void);
+
+// Queues the stats of the run of a process that has just exited
+void ResourceSampler_OnProcessExit(const ProcessData *process);
+
+// Latest sample first, returns the number of samples written
+u32 ResourceSampler_GetSamples(ResourceSample *out, u32 maxSamples);
+void ResourceSampler_MergeTitleStats(TitleResourceStats *stats, const ProcessResourceUsage *usage, u32 memoryLimit, u32 runTimeSec);
+
+Result GetResourceSamples(u32 *outNumSamples, void *buf, u32 size);
+Result GetProcessResourceUsage(ProcessResourceUsage *outUsage, u32 pid);
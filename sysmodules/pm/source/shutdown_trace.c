@@ -0,0 +1,121 @@
+#include <3ds.h>
+#include <string.h>
+#include "shutdown_trace.h"
+#include "manager.h"
+#include "util.h"
+
+static ShutdownTrace g_shutdownTrace;
+static bool g_shutdownTraceActive;
+static u8 g_currentWave;
+static bool g_currentWaveUsed;
+
+static inline u32 ticksToUs(u64 ticks)
+{
+    u64 us = 1000 * 1000 * ticks / SYSCLOCK_ARM11;
+    return us > 0xFFFFFFFF ? 0xFFFFFFFF : (u32)us;
+}
+
+static ShutdownTraceEntry *findEntry(u32 pid)
+{
+    for (u32 i = 0; i < g_shutdownTrace.numEntries; i++) {
+        if (g_shutdownTrace.entries[i].pid == pid) {
+            return &g_shutdownTrace.entries[i];
+        }
+    }
+
+    return NULL;
+}
+
+void ShutdownTrace_Begin(ShutdownReason reason, u32 callerPid)
+{
+    ProcessList_Lock(&g_manager.processList);
+    memset(&g_shutdownTrace, 0, sizeof(ShutdownTrace));
+    g_shutdownTrace.reason = reason;
+    g_shutdownTrace.callerPid = callerPid;
+    g_shutdownTrace.startTick = svcGetSystemTick();
+    g_shutdownTraceActive = true;
+    g_currentWave = 0;
+    g_currentWaveUsed = false;
+    ProcessList_Unlock(&g_manager.processList);
+}
+
+void ShutdownTrace_BeginWave(void)
+{
+    ProcessList_Lock(&g_manager.processList);
+    // Empty waves (e.g. no application running) aren't counted
+    if (g_currentWaveUsed) {
+        g_currentWave++;
+        g_currentWaveUsed = false;
+    }
+    ProcessList_Unlock(&g_manager.processList);
+}
+
+void ShutdownTrace_End(void)
+{
+    ProcessList_Lock(&g_manager.processList);
+    g_shutdownTraceActive = false;
+    ProcessList_Unlock(&g_manager.processList);
+}
+
+void ShutdownTrace_RecordNotification(const ProcessData *process, Result res, u64 startTick, u64 endTick, bool dependency)
+{
+    ProcessList_Lock(&g_manager.processList);
+
+    ShutdownTraceEntry *entry = findEntry(process->pid);
+    if (!g_shutdownTraceActive || entry != NULL || g_shutdownTrace.numEntries >= SHUTDOWNTRACE_MAX_ENTRIES) {
+        // Only the first notification of a process is recorded
+        ProcessList_Unlock(&g_manager.processList);
+        return;
+    }
+
+    entry = &g_shutdownTrace.entries[g_shutdownTrace.numEntries++];
+    entry->titleId = process->titleId;
+    entry->pid = process->pid;
+    entry->wave = g_currentWave;
+    entry->flags = (R_FAILED(res) ? SHUTDOWNTRACE_FLAG_NOTIFICATION_FAILED : 0) | (dependency ? SHUTDOWNTRACE_FLAG_DEPENDENCY : 0);
+    entry->notificationResult = res;
+    entry->notifiedUs = ticksToUs(startTick - g_shutdownTrace.startTick);
+    entry->ackUs = ticksToUs(endTick - startTick);
+    g_currentWaveUsed = true;
+    g_shutdownTrace.numWaves = g_currentWave + 1;
+
+    ProcessList_Unlock(&g_manager.processList);
+}
+
+void ShutdownTrace_RecordForcedTermination(const ProcessData *process)
+{
+    ProcessList_Lock(&g_manager.processList);
+
+    ShutdownTraceEntry *entry = findEntry(process->pid);
+    if (entry != NULL && !(entry->flags & SHUTDOWNTRACE_FLAG_FORCED)) {
+        entry->flags |= SHUTDOWNTRACE_FLAG_FORCED;
+        g_shutdownTrace.numForced++;
+    }
+
+    ProcessList_Unlock(&g_manager.processList);
+}
+
+void ShutdownTrace_RecordExit(const ProcessData *process)
+{
+    // Called by the process monitor for every process, including after ShutdownTrace_End (no timeout)
+    ProcessList_Lock(&g_manager.processList);
+
+    ShutdownTraceEntry *entry = findEntry(process->pid);
+    if (entry != NULL && !(entry->flags & SHUTDOWNTRACE_FLAG_EXITED)) {
+        u32 nowUs = ticksToUs(svcGetSystemTick() - g_shutdownTrace.startTick);
+        entry->flags |= SHUTDOWNTRACE_FLAG_EXITED;
+        entry->exitUs = nowUs - entry->notifiedUs;
+        g_shutdownTrace.totalUs = nowUs > g_shutdownTrace.totalUs ? nowUs : g_shutdownTrace.totalUs;
+    }
+
+    ProcessList_Unlock(&g_manager.processList);
+}
+
+Result GetShutdownTrace(void *buf, u32 size)
+{
+    ProcessList_Lock(&g_manager.processList);
+    memcpy(buf, &g_shutdownTrace, size < sizeof(ShutdownTrace) ? size : sizeof(ShutdownTrace));
+    ProcessList_Unlock(&g_manager.processList);
+
+    return 0;
+}
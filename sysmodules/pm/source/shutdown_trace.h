@@ -0,0 +1,61 @@
+#pragma once
+
+#include <3ds/types.h>
+#include "process_data.h"
+#include "util.h"
+
+// Record of the last termination (title exit, reboot, firmlaunch...), returned by pm:dbg 0x104.
+// The layout is shared with Rosalina (see pmdbgext.h there).
+
+#define SHUTDOWNTRACE_MAX_ENTRIES   0x40
+
+typedef enum ShutdownReason {
+    SHUTDOWNREASON_NONE                     = 0,
+    SHUTDOWNREASON_TERMINATE_APPLICATION    = 1,
+    SHUTDOWNREASON_TERMINATE_TITLE          = 2,
+    SHUTDOWNREASON_TERMINATE_PROCESS        = 3,
+    SHUTDOWNREASON_REBOOT                   = 4,
+    SHUTDOWNREASON_FIRMLAUNCH               = 5,
+    SHUTDOWNREASON_CHAINLOAD_HOMEBREW       = 6,
+} ShutdownReason;
+
+enum {
+    SHUTDOWNTRACE_FLAG_NOTIFICATION_FAILED  = BIT(0),
+    SHUTDOWNTRACE_FLAG_DEPENDENCY           = BIT(1), // notified because it was no longer used
+    SHUTDOWNTRACE_FLAG_FORCED               = BIT(2), // deadline exceeded, terminated with svcTerminateProcess
+    SHUTDOWNTRACE_FLAG_EXITED               = BIT(3),
+};
+
+typedef struct ShutdownTraceEntry {
+    u64 titleId;
+    u32 pid;
+    u8 wave;
+    u8 flags;
+    u16 reserved;
+    Result notificationResult;
+    u32 notifiedUs;     // from the start of the termination to the notification
+    u32 ackUs;          // time sm took to queue notification 0x100 for the process
+    u32 exitUs;         // from the notification to the process exiting
+} ShutdownTraceEntry;
+
+typedef struct ShutdownTrace {
+    u32 reason;
+    u32 callerPid;
+    u32 numEntries;
+    u32 numWaves;
+    u32 numForced;
+    u32 totalUs;        // from the start of the termination to the last exit
+    u64 startTick;
+    ShutdownTraceEntry entries[SHUTDOWNTRACE_MAX_ENTRIES];
+} ShutdownTrace;
+
+// All of these lock the process list
+void ShutdownTrace_Begin(ShutdownReason reason, u32 callerPid);
+void ShutdownTrace_BeginWave(void);
+void ShutdownTrace_End(void);
+
+void ShutdownTrace_RecordNotification(const ProcessData *process, Result res, u64 startTick, u64 endTick, bool dependency);
+void ShutdownTrace_RecordForcedTermination(const ProcessData *process);
+void ShutdownTrace_RecordExit(const ProcessData *process);
+
+Result GetShutdownTrace(void *buf, u32 size);
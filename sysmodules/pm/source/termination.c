@@ -7,6 +7,19 @@
 #include "task_runner.h"
 #include "launch.h"
 #include "reslimit.h"
+#include "shutdown_trace.h"
+
+#define TERMINATION_MAX_WAVES           8
+#define TERMINATION_DEADLINE_EXCEEDED   (~0ULL) // terminated with svcTerminateProcess, waiting for it to exit
+#define TERMINATION_DEADLINE_NONE       (~0ULL - 1) // negative timeout: never terminated with svcTerminateProcess
+
+// Processes terminated by terminateAllProcesses, in process list order (only used by the task runner)
+static struct {
+    u64 titleId;
+    u32 pid;
+    u32 wave;
+    u64 dependencies; // bit i set: depends on terminationTargets[i]
+} terminationTargets[0x40];
 
 void forceMountSdCard(void)
 {
@@ -17,6 +30,16 @@ void forceMountSdCard(void)
     // No need to clean up things as we will firmlaunch straight away
 }
 
+static Result sendTerminationNotification(ProcessData *process, u64 deadline, bool dependency)
+{
+    u64 startTick = svcGetSystemTick();
+    Result res = ProcessData_SendTerminationNotification(process);
+
+    process->terminationDeadline = deadline;
+    ShutdownTrace_RecordNotification(process, res, startTick, svcGetSystemTick(), dependency);
+    return res;
+}
+
 static Result terminateUnusedDependencies(const u64 *dependencies, u32 numDeps)
 {
     ProcessData *process;
@@ -36,7 +59,7 @@ static Result terminateUnusedDependencies(const u64 *dependencies, u32 numDeps)
             continue;
         }
 
-        res = ProcessData_SendTerminationNotification(process);
+        res = sendTerminationNotification(process, 0, true);
         res = R_SUMMARY(res) == RS_NOTFOUND ? 0 : res;
 
         if (R_FAILED(res)) {
@@ -68,28 +91,33 @@ static Result terminateProcessImpl(ProcessData *process, ExHeader_Info *exheader
     if (process->flags & PROCESSFLAG_DEPENDENCIES_LOADED) {
         TRY(getAndListDependencies(dependencies, &numDeps, process, exheaderInfo));
         process->flags &= ~PROCESSFLAG_DEPENDENCIES_LOADED;
-        ProcessData_SendTerminationNotification(process);
+        sendTerminationNotification(process, 0, false);
         return terminateUnusedDependencies(dependencies, numDeps);
     } else {
-        ProcessData_SendTerminationNotification(process);
+        sendTerminationNotification(process, 0, false);
         return 0;
     }
 }
 
-static void terminateProcessByIdChecked(u32 pid)
+static void terminateProcessByIdChecked(u32 pid, u64 deadline)
 {
     ProcessData *process = ProcessList_FindProcessById(&g_manager.processList, pid);
     if (process != NULL) {
-        ProcessData_SendTerminationNotification(process);
+        sendTerminationNotification(process, deadline, false);
     } else {
         panic(0LL);
     }
 }
 
-static Result commitPendingTerminations(s64 timeout)
+static u64 timeoutToDeadline(s64 timeout)
+{
+    return timeout < 0 ? TERMINATION_DEADLINE_NONE : svcGetSystemTick() + nsToTicks(timeout);
+}
+
+static Result commitPendingTerminations(u64 defaultDeadline)
 {
-    // Wait for all of the processes that have received notification 0x100 to terminate
-    // till the timeout, then actually terminate these processes, etc.
+    // Wait for all of the processes that have received notification 0x100 to terminate, actually
+    // terminating each of them when its deadline (by default, defaultDeadline) has passed.
 
     Result res = 0;
     bool atLeastOneListener = false;
@@ -103,6 +131,7 @@ static Result commitPendingTerminations(s64 timeout)
                 break;
             case TERMSTATUS_NOTIFICATION_FAILED:
                 res = svcTerminateProcess(process->handle); // official pm does not panic on failure here
+                ShutdownTrace_RecordForcedTermination(process);
                 break;
             default:
                 break;
@@ -111,25 +140,44 @@ static Result commitPendingTerminations(s64 timeout)
 
     ProcessList_Unlock(&g_manager.processList);
 
-    if (atLeastOneListener) {
-        Result res = assertSuccess(svcWaitSynchronization(g_manager.allNotifiedTerminationEvent, timeout));
+    if (!atLeastOneListener) {
+        return 0;
+    }
 
-        if (R_DESCRIPTION(res) == RD_TIMEOUT) {
-            ProcessList_Lock(&g_manager.processList);
+    for (;;) {
+        u64 now = svcGetSystemTick();
+        u64 nextDeadline = TERMINATION_DEADLINE_EXCEEDED;
+        atLeastOneListener = false;
 
-            ProcessData *process;
-            FOREACH_PROCESS(&g_manager.processList, process) {
-                if (process->terminationStatus == TERMSTATUS_NOTIFICATION_SENT) {
-                    res = svcTerminateProcess(process->handle);
-                }
+        ProcessList_Lock(&g_manager.processList);
+        FOREACH_PROCESS(&g_manager.processList, process) {
+            if (process->terminationStatus != TERMSTATUS_NOTIFICATION_SENT) {
+                continue;
             }
 
-            ProcessList_Unlock(&g_manager.processList);
+            u64 deadline = process->terminationDeadline != 0 ? process->terminationDeadline : defaultDeadline;
+            atLeastOneListener = true;
+
+            if (deadline == TERMINATION_DEADLINE_EXCEEDED || deadline == TERMINATION_DEADLINE_NONE) {
+                continue;
+            } else if (deadline <= now) {
+                svcTerminateProcess(process->handle);
+                process->terminationDeadline = TERMINATION_DEADLINE_EXCEEDED;
+                ShutdownTrace_RecordForcedTermination(process);
+            } else if (deadline < nextDeadline) {
+                nextDeadline = deadline;
+            }
+        }
+        ProcessList_Unlock(&g_manager.processList);
 
-            assertSuccess(svcWaitSynchronization(g_manager.allNotifiedTerminationEvent, -1LL));
+        if (!atLeastOneListener) {
+            break;
         }
-    } else {
-        res = 0;
+
+        // The process monitor signals the event when no process is terminating anymore; it may have
+        // been signaled before the notifications were sent, hence the loop
+        s64 waitTimeout = nextDeadline == TERMINATION_DEADLINE_EXCEEDED ? -1LL : ticksToNs(nextDeadline - now);
+        assertSuccess(svcWaitSynchronization(g_manager.allNotifiedTerminationEvent, waitTimeout));
     }
 
     return res;
@@ -147,6 +195,8 @@ static void TerminateProcessOrTitleAsync(void *argdata)
     bool notify = false;
     u8 variation = 0;
 
+    ShutdownTrace_Begin(args->useTitleId ? SHUTDOWNREASON_TERMINATE_TITLE : SHUTDOWNREASON_TERMINATE_PROCESS, (u32)-1);
+
     if (args->timeout >= 0) {
         assertSuccess(svcClearEvent(g_manager.allNotifiedTerminationEvent));
         g_manager.waitingForTermination = true;
@@ -179,12 +229,14 @@ static void TerminateProcessOrTitleAsync(void *argdata)
     ExHeaderInfoHeap_Delete(exheaderInfo);
 
     if (args->timeout >= 0) {
-        commitPendingTerminations(args->timeout);
+        commitPendingTerminations(timeoutToDeadline(args->timeout));
         g_manager.waitingForTermination = false;
         if (notify) {
             notifySubscribers(0x110 + variation);
         }
     }
+
+    ShutdownTrace_End();
 }
 
 static Result TerminateProcessOrTitle(u64 id, s64 timeout, bool useTitleId)
@@ -233,6 +285,7 @@ Result TerminateApplication(s64 timeout)
         panic(0);
     }
 
+    ShutdownTrace_Begin(SHUTDOWNREASON_TERMINATE_APPLICATION, (u32)-1);
     assertSuccess(svcClearEvent(g_manager.allNotifiedTerminationEvent));
     g_manager.waitingForTermination = true;
 
@@ -242,10 +295,11 @@ Result TerminateApplication(s64 timeout)
     }
     ProcessList_Unlock(&g_manager.processList);
 
-    res = commitPendingTerminations(timeout);
+    res = commitPendingTerminations(timeoutToDeadline(timeout));
 
     ExHeaderInfoHeap_Delete(exheaderInfo);
     g_manager.waitingForTermination = false;
+    ShutdownTrace_End();
 
     return res;
 }
@@ -260,14 +314,71 @@ Result TerminateProcess(u32 pid, s64 timeout)
     return TerminateProcessOrTitle(pid, timeout, false);
 }
 
+static void addTerminationTarget(const ProcessData *process, u32 *numTargets)
+{
+    if (process->terminationStatus == TERMSTATUS_RUNNING && *numTargets < sizeof(terminationTargets) / sizeof(terminationTargets[0])) {
+        terminationTargets[*numTargets].titleId = process->titleId;
+        terminationTargets[*numTargets].pid = process->pid;
+        ++*numTargets;
+    }
+}
+
+static u32 orderTerminationTargets(u32 numTargets, ExHeader_Info *exheaderInfo)
+{
+    // A process is put in a later wave than every process depending on it, so that it is still there
+    // while they shut down. Dependency cycles are cut at TERMINATION_MAX_WAVES. Returns the number of waves.
+    u64 dependencies[48];
+    u32 numDeps = 0;
+    u32 numWaves = numTargets > 0 ? 1 : 0;
+
+    ProcessList_Lock(&g_manager.processList);
+    for (u32 i = 0; i < numTargets; i++) {
+        ProcessData *process = ProcessList_FindProcessById(&g_manager.processList, terminationTargets[i].pid);
+        terminationTargets[i].wave = 0;
+        terminationTargets[i].dependencies = 0;
+
+        if (process == NULL || R_FAILED(getAndListDependencies(dependencies, &numDeps, process, exheaderInfo))) {
+            continue;
+        }
+
+        for (u32 j = 0; j < numTargets; j++) {
+            u32 k;
+            for (k = 0; k < numDeps && dependencies[k] != (terminationTargets[j].titleId & ~N3DS_TID_MASK); k++);
+            if (k < numDeps && j != i) {
+                terminationTargets[i].dependencies |= 1ULL << j;
+            }
+        }
+    }
+    ProcessList_Unlock(&g_manager.processList);
+
+    bool changed = true;
+    for (u32 pass = 0; changed && pass < TERMINATION_MAX_WAVES; pass++) {
+        changed = false;
+        for (u32 i = 0; i < numTargets; i++) {
+            u32 wave = terminationTargets[i].wave + 1;
+            for (u32 j = 0; j < numTargets && wave < TERMINATION_MAX_WAVES; j++) {
+                if ((terminationTargets[i].dependencies & (1ULL << j)) && terminationTargets[j].wave < wave) {
+                    terminationTargets[j].wave = wave;
+                    numWaves = wave + 1 > numWaves ? wave + 1 : numWaves;
+                    changed = true;
+                }
+            }
+        }
+    }
+
+    return numWaves;
+}
+
 ProcessData *terminateAllProcesses(u32 callerPid, s64 timeout)
 {
-    u64 dstTimePoint = svcGetSystemTick() + nsToTicks(timeout);
+    u64 dstTimePoint = timeoutToDeadline(timeout);
     ProcessData *process;
     ProcessData *callerProcess = NULL; // note: official pm returns the caller's handle instead
 
     u64 dependencies[48];
     u32 numDeps = 0;
+    u32 numTargets = 0;
+    u32 numWaves;
     s64 numKips = 0;
     svcGetSystemInfo(&numKips, 26, 0);
 
@@ -277,8 +388,7 @@ ProcessData *terminateAllProcesses(u32 callerPid, s64 timeout)
         panic(0);
     }
 
-    assertSuccess(svcClearEvent(g_manager.allNotifiedTerminationEvent));
-    g_manager.waitingForTermination = true;
+    ShutdownTrace_Begin(callerPid == (u32)-1 ? SHUTDOWNREASON_FIRMLAUNCH : SHUTDOWNREASON_REBOOT, callerPid);
 
     // List the dependencies of the caller
     if (callerPid != (u32)-1) {
@@ -298,16 +408,16 @@ ProcessData *terminateAllProcesses(u32 callerPid, s64 timeout)
         notifySubscribers(0x2000);
     }
 
-    // Send notification 0x100 to the currently running application
+    // Terminate the currently running application (its dependencies are terminated with everything else)
     if (g_manager.runningApplicationData != NULL) {
         g_manager.runningApplicationData->flags &= ~PROCESSFLAG_DEPENDENCIES_LOADED;
-        ProcessData_SendTerminationNotification(g_manager.runningApplicationData);
+        addTerminationTarget(g_manager.runningApplicationData, &numTargets);
     }
 
-    // Send notification 0x100 to anything but the caller deps or the caller; and *increase* the refcount of the latter if autoloaded
+    // Terminate anything but the caller deps or the caller; and *increase* the refcount of the latter if autoloaded
     // Ignore KIPs
     FOREACH_PROCESS(&g_manager.processList, process) {
-        if (process->flags & PROCESSFLAG_KIP) {
+        if ((process->flags & PROCESSFLAG_KIP) || process == g_manager.runningApplicationData) {
             continue;
         } else if (process == callerProcess && (process->flags & PROCESSFLAG_AUTOLOADED) != 0) {
             ProcessData_Incref(process, 1);
@@ -318,18 +428,44 @@ ProcessData *terminateAllProcesses(u32 callerPid, s64 timeout)
         for (i = 0; i < numDeps && dependencies[i] != process->titleId; i++);
 
         if (i >= numDeps) {
-            // Process not a listed dependency: send notification 0x100
-            ProcessData_SendTerminationNotification(process);
+            // Process not a listed dependency: will be sent notification 0x100
+            addTerminationTarget(process, &numTargets);
         } else if (process->flags & PROCESSFLAG_AUTOLOADED){
             ProcessData_Incref(process, 1);
         }
     }
     ProcessList_Unlock(&g_manager.processList);
+
+    numWaves = orderTerminationTargets(numTargets, exheaderInfo);
     ExHeaderInfoHeap_Delete(exheaderInfo);
 
-    s64 timeoutTicks = dstTimePoint - svcGetSystemTick();
-    commitPendingTerminations(timeoutTicks >= 0 ? ticksToNs(timeoutTicks) : 0LL);
-    g_manager.waitingForTermination = false;
+    // Send notification 0x100 wave by wave. The first one, with the application, gets the whole timeout like
+    // on official pm, where every process is notified at once; each of the next ones gets an equal share of
+    // what remains (unused time goes to the next waves), so that a hung system module doesn't leave nothing
+    // for the ones it depends on. Each process is terminated once it exceeds the deadline of its wave.
+    for (u32 wave = 0; wave < numWaves; wave++) {
+        u64 deadline = dstTimePoint;
+        if (wave > 0 && dstTimePoint != TERMINATION_DEADLINE_NONE) {
+            s64 timeoutTicks = dstTimePoint - svcGetSystemTick();
+            deadline = svcGetSystemTick() + (timeoutTicks >= 0 ? timeoutTicks / (numWaves - wave) : 0LL);
+        }
+
+        ShutdownTrace_BeginWave();
+        assertSuccess(svcClearEvent(g_manager.allNotifiedTerminationEvent));
+        g_manager.waitingForTermination = true;
+
+        ProcessList_Lock(&g_manager.processList);
+        for (u32 i = 0; i < numTargets; i++) {
+            process = ProcessList_FindProcessById(&g_manager.processList, terminationTargets[i].pid);
+            if (terminationTargets[i].wave == wave && process != NULL && process->terminationStatus == TERMSTATUS_RUNNING) {
+                sendTerminationNotification(process, deadline, false);
+            }
+        }
+        ProcessList_Unlock(&g_manager.processList);
+
+        commitPendingTerminations(deadline);
+        g_manager.waitingForTermination = false;
+    }
 
     if (callerPid == (u32)-1) {
         // On firmlaunch, try to force Process9 to mount the SD card to allow the Process9 firmlaunch patch to load boot.firm if needed
@@ -342,21 +478,26 @@ ProcessData *terminateAllProcesses(u32 callerPid, s64 timeout)
     }
 
     // Now, send termination notification to PXI (PID 4). Also do the same for Rosalina.
+    // Allow 1.5 extra seconds for PXI and Rosalina (approx 402167783 ticks)
+    s64 timeoutTicks = dstTimePoint - svcGetSystemTick();
+    s64 finalTimeout = timeout < 0 ? -1LL : 1500 * 1000 * 1000LL + (timeoutTicks >= 0 ? ticksToNs(timeoutTicks) : 0LL);
+    u64 deadline = timeoutToDeadline(finalTimeout);
+
+    ShutdownTrace_BeginWave();
     assertSuccess(svcClearEvent(g_manager.allNotifiedTerminationEvent));
     g_manager.waitingForTermination = true;
     ProcessList_Lock(&g_manager.processList);
 
     if (numKips >= 6) {
-        terminateProcessByIdChecked(5); // Rosalina
+        terminateProcessByIdChecked(5, deadline); // Rosalina
     }
-    terminateProcessByIdChecked(4); // PXI
+    terminateProcessByIdChecked(4, deadline); // PXI
 
     ProcessList_Unlock(&g_manager.processList);
 
-    // Allow 1.5 extra seconds for PXI and Rosalina (approx 402167783 ticks)
-    timeoutTicks = dstTimePoint - svcGetSystemTick();
-    commitPendingTerminations(1500 * 1000 * 1000LL + (timeoutTicks >= 0 ? ticksToNs(timeoutTicks) : 0LL));
+    commitPendingTerminations(deadline);
     g_manager.waitingForTermination = false;
+    ShutdownTrace_End();
 
     return callerProcess;
 }
@@ -403,6 +544,7 @@ static void ChainloadHomebrewDirtyAsync(void *argdata)
         panic(0);
     }
 
+    ShutdownTrace_Begin(SHUTDOWNREASON_CHAINLOAD_HOMEBREW, (u32)-1);
     assertSuccess(svcClearEvent(g_manager.allNotifiedTerminationEvent));
     g_manager.waitingForTermination = true;
 
@@ -428,6 +570,7 @@ static void ChainloadHomebrewDirtyAsync(void *argdata)
     res = commitPendingTerminations(3 * 1000 * 1000 * 1000LL); // 3s, what NS is using
     ExHeaderInfoHeap_Delete(exheaderInfo);
     g_manager.waitingForTermination = false;
+    ShutdownTrace_End();
 
     if (app == NULL) {
         res = MAKERESULT(RL_TEMPORARY, RS_NOTFOUND, RM_PM, 0x100);
@@ -0,0 +1,589 @@
+/*
+*   This file is part of Luma3DS.
+*   Copyright (C) 2016-2020 Aurora Wright, TuxSH
+*
+*   SPDX-License-Identifier: (MIT OR GPL-2.0-or-later)
+*/
+
+/* Checks the GDB agent expressions (agent.c): bytecode the verifier must reject, the result of each opcode, and
+   random bytecode, verified then evaluated right before a guard page so that any read past its end crashes. Then
+   the breakpoint conditions of Z0 packets (stop_point.c, breakpoints.c) against the simulated process of gdbsim.c:
+   hits reported or stepped over depending on the conditions, several conditions, replaced and removed conditions,
+   and the packets rejected.
+
+   Exits with status 1 if anything doesn't match.
+*/
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#include "gdbsim.h"
+#include "gdb/agent.h"
+#include "gdb/breakpoints.h"
+
+#define CODE        (GDBSIM_MEMORY_BASE + 0x1000)
+#define NOP         0xE1A00000
+
+#define MEM_BASE    0x1000
+#define NUM_FUZZ    200000
+
+static bool failed;
+
+static GDBServer server;
+static GDBContext *ctx = &server.ctxs[0];
+
+static void expect(const char *name, bool ok)
+{
+    if (!ok)
+    {
+        printf("    %s: FAILED\n", name);
+        failed = true;
+    }
+}
+
+static u32 decodeHex(u8 *out, const char *hex)
+{
+    u32 n = 0;
+    for (; hex[0] != 0 && hex[1] != 0; hex += 2)
+    {
+        unsigned int byte;
+        sscanf(hex, "%2x", &byte);
+        out[n++] = (u8)byte;
+    }
+
+    return n;
+}
+
+/* Agent callbacks: r0-r15 hold n * 0x1111, the memory is 8 bytes at MEM_BASE, there are 4 trace state variables */
+
+static const u8 memory[8] = { 1, 2, 3, 4, 5, 6, 7, 8 };
+static s64 variables[4];
+static u32 numCollected, collectedAddress, collectedSize;
+static bool outOfBounds;
+
+static bool readRegister(void *userdata, u64 *out, u32 gdbRegNum)
+{
+    (void)userdata;
+    *out = gdbRegNum * 0x1111;
+    return gdbRegNum < 16;
+}
+
+static bool readMemory(void *userdata, void *out, u32 address, u32 size)
+{
+    (void)userdata;
+    if (size > 8 || (u64)address + size - 1 > 0xFFFFFFFF)
+        outOfBounds = true;
+    if (address < MEM_BASE || address - MEM_BASE + size > sizeof(memory))
+        return false;
+
+    memcpy(out, memory + (address - MEM_BASE), size);
+    return true;
+}
+
+static bool getVariable(void *userdata, s64 *out, u32 id)
+{
+    (void)userdata;
+    if (id >= 4)
+        return false;
+
+    *out = variables[id];
+    return true;
+}
+
+static bool setVariable(void *userdata, u32 id, s64 value)
+{
+    (void)userdata;
+    if (id >= 4)
+        return false;
+
+    variables[id] = value;
+    return true;
+}
+
+static bool collectMemory(void *userdata, u32 address, u32 size, bool stopAtZero)
+{
+    (void)userdata; (void)stopAtZero;
+    numCollected++;
+    collectedAddress = address;
+    collectedSize = size;
+    return true;
+}
+
+static bool collectVariable(void *userdata, u32 id)
+{
+    (void)userdata;
+    numCollected++;
+    return id < 4;
+}
+
+static const GDBAgentOps ops = { readRegister, readMemory, getVariable, setVariable, collectMemory, collectVariable };
+static const GDBAgentOps noTraceOps = { readRegister, readMemory, NULL, NULL, NULL, NULL };
+
+static int verify(const char *hex)
+{
+    u8 bytecode[GDB_AGENT_MAX_BYTECODE_SIZE];
+    return GDB_AgentVerify(bytecode, decodeHex(bytecode, hex));
+}
+
+static int evaluate(s64 *result, const char *hex, const GDBAgentOps *agentOps)
+{
+    u8 bytecode[GDB_AGENT_MAX_BYTECODE_SIZE];
+    u32 size = decodeHex(bytecode, hex);
+    int res = GDB_AgentVerify(bytecode, size);
+
+    *result = 0x7E57;
+    return res != 0 ? res : GDB_AgentEvaluate(result, bytecode, size, agentOps, NULL);
+}
+
+static void testVerifier(void)
+{
+    static const struct
+    {
+        const char *name, *hex;
+        int res;
+    } cases[] =
+    {
+        { "end only",               "27",                       0 },
+        { "bad opcode 0",           "00",                       -EINVAL },
+        { "bad opcode 0x31",        "2201312027",               -EINVAL },
+        { "bad opcode 0x35",        "35",                       -EINVAL },
+        { "bad opcode 0xff",        "ff27",                     -EINVAL },
+        { "float",                  "0127",                     -ENOTSUP },
+        { "ref_float",              "2201 1b27",                -ENOTSUP },
+        { "printf",                 "3427",                     -ENOTSUP },
+        { "add, empty stack",       "0227",                     -EINVAL },
+        { "add, one item",          "2201 02 27",               -EINVAL },
+        { "pop, empty stack",       "2927",                     -EINVAL },
+        { "pick past the bottom",   "2201 3201 27",             -EINVAL },
+        { "rot, two items",         "2201 2202 33 27",          -EINVAL },
+        { "trace, one item",        "2201 0c 27",               -EINVAL },
+        { "stack growing in loop",  "2201 210000",              -EINVAL },
+        { "goto past the end",      "210010 27",                -EINVAL },
+        { "goto to the end",        "2201 200006 27",           -EINVAL },
+        { "goto into an operand",   "231234 210001 27",         -EINVAL },
+        { "heights differ at merge", "2201 200007 2202 27",     -EINVAL },
+        { "truncated const32",      "24123456",                 -EINVAL },
+        { "truncated const16",      "2312",                     -EINVAL },
+        { "truncated goto",         "2100",                     -EINVAL },
+        { "truncated reg",          "26",                       -EINVAL },
+        { "ext 0",                  "2201 1600 27",             -EINVAL },
+        { "no end",                 "2201",                     -EINVAL },
+        { "falls off the end",      "2201 2202 02",             -EINVAL },
+        { "unreachable junk",       "210004 ff 27",             -EINVAL }, // decoded linearly first
+    };
+    u8 bytecode[GDB_AGENT_MAX_BYTECODE_SIZE + 1];
+
+    printf("Verifier:\n");
+
+    for (u32 i = 0; i < sizeof(cases) / sizeof(cases[0]); i++)
+    {
+        char hex[128];
+        u32 n = 0;
+        for (const char *c = cases[i].hex; *c != 0; c++)
+            if (*c != ' ')
+                hex[n++] = *c;
+        hex[n] = 0;
+        expect(cases[i].name, verify(hex) == cases[i].res);
+    }
+
+    expect("empty", GDB_AgentVerify(bytecode, 0) == -EINVAL);
+
+    memset(bytecode, GDB_AGENT_OP_END, sizeof(bytecode));
+    expect("largest", GDB_AgentVerify(bytecode, GDB_AGENT_MAX_BYTECODE_SIZE) == 0);
+    expect("too large", GDB_AgentVerify(bytecode, GDB_AGENT_MAX_BYTECODE_SIZE + 1) == -EINVAL);
+
+    // GDB_AGENT_MAX_STACK_SIZE items, then one too many
+    for (u32 i = 0; i <= GDB_AGENT_MAX_STACK_SIZE; i++)
+    {
+        bytecode[2 * i] = GDB_AGENT_OP_CONST8;
+        bytecode[2 * i + 1] = (u8)i;
+    }
+    bytecode[2 * GDB_AGENT_MAX_STACK_SIZE] = GDB_AGENT_OP_END;
+    expect("full stack", GDB_AgentVerify(bytecode, 2 * GDB_AGENT_MAX_STACK_SIZE + 1) == 0);
+    bytecode[2 * GDB_AGENT_MAX_STACK_SIZE] = GDB_AGENT_OP_CONST8;
+    bytecode[2 * GDB_AGENT_MAX_STACK_SIZE + 2] = GDB_AGENT_OP_END;
+    expect("stack overflow", GDB_AgentVerify(bytecode, 2 * GDB_AGENT_MAX_STACK_SIZE + 3) == -EINVAL);
+}
+
+static void testOpcodes(void)
+{
+    static const struct
+    {
+        const char *name, *hex;
+        int res;
+        s64 value;
+    } cases[] =
+    {
+        { "add",            "2205220302" "27",                          0, 8 },
+        { "sub",            "2205220303" "27",                          0, 2 },
+        { "mul",            "2205220304" "27",                          0, 15 },
+        { "div_signed",     "25fffffffffffffff9" "220205" "27",         0, -3 },
+        { "rem_signed",     "25fffffffffffffff9" "220207" "27",         0, -1 },
+        { "div_unsigned",   "2207220206" "27",                          0, 3 },
+        { "rem_unsigned",   "2207220208" "27",                          0, 1 },
+        { "div by 0",       "2207220005" "27",                          -EDOM, 0x7E57 },
+        { "rem by 0",       "2207220008" "27",                          -EDOM, 0x7E57 },
+        { "INT64_MIN / -1", "258000000000000000" "25ffffffffffffffff05" "27", 0, INT64_MIN },
+        { "INT64_MIN % -1", "258000000000000000" "25ffffffffffffffff07" "27", 0, 0 },
+        { "lsh",            "2201223f09" "27",                          0, INT64_MIN },
+        { "lsh 64",         "2201224009" "27",                          0, 0 },
+        { "rsh_signed",     "25fffffffffffffff8" "22010a" "27",         0, -4 },
+        { "rsh_signed 100", "25fffffffffffffff8" "22640a" "27",         0, -1 },
+        { "rsh_unsigned",   "25fffffffffffffff8" "22010b" "27",         0, 0x7FFFFFFFFFFFFFFC },
+        { "log_not 0",      "22000e" "27",                              0, 1 },
+        { "log_not 5",      "22050e" "27",                              0, 0 },
+        { "bit_and",        "220c220a0f" "27",                          0, 8 },
+        { "bit_or",         "220c220a10" "27",                          0, 14 },
+        { "bit_xor",        "220c220a11" "27",                          0, 6 },
+        { "bit_not",        "220012" "27",                              0, -1 },
+        { "equal",          "2205220513" "27",                          0, 1 },
+        { "not equal",      "2205220613" "27",                          0, 0 },
+        { "less_signed",    "25ffffffffffffffff220014" "27",            0, 1 },
+        { "less_unsigned",  "25ffffffffffffffff220015" "27",            0, 0 },
+        { "ext 8",          "22801608" "27",                            0, -128 },
+        { "ext 64",         "22801640" "27",                            0, 128 },
+        { "zero_ext 8",     "2301ff2a08" "27",                          0, 0xFF },
+        { "const16",        "231234" "27",                              0, 0x1234 },
+        { "const32",        "2412345678" "27",                          0, 0x12345678 },
+        { "const64",        "250123456789abcdef" "27",                  0, 0x0123456789ABCDEF },
+        { "reg",            "260003" "27",                              0, 0x3333 },
+        { "reg, bad",       "260063" "27",                              -EFAULT, 0x7E57 },
+        { "ref8",           "23100017" "27",                            0, 0x01 },
+        { "ref16",          "23100118" "27",                            0, 0x0302 },
+        { "ref32",          "23100019" "27",                            0, 0x04030201 },
+        { "ref64",          "2310001a" "27",                            0, 0x0807060504030201 },
+        { "ref, unmapped",  "23000019" "27",                            -EFAULT, 0x7E57 },
+        { "ref, wrapping",  "24ffffffff19" "27",                        -EFAULT, 0x7E57 },
+        { "ref, above 4G",  "25000000010000100017" "27",                -EFAULT, 0x7E57 },
+        { "goto",           "210005" "2201" "2202" "27",                0, 2 },
+        { "if_goto taken",  "260001" "20000b" "220a" "21000d" "2214" "27", 0, 20 },
+        { "if_goto not",    "260000" "20000b" "220a" "21000d" "2214" "27", 0, 10 },
+        { "dup",            "22052802" "27",                            0, 10 },
+        { "pop",            "2205220629" "27",                          0, 5 },
+        { "swap",           "220522062b03" "27",                        0, 1 },
+        { "pick",           "220522063201" "27",                        0, 5 },
+        { "rot, top",       "22012202220333" "27",                      0, 2 },
+        { "rot, middle",    "2201220222033329" "27",                    0, 1 },
+        { "rot, bottom",    "220122022203332929" "27",                  0, 3 },
+        { "empty stack",    "27",                                       0, 0 },
+        { "countdown loop", "220a" "28" "0e" "20000d" "2201" "03" "210002" "27", 0, 0 },
+        { "endless loop",   "2200" "2201" "02" "210002",                -ETIMEDOUT, 0x7E57 },
+        { "getv",           "2c0001" "27",                              0, 42 },
+        { "getv, bad",      "2c0063" "27",                              -EFAULT, 0x7E57 },
+        { "setv",           "22072d0002" "27",                          0, 7 },
+        { "trace_quick",    "2310000d04" "27",                          0, 0x1000 },
+        { "trace16",        "231000300010" "27",                        0, 0x1000 },
+        { "tracev",         "2e0001" "27",                              0, 0 },
+    };
+
+    printf("Opcodes:\n");
+
+    variables[1] = 42;
+    for (u32 i = 0; i < sizeof(cases) / sizeof(cases[0]); i++)
+    {
+        s64 result;
+        int res = evaluate(&result, cases[i].hex, &ops);
+        if (res != cases[i].res || result != cases[i].value)
+        {
+            printf("    %s: got %d, %lld instead of %d, %lld: FAILED\n", cases[i].name, res, (long long)result, cases[i].res,
+                   (long long)cases[i].value);
+            failed = true;
+        }
+    }
+    expect("setv stored", variables[2] == 7);
+
+    s64 result;
+    numCollected = 0;
+    expect("trace", evaluate(&result, "2310002204" "0c" "27", &ops) == 0 && result == 0 && numCollected == 1 &&
+           collectedAddress == 0x1000 && collectedSize == 4);
+    expect("tracenz", evaluate(&result, "2310002208" "2f" "27", &ops) == 0 && numCollected == 2 && collectedSize == 8);
+    expect("trace16 collected", evaluate(&result, "231000300010" "27", &ops) == 0 && numCollected == 3 && collectedSize == 0x10);
+
+    // Callbacks left NULL
+    expect("getv without trace state", evaluate(&result, "2c0001" "27", &noTraceOps) == -ENOTSUP);
+    expect("setv without trace state", evaluate(&result, "22012d0001" "27", &noTraceOps) == -ENOTSUP);
+    expect("trace without trace state", evaluate(&result, "2310002204" "0c" "27", &noTraceOps) == -ENOTSUP);
+    expect("tracev without trace state", evaluate(&result, "2e0001" "27", &noTraceOps) == -ENOTSUP);
+}
+
+// Bytecode made of supported instructions keeping the stack in bounds, with random operands and jumps to instructions
+// where the stack had the same height, sometimes with a byte changed or only random bytes
+static u32 generate(u8 *bytecode)
+{
+    static const struct
+    {
+        u8 op, operandSize, pops, pushes;
+    } instructions[] =
+    {
+        { 0x02, 0, 2, 1 }, { 0x03, 0, 2, 1 }, { 0x04, 0, 2, 1 }, { 0x05, 0, 2, 1 }, { 0x06, 0, 2, 1 }, { 0x07, 0, 2, 1 },
+        { 0x08, 0, 2, 1 }, { 0x09, 0, 2, 1 }, { 0x0A, 0, 2, 1 }, { 0x0B, 0, 2, 1 }, { 0x0C, 0, 2, 0 }, { 0x0D, 1, 1, 1 },
+        { 0x0E, 0, 1, 1 }, { 0x0F, 0, 2, 1 }, { 0x10, 0, 2, 1 }, { 0x11, 0, 2, 1 }, { 0x12, 0, 1, 1 }, { 0x13, 0, 2, 1 },
+        { 0x14, 0, 2, 1 }, { 0x15, 0, 2, 1 }, { 0x16, 1, 1, 1 }, { 0x17, 0, 1, 1 }, { 0x18, 0, 1, 1 }, { 0x19, 0, 1, 1 },
+        { 0x1A, 0, 1, 1 }, { 0x20, 2, 1, 0 }, { 0x21, 2, 0, 0 }, { 0x22, 1, 0, 1 }, { 0x23, 2, 0, 1 }, { 0x24, 4, 0, 1 },
+        { 0x25, 8, 0, 1 }, { 0x26, 2, 0, 1 }, { 0x28, 0, 1, 2 }, { 0x29, 0, 1, 0 }, { 0x2A, 1, 1, 1 }, { 0x2B, 0, 2, 2 },
+        { 0x2C, 2, 0, 1 }, { 0x2D, 2, 1, 1 }, { 0x2E, 2, 0, 0 }, { 0x2F, 0, 2, 0 }, { 0x30, 2, 1, 1 }, { 0x32, 1, 0, 1 },
+        { 0x33, 0, 3, 3 },
+    };
+    u32 maxSize = 1 + rand() % GDB_AGENT_MAX_BYTECODE_SIZE, size = 0, height = 0;
+    s8 heights[GDB_AGENT_MAX_BYTECODE_SIZE];
+    u32 jumps[GDB_AGENT_MAX_BYTECODE_SIZE], numJumps = 0;
+
+    if (rand() % 8 == 0)
+    {
+        for (; size < maxSize; size++)
+            bytecode[size] = (u8)rand();
+        return size;
+    }
+
+    memset(heights, -1, sizeof(heights));
+    for (;;)
+    {
+        u32 i = rand() % (sizeof(instructions) / sizeof(instructions[0]));
+        u32 pops = instructions[i].op == 0x32 ? 1 : instructions[i].pops; // pick 0 at least
+        if (height < pops || height + instructions[i].pushes - instructions[i].pops > GDB_AGENT_MAX_STACK_SIZE)
+            continue;
+        else if (size + 1 + instructions[i].operandSize + 1 > maxSize)
+            break;
+
+        heights[size] = (s8)height;
+        bytecode[size] = instructions[i].op;
+        for (u32 j = 1; j <= instructions[i].operandSize; j++)
+            bytecode[size + j] = rand() % 4 == 0 ? (u8)rand() : (u8)(rand() % 8);
+
+        // Small operands mostly: pick depth, sign extension width, register and variable numbers
+        if (instructions[i].op == 0x32)
+            bytecode[size + 1] = (u8)(rand() % height);
+        else if (instructions[i].op == 0x16)
+            bytecode[size + 1] = (u8)(1 + rand() % 64);
+        else if (instructions[i].op == 0x20 || instructions[i].op == 0x21)
+            jumps[numJumps++] = size;
+
+        height += instructions[i].pushes - instructions[i].pops;
+        size += 1 + instructions[i].operandSize;
+    }
+
+    heights[size] = (s8)height;
+    bytecode[size++] = GDB_AGENT_OP_END;
+
+    for (u32 i = 0; i < numJumps; i++)
+    {
+        u32 pc = jumps[i], target = rand() % size, height = heights[pc] - (bytecode[pc] == GDB_AGENT_OP_IF_GOTO);
+        for (u32 j = 0; j < size && (heights[target] != (s8)height || target == pc); j++)
+            target = (target + 1) % size;
+
+        target = rand() % 8 == 0 ? (u32)rand() % (size + 2) : target;
+        bytecode[pc + 1] = (u8)(target >> 8);
+        bytecode[pc + 2] = (u8)target;
+    }
+
+    if (rand() % 4 == 0)
+        bytecode[rand() % size] = (u8)rand();
+
+    return size;
+}
+
+static void testFuzz(void)
+{
+    long pageSize = sysconf(_SC_PAGESIZE);
+    u32 numVerified = 0, numEvaluated = 0;
+    bool resultsOk = true;
+
+    printf("Random bytecode:\n");
+
+    // The bytecode ends right before a page that can't be read
+    u8 *pages = mmap(NULL, 2 * pageSize, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (pages == MAP_FAILED || mprotect(pages + pageSize, pageSize, PROT_NONE) != 0)
+    {
+        printf("    guard page: FAILED\n");
+        failed = true;
+        return;
+    }
+
+    srand(0x4147);
+    outOfBounds = false;
+    for (u32 i = 0; i < NUM_FUZZ; i++)
+    {
+        u8 program[GDB_AGENT_MAX_BYTECODE_SIZE];
+        u32 size = generate(program);
+        u8 *bytecode = pages + pageSize - size;
+        s64 result;
+
+        memcpy(bytecode, program, size);
+        if (GDB_AgentVerify(bytecode, size) != 0)
+            continue;
+
+        numVerified++;
+        int res = GDB_AgentEvaluate(&result, bytecode, size, &ops, NULL);
+        numEvaluated += res == 0;
+        resultsOk = resultsOk && (res == 0 || res == -EDOM || res == -EFAULT || res == -ETIMEDOUT);
+    }
+
+    munmap(pages, 2 * pageSize);
+
+    printf("    %u programs, %u verified, %u evaluated to the end\n", NUM_FUZZ, numVerified, numEvaluated);
+    expect("enough verified", numVerified > NUM_FUZZ / 20 && numEvaluated > NUM_FUZZ / 50);
+    expect("evaluation results", resultsOk);
+    expect("memory accesses", !outOfBounds);
+}
+
+/* Breakpoint conditions */
+
+// r0 == 5, r1 == 7, r0 == 9 and *(u32 *)0 (which can't be evaluated)
+#define COND_R0_5   "X7,26000022051327"
+#define COND_R1_7   "X7,26000122071327"
+#define COND_R0_9   "X7,26000022091327"
+#define COND_FAULT  "X7,24000000001927"
+
+static void expectReply(const char *packet, const char *expected)
+{
+    const char *reply = GDBSim_Command(ctx, packet);
+    if (reply == NULL || strcmp(reply, expected) != 0)
+    {
+        printf("    %s: got \"%s\" instead of \"%s\"\n", packet, reply != NULL ? reply : "(nothing)", expected);
+        failed = true;
+    }
+}
+
+static void setBreakpoint(const char *expected, u32 address, const char *conditions)
+{
+    char packet[GDB_BUF_LEN];
+    sprintf(packet, "Z0,%x,4%s", address, conditions);
+    expectReply(packet, expected);
+}
+
+static const char *errnoReply(int no)
+{
+    static char buf[4];
+    sprintf(buf, "E%02x", (u8)no);
+    return buf;
+}
+
+static void removeBreakpoint(u32 address)
+{
+    char packet[32];
+    sprintf(packet, "z0,%x,4", address);
+    expectReply(packet, "OK");
+}
+
+static void setRegisters(u32 threadId, u32 r0, u32 r1)
+{
+    gdbSim.threads[threadId].cpu_registers.r[0] = r0;
+    gdbSim.threads[threadId].cpu_registers.r[1] = r1;
+}
+
+// Reported to GDB, which then continues
+static bool reported(u32 threadId, u32 pc)
+{
+    char prefix[16];
+    sprintf(prefix, "T05thread:%x;", threadId);
+
+    bool ok = GDBSim_HitBreakpoint(ctx, threadId, pc) >= 0;
+    const char *reply = GDBSim_TakeReply();
+    ok = ok && reply != NULL && strncmp(reply, prefix, strlen(prefix)) == 0;
+    return GDBSim_Command(ctx, "c") == NULL && ok;
+}
+
+// Resumed without telling GDB: conditions all false, or end of a step-over
+static bool hitSilently(u32 threadId, u32 pc)
+{
+    return GDBSim_HitBreakpoint(ctx, threadId, pc) == -3 && GDBSim_TakeReply() == NULL;
+}
+
+// Conditions all false, then the step-over to the next instruction
+static bool steppedOver(u32 threadId, u32 pc)
+{
+    bool ok = hitSilently(threadId, pc) && ctx->stepOver.threadId == threadId;
+    return hitSilently(threadId, pc + 4) && ctx->stepOver.threadId == 0 && ok;
+}
+
+static void testConditions(void)
+{
+    printf("Breakpoint conditions:\n");
+
+    GDBSim_Attach(&server, ctx, 3);
+    for (u32 addr = CODE; addr < CODE + 0x100; addr += 4)
+        GDBSim_Write32(addr, NOP);
+    expectReply("QStartNoAckMode", "OK");
+
+    setBreakpoint("OK", CODE, ";" COND_R0_5);
+    expect("stored", ctx->breakpointConditionsSize == 2 + 7);
+    GDBSim_Command(ctx, "c");
+
+    setRegisters(1, 0, 0);
+    expect("false: hit", hitSilently(1, CODE) && ctx->stepOver.threadId == 1);
+
+    // The original instruction is back for the step-over, for every thread (see GDB_StartStepOver): another
+    // thread can only be held on the temporary breakpoint
+    expect("disarmed while stepping over", GDBSim_Read32(CODE) == NOP && GDBSim_Read32(CODE + 4) == BREAKPOINT_INSTRUCTION_ARM);
+    expect("other thread held", hitSilently(2, CODE + 4) && ctx->stepOver.threadId == 1);
+    expect("false: step-over done", hitSilently(1, CODE + 4) && ctx->stepOver.threadId == 0);
+    expect("armed again", GDBSim_Read32(CODE) == BREAKPOINT_INSTRUCTION_ARM && GDBSim_Read32(CODE + 4) == NOP);
+
+    setRegisters(2, 5, 0);
+    expect("true", reported(2, CODE));
+
+    // Any true condition
+    setBreakpoint("OK", CODE, ";" COND_R0_5 ";" COND_R1_7);
+    expect("replaced", ctx->breakpointConditionsSize == 2 * (2 + 7));
+    setRegisters(3, 0, 7);
+    expect("second true", reported(3, CODE));
+    setRegisters(3, 0, 0);
+    expect("both false", steppedOver(3, CODE));
+
+    // GDB sends all the conditions again when they change
+    setBreakpoint("OK", CODE, ";" COND_R0_9);
+    expect("replaced again", ctx->breakpointConditionsSize == 2 + 7);
+    setRegisters(2, 5, 0);
+    expect("old condition gone", steppedOver(2, CODE));
+    setRegisters(2, 9, 0);
+    expect("new condition", reported(2, CODE));
+
+    // Conditions that can't be evaluated are true, like in gdbserver
+    setBreakpoint("OK", CODE, ";" COND_FAULT);
+    expect("evaluation error", reported(1, CODE));
+
+    setBreakpoint("OK", CODE, "");
+    expect("unconditional", ctx->breakpointConditionsSize == 0 && reported(1, CODE));
+
+    // Rejected, the breakpoint being left as it was
+    setBreakpoint(errnoReply(ENOTSUP), CODE + 8, ";X2,0127");
+    setBreakpoint(errnoReply(EINVAL), CODE + 8, ";X1,00");
+    setBreakpoint(errnoReply(EINVAL), CODE + 8, ";X3,220102");
+    setBreakpoint(errnoReply(EILSEQ), CODE + 8, ";X4,27");
+    setBreakpoint(errnoReply(EILSEQ), CODE + 8, ";X4");
+    setBreakpoint(errnoReply(ENOSPC), CODE + 8, ";X101,27");
+    setBreakpoint(errnoReply(EINVAL), CODE, ";X1,00");
+    expect("not added", ctx->nbBreakpoints == 1 && GDBSim_Read32(CODE + 8) == NOP && ctx->breakpointConditionsSize == 0);
+
+    // Removing a breakpoint moves the conditions of the next ones
+    setBreakpoint("OK", CODE + 0x20, ";" COND_R1_7);
+    setBreakpoint("OK", CODE + 0x40, ";" COND_R0_5);
+    setBreakpoint("OK", CODE, ";" COND_R0_9);
+    removeBreakpoint(CODE + 0x20);
+    expect("removed", ctx->nbBreakpoints == 2 && ctx->breakpointConditionsSize == 2 * (2 + 7));
+    setRegisters(3, 5, 7);
+    expect("moved", reported(3, CODE + 0x40));
+    expect("kept", steppedOver(3, CODE));
+
+    removeBreakpoint(CODE);
+    removeBreakpoint(CODE + 0x40);
+    expect("all removed", ctx->nbBreakpoints == 0 && ctx->breakpointConditionsSize == 0 && GDBSim_Read32(CODE) == NOP);
+
+    GDBSim_Detach(ctx);
+    expect("well-formed packets", GDBSim_NumBadPackets() == 0);
+}
+
+int main(void)
+{
+    GDB_InitializeServer(&server);
+
+    testVerifier();
+    testOpcodes();
+    testFuzz();
+    testConditions();
+
+    printf(failed ? "FAILED\n" : "ok\n");
+    return failed ? 1 : 0;
+}
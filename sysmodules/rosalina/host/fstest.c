@@ -0,0 +1,260 @@
+/*
+*   This file is part of Luma3DS.
+*   Copyright (C) 2016-2022 Aurora Wright, TuxSH
+*
+*   SPDX-License-Identifier: (MIT OR GPL-2.0-or-later)
+*/
+
+/* Checks the frame pacing statistics (frame_stats.c) against synthetic swap timestamps: steady and halved frame
+   rates with polling jitter, 2/1 VBlank judder, hitches, pauses, window wrap-around and out-of-order timestamps.
+   The 1% and 0.1% lows are also compared with a sort-based reference.
+
+   Exits with status 1 if anything doesn't match.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include "frame_stats.h"
+
+#define VBLANK_PERIOD_US    16713
+
+static FrameStats stats;
+static bool failed;
+
+static void expect(const char *name, bool ok)
+{
+    if (!ok)
+    {
+        printf("    %s: FAILED\n", name);
+        failed = true;
+    }
+}
+
+static void expectNear(const char *name, u32 value, u32 expected, u32 tolerance)
+{
+    if ((value > expected ? value - expected : expected - value) > tolerance)
+    {
+        printf("    %s: FAILED, %u instead of %u (+/- %u)\n", name, value, expected, tolerance);
+        failed = true;
+    }
+}
+
+static int compareDescending(const void *a, const void *b)
+{
+    u32 x = *(const u32 *)a, y = *(const u32 *)b;
+    return x < y ? 1 : x > y ? -1 : 0;
+}
+
+static u32 referenceLowFpsX100(u32 numLow)
+{
+    u32 sorted[FRAMESTATS_WINDOW_SIZE];
+    u64 sum = 0;
+
+    for (u32 i = 0; i < stats.windowCount; i++)
+        sorted[i] = stats.frameTimes[(stats.windowHead + i) % FRAMESTATS_WINDOW_SIZE];
+    qsort(sorted, stats.windowCount, sizeof(u32), compareDescending);
+
+    for (u32 i = 0; i < numLow; i++)
+        sum += sorted[i];
+    return sum == 0 ? 0 : (u32)(100000000ULL * numLow / sum);
+}
+
+static void checkCommon(FrameStatsSummary *summary)
+{
+    u32 n = stats.windowCount, histogramSum = 0, vblankSum = 0;
+    u64 windowSum = 0;
+
+    FrameStats_GetSummary(&stats, summary);
+
+    for (u32 i = 0; i < n; i++)
+        windowSum += stats.frameTimes[(stats.windowHead + i) % FRAMESTATS_WINDOW_SIZE];
+    for (u32 i = 0; i < FRAMESTATS_HISTOGRAM_BINS; i++)
+        histogramSum += stats.histogram[i];
+    for (u32 i = 0; i <= FRAMESTATS_MAX_VBLANKS; i++)
+        vblankSum += stats.vblankHistogram[i];
+
+    expect("window sum", windowSum == stats.windowSumUs);
+    expect("histogram total", histogramSum == stats.numFrames);
+    expect("VBlank histogram total", vblankSum == stats.numFrames);
+    if (n != 0)
+    {
+        expect("1% low matches the reference", summary->low1FpsX100 == referenceLowFpsX100(n / 100 > 1 ? n / 100 : 1));
+        expect("0.1% low matches the reference", summary->low01FpsX100 == referenceLowFpsX100(n / 1000 > 1 ? n / 1000 : 1));
+        expect("lows ordered", summary->low01FpsX100 <= summary->low1FpsX100 && summary->low1FpsX100 <= summary->fpsX100);
+    }
+
+    printf("    %u frames: %u.%02u fps, 1%% low %u.%02u, 0.1%% low %u.%02u, avg %u us, max %u us, jitter %u us\n",
+           summary->numFrames, summary->fpsX100 / 100, summary->fpsX100 % 100, summary->low1FpsX100 / 100, summary->low1FpsX100 % 100,
+           summary->low01FpsX100 / 100, summary->low01FpsX100 % 100, summary->avgFrameUs, summary->maxFrameUs, summary->jitterUs);
+}
+
+// Swaps every vblanks[i % numPattern] VBlanks, timestamped by a poller with up to +/- jitterUs of error
+static u64 feed(u64 timeUs, u32 numFrames, const u32 *pattern, u32 numPattern, u32 jitterUs)
+{
+    for (u32 i = 0; i < numFrames; i++)
+    {
+        timeUs += (u64)pattern[i % numPattern] * VBLANK_PERIOD_US;
+        s32 error = jitterUs == 0 ? 0 : (s32)(rand() % (2 * jitterUs + 1)) - (s32)jitterUs;
+        FrameStats_AddSwap(&stats, timeUs + error);
+    }
+
+    return timeUs;
+}
+
+static void steady60(void)
+{
+    static const u32 pattern[] = { 1 };
+    FrameStatsSummary summary;
+
+    printf("steady 60 fps with polling jitter\n");
+    FrameStats_Init(&stats, VBLANK_PERIOD_US);
+    feed(1000000, 601, pattern, 1, 500);
+    checkCommon(&summary);
+
+    expect("first swap only starts a frame", stats.numFrames == 600);
+    expectNear("fps", summary.fpsX100, 5983, 5);
+    expectNear("1% low, slowed by the polling error", summary.low1FpsX100, 5983, 400);
+    expect("all frames are 1 VBlank", stats.vblankHistogram[1] == 600);
+    expect("jitter within the polling error", summary.jitterUs <= 1000);
+}
+
+static void steady30(void)
+{
+    static const u32 pattern[] = { 2 };
+    FrameStatsSummary summary;
+
+    printf("steady 30 fps\n");
+    FrameStats_Init(&stats, VBLANK_PERIOD_US);
+    feed(0, 301, pattern, 1, 0);
+    checkCommon(&summary);
+
+    expectNear("fps", summary.fpsX100, 2991, 1);
+    expect("1% low equals the average", summary.low1FpsX100 == summary.fpsX100);
+    expect("no jitter", summary.jitterUs == 0);
+    expect("all frames are 2 VBlanks", stats.vblankHistogram[2] == 300);
+    expect("33 ms bin", stats.histogram[33] == 300);
+    expect("min and max", stats.minFrameUs == 2 * VBLANK_PERIOD_US && stats.maxFrameUs == 2 * VBLANK_PERIOD_US);
+}
+
+static void judder(void)
+{
+    static const u32 pattern[] = { 2, 1 };
+    FrameStatsSummary summary;
+
+    printf("2/1 VBlank judder\n");
+    FrameStats_Init(&stats, VBLANK_PERIOD_US);
+    feed(0, 401, pattern, 2, 0);
+    checkCommon(&summary);
+
+    expectNear("fps", summary.fpsX100, 3989, 1);
+    expectNear("1% low", summary.low1FpsX100, 2991, 1);
+    expect("jitter of one VBlank", summary.jitterUs == VBLANK_PERIOD_US);
+    expect("VBlank split", stats.vblankHistogram[1] == 200 && stats.vblankHistogram[2] == 200);
+}
+
+static void hitches(void)
+{
+    u32 pattern[100];
+    FrameStatsSummary summary;
+
+    printf("1%% hitches of 6 VBlanks\n");
+    for (u32 i = 0; i < 100; i++)
+        pattern[i] = i == 50 ? 6 : 1;
+
+    FrameStats_Init(&stats, VBLANK_PERIOD_US);
+    feed(0, 1001, pattern, 100, 0);
+    checkCommon(&summary);
+
+    expectNear("1% low is the hitch rate", summary.low1FpsX100, 997, 1);
+    expectNear("0.1% low", summary.low01FpsX100, 997, 1);
+    expect("max", summary.maxFrameUs == 6 * VBLANK_PERIOD_US);
+    expect("VBlank split", stats.vblankHistogram[1] == 990 && stats.vblankHistogram[6] == 10);
+}
+
+static void pauses(void)
+{
+    static const u32 pattern[] = { 1 };
+    FrameStatsSummary summary;
+
+    printf("pause with a break\n");
+    FrameStats_Init(&stats, VBLANK_PERIOD_US);
+    u64 timeUs = feed(0, 101, pattern, 1, 0);
+    FrameStats_Break(&stats);
+    feed(timeUs + 5000000, 101, pattern, 1, 0);
+    checkCommon(&summary);
+
+    expect("pause not counted", stats.numFrames == 200 && summary.maxFrameUs == VBLANK_PERIOD_US);
+    expect("no jitter", summary.jitterUs == 0);
+}
+
+static void wrap(void)
+{
+    static const u32 slow[] = { 3 }, fast[] = { 1 };
+    FrameStatsSummary summary;
+
+    printf("window wrap-around\n");
+    FrameStats_Init(&stats, VBLANK_PERIOD_US);
+    u64 timeUs = feed(0, 501, slow, 1, 0);
+    feed(timeUs, FRAMESTATS_WINDOW_SIZE + 37, fast, 1, 0);
+    checkCommon(&summary);
+
+    expect("window full", summary.numFrames == FRAMESTATS_WINDOW_SIZE && stats.numFrames == 500 + FRAMESTATS_WINDOW_SIZE + 37);
+    expect("slow frames left the window", summary.maxFrameUs == VBLANK_PERIOD_US && summary.low01FpsX100 == summary.fpsX100);
+    expect("but not the session statistics", stats.maxFrameUs == 3 * VBLANK_PERIOD_US && stats.vblankHistogram[3] == 500);
+}
+
+static void overflow(void)
+{
+    FrameStatsSummary summary;
+
+    printf("histogram overflow bins\n");
+    FrameStats_Init(&stats, VBLANK_PERIOD_US);
+    FrameStats_AddSwap(&stats, 0);
+    FrameStats_AddSwap(&stats, 99999);
+    FrameStats_AddSwap(&stats, 99999 + 100000);
+    FrameStats_AddSwap(&stats, 99999 + 100000 + 10000000);
+    FrameStats_AddSwap(&stats, 99999 + 100000 + 10000000 + 0x200000000ULL);
+    checkCommon(&summary);
+
+    expect("99 ms bin", stats.histogram[99] == 4);
+    expect("longer frames in the last VBlank bin", stats.vblankHistogram[6] == 2 && stats.vblankHistogram[FRAMESTATS_MAX_VBLANKS] == 2);
+    expect("frame time saturated", stats.maxFrameUs == 0xFFFFFFFF);
+}
+
+static void outOfOrder(void)
+{
+    FrameStatsSummary summary;
+
+    printf("non-increasing timestamps\n");
+    FrameStats_Init(&stats, VBLANK_PERIOD_US);
+    FrameStats_AddSwap(&stats, 100000);
+    FrameStats_AddSwap(&stats, 100000);
+    FrameStats_AddSwap(&stats, 90000);
+    FrameStats_AddSwap(&stats, 90000 + VBLANK_PERIOD_US);
+    checkCommon(&summary);
+
+    expect("only the last frame counted", stats.numFrames == 1 && summary.maxFrameUs == VBLANK_PERIOD_US);
+
+    printf("no frames\n");
+    FrameStats_Init(&stats, VBLANK_PERIOD_US);
+    FrameStats_AddSwap(&stats, 100000);
+    checkCommon(&summary);
+    expect("empty summary", summary.numFrames == 0 && summary.fpsX100 == 0 && stats.numFrames == 0);
+}
+
+int main(void)
+{
+    srand(1);
+
+    steady60();
+    steady30();
+    judder();
+    hitches();
+    pauses();
+    wrap();
+    overflow();
+    outOfOrder();
+
+    printf("%s\n", failed ? "FAILED" : "ok");
+    return failed ? 1 : 0;
+}
@@ -0,0 +1,553 @@
+/*
+*   This file is part of Luma3DS.
+*   Copyright (C) 2016-2020 Aurora Wright, TuxSH
+*
+*   SPDX-License-Identifier: (MIT OR GPL-2.0-or-later)
+*/
+
+/* The debug SVCs over the simulated debuggee of gdbsim.h, the parts of the GDB stub that can't be built on the host
+   (mem.c uses ARM assembly, tio.c, xfer.c and remote_command.c need the rest of Rosalina), and the GDB side of the
+   connection. */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include "gdbsim.h"
+#include "gdb/debug.h"
+#include "gdb/net.h"
+#include "gdb/mem.h"
+#include "gdb/tio.h"
+#include "gdb/xfer.h"
+#include "gdb/remote_command.h"
+#include "gdb/tracepoints.h"
+#include "csvc.h"
+#include "ifile.h"
+#include <3ds/services/pmdbg.h>
+
+#define ERR_NO_EVENT        ((Result)0xD8402009)
+#define ERR_INVALID_STATE   ((Result)0xD8A02009)
+#define ERR_INVALID_HANDLE  ((Result)0xD8E007F7)
+#define ERR_INVALID_ADDRESS ((Result)0xE0E01BF5)
+#define ERR_NOT_FOUND       ((Result)0xD88007FA)
+
+#define PROCESS_HANDLE      0x300
+#define THREAD_HANDLE_BASE  0x400
+
+GDBSimState gdbSim;
+
+static int gdbFd = -1;
+static char replies[2][GDB_BUF_LEN + 4];
+static bool hasReply[2];
+static u32 numBadPackets;
+
+/* Debug SVCs */
+
+static bool inMemory(u32 addr, u32 size)
+{
+    return addr >= GDBSIM_MEMORY_BASE && size <= GDBSIM_MEMORY_SIZE && addr - GDBSIM_MEMORY_BASE <= GDBSIM_MEMORY_SIZE - size;
+}
+
+static ThreadContext *getThread(Handle debug, u32 threadId)
+{
+    return debug == GDBSIM_DEBUG_HANDLE && threadId >= 1 && threadId < GDBSIM_MAX_THREADS ? &gdbSim.threads[threadId] : NULL;
+}
+
+Result svcReadProcessMemory(void *buffer, Handle debug, u32 addr, u32 size)
+{
+    if(debug != GDBSIM_DEBUG_HANDLE)
+        return ERR_INVALID_HANDLE;
+    if(!inMemory(addr, size))
+        return ERR_INVALID_ADDRESS;
+
+    memcpy(buffer, gdbSim.memory + (addr - GDBSIM_MEMORY_BASE), size);
+    return 0;
+}
+
+Result svcWriteProcessMemory(Handle debug, const void *buffer, u32 addr, u32 size)
+{
+    if(debug != GDBSIM_DEBUG_HANDLE)
+        return ERR_INVALID_HANDLE;
+    if(!inMemory(addr, size))
+        return ERR_INVALID_ADDRESS;
+
+    memcpy(gdbSim.memory + (addr - GDBSIM_MEMORY_BASE), buffer, size);
+    return 0;
+}
+
+// As with the kernel, the registers can only be accessed while the process is stopped by a debug event
+static bool isBroken(void)
+{
+    return gdbSim.numWaiting != 0 || gdbSim.numEvents != 0;
+}
+
+Result svcGetDebugThreadContext(ThreadContext *context, Handle debug, u32 threadId, ThreadContextControlFlags controlFlags)
+{
+    (void)controlFlags;
+    ThreadContext *thread = getThread(debug, threadId);
+    if(thread == NULL)
+        return ERR_INVALID_HANDLE;
+    if(!isBroken())
+        return ERR_INVALID_STATE;
+
+    *context = *thread;
+    return 0;
+}
+
+Result svcSetDebugThreadContext(Handle debug, u32 threadId, ThreadContext *context, ThreadContextControlFlags controlFlags)
+{
+    (void)controlFlags;
+    ThreadContext *thread = getThread(debug, threadId);
+    if(thread == NULL)
+        return ERR_INVALID_HANDLE;
+    if(!isBroken())
+        return ERR_INVALID_STATE;
+
+    *thread = *context;
+    return 0;
+}
+
+Result svcGetDebugThreadParam(s64 *unused, u32 *out, Handle debug, u32 threadId, DebugThreadParameter parameter)
+{
+    *unused = 0;
+    if(getThread(debug, threadId) == NULL)
+        return ERR_INVALID_HANDLE;
+
+    *out = parameter == DBGTHREAD_PARAMETER_PRIORITY ? 0x30 : 0;
+    return 0;
+}
+
+Result svcGetProcessDebugEvent(DebugEventInfo *info, Handle debug)
+{
+    if(debug != GDBSIM_DEBUG_HANDLE)
+        return ERR_INVALID_HANDLE;
+    if(gdbSim.numEvents == 0)
+        return ERR_NO_EVENT;
+
+    *info = gdbSim.events[gdbSim.eventsHead];
+    gdbSim.eventsHead = (gdbSim.eventsHead + 1) % GDBSIM_MAX_EVENTS;
+    gdbSim.numEvents--;
+    if(info->flags & 1)
+        gdbSim.numWaiting++;
+
+    return 0;
+}
+
+Result svcContinueDebugEvent(Handle debug, DebugFlags flags)
+{
+    (void)flags;
+    if(debug != GDBSIM_DEBUG_HANDLE)
+        return ERR_INVALID_HANDLE;
+    if(gdbSim.numWaiting == 0)
+        return ERR_INVALID_STATE;
+
+    gdbSim.numWaiting--;
+    gdbSim.numContinues++;
+    return 0;
+}
+
+// As with the kernel, fails if the process is already broken
+Result svcBreakDebugProcess(Handle debug)
+{
+    if(debug != GDBSIM_DEBUG_HANDLE)
+        return ERR_INVALID_HANDLE;
+    if(isBroken())
+        return ERR_INVALID_STATE;
+
+    gdbSim.numBreaks++;
+    GDBSim_QueueEvent(DBGEVENT_EXCEPTION, 0, EXCEVENT_DEBUGGER_BREAK);
+    return 0;
+}
+
+Result svcDebugActiveProcess(Handle *debug, u32 processId)
+{
+    if(processId != GDBSIM_PID)
+        return ERR_NOT_FOUND;
+
+    *debug = GDBSIM_DEBUG_HANDLE;
+    return 0;
+}
+
+Result svcTerminateDebugProcess(Handle debug)
+{
+    return debug == GDBSIM_DEBUG_HANDLE ? 0 : ERR_INVALID_HANDLE;
+}
+
+Result svcOpenProcess(Handle *process, u32 processId)
+{
+    if(processId != GDBSIM_PID)
+        return ERR_NOT_FOUND;
+
+    *process = PROCESS_HANDLE;
+    return 0;
+}
+
+Result svcOpenThread(Handle *thread, Handle process, u32 threadId)
+{
+    if(process != PROCESS_HANDLE || getThread(GDBSIM_DEBUG_HANDLE, threadId) == NULL)
+        return ERR_INVALID_HANDLE;
+
+    *thread = THREAD_HANDLE_BASE + threadId;
+    return 0;
+}
+
+Result svcGetThreadPriority(s32 *out, Handle handle)
+{
+    (void)handle;
+    *out = 0x30;
+    return 0;
+}
+
+Result svcGetHandleInfo(s64 *out, Handle handle, u32 param)
+{
+    (void)handle; (void)param;
+    *out = 0;
+    return ERR_INVALID_HANDLE;
+}
+
+Result svcKernelSetState(u32 type, ...)
+{
+    (void)type;
+    return 0;
+}
+
+// The predicate is passed as a u32 (non_stop.c), hence -no-pie. Only the thread ID (word 0x22) of the kernel objects is set
+Result svcControlProcess(Handle process, ProcessOp op, u32 varg2, u32 varg3)
+{
+    static u32 kthreads[GDBSIM_MAX_THREADS][0x30];
+
+    if(process != PROCESS_HANDLE || op != PROCESSOP_SCHEDULE_THREADS)
+        return ERR_INVALID_HANDLE;
+
+    bool (*predicate)(u32 *) = (bool (*)(u32 *))(uintptr_t)varg3;
+    for(u32 i = 1; i < GDBSIM_MAX_THREADS; i++)
+    {
+        kthreads[i][0x22] = i;
+        if(predicate(kthreads[i]))
+            gdbSim.locked[i] = varg2 != 0;
+    }
+
+    return 0;
+}
+
+// The trace buffers, at fixed addresses below 4 GiB
+Result svcControlMemoryEx(u32 *addr_out, u32 addr0, u32 addr1, u32 size, MemOp op, MemPerm perm, bool isLoader)
+{
+    (void)addr1; (void)op; (void)perm; (void)isLoader;
+    void *p = mmap((void *)(uintptr_t)addr0, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_FIXED_NOREPLACE, -1, 0);
+    if(p == MAP_FAILED)
+        return ERR_INVALID_ADDRESS;
+
+    *addr_out = addr0;
+    return 0;
+}
+
+Result svcControlMemory(u32 *addr_out, u32 addr0, u32 addr1, u32 size, MemOp op, MemPerm perm)
+{
+    (void)addr1; (void)perm;
+    *addr_out = 0;
+    return (op & MEMOP_OP_MASK) == MEMOP_FREE && munmap((void *)(uintptr_t)addr0, size) == 0 ? 0 : ERR_INVALID_ADDRESS;
+}
+
+void svcBreak(UserBreakType breakReason)
+{
+    fprintf(stderr, "svcBreak(%d)\n", (int)breakReason);
+    abort();
+}
+
+Result PMDBG_LaunchTitleDebug(Handle *outDebug, const FS_ProgramInfo *programInfo, u32 launchFlags)
+{
+    (void)outDebug; (void)programInfo; (void)launchFlags;
+    return ERR_NOT_FOUND;
+}
+
+Result IFile_Close(IFile *file)
+{
+    (void)file;
+    return 0;
+}
+
+/* mem.c, for user memory only */
+
+u32 GDB_ReadTargetMemory(void *out, GDBContext *ctx, u32 addr, u32 len)
+{
+    u32 total = 0;
+    while(total < len)
+    {
+        u32 size = 0x1000 - ((addr + total) & 0xFFF);
+        size = size < len - total ? size : len - total;
+        if(R_FAILED(svcReadProcessMemory((u8 *)out + total, ctx->debug, addr + total, size)))
+            break;
+        total += size;
+    }
+
+    return total;
+}
+
+u32 GDB_WriteTargetMemory(GDBContext *ctx, const void *in, u32 addr, u32 len)
+{
+    u32 total = 0;
+    while(total < len)
+    {
+        u32 size = 0x1000 - ((addr + total) & 0xFFF);
+        size = size < len - total ? size : len - total;
+        if(R_FAILED(svcWriteProcessMemory(ctx->debug, (const u8 *)in + total, addr + total, size)))
+            break;
+        total += size;
+    }
+
+    return total;
+}
+
+int GDB_SendMemory(GDBContext *ctx, const char *prefix, u32 prefixLen, u32 addr, u32 len)
+{
+    char buf[GDB_BUF_LEN];
+    u8 membuf[GDB_BUF_LEN / 2];
+
+    if(prefix != NULL)
+        memcpy(buf, prefix, prefixLen);
+    else
+        prefixLen = 0;
+
+    if(prefixLen + 2 * len > GDB_BUF_LEN)
+        return prefix == NULL ? GDB_ReplyErrno(ctx, ENOMEM) : -1;
+
+    u32 total = GDB_ReadTargetMemory(membuf, ctx, addr, len);
+    if(total == 0)
+        return prefix == NULL ? GDB_ReplyErrno(ctx, EFAULT) : -EFAULT;
+
+    GDB_EncodeHex(buf + prefixLen, membuf, total);
+    return GDB_SendPacket(ctx, buf, prefixLen + 2 * total);
+}
+
+int GDB_WriteMemory(GDBContext *ctx, const void *buf, u32 addr, u32 len)
+{
+    return GDB_WriteTargetMemory(ctx, buf, addr, len) == len ? GDB_ReplyOk(ctx) : GDB_ReplyErrno(ctx, EFAULT);
+}
+
+GDB_DECLARE_HANDLER(ReadMemory)
+{
+    u32 lst[2];
+    if(GDB_ParseHexIntegerList(lst, ctx->commandData, 2, 0) == NULL)
+        return GDB_ReplyErrno(ctx, EILSEQ);
+
+    if(ctx->trace.frameSelected)
+        return GDB_SendTraceFrameMemory(ctx, lst[0], lst[1]);
+
+    return GDB_SendMemory(ctx, NULL, 0, lst[0], lst[1]);
+}
+
+GDB_DECLARE_HANDLER(WriteMemory)
+{
+    u32 lst[2];
+    u8 buf[GDB_BUF_LEN / 2];
+    const char *dataStart = GDB_ParseHexIntegerList(lst, ctx->commandData, 2, ':');
+    if(dataStart == NULL || *dataStart != ':')
+        return GDB_ReplyErrno(ctx, EILSEQ);
+
+    dataStart++;
+    if(lst[1] > sizeof(buf) || (u32)(ctx->commandEnd - dataStart) != 2 * lst[1] || GDB_DecodeHex(buf, dataStart, lst[1]) != lst[1])
+        return GDB_ReplyErrno(ctx, EILSEQ);
+
+    return GDB_WriteMemory(ctx, buf, lst[0], lst[1]);
+}
+
+GDB_DECLARE_HANDLER(WriteMemoryRaw)
+{
+    return GDB_HandleUnsupported(ctx);
+}
+
+GDB_DECLARE_QUERY_HANDLER(SearchMemory)
+{
+    return GDB_HandleUnsupported(ctx);
+}
+
+/* tio.c, xfer.c, remote_command.c */
+
+GDB_DECLARE_VERBOSE_HANDLER(File)
+{
+    return GDB_HandleUnsupported(ctx);
+}
+
+GDB_DECLARE_QUERY_HANDLER(Xfer)
+{
+    return GDB_HandleUnsupported(ctx);
+}
+
+GDB_DECLARE_QUERY_HANDLER(Rcmd)
+{
+    return GDB_HandleUnsupported(ctx);
+}
+
+/* Connection */
+
+static u8 checksum(const char *data, u32 len)
+{
+    u8 sum = 0;
+    for(u32 i = 0; i < len; i++)
+        sum += (u8)data[i];
+    return sum;
+}
+
+// Takes all the stub has sent: acknowledgments, packets and notifications
+static void receive(void)
+{
+    static char buf[4 * GDB_BUF_LEN];
+    ssize_t n;
+    u32 size = 0;
+
+    while((n = recv(gdbFd, buf + size, sizeof(buf) - 1 - size, MSG_DONTWAIT)) > 0)
+        size += n;
+    buf[size] = 0;
+
+    for(char *pos = buf; pos < buf + size; )
+    {
+        if(*pos == '+')
+        {
+            pos++;
+            continue;
+        }
+
+        char *end = strchr(pos, '#');
+        u32 kind = *pos == '%' ? 1 : 0;
+        unsigned int sum;
+        if((*pos != '$' && *pos != '%') || end == NULL || end + 3 > buf + size || sscanf(end + 1, "%2x", &sum) != 1 ||
+           checksum(pos + 1, end - pos - 1) != sum || end - pos - 1 > GDB_BUF_LEN)
+        {
+            numBadPackets++;
+            return;
+        }
+
+        memcpy(replies[kind], pos + 1, end - pos - 1);
+        replies[kind][end - pos - 1] = 0;
+        hasReply[kind] = true;
+        pos = end + 3;
+    }
+}
+
+static const char *take(u32 kind)
+{
+    receive();
+    if(!hasReply[kind])
+        return NULL;
+
+    hasReply[kind] = false;
+    return replies[kind];
+}
+
+const char *GDBSim_TakeReply(void)
+{
+    return take(0);
+}
+
+const char *GDBSim_TakeNotification(void)
+{
+    return take(1);
+}
+
+u32 GDBSim_NumBadPackets(void)
+{
+    receive();
+    return numBadPackets;
+}
+
+const char *GDBSim_Command(GDBContext *ctx, const char *packet)
+{
+    char buf[GDB_BUF_LEN + 4];
+    u32 len = strlen(packet);
+    int n = sprintf(buf, "$%s#%02x", packet, checksum(packet, len));
+
+    receive();
+    hasReply[0] = false;
+    if(send(gdbFd, buf, n, 0) != n)
+        return NULL;
+
+    GDB_DoPacket(ctx);
+    return GDBSim_TakeReply();
+}
+
+void GDBSim_Attach(GDBServer *server, GDBContext *ctx, u32 numThreads)
+{
+    int fds[2];
+    if(socketpair(AF_UNIX, SOCK_STREAM, 0, fds) != 0)
+        abort();
+
+    memset(&gdbSim, 0, sizeof(gdbSim));
+    gdbFd = fds[1];
+    hasReply[0] = hasReply[1] = false;
+
+    ctx->parent = server;
+    ctx->super.sockfd = fds[0];
+    ctx->flags = GDB_FLAG_SELECTED;
+    ctx->pid = GDBSIM_PID;
+
+    // What the kernel reports on attach, then the threads are stopped until the attach break is continued
+    GDBSim_QueueEvent(DBGEVENT_ATTACH_PROCESS, 0, 0)->attach_process.process_id = GDBSIM_PID;
+    for(u32 i = 1; i <= numThreads && i < GDBSIM_MAX_THREADS; i++)
+    {
+        gdbSim.threads[i].cpu_registers.cpsr = 0x10; // user mode, ARM
+        gdbSim.threads[i].cpu_registers.sp = GDBSIM_MEMORY_BASE + GDBSIM_MEMORY_SIZE - 0x100 * i;
+        GDBSim_QueueEvent(DBGEVENT_ATTACH_THREAD, i, 0);
+    }
+    GDBSim_QueueEvent(DBGEVENT_EXCEPTION, 0, EXCEVENT_ATTACH_BREAK);
+
+    GDB_AcceptClient(ctx);
+}
+
+void GDBSim_Detach(GDBContext *ctx)
+{
+    GDB_CloseClient(ctx);
+    close(ctx->super.sockfd);
+    close(gdbFd);
+    gdbFd = -1;
+}
+
+/* Debug events */
+
+DebugEventInfo *GDBSim_QueueEvent(DebugEventType type, u32 threadId, ExceptionEventType exceptionType)
+{
+    if(gdbSim.numEvents == GDBSIM_MAX_EVENTS)
+        abort();
+
+    DebugEventInfo *info = &gdbSim.events[(gdbSim.eventsHead + gdbSim.numEvents++) % GDBSIM_MAX_EVENTS];
+    memset(info, 0, sizeof(DebugEventInfo));
+    info->type = type;
+    info->thread_id = threadId;
+    info->flags = 1;
+    if(type == DBGEVENT_EXCEPTION)
+    {
+        info->exception.type = exceptionType;
+        info->exception.address = threadId != 0 ? gdbSim.threads[threadId].cpu_registers.pc : 0;
+        info->exception.stop_point.type = STOPPOINT_SVC_FF;
+    }
+
+    return info;
+}
+
+int GDBSim_HandleEvent(GDBContext *ctx)
+{
+    RecursiveLock_Lock(&ctx->lock);
+    int r = GDB_HandleDebugEvents(ctx);
+    RecursiveLock_Unlock(&ctx->lock);
+    return r;
+}
+
+int GDBSim_HitBreakpoint(GDBContext *ctx, u32 threadId, u32 pc)
+{
+    gdbSim.threads[threadId].cpu_registers.pc = pc;
+    GDBSim_QueueEvent(DBGEVENT_EXCEPTION, threadId, EXCEVENT_STOP_POINT);
+    return GDBSim_HandleEvent(ctx);
+}
+
+u32 GDBSim_Read32(u32 addr)
+{
+    u32 value;
+    memcpy(&value, gdbSim.memory + (addr - GDBSIM_MEMORY_BASE), 4);
+    return value;
+}
+
+void GDBSim_Write32(u32 addr, u32 value)
+{
+    memcpy(gdbSim.memory + (addr - GDBSIM_MEMORY_BASE), &value, 4);
+}
@@ -0,0 +1,63 @@
+/*
+*   This file is part of Luma3DS.
+*   Copyright (C) 2016-2020 Aurora Wright, TuxSH
+*
+*   SPDX-License-Identifier: (MIT OR GPL-2.0-or-later)
+*/
+
+/* Simulated debuggee for the GDB stub tests (gdbtest.c, nstest.c): a block of user memory, thread contexts and a
+   queue of debug events behind the debug SVCs, and a socket pair standing for the connection to GDB. The packets go
+   through the real server and network code (server.c, net.c). */
+
+#pragma once
+
+#include "gdb.h"
+#include "gdb/server.h"
+
+#define GDBSIM_PID              0x30
+#define GDBSIM_DEBUG_HANDLE     0x200
+#define GDBSIM_MEMORY_BASE      0x00100000
+#define GDBSIM_MEMORY_SIZE      0x10000
+#define GDBSIM_MAX_THREADS      8       ///< Thread IDs are 1 to GDBSIM_MAX_THREADS - 1
+#define GDBSIM_MAX_EVENTS       16
+
+typedef struct GDBSimState
+{
+    u8 memory[GDBSIM_MEMORY_SIZE];
+    ThreadContext threads[GDBSIM_MAX_THREADS];
+    bool locked[GDBSIM_MAX_THREADS];    ///< Set by PROCESSOP_SCHEDULE_THREADS
+
+    DebugEventInfo events[GDBSIM_MAX_EVENTS];
+    u32 eventsHead, numEvents;
+    u32 numWaiting;                     ///< Events handed out and not continued yet
+
+    u32 numContinues;                   ///< svcContinueDebugEvent calls
+    u32 numBreaks;                      ///< svcBreakDebugProcess calls
+} GDBSimState;
+
+extern GDBSimState gdbSim;
+
+/// Attaches ctx to the simulated process with threads 1 to numThreads, stopped as on attach, and connects it.
+void GDBSim_Attach(GDBServer *server, GDBContext *ctx, u32 numThreads);
+/// Disconnects ctx.
+void GDBSim_Detach(GDBContext *ctx);
+
+/// Sends a packet (without the framing) and has the stub handle it. Returns the reply, or NULL if there is none.
+const char *GDBSim_Command(GDBContext *ctx, const char *packet);
+/// Returns the last packet received since the last call (or command), or NULL.
+const char *GDBSim_TakeReply(void);
+/// Returns the last notification (with its name, e.g. "Stop:T05...") received since the last call, or NULL.
+const char *GDBSim_TakeNotification(void);
+/// Returns the number of packets with a wrong checksum or framing received so far.
+u32 GDBSim_NumBadPackets(void);
+
+/// Queues a debug event (flags = 1: the thread waits for it to be continued), returns it for the other fields.
+DebugEventInfo *GDBSim_QueueEvent(DebugEventType type, u32 threadId, ExceptionEventType exceptionType);
+/// Has the stub handle the oldest queued event, as its monitor thread does. Returns what GDB_HandleDebugEvents returns.
+int GDBSim_HandleEvent(GDBContext *ctx);
+/// Moves threadId to pc and has the stub handle the breakpoint instruction there (GDBSim_HandleEvent).
+int GDBSim_HitBreakpoint(GDBContext *ctx, u32 threadId, u32 pc);
+
+/// Little-endian 32-bit words in the simulated memory.
+u32 GDBSim_Read32(u32 addr);
+void GDBSim_Write32(u32 addr, u32 value);
@@ -0,0 +1,328 @@
+/*
+*   This file is part of Luma3DS.
+*   Copyright (C) 2016-2020 Aurora Wright, TuxSH
+*
+*   SPDX-License-Identifier: (MIT OR GPL-2.0-or-later)
+*/
+
+/* Checks the GDB tracepoints (tracepoints.c) through the packets GDB sends, against the simulated process of
+   gdbsim.c: definitions, collection on breakpoint hits (queued as debug events, as the kernel reports them), pass
+   counts, trace state variables, tfind and qTBuffer, the circular buffer wrapping around, a tracepoint sharing its
+   address with a GDB breakpoint, and condition errors.
+
+   Exits with status 1 if anything doesn't match.
+*/
+
+#include <stdio.h>
+#include "gdbsim.h"
+#include "gdb/breakpoints.h"
+#include "gdb/tracepoints.h"
+
+#define CODE    (GDBSIM_MEMORY_BASE + 0x1000)
+#define DATA    (GDBSIM_MEMORY_BASE + 0x2000)
+#define NOP     0xE1A00000
+
+static bool failed;
+
+static GDBServer server;
+static GDBContext *ctx = &server.ctxs[0];
+
+static void expect(const char *name, bool ok)
+{
+    if (!ok)
+    {
+        printf("    %s: FAILED\n", name);
+        failed = true;
+    }
+}
+
+static void expectReply(const char *packet, const char *expected)
+{
+    const char *reply = GDBSim_Command(ctx, packet);
+    if (reply == NULL || strcmp(reply, expected) != 0)
+    {
+        printf("    %s: got \"%s\" instead of \"%s\"\n", packet, reply != NULL ? reply : "(nothing)", expected);
+        failed = true;
+    }
+}
+
+static void expectReplyf(const char *expected, const char *fmt, u32 a, u32 b)
+{
+    char packet[64];
+    sprintf(packet, fmt, a, b);
+    expectReply(packet, expected);
+}
+
+// The stub resumes the thread by itself: tracepoint hit with no GDB breakpoint there, or end of a step-over
+static bool hitSilently(u32 threadId, u32 pc)
+{
+    return GDBSim_HitBreakpoint(ctx, threadId, pc) == -3 && GDBSim_TakeReply() == NULL;
+}
+
+// Hit, then the step-over to the next instruction
+static bool collect(u32 threadId, u32 pc)
+{
+    bool ok = hitSilently(threadId, pc);
+    return hitSilently(threadId, pc + 4) && ok;
+}
+
+static void attach(void)
+{
+    GDBSim_Attach(&server, ctx, 3);
+    for (u32 addr = CODE; addr < CODE + 0x100; addr += 4)
+        GDBSim_Write32(addr, NOP);
+    strcpy((char *)gdbSim.memory + (DATA - GDBSIM_MEMORY_BASE), "hello");
+    for (u32 i = 1; i <= 3; i++)
+        gdbSim.threads[i].cpu_registers.r[0] = DATA;
+
+    expectReply("QStartNoAckMode", "OK");
+}
+
+static void detach(void)
+{
+    GDBSim_Detach(ctx);
+    expect("well-formed packets", GDBSim_NumBadPackets() == 0);
+}
+
+static void testCollection(void)
+{
+    printf("Collection:\n");
+    attach();
+
+    expectReply("QTinit", "OK");
+    expectReplyf("OK", "QTDP:1:%x:E:0:0-", CODE, 0);
+    expectReplyf("OK", "QTDP:-1:%x:R7fff-", CODE, 0);
+    expectReplyf("OK", "QTDP:-1:%x:M0,1,4-", CODE, 0);                           // r0 + 1, 4 bytes
+    expectReplyf("OK", "QTDP:-1:%x:Mffffffff,%x,2-", CODE, DATA);               // absolute
+    expectReplyf("OK", "QTDP:-1:%x:X7,26000022082f27", CODE, 0);                 // tracenz r0, 8
+    expectReplyf("OK", "QTDP:2:%x:E:0:3:X4,26000027", CODE + 8, 0);              // pass count 3, condition r0
+    expectReplyf("E5f", "QTDP:3:%x:E:1:0", CODE + 0x10, 0);                      // while-stepping
+    expectReplyf("E11", "QTDP:2:%x:E:0:3", CODE + 8, 0);                         // already defined
+    expectReplyf("E16", "QTDP:-1:%x:R1", CODE, 0);                               // not contiguous
+    expectReply("QTDV:1:5:0:666f6f", "OK");
+    expectReplyf("OK", "QTDP:4:%x:E:0:0-", CODE + 0xC, 0);
+    expectReplyf("OK", "QTDP:-4:%x:X7,2c00012e000127", CODE + 0xC, 0);           // getv 1, tracev 1
+    expectReply("qTStatus", "T0;tnotrun:0;tframes:0;tcreated:0;tfree:10000;tsize:10000;circular:0;disconn:0");
+
+    expectReply("QTStart", "OK");
+    expect("breakpoints set", GDBSim_Read32(CODE) == BREAKPOINT_INSTRUCTION_ARM && GDBSim_Read32(CODE + 8) == BREAKPOINT_INSTRUCTION_ARM);
+    expectReplyf("E10", "QTDP:5:%x:E:0:0", CODE + 0x10, 0);                      // running
+    expect("continued", GDBSim_Command(ctx, "c") == NULL && (ctx->flags & GDB_FLAG_PROCESS_CONTINUING));
+
+    expect("hit", hitSilently(1, CODE));
+    expectReply("qTStatus", "T1;tunknown:0;tframes:1;tcreated:1;tfree:ff00;tsize:10000;circular:0;disconn:0");
+    expect("stepping over", ctx->stepOver.threadId == 1 && GDBSim_Read32(CODE) == NOP);
+    expect("step-over done", hitSilently(1, CODE + 4) && ctx->stepOver.threadId == 0 && GDBSim_Read32(CODE) == BREAKPOINT_INSTRUCTION_ARM);
+
+    // The pass count of tracepoint 2 stops the trace after its third hit (the numbers in qTStatus are hex)
+    // (tracepoint 4 is at the instruction after it, then its own step-over)
+    bool ok = true;
+    for (u32 i = 0; i < 3; i++)
+    {
+        ok = hitSilently(2, CODE + 8) && ok;
+        ok = hitSilently(2, CODE + 0xC) && ok;
+        if (ctx->trace.running)
+            ok = hitSilently(2, CODE + 0x10) && ok;
+    }
+    expect("hits", ok);
+    expectReply("qTStatus", "T0;tpasscount:2;tframes:6;tcreated:6;tfree:fec8;tsize:10000;circular:0;disconn:0");
+    expect("breakpoints removed", GDBSim_Read32(CODE) == NOP && GDBSim_Read32(CODE + 8) == NOP && ctx->nbBreakpoints == 0);
+    expect("all continued", gdbSim.numWaiting == 0);
+    expectReplyf("V3:12", "qTP:2:%x", CODE + 8, 0);
+
+    // tfind, then the registers and memory of the frame
+    expectReply("QTFrame:0", "F0T1");
+    expectReply("pf", "00101000");
+    expectReplyf("656c6c6f", "m%x,%x", DATA + 1, 4);
+    expectReplyf("68656c6c6f00", "m%x,%x", DATA, 8);
+    expectReplyf("E0e", "m%x,%x", DATA + 0x1000, 4);
+    expectReplyf("F1T2", "QTFrame:pc:%x", CODE + 8, 0);
+    expectReplyf("F3T2", "QTFrame:pc:%x", CODE + 8, 0);
+    expectReply("QTFrame:tdp:1", "F-1");
+    expectReplyf("F0T1", "QTFrame:range:%x:%x", CODE, CODE + 4);
+    expectReplyf("F1T2", "QTFrame:outside:%x:%x", CODE, CODE + 4);
+    expectReply("QTFrame:ffffffff", "OK");
+    expectReply("qTV:1", "V5");
+    expectReply("qTV:9", "U");
+    expectReply("qTBuffer:0,10", "0100fa00000052002010000000000000");
+    expectReply("qTBuffer:300,10", "l");
+
+    // Frame of tracepoint 4: the variable and no registers
+    expectReply("QTFrame:tdp:4", "F2T4");
+    expectReply("qTV:1", "V5");
+    expectReply("pf", "0c101000");
+    expectReply("p0", "xxxxxxxx");
+    const char *regs = GDBSim_Command(ctx, "g");
+    expect("registers", regs != NULL && strlen(regs) == 408 && memcmp(regs + 120, "0c101000", 8) == 0 && regs[0] == 'x');
+    expectReplyf("E0e", "m%x,%x", DATA, 4);
+    expectReplyf("OK", "QTro:%x,%x", DATA, DATA + 4);
+    expectReplyf("68656c6c", "m%x,%x", DATA, 4);
+    expectReply("QTFrame:ffffffff", "OK");
+
+    detach();
+    expect("freed on detach", ctx->trace.buffer == NULL);
+}
+
+static bool checkRing(void)
+{
+    GDBTraceState *trace = &ctx->trace;
+    u32 used = trace->wrapped ? trace->wrapEnd - trace->head + trace->tail : trace->tail - trace->head;
+    if (used != trace->nbFrames * 117 || used > trace->bufferSize)
+        return false;
+
+    // Every frame is whole, in order, and the last one ends at the tail
+    u32 offset = trace->head;
+    for (u32 i = 0; i < trace->nbFrames; i++)
+    {
+        u32 size;
+        memcpy(&size, trace->buffer + offset + 2, 4);
+        if (trace->buffer[offset] != 1 || size != 111)
+            return false;
+
+        offset += 117;
+        if (trace->wrapped && offset == trace->wrapEnd)
+            offset = 0;
+    }
+
+    return offset == trace->tail;
+}
+
+static void testCircular(void)
+{
+    char data[2 * 0x1000 + 1];
+    u32 threadId = 1;
+
+    printf("Circular buffer:\n");
+    attach();
+
+    // Frames of 6 + 11 + 100 bytes, the oldest ones get dropped
+    expectReply("QTinit", "OK");
+    expectReply("QTBuffer:size:1000", "OK");
+    expectReply("QTBuffer:size:100000", "E0c");
+    expectReply("QTBuffer:circular:1", "OK");
+    expectReplyf("OK", "QTDP:1:%x:E:0:0-", CODE, 0);
+    expectReplyf("OK", "QTDP:-1:%x:Mffffffff,%x,64", CODE, DATA);
+    expectReply("QTStart", "OK");
+    GDBSim_Command(ctx, "c");
+
+    bool ok = true, ringOk = true;
+    for (u32 i = 0; i < 100; i++)
+    {
+        ok = collect(threadId, CODE) && ok;
+        ringOk = ringOk && checkRing();
+        threadId = threadId % 3 + 1;
+    }
+    expect("hits", ok);
+    expect("ring", ringOk && ctx->trace.wrapped);
+    expectReply("qTStatus", "T1;tunknown:0;tframes:23;tcreated:64;tfree:1;tsize:1000;circular:1;disconn:0");
+
+    // qTBuffer reads the frames in order across the wrap
+    u32 used = 0x23 * 117, total = 0;
+    ok = true;
+    while (total < used && ok)
+    {
+        char packet[32];
+        sprintf(packet, "qTBuffer:%x,%x", total, 0x1000);
+        const char *reply = GDBSim_Command(ctx, packet);
+        u32 n = reply != NULL ? strlen(reply) / 2 : 0;
+        ok = n > 0 && total + n <= used;
+        if (ok)
+            memcpy(data + 2 * total, reply, 2 * n);
+        total += n;
+    }
+    for (u32 offset = 0; offset < used && ok; offset += 117)
+        ok = memcmp(data + 2 * offset, "01006f000000", 12) == 0;
+    expect("qTBuffer across the wrap", ok && total == used);
+    expectReplyf("l", "qTBuffer:%x,%x", used, 0x10);
+
+    expectReply("QTFrame:21", "F21T1");
+    expectReply("QTFrame:23", "F-1");
+    expectReply("QTStop", "OK");
+    expectReply("qTStatus", "T0;tstop::0;tframes:23;tcreated:64;tfree:1;tsize:1000;circular:1;disconn:0");
+
+    printf("Full buffer:\n");
+
+    // Without wrapping, the trace stops when the next frame doesn't fit
+    expectReply("QTBuffer:circular:0", "OK");
+    expectReply("QTStart", "OK");
+    ok = true;
+    for (u32 i = 0; i < 40 && ctx->trace.running; i++)
+    {
+        ok = collect(threadId, CODE) && ok;
+        threadId = threadId % 3 + 1;
+    }
+    expect("hits", ok);
+    expectReply("qTStatus", "T0;tfull:0;tframes:23;tcreated:23;tfree:1;tsize:1000;circular:0;disconn:0");
+    expect("breakpoint removed", GDBSim_Read32(CODE) == NOP);
+
+    detach();
+}
+
+static void testSharedBreakpoint(void)
+{
+    printf("Shared with a GDB breakpoint:\n");
+    attach();
+
+    expectReply("QTinit", "OK");
+    expectReplyf("OK", "QTDP:1:%x:E:0:0", CODE, 0);
+    expectReply("QTStart", "OK");
+    expectReplyf("OK", "Z0,%x,4", CODE, 0);
+    GDBSim_Command(ctx, "c");
+
+    // Collected, and reported
+    expect("reported", GDBSim_HitBreakpoint(ctx, 3, CODE) >= 0);
+    const char *reply = GDBSim_TakeReply();
+    expect("stop reply", reply != NULL && strncmp(reply, "T05thread:3;", 12) == 0 && strstr(reply, "swbreak:;") != NULL);
+    expect("collected", ctx->trace.nbFrames == 1);
+    expectReplyf("OK", "z0,%x,4", CODE, 0);
+    expect("tracepoint kept", GDBSim_Read32(CODE) == BREAKPOINT_INSTRUCTION_ARM);
+
+    // Resumed on the same trap: not collected again
+    GDBSim_Command(ctx, "c");
+    expect("same trap", hitSilently(3, CODE) && ctx->trace.nbFrames == 1);
+    expect("step-over", hitSilently(3, CODE + 4));
+    expect("next hit", collect(3, CODE) && ctx->trace.nbFrames == 2);
+
+    // Stopping the trace leaves GDB's breakpoint
+    expectReplyf("OK", "Z0,%x,4", CODE, 0);
+    expectReply("QTStop", "OK");
+    expect("GDB breakpoint kept", GDBSim_Read32(CODE) == BREAKPOINT_INSTRUCTION_ARM && ctx->nbBreakpoints == 1);
+    expectReplyf("OK", "z0,%x,4", CODE, 0);
+    expect("instruction restored", GDBSim_Read32(CODE) == NOP);
+
+    detach();
+}
+
+static void testConditionError(void)
+{
+    printf("Condition error:\n");
+    attach();
+
+    expectReply("QTinit", "OK");
+    expectReplyf("OK", "QTDP:1:%x:E:0:0:X7,24000200001927", CODE, 0);          // *(u32 *)0
+    expectReply("QTStart", "OK");
+    GDBSim_Command(ctx, "c");
+
+    GDBSim_HitBreakpoint(ctx, 2, CODE);
+    expect("stopped", !ctx->trace.running);
+    expectReply("qTStatus", "T0;terror:636f6e646974696f6e206576616c756174696f6e206661696c6564:1;tframes:0;tcreated:0;tfree:10000;tsize:10000;circular:0;disconn:0");
+    expect("step-over", hitSilently(2, CODE + 4));
+    expect("breakpoint removed", GDBSim_Read32(CODE) == NOP);
+    expectReply("QTDisconnected:1", "E5f");
+
+    detach();
+    expect("freed on detach", ctx->trace.buffer == NULL && ctx->nbBreakpoints == 0);
+}
+
+int main(void)
+{
+    GDB_InitializeServer(&server);
+
+    testCollection();
+    testCircular();
+    testSharedBreakpoint();
+    testConditionError();
+
+    printf(failed ? "FAILED\n" : "ok\n");
+    return failed ? 1 : 0;
+}
@@ -0,0 +1,26 @@
+/*
+*   This file is part of Luma3DS.
+*   Copyright (C) 2016-2020 Aurora Wright, TuxSH
+*
+*   SPDX-License-Identifier: (MIT OR GPL-2.0-or-later)
+*/
+
+#pragma once
+
+#include <3ds/types.h>
+
+#define SYSCLOCK_ARM11  268111856ULL
+
+#define OS_SHAREDCFG_VADDR  0x1FF81000
+
+typedef enum MemRegion
+{
+    MEMREGION_ALL         = 0,
+    MEMREGION_APPLICATION = 1,
+    MEMREGION_SYSTEM      = 2,
+    MEMREGION_BASE        = 3,
+} MemRegion;
+
+// Provided by the programs that need them (see rstest.c and mdtest.c)
+s64 osGetMemRegionFree(MemRegion region);
+u64 osGetTime(void);
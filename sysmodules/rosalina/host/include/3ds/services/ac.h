@@ -0,0 +1,15 @@
+/*
+*   This file is part of Luma3DS.
+*   Copyright (C) 2016-2020 Aurora Wright, TuxSH
+*
+*   SPDX-License-Identifier: (MIT OR GPL-2.0-or-later)
+*/
+
+#pragma once
+
+#include <3ds/types.h>
+
+// The host is always connected
+Result acInit(void);
+Result ACU_GetWifiStatus(u32 *out);
+Result ACU_GetStatus(u32 *out);
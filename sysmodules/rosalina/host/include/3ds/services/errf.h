@@ -0,0 +1,65 @@
+/*
+*   This file is part of Luma3DS.
+*   Copyright (C) 2016-2020 Aurora Wright, TuxSH
+*
+*   SPDX-License-Identifier: (MIT OR GPL-2.0-or-later)
+*/
+
+#pragma once
+
+#include <3ds/types.h>
+#include <3ds/svc.h>
+
+// Just the fatal error info minidump.c reads, see mdtest.c
+
+typedef enum ERRF_ErrType
+{
+    ERRF_ERRTYPE_GENERIC      = 0,
+    ERRF_ERRTYPE_MEM_CORRUPT  = 1,
+    ERRF_ERRTYPE_CARD_REMOVED = 2,
+    ERRF_ERRTYPE_EXCEPTION    = 3,
+    ERRF_ERRTYPE_FAILURE      = 4,
+    ERRF_ERRTYPE_LOGGED       = 5,
+} ERRF_ErrType;
+
+typedef enum ERRF_ExceptionType
+{
+    ERRF_EXCEPTION_PREFETCH_ABORT = 0,
+    ERRF_EXCEPTION_DATA_ABORT     = 1,
+    ERRF_EXCEPTION_UNDEFINED      = 2,
+    ERRF_EXCEPTION_VFP            = 3,
+} ERRF_ExceptionType;
+
+typedef struct ERRF_ExceptionInfo
+{
+    ERRF_ExceptionType type : 8;
+    u8 reserved[3];
+    u32 fsr;
+    u32 far;
+    u32 fpexc;
+    u32 fpinst;
+    u32 fpinst2;
+} ERRF_ExceptionInfo;
+
+typedef struct ERRF_ExceptionData
+{
+    ERRF_ExceptionInfo excep;
+    CpuRegisters regs;
+} ERRF_ExceptionData;
+
+typedef struct ERRF_FatalErrInfo
+{
+    ERRF_ErrType type : 8;
+    u8 revHigh;
+    u16 revLow;
+    u32 resCode;
+    u32 pcAddr;
+    u32 procId;
+    u64 titleId;
+    u64 appTitleId;
+    union
+    {
+        ERRF_ExceptionData exception_data;
+        char failure_mesg[0x60];
+    } data;
+} ERRF_FatalErrInfo;
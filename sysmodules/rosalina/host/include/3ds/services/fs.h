@@ -0,0 +1,73 @@
+/*
+*   This file is part of Luma3DS.
+*   Copyright (C) 2016-2020 Aurora Wright, TuxSH
+*
+*   SPDX-License-Identifier: (MIT OR GPL-2.0-or-later)
+*/
+
+#pragma once
+
+#include <string.h>
+#include <3ds/types.h>
+
+// Only declared, the programs doing file I/O provide their own (see rstest.c)
+
+enum
+{
+    FS_OPEN_READ    = BIT(0),
+    FS_OPEN_WRITE   = BIT(1),
+    FS_OPEN_CREATE  = BIT(2),
+};
+
+enum
+{
+    FS_WRITE_FLUSH      = BIT(0),
+    FS_WRITE_UPDATE_TIME = BIT(8),
+};
+
+typedef enum FS_ArchiveID
+{
+    ARCHIVE_SDMC    = 0x00000009,
+} FS_ArchiveID;
+
+typedef enum FS_PathType
+{
+    PATH_INVALID    = 0,
+    PATH_EMPTY      = 1,
+    PATH_BINARY     = 2,
+    PATH_ASCII      = 3,
+    PATH_UTF16      = 4,
+} FS_PathType;
+
+typedef struct FS_Path
+{
+    FS_PathType type;
+    u32 size;
+    const void *data;
+} FS_Path;
+
+typedef u64 FS_Archive;
+
+typedef enum FS_MediaType
+{
+    MEDIATYPE_NAND      = 0,
+    MEDIATYPE_SD        = 1,
+    MEDIATYPE_GAME_CARD = 2,
+} FS_MediaType;
+
+typedef struct FS_ProgramInfo
+{
+    u64 programId;
+    FS_MediaType mediaType : 8;
+    u8 padding[7];
+} FS_ProgramInfo;
+
+static inline FS_Path fsMakePath(FS_PathType type, const void *path)
+{
+    FS_Path p = { type, type == PATH_ASCII ? (u32)strlen((const char *)path) + 1 : 0, path };
+    return p;
+}
+
+Result FSUSER_OpenArchive(FS_Archive *archive, FS_ArchiveID id, FS_Path path);
+Result FSUSER_CloseArchive(FS_Archive archive);
+Result FSUSER_CreateDirectory(FS_Archive archive, FS_Path path, u32 attributes);
@@ -0,0 +1,22 @@
+/*
+*   This file is part of Luma3DS.
+*   Copyright (C) 2016-2020 Aurora Wright, TuxSH
+*
+*   SPDX-License-Identifier: (MIT OR GPL-2.0-or-later)
+*/
+
+#pragma once
+
+#include <3ds/services/fs.h>
+
+enum
+{
+    PMLAUNCHFLAG_NORMAL_APPLICATION     = BIT(0),
+    PMLAUNCHFLAG_LOAD_DEPENDENCIES      = BIT(1),
+    PMLAUNCHFLAG_NOTIFY_TERMINATION     = BIT(2),
+    PMLAUNCHFLAG_QUEUE_DEBUG_APPLICATION = BIT(3),
+    PMLAUNCHFLAG_TERMINATION_NOTIFICATION_MASK = 0xF0,
+    PMLAUNCHFLAG_FORCE_USE_O3DS_APP_MEM = BIT(8),
+    PMLAUNCHFLAG_FORCE_USE_O3DS_MAX_APP_MEM = BIT(9),
+    PMLAUNCHFLAG_USE_UPDATE_TITLE       = BIT(16),
+};
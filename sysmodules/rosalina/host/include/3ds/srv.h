@@ -0,0 +1,13 @@
+/*
+*   This file is part of Luma3DS.
+*   Copyright (C) 2016-2020 Aurora Wright, TuxSH
+*
+*   SPDX-License-Identifier: (MIT OR GPL-2.0-or-later)
+*/
+
+#pragma once
+
+#include <3ds/types.h>
+
+Result srvGetServiceHandle(Handle *out, const char *name);
+Result srvIsServiceRegistered(bool *registered, const char *name);
@@ -0,0 +1,335 @@
+/*
+*   This file is part of Luma3DS.
+*   Copyright (C) 2016-2020 Aurora Wright, TuxSH
+*
+*   SPDX-License-Identifier: (MIT OR GPL-2.0-or-later)
+*/
+
+#pragma once
+
+#include <3ds/types.h>
+
+// Events are implemented with pthreads in stubs.c, handles are indices in a fixed table. The memory, process and
+// debug SVCs are only declared, the programs using them provide their own (see rstest.c and gdbsim.c)
+
+#define CUR_PROCESS_HANDLE  0xFFFF8001
+
+typedef enum MemOp
+{
+    MEMOP_FREE      = 1,
+    MEMOP_RESERVE   = 2,
+    MEMOP_ALLOC     = 3,
+    MEMOP_MAP       = 4,
+    MEMOP_UNMAP     = 5,
+    MEMOP_PROT      = 6,
+
+    MEMOP_REGION_APP    = 0x100,
+    MEMOP_REGION_SYSTEM = 0x200,
+    MEMOP_REGION_BASE   = 0x300,
+
+    MEMOP_OP_MASK       = 0xFF,
+    MEMOP_REGION_MASK   = 0xF00,
+    MEMOP_LINEAR_FLAG   = 0x10000,
+
+    MEMOP_ALLOC_LINEAR  = MEMOP_LINEAR_FLAG | MEMOP_ALLOC,
+} MemOp;
+
+typedef enum MemState
+{
+    MEMSTATE_FREE       = 0,
+    MEMSTATE_RESERVED   = 1,
+    MEMSTATE_IO         = 2,
+    MEMSTATE_STATIC     = 3,
+    MEMSTATE_CODE       = 4,
+    MEMSTATE_PRIVATE    = 5,
+    MEMSTATE_SHARED     = 6,
+    MEMSTATE_CONTINUOUS = 7,
+    MEMSTATE_ALIASED    = 8,
+    MEMSTATE_ALIAS      = 9,
+    MEMSTATE_ALIAS_CODE = 10,
+    MEMSTATE_LOCKED     = 11,
+} MemState;
+
+typedef enum MemPerm
+{
+    MEMPERM_READ        = 1,
+    MEMPERM_WRITE       = 2,
+    MEMPERM_EXECUTE     = 4,
+    MEMPERM_READWRITE   = MEMPERM_READ | MEMPERM_WRITE,
+    MEMPERM_READEXECUTE = MEMPERM_READ | MEMPERM_EXECUTE,
+    MEMPERM_DONTCARE    = 0x10000000,
+} MemPerm;
+
+typedef struct MemInfo
+{
+    u32 base_addr;
+    u32 size;
+    u32 perm;
+    u32 state;
+} MemInfo;
+
+typedef struct PageInfo
+{
+    u32 flags;
+} PageInfo;
+
+typedef enum UserBreakType
+{
+    USERBREAK_PANIC   = 0,
+    USERBREAK_ASSERT  = 1,
+    USERBREAK_USER    = 2,
+    USERBREAK_LOAD_RO = 3,
+    USERBREAK_UNLOAD_RO = 4,
+} UserBreakType;
+
+
+typedef enum ResetType
+{
+    RESET_ONESHOT = 0,
+    RESET_STICKY  = 1,
+} ResetType;
+
+Result svcCreateEvent(Handle *event, ResetType resetType);
+Result svcSignalEvent(Handle handle);
+Result svcClearEvent(Handle handle);
+Result svcCloseHandle(Handle handle);
+Result svcWaitSynchronization(Handle handle, s64 nanoseconds);
+Result svcWaitSynchronizationN(s32 *out, const Handle *handles, s32 handlesNum, bool waitAll, s64 nanoseconds);
+void svcSleepThread(s64 ns);
+u64 svcGetSystemTick(void);
+
+Result svcControlMemory(u32 *addr_out, u32 addr0, u32 addr1, u32 size, MemOp op, MemPerm perm);
+Result svcQueryProcessMemory(MemInfo *info, PageInfo *out, Handle process, u32 addr);
+Result svcOpenProcess(Handle *process, u32 processId);
+Result svcGetProcessInfo(s64 *out, Handle process, u32 type);
+Result svcGetProcessId(u32 *out, Handle handle);
+void svcBreak(UserBreakType breakReason);
+
+typedef struct CpuRegisters
+{
+    u32 r[13];
+    u32 sp;
+    u32 lr;
+    u32 pc;
+    u32 cpsr;
+} CpuRegisters;
+
+typedef struct FpuRegisters
+{
+    union
+    {
+        struct PACKED { double d[16]; };
+        float s[32];
+    };
+    u32 fpscr;
+    u32 fpexc;
+} FpuRegisters;
+
+typedef struct ThreadContext
+{
+    CpuRegisters cpu_registers;
+    FpuRegisters fpu_registers;
+} ThreadContext;
+
+typedef enum ThreadContextControlFlags
+{
+    THREADCONTEXT_CONTROL_CPU_GPRS  = BIT(0),
+    THREADCONTEXT_CONTROL_CPU_SPRS  = BIT(1),
+    THREADCONTEXT_CONTROL_FPU_GPRS  = BIT(2),
+    THREADCONTEXT_CONTROL_FPU_SPRS  = BIT(3),
+
+    THREADCONTEXT_CONTROL_CPU_REGS  = BIT(0) | BIT(1),
+    THREADCONTEXT_CONTROL_FPU_REGS  = BIT(2) | BIT(3),
+    THREADCONTEXT_CONTROL_ALL       = THREADCONTEXT_CONTROL_CPU_REGS | THREADCONTEXT_CONTROL_FPU_REGS,
+} ThreadContextControlFlags;
+
+typedef enum DebugThreadParameter
+{
+    DBGTHREAD_PARAMETER_PRIORITY            = 0,
+    DBGTHREAD_PARAMETER_SCHEDULING_MASK_LOW = 1,
+    DBGTHREAD_PARAMETER_CPU_IDEAL           = 2,
+    DBGTHREAD_PARAMETER_CPU_CREATOR         = 3,
+} DebugThreadParameter;
+
+typedef enum DebugEventType
+{
+    DBGEVENT_ATTACH_PROCESS = 0,
+    DBGEVENT_ATTACH_THREAD  = 1,
+    DBGEVENT_EXIT_THREAD    = 2,
+    DBGEVENT_EXIT_PROCESS   = 3,
+    DBGEVENT_EXCEPTION      = 4,
+    DBGEVENT_DLL_LOAD       = 5,
+    DBGEVENT_DLL_UNLOAD     = 6,
+    DBGEVENT_SCHEDULE_IN    = 7,
+    DBGEVENT_SCHEDULE_OUT   = 8,
+    DBGEVENT_SYSCALL_IN     = 9,
+    DBGEVENT_SYSCALL_OUT    = 10,
+    DBGEVENT_OUTPUT_STRING  = 11,
+    DBGEVENT_MAP            = 12,
+} DebugEventType;
+
+typedef enum ProcessExitReason
+{
+    EXITPROCESS_EVENT_EXIT              = 0,
+    EXITPROCESS_EVENT_TERMINATE         = 1,
+    EXITPROCESS_EVENT_DEBUG_TERMINATE   = 2,
+} ProcessExitReason;
+
+typedef struct AttachProcessEvent
+{
+    u64 program_id;
+    char process_name[8];
+    u32 process_id;
+    u32 other_flags;
+} AttachProcessEvent;
+
+typedef struct ExitProcessEvent
+{
+    ProcessExitReason reason;
+} ExitProcessEvent;
+
+typedef struct AttachThreadEvent
+{
+    u32 creator_thread_id;
+    u32 thread_local_storage;
+    u32 entry_point;
+} AttachThreadEvent;
+
+typedef enum ExitThreadEventReason
+{
+    EXITTHREAD_EVENT_EXIT               = 0,
+    EXITTHREAD_EVENT_TERMINATE          = 1,
+    EXITTHREAD_EVENT_EXIT_PROCESS       = 2,
+    EXITTHREAD_EVENT_TERMINATE_PROCESS  = 3,
+} ExitThreadEventReason;
+
+typedef struct ExitThreadEvent
+{
+    ExitThreadEventReason reason;
+} ExitThreadEvent;
+
+typedef enum ExceptionEventType
+{
+    EXCEVENT_UNDEFINED_INSTRUCTION  = 0,
+    EXCEVENT_PREFETCH_ABORT         = 1,
+    EXCEVENT_DATA_ABORT             = 2,
+    EXCEVENT_UNALIGNED_DATA_ACCESS  = 3,
+    EXCEVENT_ATTACH_BREAK           = 4,
+    EXCEVENT_STOP_POINT             = 5,
+    EXCEVENT_USER_BREAK             = 6,
+    EXCEVENT_DEBUGGER_BREAK         = 7,
+    EXCEVENT_UNDEFINED_SYSCALL      = 8,
+} ExceptionEventType;
+
+typedef struct FaultExceptionEvent
+{
+    u32 fault_information;
+} FaultExceptionEvent;
+
+typedef enum StopPointType
+{
+    STOPPOINT_SVC_FF        = 0,
+    STOPPOINT_BREAKPOINT    = 1,
+    STOPPOINT_WATCHPOINT    = 2,
+} StopPointType;
+
+typedef struct StopPointExceptionEvent
+{
+    StopPointType type;
+    u32 fault_information;
+} StopPointExceptionEvent;
+
+typedef struct UserBreakExceptionEvent
+{
+    UserBreakType type;
+    u32 croInfo;
+    u32 croInfoSize;
+} UserBreakExceptionEvent;
+
+typedef struct DebuggerBreakExceptionEvent
+{
+    s32 thread_ids[4];
+} DebuggerBreakExceptionEvent;
+
+typedef struct ExceptionEvent
+{
+    ExceptionEventType type;
+    u32 address;
+    union
+    {
+        FaultExceptionEvent fault;
+        StopPointExceptionEvent stop_point;
+        UserBreakExceptionEvent user_break;
+        DebuggerBreakExceptionEvent debugger_break;
+    };
+} ExceptionEvent;
+
+typedef struct ScheduleInOutEvent
+{
+    u64 clock_tick;
+} ScheduleInOutEvent;
+
+typedef struct SyscallInOutEvent
+{
+    u64 clock_tick;
+    u32 syscall;
+} SyscallInOutEvent;
+
+typedef struct OutputStringEvent
+{
+    u32 string_addr;
+    u32 string_size;
+} OutputStringEvent;
+
+typedef struct MapEvent
+{
+    u32 mapped_addr;
+    u32 mapped_size;
+    MemPerm memperm;
+    MemState memstate;
+} MapEvent;
+
+typedef struct DebugEventInfo
+{
+    DebugEventType type;
+    u32 thread_id;
+    u32 flags;
+    u8 remnants[4];
+    union
+    {
+        AttachProcessEvent attach_process;
+        AttachThreadEvent attach_thread;
+        ExitThreadEvent exit_thread;
+        ExitProcessEvent exit_process;
+        ExceptionEvent exception;
+        ScheduleInOutEvent scheduler;
+        SyscallInOutEvent syscall;
+        OutputStringEvent output_string;
+        MapEvent map;
+    };
+} DebugEventInfo;
+
+typedef enum DebugFlags
+{
+    DBG_INHIBIT_USER_CPU_EXCEPTION_HANDLERS = BIT(0),
+    DBG_SIGNAL_FAULT_EXCEPTION_EVENTS       = BIT(1),
+    DBG_SIGNAL_SCHEDULE_EVENTS              = BIT(2),
+    DBG_SIGNAL_SYSCALL_EVENTS               = BIT(3),
+    DBG_SIGNAL_MAP_EVENTS                   = BIT(4),
+} DebugFlags;
+
+Result svcReadProcessMemory(void *buffer, Handle debug, u32 addr, u32 size);
+Result svcWriteProcessMemory(Handle debug, const void *buffer, u32 addr, u32 size);
+Result svcGetDebugThreadContext(ThreadContext *context, Handle debug, u32 threadId, ThreadContextControlFlags controlFlags);
+Result svcSetDebugThreadContext(Handle debug, u32 threadId, ThreadContext *context, ThreadContextControlFlags controlFlags);
+Result svcGetDebugThreadParam(s64 *unused, u32 *out, Handle debug, u32 threadId, DebugThreadParameter parameter);
+Result svcGetProcessDebugEvent(DebugEventInfo *info, Handle debug);
+Result svcContinueDebugEvent(Handle debug, DebugFlags flags);
+Result svcBreakDebugProcess(Handle debug);
+Result svcGetThreadList(s32 *threadCount, u32 *threadIds, s32 threadIdMaxCount, Handle domain);
+Result svcDebugActiveProcess(Handle *debug, u32 processId);
+Result svcTerminateDebugProcess(Handle debug);
+Result svcOpenThread(Handle *thread, Handle process, u32 threadId);
+Result svcGetThreadPriority(s32 *out, Handle handle);
+Result svcGetHandleInfo(s64 *out, Handle handle, u32 param);
+Result svcKernelSetState(u32 type, ...);
@@ -0,0 +1,167 @@
+/*
+*   This file is part of Luma3DS.
+*   Copyright (C) 2016-2020 Aurora Wright, TuxSH
+*
+*   SPDX-License-Identifier: (MIT OR GPL-2.0-or-later)
+*/
+
+#pragma once
+
+#include <pthread.h>
+#include <stdlib.h>
+#include <time.h>
+#include <3ds/svc.h>
+
+// Same as libctru
+#define AtomicIncrement(ptr)        __atomic_add_fetch((u32 *)(ptr), 1, __ATOMIC_SEQ_CST)
+#define AtomicDecrement(ptr)        __atomic_sub_fetch((u32 *)(ptr), 1, __ATOMIC_SEQ_CST)
+#define AtomicPostIncrement(ptr)    __atomic_fetch_add((u32 *)(ptr), 1, __ATOMIC_SEQ_CST)
+#define AtomicPostDecrement(ptr)    __atomic_fetch_sub((u32 *)(ptr), 1, __ATOMIC_SEQ_CST)
+
+typedef pthread_mutex_t LightLock;
+
+static inline void LightLock_Init(LightLock *lock)
+{
+    pthread_mutex_init(lock, NULL);
+}
+
+static inline void LightLock_Lock(LightLock *lock)
+{
+    pthread_mutex_lock(lock);
+}
+
+static inline void LightLock_Unlock(LightLock *lock)
+{
+    pthread_mutex_unlock(lock);
+}
+
+typedef pthread_mutex_t RecursiveLock;
+
+static inline void RecursiveLock_Init(RecursiveLock *lock)
+{
+    pthread_mutexattr_t attr;
+    pthread_mutexattr_init(&attr);
+    pthread_mutexattr_settype(&attr, PTHREAD_MUTEX_RECURSIVE);
+    pthread_mutex_init(lock, &attr);
+    pthread_mutexattr_destroy(&attr);
+}
+
+static inline void RecursiveLock_Lock(RecursiveLock *lock)
+{
+    pthread_mutex_lock(lock);
+}
+
+static inline void RecursiveLock_Unlock(RecursiveLock *lock)
+{
+    pthread_mutex_unlock(lock);
+}
+
+// Light events and semaphores are a mutex and a condition variable each
+
+typedef struct LightEvent
+{
+    pthread_mutex_t mutex;
+    pthread_cond_t cond;
+    bool signaled;
+    ResetType resetType;
+} LightEvent;
+
+typedef struct LightSemaphore
+{
+    pthread_mutex_t mutex;
+    pthread_cond_t cond;
+    s32 count;
+    s16 maxCount;
+} LightSemaphore;
+
+static inline void LightEvent_Init(LightEvent *event, ResetType resetType)
+{
+    pthread_mutex_init(&event->mutex, NULL);
+    pthread_cond_init(&event->cond, NULL);
+    event->signaled = false;
+    event->resetType = resetType;
+}
+
+static inline void LightEvent_Signal(LightEvent *event)
+{
+    pthread_mutex_lock(&event->mutex);
+    event->signaled = true;
+    pthread_cond_broadcast(&event->cond);
+    pthread_mutex_unlock(&event->mutex);
+}
+
+static inline void LightEvent_Clear(LightEvent *event)
+{
+    pthread_mutex_lock(&event->mutex);
+    event->signaled = false;
+    pthread_mutex_unlock(&event->mutex);
+}
+
+// Returns 0 when signaled, 1 on timeout
+static inline int LightEvent_WaitTimeout(LightEvent *event, s64 timeout_ns)
+{
+    struct timespec deadline;
+    clock_gettime(CLOCK_REALTIME, &deadline);
+    deadline.tv_sec += timeout_ns / 1000000000LL + (deadline.tv_nsec + timeout_ns % 1000000000LL) / 1000000000LL;
+    deadline.tv_nsec = (deadline.tv_nsec + timeout_ns % 1000000000LL) % 1000000000LL;
+
+    int res = 0;
+    pthread_mutex_lock(&event->mutex);
+    while (!event->signaled && res == 0)
+        res = pthread_cond_timedwait(&event->cond, &event->mutex, &deadline);
+    bool signaled = event->signaled;
+    if (signaled && event->resetType == RESET_ONESHOT)
+        event->signaled = false;
+    pthread_mutex_unlock(&event->mutex);
+
+    return signaled ? 0 : 1;
+}
+
+static inline void LightEvent_Wait(LightEvent *event)
+{
+    pthread_mutex_lock(&event->mutex);
+    while (!event->signaled)
+        pthread_cond_wait(&event->cond, &event->mutex);
+    if (event->resetType == RESET_ONESHOT)
+        event->signaled = false;
+    pthread_mutex_unlock(&event->mutex);
+}
+
+static inline void LightSemaphore_Init(LightSemaphore *semaphore, s16 initialCount, s16 maxCount)
+{
+    pthread_mutex_init(&semaphore->mutex, NULL);
+    pthread_cond_init(&semaphore->cond, NULL);
+    semaphore->count = initialCount;
+    semaphore->maxCount = maxCount;
+}
+
+static inline void LightSemaphore_Acquire(LightSemaphore *semaphore, s32 count)
+{
+    pthread_mutex_lock(&semaphore->mutex);
+    while (semaphore->count < count)
+        pthread_cond_wait(&semaphore->cond, &semaphore->mutex);
+    semaphore->count -= count;
+    pthread_mutex_unlock(&semaphore->mutex);
+}
+
+// Returns 0 on success
+static inline int LightSemaphore_TryAcquire(LightSemaphore *semaphore, s32 count)
+{
+    pthread_mutex_lock(&semaphore->mutex);
+    int res = semaphore->count < count;
+    if (res == 0)
+        semaphore->count -= count;
+    pthread_mutex_unlock(&semaphore->mutex);
+    return res;
+}
+
+// The count is checked against the maximum, as the kernel does
+static inline void LightSemaphore_Release(LightSemaphore *semaphore, s32 count)
+{
+    pthread_mutex_lock(&semaphore->mutex);
+    if (semaphore->count + count > semaphore->maxCount)
+        abort();
+    semaphore->count += count;
+    pthread_cond_broadcast(&semaphore->cond);
+    pthread_mutex_unlock(&semaphore->mutex);
+}
@@ -0,0 +1,44 @@
+/*
+*   This file is part of Luma3DS.
+*   Copyright (C) 2016-2020 Aurora Wright, TuxSH
+*
+*   SPDX-License-Identifier: (MIT OR GPL-2.0-or-later)
+*/
+
+#pragma once
+
+// Threads are pthreads with their own stacks, the stack, priority and affinity arguments are ignored
+
+#include <pthread.h>
+#include <3ds/types.h>
+
+#define THREAD_STACK_SIZE 0x1000
+
+typedef struct MyThread
+{
+    pthread_t thread;
+    void (*ep)(void);
+} MyThread;
+
+static inline void *myThreadStart(void *arg)
+{
+    ((MyThread *)arg)->ep();
+    return NULL;
+}
+
+static inline Result MyThread_Create(MyThread *t, void (*entrypoint)(void), void *stack, u32 stackSize, int prio, int affinity)
+{
+    (void)stack;
+    (void)stackSize;
+    (void)prio;
+    (void)affinity;
+    t->ep = entrypoint;
+    return pthread_create(&t->thread, NULL, myThreadStart, t) == 0 ? 0 : -1;
+}
+
+// Always waits for the thread to exit
+static inline Result MyThread_Join(MyThread *thread, s64 timeout_ns)
+{
+    (void)timeout_ns;
+    return pthread_join(thread->thread, NULL) == 0 ? 0 : -1;
+}
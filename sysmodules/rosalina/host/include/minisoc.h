@@ -0,0 +1,82 @@
+/*
+*   This file is part of Luma3DS.
+*   Copyright (C) 2016-2020 Aurora Wright, TuxSH
+*
+*   SPDX-License-Identifier: (MIT OR GPL-2.0-or-later)
+*/
+
+#pragma once
+
+// minisoc on top of the POSIX sockets. Like minisoc, the functions return -1 on failure
+
+#include <3ds/types.h>
+#include <errno.h>
+#include <poll.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+
+static inline Result miniSocInit(void)
+{
+    return 0;
+}
+
+static inline Result miniSocExit(void)
+{
+    return 0;
+}
+
+static inline int socSocket(int domain, int type, int protocol)
+{
+    int fd = socket(domain, type, protocol);
+    if(fd != -1)
+    {
+        int yes = 1;
+        setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &yes, sizeof(yes));
+    }
+    return fd;
+}
+
+static inline int socBind(int sockfd, const struct sockaddr *addr, socklen_t addrlen)
+{
+    return bind(sockfd, addr, addrlen);
+}
+
+static inline int socListen(int sockfd, int max_connections)
+{
+    return listen(sockfd, max_connections);
+}
+
+static inline int socAccept(int sockfd, struct sockaddr *addr, socklen_t *addrlen)
+{
+    return accept(sockfd, addr, addrlen);
+}
+
+static inline int socPoll(struct pollfd *fds, nfds_t nfds, int timeout)
+{
+    return poll(fds, nfds, timeout);
+}
+
+static inline int socSetsockopt(int sockfd, int level, int optname, const void *optval, socklen_t optlen)
+{
+    return setsockopt(sockfd, level, optname, optval, optlen);
+}
+
+static inline int socClose(int sockfd)
+{
+    return close(sockfd);
+}
+
+// Set the SOCUTIL_HOST environment variable to listen on something else than the loopback interface
+long socGethostid(void);
+
+static inline ssize_t socRecv(int sockfd, void *buf, size_t len, int flags)
+{
+    return recv(sockfd, buf, len, flags);
+}
+
+static inline ssize_t socSend(int sockfd, const void *buf, size_t len, int flags)
+{
+    return send(sockfd, buf, len, flags | MSG_NOSIGNAL);
+}
@@ -0,0 +1,372 @@
+/*
+*   This file is part of Luma3DS.
+*   Copyright (C) 2016-2022 Aurora Wright, TuxSH
+*
+*   SPDX-License-Identifier: (MIT OR GPL-2.0-or-later)
+*/
+
+/* Round trip tests and benchmarks of the input record codec (source/input_record.c) on synthetic traces: idle input,
+   button mashing, touch screen drawing, analog sweeps, everything at once, and random registers as the worst case.
+   Every trace is also decoded through a window as small as the one the console keeps refilled. Malformed records must be
+   rejected, and truncated ones must not be read past their end. The start of the mixed trace is left in build/ for irtool.
+
+   Exits with status 1 if anything fails. */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include "input_record.h"
+
+#define CHECK(cond) check((cond), #cond, __LINE__)
+
+#define NUM_UPDATES     200000  // About 13 minutes of HID updates
+#define NUM_ITERATIONS  10
+
+typedef enum TraceKind
+{
+    TRACE_IDLE,
+    TRACE_BUTTONS,
+    TRACE_TOUCH,
+    TRACE_ANALOG,
+    TRACE_MIXED,
+    TRACE_RANDOM,
+    TRACE_COUNT,
+} TraceKind;
+
+static const char *traceNames[TRACE_COUNT] = { "idle", "buttons", "touch", "analog", "mixed", "random" };
+
+static bool failed;
+static u32 rngState = 1;
+
+static void check(bool cond, const char *what, int line)
+{
+    if (!cond)
+    {
+        printf("    line %d: %s\n", line, what);
+        failed = true;
+    }
+}
+
+static u32 rng(void)
+{
+    rngState = rngState * 1103515245 + 12345;
+    return rngState >> 8;
+}
+
+static double now(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static u32 packXY(u32 x, u32 y, u32 high)
+{
+    return high << 24 | (y & 0xFFF) << 12 | (x & 0xFFF);
+}
+
+// Buttons are held for a few dozen updates, as when playing; the pad register is active low
+static void genButtons(InputState *s, u32 *held, u32 *holdLeft)
+{
+    if (*holdLeft == 0)
+    {
+        *held = rng() % 3 == 0 ? 0 : (1u << (rng() % 12)) | (rng() % 4 == 0 ? 1u << (rng() % 12) : 0);
+        *holdLeft = 4 + rng() % 40;
+    }
+
+    (*holdLeft)--;
+    s->pad = 0xFFF & ~*held;
+}
+
+static void genTouch(InputState *s, u32 i)
+{
+    // Strokes of 200 updates, lifting the stylus in between
+    if (i % 300 < 200)
+    {
+        double t = i / 37.0;
+        s->touch = packXY((u32)(2048 + 1500 * sin(t)), (u32)(2048 + 1200 * cos(t * 0.7)), 0x01);
+    }
+}
+
+static void genAnalog(InputState *s, u32 i)
+{
+    double t = i / 250.0;
+
+    // Sweeps with the noise of the ADC
+    s->circlePad = packXY((u32)(0x7FF + 1400 * sin(t)) + rng() % 3, (u32)(0x7F7 + 1400 * cos(t)) + rng() % 3, 0);
+    if ((i / 1000) % 2 == 0)
+        s->cStick = (u32)(u8)(0x80 + 100 * sin(t * 3)) << 24 | (u32)(u8)(0x80 + 100 * cos(t * 3)) << 16 | 0x0081;
+}
+
+static void genTrace(InputState *trace, u32 n, TraceKind kind)
+{
+    u32 held = 0, holdLeft = 0;
+
+    rngState = kind + 1;
+    for (u32 i = 0; i < n; i++)
+    {
+        InputState *s = &trace[i];
+        *s = INPUT_STATE_IDLE;
+
+        switch (kind)
+        {
+            case TRACE_BUTTONS:
+                genButtons(s, &held, &holdLeft);
+                break;
+            case TRACE_TOUCH:
+                genTouch(s, i);
+                break;
+            case TRACE_ANALOG:
+                genAnalog(s, i);
+                break;
+            case TRACE_MIXED:
+                genButtons(s, &held, &holdLeft);
+                genTouch(s, i);
+                genAnalog(s, i);
+                break;
+            case TRACE_RANDOM:
+                s->pad = rng() ^ rng() << 16;
+                s->touch = rng() ^ rng() << 16;
+                s->circlePad = rng() ^ rng() << 16;
+                s->cStick = rng() ^ rng() << 16;
+                break;
+            default:
+                break;
+        }
+    }
+}
+
+static u32 encodeTrace(const InputState *trace, u32 n, u8 *out, u32 *maxUpdateSize)
+{
+    InputRecordEncoder enc;
+    u32 size = 0;
+
+    InputRecord_InitEncoder(&enc);
+    for (u32 i = 0; i < n; i++)
+    {
+        u32 written = InputRecord_Encode(&enc, &trace[i], out + size);
+        *maxUpdateSize = written > *maxUpdateSize ? written : *maxUpdateSize;
+        size += written;
+    }
+
+    u32 written = InputRecord_Flush(&enc, out + size);
+    *maxUpdateSize = written > *maxUpdateSize ? written : *maxUpdateSize;
+    return size + written;
+}
+
+// Decodes the whole buffer, which must end exactly after the last update. Returns the number of updates decoded.
+static u32 decodeTrace(const u8 *data, u32 size, InputState *out, u32 maxUpdates)
+{
+    InputRecordDecoder dec;
+    u32 pos = 0, n = 0;
+
+    InputRecord_InitDecoder(&dec);
+    while (n < maxUpdates && (pos < size || dec.runLeft != 0))
+    {
+        s32 consumed = InputRecord_Decode(&dec, data + pos, size - pos, &out[n]);
+        if (consumed < 0)
+            return 0;
+
+        pos += consumed;
+        n++;
+    }
+
+    return pos == size ? n : 0;
+}
+
+// Like the console: at least INPUT_RECORD_MAX_UPDATE_SIZE bytes are available unless at the end, never more than the window
+static bool decodeWindowed(const u8 *data, u32 size, const InputState *expected, u32 n)
+{
+    InputRecordDecoder dec;
+    u8 window[INPUT_RECORD_MAX_UPDATE_SIZE + 7];
+    u32 pos = 0;
+
+    InputRecord_InitDecoder(&dec);
+    for (u32 i = 0; i < n; i++)
+    {
+        u32 avail = size - pos < sizeof(window) ? size - pos : sizeof(window);
+        InputState s;
+
+        memcpy(window, data + pos, avail);
+        s32 consumed = InputRecord_Decode(&dec, window, avail, &s);
+        if (consumed < 0 || memcmp(&s, &expected[i], sizeof(InputState)) != 0)
+            return false;
+        pos += consumed;
+    }
+
+    return pos == size;
+}
+
+static void testTraces(InputState *trace, InputState *decoded, u8 *buf)
+{
+    printf("%-8s %9s %10s %7s %8s %12s %12s\n", "trace", "updates", "bytes", "B/upd", "ratio", "encode Mu/s", "decode Mu/s");
+
+    for (TraceKind kind = 0; kind < TRACE_COUNT; kind++)
+    {
+        u32 maxUpdateSize = 0, size = 0;
+        double t0, encodeTime, decodeTime;
+
+        genTrace(trace, NUM_UPDATES, kind);
+
+        t0 = now();
+        for (u32 it = 0; it < NUM_ITERATIONS; it++)
+            size = encodeTrace(trace, NUM_UPDATES, buf, &maxUpdateSize);
+        encodeTime = (now() - t0) / NUM_ITERATIONS;
+
+        u32 numDecoded = 0;
+        t0 = now();
+        for (u32 it = 0; it < NUM_ITERATIONS; it++)
+            numDecoded = decodeTrace(buf, size, decoded, NUM_UPDATES);
+        decodeTime = (now() - t0) / NUM_ITERATIONS;
+
+        printf("%-8s %9u %10u %7.3f %7.1fx %12.1f %12.1f\n", traceNames[kind], NUM_UPDATES, size, (double)size / NUM_UPDATES,
+            16.0 * NUM_UPDATES / size, NUM_UPDATES / encodeTime / 1e6, NUM_UPDATES / decodeTime / 1e6);
+
+        CHECK(maxUpdateSize <= INPUT_RECORD_MAX_UPDATE_SIZE);
+        CHECK(numDecoded == NUM_UPDATES);
+        CHECK(memcmp(trace, decoded, sizeof(InputState) * NUM_UPDATES) == 0);
+        CHECK(decodeWindowed(buf, size, trace, NUM_UPDATES));
+    }
+}
+
+static void testRuns(u8 *buf)
+{
+    static const u32 lengths[] = { 1, 2, 15, 16, 17, 127 + 16, 128 + 16, 100000 };
+    static InputState trace[100002], decoded[100002];
+
+    printf("runs of identical updates\n");
+    for (u32 i = 0; i < sizeof(lengths) / sizeof(lengths[0]); i++)
+    {
+        u32 maxUpdateSize = 0, n = lengths[i] + 2;
+
+        // Changed update, run, changed update
+        for (u32 j = 0; j < n; j++)
+            trace[j] = INPUT_STATE_IDLE;
+        trace[0].pad = trace[n - 1].pad = 0xFFE;
+
+        u32 size = encodeTrace(trace, n, buf, &maxUpdateSize);
+        CHECK(decodeTrace(buf, size, decoded, n) == n);
+        CHECK(memcmp(trace, decoded, sizeof(InputState) * n) == 0);
+    }
+
+    // The encoder splits runs before their length overflows
+    InputRecordEncoder enc;
+    InputState idle = INPUT_STATE_IDLE;
+    InputRecord_InitEncoder(&enc);
+    enc.pendingRun = 0xFFFFFFFD;
+    CHECK(InputRecord_Encode(&enc, &idle, buf) == 0);
+    u32 size = InputRecord_Encode(&enc, &idle, buf);
+    CHECK(size > 0 && size <= INPUT_RECORD_MAX_UPDATE_SIZE && enc.pendingRun == 0);
+
+    InputRecordDecoder dec;
+    InputState s;
+    InputRecord_InitDecoder(&dec);
+    CHECK(InputRecord_Decode(&dec, buf, size, &s) == (s32)size && dec.runLeft == 0xFFFFFFFE);
+}
+
+static void testMalformed(const InputState *trace, u8 *buf)
+{
+    static InputState decoded[1000];
+    u32 maxUpdateSize = 0;
+
+    printf("malformed records\n");
+
+    // Truncated records: whatever is decoded, never read past the end
+    u32 size = encodeTrace(trace, 1000, buf, &maxUpdateSize);
+    for (u32 cut = 0; cut < size; cut++)
+    {
+        u8 *copy = malloc(cut > 0 ? cut : 1); // so that ASan catches overreads
+        InputRecordDecoder dec;
+        u32 pos = 0;
+        s32 consumed = 0;
+
+        memcpy(copy, buf, cut);
+        InputRecord_InitDecoder(&dec);
+        for (u32 i = 0; i < 1000 && consumed >= 0 && (pos < cut || dec.runLeft != 0); i++)
+        {
+            consumed = InputRecord_Decode(&dec, copy + pos, cut - pos, &decoded[i]);
+            pos += consumed > 0 ? consumed : 0;
+        }
+
+        CHECK(pos <= cut);
+        free(copy);
+    }
+
+    // Nothing to decode
+    InputRecordDecoder dec;
+    InputState s;
+    InputRecord_InitDecoder(&dec);
+    CHECK(InputRecord_Decode(&dec, buf, 0, &s) == -1);
+
+    // Varints longer than 32 bits
+    static const u8 padOverflow[] = { INPUT_FIELD_PAD, 0xFF, 0xFF, 0xFF, 0xFF, 0x1F };
+    static const u8 padTooLong[] = { INPUT_FIELD_PAD, 0x80, 0x80, 0x80, 0x80, 0x80, 0x00 };
+    static const u8 runOverflow[] = { 0xF0, 0xF0, 0xFF, 0xFF, 0xFF, 0x0F };
+    static const u8 padMax[] = { INPUT_FIELD_PAD, 0xFF, 0xFF, 0xFF, 0xFF, 0x0F };
+
+    InputRecord_InitDecoder(&dec);
+    CHECK(InputRecord_Decode(&dec, padOverflow, sizeof(padOverflow), &s) == -1);
+    InputRecord_InitDecoder(&dec);
+    CHECK(InputRecord_Decode(&dec, padTooLong, sizeof(padTooLong), &s) == -1);
+    InputRecord_InitDecoder(&dec);
+    CHECK(InputRecord_Decode(&dec, runOverflow, sizeof(runOverflow), &s) == -1);
+    InputRecord_InitDecoder(&dec);
+    CHECK(InputRecord_Decode(&dec, padMax, sizeof(padMax), &s) == sizeof(padMax) && s.pad == ~0xFFFu);
+
+    // Missing optional bytes
+    static const u8 touchNoHigh[] = { INPUT_FIELD_TOUCH | INPUT_EXTRA_TOUCH_HIGH, 0x02, 0x02 };
+    static const u8 cStickNoLow[] = { INPUT_FIELD_CSTICK | INPUT_EXTRA_CSTICK_LOW, 0x02, 0x02, 0x81 };
+    InputRecord_InitDecoder(&dec);
+    CHECK(InputRecord_Decode(&dec, touchNoHigh, sizeof(touchNoHigh), &s) == -1);
+    InputRecord_InitDecoder(&dec);
+    CHECK(InputRecord_Decode(&dec, cStickNoLow, sizeof(cStickNoLow), &s) == -1);
+}
+
+// Same layout as source/input_recorder.c
+static void writeRecording(const char *path, const InputState *trace, u32 n, u8 *buf)
+{
+    InputRecordHeader header = { 0 };
+    u32 maxUpdateSize = 0;
+    FILE *f = fopen(path, "wb");
+
+    if (f == NULL)
+    {
+        perror(path);
+        failed = true;
+        return;
+    }
+
+    header.magic = INPUT_RECORD_MAGIC;
+    header.version = INPUT_RECORD_VERSION;
+    header.titleId = 0x0004000000030800ULL;
+    header.numUpdates = n;
+    header.durationMs = n * 4;
+    header.dataSize = encodeTrace(trace, n, buf, &maxUpdateSize);
+
+    fwrite(&header, sizeof(header), 1, f);
+    fwrite(buf, 1, header.dataSize, f);
+    fclose(f);
+}
+
+int main(void)
+{
+    InputState *trace = malloc(sizeof(InputState) * NUM_UPDATES);
+    InputState *decoded = malloc(sizeof(InputState) * NUM_UPDATES);
+    u8 *buf = malloc((size_t)INPUT_RECORD_MAX_UPDATE_SIZE * NUM_UPDATES);
+
+    testTraces(trace, decoded, buf);
+    testRuns(buf);
+
+    genTrace(trace, NUM_UPDATES, TRACE_MIXED);
+    testMalformed(trace, buf);
+    writeRecording("build/mixed.lirc", trace, 5000, buf);
+
+    printf("%s\n", failed ? "FAILED" : "ok");
+
+    free(trace);
+    free(decoded);
+    free(buf);
+    return failed ? 1 : 0;
+}
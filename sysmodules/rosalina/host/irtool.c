@@ -0,0 +1,251 @@
+/*
+*   This file is part of Luma3DS.
+*   Copyright (C) 2016-2022 Aurora Wright, TuxSH
+*
+*   SPDX-License-Identifier: (MIT OR GPL-2.0-or-later)
+*/
+
+/* Inspects and builds the input recordings Rosalina writes to /luma/inputs/<title ID>.lirc:
+       irtool info FILE                    header and statistics of the records
+       irtool dump FILE                    "update pad touch circle-pad C-stick" for each update that changed, and the last one
+       irtool encode TEXT FILE [TITLE ID]  the reverse of dump, e.g. to script a benchmark scenario
+*/
+
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "input_record.h"
+
+typedef struct IrFile
+{
+    InputRecordHeader header;
+    u8 *data;
+} IrFile;
+
+static const char *load(IrFile *f, const char *path)
+{
+    FILE *file = fopen(path, "rb");
+    long size;
+
+    if (file == NULL)
+        return "can't open the file";
+
+    fseek(file, 0, SEEK_END);
+    size = ftell(file);
+    fseek(file, 0, SEEK_SET);
+
+    if (size < (long)sizeof(InputRecordHeader) || fread(&f->header, sizeof(InputRecordHeader), 1, file) != 1)
+    {
+        fclose(file);
+        return "too small";
+    }
+
+    if (f->header.magic != INPUT_RECORD_MAGIC || f->header.version != INPUT_RECORD_VERSION)
+    {
+        fclose(file);
+        return "not an input recording";
+    }
+
+    if ((u64)sizeof(InputRecordHeader) + f->header.dataSize > (u64)size)
+    {
+        fclose(file);
+        return "truncated";
+    }
+
+    f->data = malloc(f->header.dataSize + 1);
+    if (fread(f->data, 1, f->header.dataSize, file) != f->header.dataSize)
+    {
+        free(f->data);
+        fclose(file);
+        return "read error";
+    }
+
+    fclose(file);
+    return NULL;
+}
+
+// Calls fn for each update; stops and returns false on malformed records
+static bool forEachUpdate(const IrFile *f, void (*fn)(u32 index, const InputState *state, const InputState *prev, void *arg), void *arg)
+{
+    InputRecordDecoder dec;
+    InputState state, prev = INPUT_STATE_IDLE;
+    u32 pos = 0;
+
+    InputRecord_InitDecoder(&dec);
+    for (u32 i = 0; i < f->header.numUpdates; i++)
+    {
+        s32 n = InputRecord_Decode(&dec, f->data + pos, f->header.dataSize - pos, &state);
+        if (n < 0)
+        {
+            fprintf(stderr, "malformed records at update %u, offset %u\n", i, pos);
+            return false;
+        }
+
+        pos += n;
+        fn(i, &state, &prev, arg);
+        prev = state;
+    }
+
+    if (pos != f->header.dataSize)
+    {
+        fprintf(stderr, "%u bytes of records left after the last update\n", f->header.dataSize - pos);
+        return false;
+    }
+
+    return true;
+}
+
+typedef struct Stats
+{
+    u32 numChanged;
+    u32 fieldChanges[4];
+} Stats;
+
+static void countChanges(u32 index, const InputState *state, const InputState *prev, void *arg)
+{
+    Stats *stats = (Stats *)arg;
+    const u32 *cur = &state->pad, *old = &prev->pad;
+    bool changed = false;
+
+    (void)index;
+    for (u32 i = 0; i < 4; i++)
+    {
+        if (cur[i] != old[i])
+        {
+            stats->fieldChanges[i]++;
+            changed = true;
+        }
+    }
+
+    stats->numChanged += changed;
+}
+
+static int info(const IrFile *f)
+{
+    const InputRecordHeader *h = &f->header;
+    Stats stats = { 0 };
+
+    printf("title ID        %016" PRIX64 "\n", h->titleId);
+    printf("updates         %u", h->numUpdates);
+    if (h->durationMs != 0)
+        printf(" in %u.%03u s (%.1f Hz)", h->durationMs / 1000, h->durationMs % 1000, 1000.0 * h->numUpdates / h->durationMs);
+    printf("\ndropped         %u\n", h->numDroppedUpdates);
+    printf("records         %u bytes", h->dataSize);
+    if (h->numUpdates != 0)
+        printf(", %.3f per update (%.1fx smaller than raw)", (double)h->dataSize / h->numUpdates, 16.0 * h->numUpdates / (h->dataSize ? h->dataSize : 1));
+    printf("\n");
+
+    if (!forEachUpdate(f, countChanges, &stats))
+        return 1;
+
+    printf("changed         %u updates: pad %u, touch %u, circle pad %u, C-stick %u\n", stats.numChanged,
+           stats.fieldChanges[0], stats.fieldChanges[1], stats.fieldChanges[2], stats.fieldChanges[3]);
+    return 0;
+}
+
+static void dumpUpdate(u32 index, const InputState *state, const InputState *prev, void *arg)
+{
+    const IrFile *f = (const IrFile *)arg;
+
+    if (index == 0 || index == f->header.numUpdates - 1 || memcmp(state, prev, sizeof(InputState)) != 0)
+        printf("%u %08X %08X %08X %08X\n", index, state->pad, state->touch, state->circlePad, state->cStick);
+}
+
+static int dump(const IrFile *f)
+{
+    return forEachUpdate(f, dumpUpdate, (void *)f) ? 0 : 1;
+}
+
+// Updates missing from the text repeat the previous one
+static int encode(const char *textPath, const char *path, u64 titleId)
+{
+    FILE *text = fopen(textPath, "r"), *out;
+    InputRecordHeader header = { 0 };
+    InputRecordEncoder enc;
+    InputState state = INPUT_STATE_IDLE, next;
+    u8 buf[INPUT_RECORD_MAX_UPDATE_SIZE];
+    u32 index, line = 0;
+    int ret = 0;
+
+    if (text == NULL || (out = fopen(path, "wb")) == NULL)
+    {
+        perror(text == NULL ? textPath : path);
+        if (text != NULL)
+            fclose(text);
+        return 2;
+    }
+
+    header.magic = INPUT_RECORD_MAGIC;
+    header.version = INPUT_RECORD_VERSION;
+    header.titleId = titleId;
+    fwrite(&header, sizeof(header), 1, out);
+
+    InputRecord_InitEncoder(&enc);
+    for (;;)
+    {
+        int n = fscanf(text, "%u %x %x %x %x", &index, &next.pad, &next.touch, &next.circlePad, &next.cStick);
+        if (n == EOF)
+            break;
+
+        line++;
+        if (n != 5 || (header.numUpdates != 0 && index < header.numUpdates) || index == 0xFFFFFFFF)
+        {
+            fprintf(stderr, "%s:%u: expected increasing \"update pad touch circle-pad C-stick\"\n", textPath, line);
+            ret = 1;
+            break;
+        }
+
+        for (; header.numUpdates < index; header.numUpdates++)
+        {
+            u32 size = InputRecord_Encode(&enc, &state, buf);
+            header.dataSize += fwrite(buf, 1, size, out);
+        }
+
+        state = next;
+        u32 size = InputRecord_Encode(&enc, &state, buf);
+        header.dataSize += fwrite(buf, 1, size, out);
+        header.numUpdates++;
+    }
+
+    u32 size = InputRecord_Flush(&enc, buf);
+    header.dataSize += fwrite(buf, 1, size, out);
+
+    fseek(out, 0, SEEK_SET);
+    fwrite(&header, sizeof(header), 1, out);
+    fclose(out);
+    fclose(text);
+
+    if (ret == 0)
+        printf("%u updates, %u bytes of records\n", header.numUpdates, header.dataSize);
+    return ret;
+}
+
+static int usage(void)
+{
+    fprintf(stderr, "usage: irtool info FILE | irtool dump FILE | irtool encode TEXT FILE [TITLE ID]\n");
+    return 2;
+}
+
+int main(int argc, char *argv[])
+{
+    IrFile f;
+    const char *err;
+    int ret;
+
+    if (argc >= 4 && argc <= 5 && strcmp(argv[1], "encode") == 0)
+        return encode(argv[2], argv[3], argc == 5 ? strtoull(argv[4], NULL, 16) : 0);
+    else if (argc != 3 || (strcmp(argv[1], "info") != 0 && strcmp(argv[1], "dump") != 0))
+        return usage();
+
+    err = load(&f, argv[2]);
+    if (err != NULL)
+    {
+        fprintf(stderr, "%s: %s\n", argv[2], err);
+        return 2;
+    }
+
+    ret = strcmp(argv[1], "info") == 0 ? info(&f) : dump(&f);
+    free(f.data);
+    return ret;
+}
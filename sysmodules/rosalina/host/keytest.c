@@ -0,0 +1,150 @@
+/*
+*   This file is part of Luma3DS.
+*   Copyright (C) 2016-2022 Aurora Wright, TuxSH
+*
+*   SPDX-License-Identifier: (MIT OR GPL-2.0-or-later)
+*/
+
+/* Checks the menu key repeat (key_repeat.c) against scripted key presses scanned at the rates the menus can see:
+   every HID update, every frame, irregularly, or with long gaps. Repeats must start after the delay and then come
+   every interval whatever the scan rate, without drifting, and pressing or changing keys must restart the delay.
+   Times are in ms here, the menus use system ticks.
+
+   Exits with status 1 if anything doesn't match.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include "key_repeat.h"
+
+#define KEY_A       1
+#define KEY_B       2
+
+#define DELAY       200
+#define INTERVAL    100
+#define HOLD_TIME   5000
+
+static KeyRepeat repeat;
+static bool failed;
+
+static void expect(const char *name, bool ok)
+{
+    if (!ok)
+    {
+        printf("    %s: FAILED\n", name);
+        failed = true;
+    }
+}
+
+// Holds keys (pressed at start) until end, scanning every step ms (random steps from 1 to -step if negative).
+// Each repeat must come at the first scan at or after when it is due; returns the number of repeats.
+static u32 hold(const char *name, u32 keys, u64 start, u64 end, s32 step)
+{
+    u32 numRepeats = 0;
+    u64 due = start + DELAY;
+    bool ok = KeyRepeat_Update(&repeat, keys, keys, start) == 0;
+
+    for (u64 now = start + (step > 0 ? step : 1); now <= end; now += step > 0 ? step : 1 + rand() % -step)
+    {
+        u32 repeated = KeyRepeat_Update(&repeat, 0, keys, now);
+        if (repeated != 0)
+        {
+            ok = ok && repeated == keys && now >= due && now - due < (u64)(step > 0 ? step : -step);
+            due += INTERVAL;
+            numRepeats++;
+        }
+        else
+            ok = ok && now < due;
+    }
+
+    expect(name, ok);
+    return numRepeats;
+}
+
+static void testScanRates(void)
+{
+    static const s32 steps[] = { 1, 4, 16, 17, 33, -20, -60 };
+
+    printf("Scan rates:\n");
+    KeyRepeat_Configure(&repeat, DELAY, INTERVAL);
+
+    for (u32 i = 0; i < sizeof(steps) / sizeof(steps[0]); i++)
+    {
+        u32 numRepeats = hold("on schedule", KEY_A, 1000, 1000 + HOLD_TIME, steps[i]);
+        u32 expected = (HOLD_TIME - DELAY) / INTERVAL + 1;
+
+        // The last one is missed if no scan happens between it being due and the release
+        expect("no drift", numRepeats == expected || (steps[i] != 1 && numRepeats == expected - 1));
+        expect("released", KeyRepeat_Update(&repeat, 0, 0, 1000 + HOLD_TIME + 1) == 0 && repeat.heldKeys == 0);
+    }
+}
+
+static void testRestarts(void)
+{
+    printf("Restarts:\n");
+    KeyRepeat_Configure(&repeat, DELAY, INTERVAL);
+
+    // Held, then pressed again: the delay starts over from the new press
+    KeyRepeat_Update(&repeat, KEY_A, KEY_A, 0);
+    expect("repeating", KeyRepeat_Update(&repeat, 0, KEY_A, DELAY) == KEY_A);
+    expect("pressed again", KeyRepeat_Update(&repeat, KEY_A, KEY_A, DELAY + 50) == 0);
+    expect("new delay", KeyRepeat_Update(&repeat, 0, KEY_A, DELAY + INTERVAL) == 0 &&
+        KeyRepeat_Update(&repeat, 0, KEY_A, 2 * DELAY + 49) == 0 && KeyRepeat_Update(&repeat, 0, KEY_A, 2 * DELAY + 50) == KEY_A);
+
+    // A second key joining or one leaving restarts the delay, with both or the one left repeated
+    expect("joined", KeyRepeat_Update(&repeat, 0, KEY_A | KEY_B, 1000) == 0 && KeyRepeat_Update(&repeat, 0, KEY_A | KEY_B, 1000 + DELAY - 1) == 0);
+    expect("both repeated", KeyRepeat_Update(&repeat, 0, KEY_A | KEY_B, 1000 + DELAY) == (KEY_A | KEY_B));
+    expect("left", KeyRepeat_Update(&repeat, 0, KEY_B, 1250) == 0 && KeyRepeat_Update(&repeat, 0, KEY_B, 1250 + DELAY) == KEY_B);
+
+    // Released between two scans
+    KeyRepeat_Update(&repeat, 0, 0, 2000);
+    expect("restarted after release", KeyRepeat_Update(&repeat, 0, KEY_B, 2010) == 0 && KeyRepeat_Update(&repeat, 0, KEY_B, 2010 + DELAY) == KEY_B);
+
+    // Configuring forgets the held keys
+    KeyRepeat_Configure(&repeat, DELAY, INTERVAL);
+    expect("configured", KeyRepeat_Update(&repeat, 0, KEY_B, 2010 + DELAY + INTERVAL) == 0);
+}
+
+static void testGaps(void)
+{
+    printf("Gaps:\n");
+    KeyRepeat_Configure(&repeat, DELAY, INTERVAL);
+
+    // No scan for a second while held: one repeat, then on schedule from there, not a burst to catch up
+    KeyRepeat_Update(&repeat, KEY_A, KEY_A, 0);
+    expect("first", KeyRepeat_Update(&repeat, 0, KEY_A, DELAY) == KEY_A);
+    expect("after the gap", KeyRepeat_Update(&repeat, 0, KEY_A, DELAY + 1000) == KEY_A);
+    expect("no burst", KeyRepeat_Update(&repeat, 0, KEY_A, DELAY + 1001) == 0 && KeyRepeat_Update(&repeat, 0, KEY_A, DELAY + 1000 + INTERVAL - 1) == 0);
+    expect("next", KeyRepeat_Update(&repeat, 0, KEY_A, DELAY + 1000 + INTERVAL) == KEY_A);
+}
+
+static void testSettings(void)
+{
+    printf("Settings:\n");
+
+    // Disabled, as while the menu combo is still held
+    KeyRepeat_Configure(&repeat, 0, 0);
+    u32 repeated = KeyRepeat_Update(&repeat, KEY_A, KEY_A, 0);
+    for (u64 now = 4; now <= HOLD_TIME; now += 4)
+        repeated |= KeyRepeat_Update(&repeat, 0, KEY_A, now);
+    expect("disabled", repeated == 0);
+
+    // No interval: the delay is used for both
+    KeyRepeat_Configure(&repeat, DELAY, 0);
+    KeyRepeat_Update(&repeat, KEY_A, KEY_A, 0);
+    expect("delay as interval", KeyRepeat_Update(&repeat, 0, KEY_A, DELAY) == KEY_A &&
+        KeyRepeat_Update(&repeat, 0, KEY_A, 2 * DELAY - 1) == 0 && KeyRepeat_Update(&repeat, 0, KEY_A, 2 * DELAY) == KEY_A);
+}
+
+int main(void)
+{
+    srand(1);
+
+    testScanRates();
+    testRestarts();
+    testGaps();
+    testSettings();
+
+    printf(failed ? "FAILED\n" : "ok\n");
+    return failed ? 1 : 0;
+}
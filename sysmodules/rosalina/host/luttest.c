@@ -0,0 +1,277 @@
+/*
+*   This file is part of Luma3DS.
+*   Copyright (C) 2016-2020 Aurora Wright, TuxSH
+*
+*   SPDX-License-Identifier: (MIT OR GPL-2.0-or-later)
+*/
+
+/* Checks the fixed-point screen filter LUTs (color_lut.c) against the float code they replaced, over a grid of the
+   settings the menu can produce and random ones: every entry must be exact or 1 LSB off, except where brightness
+   exactly cancels the scaled level (the float code raises its rounding noise to the gamma there). Also checks the
+   LUT cache and times both versions.
+
+   Exits with status 1 if anything doesn't match.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include "color_lut.h"
+#include "menus/screen_filters_srgb_tables.h"
+#include "redshift/colorramp.h"
+
+// At most this many entries in a million may be 1 LSB off
+#define MAX_OFF_BY_ONE_PPM  10
+
+static bool failed;
+
+static u64 numLuts, numExact, numOffByOne, numWorse, numCancelled;
+
+static void expect(const char *name, bool ok)
+{
+    if (!ok)
+    {
+        printf("    %s: FAILED\n", name);
+        failed = true;
+    }
+}
+
+static double elapsedNs(const struct timespec *start)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (now.tv_sec - start->tv_sec) * 1e9 + (now.tv_nsec - start->tv_nsec);
+}
+
+/* The float code, as it was in screen_filters.c */
+
+static u8 ScreenFilterMenu_CalculatePolynomialColorLutComponent(const float coeffs[][3], u32 component, float gamma, u32 dim, int inLevel)
+{
+    float x = inLevel / 255.0f;
+    float level = 0.0f;
+    float xN = 1.0f;
+
+    // Compute a_n * x^n + ... a_0, then clamp, then exponentiate by "gamma" and clamp again
+    for (u32 i = 0; i < dim + 1; i++)
+    {
+        level += coeffs[i][component] * xN;
+        xN *= x;
+    }
+
+    level = powf(CLAMP(level, 0.0f, 1.0f), gamma);
+    s32 levelInt = (s32)(255.0f * level + 0.5f); // round up
+    return (u8)CLAMP(levelInt, 0, 255); // clamp again just to be sure
+}
+
+static void computeFloatLut(u32 *lut, const ScreenFilter *filter)
+{
+    float wp[3];
+    colorramp_get_white_point(wp, filter->cct);
+    float a = filter->contrast;
+    float b = filter->brightness;
+    float g = filter->gamma;
+
+    float poly[][3] = {
+        { b, b, b },                            // x^0
+        { a * wp[0], a * wp[1], a * wp[2] },    // x^1
+    };
+
+    for (int i = 0; i <= 255; i++)
+    {
+        int inLevel = filter->invert ? 255 - i : i;
+        const u8 (*tbl)[3] = filter->colorCurveCorrection == 2 ? ctrToSrgbTableBottom : ctrToSrgbTableTop;
+
+        u8 inLevelR = filter->colorCurveCorrection > 0 ? tbl[inLevel][0] : inLevel;
+        u8 inLevelG = filter->colorCurveCorrection > 0 ? tbl[inLevel][1] : inLevel;
+        u8 inLevelB = filter->colorCurveCorrection > 0 ? tbl[inLevel][2] : inLevel;
+
+        lut[i] = ScreenFilterMenu_CalculatePolynomialColorLutComponent(poly, 0, g, 1, inLevelR) |
+            ScreenFilterMenu_CalculatePolynomialColorLutComponent(poly, 1, g, 1, inLevelG) << 8 |
+            ScreenFilterMenu_CalculatePolynomialColorLutComponent(poly, 2, g, 1, inLevelB) << 16;
+    }
+}
+
+/* Comparison */
+
+static void compare(const ScreenFilter *filter)
+{
+    u32 ref[256];
+    float wp[3];
+
+    computeFloatLut(ref, filter);
+    const u32 *lut = ColorLut_Get(filter);
+    colorramp_get_white_point(wp, filter->cct);
+    numLuts++;
+
+    for (u32 i = 0; i < 256; i++)
+    {
+        for (u32 c = 0; c < 3; c++)
+        {
+            int expected = (ref[i] >> (8 * c)) & 0xFF, got = (lut[i] >> (8 * c)) & 0xFF;
+            int diff = abs(expected - got);
+
+            if (diff == 0)
+                numExact++;
+            else if (diff == 1)
+                numOffByOne++;
+            else
+            {
+                u32 inLevel = filter->invert ? 255 - i : i;
+                const u8 (*tbl)[3] = filter->colorCurveCorrection == 2 ? ctrToSrgbTableBottom : ctrToSrgbTableTop;
+                u32 v = filter->colorCurveCorrection > 0 ? tbl[inLevel][c] : inLevel;
+                double level = (double)filter->brightness + (double)(filter->contrast * wp[c]) * v / 255.0;
+
+                if (fabs(level) < 1.0 / (1 << 20))
+                    numCancelled++;
+                else
+                {
+                    if (numWorse < 5)
+                        printf("    %uK gamma %.2f contrast %.2f brightness %.2f invert %d curve %u, entry %u channel %u: %d instead of %d\n",
+                            filter->cct, filter->gamma, filter->contrast, filter->brightness, filter->invert,
+                            filter->colorCurveCorrection, i, c, got, expected);
+                    numWorse++;
+                }
+            }
+        }
+    }
+}
+
+static void testAgainstFloat(void)
+{
+    printf("Against the float code:\n");
+
+    // Grid over the values the menu can produce (steps of 100K and 0.01), subsampled
+    for (u32 cct = 1000; cct <= 25100; cct += 700)
+        for (int gamma = 0; gamma <= 800; gamma += 73)
+            for (int contrast = 0; contrast <= 400; contrast += 57)
+                for (int brightness = -100; brightness <= 100; brightness += 40)
+                    for (u32 mode = 0; mode < 6; mode++)
+                    {
+                        ScreenFilter filter = { cct, mode & 1, mode >> 1, gamma / 100.0f, contrast / 100.0f, brightness / 100.0f };
+                        compare(&filter);
+                    }
+
+    srand(1);
+    for (u32 n = 0; n < 50000; n++)
+    {
+        ScreenFilter filter = { 1000 + rand() % 24100, rand() & 1, rand() % 3, (rand() % 801) / 100.0f,
+            rand() % 10 == 0 ? (rand() % 25501) / 100.0f : (rand() % 301) / 100.0f, (rand() % 201 - 100) / 100.0f };
+        compare(&filter);
+    }
+
+    u64 total = numExact + numOffByOne + numWorse;
+    printf("    %llu LUTs: %llu entries exact, %llu 1 LSB off (%.4f%%), %llu worse, %llu at cancelled levels\n",
+        (unsigned long long)numLuts, (unsigned long long)numExact, (unsigned long long)numOffByOne,
+        100.0 * numOffByOne / total, (unsigned long long)numWorse, (unsigned long long)numCancelled);
+
+    expect("at most 1 LSB off", numWorse == 0);
+    expect("rarely 1 LSB off", numOffByOne * 1000000 <= total * MAX_OFF_BY_ONE_PPM);
+}
+
+static void testCache(void)
+{
+    ScreenFilter filters[COLOR_LUT_CACHE_SIZE + 1];
+    const u32 *luts[COLOR_LUT_CACHE_SIZE + 1];
+    u32 ref[256];
+
+    printf("Cache:\n");
+
+    for (u32 i = 0; i <= COLOR_LUT_CACHE_SIZE; i++)
+        filters[i] = (ScreenFilter){ 2000 + 1000 * i, false, 0, 1.0f, 1.0f, 0.0f };
+
+    for (u32 i = 0; i < COLOR_LUT_CACHE_SIZE; i++)
+        luts[i] = ColorLut_Get(&filters[i]);
+    expect("hit", ColorLut_Get(&filters[0]) == luts[0]);
+
+    // The least recently used one (filters[1]) makes room
+    luts[COLOR_LUT_CACHE_SIZE] = ColorLut_Get(&filters[COLOR_LUT_CACHE_SIZE]);
+    expect("evicted", luts[COLOR_LUT_CACHE_SIZE] == luts[1]);
+    bool kept = true;
+    for (u32 i = 2; i < COLOR_LUT_CACHE_SIZE; i++)
+        kept = kept && ColorLut_Get(&filters[i]) == luts[i];
+    expect("others kept", kept && ColorLut_Get(&filters[0]) == luts[0]);
+
+    // Each setting is part of the key
+    ScreenFilter base = { 4200, false, 0, 1.5f, 1.2f, 0.1f };
+    ScreenFilter variants[6] = { base, base, base, base, base, base };
+    variants[0].cct = 4300;
+    variants[1].invert = true;
+    variants[2].colorCurveCorrection = 1;
+    variants[3].gamma = 1.6f;
+    variants[4].contrast = 1.3f;
+    variants[5].brightness = 0.2f;
+
+    bool keyed = true;
+    for (u32 i = 0; i < 6; i++)
+    {
+        ColorLut_Get(&base);
+        computeFloatLut(ref, &variants[i]);
+        const u32 *lut = ColorLut_Get(&variants[i]);
+        u32 numDifferent = 0;
+        for (u32 j = 0; j < 256; j++)
+            numDifferent += lut[j] != ref[j];
+        keyed = keyed && numDifferent < 4;
+    }
+    expect("keyed by all settings", keyed);
+}
+
+static void benchmark(void)
+{
+    enum { N = 20000 };
+    u32 lut[256];
+    struct timespec start;
+    volatile u32 sink = 0;
+    ScreenFilter filter = { 4200, false, 1, 2.2f, 1.0f, 0.0f };
+
+    printf("Time per LUT:\n");
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (u32 n = 0; n < N; n++)
+    {
+        filter.cct = 1000 + n % 24000;
+        computeFloatLut(lut, &filter);
+        sink += lut[n & 255];
+    }
+    double floatNs = elapsedNs(&start) / N;
+
+    // Cache misses with the same gamma, then with a new gamma each time, then hits (switching between two presets)
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (u32 n = 0; n < N; n++)
+    {
+        filter.cct = 1000 + n % 24000;
+        sink += ColorLut_Get(&filter)[n & 255];
+    }
+    double missNs = elapsedNs(&start) / N;
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (u32 n = 0; n < N; n++)
+    {
+        filter.cct = 1000 + n % 24000;
+        filter.gamma = 1.0f + (n % 700) / 100.0f;
+        sink += ColorLut_Get(&filter)[n & 255];
+    }
+    double gammaMissNs = elapsedNs(&start) / N;
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (u32 n = 0; n < N; n++)
+    {
+        filter.cct = (n & 1) ? 2700 : 6500;
+        filter.gamma = 1.0f;
+        sink += ColorLut_Get(&filter)[n & 255];
+    }
+    double hitNs = elapsedNs(&start) / N;
+
+    printf("    float %.2f us, fixed point %.2f us (same gamma), %.2f us (new gamma), cached %.3f us\n",
+        floatNs / 1000, missNs / 1000, gammaMissNs / 1000, hitNs / 1000);
+    (void)sink;
+}
+
+int main(void)
+{
+    testAgainstFloat();
+    testCache();
+    benchmark();
+
+    printf(failed ? "FAILED\n" : "ok\n");
+    return failed ? 1 : 0;
+}
@@ -0,0 +1,584 @@
+/*
+*   This file is part of Luma3DS.
+*   Copyright (C) 2016-2020 Aurora Wright, TuxSH
+*
+*   SPDX-License-Identifier: (MIT OR GPL-2.0-or-later)
+*/
+
+/* Checks the ErrDisp minidumps (minidump.c) end to end: fatal errors of a simulated process are written to the ring
+   of slots of an in-memory SD card, and each dump is checked record by record. The slots are then copied to a
+   directory and decoded with minidump.py (usage: mdtest <directory> <minidump.py>), whose report and fault buckets
+   are checked too.
+
+   Exits with status 1 if anything doesn't match.
+*/
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <3ds.h>
+#include "minidump.h"
+#include "csvc.h"
+#include "ifile.h"
+
+#define SIM_PROCESS_HANDLE  0x1234
+#define SIM_PID             0x30
+#define SIM_TITLE_ID        0x0004000000123400ULL
+#define SIM_OTHER_PID       0x31    // can't be opened, as if it had already exited
+#define SIM_OTHER_TITLE_ID  0x0004000000567800ULL
+
+#define SIM_TEXT_ADDR       0x00100000
+#define SIM_TEXT_SIZE       0x2000
+#define SIM_PC              0x00100800
+#define SIM_LR              0x00101FC1  // Thumb, close to the end of the text
+#define SIM_SP              0x0FFFFF00
+#define SIM_RETURN_ADDR     0x00100C41  // on the stack, at SP + 8
+#define SIM_ARM_RETURN_ADDR 0x00100D00  // and at SP + 0x10
+#define SIM_FAILURE_PC      0x00100ABC
+#define SIM_FAILURE_RESULT  0xC8A04567
+
+#define SIM_ERR_INVALID     MAKERESULT(RL_PERMANENT, RS_INVALIDARG, RM_KERNEL, RD_INVALID_ADDRESS)
+#define SIM_ERR_NOT_FOUND   MAKERESULT(RL_PERMANENT, RS_NOTFOUND, RM_FS, RD_NOT_FOUND)
+
+typedef struct SimRegion {
+    u32 base;
+    u32 size;
+    MemPerm perm;
+    MemState state;
+    u8 *data;
+} SimRegion;
+
+typedef struct SimFile {
+    char path[64];
+    u8 data[MINIDUMP_MAX_SIZE];
+    u32 size;
+    bool exists;
+} SimFile;
+
+static SimRegion regions[] = {
+    { SIM_TEXT_ADDR,    SIM_TEXT_SIZE,  MEMPERM_READEXECUTE,    MEMSTATE_CODE,      NULL },
+    { 0x00103000,       0x1000,         MEMPERM_READWRITE,      MEMSTATE_PRIVATE,   NULL },
+    { 0x0FFFC000,       0x4000,         MEMPERM_READWRITE,      MEMSTATE_PRIVATE,   NULL },
+};
+
+#define NUM_REGIONS (sizeof(regions) / sizeof(regions[0]))
+
+static SimFile files[MINIDUMP_NUM_SLOTS];
+static u32 numMaps, numActiveMaps;
+static bool badMap;
+static u64 simTime = 3900000000000ULL; // ms since 1900, in 2023
+static bool failed;
+
+static void expect(const char *name, bool ok)
+{
+    if (!ok)
+    {
+        printf("    %s: FAILED\n", name);
+        failed = true;
+    }
+}
+
+static SimRegion *findRegion(u32 addr)
+{
+    for (u32 i = 0; i < NUM_REGIONS; i++)
+    {
+        if (addr >= regions[i].base && addr - regions[i].base < regions[i].size)
+            return &regions[i];
+    }
+
+    return NULL;
+}
+
+/* Simulated kernel and SD card */
+
+u64 svcGetSystemTick(void)
+{
+    return simTime * (SYSCLOCK_ARM11 / 1000);
+}
+
+u64 osGetTime(void)
+{
+    return simTime;
+}
+
+Result svcOpenProcess(Handle *process, u32 processId)
+{
+    if (processId != SIM_PID)
+        return SIM_ERR_INVALID;
+
+    *process = SIM_PROCESS_HANDLE;
+    return 0;
+}
+
+Result svcCloseHandle(Handle handle)
+{
+    return handle == SIM_PROCESS_HANDLE ? 0 : SIM_ERR_INVALID;
+}
+
+Result svcQueryProcessMemory(MemInfo *info, PageInfo *out, Handle process, u32 addr)
+{
+    (void)out;
+    if (process != SIM_PROCESS_HANDLE || addr >= 0x40000000)
+        return SIM_ERR_INVALID;
+
+    SimRegion *r = findRegion(addr);
+    if (r != NULL)
+    {
+        info->base_addr = r->base;
+        info->size = r->size;
+        info->perm = r->perm;
+        info->state = r->state;
+        return 0;
+    }
+
+    // The free block around addr
+    u32 start = 0, end = 0x40000000;
+    for (u32 i = 0; i < NUM_REGIONS; i++)
+    {
+        if (regions[i].base + regions[i].size <= addr && regions[i].base + regions[i].size > start)
+            start = regions[i].base + regions[i].size;
+        if (regions[i].base > addr && regions[i].base < end)
+            end = regions[i].base;
+    }
+
+    info->base_addr = start;
+    info->size = end - start;
+    info->perm = 0;
+    info->state = MEMSTATE_FREE;
+    return 0;
+}
+
+Result svcMapProcessMemoryEx(Handle dstProcessHandle, u32 destAddress, Handle srcProcessHandle, u32 srcAddress, u32 size)
+{
+    SimRegion *r = findRegion(srcAddress);
+    if (dstProcessHandle != CUR_PROCESS_HANDLE || srcProcessHandle != SIM_PROCESS_HANDLE || r == NULL ||
+        destAddress != MINIDUMP_MAP_ADDR || size == 0 || (srcAddress & 0xFFF) != 0 || (size & 0xFFF) != 0 ||
+        size > r->size - (srcAddress - r->base))
+    {
+        badMap = true;
+        return SIM_ERR_INVALID;
+    }
+
+    // A copy is enough, the dump only reads it. Fails if the previous window wasn't unmapped
+    void *p = mmap((void *)(uintptr_t)destAddress, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_FIXED_NOREPLACE, -1, 0);
+    if (p == MAP_FAILED)
+    {
+        badMap = true;
+        return SIM_ERR_INVALID;
+    }
+
+    memcpy(p, r->data + (srcAddress - r->base), size);
+    numMaps++;
+    numActiveMaps++;
+    return 0;
+}
+
+Result svcUnmapProcessMemoryEx(Handle process, u32 destAddress, u32 size)
+{
+    if (process != CUR_PROCESS_HANDLE || numActiveMaps == 0 || munmap((void *)(uintptr_t)destAddress, size) != 0)
+    {
+        badMap = true;
+        return SIM_ERR_INVALID;
+    }
+
+    numActiveMaps--;
+    return 0;
+}
+
+Result svcGetProcessInfo(s64 *out, Handle process, u32 type)
+{
+    if (process != SIM_PROCESS_HANDLE)
+        return SIM_ERR_INVALID;
+
+    switch (type)
+    {
+        case 0x10000:
+            memset(out, 0, 8);
+            memcpy(out, "crasher", 7);
+            return 0;
+        case 0x10002: *out = SIM_TEXT_SIZE; return 0;
+        case 0x10003: *out = 0; return 0;
+        case 0x10004: *out = 0x1000; return 0;
+        case 0x10005: *out = SIM_TEXT_ADDR; return 0;
+        case 0x10006: *out = SIM_TEXT_ADDR + SIM_TEXT_SIZE; return 0;
+        case 0x10007: *out = 0x00103000; return 0;
+        default: return SIM_ERR_INVALID;
+    }
+}
+
+Result FSUSER_OpenArchive(FS_Archive *archive, FS_ArchiveID id, FS_Path path)
+{
+    (void)path;
+    *archive = id;
+    return 0;
+}
+
+Result FSUSER_CloseArchive(FS_Archive archive)
+{
+    (void)archive;
+    return 0;
+}
+
+Result FSUSER_CreateDirectory(FS_Archive archive, FS_Path path, u32 attributes)
+{
+    (void)archive;
+    (void)path;
+    (void)attributes;
+    return 0;
+}
+
+Result IFile_OpenFromArchive(IFile *file, FS_Archive archive, FS_Path filePath, u32 flags)
+{
+    (void)archive;
+    SimFile *f = NULL;
+
+    for (u32 i = 0; i < MINIDUMP_NUM_SLOTS && f == NULL; i++)
+    {
+        if (files[i].exists && strcmp(files[i].path, filePath.data) == 0)
+            f = &files[i];
+    }
+
+    if (f == NULL && (flags & FS_OPEN_CREATE))
+    {
+        for (u32 i = 0; i < MINIDUMP_NUM_SLOTS && f == NULL; i++)
+        {
+            if (!files[i].exists)
+            {
+                f = &files[i];
+                snprintf(f->path, sizeof(f->path), "%s", (const char *)filePath.data);
+                f->size = 0;
+                f->exists = true;
+            }
+        }
+    }
+
+    if (f == NULL)
+        return SIM_ERR_NOT_FOUND;
+
+    file->handle = f - files;
+    file->pos = 0;
+    file->size = f->size;
+    return 0;
+}
+
+Result IFile_Close(IFile *file)
+{
+    (void)file;
+    return 0;
+}
+
+Result IFile_SetSize(IFile *file, u64 size)
+{
+    if (size > MINIDUMP_MAX_SIZE)
+        return SIM_ERR_INVALID;
+
+    files[file->handle].size = size;
+    return 0;
+}
+
+Result IFile_Read(IFile *file, u64 *total, void *buffer, u32 len)
+{
+    SimFile *f = &files[file->handle];
+    u32 n = file->pos >= f->size ? 0 : f->size - file->pos < len ? f->size - file->pos : len;
+
+    memcpy(buffer, f->data + file->pos, n);
+    file->pos += n;
+    *total = n;
+    return 0;
+}
+
+Result IFile_Write(IFile *file, u64 *total, const void *buffer, u32 len, u32 flags)
+{
+    (void)flags;
+    SimFile *f = &files[file->handle];
+
+    if (file->pos + len > MINIDUMP_MAX_SIZE)
+        return SIM_ERR_INVALID;
+
+    memcpy(f->data + file->pos, buffer, len);
+    file->pos += len;
+    f->size = file->pos > f->size ? file->pos : f->size;
+    *total = len;
+    return 0;
+}
+
+/* Errors */
+
+static void setupProcess(void)
+{
+    for (u32 i = 0; i < NUM_REGIONS; i++)
+    {
+        regions[i].data = calloc(1, regions[i].size);
+        if (regions[i].perm & MEMPERM_EXECUTE)
+        {
+            for (u32 j = 0; j < regions[i].size; j++)
+                regions[i].data[j] = (u8)(j * 7 + 1);
+        }
+    }
+
+    u32 returnAddrs[] = { SIM_RETURN_ADDR, 0, SIM_ARM_RETURN_ADDR };
+    SimRegion *stack = findRegion(SIM_SP);
+    memcpy(stack->data + (SIM_SP + 8 - stack->base), returnAddrs, sizeof(returnAddrs));
+}
+
+static Result dataAbort(void)
+{
+    ERRF_FatalErrInfo info = { 0 };
+
+    info.type = ERRF_ERRTYPE_EXCEPTION;
+    info.procId = SIM_PID;
+    info.titleId = SIM_TITLE_ID;
+    info.appTitleId = SIM_TITLE_ID;
+    info.data.exception_data.excep.type = ERRF_EXCEPTION_DATA_ABORT;
+    info.data.exception_data.excep.fsr = 0x805;
+    info.data.exception_data.excep.far = 0x4;
+    for (u32 i = 0; i < 13; i++)
+        info.data.exception_data.regs.r[i] = i;
+    info.data.exception_data.regs.sp = SIM_SP;
+    info.data.exception_data.regs.lr = SIM_LR;
+    info.data.exception_data.regs.pc = SIM_PC;
+    info.data.exception_data.regs.cpsr = 0x10;
+
+    simTime += 60000;
+    return MiniDump_Write(ARCHIVE_SDMC, &info, "");
+}
+
+static Result failure(void)
+{
+    ERRF_FatalErrInfo info = { 0 };
+
+    info.type = ERRF_ERRTYPE_FAILURE;
+    info.resCode = SIM_FAILURE_RESULT;
+    info.pcAddr = SIM_FAILURE_PC;
+    info.procId = SIM_OTHER_PID;
+    info.titleId = SIM_OTHER_TITLE_ID;
+    snprintf(info.data.failure_mesg, sizeof(info.data.failure_mesg), "assertion failed");
+
+    simTime += 60000;
+    return MiniDump_Write(ARCHIVE_SDMC, &info, "from pm");
+}
+
+static const SimFile *slotFile(u32 slot)
+{
+    char path[64];
+    snprintf(path, sizeof(path), MINIDUMP_DIR_PATH "/minidump_%02u.dmp", slot);
+
+    for (u32 i = 0; i < MINIDUMP_NUM_SLOTS; i++)
+    {
+        if (files[i].exists && strcmp(files[i].path, path) == 0)
+            return &files[i];
+    }
+
+    return NULL;
+}
+
+static const MiniDumpRecordHeader *findRecord(const SimFile *f, MiniDumpRecordType type, u32 index)
+{
+    const MiniDumpHeader *header = (const MiniDumpHeader *)f->data;
+    const u8 *pos = f->data + sizeof(MiniDumpHeader);
+
+    for (u32 i = 0; i < header->numRecords && pos + sizeof(MiniDumpRecordHeader) <= f->data + f->size; i++)
+    {
+        const MiniDumpRecordHeader *hdr = (const MiniDumpRecordHeader *)pos;
+        if (hdr->type == (u32)type && index-- == 0)
+            return hdr;
+        pos += sizeof(MiniDumpRecordHeader) + ((hdr->size + 7) & ~7);
+    }
+
+    return NULL;
+}
+
+// The captured memory must be the process's, within the region of the anchor
+static bool memoryMatches(const MiniDumpMemory *mem, u32 start, u32 end, MiniDumpMemoryKind kind)
+{
+    SimRegion *r = findRegion(start);
+    return mem != NULL && mem->address == start && mem->size == end - start && mem->kind == (u32)kind && r != NULL &&
+        memcmp(mem + 1, r->data + (start - r->base), end - start) == 0;
+}
+
+static void checkAbort(u32 slot, u32 sequence)
+{
+    const SimFile *f = slotFile(slot);
+    expect("slot written", f != NULL);
+    if (f == NULL)
+        return;
+
+    const MiniDumpHeader *header = (const MiniDumpHeader *)f->data;
+    expect("header", header->magic == MINIDUMP_MAGIC && header->version == MINIDUMP_VERSION && header->size == f->size);
+    expect("sequence", header->sequence == sequence);
+    expect("timestamp", header->timestamp == simTime);
+    expect("number of records", header->numRecords == 7);
+
+    const MiniDumpRecordHeader *hdr = findRecord(f, MINIDUMP_RECORD_CRASH_REASON, 0);
+    const MiniDumpCrashReason *reason = (const MiniDumpCrashReason *)(hdr + 1);
+    expect("crash reason", hdr != NULL && hdr->size == sizeof(MiniDumpCrashReason) &&
+        reason->errorType == ERRF_ERRTYPE_EXCEPTION && reason->exceptionType == ERRF_EXCEPTION_DATA_ABORT &&
+        reason->pcAddr == SIM_PC && reason->fsr == 0x805 && reason->far == 0x4);
+
+    hdr = findRecord(f, MINIDUMP_RECORD_PROCESS, 0);
+    const MiniDumpProcess *proc = (const MiniDumpProcess *)(hdr + 1);
+    expect("process", hdr != NULL && proc->pid == SIM_PID && proc->titleId == SIM_TITLE_ID &&
+        strncmp(proc->name, "crasher", 8) == 0 && proc->textAddr == SIM_TEXT_ADDR && proc->textSize == SIM_TEXT_SIZE);
+
+    hdr = findRecord(f, MINIDUMP_RECORD_REGISTERS, 0);
+    const CpuRegisters *regs = (const CpuRegisters *)(hdr + 1);
+    expect("registers", hdr != NULL && regs->r[12] == 12 && regs->sp == SIM_SP && regs->lr == SIM_LR && regs->pc == SIM_PC);
+
+    // Around PC, around LR but clipped to the end of the text, and the stack up to the end of its region
+    hdr = findRecord(f, MINIDUMP_RECORD_MEMORY, 0);
+    expect("memory around PC", hdr != NULL && memoryMatches((const MiniDumpMemory *)(hdr + 1),
+        SIM_PC - MINIDUMP_CODE_SIZE / 2, SIM_PC + MINIDUMP_CODE_SIZE / 2, MINIDUMP_MEMORY_PC));
+    hdr = findRecord(f, MINIDUMP_RECORD_MEMORY, 1);
+    expect("memory around LR", hdr != NULL && memoryMatches((const MiniDumpMemory *)(hdr + 1),
+        (SIM_LR & ~1) - MINIDUMP_CODE_SIZE / 2, SIM_TEXT_ADDR + SIM_TEXT_SIZE, MINIDUMP_MEMORY_LR));
+    hdr = findRecord(f, MINIDUMP_RECORD_MEMORY, 2);
+    expect("stack", hdr != NULL && memoryMatches((const MiniDumpMemory *)(hdr + 1), SIM_SP, 0x10000000, MINIDUMP_MEMORY_STACK));
+
+    hdr = findRecord(f, MINIDUMP_RECORD_MEMORY_MAP, 0);
+    const MiniDumpMemoryMapEntry *map = (const MiniDumpMemoryMapEntry *)(hdr + 1);
+    bool mapOk = hdr != NULL && hdr->size == NUM_REGIONS * sizeof(MiniDumpMemoryMapEntry);
+    for (u32 i = 0; mapOk && i < NUM_REGIONS; i++)
+    {
+        mapOk = map[i].baseAddr == regions[i].base && map[i].size == regions[i].size &&
+            map[i].perm == (u8)regions[i].perm && map[i].state == (u8)regions[i].state;
+    }
+    expect("memory map", mapOk);
+
+    expect("no user string", findRecord(f, MINIDUMP_RECORD_USER_STRING, 0) == NULL);
+    expect("windows unmapped", numActiveMaps == 0 && !badMap);
+}
+
+static void checkFailure(u32 slot, u32 sequence)
+{
+    const SimFile *f = slotFile(slot);
+    expect("slot written", f != NULL);
+    if (f == NULL)
+        return;
+
+    const MiniDumpHeader *header = (const MiniDumpHeader *)f->data;
+    expect("sequence", header->sequence == sequence);
+
+    // Nothing from the process, it couldn't be opened
+    expect("number of records", header->numRecords == 3);
+
+    const MiniDumpRecordHeader *hdr = findRecord(f, MINIDUMP_RECORD_CRASH_REASON, 0);
+    const MiniDumpCrashReason *reason = (const MiniDumpCrashReason *)(hdr + 1);
+    expect("crash reason", hdr != NULL && reason->errorType == ERRF_ERRTYPE_FAILURE && reason->exceptionType == 0xFF &&
+        reason->resultCode == SIM_FAILURE_RESULT && reason->pcAddr == SIM_FAILURE_PC &&
+        strcmp(reason->message, "assertion failed") == 0);
+
+    hdr = findRecord(f, MINIDUMP_RECORD_PROCESS, 0);
+    const MiniDumpProcess *proc = (const MiniDumpProcess *)(hdr + 1);
+    expect("process", hdr != NULL && proc->pid == SIM_OTHER_PID && proc->titleId == SIM_OTHER_TITLE_ID && proc->textSize == 0);
+
+    hdr = findRecord(f, MINIDUMP_RECORD_USER_STRING, 0);
+    expect("user string", hdr != NULL && hdr->size == 7 && memcmp(hdr + 1, "from pm", 7) == 0);
+}
+
+static void testRing(void)
+{
+    printf("Ring:\n");
+
+    expect("first dump", R_SUCCEEDED(dataAbort()));
+    checkAbort(0, 1);
+    expect("one map per memory record", numMaps == 3);
+
+    for (u32 i = 1; i < MINIDUMP_NUM_SLOTS - 1; i++)
+        expect("dump", R_SUCCEEDED(dataAbort()));
+    expect("failure", R_SUCCEEDED(failure()));
+    checkFailure(MINIDUMP_NUM_SLOTS - 1, MINIDUMP_NUM_SLOTS);
+
+    // The ring is full: the oldest dump goes
+    expect("dump over the oldest", R_SUCCEEDED(dataAbort()));
+    checkAbort(0, MINIDUMP_NUM_SLOTS + 1);
+    expect("other slots kept", ((const MiniDumpHeader *)slotFile(1)->data)->sequence == 2);
+}
+
+static void runDecoder(const char *decoder, const char *args, const char *dir, char *output, size_t size)
+{
+    char command[0x400];
+    snprintf(command, sizeof(command), "python3 '%s' %s '%s'", decoder, args, dir);
+
+    FILE *f = popen(command, "r");
+    size_t n = f != NULL ? fread(output, 1, size - 1, f) : 0;
+    output[n] = 0;
+    expect(command, f != NULL && pclose(f) == 0);
+}
+
+static void testDecoder(const char *dir, const char *decoder)
+{
+    static const char *expectedReport[] = {
+        "  process:  crasher (pid 48), title 0004000000123400, application 0004000000123400",
+        "  code:     text 00100000+2000, rodata 00102000+0, data 00103000+1000",
+        "  error:    exception (data abort), result 0x00000000",
+        "  far:      00000004, fsr 00000805",
+        "  pc:       00100800",
+        "  lr:       00101fc0",
+        "    [0fffff08] 00100c41",
+        "    [0fffff10] 00100d00",
+        "  map:      00100000-00102000 r-x code",
+        "  map:      0fffc000-10000000 rw- private",
+        "  pc memory:\n    00100780  ",
+        "  lr memory:\n    00101f40  ",
+        "  stack memory:\n    0fffff00  ",
+        "  error:    failure, result 0xc8a04567",
+        "  message:  assertion failed",
+        "  user string: from pm",
+    };
+    static const char *expectedBuckets[] = {
+        "16 dumps, 2 distinct faults\n",
+        "   15  crasher (0004000000123400) exception (data abort) at text+0x800  [2023-",
+        "    1   (0004000000567800) failure 0xc8a04567 at 0x00100abc  [2023-",
+    };
+    static char output[0x40000];
+    char path[0x200];
+
+    printf("minidump.py:\n");
+
+    mkdir(dir, 0755);
+    for (u32 i = 0; i < MINIDUMP_NUM_SLOTS; i++)
+    {
+        const SimFile *f = slotFile(i);
+        snprintf(path, sizeof(path), "%s/minidump_%02u.dmp", dir, i);
+
+        FILE *out = f != NULL ? fopen(path, "wb") : NULL;
+        if (out == NULL || fwrite(f->data, 1, f->size, out) != f->size || fclose(out) != 0)
+        {
+            printf("    can't write %s: FAILED\n", path);
+            failed = true;
+            return;
+        }
+    }
+
+    runDecoder(decoder, "--memory", dir, output, sizeof(output));
+    for (u32 i = 0; i < sizeof(expectedReport) / sizeof(*expectedReport); i++)
+        expect(expectedReport[i], strstr(output, expectedReport[i]) != NULL);
+
+    // Oldest first, the dump over slot 0 last
+    const char *second = strstr(output, "minidump_01.dmp: #2, ");
+    const char *failure = strstr(output, "minidump_15.dmp: #16, ");
+    const char *last = strstr(output, "minidump_00.dmp: #17, ");
+    expect("sorted by time", second != NULL && failure > second && last > failure);
+
+    runDecoder(decoder, "--buckets", dir, output, sizeof(output));
+    for (u32 i = 0; i < sizeof(expectedBuckets) / sizeof(*expectedBuckets); i++)
+        expect(expectedBuckets[i], strstr(output, expectedBuckets[i]) != NULL);
+}
+
+int main(int argc, char **argv)
+{
+    if (argc != 3)
+    {
+        fprintf(stderr, "usage: %s <directory> <minidump.py>\n", argv[0]);
+        return 2;
+    }
+
+    setupProcess();
+    testRing();
+    testDecoder(argv[1], argv[2]);
+
+    printf(failed ? "FAILED\n" : "ok\n");
+    return failed ? 1 : 0;
+}
@@ -0,0 +1,266 @@
+/*
+*   This file is part of Luma3DS.
+*   Copyright (C) 2016-2020 Aurora Wright, TuxSH
+*
+*   SPDX-License-Identifier: (MIT OR GPL-2.0-or-later)
+*/
+
+/* Checks the GDB non-stop mode (non_stop.c) against the simulated process of gdbsim.c, with scripted streams of
+   debug events: which threads get stopped and resumed, the %Stop notifications and vStopped replies, steps and
+   vCont;t, exceptions while a stop is being reported, process-level breaks, HIO requests and the process exiting.
+
+   Exits with status 1 if anything doesn't match.
+*/
+
+#include <errno.h>
+#include <stdio.h>
+#include "gdbsim.h"
+#include "gdb/breakpoints.h"
+#include "gdb/hio.h"
+
+#define CODE    (GDBSIM_MEMORY_BASE + 0x1000)
+#define DATA    (GDBSIM_MEMORY_BASE + 0x2000)
+#define NOP     0xE1A00000
+
+static bool failed;
+
+static GDBServer server;
+static GDBContext *ctx = &server.ctxs[0];
+
+static void expect(const char *name, bool ok)
+{
+    if (!ok)
+    {
+        printf("    %s: FAILED\n", name);
+        failed = true;
+    }
+}
+
+static bool startsWith(const char *str, const char *prefix)
+{
+    return str != NULL && strncmp(str, prefix, strlen(prefix)) == 0;
+}
+
+// Handles what the stub queued (svcBreakDebugProcess), as the monitor thread would
+static void runMonitor(void)
+{
+    while (gdbSim.numEvents != 0)
+        GDBSim_HandleEvent(ctx);
+}
+
+// Stop replies are compared up to the registers, which must follow
+static void expectReply(const char *packet, const char *expected)
+{
+    const char *reply = GDBSim_Command(ctx, packet);
+    bool ok = expected[0] == 'T' ? startsWith(reply, expected) && strstr(reply, ";f:") != NULL : reply != NULL && strcmp(reply, expected) == 0;
+    if (!ok)
+    {
+        printf("    %s: got \"%.40s\" instead of \"%s\"\n", packet, reply != NULL ? reply : "(nothing)", expected);
+        failed = true;
+    }
+
+    runMonitor();
+}
+
+static bool expectNotification(const char *expected)
+{
+    const char *notification = GDBSim_TakeNotification();
+    return expected == NULL ? notification == NULL : startsWith(notification, expected) && strstr(notification, ";f:") != NULL;
+}
+
+static const char *lockedThreads(void)
+{
+    static char str[GDBSIM_MAX_THREADS + 1];
+    char *pos = str;
+    for (u32 i = 1; i < GDBSIM_MAX_THREADS; i++)
+    {
+        if (gdbSim.locked[i])
+            *pos++ = '0' + i;
+    }
+    *pos = 0;
+    return str;
+}
+
+static void attach(void)
+{
+    GDBSim_Attach(&server, ctx, 3);
+    for (u32 addr = CODE; addr < CODE + 0x100; addr += 4)
+        GDBSim_Write32(addr, NOP);
+    for (u32 i = 1; i <= 3; i++)
+        gdbSim.threads[i].cpu_registers.pc = CODE + 0x40 * i;
+
+    expectReply("QStartNoAckMode", "OK");
+}
+
+static void detach(void)
+{
+    GDBSim_Detach(ctx);
+    expect("well-formed packets", GDBSim_NumBadPackets() == 0);
+}
+
+static void testThreadStops(void)
+{
+    printf("Thread stops:\n");
+    attach();
+
+    // Stopped on attach, then QNonStop:1: each thread is stopped instead and the process runs
+    u32 numContinues = gdbSim.numContinues;
+    expectReply("QNonStop:1", "OK");
+    expect("all stopped", strcmp(lockedThreads(), "123") == 0 && gdbSim.numContinues == numContinues + 1 && gdbSim.numWaiting == 0 &&
+        (ctx->flags & GDB_FLAG_PROCESS_CONTINUING));
+    expectReply("?", "T00thread:1;");
+    expectReply("vStopped", "T00thread:2;");
+    expectReply("vStopped", "T00thread:3;");
+    expectReply("vStopped", "OK");
+    expect("done reporting", !ctx->nonStop.notifying);
+    expectReply("vCont;c", "OK");
+    expect("all resumed", strcmp(lockedThreads(), "") == 0);
+    expectReply("Z0,101000,4", "OK");
+
+    // Breakpoint on thread 2: only thread 2 stops, the event is continued
+    numContinues = gdbSim.numContinues;
+    expect("breakpoint handled", GDBSim_HitBreakpoint(ctx, 2, CODE) == -3);
+    expect("breakpoint notified", expectNotification("Stop:T05thread:2;") && GDBSim_TakeReply() == NULL);
+    expect("thread 2 stopped", strcmp(lockedThreads(), "2") == 0 && gdbSim.numContinues == numContinues + 1);
+
+    // Data abort on thread 3 before GDB has acknowledged: queued, no new notification
+    GDBSim_QueueEvent(DBGEVENT_EXCEPTION, 3, EXCEVENT_DATA_ABORT);
+    expect("abort handled", GDBSim_HandleEvent(ctx) == -3);
+    expect("abort not notified", expectNotification(NULL) && strcmp(lockedThreads(), "23") == 0);
+    expectReply("vStopped", "T0bthread:3;");
+    expectReply("vStopped", "OK");
+
+    // Register read while running: the process is broken for it, and continued without any stop being reported
+    u32 numBreaks = gdbSim.numBreaks;
+    numContinues = gdbSim.numContinues;
+    expectReply("Hg1", "OK");
+    expectReply("pf", "40101000");
+    expect("broken and continued", gdbSim.numBreaks == numBreaks + 1 && gdbSim.numContinues == numContinues + 1);
+    expect("nothing notified", expectNotification(NULL) && strcmp(lockedThreads(), "23") == 0);
+
+    // Resume thread 2 only
+    expectReply("vCont;c:2", "OK");
+    expect("thread 2 resumed", strcmp(lockedThreads(), "3") == 0 && ctx->threadInfos[1].stopState == GDB_THREAD_RUNNING);
+
+    detach();
+}
+
+static void testSteps(void)
+{
+    printf("Steps:\n");
+    attach();
+
+    expectReply("QNonStop:1", "OK");
+    expectReply("?", "T00thread:1;");
+    expectReply("vStopped", "T00thread:2;");
+    expectReply("vStopped", "T00thread:3;");
+    expectReply("vStopped", "OK");
+
+    // Step thread 3 while the others run; the step ends with a plain SIGTRAP
+    expectReply("vCont;s:3;c", "OK");
+    expect("all running", strcmp(lockedThreads(), "") == 0 && ctx->stepOver.threadId == 3);
+    expect("step breakpoint", GDBSim_Read32(CODE + 0xC4) == BREAKPOINT_INSTRUCTION_ARM);
+    expect("step handled", GDBSim_HitBreakpoint(ctx, 3, CODE + 0xC4) == -3);
+    expect("step notified", expectNotification("Stop:T05thread:3;"));
+    expect("thread 3 stopped", strcmp(lockedThreads(), "3") == 0 && ctx->stepOver.threadId == 0 && GDBSim_Read32(CODE + 0xC4) == NOP);
+    expectReply("vStopped", "OK");
+
+    // A step interrupted by vCont;t
+    expectReply("vCont;s:3", "OK");
+    expectReply("vCont;t", "OK");
+    expect("step cancelled", ctx->stepOver.threadId == 0 && GDBSim_Read32(CODE + 0xC8) == NOP);
+    expect("all stopped", strcmp(lockedThreads(), "123") == 0);
+    expect("interrupt notified", expectNotification("Stop:T00thread:1;"));
+    expectReply("vStopped", "T00thread:2;");
+    expectReply("vStopped", "T00thread:3;");
+    expectReply("vStopped", "OK");
+
+    // '?' reports all the stopped threads again
+    expectReply("?", "T00thread:1;");
+    expectReply("vStopped", "T00thread:2;");
+    expectReply("vStopped", "T00thread:3;");
+    expectReply("vStopped", "OK");
+
+    detach();
+}
+
+static void testExit(void)
+{
+    PackedGdbHioRequest request = { .magic = "GDB", .functionName = "open", .paramFormat = "si" };
+
+    printf("HIO and exit:\n");
+    attach();
+
+    expectReply("QNonStop:1", "OK");
+    expectReply("?", "T00thread:1;");
+    expectReply("vStopped", "T00thread:2;");
+    expectReply("vStopped", "T00thread:3;");
+    expectReply("vStopped", "OK");
+    expectReply("Z0,101000,4", "OK");
+
+    // A stop GDB hasn't seen isn't resumed by a default continue
+    expectReply("vCont;c:1", "OK");
+    expect("breakpoint handled", GDBSim_HitBreakpoint(ctx, 1, CODE) == -3);
+    expect("breakpoint notified", expectNotification("Stop:T05thread:1;"));
+    expectReply("vCont;c", "OK");
+    expect("still stopped", strcmp(lockedThreads(), "1") == 0 && ctx->threadInfos[0].stopState == GDB_THREAD_STOP_PENDING);
+
+    // File-I/O needs the whole process stopped: the request fails right away
+    memcpy(gdbSim.memory + (DATA - GDBSIM_MEMORY_BASE), &request, sizeof(request));
+    DebugEventInfo *info = GDBSim_QueueEvent(DBGEVENT_OUTPUT_STRING, 2, 0);
+    info->output_string.string_addr = DATA;
+    info->output_string.string_size = 0;
+    expect("request handled", GDBSim_HandleEvent(ctx) == -3 && GDBSim_TakeReply() == NULL);
+    memcpy(&request, gdbSim.memory + (DATA - GDBSIM_MEMORY_BASE), sizeof(request));
+    expect("request failed", request.retval == -1 && request.gdbErrno == EBUSY && !GDB_IsHioInProgress(ctx));
+    expect("thread 2 running", strcmp(lockedThreads(), "1") == 0);
+
+    // Exit while thread 1's stop is being reported: W comes after it
+    GDBSim_QueueEvent(DBGEVENT_EXIT_PROCESS, 0, 0);
+    expect("exit handled", GDBSim_HandleEvent(ctx) == -2);
+    expect("exit pending", expectNotification(NULL) && ctx->nonStop.exitPending);
+    expectReply("vStopped", "W00");
+    expectReply("vStopped", "OK");
+
+    detach();
+}
+
+static void testAllStop(void)
+{
+    printf("Back to all-stop:\n");
+    attach();
+
+    expectReply("QNonStop:1", "OK");
+    expectReply("?", "T00thread:1;");
+    expectReply("vStopped", "T00thread:2;");
+    expectReply("vStopped", "T00thread:3;");
+    expectReply("vStopped", "OK");
+    expectReply("vCont;c", "OK");
+    expectReply("vCont;t:2", "OK");
+    expect("interrupt notified", expectNotification("Stop:T00thread:2;"));
+    expectReply("vStopped", "OK");
+
+    // QNonStop:0 resumes everything, then stops are replies again
+    expectReply("QNonStop:0", "OK");
+    expect("all resumed", strcmp(lockedThreads(), "") == 0 && !(ctx->flags & GDB_FLAG_NON_STOP));
+    expectReply("Z0,101000,4", "OK");
+    expect("breakpoint reported", GDBSim_HitBreakpoint(ctx, 3, CODE) >= 0);
+    const char *reply = GDBSim_TakeReply();
+    expect("stop reply", startsWith(reply, "T05thread:3;") && expectNotification(NULL));
+    expect("process stopped", !(ctx->flags & GDB_FLAG_PROCESS_CONTINUING) && gdbSim.numWaiting == 1);
+
+    detach();
+}
+
+int main(void)
+{
+    GDB_InitializeServer(&server);
+
+    testThreadStops();
+    testSteps();
+    testExit();
+    testAllStop();
+
+    printf(failed ? "FAILED\n" : "ok\n");
+    return failed ? 1 : 0;
+}
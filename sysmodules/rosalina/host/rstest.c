@@ -0,0 +1,725 @@
+/*
+*   This file is part of Luma3DS.
+*   Copyright (C) 2016-2020 Aurora Wright, TuxSH
+*
+*   SPDX-License-Identifier: (MIT OR GPL-2.0-or-later)
+*/
+
+/* Checks the RAM search (ram_search.c) against a simulated process address space: regions of every kind, backed by
+   a memfd, which svcMapProcessMemoryEx maps at RAMSEARCH_MAP_ADDR the way the kernel does, and an in-memory SD card
+   for the snapshot and cheat files. Each pass is compared with a brute-force search over the same memory.
+
+   Exits with status 1 if anything doesn't match.
+*/
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <3ds.h>
+#include "ram_search.h"
+#include "csvc.h"
+#include "ifile.h"
+
+#define SIM_PROCESS_HANDLE  0x1234
+#define SIM_TITLE_ID        0x0004000000055D00ULL
+#define SIM_MAX_CANDIDATES  0x20000
+#define SIM_MAX_FILES       8
+
+#define SIM_ERR_INVALID     MAKERESULT(RL_PERMANENT, RS_INVALIDARG, RM_KERNEL, RD_INVALID_ADDRESS)
+#define SIM_ERR_NOT_FOUND   MAKERESULT(RL_PERMANENT, RS_NOTFOUND, RM_FS, RD_NOT_FOUND)
+
+typedef struct SimRegion {
+    u32 base;
+    u32 size;
+    MemPerm perm;
+    MemState state;
+    bool present;
+    u8 *data;           ///< The test's view of the region, shared with the RAM search windows
+    u8 *snapshot;
+    off_t offset;       ///< In the memfd
+} SimRegion;
+
+typedef struct SimFile {
+    char path[64];
+    u8 *data;
+    u64 size;
+} SimFile;
+
+typedef struct Candidate {
+    u32 addr;
+    u32 value;
+} Candidate;
+
+// Same layout as a typical application: code, .data, heap (over two windows), a shared block, linear memory, a stack
+static SimRegion regions[] = {
+    { 0x00100000, 0x040000, MEMPERM_READEXECUTE,    MEMSTATE_CODE,          true, NULL, NULL, 0 },
+    { 0x00140000, 0x010000, MEMPERM_READWRITE,      MEMSTATE_PRIVATE,       true, NULL, NULL, 0 },
+    { 0x08000000, 0x600000, MEMPERM_READWRITE,      MEMSTATE_PRIVATE,       true, NULL, NULL, 0 },
+    { 0x0FFFC000, 0x004000, MEMPERM_READWRITE,      MEMSTATE_LOCKED,        true, NULL, NULL, 0 },
+    { 0x10000000, 0x010000, MEMPERM_READWRITE,      MEMSTATE_SHARED,        true, NULL, NULL, 0 },
+    { 0x14000000, 0x080000, MEMPERM_READWRITE,      MEMSTATE_CONTINUOUS,    true, NULL, NULL, 0 },
+    { 0x1F000000, 0x010000, MEMPERM_READ,           MEMSTATE_CONTINUOUS,    true, NULL, NULL, 0 },
+};
+
+#define NUM_REGIONS (sizeof(regions) / sizeof(regions[0]))
+#define REGION_CODE         0
+#define REGION_DATA         1
+#define REGION_HEAP         2
+#define REGION_STACK        3
+#define REGION_SHARED       4
+#define REGION_LINEAR       5
+#define REGION_READONLY     6
+
+static bool failed;
+static int memFd;
+static s64 systemFree;
+
+static u32 numMaps, numActiveMaps, maxWindowSize;
+static u64 bytesMapped;
+static bool badMap;
+
+static SimFile files[SIM_MAX_FILES];
+static char directories[4][64] = { "/luma", "/luma/titles" };
+static u32 numDirectories = 2;
+
+static Candidate expected[SIM_MAX_CANDIDATES], actual[SIM_MAX_CANDIDATES];
+static u32 numExpected;
+
+static u32 rngState = 0x12345678;
+
+static void expect(const char *name, bool ok)
+{
+    if (!ok)
+    {
+        printf("    %s: FAILED\n", name);
+        failed = true;
+    }
+}
+
+static u32 rng(void)
+{
+    rngState ^= rngState << 13;
+    rngState ^= rngState >> 17;
+    rngState ^= rngState << 5;
+    return rngState;
+}
+
+static SimRegion *findRegion(u32 addr)
+{
+    for (u32 i = 0; i < NUM_REGIONS; i++)
+    {
+        if (regions[i].present && addr >= regions[i].base && addr - regions[i].base < regions[i].size)
+            return &regions[i];
+    }
+
+    return NULL;
+}
+
+static u32 readValue(u32 addr, u32 size)
+{
+    SimRegion *r = findRegion(addr);
+    u32 value = 0;
+    memcpy(&value, r->data + (addr - r->base), size);
+    return value;
+}
+
+static void writeValue(u32 addr, u32 value, u32 size)
+{
+    SimRegion *r = findRegion(addr);
+    memcpy(r->data + (addr - r->base), &value, size);
+}
+
+/* Simulated kernel and SD card */
+
+s64 osGetMemRegionFree(MemRegion region)
+{
+    (void)region;
+    return systemFree;
+}
+
+Result svcControlMemoryEx(u32 *addr_out, u32 addr0, u32 addr1, u32 size, MemOp op, MemPerm perm, bool isLoader)
+{
+    (void)addr1; (void)op; (void)perm; (void)isLoader;
+    void *p = mmap((void *)(uintptr_t)addr0, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_FIXED_NOREPLACE, -1, 0);
+    if (p == MAP_FAILED)
+        return SIM_ERR_INVALID;
+
+    *addr_out = addr0;
+    return 0;
+}
+
+Result svcControlMemory(u32 *addr_out, u32 addr0, u32 addr1, u32 size, MemOp op, MemPerm perm)
+{
+    (void)addr1; (void)perm;
+    *addr_out = 0;
+    return (op & MEMOP_OP_MASK) == MEMOP_FREE && munmap((void *)(uintptr_t)addr0, size) == 0 ? 0 : SIM_ERR_INVALID;
+}
+
+Result svcQueryProcessMemory(MemInfo *info, PageInfo *out, Handle process, u32 addr)
+{
+    if (process != SIM_PROCESS_HANDLE || addr >= 0x40000000)
+        return SIM_ERR_INVALID;
+
+    out->flags = 0;
+    SimRegion *r = findRegion(addr);
+    if (r != NULL)
+    {
+        info->base_addr = r->base;
+        info->size = r->size;
+        info->perm = r->perm;
+        info->state = r->state;
+        return 0;
+    }
+
+    // Free up to the next region
+    u32 start = 0, end = 0x40000000;
+    for (u32 i = 0; i < NUM_REGIONS; i++)
+    {
+        u32 regionEnd = regions[i].base + regions[i].size;
+        if (!regions[i].present)
+            continue;
+        if (regionEnd <= addr && regionEnd > start)
+            start = regionEnd;
+        if (regions[i].base > addr && regions[i].base < end)
+            end = regions[i].base;
+    }
+
+    info->base_addr = start;
+    info->size = end - start;
+    info->perm = 0;
+    info->state = MEMSTATE_FREE;
+    return 0;
+}
+
+Result svcMapProcessMemoryEx(Handle dstProcessHandle, u32 destAddress, Handle srcProcessHandle, u32 srcAddress, u32 size)
+{
+    SimRegion *r = findRegion(srcAddress);
+    if (dstProcessHandle != CUR_PROCESS_HANDLE || srcProcessHandle != SIM_PROCESS_HANDLE || r == NULL ||
+        size == 0 || (srcAddress & 0xFFF) != 0 || (size & 0xFFF) != 0 || size > r->size - (srcAddress - r->base))
+    {
+        badMap = true;
+        return SIM_ERR_INVALID;
+    }
+
+    // Fails if the previous window wasn't unmapped
+    void *p = mmap((void *)(uintptr_t)destAddress, size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_FIXED_NOREPLACE,
+        memFd, r->offset + (srcAddress - r->base));
+    if (p == MAP_FAILED)
+    {
+        badMap = true;
+        return SIM_ERR_INVALID;
+    }
+
+    numMaps++;
+    numActiveMaps++;
+    bytesMapped += size;
+    maxWindowSize = size > maxWindowSize ? size : maxWindowSize;
+    return 0;
+}
+
+Result svcUnmapProcessMemoryEx(Handle process, u32 destAddress, u32 size)
+{
+    if (process != CUR_PROCESS_HANDLE || numActiveMaps == 0 || munmap((void *)(uintptr_t)destAddress, size) != 0)
+    {
+        badMap = true;
+        return SIM_ERR_INVALID;
+    }
+
+    numActiveMaps--;
+    return 0;
+}
+
+Result svcGetProcessInfo(s64 *out, Handle process, u32 type)
+{
+    if (process != SIM_PROCESS_HANDLE || type != 0x10001)
+        return SIM_ERR_INVALID;
+
+    *out = (s64)SIM_TITLE_ID;
+    return 0;
+}
+
+static SimFile *findFile(const char *path)
+{
+    for (u32 i = 0; i < SIM_MAX_FILES; i++)
+    {
+        if (files[i].path[0] != 0 && strcmp(files[i].path, path) == 0)
+            return &files[i];
+    }
+
+    return NULL;
+}
+
+static bool directoryExists(const char *path)
+{
+    const char *slash = strrchr(path, '/');
+    for (u32 i = 0; i < numDirectories; i++)
+    {
+        if (slash == path || (strlen(directories[i]) == (size_t)(slash - path) && strncmp(directories[i], path, slash - path) == 0))
+            return true;
+    }
+
+    return false;
+}
+
+Result FSUSER_OpenArchive(FS_Archive *archive, FS_ArchiveID id, FS_Path path)
+{
+    (void)path;
+    *archive = id;
+    return 0;
+}
+
+Result FSUSER_CloseArchive(FS_Archive archive)
+{
+    (void)archive;
+    return 0;
+}
+
+Result FSUSER_CreateDirectory(FS_Archive archive, FS_Path path, u32 attributes)
+{
+    (void)archive; (void)attributes;
+    strcpy(directories[numDirectories++], (const char *)path.data);
+    return 0;
+}
+
+Result IFile_Open(IFile *file, FS_ArchiveID archiveId, FS_Path archivePath, FS_Path filePath, u32 flags)
+{
+    (void)archiveId; (void)archivePath;
+    const char *path = (const char *)filePath.data;
+    SimFile *f = findFile(path);
+
+    if (f == NULL)
+    {
+        if (!(flags & FS_OPEN_CREATE) || !directoryExists(path))
+            return SIM_ERR_NOT_FOUND;
+        for (f = files; f < files + SIM_MAX_FILES && f->path[0] != 0; f++);
+        if (f == files + SIM_MAX_FILES)
+            return SIM_ERR_NOT_FOUND;
+        strcpy(f->path, path);
+    }
+
+    file->handle = (Handle)(f - files);
+    file->pos = 0;
+    file->size = f->size;
+    return 0;
+}
+
+Result IFile_Close(IFile *file)
+{
+    file->handle = 0;
+    return 0;
+}
+
+Result IFile_GetSize(IFile *file, u64 *size)
+{
+    *size = files[file->handle].size;
+    return 0;
+}
+
+Result IFile_SetSize(IFile *file, u64 size)
+{
+    SimFile *f = &files[file->handle];
+    f->data = realloc(f->data, size + 1);
+    f->size = size;
+    return 0;
+}
+
+Result IFile_Read(IFile *file, u64 *total, void *buffer, u32 len)
+{
+    SimFile *f = &files[file->handle];
+    u64 n = file->pos >= f->size ? 0 : f->size - file->pos < len ? f->size - file->pos : len;
+
+    memcpy(buffer, f->data + file->pos, n);
+    file->pos += n;
+    *total = n;
+    return 0;
+}
+
+Result IFile_Write(IFile *file, u64 *total, const void *buffer, u32 len, u32 flags)
+{
+    (void)flags;
+    SimFile *f = &files[file->handle];
+
+    if (file->pos + len > f->size)
+        IFile_SetSize(file, file->pos + len);
+    memcpy(f->data + file->pos, buffer, len);
+    file->pos += len;
+    *total = len;
+    return 0;
+}
+
+/* Brute-force search */
+
+static bool isScannable(const SimRegion *r)
+{
+    return r->present && (r->perm & MEMPERM_WRITE) && (r->state == MEMSTATE_PRIVATE || r->state == MEMSTATE_CONTINUOUS ||
+        r->state == MEMSTATE_ALIASED || r->state == MEMSTATE_ALIAS_CODE || r->state == MEMSTATE_LOCKED);
+}
+
+static bool matches(RamSearchValueType type, RamSearchCompare cmp, u32 prev, u32 cur, u32 operand)
+{
+    float p, c, o;
+    memcpy(&p, &prev, 4);
+    memcpy(&c, &cur, 4);
+    memcpy(&o, &operand, 4);
+
+    switch (cmp)
+    {
+        case RAMSEARCH_CMP_EQUAL:           return cur == operand;
+        case RAMSEARCH_CMP_NOT_EQUAL:       return cur != operand;
+        case RAMSEARCH_CMP_GREATER:         return type == RAMSEARCH_TYPE_FLOAT ? c > o : cur > operand;
+        case RAMSEARCH_CMP_CHANGED:         return cur != prev;
+        case RAMSEARCH_CMP_UNCHANGED:       return cur == prev;
+        case RAMSEARCH_CMP_DECREASED:       return type == RAMSEARCH_TYPE_FLOAT ? c < p : cur < prev;
+        case RAMSEARCH_CMP_INCREASED_BY:    return type == RAMSEARCH_TYPE_FLOAT ? fabsf(c - p - o) < 0.001f : cur - prev == operand;
+        default:                            return false;
+    }
+}
+
+// First pass over all memory, against the snapshot if there is one
+static void searchAll(const RamSearchContext *ctx, RamSearchCompare cmp, u32 operand, bool fromSnapshot)
+{
+    numExpected = 0;
+    for (u32 i = 0; i < NUM_REGIONS; i++)
+    {
+        SimRegion *r = &regions[i];
+        if (!isScannable(r) || (fromSnapshot && r->snapshot == NULL))
+            continue;
+
+        for (u32 off = 0; off < r->size; off += ctx->valueSize)
+        {
+            u32 cur = 0, prev = 0;
+            memcpy(&cur, r->data + off, ctx->valueSize);
+            memcpy(&prev, (fromSnapshot ? r->snapshot : r->data) + off, ctx->valueSize);
+            if (matches(ctx->type, cmp, prev, cur, operand))
+                expected[numExpected++] = (Candidate){ r->base + off, cur };
+        }
+    }
+}
+
+static void searchExpected(const RamSearchContext *ctx, RamSearchCompare cmp, u32 operand)
+{
+    u32 n = 0;
+    for (u32 i = 0; i < numExpected; i++)
+    {
+        SimRegion *r = findRegion(expected[i].addr);
+        if (r == NULL || !isScannable(r))
+            continue;
+
+        u32 cur = readValue(expected[i].addr, ctx->valueSize);
+        if (matches(ctx->type, cmp, expected[i].value, cur, operand))
+            expected[n++] = (Candidate){ expected[i].addr, cur };
+    }
+
+    numExpected = n;
+}
+
+static bool candidatesMatch(const RamSearchContext *ctx)
+{
+    u32 addrs[64], values[64];
+    u32 n = 0, got;
+
+    if (ctx->numCandidates != numExpected)
+        return false;
+
+    do
+    {
+        got = RamSearch_GetCandidates(ctx, n, addrs, values, 64);
+        for (u32 i = 0; i < got; i++)
+            actual[n + i] = (Candidate){ addrs[i], values[i] };
+        n += got;
+    } while (got != 0 && n < SIM_MAX_CANDIDATES);
+
+    return n == numExpected && memcmp(actual, expected, n * sizeof(Candidate)) == 0;
+}
+
+static Result refine(RamSearchContext *ctx, RamSearchCompare cmp, u32 operand, bool fromSnapshot)
+{
+    bool first = ctx->numPasses == 0;
+    Result res = RamSearch_Refine(ctx, cmp, operand);
+
+    if (first)
+        searchAll(ctx, cmp, operand, fromSnapshot);
+    else
+        searchExpected(ctx, cmp, operand);
+
+    expect("windows unmapped", numActiveMaps == 0);
+    expect("windows in regions", !badMap && maxWindowSize <= RAMSEARCH_MAP_WINDOW_SIZE);
+    return res;
+}
+
+/* Tests */
+
+static void resetMemory(void)
+{
+    for (u32 i = 0; i < NUM_REGIONS; i++)
+    {
+        SimRegion *r = &regions[i];
+        r->present = true;
+        free(r->snapshot);
+        r->snapshot = NULL;
+        for (u32 off = 0; off < r->size; off += 4)
+        {
+            u32 value = rng();
+            memcpy(r->data + off, &value, 4);
+        }
+    }
+
+    for (u32 i = 0; i < SIM_MAX_FILES; i++)
+    {
+        free(files[i].data);
+        files[i] = (SimFile){ { 0 }, NULL, 0 };
+    }
+
+    numDirectories = 2;
+    numMaps = bytesMapped = maxWindowSize = 0;
+    badMap = false;
+}
+
+static void plant(u32 value, u32 size)
+{
+    // Both sides of the heap window boundary, and in each kind of region, scannable or not
+    static const u32 addrs[] = { 0x00100100, 0x00140010, 0x08000000, 0x083FFFFC, 0x08400000, 0x085FFFFC, 0x0FFFFFF0,
+        0x10000040, 0x14000000, 0x1407FFF0, 0x1F000010 };
+
+    for (u32 i = 0; i < sizeof(addrs) / sizeof(addrs[0]); i++)
+        writeValue(addrs[i], value, size);
+}
+
+static void testKnownValue(void)
+{
+    RamSearchContext ctx;
+
+    printf("Known value:\n");
+    resetMemory();
+    plant(0xDEADBEEF, 4);
+
+    expect("init", R_SUCCEEDED(RamSearch_Init(&ctx, SIM_PROCESS_HANDLE, RAMSEARCH_TYPE_U32)));
+    expect("title ID", ctx.titleId == SIM_TITLE_ID);
+    expect("first pass", R_SUCCEEDED(refine(&ctx, RAMSEARCH_CMP_EQUAL, 0xDEADBEEF, false)));
+    expect("found in writable memory", candidatesMatch(&ctx) && numExpected == 8);
+
+    u32 heapWindows = (regions[REGION_HEAP].size + RAMSEARCH_MAP_WINDOW_SIZE - 1) / RAMSEARCH_MAP_WINDOW_SIZE;
+    expect("one map per window", numMaps == heapWindows + 3);
+    printf("    %u candidates, %u windows, %.1f MiB mapped\n", ctx.numCandidates, numMaps, bytesMapped / 1048576.0);
+
+    // Some of the values change, then the linear memory block goes away
+    writeValue(0x083FFFFC, 0xDEADBEEF + 5, 4);
+    writeValue(0x08400000, 0xDEADBEEF + 6, 4);
+    writeValue(0x14000000, 0xDEADBEEF + 5, 4);
+    expect("increased by", R_SUCCEEDED(refine(&ctx, RAMSEARCH_CMP_INCREASED_BY, 5, false)));
+    expect("increased by candidates", candidatesMatch(&ctx) && numExpected == 2);
+
+    regions[REGION_LINEAR].present = false;
+    expect("unchanged", R_SUCCEEDED(refine(&ctx, RAMSEARCH_CMP_UNCHANGED, 0, false)));
+    expect("unmapped region dropped", candidatesMatch(&ctx) && numExpected == 1);
+
+    RamSearch_Exit(&ctx);
+}
+
+static void testUnknownValue(void)
+{
+    RamSearchContext ctx;
+
+    printf("Unknown value:\n");
+    resetMemory();
+
+    expect("init", R_SUCCEEDED(RamSearch_Init(&ctx, SIM_PROCESS_HANDLE, RAMSEARCH_TYPE_U16)));
+    expect("no baseline", RamSearch_Refine(&ctx, RAMSEARCH_CMP_CHANGED, 0) == RAMSEARCH_ERR_NO_BASELINE);
+    expect("snapshot", R_SUCCEEDED(RamSearch_Snapshot(&ctx)));
+
+    u64 snapshotSize = 0;
+    for (u32 i = 0; i < NUM_REGIONS; i++)
+    {
+        SimRegion *r = &regions[i];
+        if (!isScannable(r))
+            continue;
+        r->snapshot = malloc(r->size);
+        memcpy(r->snapshot, r->data, r->size);
+        snapshotSize += r->size + 8 * ((r->size + RAMSEARCH_MAP_WINDOW_SIZE - 1) / RAMSEARCH_MAP_WINDOW_SIZE);
+    }
+
+    SimFile *snapshot = findFile(RAMSEARCH_SNAPSHOT_PATH);
+    expect("snapshot size", snapshot != NULL && snapshot->size == snapshotSize);
+    printf("    %.1f MiB snapshot in %u ms\n", snapshotSize / 1048576.0, ctx.lastPassMs);
+
+    // Values decrease all over the place, and the stack is gone (its snapshot record is skipped)
+    for (u32 i = 0; i < 2000; i++)
+    {
+        SimRegion *r = &regions[1 + rng() % REGION_LINEAR];
+        u32 addr = r->base + (rng() % r->size & ~1);
+        u32 value = readValue(addr, 2);
+        writeValue(addr, value != 0 ? value - 1 : 1, 2);
+    }
+    regions[REGION_STACK].present = false;
+    free(regions[REGION_STACK].snapshot);
+    regions[REGION_STACK].snapshot = NULL;
+
+    expect("changed", R_SUCCEEDED(refine(&ctx, RAMSEARCH_CMP_CHANGED, 0, true)));
+    expect("changed candidates", candidatesMatch(&ctx) && numExpected > 1000);
+    u32 numChanged = numExpected;
+
+    for (u32 i = 0; i < numExpected; i += 2)
+        writeValue(expected[i].addr, expected[i].value - 1, 2);
+    expect("decreased", R_SUCCEEDED(refine(&ctx, RAMSEARCH_CMP_DECREASED, 0, false)));
+    expect("decreased candidates", candidatesMatch(&ctx) && numExpected > numChanged / 3);
+    printf("    %u changed, then %u decreased\n", numChanged, numExpected);
+
+    RamSearch_Exit(&ctx);
+}
+
+static void testDense(void)
+{
+    RamSearchContext ctx;
+
+    printf("Dense u8 candidates:\n");
+    resetMemory();
+
+    expect("init", R_SUCCEEDED(RamSearch_Init(&ctx, SIM_PROCESS_HANDLE, RAMSEARCH_TYPE_U8)));
+    expect("first pass", R_SUCCEEDED(refine(&ctx, RAMSEARCH_CMP_EQUAL, 0x5A, false)));
+    expect("candidates", candidatesMatch(&ctx) && numExpected > 10000);
+
+    // Pages that don't start on a block boundary
+    bool paged = true;
+    for (u32 start = 0; start < numExpected && paged; start += 97)
+    {
+        u32 addrs[7], values[7];
+        u32 n = RamSearch_GetCandidates(&ctx, start, addrs, values, 7);
+        for (u32 i = 0; i < n; i++)
+            paged = paged && addrs[i] == expected[start + i].addr && values[i] == expected[start + i].value;
+        paged = paged && n == (numExpected - start < 7 ? numExpected - start : 7);
+    }
+    expect("paging", paged);
+    printf("    %u candidates in %u bytes\n", ctx.numCandidates, ctx.candidatesSize);
+
+    for (u32 i = 0; i < numExpected; i += 3)
+        writeValue(expected[i].addr, 0x5A + 0x10, 1);
+    expect("increased by", R_SUCCEEDED(refine(&ctx, RAMSEARCH_CMP_INCREASED_BY, 0x10, false)));
+    expect("increased by candidates", candidatesMatch(&ctx));
+
+    RamSearch_Exit(&ctx);
+}
+
+static void testFloat(void)
+{
+    RamSearchContext ctx;
+    float f = 100.0f;
+    u32 bits;
+
+    printf("Float:\n");
+    resetMemory();
+    memcpy(&bits, &f, 4);
+    plant(bits, 4);
+
+    expect("init", R_SUCCEEDED(RamSearch_Init(&ctx, SIM_PROCESS_HANDLE, RAMSEARCH_TYPE_FLOAT)));
+    expect("first pass", R_SUCCEEDED(refine(&ctx, RAMSEARCH_CMP_EQUAL, bits, false)));
+    expect("candidates", candidatesMatch(&ctx) && numExpected == 8);
+
+    f = 100.25f;
+    memcpy(&bits, &f, 4);
+    writeValue(0x00140010, bits, 4);
+    f = 100.3f;
+    memcpy(&bits, &f, 4);
+    writeValue(0x08000000, bits, 4);
+    f = 0.25f;
+    memcpy(&bits, &f, 4);
+    expect("increased by", R_SUCCEEDED(refine(&ctx, RAMSEARCH_CMP_INCREASED_BY, bits, false)));
+    expect("increased by candidates", candidatesMatch(&ctx) && numExpected == 1);
+
+    RamSearch_Exit(&ctx);
+}
+
+static void testHeapFull(void)
+{
+    RamSearchContext ctx;
+
+    printf("Heap full:\n");
+    resetMemory();
+
+    systemFree = RAMSEARCH_IO_BUFFER_SIZE;
+    expect("no heap", RamSearch_Init(&ctx, SIM_PROCESS_HANDLE, RAMSEARCH_TYPE_U32) == RAMSEARCH_ERR_HEAP_FULL);
+
+    systemFree = 0x8000;
+    expect("init", R_SUCCEEDED(RamSearch_Init(&ctx, SIM_PROCESS_HANDLE, RAMSEARCH_TYPE_U32)));
+    expect("small heap", ctx.heapSize == 0x8000);
+    expect("too many candidates", RamSearch_Refine(&ctx, RAMSEARCH_CMP_NOT_EQUAL, 0) == RAMSEARCH_ERR_HEAP_FULL);
+    expect("no partial results", ctx.numCandidates == 0 && ctx.numPasses == 0);
+    expect("windows unmapped", numActiveMaps == 0);
+
+    RamSearch_Exit(&ctx);
+    systemFree = 0x1000000;
+}
+
+static void testExport(void)
+{
+    RamSearchContext ctx;
+    u32 numExported;
+    char line[64], path[64];
+
+    printf("Cheat export:\n");
+    resetMemory();
+    plant(0x1234, 2);
+
+    expect("init", R_SUCCEEDED(RamSearch_Init(&ctx, SIM_PROCESS_HANDLE, RAMSEARCH_TYPE_U16)));
+    expect("first pass", R_SUCCEEDED(refine(&ctx, RAMSEARCH_CMP_EQUAL, 0x1234, false)));
+
+    // No title directory, so it goes to /cheats, which doesn't exist yet
+    u32 n = numExpected < RAMSEARCH_MAX_EXPORTED ? numExpected : RAMSEARCH_MAX_EXPORTED;
+    expect("export", R_SUCCEEDED(RamSearch_ExportCheats(&ctx, &numExported)) && numExported == n && n != 0);
+    sprintf(path, "/cheats/%016llX.txt", SIM_TITLE_ID);
+    SimFile *f = findFile(path);
+    expect("created", f != NULL);
+    if (f != NULL)
+    {
+        f->data[f->size] = 0;
+        sprintf(line, "\r\nD3000000 %08X\r\n10000000 00001234\r\n", expected[0].addr);
+        expect("first code", strstr((const char *)f->data, line) != NULL);
+        sprintf(line, "\r\nD3000000 %08X\r\n", expected[n - 1].addr);
+        expect("last code", strstr((const char *)f->data, line) != NULL);
+    }
+
+    // Appended to the title's cheat file when there is one
+    sprintf(path, "/luma/titles/%016llX/cheats.txt", SIM_TITLE_ID);
+    strcpy(files[SIM_MAX_FILES - 1].path, path);
+    files[SIM_MAX_FILES - 1].data = malloc(8);
+    files[SIM_MAX_FILES - 1].size = 7;
+    memcpy(files[SIM_MAX_FILES - 1].data, "[Codes]", 7);
+    u64 before = f != NULL ? f->size : 0;
+    expect("export again", R_SUCCEEDED(RamSearch_ExportCheats(&ctx, &numExported)));
+    expect("appended", files[SIM_MAX_FILES - 1].size > 7 && memcmp(files[SIM_MAX_FILES - 1].data, "[Codes]\r\n", 9) == 0);
+    expect("other file untouched", f == NULL || f->size == before);
+
+    RamSearch_Exit(&ctx);
+}
+
+int main(void)
+{
+    off_t size = 0;
+
+    memFd = memfd_create("process", 0);
+    for (u32 i = 0; i < NUM_REGIONS; i++)
+    {
+        regions[i].offset = size;
+        size += regions[i].size;
+    }
+    if (memFd < 0 || ftruncate(memFd, size) != 0)
+    {
+        perror("memfd");
+        return 1;
+    }
+
+    for (u32 i = 0; i < NUM_REGIONS; i++)
+        regions[i].data = mmap(NULL, regions[i].size, PROT_READ | PROT_WRITE, MAP_SHARED, memFd, regions[i].offset);
+
+    systemFree = 0x1000000;
+    testKnownValue();
+    testUnknownValue();
+    testDense();
+    testFloat();
+    testHeapFull();
+    testExport();
+
+    printf(failed ? "FAILED\n" : "ok\n");
+    return failed ? 1 : 0;
+}
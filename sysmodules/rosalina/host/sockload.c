@@ -0,0 +1,207 @@
+/*
+*   This file is part of Luma3DS.
+*   Copyright (C) 2016-2020 Aurora Wright, TuxSH
+*
+*   SPDX-License-Identifier: (MIT OR GPL-2.0-or-later)
+*/
+
+/* Load generator for sockserv (or any echo server): opens -c connections spread over -n ports,
+   each sending -r requests of -s bytes and waiting for the echo, and reports how many
+   connections were served, the request latency percentiles and the throughput.
+   -w connections are "slow": they keep sending without ever reading, so that the server has to
+   queue then drop their replies; the latency of the other connections shouldn't be affected. */
+
+#include <errno.h>
+#include <getopt.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+
+typedef struct Connection
+{
+    pthread_t thread;
+    int port;
+    bool slow;
+    bool connected;
+    bool rejected;
+    unsigned int nbDone;
+    double *latencies;
+} Connection;
+
+static const char *host = "127.0.0.1";
+static unsigned int nbRequests = 1000, requestSize = 64, slowDuration = 2;
+
+static double now(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static int connectTo(int port)
+{
+    struct sockaddr_in addr = { .sin_family = AF_INET, .sin_port = htons(port) };
+    inet_pton(AF_INET, host, &addr.sin_addr);
+
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    int yes = 1;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &yes, sizeof(yes));
+    if(connect(fd, (struct sockaddr *)&addr, sizeof(addr)) != 0)
+    {
+        close(fd);
+        return -1;
+    }
+
+    return fd;
+}
+
+static bool receiveAll(int fd, char *buf, size_t len)
+{
+    for(size_t pos = 0; pos < len;)
+    {
+        ssize_t r = recv(fd, buf + pos, len - pos, 0);
+        if(r <= 0)
+            return false;
+        pos += r;
+    }
+
+    return true;
+}
+
+static void *connectionMain(void *arg)
+{
+    Connection *conn = (Connection *)arg;
+    char *req = malloc(requestSize), *resp = malloc(requestSize);
+    int fd = connectTo(conn->port);
+
+    conn->connected = fd != -1;
+    if(fd == -1)
+        goto end;
+
+    memset(req, 'a' + conn->port % 26, requestSize);
+
+    if(conn->slow)
+    {
+        // Small receive window, never read
+        int rcvbuf = 4096;
+        setsockopt(fd, SOL_SOCKET, SO_RCVBUF, &rcvbuf, sizeof(rcvbuf));
+        for(double end = now() + slowDuration; now() < end;)
+        {
+            if(send(fd, req, requestSize, MSG_NOSIGNAL | MSG_DONTWAIT) < 0 && errno != EAGAIN)
+                break;
+        }
+        goto end;
+    }
+
+    for(unsigned int i = 0; i < nbRequests; i++)
+    {
+        double start = now();
+        if(send(fd, req, requestSize, MSG_NOSIGNAL) != (ssize_t)requestSize || !receiveAll(fd, resp, requestSize))
+        {
+            // Closed right away: the server refused the connection
+            conn->rejected = i == 0;
+            break;
+        }
+
+        conn->latencies[conn->nbDone++] = now() - start;
+    }
+
+end:
+    if(fd != -1)
+        close(fd);
+    free(req);
+    free(resp);
+    return NULL;
+}
+
+static int compareDoubles(const void *a, const void *b)
+{
+    double x = *(const double *)a, y = *(const double *)b;
+    return x < y ? -1 : x > y;
+}
+
+static void usage(const char *name)
+{
+    fprintf(stderr, "Usage: %s [-h host] [-p port] [-n ports] [-c connections] [-r requests] [-s size] [-w slow connections] [-d slow duration]\n", name);
+    exit(1);
+}
+
+int main(int argc, char *argv[])
+{
+    int port = 4100, nbPorts = 1;
+    unsigned int nbConnections = 4, nbSlow = 0;
+    int opt;
+
+    while((opt = getopt(argc, argv, "h:p:n:c:r:s:w:d:")) != -1)
+    {
+        switch(opt)
+        {
+            case 'h': host = optarg; break;
+            case 'p': port = atoi(optarg); break;
+            case 'n': nbPorts = atoi(optarg); break;
+            case 'c': nbConnections = (unsigned int)atoi(optarg); break;
+            case 'r': nbRequests = (unsigned int)atoi(optarg); break;
+            case 's': requestSize = (unsigned int)atoi(optarg); break;
+            case 'w': nbSlow = (unsigned int)atoi(optarg); break;
+            case 'd': slowDuration = (unsigned int)atoi(optarg); break;
+            default: usage(argv[0]);
+        }
+    }
+
+    if(nbPorts < 1 || requestSize == 0)
+        usage(argv[0]);
+
+    unsigned int total = nbConnections + nbSlow;
+    Connection *conns = calloc(total, sizeof(Connection));
+
+    double start = now();
+    for(unsigned int i = 0; i < total; i++)
+    {
+        // Slow connections first, so that they are accepted
+        conns[i].slow = i < nbSlow;
+        conns[i].port = port + i % nbPorts;
+        conns[i].latencies = conns[i].slow ? NULL : calloc(nbRequests, sizeof(double));
+        pthread_create(&conns[i].thread, NULL, connectionMain, &conns[i]);
+    }
+
+    for(unsigned int i = 0; i < total; i++)
+        pthread_join(conns[i].thread, NULL);
+    double elapsed = now() - start;
+
+    unsigned int nbServed = 0, nbRejected = 0, nbFailed = 0, nbLatencies = 0;
+    double *latencies = calloc((size_t)nbConnections * nbRequests + 1, sizeof(double));
+    for(unsigned int i = nbSlow; i < total; i++)
+    {
+        if(!conns[i].connected || conns[i].rejected)
+            nbRejected++;
+        else if(conns[i].nbDone == nbRequests)
+            nbServed++;
+        else
+            nbFailed++;
+
+        memcpy(latencies + nbLatencies, conns[i].latencies, conns[i].nbDone * sizeof(double));
+        nbLatencies += conns[i].nbDone;
+    }
+
+    qsort(latencies, nbLatencies, sizeof(double), compareDoubles);
+
+    printf("connections: %u served, %u rejected, %u failed (+%u slow)\n", nbServed, nbRejected, nbFailed, nbSlow);
+    printf("requests: %u in %.2f s, %.0f req/s, %.2f MB/s echoed\n", nbLatencies, elapsed, nbLatencies / elapsed,
+        2.0 * nbLatencies * requestSize / elapsed / 1e6);
+    if(nbLatencies != 0)
+    {
+        printf("latency: p50 %.1f us, p90 %.1f us, p99 %.1f us, max %.1f us\n",
+            1e6 * latencies[nbLatencies / 2], 1e6 * latencies[nbLatencies * 9 / 10],
+            1e6 * latencies[nbLatencies * 99 / 100], 1e6 * latencies[nbLatencies - 1]);
+    }
+
+    return nbFailed == 0 ? 0 : 1;
+}
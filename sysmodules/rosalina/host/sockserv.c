@@ -0,0 +1,196 @@
+/*
+*   This file is part of Luma3DS.
+*   Copyright (C) 2016-2020 Aurora Wright, TuxSH
+*
+*   SPDX-License-Identifier: (MIT OR GPL-2.0-or-later)
+*/
+
+/* Echo service running on the unmodified sock_util.c, for load testing the server core with
+   sockload: every read is echoed back with server_send, through a send queue of -q bytes
+   (0: blocking sends, like before send queues existed). The server statistics are printed
+   every second and on exit (SIGINT or -t). */
+
+#include <getopt.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <3ds/result.h>
+#include <3ds/svc.h>
+#include <3ds/os.h>
+#include "minisoc.h"
+#include "sock_util.h"
+
+typedef struct EchoClient
+{
+    struct sock_ctx super;
+    bool used;
+    u8 *sendQueue;
+} EchoClient;
+
+extern Handle preTerminationEvent;
+
+static EchoClient clients[MAX_CTXS];
+static u32 sendQueueSize = 0x1000;
+static int sendBufferSize = 0;
+static struct sock_server server;
+static volatile sig_atomic_t interrupted = 0;
+
+static struct sock_ctx *echoAlloc(struct sock_server *serv, u16 port)
+{
+    (void)serv;
+    (void)port;
+    for(u32 i = 0; i < MAX_CTXS; i++)
+    {
+        if(!clients[i].used)
+        {
+            clients[i].used = true;
+            clients[i].super.send_queue = sendQueueSize != 0 ? clients[i].sendQueue : NULL;
+            clients[i].super.send_queue_size = sendQueueSize;
+            return &clients[i].super;
+        }
+    }
+
+    return NULL;
+}
+
+static void echoFree(struct sock_server *serv, struct sock_ctx *ctx)
+{
+    (void)serv;
+    ((EchoClient *)ctx)->used = false;
+}
+
+static int echoAccept(struct sock_ctx *ctx)
+{
+    // A small kernel buffer makes backpressure visible sooner
+    if(sendBufferSize != 0)
+        socSetsockopt(ctx->sockfd, SOL_SOCKET, SO_SNDBUF, &sendBufferSize, sizeof(sendBufferSize));
+    return 0;
+}
+
+static int echoData(struct sock_ctx *ctx)
+{
+    u8 buf[0x1000];
+    ssize_t r = server_recv(ctx, buf, sizeof(buf), 0);
+    if(r <= 0)
+        return -1;
+
+    // Dropped messages are counted by the server, the connection stays up
+    server_send(ctx, buf, r);
+    return 0;
+}
+
+static int echoClose(struct sock_ctx *ctx)
+{
+    (void)ctx;
+    return 0;
+}
+
+static void printStats(void)
+{
+    sock_server_stats stats;
+    server_get_stats(&server, &stats);
+
+    u32 nbCallbacks = stats.clients.nb_callbacks;
+    double avgLatencyUs = nbCallbacks == 0 ? 0.0 : 1e6 * stats.clients.total_latency / nbCallbacks / SYSCLOCK_ARM11;
+    double maxLatencyUs = 1e6 * stats.clients.max_latency / SYSCLOCK_ARM11;
+
+    printf("accepted %u rejected %u closed %u | in %llu out %llu bytes, %u drops | %u requests, latency %.1f us avg %.1f us max\n",
+        stats.accepted, stats.rejected, stats.closed,
+        (unsigned long long)stats.clients.bytes_received, (unsigned long long)stats.clients.bytes_sent, stats.clients.drops,
+        nbCallbacks, avgLatencyUs, maxLatencyUs);
+    fflush(stdout);
+}
+
+static void *statsThreadMain(void *arg)
+{
+    u32 duration = *(u32 *)arg;
+    for(u32 elapsed = 0; !interrupted && (duration == 0 || elapsed < duration); elapsed++)
+    {
+        svcSleepThread(1000 * 1000 * 1000LL);
+        printStats();
+    }
+
+    svcSignalEvent(server.shall_terminate_event);
+    return NULL;
+}
+
+static void onInterrupt(int sig)
+{
+    (void)sig;
+    interrupted = 1;
+}
+
+static void usage(const char *name)
+{
+    fprintf(stderr, "Usage: %s [-p port] [-n ports] [-c clients per port] [-m max clients] [-q send queue size] [-b SO_SNDBUF] [-t seconds]\n", name);
+    exit(1);
+}
+
+int main(int argc, char *argv[])
+{
+    u16 port = 4100;
+    int nbPorts = 1, clientsPerPort = MAX_CTXS, maxClients = 0;
+    u32 duration = 0;
+    int opt;
+
+    while((opt = getopt(argc, argv, "p:n:c:m:q:b:t:")) != -1)
+    {
+        switch(opt)
+        {
+            case 'p': port = (u16)atoi(optarg); break;
+            case 'n': nbPorts = atoi(optarg); break;
+            case 'c': clientsPerPort = atoi(optarg); break;
+            case 'm': maxClients = atoi(optarg); break;
+            case 'q': sendQueueSize = (u32)strtoul(optarg, NULL, 0); break;
+            case 'b': sendBufferSize = atoi(optarg); break;
+            case 't': duration = (u32)atoi(optarg); break;
+            default: usage(argv[0]);
+        }
+    }
+
+    if(nbPorts < 1 || nbPorts > MAX_PORTS)
+    {
+        fprintf(stderr, "At most %d ports\n", MAX_PORTS);
+        return 1;
+    }
+
+    for(u32 i = 0; i < MAX_CTXS && sendQueueSize != 0; i++)
+        clients[i].sendQueue = malloc(sendQueueSize);
+
+    signal(SIGINT, onInterrupt);
+    svcCreateEvent(&preTerminationEvent, RESET_STICKY);
+
+    if(R_FAILED(server_init(&server)))
+        return 1;
+
+    server.clients_per_server = clientsPerPort;
+    server.max_clients = maxClients;
+    server.alloc = echoAlloc;
+    server.free = echoFree;
+    server.accept_cb = echoAccept;
+    server.data_cb = echoData;
+    server.close_cb = echoClose;
+
+    for(int i = 0; i < nbPorts; i++)
+    {
+        if(server_bind(&server, port + i) != 0)
+        {
+            fprintf(stderr, "Failed to bind port %d\n", port + i);
+            return 1;
+        }
+    }
+
+    printf("Listening on ports %d to %d, send queues of %u bytes\n", port, port + nbPorts - 1, sendQueueSize);
+    fflush(stdout);
+
+    pthread_t statsThread;
+    pthread_create(&statsThread, NULL, statsThreadMain, &duration);
+
+    server_run(&server);
+    pthread_join(statsThread, NULL);
+
+    printf("Final: ");
+    printStats();
+    server_finalize(&server);
+    return 0;
+}
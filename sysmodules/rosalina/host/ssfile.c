@@ -0,0 +1,170 @@
+/*
+*   This file is part of Luma3DS.
+*   Copyright (C) 2016-2022 Aurora Wright, TuxSH
+*
+*   SPDX-License-Identifier: (MIT OR GPL-2.0-or-later)
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "ssfile.h"
+#include "lz4.h"
+
+static bool isTableInFile(u32 offset, u32 count, u32 entrySize, u64 fileSize)
+{
+    return offset >= sizeof(SaveStateHeader) && (offset & 7) == 0 && (u64)offset + (u64)count * entrySize <= fileSize;
+}
+
+static const char *validate(SsFile *f)
+{
+    const SaveStateHeader *h = f->header;
+
+    if (f->size < sizeof(SaveStateHeader) || h->magic != SAVESTATE_MAGIC)
+        return "not a save state";
+    if (h->version != SAVESTATE_VERSION)
+        return "unsupported version";
+    if (h->numRegions > SAVESTATE_MAX_REGIONS || h->numThreads > SAVESTATE_MAX_THREADS ||
+        h->numPages > SAVESTATE_MAX_PAGES || h->numChunks > h->numPages)
+        return "bad counts";
+    if (!isTableInFile(h->regionsOffset, h->numRegions, sizeof(SaveStateRegion), f->size) ||
+        !isTableInFile(h->pageRefsOffset, h->numPages, sizeof(u32), f->size) ||
+        !isTableInFile(h->pageHashesOffset, h->numPages, sizeof(u64), f->size) ||
+        !isTableInFile(h->chunksOffset, h->numChunks, sizeof(SaveStateChunk), f->size) ||
+        !isTableInFile(h->threadsOffset, h->numThreads, sizeof(SaveStateThread), f->size))
+        return "table out of the file";
+
+    f->regions = (const SaveStateRegion *)(f->data + h->regionsOffset);
+    f->pageRefs = (const u32 *)(f->data + h->pageRefsOffset);
+    f->pageHashes = (const u64 *)(f->data + h->pageHashesOffset);
+    f->chunks = (const SaveStateChunk *)(f->data + h->chunksOffset);
+    f->threads = (const SaveStateThread *)(f->data + h->threadsOffset);
+
+    u32 numPages = 0;
+    for (u32 i = 0; i < h->numRegions; i++)
+    {
+        const SaveStateRegion *r = &f->regions[i];
+        if ((r->addr | r->size) & (SAVESTATE_PAGE_SIZE - 1) || (i > 0 && r->addr < r[-1].addr + r[-1].size))
+            return "bad region table";
+        numPages += r->size / SAVESTATE_PAGE_SIZE;
+    }
+    if (numPages != h->numPages)
+        return "region table doesn't match the page count";
+
+    for (u32 i = 0; i < h->numChunks; i++)
+    {
+        const SaveStateChunk *c = &f->chunks[i];
+        if (c->storedSize == 0 || c->storedSize > SAVESTATE_PAGE_SIZE || c->offset < sizeof(SaveStateHeader) ||
+            c->offset + c->storedSize > h->chunksOffset)
+            return "bad chunk table";
+    }
+
+    for (u32 i = 0; i < h->numPages; i++)
+    {
+        u32 ref = f->pageRefs[i];
+        if (ref == SAVESTATE_REF_BASE ? !(h->flags & SAVESTATE_FLAG_INCREMENTAL) : ref != SAVESTATE_REF_ZERO && ref >= h->numChunks)
+            return "bad page reference";
+    }
+
+    return NULL;
+}
+
+const char *SsFile_Load(SsFile *f, const char *path)
+{
+    FILE *fp = fopen(path, "rb");
+    const char *err = NULL;
+
+    memset(f, 0, sizeof(SsFile));
+    if (fp == NULL)
+        return "can't open the file";
+
+    fseek(fp, 0, SEEK_END);
+    f->size = (u64)ftell(fp);
+    fseek(fp, 0, SEEK_SET);
+
+    // Tables are read in place, keep them aligned
+    f->data = aligned_alloc(8, (f->size + 7) & ~7ULL);
+    if (f->data == NULL || fread(f->data, 1, f->size, fp) != f->size)
+        err = "can't read the file";
+    fclose(fp);
+
+    f->header = (const SaveStateHeader *)f->data;
+    if (err == NULL)
+        err = validate(f);
+    if (err != NULL)
+        SsFile_Free(f);
+
+    return err;
+}
+
+void SsFile_Free(SsFile *f)
+{
+    free(f->data);
+    memset(f, 0, sizeof(SsFile));
+}
+
+u32 SsFile_FindPage(const SsFile *f, u32 addr)
+{
+    u32 firstPage = 0;
+
+    for (u32 i = 0; i < f->header->numRegions; i++)
+    {
+        const SaveStateRegion *r = &f->regions[i];
+        if (addr >= r->addr && addr - r->addr < r->size)
+            return firstPage + (addr - r->addr) / SAVESTATE_PAGE_SIZE;
+        firstPage += r->size / SAVESTATE_PAGE_SIZE;
+    }
+
+    return SAVESTATE_NO_BASE_PAGE;
+}
+
+u32 SsFile_GetPageAddress(const SsFile *f, u32 pageIdx)
+{
+    for (u32 i = 0; i < f->header->numRegions; i++)
+    {
+        u32 n = f->regions[i].size / SAVESTATE_PAGE_SIZE;
+        if (pageIdx < n)
+            return f->regions[i].addr + pageIdx * SAVESTATE_PAGE_SIZE;
+        pageIdx -= n;
+    }
+
+    return 0;
+}
+
+static const char *readChunk(const SsFile *f, u32 ref, void *out)
+{
+    const SaveStateChunk *c = &f->chunks[ref];
+
+    if (c->storedSize == SAVESTATE_PAGE_SIZE)
+        memcpy(out, f->data + c->offset, SAVESTATE_PAGE_SIZE);
+    else if (lz4DecompressBlock(f->data + c->offset, c->storedSize, out, SAVESTATE_PAGE_SIZE) != SAVESTATE_PAGE_SIZE)
+        return "chunk doesn't decompress to a page";
+
+    return SaveStateStore_HashPage(out) == c->hash ? NULL : "chunk hash mismatch";
+}
+
+const char *SsFile_ReadPage(const SsFile *f, const SsFile *base, u32 pageIdx, void *out)
+{
+    u32 ref = f->pageRefs[pageIdx];
+
+    if (ref == SAVESTATE_REF_BASE)
+    {
+        if (base == NULL)
+            return "page is in the base snapshot, which wasn't given";
+        if (base->header->id != f->header->baseId)
+            return "wrong base snapshot";
+
+        u32 basePage = SsFile_FindPage(base, SsFile_GetPageAddress(f, pageIdx));
+        if (basePage == SAVESTATE_NO_BASE_PAGE)
+            return "page missing from the base snapshot";
+        return SsFile_ReadPage(base, NULL, basePage, out);
+    }
+
+    if (ref == SAVESTATE_REF_ZERO)
+    {
+        memset(out, 0, SAVESTATE_PAGE_SIZE);
+        return NULL;
+    }
+
+    return readChunk(f, ref, out);
+}
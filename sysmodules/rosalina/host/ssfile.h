@@ -0,0 +1,40 @@
+/*
+*   This file is part of Luma3DS.
+*   Copyright (C) 2016-2022 Aurora Wright, TuxSH
+*
+*   SPDX-License-Identifier: (MIT OR GPL-2.0-or-later)
+*/
+
+#pragma once
+
+// Host reader for the save state files written by source/save_state.c
+
+#include <3ds/types.h>
+#include "save_state_store.h"
+
+typedef struct SsFile
+{
+    u8 *data;
+    u64 size;
+    const SaveStateHeader *header;
+    const SaveStateRegion *regions;
+    const u32 *pageRefs;
+    const u64 *pageHashes;
+    const SaveStateChunk *chunks;
+    const SaveStateThread *threads;
+} SsFile;
+
+/// Loads and validates a whole file, like the console does before restoring. Returns NULL or an error message.
+const char *SsFile_Load(SsFile *f, const char *path);
+void SsFile_Free(SsFile *f);
+
+/// Returns the index of the page containing addr, or SAVESTATE_NO_BASE_PAGE.
+u32 SsFile_FindPage(const SsFile *f, u32 addr);
+u32 SsFile_GetPageAddress(const SsFile *f, u32 pageIdx);
+
+/**
+ * @brief Decompresses a page and checks its hash.
+ * @param base Base snapshot of an incremental one, NULL otherwise.
+ * @return NULL or an error message.
+ */
+const char *SsFile_ReadPage(const SsFile *f, const SsFile *base, u32 pageIdx, void *out);
@@ -0,0 +1,375 @@
+/*
+*   This file is part of Luma3DS.
+*   Copyright (C) 2016-2022 Aurora Wright, TuxSH
+*
+*   SPDX-License-Identifier: (MIT OR GPL-2.0-or-later)
+*/
+
+/* Unit tests of the save state chunk store (source/save_state_store.c) and of the LZ4 decoder, then a round trip
+   through a full and an incremental snapshot of synthetic memory, written with the same layout as source/save_state.c
+   and read back with ssfile.c. The snapshots are left in build/ for sstool.
+
+   Exits with status 1 if anything fails. */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "ssfile.h"
+#include "lz4.h"
+
+#define CHECK(cond) check((cond), #cond, __LINE__)
+
+static bool failed;
+
+static void check(bool cond, const char *what, int line)
+{
+    if (!cond)
+    {
+        printf("    line %d: %s\n", line, what);
+        failed = true;
+    }
+}
+
+// Compressible pages are runs of 64 identical bytes, tagged with their seed so that they differ
+static void fillPage(u8 *page, u32 seed, bool compressible)
+{
+    u32 x = seed;
+
+    for (u32 i = 0; i < SAVESTATE_PAGE_SIZE; i++)
+    {
+        x = x * 1103515245 + 12345;
+        page[i] = compressible ? (u8)(seed * 7 + i / 64) : (u8)(x >> 16);
+    }
+
+    if (compressible)
+        memcpy(page, &seed, sizeof(seed));
+}
+
+static void testLz4(void)
+{
+    static u8 src[SAVESTATE_PAGE_SIZE], dst[SAVESTATE_PAGE_SIZE], compressed[LZ4_COMPRESS_BOUND(SAVESTATE_PAGE_SIZE)];
+    static u16 hashTable[LZ4_HASH_TABLE_SIZE / 2];
+
+    printf("lz4 round trip\n");
+    for (u32 kind = 0; kind < 3; kind++)
+    {
+        if (kind == 2)
+            memset(src, 0xAB, sizeof(src)); // one long overlapping match
+        else
+            fillPage(src, kind + 1, kind == 0);
+
+        u32 size = lz4CompressBlock(src, sizeof(src), compressed, sizeof(compressed), hashTable);
+        CHECK(size != 0);
+        CHECK(lz4DecompressBlock(compressed, size, dst, sizeof(dst)) == sizeof(src));
+        CHECK(memcmp(src, dst, sizeof(src)) == 0);
+
+        // Truncated input or output must be rejected, not overrun
+        CHECK(lz4DecompressBlock(compressed, size - 1, dst, sizeof(dst)) != sizeof(src));
+        CHECK(lz4DecompressBlock(compressed, size, dst, sizeof(dst) - 1) == 0);
+    }
+
+    // Match offset pointing before the start of the output
+    static const u8 badOffset[] = { 0x10, 'a', 0x08, 0x00, 0x00 };
+    CHECK(lz4DecompressBlock(badOffset, sizeof(badOffset), dst, sizeof(dst)) == 0);
+}
+
+static SaveStateStore *newStore(u32 maxChunks)
+{
+    SaveStateStore *store = malloc(sizeof(SaveStateStore));
+    SaveStateStore_Init(store, malloc(SaveStateStore_GetRequiredSize(maxChunks)), maxChunks);
+    return store;
+}
+
+static void freeStore(SaveStateStore *store)
+{
+    free(store->hashes);
+    free(store);
+}
+
+static void testStore(void)
+{
+    static u8 zero[SAVESTATE_PAGE_SIZE], a[SAVESTATE_PAGE_SIZE], b[SAVESTATE_PAGE_SIZE];
+    SaveStateStore *store = newStore(4);
+    u64 hash, hashA, hashB;
+
+    printf("chunk store: zero pages, deduplication, base references, full store\n");
+    fillPage(a, 1, false);
+    fillPage(b, 2, false);
+
+    CHECK(SaveStateStore_LookupPage(store, zero, NULL, &hash) == SAVESTATE_REF_ZERO);
+    CHECK(hash == SAVESTATE_ZERO_PAGE_HASH);
+
+    CHECK(SaveStateStore_LookupPage(store, a, NULL, &hashA) == SAVESTATE_REF_NEW);
+    CHECK(hashA != SAVESTATE_ZERO_PAGE_HASH);
+    CHECK(SaveStateStore_AddChunk(store, hashA, 0x100, 0x800) == 0);
+    CHECK(SaveStateStore_LookupPage(store, a, NULL, &hash) == 0);
+
+    // A page identical to the base one is a base reference even if it is also in the store
+    CHECK(SaveStateStore_LookupPage(store, a, &hashA, &hash) == SAVESTATE_REF_BASE);
+    CHECK(SaveStateStore_LookupPage(store, b, &hashA, &hashB) == SAVESTATE_REF_NEW);
+
+    // A zero base page must not match a non-zero page
+    u64 zeroHash = SAVESTATE_ZERO_PAGE_HASH;
+    CHECK(SaveStateStore_LookupPage(store, b, &zeroHash, &hash) == SAVESTATE_REF_NEW);
+    CHECK(SaveStateStore_LookupPage(store, zero, &zeroHash, &hash) == SAVESTATE_REF_ZERO);
+
+    CHECK(SaveStateStore_AddChunk(store, hashB, 0x900, SAVESTATE_PAGE_SIZE) == 1);
+    CHECK(SaveStateStore_AddChunk(store, 3, 0, 1) == 2);
+    CHECK(SaveStateStore_AddChunk(store, 4, 0, 1) == 3);
+    CHECK(SaveStateStore_AddChunk(store, 5, 0, 1) == SAVESTATE_REF_NEW);
+    CHECK(store->numChunks == 4);
+    CHECK(SaveStateStore_Find(store, hashB) == 1 && store->offsets[1] == 0x900 && store->storedSizes[1] == SAVESTATE_PAGE_SIZE);
+    freeStore(store);
+
+    printf("chunk store: collisions wrapping around the index\n");
+    store = newStore(8);
+    u32 last = store->indexMask;
+    for (u32 i = 0; i < 8; i++)
+        CHECK(SaveStateStore_AddChunk(store, ((u64)i << 32) | last, 0, 1) == i);
+    for (u32 i = 0; i < 8; i++)
+        CHECK(SaveStateStore_Find(store, ((u64)i << 32) | last) == i);
+    CHECK(SaveStateStore_Find(store, (8ULL << 32) | last) == SAVESTATE_REF_NEW);
+    CHECK(SaveStateStore_Find(store, 1) == SAVESTATE_REF_NEW);
+    freeStore(store);
+
+    printf("chunk store: at most 0xFFFF chunks\n");
+    store = newStore(0x10000);
+    CHECK(store->maxChunks == 0xFFFF);
+    freeStore(store);
+}
+
+static void testMatchBasePages(void)
+{
+    // Base: 0x1000-0x4000, 0x8000-0xA000. Current: 0x0000-0x2000 (partly in the base), 0x3000-0x9000 (over a hole)
+    static const SaveStateRegion base[] = { { 0x1000, 0x3000, 3, 5 }, { 0x8000, 0x2000, 3, 5 } };
+    static const SaveStateRegion cur[] = { { 0x0000, 0x2000, 3, 5 }, { 0x3000, 0x6000, 3, 5 } };
+    static const u32 expected[] = {
+        SAVESTATE_NO_BASE_PAGE, 0,
+        2, SAVESTATE_NO_BASE_PAGE, SAVESTATE_NO_BASE_PAGE, SAVESTATE_NO_BASE_PAGE, SAVESTATE_NO_BASE_PAGE, 3,
+    };
+    u32 basePages[8];
+
+    printf("base page matching\n");
+    SaveStateStore_MatchBasePages(basePages, cur, 2, base, 2);
+    CHECK(memcmp(basePages, expected, sizeof(expected)) == 0);
+
+    SaveStateStore_MatchBasePages(basePages, cur, 2, base, 0);
+    for (u32 i = 0; i < 8; i++)
+        CHECK(basePages[i] == SAVESTATE_NO_BASE_PAGE);
+}
+
+// Synthetic process memory
+typedef struct Memory
+{
+    SaveStateRegion regions[3];
+    u32 numRegions;
+    u8 *data[3];
+} Memory;
+
+static void writeTable(FILE *fp, u32 *offset, u32 *tableOffset, const void *data, u32 size)
+{
+    static const u8 padding[8] = { 0 };
+
+    fwrite(padding, 1, ((*offset + 7) & ~7) - *offset, fp);
+    *offset = (*offset + 7) & ~7;
+    *tableOffset = *offset;
+    fwrite(data, 1, size, fp);
+    *offset += size;
+}
+
+// Same layout and decisions as SaveState_Save
+static bool writeSnapshot(const char *path, const Memory *mem, const SsFile *base, u64 id)
+{
+    static u8 compressed[LZ4_COMPRESS_BOUND(SAVESTATE_PAGE_SIZE)];
+    static u16 hashTable[LZ4_HASH_TABLE_SIZE / 2];
+    SaveStateHeader h = { 0 };
+    SaveStateThread thread = { .threadId = 7, .cpu = { [15] = 0x00100000 + (u32)id } };
+    FILE *fp = fopen(path, "wb");
+
+    if (fp == NULL)
+        return false;
+
+    for (u32 i = 0; i < mem->numRegions; i++)
+        h.numPages += mem->regions[i].size / SAVESTATE_PAGE_SIZE;
+
+    SaveStateStore *store = newStore(h.numPages);
+    u32 *refs = malloc(h.numPages * sizeof(u32)), *basePages = malloc(h.numPages * sizeof(u32));
+    u64 *hashes = malloc(h.numPages * sizeof(u64));
+    u32 offset = sizeof(SaveStateHeader), p = 0;
+
+    if (base != NULL)
+        SaveStateStore_MatchBasePages(basePages, mem->regions, mem->numRegions, base->regions, base->header->numRegions);
+
+    fwrite(&h, 1, sizeof(h), fp);
+    for (u32 i = 0; i < mem->numRegions; i++)
+    {
+        for (u32 off = 0; off < mem->regions[i].size; off += SAVESTATE_PAGE_SIZE, p++)
+        {
+            const u8 *page = mem->data[i] + off;
+            u64 baseHash = base != NULL && basePages[p] != SAVESTATE_NO_BASE_PAGE ? base->pageHashes[basePages[p]] : SAVESTATE_ZERO_PAGE_HASH;
+            u32 ref = SaveStateStore_LookupPage(store, page, base != NULL ? &baseHash : NULL, &hashes[p]);
+
+            if (ref == SAVESTATE_REF_NEW)
+            {
+                const void *data = compressed;
+                u32 storedSize = lz4CompressBlock(page, SAVESTATE_PAGE_SIZE, compressed, sizeof(compressed), hashTable);
+                if (storedSize == 0 || storedSize >= SAVESTATE_PAGE_SIZE)
+                {
+                    data = page;
+                    storedSize = SAVESTATE_PAGE_SIZE;
+                }
+
+                ref = SaveStateStore_AddChunk(store, hashes[p], offset, storedSize);
+                fwrite(data, 1, storedSize, fp);
+                offset += storedSize;
+                h.chunkDataSize += storedSize;
+            }
+            else if (ref == SAVESTATE_REF_ZERO)
+                h.numZeroPages++;
+            else if (ref == SAVESTATE_REF_BASE)
+                h.numBasePages++;
+            else
+                h.numDedupPages++;
+
+            refs[p] = ref;
+        }
+    }
+
+    h.magic = SAVESTATE_MAGIC;
+    h.version = SAVESTATE_VERSION;
+    h.flags = base != NULL ? SAVESTATE_FLAG_INCREMENTAL : 0;
+    h.titleId = 0x0004000000055D00ULL;
+    h.id = id;
+    h.baseId = base != NULL ? base->header->id : 0;
+    h.numRegions = mem->numRegions;
+    h.numChunks = store->numChunks;
+    h.numThreads = 1;
+
+    writeTable(fp, &offset, &h.regionsOffset, mem->regions, h.numRegions * sizeof(SaveStateRegion));
+    writeTable(fp, &offset, &h.pageRefsOffset, refs, h.numPages * sizeof(u32));
+    writeTable(fp, &offset, &h.pageHashesOffset, hashes, h.numPages * sizeof(u64));
+    SaveStateChunk *chunks = malloc(store->numChunks * sizeof(SaveStateChunk));
+    for (u32 i = 0; i < store->numChunks; i++)
+        chunks[i] = (SaveStateChunk){ store->hashes[i], store->offsets[i], store->storedSizes[i] };
+    writeTable(fp, &offset, &h.chunksOffset, chunks, store->numChunks * sizeof(SaveStateChunk));
+    writeTable(fp, &offset, &h.threadsOffset, &thread, sizeof(thread));
+
+    fseek(fp, 0, SEEK_SET);
+    fwrite(&h, 1, sizeof(h), fp);
+    bool ok = fclose(fp) == 0;
+
+    free(chunks);
+    free(refs);
+    free(basePages);
+    free(hashes);
+    freeStore(store);
+    return ok;
+}
+
+// Reads back every page, like SaveState_Restore does
+static void checkSnapshot(const SsFile *f, const SsFile *base, const Memory *mem)
+{
+    static u8 page[SAVESTATE_PAGE_SIZE];
+    u32 p = 0;
+
+    for (u32 i = 0; i < mem->numRegions; i++)
+    {
+        for (u32 off = 0; off < mem->regions[i].size; off += SAVESTATE_PAGE_SIZE, p++)
+        {
+            const char *err = SsFile_ReadPage(f, base, p, page);
+            if (err != NULL)
+                printf("    page %u: %s\n", p, err);
+            CHECK(err == NULL && memcmp(page, mem->data[i] + off, SAVESTATE_PAGE_SIZE) == 0);
+        }
+    }
+}
+
+static void testSnapshots(void)
+{
+    // Heap with a bit of everything, a zero-filled region and a mostly random one
+    Memory mem = {
+        .regions = { { 0x08000000, 0x40000, 3, 5 }, { 0x10000000, 0x10000, 3, 7 }, { 0x14000000, 0x20000, 3, 5 } },
+        .numRegions = 3,
+    };
+    SsFile full, incremental;
+    const char *err;
+
+    printf("full and incremental snapshots\n");
+    for (u32 i = 0; i < mem.numRegions; i++)
+        mem.data[i] = calloc(1, mem.regions[i].size);
+    for (u32 off = 0; off < 0x40000; off += SAVESTATE_PAGE_SIZE)
+    {
+        if ((off / SAVESTATE_PAGE_SIZE) % 4 == 1)
+            fillPage(mem.data[0] + off, 42, true); // duplicates
+        else if ((off / SAVESTATE_PAGE_SIZE) % 4 == 2)
+            fillPage(mem.data[0] + off, off, true);
+    }
+    for (u32 off = 0; off < 0x20000; off += SAVESTATE_PAGE_SIZE)
+        fillPage(mem.data[2] + off, off + 1, false);
+
+    CHECK(writeSnapshot("build/full.lss", &mem, NULL, 1000));
+    err = SsFile_Load(&full, "build/full.lss");
+    if (err != NULL)
+    {
+        printf("    build/full.lss: %s\n", err);
+        failed = true;
+        return;
+    }
+
+    const SaveStateHeader *h = full.header;
+    CHECK(h->numPages == 0x70);
+    CHECK(h->numZeroPages == 0x20 + 0x10);      // every other page of the first region, and the second region
+    CHECK(h->numDedupPages == 0x10 - 1);
+    CHECK(h->numChunks == 1 + 0x10 + 0x20);
+    CHECK(h->numBasePages == 0);
+    CHECK(h->chunkDataSize < 0x20 * SAVESTATE_PAGE_SIZE + 0x11 * SAVESTATE_PAGE_SIZE / 2);
+    checkSnapshot(&full, NULL, &mem);
+
+    // Change two pages, unmap the zero region and map a new one
+    mem.data[0][0x5000] ^= 1;
+    memset(mem.data[2] + 0x3000, 0, SAVESTATE_PAGE_SIZE);
+    mem.regions[1] = (SaveStateRegion){ 0x12000000, 0x2000, 3, 5 };
+    fillPage(mem.data[1], 7, true);
+    fillPage(mem.data[1] + 0x1000, 7, true);
+
+    CHECK(writeSnapshot("build/incremental.lss", &mem, &full, 2000));
+    err = SsFile_Load(&incremental, "build/incremental.lss");
+    if (err != NULL)
+    {
+        printf("    build/incremental.lss: %s\n", err);
+        failed = true;
+        SsFile_Free(&full);
+        return;
+    }
+
+    h = incremental.header;
+    CHECK(h->flags & SAVESTATE_FLAG_INCREMENTAL);
+    CHECK(h->baseId == 1000);
+    CHECK(h->numChunks == 2);                   // the changed page and the new region (twice the same page)
+    CHECK(h->numDedupPages == 1);
+    CHECK(h->numZeroPages == 0x20 + 1);
+    CHECK(h->numBasePages == (0x20 - 1) + (0x20 - 1));
+    CHECK(h->numBasePages + h->numZeroPages + h->numDedupPages + h->numChunks == h->numPages);
+    checkSnapshot(&incremental, &full, &mem);
+
+    // Without the right base, base references must not resolve
+    u8 page[SAVESTATE_PAGE_SIZE];
+    CHECK(SsFile_ReadPage(&incremental, NULL, 1, page) != NULL);
+    CHECK(SsFile_ReadPage(&incremental, &incremental, 1, page) != NULL);
+
+    SsFile_Free(&incremental);
+    SsFile_Free(&full);
+    for (u32 i = 0; i < mem.numRegions; i++)
+        free(mem.data[i]);
+}
+
+int main(void)
+{
+    testLz4();
+    testStore();
+    testMatchBasePages();
+    testSnapshots();
+
+    printf(failed ? "FAILED\n" : "all tests passed\n");
+    return failed ? 1 : 0;
+}
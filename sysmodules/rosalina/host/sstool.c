@@ -0,0 +1,212 @@
+/*
+*   This file is part of Luma3DS.
+*   Copyright (C) 2016-2022 Aurora Wright, TuxSH
+*
+*   SPDX-License-Identifier: (MIT OR GPL-2.0-or-later)
+*/
+
+/* Inspects the save states Rosalina writes to /luma/savestates/<title ID>/slot<n>.lss:
+       sstool info FILE            header, regions and threads
+       sstool diff A B             address ranges whose contents differ, from the page hashes
+       sstool verify FILE [BASE]   decompresses every page and checks its hash (BASE: slot 0, for incremental snapshots)
+*/
+
+#include <inttypes.h>
+#include <stdio.h>
+#include <string.h>
+#include "ssfile.h"
+
+static const char *const memStates[] = {
+    "free", "reserved", "io", "static", "code", "private", "shared", "continuous",
+    "aliased", "alias", "alias code", "locked",
+};
+
+static int info(const SsFile *f)
+{
+    const SaveStateHeader *h = f->header;
+    u64 stored = (u64)h->numPages * SAVESTATE_PAGE_SIZE;
+
+    printf("title ID        %016" PRIX64 "\n", h->titleId);
+    printf("id              %016" PRIX64 "\n", h->id);
+    if (h->flags & SAVESTATE_FLAG_INCREMENTAL)
+        printf("incremental, based on %016" PRIX64 "\n", h->baseId);
+    printf("pages           %u (%u KB)\n", h->numPages, h->numPages * (SAVESTATE_PAGE_SIZE >> 10));
+    printf("  zero          %u\n", h->numZeroPages);
+    printf("  unchanged     %u\n", h->numBasePages);
+    printf("  duplicate     %u\n", h->numDedupPages);
+    printf("  stored        %u chunks, %u KB", h->numChunks, h->chunkDataSize >> 10);
+    if (stored != 0)
+        printf(" (%.1f%% of the memory)", 100.0 * h->chunkDataSize / stored);
+    printf("\nfile size       %" PRIu64 " KB\n\n", f->size >> 10);
+
+    printf("%u regions:\n", h->numRegions);
+    for (u32 i = 0; i < h->numRegions; i++)
+    {
+        const SaveStateRegion *r = &f->regions[i];
+        printf("  %08X-%08X %c%c%c %s\n", r->addr, r->addr + r->size, r->perm & 1 ? 'r' : '-', r->perm & 2 ? 'w' : '-', r->perm & 4 ? 'x' : '-',
+               r->state < sizeof(memStates) / sizeof(memStates[0]) ? memStates[r->state] : "?");
+    }
+
+    printf("\n%u threads:\n", h->numThreads);
+    for (u32 i = 0; i < h->numThreads; i++)
+    {
+        const SaveStateThread *t = &f->threads[i];
+        printf("  %3u  pc %08X lr %08X sp %08X cpsr %08X\n", t->threadId, t->cpu[15], t->cpu[14], t->cpu[13], t->cpu[16]);
+    }
+
+    return 0;
+}
+
+// Page hashes are those of the actual contents, even for pages left in the base snapshot
+static bool getPageHash(const SsFile *f, u32 addr, u64 *hash)
+{
+    u32 page = SsFile_FindPage(f, addr);
+
+    if (page == SAVESTATE_NO_BASE_PAGE)
+        return false;
+
+    *hash = f->pageHashes[page];
+    return true;
+}
+
+static void printRange(u32 start, u32 end, const char *what)
+{
+    if (start != end)
+        printf("  %08X-%08X %s (%u pages)\n", start, end, what, (end - start) / SAVESTATE_PAGE_SIZE);
+}
+
+static int diff(const SsFile *a, const SsFile *b)
+{
+    u32 numDiffering = 0, numOnlyA = 0, numOnlyB = 0;
+    u32 rangeStart = 0, rangeEnd = 0;
+    const char *rangeWhat = NULL;
+
+    // Merge the page addresses of both files, they are sorted
+    const SsFile *files[2] = { a, b };
+    u32 regionIdx[2] = { 0, 0 }, offset[2] = { 0, 0 };
+
+    for (;;)
+    {
+        u32 addr[2];
+        for (u32 i = 0; i < 2; i++)
+        {
+            const SsFile *f = files[i];
+            addr[i] = regionIdx[i] < f->header->numRegions ? f->regions[regionIdx[i]].addr + offset[i] : UINT32_MAX;
+        }
+        if (addr[0] == UINT32_MAX && addr[1] == UINT32_MAX)
+            break;
+
+        u32 cur = addr[0] < addr[1] ? addr[0] : addr[1];
+        const char *what = NULL;
+        u64 hashA, hashB;
+
+        if (addr[0] != cur)
+        {
+            what = "only in the second file";
+            numOnlyB++;
+        }
+        else if (addr[1] != cur)
+        {
+            what = "only in the first file";
+            numOnlyA++;
+        }
+        else if (getPageHash(a, cur, &hashA) && getPageHash(b, cur, &hashB) && hashA != hashB)
+        {
+            what = "differs";
+            numDiffering++;
+        }
+
+        if (what != rangeWhat || cur != rangeEnd)
+        {
+            if (rangeWhat != NULL)
+                printRange(rangeStart, rangeEnd, rangeWhat);
+            rangeStart = cur;
+            rangeWhat = what;
+        }
+        rangeEnd = cur + SAVESTATE_PAGE_SIZE;
+
+        for (u32 i = 0; i < 2; i++)
+        {
+            if (addr[i] != cur)
+                continue;
+            offset[i] += SAVESTATE_PAGE_SIZE;
+            if (offset[i] == files[i]->regions[regionIdx[i]].size)
+            {
+                regionIdx[i]++;
+                offset[i] = 0;
+            }
+        }
+    }
+
+    if (rangeWhat != NULL)
+        printRange(rangeStart, rangeEnd, rangeWhat);
+
+    printf("%u pages differ, %u only in the first file, %u only in the second file\n", numDiffering, numOnlyA, numOnlyB);
+    return numDiffering + numOnlyA + numOnlyB != 0 ? 1 : 0;
+}
+
+static int verify(const SsFile *f, const SsFile *base)
+{
+    static u8 page[SAVESTATE_PAGE_SIZE];
+    u32 numErrors = 0;
+
+    for (u32 i = 0; i < f->header->numPages; i++)
+    {
+        const char *err = SsFile_ReadPage(f, base, i, page);
+        u64 hash = SaveStateStore_IsZeroPage(page) ? SAVESTATE_ZERO_PAGE_HASH : SaveStateStore_HashPage(page);
+
+        if (err == NULL && hash != f->pageHashes[i])
+            err = "page hash mismatch";
+        if (err != NULL && numErrors++ < 16)
+            printf("  %08X: %s\n", SsFile_GetPageAddress(f, i), err);
+    }
+
+    printf("%u pages checked, %u errors\n", f->header->numPages, numErrors);
+    return numErrors != 0 ? 1 : 0;
+}
+
+static int usage(void)
+{
+    fprintf(stderr, "usage: sstool info FILE | diff A B | verify FILE [BASE]\n");
+    return 2;
+}
+
+int main(int argc, char *argv[])
+{
+    SsFile files[2];
+    u32 numFiles = (u32)argc - 2;
+    const char *err = NULL;
+    int ret;
+
+    if (argc < 3 || argc > 4 || (strcmp(argv[1], "info") == 0 && argc != 3) || (strcmp(argv[1], "diff") == 0 && argc != 4))
+        return usage();
+
+    for (u32 i = 0; i < numFiles && err == NULL; i++)
+    {
+        err = SsFile_Load(&files[i], argv[2 + i]);
+        if (err != NULL)
+        {
+            fprintf(stderr, "%s: %s\n", argv[2 + i], err);
+            numFiles = i;
+        }
+    }
+    if (err != NULL)
+    {
+        for (u32 i = 0; i < numFiles; i++)
+            SsFile_Free(&files[i]);
+        return 2;
+    }
+
+    if (strcmp(argv[1], "info") == 0)
+        ret = info(&files[0]);
+    else if (strcmp(argv[1], "diff") == 0)
+        ret = diff(&files[0], &files[1]);
+    else if (strcmp(argv[1], "verify") == 0)
+        ret = verify(&files[0], numFiles == 2 ? &files[1] : NULL);
+    else
+        ret = usage();
+
+    for (u32 i = 0; i < numFiles; i++)
+        SsFile_Free(&files[i]);
+    return ret;
+}
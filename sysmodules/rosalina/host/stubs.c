@@ -0,0 +1,187 @@
+/*
+*   This file is part of Luma3DS.
+*   Copyright (C) 2016-2020 Aurora Wright, TuxSH
+*
+*   SPDX-License-Identifier: (MIT OR GPL-2.0-or-later)
+*/
+
+/* What sock_util.c links against on the host: kernel events (pthreads), the system tick
+   (CLOCK_MONOTONIC), and the AC, sleep and termination state of Rosalina, which never change. */
+
+#include <pthread.h>
+#include <stdlib.h>
+#include <time.h>
+#include <3ds/svc.h>
+#include <3ds/os.h>
+#include <3ds/services/ac.h>
+#include "minisoc.h"
+#include "sleep.h"
+
+#define MAX_EVENTS          16
+#define ERR_TIMEOUT         ((Result)0x09401BFE)
+#define ERR_INVALID_HANDLE  ((Result)0xD8E007F7)
+
+typedef struct HostEvent
+{
+    bool used;
+    bool signaled;
+    ResetType resetType;
+} HostEvent;
+
+static pthread_mutex_t eventsLock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t eventsCond = PTHREAD_COND_INITIALIZER;
+static HostEvent events[MAX_EVENTS];
+
+Handle preTerminationEvent;
+bool preTerminationRequested = false;
+
+static HostEvent *getEvent(Handle handle)
+{
+    return handle >= 1 && handle <= MAX_EVENTS && events[handle - 1].used ? &events[handle - 1] : NULL;
+}
+
+Result svcCreateEvent(Handle *event, ResetType resetType)
+{
+    pthread_mutex_lock(&eventsLock);
+    for(u32 i = 0; i < MAX_EVENTS; i++)
+    {
+        if(!events[i].used)
+        {
+            events[i] = (HostEvent){ .used = true, .signaled = false, .resetType = resetType };
+            *event = i + 1;
+            pthread_mutex_unlock(&eventsLock);
+            return 0;
+        }
+    }
+    pthread_mutex_unlock(&eventsLock);
+    return -1;
+}
+
+Result svcSignalEvent(Handle handle)
+{
+    pthread_mutex_lock(&eventsLock);
+    HostEvent *ev = getEvent(handle);
+    if(ev != NULL)
+        ev->signaled = true;
+    pthread_cond_broadcast(&eventsCond);
+    pthread_mutex_unlock(&eventsLock);
+    return ev != NULL ? 0 : ERR_INVALID_HANDLE;
+}
+
+Result svcClearEvent(Handle handle)
+{
+    pthread_mutex_lock(&eventsLock);
+    HostEvent *ev = getEvent(handle);
+    if(ev != NULL)
+        ev->signaled = false;
+    pthread_mutex_unlock(&eventsLock);
+    return ev != NULL ? 0 : ERR_INVALID_HANDLE;
+}
+
+Result svcCloseHandle(Handle handle)
+{
+    pthread_mutex_lock(&eventsLock);
+    HostEvent *ev = getEvent(handle);
+    if(ev != NULL)
+        ev->used = false;
+    pthread_mutex_unlock(&eventsLock);
+    return ev != NULL ? 0 : ERR_INVALID_HANDLE;
+}
+
+Result svcWaitSynchronizationN(s32 *out, const Handle *handles, s32 handlesNum, bool waitAll, s64 nanoseconds)
+{
+    struct timespec deadline;
+    clock_gettime(CLOCK_REALTIME, &deadline);
+    if(nanoseconds > 0)
+    {
+        deadline.tv_sec += nanoseconds / 1000000000LL;
+        deadline.tv_nsec += nanoseconds % 1000000000LL;
+        if(deadline.tv_nsec >= 1000000000L)
+        {
+            deadline.tv_sec++;
+            deadline.tv_nsec -= 1000000000L;
+        }
+    }
+
+    (void)waitAll; // not used by the socket server
+    pthread_mutex_lock(&eventsLock);
+    for(;;)
+    {
+        for(s32 i = 0; i < handlesNum; i++)
+        {
+            HostEvent *ev = getEvent(handles[i]);
+            if(ev == NULL)
+            {
+                pthread_mutex_unlock(&eventsLock);
+                return ERR_INVALID_HANDLE;
+            }
+            else if(ev->signaled)
+            {
+                if(ev->resetType == RESET_ONESHOT)
+                    ev->signaled = false;
+                *out = i;
+                pthread_mutex_unlock(&eventsLock);
+                return 0;
+            }
+        }
+
+        if(nanoseconds == 0 || (nanoseconds > 0 && pthread_cond_timedwait(&eventsCond, &eventsLock, &deadline) != 0))
+            break;
+        else if(nanoseconds < 0)
+            pthread_cond_wait(&eventsCond, &eventsLock);
+    }
+    pthread_mutex_unlock(&eventsLock);
+
+    return ERR_TIMEOUT;
+}
+
+Result svcWaitSynchronization(Handle handle, s64 nanoseconds)
+{
+    s32 idx;
+    return svcWaitSynchronizationN(&idx, &handle, 1, false, nanoseconds);
+}
+
+void svcSleepThread(s64 ns)
+{
+    struct timespec ts = { .tv_sec = ns / 1000000000LL, .tv_nsec = ns % 1000000000LL };
+    nanosleep(&ts, NULL);
+}
+
+u64 svcGetSystemTick(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (u64)ts.tv_sec * SYSCLOCK_ARM11 + (u64)ts.tv_nsec * SYSCLOCK_ARM11 / 1000000000ULL;
+}
+
+Result acInit(void)
+{
+    return 0;
+}
+
+Result ACU_GetWifiStatus(u32 *out)
+{
+    *out = 1;
+    return 0;
+}
+
+Result ACU_GetStatus(u32 *out)
+{
+    *out = 3;
+    return 0;
+}
+
+bool Sleep__Status(void)
+{
+    return false;
+}
+
+long socGethostid(void)
+{
+    const char *host = getenv("SOCUTIL_HOST");
+    struct in_addr addr = { .s_addr = htonl(INADDR_LOOPBACK) };
+
+    if(host != NULL)
+        inet_pton(AF_INET, host, &addr);
+    return (long)addr.s_addr;
+}
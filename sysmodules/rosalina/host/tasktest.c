@@ -0,0 +1,334 @@
+/*
+*   This file is part of Luma3DS.
+*   Copyright (C) 2016-2020 Aurora Wright, TuxSH
+*
+*   SPDX-License-Identifier: (MIT OR GPL-2.0-or-later)
+*/
+
+/* Checks the task runner (task_runner.c) with its worker threads: tasks queued with TaskRunner_RunTask, as the
+   plugin loader and debugger do, must run one at a time in submission order even while tasks queued with
+   TaskRunner_SubmitTask run on the other worker. Also checks priorities, a full queue, waiting on handles,
+   and termination with tasks still pending.
+
+   Exits with status 1 if anything doesn't match.
+*/
+
+#include <stdio.h>
+#include <stdatomic.h>
+#include "task_runner.h"
+
+#define MAX_EVENTS          64
+#define SECOND_NS           1000000000LL
+
+typedef struct TestTaskArgs {
+    u32 id;
+    u32 sleepUs;
+    LightEvent *blockOn;    ///< Waited on before returning, if not NULL
+} TestTaskArgs;
+
+static bool failed;
+
+// Start and end of each task, in the order they happened
+static LightLock eventsLock;
+static u32 events[MAX_EVENTS];
+static u32 numEvents;
+
+static atomic_int numSerialRunning, maxSerialRunning, numRunning, maxRunning;
+
+#define EVENT_START(id)     (0x100 | (id))
+#define EVENT_END(id)       (0x200 | (id))
+
+static void expect(const char *name, bool ok)
+{
+    if (!ok)
+    {
+        printf("    %s: FAILED\n", name);
+        failed = true;
+    }
+}
+
+static void recordEvent(u32 event)
+{
+    LightLock_Lock(&eventsLock);
+    if (numEvents < MAX_EVENTS)
+        events[numEvents++] = event;
+    LightLock_Unlock(&eventsLock);
+}
+
+static s32 eventIndex(u32 event)
+{
+    LightLock_Lock(&eventsLock);
+    s32 idx = -1;
+    for (u32 i = 0; i < numEvents && idx < 0; i++)
+    {
+        if (events[i] == event)
+            idx = (s32)i;
+    }
+    LightLock_Unlock(&eventsLock);
+    return idx;
+}
+
+static bool happenedBefore(u32 first, u32 second)
+{
+    s32 a = eventIndex(first), b = eventIndex(second);
+    return a >= 0 && b >= 0 && a < b;
+}
+
+static void resetEvents(void)
+{
+    LightLock_Lock(&eventsLock);
+    numEvents = 0;
+    LightLock_Unlock(&eventsLock);
+    numSerialRunning = maxSerialRunning = numRunning = maxRunning = 0;
+}
+
+static void updateMax(atomic_int *max, int value)
+{
+    int old = atomic_load(max);
+    while (value > old && !atomic_compare_exchange_weak(max, &old, value));
+}
+
+static void runTestTask(const TestTaskArgs *args, atomic_int *lane, atomic_int *laneMax)
+{
+    if (lane != NULL)
+        updateMax(laneMax, atomic_fetch_add(lane, 1) + 1);
+    updateMax(&maxRunning, atomic_fetch_add(&numRunning, 1) + 1);
+
+    recordEvent(EVENT_START(args->id));
+    if (args->sleepUs != 0)
+        svcSleepThread(args->sleepUs * 1000LL);
+    if (args->blockOn != NULL)
+        LightEvent_Wait(args->blockOn);
+    recordEvent(EVENT_END(args->id));
+
+    atomic_fetch_sub(&numRunning, 1);
+    if (lane != NULL)
+        atomic_fetch_sub(lane, 1);
+}
+
+static void serialTask(void *argdata)
+{
+    runTestTask((const TestTaskArgs *)argdata, &numSerialRunning, &maxSerialRunning);
+}
+
+static void concurrentTask(void *argdata)
+{
+    runTestTask((const TestTaskArgs *)argdata, NULL, NULL);
+}
+
+static void runSerial(u32 id, u32 sleepUs, LightEvent *blockOn)
+{
+    TestTaskArgs args = { id, sleepUs, blockOn };
+    TaskRunner_RunTask(serialTask, &args, sizeof(args));
+}
+
+static TaskHandle submit(u32 id, u32 sleepUs, LightEvent *blockOn, TaskPriority priority)
+{
+    TestTaskArgs args = { id, sleepUs, blockOn };
+    return TaskRunner_SubmitTask(concurrentTask, &args, sizeof(args), priority);
+}
+
+static bool waitStarted(u32 id)
+{
+    for (u32 i = 0; i < 1000; i++)
+    {
+        if (eventIndex(EVENT_START(id)) >= 0)
+            return true;
+        svcSleepThread(1000 * 1000LL);
+    }
+
+    return false;
+}
+
+static void testSerialOrder(void)
+{
+    printf("Serial tasks:\n");
+    resetEvents();
+
+    // As in plgloader.c: SetMode3AppMode, then WaitForProcessTerminated (which can block for seconds),
+    // then the debugger's task for the next application
+    runSerial(1, 20000, NULL);
+    runSerial(2, 5000, NULL);
+    runSerial(3, 0, NULL);
+    for (u32 i = 4; i < 12; i++)
+        runSerial(i, i % 3 == 0 ? 1000 : 0, NULL);
+    TaskRunner_WaitReady();
+
+    expect("never concurrent", maxSerialRunning == 1);
+    bool ordered = true;
+    for (u32 i = 1; i < 11; i++)
+        ordered = ordered && happenedBefore(EVENT_END(i), EVENT_START(i + 1));
+    expect("submission order", ordered);
+}
+
+static void testSerialWithConcurrent(void)
+{
+    LightEvent release;
+    LightEvent_Init(&release, RESET_STICKY);
+
+    printf("Serial and concurrent tasks:\n");
+    resetEvents();
+
+    // A long serial task must not hold back the other lane, nor let the next serial task start
+    runSerial(1, 0, &release);
+    expect("first serial task started", waitStarted(1));
+    runSerial(2, 0, NULL);
+    TaskHandle handle = submit(3, 0, NULL, TASK_PRIORITY_NORMAL);
+    expect("submitted", handle != TASK_HANDLE_INVALID);
+    expect("concurrent task done while serial is blocked", TaskRunner_WaitTask(handle, SECOND_NS));
+    svcSleepThread(10 * 1000 * 1000LL);
+    expect("second serial task waiting", eventIndex(EVENT_START(2)) < 0);
+
+    LightEvent_Signal(&release);
+    TaskRunner_WaitReady();
+    expect("second serial task after the first", happenedBefore(EVENT_END(1), EVENT_START(2)));
+    expect("never concurrent", maxSerialRunning == 1);
+    expect("both workers used", maxRunning == 2);
+}
+
+static void testPriorities(void)
+{
+    LightEvent release1, release2;
+    LightEvent_Init(&release1, RESET_STICKY);
+    LightEvent_Init(&release2, RESET_STICKY);
+
+    printf("Priorities:\n");
+    resetEvents();
+
+    // Both workers busy, then the queued tasks run on the first one to be released
+    TaskHandle blocker1 = submit(1, 0, &release1, TASK_PRIORITY_NORMAL);
+    TaskHandle blocker2 = submit(2, 0, &release2, TASK_PRIORITY_NORMAL);
+    expect("workers busy", waitStarted(1) && waitStarted(2));
+
+    TaskHandle low = submit(3, 0, NULL, TASK_PRIORITY_LOW);
+    TaskHandle normal = submit(4, 0, NULL, TASK_PRIORITY_NORMAL);
+    TaskHandle high = submit(5, 0, NULL, TASK_PRIORITY_HIGH);
+    expect("not started", !TaskRunner_WaitTask(high, 10 * 1000 * 1000LL));
+
+    LightEvent_Signal(&release1);
+    expect("completed", TaskRunner_WaitTask(low, SECOND_NS) && TaskRunner_WaitTask(normal, SECOND_NS) && TaskRunner_WaitTask(high, SECOND_NS));
+    expect("highest priority first", happenedBefore(EVENT_END(5), EVENT_START(4)) && happenedBefore(EVENT_END(4), EVENT_START(3)));
+    expect("blocker 2 still running", !TaskRunner_WaitTask(blocker2, 0));
+
+    LightEvent_Signal(&release2);
+    expect("blockers completed", TaskRunner_WaitTask(blocker1, SECOND_NS) && TaskRunner_WaitTask(blocker2, SECOND_NS));
+    TaskRunner_WaitReady();
+}
+
+static void testQueueFull(void)
+{
+    LightEvent release;
+    LightEvent_Init(&release, RESET_STICKY);
+    TaskRunnerStats before, after;
+    TaskHandle handles[TASK_RUNNER_QUEUE_SIZE];
+
+    printf("Full queue:\n");
+    resetEvents();
+    TaskRunner_GetStats(&before);
+
+    for (u32 i = 0; i < TASK_RUNNER_QUEUE_SIZE; i++)
+    {
+        handles[i] = submit(i + 1, 0, &release, TASK_PRIORITY_LOW);
+        expect("submitted", handles[i] != TASK_HANDLE_INVALID);
+    }
+
+    expect("rejected", submit(0x20, 0, NULL, TASK_PRIORITY_HIGH) == TASK_HANDLE_INVALID);
+    TaskRunner_GetStats(&after);
+    expect("rejection counted", after.rejected == before.rejected + 1);
+    expect("queue depth", after.maxQueueDepth == TASK_RUNNER_QUEUE_SIZE);
+
+    LightEvent_Signal(&release);
+    for (u32 i = 0; i < TASK_RUNNER_QUEUE_SIZE; i++)
+        expect("completed", TaskRunner_WaitTask(handles[i], SECOND_NS));
+
+    // Stale handles of reused slots are complete
+    TaskHandle reused = submit(0x21, 0, NULL, TASK_PRIORITY_NORMAL);
+    expect("new handle", reused != TASK_HANDLE_INVALID && reused != handles[0]);
+    expect("stale handle", TaskRunner_WaitTask(handles[0], 0));
+    TaskRunner_WaitReady();
+}
+
+typedef struct ProducerArgs {
+    u32 first;
+    u32 count;
+} ProducerArgs;
+
+static void *producer(void *arg)
+{
+    const ProducerArgs *args = (const ProducerArgs *)arg;
+    for (u32 i = 0; i < args->count; i++)
+    {
+        if (i % 2 == 0)
+            runSerial(args->first + i, 200, NULL);
+        else
+            while (submit(args->first + i, 200, NULL, (TaskPriority)(i % TASK_PRIORITY_COUNT)) == TASK_HANDLE_INVALID)
+                svcSleepThread(100 * 1000LL);
+    }
+
+    return NULL;
+}
+
+static void testStress(void)
+{
+    pthread_t threads[3];
+    ProducerArgs args[3] = { { 0x00, 10 }, { 0x10, 10 }, { 0x20, 10 } };
+
+    printf("Several submitters:\n");
+    resetEvents();
+
+    for (u32 i = 0; i < 3; i++)
+        pthread_create(&threads[i], NULL, producer, &args[i]);
+    for (u32 i = 0; i < 3; i++)
+        pthread_join(threads[i], NULL);
+    TaskRunner_WaitReady();
+
+    expect("serial tasks never concurrent", maxSerialRunning == 1);
+    expect("all run", numEvents == 2 * 3 * 10);
+
+    // Each submitter's serial tasks run in its order
+    bool ordered = true;
+    for (u32 i = 0; i < 3; i++)
+    {
+        for (u32 j = 2; j < args[i].count; j += 2)
+            ordered = ordered && happenedBefore(EVENT_END(args[i].first + j - 2), EVENT_START(args[i].first + j));
+    }
+    expect("per-submitter order", ordered);
+}
+
+static void testTerminate(void)
+{
+    TaskRunnerStats stats;
+
+    printf("Termination:\n");
+    resetEvents();
+
+    // Pending tasks, including a serial one waiting for the other, still run
+    runSerial(1, 20000, NULL);
+    runSerial(2, 0, NULL);
+    submit(3, 0, NULL, TASK_PRIORITY_LOW);
+    TaskRunner_Terminate();
+    TaskRunner_JoinThreads(-1LL);
+
+    expect("pending tasks run", eventIndex(EVENT_END(1)) >= 0 && eventIndex(EVENT_END(2)) >= 0 && eventIndex(EVENT_END(3)) >= 0);
+    expect("serial order", happenedBefore(EVENT_END(1), EVENT_START(2)));
+
+    TaskRunner_GetStats(&stats);
+    expect("all completed", stats.completed == stats.submitted);
+    printf("    %u tasks, %u rejected, max queue depth %u\n", stats.completed, stats.rejected, stats.maxQueueDepth);
+}
+
+int main(void)
+{
+    LightLock_Init(&eventsLock);
+    taskRunnerCreateThreads();
+
+    testSerialOrder();
+    testSerialWithConcurrent();
+    testPriorities();
+    testQueueFull();
+    testStress();
+    testTerminate();
+
+    printf(failed ? "FAILED\n" : "ok\n");
+    return failed ? 1 : 0;
+}
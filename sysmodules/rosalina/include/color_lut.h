@@ -0,0 +1,39 @@
+/*
+*   This file is part of Luma3DS
+*   Copyright (C) 2016-2022 Aurora Wright, TuxSH
+*
+*   This program is free software: you can redistribute it and/or modify
+*   it under the terms of the GNU General Public License as published by
+*   the Free Software Foundation, either version 3 of the License, or
+*   (at your option) any later version.
+*
+*   This program is distributed in the hope that it will be useful,
+*   but WITHOUT ANY WARRANTY; without even the implied warranty of
+*   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*   GNU General Public License for more details.
+*
+*   You should have received a copy of the GNU General Public License
+*   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*
+*   Additional Terms 7.b and 7.c of GPLv3 apply to this file:
+*       * Requiring preservation of specified reasonable legal notices or
+*         author attributions in that material or in the Appropriate Legal
+*         Notices displayed by works containing it.
+*       * Prohibiting misrepresentation of the origin of that material,
+*         or requiring that modified versions of such material be marked in
+*         reasonable ways as different from the original version.
+*/
+
+#pragma once
+
+#include <3ds/types.h>
+#include "menus/screen_filters.h"
+
+// Finished LUTs of the last few filter settings, so that switching between presets or restoring them after sleep is just a register upload
+#define COLOR_LUT_CACHE_SIZE    4
+
+// Fractional bits of the fixed-point levels (1.0 = 1 << COLOR_LUT_FRAC_BITS)
+#define COLOR_LUT_FRAC_BITS     24
+
+/// Returns the 256 GPU color LUT entries (0x00BBGGRR) for the filter settings, computing them on a cache miss
+const u32 *ColorLut_Get(const ScreenFilter *filter);
@@ -0,0 +1,59 @@
+/*
+*   This file is part of Luma3DS
+*   Copyright (C) 2016-2022 Aurora Wright, TuxSH
+*
+*   This program is free software: you can redistribute it and/or modify
+*   it under the terms of the GNU General Public License as published by
+*   the Free Software Foundation, either version 3 of the License, or
+*   (at your option) any later version.
+*
+*   This program is distributed in the hope that it will be useful,
+*   but WITHOUT ANY WARRANTY; without even the implied warranty of
+*   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*   GNU General Public License for more details.
+*
+*   You should have received a copy of the GNU General Public License
+*   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*
+*   Additional Terms 7.b and 7.c of GPLv3 apply to this file:
+*       * Requiring preservation of specified reasonable legal notices or
+*         author attributions in that material or in the Appropriate Legal
+*         Notices displayed by works containing it.
+*       * Prohibiting misrepresentation of the origin of that material,
+*         or requiring that modified versions of such material be marked in
+*         reasonable ways as different from the original version.
+*/
+
+#pragma once
+
+#include <3ds/types.h>
+#include "utils.h"
+
+// Staging buffers, allocated from the SYSTEM region for the duration of a dump
+#define COREDUMP_HEAP_ADDR          0x0E800000
+#define COREDUMP_MAP_ADDR           0x00100000
+#define COREDUMP_MAP_WINDOW_SIZE    0x400000
+
+#define COREDUMP_MAX_SEGMENTS       64
+#define COREDUMP_MAX_THREADS        32
+
+// Compressed dumps are a sequence of LZ4 blocks wrapping the ELF file, see tools/coredump.py
+#define COREDUMP_LZ4C_MAGIC         0x43345A4C // 'LZ4C'
+#define COREDUMP_LZ4C_BLOCK_SIZE    0x4000
+
+typedef struct CoreDumpStats
+{
+    u32 numSegments;
+    u32 numThreads;
+    u64 rawSize;
+    u64 fileSize;
+    u32 elapsedMs;
+} CoreDumpStats;
+
+/// Writes an ELF core file (PT_LOAD per mapped region, NT_PRSTATUS and NT_ARM_VFP per thread) of the process to /luma/dumps/memory
+Result CoreDump_DumpProcess(u32 pid, const char *name, bool compress, CoreDumpStats *stats);
+
+/// Attaches then waits for the attach break, so that all the threads are stopped. Returns the number of thread IDs written (at most COREDUMP_MAX_THREADS).
+u32 CoreDump_FreezeProcess(Handle debug, u32 *threadIds);
+/// Continues all pending debug events, then detaches.
+void CoreDump_ResumeProcess(Handle debug);
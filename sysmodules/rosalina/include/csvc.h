@@ -70,6 +70,30 @@ void svcInvalidateInstructionCacheRange(void *addr, u32 len);
  * @brief Invalidates the data cache entirely.
 */
 void svcInvalidateEntireInstructionCache(void);
+
+/// Physically contiguous part of a virtual address range, see @ref svcConvertVARangeToPA
+typedef struct PhysicalRun
+{
+    u32 va;
+    u32 pa;
+    u32 size;
+    u32 attributes; ///< See PHYSRUN_PERM, PHYSRUN_MEMTYPE and PHYSRUN_SHARED
+} PhysicalRun;
+
+#define PHYSRUN_PERM(attributes)    ((attributes) & 7)              ///< MemPerm, as seen by the process
+#define PHYSRUN_MEMTYPE(attributes) (((attributes) >> 8) & 0x1F)   ///< TEX[2:0], C, B
+#define PHYSRUN_SHARED(attributes)  (((attributes) >> 16) & 1)
+
+/**
+ * @brief Gives the physically contiguous runs a virtual address range of a process is made of, unmapped parts being skipped.
+ * @param out Output runs.
+ * @param maxRuns Maximum number of runs to write.
+ * @param process Handle of the process.
+ * @param VA Start of the range, which must be in the user address space (below 0x40000000).
+ * @param size Size of the range.
+ * @return The number of runs written, or an error. If it is maxRuns, the rest of the range starts after the last run.
+*/
+Result svcConvertVARangeToPA(PhysicalRun *out, u32 maxRuns, Handle process, u32 VA, u32 size);
 ///@}
 
 ///@name Memory management
@@ -95,6 +95,9 @@ u32 Draw_DrawString(u32 posX, u32 posY, u32 color, const char *string);
 __attribute__((format(printf,4,5)))
 u32 Draw_DrawFormattedString(u32 posX, u32 posY, u32 color, const char *fmt, ...);
 
+/// Draws on the framebuffer displayed on a screen, in its format, e.g. over a running application. Doesn't wrap lines.
+u32 Draw_DrawStringOnScreen(bool top, u32 posX, u32 posY, u32 color, const char *string);
+
 void Draw_FillFramebuffer(u32 value);
 void Draw_ClearFramebuffer(void);
 Result Draw_AllocateFramebufferCache(u32 size);
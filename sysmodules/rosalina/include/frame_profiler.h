@@ -0,0 +1,59 @@
+/*
+*   This file is part of Luma3DS
+*   Copyright (C) 2016-2022 Aurora Wright, TuxSH
+*
+*   This program is free software: you can redistribute it and/or modify
+*   it under the terms of the GNU General Public License as published by
+*   the Free Software Foundation, either version 3 of the License, or
+*   (at your option) any later version.
+*
+*   This program is distributed in the hope that it will be useful,
+*   but WITHOUT ANY WARRANTY; without even the implied warranty of
+*   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*   GNU General Public License for more details.
+*
+*   You should have received a copy of the GNU General Public License
+*   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*
+*   Additional Terms 7.b and 7.c of GPLv3 apply to this file:
+*       * Requiring preservation of specified reasonable legal notices or
+*         author attributions in that material or in the Appropriate Legal
+*         Notices displayed by works containing it.
+*       * Prohibiting misrepresentation of the origin of that material,
+*         or requiring that modified versions of such material be marked in
+*         reasonable ways as different from the original version.
+*/
+
+#pragma once
+
+#include <3ds/types.h>
+#include "frame_stats.h"
+
+// Measures the frame pacing of both screens from the framebuffer swaps done by GSP, which happen on VBlank when an
+// application presents a new framebuffer. The profiler polls the LCD framebuffer registers and timestamps every change.
+
+#define FRAME_PROFILER_POLL_PERIOD_US   500
+#define FRAME_PROFILER_VBLANK_PERIOD_US 16713   // 59.83 Hz
+#define FRAME_PROFILER_SUMMARY_PERIOD   15      // Top screen frames between two updates of the overlay text
+
+#define FRAME_PROFILER_ERR_NOT_STARTED  MAKERESULT(RL_PERMANENT, RS_INVALIDSTATE, RM_APPLICATION, RD_NOT_INITIALIZED)
+
+typedef enum FrameProfilerScreen
+{
+    FRAME_PROFILER_SCREEN_TOP = 0,
+    FRAME_PROFILER_SCREEN_BOTTOM,
+    FRAME_PROFILER_NUM_SCREENS,
+} FrameProfilerScreen;
+
+extern bool frameProfilerEnabled;
+extern bool frameProfilerOverlayEnabled;
+
+/// Starts profiling from scratch. Profiling is paused while the menu is open.
+Result FrameProfiler_Start(void);
+Result FrameProfiler_Stop(s64 timeout);
+
+/// Copies the statistics of a screen (not thread-safe, only meant for the menu, which pauses the profiler).
+void FrameProfiler_GetStats(FrameProfilerScreen screen, FrameStats *stats);
+
+/// Writes the summaries and histograms of both screens to /luma/frameprof/<title ID>_<date>.csv.
+Result FrameProfiler_ExportCsv(char *path);
@@ -0,0 +1,79 @@
+/*
+*   This file is part of Luma3DS
+*   Copyright (C) 2016-2022 Aurora Wright, TuxSH
+*
+*   This program is free software: you can redistribute it and/or modify
+*   it under the terms of the GNU General Public License as published by
+*   the Free Software Foundation, either version 3 of the License, or
+*   (at your option) any later version.
+*
+*   This program is distributed in the hope that it will be useful,
+*   but WITHOUT ANY WARRANTY; without even the implied warranty of
+*   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*   GNU General Public License for more details.
+*
+*   You should have received a copy of the GNU General Public License
+*   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*
+*   Additional Terms 7.b and 7.c of GPLv3 apply to this file:
+*       * Requiring preservation of specified reasonable legal notices or
+*         author attributions in that material or in the Appropriate Legal
+*         Notices displayed by works containing it.
+*       * Prohibiting misrepresentation of the origin of that material,
+*         or requiring that modified versions of such material be marked in
+*         reasonable ways as different from the original version.
+*/
+
+#pragma once
+
+#include <3ds/types.h>
+
+// Frame pacing statistics of one screen, computed from the times its framebuffers are swapped.
+// Shared with the host tests (host/fstest.c), so nothing console-specific here.
+
+#define FRAMESTATS_WINDOW_SIZE      1024    // Frames the rolling statistics are computed over
+#define FRAMESTATS_HISTOGRAM_BINS   100     // 1 ms each, the last one also counts longer frames
+#define FRAMESTATS_MAX_VBLANKS      8       // Last bin of the VBlank histogram, which also counts longer frames
+#define FRAMESTATS_MAX_LOW_FRAMES   (FRAMESTATS_WINDOW_SIZE / 100)
+
+typedef struct FrameStats
+{
+    u32 vblankPeriodUs;
+    bool hasLastSwap;
+    u64 lastSwapUs;
+
+    // Rolling window
+    u32 frameTimes[FRAMESTATS_WINDOW_SIZE]; ///< us, oldest first from windowHead when the window is full
+    u32 windowHead;
+    u32 windowCount;
+    u64 windowSumUs;
+
+    // Since the statistics were reset
+    u32 numFrames;
+    u64 totalUs;
+    u32 minFrameUs;
+    u32 maxFrameUs;
+    u32 histogram[FRAMESTATS_HISTOGRAM_BINS];
+    u32 vblankHistogram[FRAMESTATS_MAX_VBLANKS + 1];  ///< Frame times in VBlanks, rounded: 1 at full speed
+} FrameStats;
+
+typedef struct FrameStatsSummary
+{
+    u32 numFrames;      ///< In the window
+    u32 fpsX100;        ///< Over the window
+    u32 avgFrameUs;
+    u32 low1FpsX100;    ///< 1% low: frame rate of the slowest 1% frames of the window
+    u32 low01FpsX100;   ///< 0.1% low, at least the slowest frame of the window
+    u32 maxFrameUs;
+    u32 jitterUs;       ///< Average difference between consecutive frame times
+} FrameStatsSummary;
+
+void FrameStats_Init(FrameStats *stats, u32 vblankPeriodUs);
+
+/// Adds the frame ending with this swap. The first swap, and the first after FrameStats_Break, only start a frame.
+void FrameStats_AddSwap(FrameStats *stats, u64 timeUs);
+
+/// Forgets the last swap, e.g. while the application is paused, so that the pause isn't counted as a frame.
+void FrameStats_Break(FrameStats *stats);
+
+void FrameStats_GetSummary(const FrameStats *stats, FrameStatsSummary *summary);
@@ -21,6 +21,16 @@
 #define MAX_DEBUG_THREAD    127
 #define MAX_BREAKPOINT      64
 
+// Agent expression bytecode of the breakpoint conditions, see gdb/agent.h
+#define MAX_BREAKPOINT_CONDITIONS_SIZE      0x200
+#define BREAKPOINT_CONDITIONS_POOL_SIZE     0x800
+
+// Tracepoint definitions, their actions and trace state variables, see gdb/tracepoints.h
+#define MAX_TRACEPOINT                  32
+#define TRACEPOINT_ACTIONS_POOL_SIZE    0x800
+#define MAX_TRACE_STATE_VARIABLE        16
+#define MAX_TRACE_READ_ONLY_RANGE       16
+
 #define MAX_TIO_OPEN_FILE   32
 
 // 512+24 is the ideal size as IDA will try to read exactly 0x100 bytes at a time. Add 4 to this, for $#<checksum>, see below.
@@ -36,14 +46,95 @@
 #define GDB_DECLARE_QUERY_HANDLER(name)     GDB_DECLARE_HANDLER(Query##name)
 #define GDB_DECLARE_VERBOSE_HANDLER(name)   GDB_DECLARE_HANDLER(Verbose##name)
 
+enum
+{
+    BREAKPOINT_USER_GDB         = 1, // Z0
+    BREAKPOINT_USER_TRACEPOINT  = 2,
+};
+
 typedef struct Breakpoint
 {
     u32 address;
     u32 savedInstruction;
     u8 instructionSize;
     bool persistent;
+    u8 users;
+    u16 conditionsOffset; // in breakpointConditions, as a list of (u16 size, bytecode)
+    u16 conditionsSize;
 } Breakpoint;
 
+// Stepping over a breakpoint whose conditions are all false (or single stepping), with a temporary breakpoint on the next instruction
+typedef struct BreakpointStepOver
+{
+    u32 threadId; // 0 if none in progress
+    u32 address;
+    bool stepping; // single step requested by GDB (non-stop mode), the hit of the target is reported
+    Breakpoint target; // instructionSize is 0 if the next instruction already has a breakpoint
+} BreakpointStepOver;
+
+typedef struct Tracepoint
+{
+    u32 number;
+    u32 address;
+    bool enabled;
+    bool thumb;
+    bool collectRegisters;
+    u32 passCount;
+    u32 hitCount;
+    u32 usage; // bytes of trace frames
+    u16 conditionOffset, conditionSize; // in actions, bytecode
+    u16 actionsOffset, actionsSize; // in actions, see tracepoints.c
+} Tracepoint;
+
+typedef struct TraceStateVariable
+{
+    u32 number;
+    s64 initialValue;
+    s64 value;
+} TraceStateVariable;
+
+typedef enum TraceStopReason
+{
+    TRACE_STOP_NOT_RUN = 0,
+    TRACE_STOP_COMMAND,
+    TRACE_STOP_BUFFER_FULL,
+    TRACE_STOP_PASS_COUNT,
+    TRACE_STOP_ERROR,
+} TraceStopReason;
+
+typedef struct GDBTraceState
+{
+    bool running;
+    bool circular;
+    TraceStopReason stopReason;
+    u32 stoppingTracepoint;
+
+    u32 nbTracepoints;
+    Tracepoint tracepoints[MAX_TRACEPOINT];
+    u32 actionsSize;
+    u8 actions[TRACEPOINT_ACTIONS_POOL_SIZE];
+
+    u32 nbVariables;
+    TraceStateVariable variables[MAX_TRACE_STATE_VARIABLE];
+
+    // Read from the process while looking at trace frames (QTro)
+    u32 nbReadOnlyRanges;
+    u32 readOnlyRanges[MAX_TRACE_READ_ONLY_RANGE][2];
+
+    // Trace frames ring, allocated by QTStart: frames are contiguous, from "head" to "wrapEnd" then from 0 to "tail" if wrapped
+    u8 *buffer;
+    u32 bufferSize, requestedBufferSize;
+    u32 head, tail, wrapEnd;
+    bool wrapped;
+    u32 nbFrames, nbCreatedFrames;
+
+    bool frameSelected; // tfind
+    u32 currentFrame;
+
+    // A thread whose hit has been collected and reported will hit the same trap again when resumed
+    u32 lastHitThreadId, lastHitAddress;
+} GDBTraceState;
+
 typedef struct PackedGdbHioRequest
 {
     char magic[4]; // "GDB\x00"
@@ -75,11 +166,12 @@ enum
     GDB_FLAG_ALLOCATED_MASK = GDB_FLAG_SELECTED | GDB_FLAG_USED,
     GDB_FLAG_EXTENDED_REMOTE = 4,
     GDB_FLAG_NOACK = 8,
-    GDB_FLAG_PROC_RESTART_MASK = GDB_FLAG_NOACK | GDB_FLAG_EXTENDED_REMOTE | GDB_FLAG_USED,
     GDB_FLAG_PROCESS_CONTINUING = 16,
     GDB_FLAG_TERMINATE_PROCESS = 32,
     GDB_FLAG_ATTACHED_AT_START = 64,
     GDB_FLAG_CREATED = 128,
+    GDB_FLAG_NON_STOP = 256,
+    GDB_FLAG_PROC_RESTART_MASK = GDB_FLAG_NOACK | GDB_FLAG_EXTENDED_REMOTE | GDB_FLAG_USED | GDB_FLAG_NON_STOP,
 };
 
 typedef enum GDBState
@@ -90,12 +182,33 @@ typedef enum GDBState
     GDB_STATE_DETACHING,
 } GDBState;
 
+// Non-stop mode, see gdb/non_stop.h
+typedef enum GDBThreadStopState
+{
+    GDB_THREAD_RUNNING = 0,
+    GDB_THREAD_STOP_PENDING, // stopped, not reported yet
+    GDB_THREAD_STOPPED,
+} GDBThreadStopState;
+
 typedef struct ThreadInfo
 {
     u32 id;
     u32 tls;
+
+    GDBThreadStopState stopState;
+    u32 stopOrder;
+    s32 stopSignal; // -1 if the thread has been stopped by stopEvent, otherwise by vCont;t (0) or a step (SIGTRAP)
+    DebugEventInfo stopEvent;
 } ThreadInfo;
 
+typedef struct GDBNonStopState
+{
+    bool notifying; // a %Stop notification has been sent: GDB gets the other stops with vStopped, until OK
+    u32 reportedThreadId; // stop reply being acknowledged by the next vStopped
+    bool exitPending; // the process exited while notifying, reported after the thread stops
+    u32 nbStops;
+} GDBNonStopState;
+
 struct GDBServer;
 
 typedef struct GDBContext
@@ -135,6 +248,12 @@ typedef struct GDBContext
 
     u32 nbBreakpoints;
     Breakpoint breakpoints[MAX_BREAKPOINT];
+    u32 breakpointConditionsSize;
+    u8 breakpointConditions[BREAKPOINT_CONDITIONS_POOL_SIZE];
+    BreakpointStepOver stepOver;
+
+    GDBTraceState trace;
+    GDBNonStopState nonStop;
 
     u32 nbWatchpoints;
     u32 watchpoints[2];
@@ -149,6 +268,7 @@ typedef struct GDBContext
     char *commandData, *commandEnd;
     int latestSentPacketSize;
     char buffer[GDB_BUF_LEN + 4];
+    u8 sendQueue[2 * (GDB_BUF_LEN + 4)]; // see server_send
 
     char threadListData[0x800];
     u32 threadListDataPos;
@@ -0,0 +1,95 @@
+/*
+*   This file is part of Luma3DS.
+*   Copyright (C) 2016-2020 Aurora Wright, TuxSH
+*
+*   SPDX-License-Identifier: (MIT OR GPL-2.0-or-later)
+*/
+
+
+#pragma once
+
+#include <3ds/types.h>
+
+/*
+    GDB agent expressions ("Agent Expressions" appendix of the GDB manual), as sent in
+    the condition lists of Z0/Z1 packets and in tracepoint definitions. This file doesn't
+    depend on the rest of the stub so that it can be built and tested on the host.
+*/
+
+#define GDB_AGENT_MAX_BYTECODE_SIZE 256
+#define GDB_AGENT_MAX_STACK_SIZE    32
+#define GDB_AGENT_MAX_STEPS         4096 // backward jumps are allowed, this bounds loops
+
+typedef enum GDBAgentOpcode
+{
+    GDB_AGENT_OP_FLOAT          = 0x01,
+    GDB_AGENT_OP_ADD            = 0x02,
+    GDB_AGENT_OP_SUB            = 0x03,
+    GDB_AGENT_OP_MUL            = 0x04,
+    GDB_AGENT_OP_DIV_SIGNED     = 0x05,
+    GDB_AGENT_OP_DIV_UNSIGNED   = 0x06,
+    GDB_AGENT_OP_REM_SIGNED     = 0x07,
+    GDB_AGENT_OP_REM_UNSIGNED   = 0x08,
+    GDB_AGENT_OP_LSH            = 0x09,
+    GDB_AGENT_OP_RSH_SIGNED     = 0x0A,
+    GDB_AGENT_OP_RSH_UNSIGNED   = 0x0B,
+    GDB_AGENT_OP_TRACE          = 0x0C,
+    GDB_AGENT_OP_TRACE_QUICK    = 0x0D,
+    GDB_AGENT_OP_LOG_NOT        = 0x0E,
+    GDB_AGENT_OP_BIT_AND        = 0x0F,
+    GDB_AGENT_OP_BIT_OR         = 0x10,
+    GDB_AGENT_OP_BIT_XOR        = 0x11,
+    GDB_AGENT_OP_BIT_NOT        = 0x12,
+    GDB_AGENT_OP_EQUAL          = 0x13,
+    GDB_AGENT_OP_LESS_SIGNED    = 0x14,
+    GDB_AGENT_OP_LESS_UNSIGNED  = 0x15,
+    GDB_AGENT_OP_EXT            = 0x16,
+    GDB_AGENT_OP_REF8           = 0x17,
+    GDB_AGENT_OP_REF16          = 0x18,
+    GDB_AGENT_OP_REF32          = 0x19,
+    GDB_AGENT_OP_REF64          = 0x1A,
+    GDB_AGENT_OP_REF_FLOAT      = 0x1B,
+    GDB_AGENT_OP_REF_DOUBLE     = 0x1C,
+    GDB_AGENT_OP_REF_LONG_DOUBLE = 0x1D,
+    GDB_AGENT_OP_L_TO_D         = 0x1E,
+    GDB_AGENT_OP_D_TO_L         = 0x1F,
+    GDB_AGENT_OP_IF_GOTO        = 0x20,
+    GDB_AGENT_OP_GOTO           = 0x21,
+    GDB_AGENT_OP_CONST8         = 0x22,
+    GDB_AGENT_OP_CONST16        = 0x23,
+    GDB_AGENT_OP_CONST32        = 0x24,
+    GDB_AGENT_OP_CONST64        = 0x25,
+    GDB_AGENT_OP_REG            = 0x26,
+    GDB_AGENT_OP_END            = 0x27,
+    GDB_AGENT_OP_DUP            = 0x28,
+    GDB_AGENT_OP_POP            = 0x29,
+    GDB_AGENT_OP_ZERO_EXT       = 0x2A,
+    GDB_AGENT_OP_SWAP           = 0x2B,
+    GDB_AGENT_OP_GETV           = 0x2C,
+    GDB_AGENT_OP_SETV           = 0x2D,
+    GDB_AGENT_OP_TRACEV         = 0x2E,
+    GDB_AGENT_OP_TRACENZ        = 0x2F,
+    GDB_AGENT_OP_TRACE16        = 0x30,
+    GDB_AGENT_OP_PICK           = 0x32,
+    GDB_AGENT_OP_ROT            = 0x33,
+    GDB_AGENT_OP_PRINTF         = 0x34,
+} GDBAgentOpcode;
+
+typedef struct GDBAgentOps
+{
+    // All return false on failure, which makes the evaluation fail
+    bool (*readRegister)(void *userdata, u64 *out, u32 gdbRegNum);
+    bool (*readMemory)(void *userdata, void *out, u32 address, u32 size);
+
+    // Trace state variables and collection, can be NULL outside of tracepoints (the evaluation then fails with -ENOTSUP)
+    bool (*getVariable)(void *userdata, s64 *out, u32 id);
+    bool (*setVariable)(void *userdata, u32 id, s64 value);
+    bool (*collectMemory)(void *userdata, u32 address, u32 size, bool stopAtZero);
+    bool (*collectVariable)(void *userdata, u32 id);
+} GDBAgentOps;
+
+/// Checks that the bytecode only uses supported opcodes, that its jumps land on instructions and that the stack height is consistent and bounded on all paths. Returns 0 or -EINVAL/-ENOTSUP
+int GDB_AgentVerify(const u8 *bytecode, u32 size);
+
+/// Evaluates verified bytecode, the result being the top of the stack at 'end' (0 if empty). Returns 0 or -EFAULT (register, memory or variable access, collection), -EDOM (division by zero), -ETIMEDOUT (too many steps), -ENOTSUP (missing callback)
+int GDB_AgentEvaluate(s64 *result, const u8 *bytecode, u32 size, const GDBAgentOps *ops, void *userdata);
@@ -15,6 +15,17 @@
 
 u32 GDB_FindClosestBreakpointSlot(GDBContext *ctx, u32 address);
 int GDB_GetBreakpointInstruction(u32 *instr, GDBContext *ctx, u32 address);
-int GDB_AddBreakpoint(GDBContext *ctx, u32 address, bool thumb, bool persist);
+int GDB_AddBreakpoint(GDBContext *ctx, u32 address, bool thumb, bool persist, const u8 *conditions, u32 conditionsSize);
 int GDB_DisableBreakpointById(GDBContext *ctx, u32 id);
 int GDB_RemoveBreakpoint(GDBContext *ctx, u32 address);
+
+// Tracepoints share the breakpoints of GDB, if any
+int GDB_AddTracepointBreakpoint(GDBContext *ctx, u32 address, bool thumb);
+int GDB_RemoveTracepointBreakpoint(GDBContext *ctx, u32 address);
+
+// Called on 'svc 0xFF' stop points: returns true if the thread should be silently resumed (conditions all false, tracepoint, or step-over in progress)
+bool GDB_ShouldIgnoreBreakpointHit(GDBContext *ctx, u32 threadId);
+void GDB_CancelBreakpointStepOver(GDBContext *ctx);
+
+// Single steps a stopped thread (non-stop mode), which then has to be resumed. Only one step or step-over at a time
+int GDB_StepThread(GDBContext *ctx, u32 threadId);
@@ -21,7 +21,11 @@ GDB_DECLARE_VERBOSE_HANDLER(Continue);
 GDB_DECLARE_HANDLER(GetStopReason);
 
 void GDB_ContinueExecution(GDBContext *ctx);
-void GDB_PreprocessDebugEvent(GDBContext *ctx, DebugEventInfo *info);
+// Returns true if the event should be continued without being reported (e.g. breakpoint whose conditions are false)
+bool GDB_PreprocessDebugEvent(GDBContext *ctx, DebugEventInfo *info);
+int GDB_ParseCommonThreadInfo(char *out, GDBContext *ctx, int sig);
+// Returns 0 if the event isn't reported
+int GDB_FormatStopReply(GDBContext *ctx, char *out, const DebugEventInfo *info);
 int GDB_SendStopReply(GDBContext *ctx, const DebugEventInfo *info);
 int GDB_HandleDebugEvents(GDBContext *ctx);
 void GDB_BreakProcessAndSinkDebugEvents(GDBContext *ctx, DebugFlags flags);
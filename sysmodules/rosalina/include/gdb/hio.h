@@ -12,5 +12,7 @@
 bool GDB_FetchPackedHioRequest(GDBContext *ctx, u32 addr);
 bool GDB_IsHioInProgress(GDBContext *ctx);
 int GDB_SendCurrentHioRequest(GDBContext *ctx);
+// Completes the request without GDB (non-stop mode), the process isn't continued
+int GDB_FailCurrentHioRequest(GDBContext *ctx, int gdbErrno);
 
 GDB_DECLARE_HANDLER(HioReply);
@@ -0,0 +1,45 @@
+/*
+*   This file is part of Luma3DS.
+*   Copyright (C) 2016-2020 Aurora Wright, TuxSH
+*
+*   SPDX-License-Identifier: (MIT OR GPL-2.0-or-later)
+*/
+
+#pragma once
+
+#include "gdb.h"
+
+/*
+    Non-stop mode ("Remote Non-Stop" section of the GDB manual): a debug event only stops the thread it
+    belongs to. That thread is locked with PROCESSOP_SCHEDULE_THREADS and the event is continued right
+    away, so the other threads keep running. The stops are sent with %Stop notifications then vStopped,
+    and vCont resumes (c), steps (s) or stops (t) threads individually.
+
+    Registers can only be accessed while the process is broken, so the packets that need them break it
+    briefly (see GDB_BreakProcessForNonStop).
+*/
+
+void GDB_InitializeNonStopMode(void);
+
+// Returns the same values as GDB_HandleDebugEvents, the event is always continued
+int GDB_HandleNonStopDebugEvent(GDBContext *ctx, DebugEventInfo *info);
+
+// The monitor thread continues the resulting debugger break when it gets the context lock back
+void GDB_BreakProcessForNonStop(GDBContext *ctx);
+
+// Process stopped by ctx->latestDebugEvent (attach, QNonStop:1): locks all threads, whose stops are pending
+void GDB_StopAllThreads(GDBContext *ctx);
+// Unlocks all stopped threads and forgets their stops (QNonStop:0, detach)
+void GDB_ResumeAllThreads(GDBContext *ctx);
+
+// Sends a %Stop notification if there are pending stops and GDB isn't already getting them
+int GDB_NotifyPendingStops(GDBContext *ctx);
+// Replies with the first pending stop, marked as stopped already (vRun)
+int GDB_SendFirstPendingStop(GDBContext *ctx);
+
+int GDB_SendNonStopStopReason(GDBContext *ctx);
+int GDB_ContinueNonStopThreads(GDBContext *ctx);
+int GDB_InterruptNonStopThreads(GDBContext *ctx);
+
+GDB_DECLARE_VERBOSE_HANDLER(Stopped);
+GDB_DECLARE_QUERY_HANDLER(NonStop);
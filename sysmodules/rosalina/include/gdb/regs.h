@@ -9,6 +9,8 @@
 
 #include "gdb.h"
 
+int GDB_ReadRegisterFromContext(u64 *out, const ThreadContext *regs, u32 gdbRegNum);
+
 GDB_DECLARE_HANDLER(ReadRegisters);
 GDB_DECLARE_HANDLER(WriteRegisters);
 GDB_DECLARE_HANDLER(ReadRegister);
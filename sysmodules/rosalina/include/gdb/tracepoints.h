@@ -0,0 +1,54 @@
+/*
+*   This file is part of Luma3DS.
+*   Copyright (C) 2016-2020 Aurora Wright, TuxSH
+*
+*   SPDX-License-Identifier: (MIT OR GPL-2.0-or-later)
+*/
+
+#pragma once
+
+#include "gdb.h"
+
+/*
+    Tracepoints ("Tracepoints" chapter of the GDB manual): the registers, memory and trace state
+    variables requested by GDB are collected into trace frames without stopping the process, then
+    looked at with tfind. The frames use the layout of gdbserver and trace files, so qTBuffer (tsave)
+    sends the buffer as is.
+*/
+
+// Allocated from the SYSTEM region by QTStart, one window per context
+#define GDB_TRACE_BUFFER_ADDR           0x0F000000
+#define GDB_TRACE_BUFFER_DEFAULT_SIZE   0x10000
+#define GDB_TRACE_BUFFER_MAX_SIZE       0x40000
+#define GDB_TRACE_MAX_FRAME_SIZE        0x1000
+
+// Called on the hits of tracepoint breakpoints. Can stop the trace (buffer full, pass count, error)
+void GDB_CollectTraceFrames(GDBContext *ctx, u32 threadId, const ThreadContext *regs);
+
+bool GDB_GetTraceStateVariable(GDBContext *ctx, s64 *out, u32 id);
+bool GDB_SetTraceStateVariable(GDBContext *ctx, u32 id, s64 value);
+
+// Stops the trace and frees the buffer, on detach
+void GDB_FinalizeTrace(GDBContext *ctx);
+
+// Used instead of the live process by g, p and m while a trace frame is selected
+int GDB_SendTraceFrameRegisters(GDBContext *ctx);
+int GDB_SendTraceFrameRegister(GDBContext *ctx, u32 gdbRegNum);
+int GDB_SendTraceFrameMemory(GDBContext *ctx, u32 addr, u32 len);
+
+GDB_DECLARE_QUERY_HANDLER(TraceInit);
+GDB_DECLARE_QUERY_HANDLER(DefineTracepoint);
+GDB_DECLARE_QUERY_HANDLER(DefineTraceStateVariable);
+GDB_DECLARE_QUERY_HANDLER(EnableTracepoint);
+GDB_DECLARE_QUERY_HANDLER(DisableTracepoint);
+GDB_DECLARE_QUERY_HANDLER(TraceStart);
+GDB_DECLARE_QUERY_HANDLER(TraceStop);
+GDB_DECLARE_QUERY_HANDLER(SelectTraceFrame);
+GDB_DECLARE_QUERY_HANDLER(SetTraceBufferOption);
+GDB_DECLARE_QUERY_HANDLER(TraceReadOnlyRanges);
+GDB_DECLARE_QUERY_HANDLER(TraceDisconnected);
+GDB_DECLARE_QUERY_HANDLER(TraceStatus);
+GDB_DECLARE_QUERY_HANDLER(TracepointStatus);
+GDB_DECLARE_QUERY_HANDLER(TraceStateVariableValue);
+GDB_DECLARE_QUERY_HANDLER(ReadTraceBuffer);
+GDB_DECLARE_QUERY_HANDLER(UploadTraceDefinitions);
@@ -0,0 +1,109 @@
+/*
+*   This file is part of Luma3DS
+*   Copyright (C) 2016-2022 Aurora Wright, TuxSH
+*
+*   This program is free software: you can redistribute it and/or modify
+*   it under the terms of the GNU General Public License as published by
+*   the Free Software Foundation, either version 3 of the License, or
+*   (at your option) any later version.
+*
+*   This program is distributed in the hope that it will be useful,
+*   but WITHOUT ANY WARRANTY; without even the implied warranty of
+*   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*   GNU General Public License for more details.
+*
+*   You should have received a copy of the GNU General Public License
+*   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*
+*   Additional Terms 7.b and 7.c of GPLv3 apply to this file:
+*       * Requiring preservation of specified reasonable legal notices or
+*         author attributions in that material or in the Appropriate Legal
+*         Notices displayed by works containing it.
+*       * Prohibiting misrepresentation of the origin of that material,
+*         or requiring that modified versions of such material be marked in
+*         reasonable ways as different from the original version.
+*/
+
+#pragma once
+
+#include <3ds/types.h>
+
+// Input record files and their codec. Shared with the host tools (host/irtool.c), so nothing console-specific here.
+//
+// File layout: header, then one record per run of identical HID updates or per changed update:
+//   tag byte, bits 0-3: fields that changed (INPUT_FIELD_*)
+//     none changed:  bits 4-7 are the number of identical updates - 1; 15 means 16 + a varint
+//     some changed:  bits 4-7 are INPUT_EXTRA_* flags, then for each changed field, in order:
+//       pad:         varint of old ^ new
+//       touch, circle pad:
+//                    zigzag varints of the X (bits 0-11) and Y (bits 12-23) deltas, then bits 24-31 if INPUT_EXTRA_*_HIGH
+//       C-stick:     zigzag varints of the X (bits 16-23) and Y (bits 24-31) deltas, then bits 0-15 if INPUT_EXTRA_CSTICK_LOW
+// Updates are decoded against the previous one, starting from INPUT_STATE_IDLE.
+
+#define INPUT_RECORD_MAGIC              0x4352494C // 'LIRC'
+#define INPUT_RECORD_VERSION            1
+
+/// Largest encoding of one update, including the flush of a pending run of identical updates.
+#define INPUT_RECORD_MAX_UPDATE_SIZE    32
+
+#define INPUT_FIELD_PAD                 1
+#define INPUT_FIELD_TOUCH               2
+#define INPUT_FIELD_CIRCLE_PAD          4
+#define INPUT_FIELD_CSTICK              8
+
+#define INPUT_EXTRA_TOUCH_HIGH          0x10
+#define INPUT_EXTRA_CIRCLE_PAD_HIGH     0x20
+#define INPUT_EXTRA_CSTICK_LOW          0x40
+
+/// What hid gets for one update once the hooks are done: raw pad, touch screen and circle pad registers, and the C-stick state of ir:rst.
+typedef struct InputState
+{
+    u32 pad;
+    u32 touch;
+    u32 circlePad;
+    u32 cStick;
+} InputState;
+
+#define INPUT_STATE_IDLE                ((InputState){ 0x00000FFF, 0x02000000, 0x007FF7FF, 0x80800081 })
+
+typedef struct InputRecordHeader
+{
+    u32 magic;
+    u16 version;
+    u16 reserved;
+    u64 titleId;            ///< Application running when recording started, 0 if none
+    u64 creationTime;       ///< Milliseconds since 1900
+    u32 numUpdates;
+    u32 durationMs;
+    u32 dataSize;           ///< Size of the records following the header
+    u32 numDroppedUpdates;  ///< Recording: updates lost because the ring overflowed
+} InputRecordHeader;
+
+typedef struct InputRecordEncoder
+{
+    InputState prev;
+    u32 pendingRun;         ///< Identical updates not written yet
+} InputRecordEncoder;
+
+typedef struct InputRecordDecoder
+{
+    InputState state;
+    u32 runLeft;
+} InputRecordDecoder;
+
+void InputRecord_InitEncoder(InputRecordEncoder *enc);
+
+/// Returns the number of bytes written to out (at most INPUT_RECORD_MAX_UPDATE_SIZE), 0 if the update was added to the pending run.
+u32 InputRecord_Encode(InputRecordEncoder *enc, const InputState *state, u8 *out);
+
+/// Writes the pending run, if any. Returns the number of bytes written (at most INPUT_RECORD_MAX_UPDATE_SIZE).
+u32 InputRecord_Flush(InputRecordEncoder *enc, u8 *out);
+
+void InputRecord_InitDecoder(InputRecordDecoder *dec);
+
+/**
+ * @brief Decodes the next update.
+ * @param size Bytes available at data; pass at least INPUT_RECORD_MAX_UPDATE_SIZE unless at the end of the records.
+ * @return The number of bytes consumed (0 while in a run of identical updates), or -1 if the records are malformed or truncated.
+ */
+s32 InputRecord_Decode(InputRecordDecoder *dec, const u8 *data, u32 size, InputState *out);
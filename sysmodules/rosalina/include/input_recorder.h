@@ -0,0 +1,68 @@
+/*
+*   This file is part of Luma3DS
+*   Copyright (C) 2016-2022 Aurora Wright, TuxSH
+*
+*   This program is free software: you can redistribute it and/or modify
+*   it under the terms of the GNU General Public License as published by
+*   the Free Software Foundation, either version 3 of the License, or
+*   (at your option) any later version.
+*
+*   This program is distributed in the hope that it will be useful,
+*   but WITHOUT ANY WARRANTY; without even the implied warranty of
+*   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*   GNU General Public License for more details.
+*
+*   You should have received a copy of the GNU General Public License
+*   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*
+*   Additional Terms 7.b and 7.c of GPLv3 apply to this file:
+*       * Requiring preservation of specified reasonable legal notices or
+*         author attributions in that material or in the Appropriate Legal
+*         Notices displayed by works containing it.
+*       * Prohibiting misrepresentation of the origin of that material,
+*         or requiring that modified versions of such material be marked in
+*         reasonable ways as different from the original version.
+*/
+
+#pragma once
+
+#include <3ds/types.h>
+#include "input_record.h"
+
+// Records what hid gets on every HID update, or replays it in place of the actual input, through the input redirection hooks.
+// Recordings are stored in /luma/inputs/<title ID>.lirc, after the application running when the recording starts.
+
+#define INPUT_RECORDER_MODE_OFF             0
+#define INPUT_RECORDER_MODE_RECORD          1
+#define INPUT_RECORDER_MODE_REPLAY          2
+
+#define INPUT_RECORDER_RING_SIZE            256 // HID updates, a bit more than a second
+#define INPUT_RECORDER_POLL_PERIOD_MS       10
+
+#define INPUT_RECORDER_ERR_NO_APPLICATION   MAKERESULT(RL_PERMANENT, RS_NOTFOUND, RM_APPLICATION, RD_NOT_FOUND)
+#define INPUT_RECORDER_ERR_INVALID_FILE     MAKERESULT(RL_PERMANENT, RS_INVALIDARG, RM_APPLICATION, RD_INVALID_RESULT_VALUE)
+#define INPUT_RECORDER_ERR_BUSY             MAKERESULT(RL_TEMPORARY, RS_INVALIDSTATE, RM_APPLICATION, RD_ALREADY_EXISTS)
+
+typedef struct InputRecorderStatus
+{
+    u32 mode;               ///< INPUT_RECORDER_MODE_*, what was last started
+    bool active;            ///< Still recording or replaying
+    u64 titleId;
+    u32 numUpdates;         ///< Recorded or replayed so far
+    u32 totalUpdates;       ///< Replay: updates in the file
+    u32 numDroppedUpdates;  ///< Recording: lost because the ring overflowed, recorded as repeats of the previous update
+    u32 numUnderruns;       ///< Replay: HID updates the ring was empty for, which delayed the replay
+    u32 dataSize;
+    Result result;          ///< First error of the recorder thread
+} InputRecorderStatus;
+
+/// Starts recording the input into the file of the running application, overwriting it, once the menu is closed.
+Result InputRecorder_StartRecording(void);
+
+/// Starts replaying the file of the running application once the menu is closed.
+Result InputRecorder_StartReplay(void);
+
+/// Stops recording (completing the file) or replaying, and removes the hooks unless the input redirection uses them.
+Result InputRecorder_Stop(s64 timeout);
+
+void InputRecorder_GetStatus(InputRecorderStatus *status);
@@ -30,6 +30,17 @@
 #include "MyThread.h"
 #include "utils.h"
 
+// Words of hidData used by the input recorder, shared with the HID hook (input_redirection_hooks.s)
+#define HIDDATA_RECORDER_MODE       8   ///< INPUT_RECORDER_MODE_*
+#define HIDDATA_RECORDER_COUNT      9   ///< HID updates recorded or replayed, written by the hook
+#define HIDDATA_RECORDER_AVAILABLE  10  ///< Replay: the hook doesn't go past this update count
+#define HIDDATA_RECORDER_IRDATA     11  ///< PA of irData
+#define HIDDATA_RECORDER_UNDERRUNS  12  ///< Replay: HID updates passed through because the ring was empty
+#define HIDDATA_RECORDER_RING       13  ///< PA of the ring of 256 InputState entries
+
+extern u32 hidData[16];
+extern u32 irData[2];
+
 extern bool inputRedirectionEnabled;
 extern Handle inputRedirectionThreadStartedEvent;
 
@@ -40,3 +51,7 @@ void inputRedirectionThreadMain(void);
 Result InputRedirection_Disable(s64 timeout);
 Result InputRedirection_DoOrUndoPatches(void);
 
+// The hooks stay in place while either the input redirection or the input recorder needs them
+Result InputRedirection_AcquirePatches(void);
+Result InputRedirection_ReleasePatches(void);
+
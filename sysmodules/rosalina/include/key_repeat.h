@@ -0,0 +1,46 @@
+/*
+*   This file is part of Luma3DS
+*   Copyright (C) 2016-2022 Aurora Wright, TuxSH
+*
+*   This program is free software: you can redistribute it and/or modify
+*   it under the terms of the GNU General Public License as published by
+*   the Free Software Foundation, either version 3 of the License, or
+*   (at your option) any later version.
+*
+*   This program is distributed in the hope that it will be useful,
+*   but WITHOUT ANY WARRANTY; without even the implied warranty of
+*   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*   GNU General Public License for more details.
+*
+*   You should have received a copy of the GNU General Public License
+*   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*
+*   Additional Terms 7.b and 7.c of GPLv3 apply to this file:
+*       * Requiring preservation of specified reasonable legal notices or
+*         author attributions in that material or in the Appropriate Legal
+*         Notices displayed by works containing it.
+*       * Prohibiting misrepresentation of the origin of that material,
+*         or requiring that modified versions of such material be marked in
+*         reasonable ways as different from the original version.
+*/
+
+#pragma once
+
+#include <3ds/types.h>
+
+// Key repeat driven by timestamps, so that it doesn't depend on how often the keys are scanned (the menus scan them
+// when HID updates its shared memory). Shared with the host tests (host/keytest.c).
+
+typedef struct KeyRepeat
+{
+    u64 delay;      ///< Before the held keys start repeating, 0 disables repeat
+    u64 interval;   ///< Between repeats, the delay if 0
+    u32 heldKeys;   ///< Keys being repeated, 0 if none
+    u64 nextTime;   ///< Of the next repeat
+} KeyRepeat;
+
+/// Sets the delay and interval, in the unit of the timestamps, and forgets the held keys.
+void KeyRepeat_Configure(KeyRepeat *repeat, u64 delay, u64 interval);
+
+/// Returns the held keys to report again at time now. Pressing a key or changing the held keys restarts the delay.
+u32 KeyRepeat_Update(KeyRepeat *repeat, u32 down, u32 held, u64 now);
@@ -0,0 +1,26 @@
+// License for this file: ctrulib's license
+// Copyright AuroraWright, TuxSH 2019-2020
+
+#pragma once
+
+#include <3ds/types.h>
+
+#define LAUNCHTRACE_COUNT   8
+
+/// Timings of a process launch done by Loader (same layout as Loader's).
+typedef struct LaunchTrace {
+    u64 titleId;
+    u32 programInfoUs;          ///< GetProgramInfo, including the exheader override.
+    u32 codeLoadUs;             ///< Reading (and decompressing) the code.
+    u32 patchUs;                ///< Patching the code, including the per-title override files.
+    u32 totalUs;                ///< Whole LoadProcess.
+    u32 fsRequests;             ///< FS requests issued to look up per-title overrides.
+    u32 overrides;              ///< Per-title overrides found.
+} LaunchTrace;
+
+/**
+ * @brief Gets the traces of the last launches.
+ * @param outTraces Ring buffer of LAUNCHTRACE_COUNT traces, the newest one at (*outCount - 1) % LAUNCHTRACE_COUNT.
+ * @param outCount Number of launches done since boot.
+ */
+Result LOADEREXT_GetLaunchTraces(LaunchTrace *outTraces, u32 *outCount);
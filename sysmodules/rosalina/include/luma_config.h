@@ -53,6 +53,7 @@ enum singleOptions
     NOERRDISPINSTANTREBOOT,
     SHOWADVANCEDSETTINGS,
     HARDWAREPATCHING,
+    BOOTTIMELOG,
 };
 
 enum multiOptions
@@ -0,0 +1,40 @@
+/*
+*   This file is part of Luma3DS
+*   Copyright (C) 2016-2022 Aurora Wright, TuxSH
+*
+*   This program is free software: you can redistribute it and/or modify
+*   it under the terms of the GNU General Public License as published by
+*   the Free Software Foundation, either version 3 of the License, or
+*   (at your option) any later version.
+*
+*   This program is distributed in the hope that it will be useful,
+*   but WITHOUT ANY WARRANTY; without even the implied warranty of
+*   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*   GNU General Public License for more details.
+*
+*   You should have received a copy of the GNU General Public License
+*   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*
+*   Additional Terms 7.b and 7.c of GPLv3 apply to this file:
+*       * Requiring preservation of specified reasonable legal notices or
+*         author attributions in that material or in the Appropriate Legal
+*         Notices displayed by works containing it.
+*       * Prohibiting misrepresentation of the origin of that material,
+*         or requiring that modified versions of such material be marked in
+*         reasonable ways as different from the original version.
+*/
+
+#pragma once
+
+#include <3ds/types.h>
+
+// Minimal LZ4 block format encoder (greedy, single hash probe) and decoder. Blocks are limited to 64KB.
+#define LZ4_MAX_BLOCK_SIZE          0x10000
+#define LZ4_HASH_TABLE_SIZE         (sizeof(u16) << 12)
+#define LZ4_COMPRESS_BOUND(n)       ((n) + (n) / 255 + 16)
+
+/// Returns the compressed size, or 0 if it would not fit in dstCapacity. hashTable must be LZ4_HASH_TABLE_SIZE bytes.
+u32 lz4CompressBlock(const void *src, u32 srcSize, void *dst, u32 dstCapacity, void *hashTable);
+
+/// Returns the decompressed size, or 0 if the block is malformed or would not fit in dstCapacity.
+u32 lz4DecompressBlock(const void *src, u32 srcSize, void *dst, u32 dstCapacity);
@@ -98,6 +98,9 @@ u32 waitInputWithTimeout(s32 msec);
 u32 waitInputWithTimeoutEx(u32 *outHeldKeys, s32 msec);
 u32 waitInput(void);
 
+/// Sets the delay before directional keys start repeating and the repeat interval, 0 disables repeat
+void menuSetKeyRepeat(u32 delayMs, u32 intervalMs);
+
 u32 waitComboWithTimeout(s32 msec);
 u32 waitCombo(void);
 
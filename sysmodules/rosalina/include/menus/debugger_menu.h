@@ -41,3 +41,4 @@ extern Menu debuggerMenu;
 void DebuggerMenu_EnableDebugger(void);
 void DebuggerMenu_DisableDebugger(void);
 void DebuggerMenu_DebugNextApplicationByForce(void);
+void DebuggerMenu_ShowServerStatistics(void);
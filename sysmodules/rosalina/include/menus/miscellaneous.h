@@ -37,7 +37,11 @@ extern int lastNtpTzOffset;
 void MiscellaneousMenu_SwitchBoot3dsxTargetTitle(void);
 void MiscellaneousMenu_ChangeMenuCombo(void);
 void MiscellaneousMenu_InputRedirection(void);
+void MiscellaneousMenu_InputRecorder(void);
+void MiscellaneousMenu_FrameProfiler(void);
 void MiscellaneousMenu_UpdateTimeDateNtp(void);
 void MiscellaneousMenu_NullifyUserTimeOffset(void);
 void MiscellaneousMenu_DumpDspFirm(void);
 void MiscellaneousMenu_MaxPlayCoins(void);
+void MiscellaneousMenu_ShowShutdownTrace(void);
+void MiscellaneousMenu_ShowLaunchTraces(void);
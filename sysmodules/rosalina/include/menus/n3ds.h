@@ -36,8 +36,6 @@ void N3DSMenu_UpdateStatus(void);
 void N3DSMenu_ChangeClockRate(void);
 void N3DSMenu_EnableDisableL2Cache(void);
 void N3DSMenu_CheckForConfigFile(void);
-void N3DSMenu_CreateConfigFile(void);
-void N3DSMenu_DeleteConfigFile(void);
 void N3DSMenu_UpdateConfig(void);
 void N3DSMenu_UpdateConfigStatus(void);
 bool currentTitleAvailable(void);
@@ -49,4 +49,5 @@ void SysConfigMenu_DisableForcedWifiConnection(void);
 void SysConfigMenu_ToggleCardIfPower(void);
 void SysConfigMenu_ToggleRehidFolder(void);
 void SysConfigMenu_UpdateRehidFolderStatus(void);
+void SysConfigMenu_ChangeTitleLocale(void);
 void SysConfigMenu_Tip(void);
@@ -0,0 +1,129 @@
+/*
+*   This file is part of Luma3DS
+*   Copyright (C) 2016-2022 Aurora Wright, TuxSH
+*
+*   This program is free software: you can redistribute it and/or modify
+*   it under the terms of the GNU General Public License as published by
+*   the Free Software Foundation, either version 3 of the License, or
+*   (at your option) any later version.
+*
+*   This program is distributed in the hope that it will be useful,
+*   but WITHOUT ANY WARRANTY; without even the implied warranty of
+*   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*   GNU General Public License for more details.
+*
+*   You should have received a copy of the GNU General Public License
+*   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*
+*   Additional Terms 7.b and 7.c of GPLv3 apply to this file:
+*       * Requiring preservation of specified reasonable legal notices or
+*         author attributions in that material or in the Appropriate Legal
+*         Notices displayed by works containing it.
+*       * Prohibiting misrepresentation of the origin of that material,
+*         or requiring that modified versions of such material be marked in
+*         reasonable ways as different from the original version.
+*/
+
+
+#pragma once
+
+#include <3ds/types.h>
+#include <3ds/services/errf.h>
+#include "utils.h"
+
+/* Binary minidumps of the fatal errors reported to err:f, one file per error in a fixed ring
+   of slots (/luma/dumps/errdisp/minidump_XX.dmp, the oldest one being overwritten). A dump is a
+   header followed by records, each a (type, size) pair then its data padded to 8 bytes, all
+   little-endian. See tools/minidump.py. */
+
+#define MINIDUMP_DIR_PATH           "/luma/dumps/errdisp"
+#define MINIDUMP_MAGIC              0x504D444C // 'LDMP'
+#define MINIDUMP_VERSION            1
+#define MINIDUMP_NUM_SLOTS          16
+
+#define MINIDUMP_STACK_SIZE         0x1000
+#define MINIDUMP_CODE_SIZE          0x100 // around PC and LR
+#define MINIDUMP_MAX_MAP_ENTRIES    64
+#define MINIDUMP_MAX_SIZE           0x2000
+
+// Process memory is mapped there while it is being copied
+#define MINIDUMP_MAP_ADDR           0x0F800000
+
+typedef enum MiniDumpRecordType
+{
+    MINIDUMP_RECORD_CRASH_REASON = 1,
+    MINIDUMP_RECORD_PROCESS,
+    MINIDUMP_RECORD_REGISTERS,  // CpuRegisters, exceptions only
+    MINIDUMP_RECORD_MEMORY,
+    MINIDUMP_RECORD_MEMORY_MAP, // MiniDumpMemoryMapEntry array
+    MINIDUMP_RECORD_USER_STRING,
+} MiniDumpRecordType;
+
+typedef enum MiniDumpMemoryKind
+{
+    MINIDUMP_MEMORY_STACK = 0,
+    MINIDUMP_MEMORY_PC,
+    MINIDUMP_MEMORY_LR,
+} MiniDumpMemoryKind;
+
+typedef struct MiniDumpHeader
+{
+    u32 magic;
+    u16 version;
+    u16 numRecords;
+    u32 sequence;       // 0 for an unused slot
+    u32 size;           // of the whole dump
+    u64 timestamp;      // osGetTime
+    u64 systemTick;
+} MiniDumpHeader;
+
+typedef struct MiniDumpRecordHeader
+{
+    u32 type;
+    u32 size;           // without padding
+} MiniDumpRecordHeader;
+
+typedef struct MiniDumpCrashReason
+{
+    u8 errorType;       // ERRF_ErrType
+    u8 exceptionType;   // ERRF_ExceptionType, 0xFF if not an exception
+    u8 revHigh;
+    u8 reserved;
+    u16 revLow;
+    u16 reserved2;
+    u32 resultCode;
+    u32 pcAddr;
+    u32 fsr, far, fpexc, fpinst, fpinst2;
+    char message[0x60]; // failure message
+} MiniDumpCrashReason;
+
+typedef struct MiniDumpProcess
+{
+    u64 titleId;
+    u64 appTitleId;
+    u32 pid;
+    char name[8];
+    u32 textAddr, textSize;
+    u32 rodataAddr, rodataSize;
+    u32 dataAddr, dataSize;
+    u32 reserved;
+} MiniDumpProcess;
+
+typedef struct MiniDumpMemory
+{
+    u32 address;
+    u32 size;
+    u32 kind;           // MiniDumpMemoryKind
+} MiniDumpMemory;       // followed by the data
+
+typedef struct MiniDumpMemoryMapEntry
+{
+    u32 baseAddr;
+    u32 size;
+    u8 perm;
+    u8 state;
+    u16 reserved;
+} MiniDumpMemoryMapEntry;
+
+/// Writes the minidump of a fatal error to the next slot of the ring
+Result MiniDump_Write(FS_ArchiveID archiveId, const ERRF_FatalErrInfo *info, const char *userString);
@@ -42,8 +42,6 @@ u32      PLG__GetConfigMemoryEvent(void);
 
 void    PluginLoader__MenuOption(void);
 void    PerGamePluginLoader__CheckForConfigFile(void);
-void    PerGamePluginLoader__CreateConfigFile(void);
-void    PerGamePluginLoader__DeleteConfigFile(void);
 void    PerGamePluginLoader__UpdateConfig(void);
 
 
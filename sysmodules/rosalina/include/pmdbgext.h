@@ -12,6 +12,53 @@ enum {
     PMLAUNCHFLAGEXT_FAKE_DEPENDENCY_LOADING = BIT(24),
 };
 
+#define SHUTDOWNTRACE_MAX_ENTRIES   0x40
+
+/// What the last termination done by PM was for.
+typedef enum ShutdownReason {
+    SHUTDOWNREASON_NONE                     = 0,
+    SHUTDOWNREASON_TERMINATE_APPLICATION    = 1,
+    SHUTDOWNREASON_TERMINATE_TITLE          = 2,
+    SHUTDOWNREASON_TERMINATE_PROCESS        = 3,
+    SHUTDOWNREASON_REBOOT                   = 4,
+    SHUTDOWNREASON_FIRMLAUNCH               = 5,
+    SHUTDOWNREASON_CHAINLOAD_HOMEBREW       = 6,
+} ShutdownReason;
+
+/// Shutdown trace entry flags.
+enum {
+    SHUTDOWNTRACE_FLAG_NOTIFICATION_FAILED  = BIT(0),
+    SHUTDOWNTRACE_FLAG_DEPENDENCY           = BIT(1), ///< Notified because it was no longer used.
+    SHUTDOWNTRACE_FLAG_FORCED               = BIT(2), ///< Deadline exceeded, terminated with svcTerminateProcess.
+    SHUTDOWNTRACE_FLAG_EXITED               = BIT(3),
+};
+
+/// Termination of a process, in notification order.
+typedef struct ShutdownTraceEntry {
+    u64 titleId;
+    u32 pid;
+    u8 wave;                    ///< Processes are notified after all of the processes that depend on them.
+    u8 flags;
+    u16 reserved;
+    Result notificationResult;
+    u32 notifiedUs;             ///< From the start of the termination to the notification.
+    u32 ackUs;                  ///< Time SM took to queue notification 0x100 for the process.
+    u32 exitUs;                 ///< From the notification to the process exiting.
+} ShutdownTraceEntry;
+
+/// Trace of the last termination done by PM.
+typedef struct ShutdownTrace {
+    u32 reason;
+    u32 callerPid;
+    u32 numEntries;
+    u32 numWaves;
+    u32 numForced;
+    u32 totalUs;                ///< From the start of the termination to the last exit.
+    u64 startTick;
+    ShutdownTraceEntry entries[SHUTDOWNTRACE_MAX_ENTRIES];
+} ShutdownTrace;
+
 Result PMDBG_GetCurrentAppInfo(FS_ProgramInfo *outProgramInfo, u32 *outPid, u32 *outLaunchFlags);
 Result PMDBG_DebugNextApplicationByForce(bool debug);
 Result PMDBG_LaunchTitleDebug(Handle *outDebug, const FS_ProgramInfo *programInfo, u32 launchFlags);
+Result PMDBG_GetShutdownTrace(ShutdownTrace *outTrace);
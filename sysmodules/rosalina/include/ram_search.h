@@ -0,0 +1,127 @@
+/*
+*   This file is part of Luma3DS
+*   Copyright (C) 2016-2022 Aurora Wright, TuxSH
+*
+*   This program is free software: you can redistribute it and/or modify
+*   it under the terms of the GNU General Public License as published by
+*   the Free Software Foundation, either version 3 of the License, or
+*   (at your option) any later version.
+*
+*   This program is distributed in the hope that it will be useful,
+*   but WITHOUT ANY WARRANTY; without even the implied warranty of
+*   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*   GNU General Public License for more details.
+*
+*   You should have received a copy of the GNU General Public License
+*   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*
+*   Additional Terms 7.b and 7.c of GPLv3 apply to this file:
+*       * Requiring preservation of specified reasonable legal notices or
+*         author attributions in that material or in the Appropriate Legal
+*         Notices displayed by works containing it.
+*       * Prohibiting misrepresentation of the origin of that material,
+*         or requiring that modified versions of such material be marked in
+*         reasonable ways as different from the original version.
+*/
+
+#pragma once
+
+#include <3ds/types.h>
+#include "utils.h"
+
+// Candidate storage, allocated from the SYSTEM region for the duration of a search
+#define RAMSEARCH_HEAP_ADDR         0x0E000000
+#define RAMSEARCH_MAX_HEAP_SIZE     0x80000
+#define RAMSEARCH_IO_BUFFER_SIZE    0x4000
+
+// Process memory is mapped window by window at this address while scanning
+#define RAMSEARCH_MAP_ADDR          0x00100000
+#define RAMSEARCH_MAP_WINDOW_SIZE   0x400000
+
+// A candidate block covers 32 consecutive, naturally aligned slots
+#define RAMSEARCH_SLOTS_PER_BLOCK   32
+
+#define RAMSEARCH_SNAPSHOT_PATH     "/luma/ramsearch.bin"
+#define RAMSEARCH_MAX_EXPORTED      64
+
+#define RAMSEARCH_ERR_HEAP_FULL     MAKERESULT(RL_PERMANENT, RS_OUTOFRESOURCE, RM_APPLICATION, RD_OUT_OF_MEMORY)
+#define RAMSEARCH_ERR_NO_BASELINE   MAKERESULT(RL_PERMANENT, RS_INVALIDSTATE, RM_APPLICATION, RD_NOT_INITIALIZED)
+
+typedef enum RamSearchValueType
+{
+    RAMSEARCH_TYPE_U8 = 0,
+    RAMSEARCH_TYPE_U16,
+    RAMSEARCH_TYPE_U32,
+    RAMSEARCH_TYPE_FLOAT,
+
+    RAMSEARCH_TYPE_MAX,
+} RamSearchValueType;
+
+typedef enum RamSearchCompare
+{
+    RAMSEARCH_CMP_EQUAL = 0,
+    RAMSEARCH_CMP_NOT_EQUAL,
+    RAMSEARCH_CMP_GREATER,
+    RAMSEARCH_CMP_LESS,
+
+    // The following ones compare against the value recorded by the previous pass
+    RAMSEARCH_CMP_CHANGED,
+    RAMSEARCH_CMP_UNCHANGED,
+    RAMSEARCH_CMP_INCREASED,
+    RAMSEARCH_CMP_DECREASED,
+    RAMSEARCH_CMP_INCREASED_BY,
+    RAMSEARCH_CMP_DECREASED_BY,
+
+    RAMSEARCH_CMP_MAX,
+} RamSearchCompare;
+
+/// Header of a bitmap-encoded run of candidates, followed by one value per set bit (4-byte aligned as a whole)
+typedef struct RamSearchBlock
+{
+    u32 base;
+    u32 mask;
+} RamSearchBlock;
+
+typedef struct RamSearchContext
+{
+    Handle processHandle;
+    u64 titleId;
+
+    RamSearchValueType type;
+    u32 valueSize;
+
+    u8 *heap;
+    u32 heapSize;
+    u8 *ioBuffer;
+    u8 *candidates;
+    u32 candidatesCapacity;
+    u32 candidatesSize;
+    u32 numCandidates;
+
+    u32 windowBase;
+    u32 windowSize;
+
+    u32 numPasses;
+    bool hasSnapshot;
+    u32 lastPassMs;
+} RamSearchContext;
+
+Result RamSearch_Init(RamSearchContext *ctx, Handle processHandle, RamSearchValueType type);
+void RamSearch_Exit(RamSearchContext *ctx);
+void RamSearch_Reset(RamSearchContext *ctx, RamSearchValueType type);
+
+/// Streams all writable memory of the process to the SD card, as the baseline of an unknown-value search
+Result RamSearch_Snapshot(RamSearchContext *ctx);
+
+/// Runs a scan pass: over all writable memory (or the snapshot) for the first pass, over the candidates afterwards
+Result RamSearch_Refine(RamSearchContext *ctx, RamSearchCompare cmp, u32 operand);
+
+/// Fetches up to maxCount candidates starting at the given index, returns the number fetched
+u32 RamSearch_GetCandidates(const RamSearchContext *ctx, u32 startIndex, u32 *addrs, u32 *values, u32 maxCount);
+
+/// Appends the first candidates as Gateway codes writing their current value, to the title's cheat file
+Result RamSearch_ExportCheats(RamSearchContext *ctx, u32 *numExported);
+
+const char *RamSearch_GetTypeName(RamSearchValueType type);
+const char *RamSearch_GetCompareName(RamSearchCompare cmp);
+bool RamSearch_CompareNeedsOperand(RamSearchCompare cmp);
@@ -0,0 +1,76 @@
+/*
+*   This file is part of Luma3DS
+*   Copyright (C) 2016-2022 Aurora Wright, TuxSH
+*
+*   This program is free software: you can redistribute it and/or modify
+*   it under the terms of the GNU General Public License as published by
+*   the Free Software Foundation, either version 3 of the License, or
+*   (at your option) any later version.
+*
+*   This program is distributed in the hope that it will be useful,
+*   but WITHOUT ANY WARRANTY; without even the implied warranty of
+*   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*   GNU General Public License for more details.
+*
+*   You should have received a copy of the GNU General Public License
+*   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*
+*   Additional Terms 7.b and 7.c of GPLv3 apply to this file:
+*       * Requiring preservation of specified reasonable legal notices or
+*         author attributions in that material or in the Appropriate Legal
+*         Notices displayed by works containing it.
+*       * Prohibiting misrepresentation of the origin of that material,
+*         or requiring that modified versions of such material be marked in
+*         reasonable ways as different from the original version.
+*/
+
+#pragma once
+
+#include <3ds/types.h>
+#include "utils.h"
+#include "save_state_store.h"
+
+// Working memory, allocated from the SYSTEM region for the duration of a save or a restore and sized after the process
+#define SAVESTATE_HEAP_ADDR         0x0E400000
+#define SAVESTATE_MAP_ADDR          0x00100000
+#define SAVESTATE_MAP_WINDOW_SIZE   0x400000
+#define SAVESTATE_IO_BUFFER_SIZE    0x10000
+
+// Stored in /luma/savestates/<title ID>/slot<n>.lss. Incremental snapshots are based on slot 0, which must be a full one.
+#define SAVESTATE_NUM_SLOTS         4
+#define SAVESTATE_BASE_SLOT         0
+
+#define SAVESTATE_ERR_TOO_LARGE     MAKERESULT(RL_PERMANENT, RS_OUTOFRESOURCE, RM_APPLICATION, RD_OUT_OF_MEMORY)
+#define SAVESTATE_ERR_INVALID_FILE  MAKERESULT(RL_PERMANENT, RS_INVALIDARG, RM_APPLICATION, RD_INVALID_RESULT_VALUE)
+#define SAVESTATE_ERR_NO_BASE       MAKERESULT(RL_PERMANENT, RS_NOTFOUND, RM_APPLICATION, RD_NOT_FOUND)
+#define SAVESTATE_ERR_INVALID_SLOT  MAKERESULT(RL_PERMANENT, RS_INVALIDARG, RM_APPLICATION, RD_OUT_OF_RANGE)
+#define SAVESTATE_ERR_MISMATCH      MAKERESULT(RL_PERMANENT, RS_INVALIDSTATE, RM_APPLICATION, RD_INVALID_COMBINATION)
+
+typedef struct SaveStateStats
+{
+    u32 numRegions;
+    u32 numPages;
+    u32 numChunks;
+    u32 numZeroPages;
+    u32 numBasePages;
+    u32 numDedupPages;
+    u32 numThreads;
+    u32 numThreadsMissing;  ///< Restore: saved threads that don't exist anymore
+    u64 fileSize;
+    u32 elapsedMs;
+} SaveStateStats;
+
+/**
+ * @brief Saves the writable memory and thread contexts of a process, which is frozen through the debug API meanwhile.
+ * @param incremental Only store the pages that changed since the snapshot in SAVESTATE_BASE_SLOT.
+ *
+ * Kernel objects (handles, synchronization objects, shared memory...) aren't part of the snapshot: it can only be
+ * restored into the same run of the title, e.g. to replay a scenario.
+ */
+Result SaveState_Save(u32 pid, u64 titleId, u32 slot, bool incremental, SaveStateStats *stats);
+
+/// Restores a snapshot in place. Nothing is written if the memory layout of the process doesn't match.
+Result SaveState_Restore(u32 pid, u64 titleId, u32 slot, SaveStateStats *stats);
+
+/// Reads the header of a slot.
+Result SaveState_GetSlotInfo(u64 titleId, u32 slot, SaveStateHeader *header);
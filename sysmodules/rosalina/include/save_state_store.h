@@ -0,0 +1,144 @@
+/*
+*   This file is part of Luma3DS
+*   Copyright (C) 2016-2022 Aurora Wright, TuxSH
+*
+*   This program is free software: you can redistribute it and/or modify
+*   it under the terms of the GNU General Public License as published by
+*   the Free Software Foundation, either version 3 of the License, or
+*   (at your option) any later version.
+*
+*   This program is distributed in the hope that it will be useful,
+*   but WITHOUT ANY WARRANTY; without even the implied warranty of
+*   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*   GNU General Public License for more details.
+*
+*   You should have received a copy of the GNU General Public License
+*   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*
+*   Additional Terms 7.b and 7.c of GPLv3 apply to this file:
+*       * Requiring preservation of specified reasonable legal notices or
+*         author attributions in that material or in the Appropriate Legal
+*         Notices displayed by works containing it.
+*       * Prohibiting misrepresentation of the origin of that material,
+*         or requiring that modified versions of such material be marked in
+*         reasonable ways as different from the original version.
+*/
+
+#pragma once
+
+#include <3ds/types.h>
+
+// Save state files and their chunk store. Shared with the host tools (host/sstool.c), so nothing console-specific here.
+//
+// File layout: header, compressed chunks (one per distinct page), then the region table, the page references,
+// the page hashes, the chunk table and the thread contexts, at the (8-byte aligned) offsets given by the header.
+// Pages of the regions follow each other in the page reference and page hash tables.
+
+#define SAVESTATE_MAGIC             0x5453534C // 'LSST'
+#define SAVESTATE_VERSION           1
+#define SAVESTATE_PAGE_SIZE         0x1000
+
+#define SAVESTATE_MAX_REGIONS       64
+#define SAVESTATE_MAX_THREADS       32
+#define SAVESTATE_MAX_PAGES         0x8000 // 128MB, also the maximum number of chunks
+
+#define SAVESTATE_FLAG_INCREMENTAL  1
+
+// Page references: a chunk index, or one of these
+#define SAVESTATE_REF_ZERO          0xFFFFFFFE  ///< All zeros, nothing stored
+#define SAVESTATE_REF_BASE          0xFFFFFFFD  ///< Unchanged since the base snapshot (incremental snapshots only)
+#define SAVESTATE_REF_NEW           0xFFFFFFFC  ///< Not in the store yet (SaveStateStore_LookupPage only)
+
+#define SAVESTATE_ZERO_PAGE_HASH    0ULL
+#define SAVESTATE_NO_BASE_PAGE      0xFFFFFFFF
+
+typedef struct SaveStateHeader
+{
+    u32 magic;
+    u16 version;
+    u16 flags;
+    u64 titleId;
+    u64 id;                 ///< System tick at capture time, identifies the snapshot
+    u64 baseId;             ///< Incremental snapshots: id of the base snapshot
+    u64 creationTime;       ///< Milliseconds since 1900
+    u32 numRegions;
+    u32 numPages;
+    u32 numChunks;
+    u32 numThreads;
+    u32 regionsOffset;
+    u32 pageRefsOffset;
+    u32 pageHashesOffset;
+    u32 chunksOffset;
+    u32 threadsOffset;
+    u32 numZeroPages;
+    u32 numBasePages;
+    u32 numDedupPages;      ///< Pages sharing their chunk with an earlier page
+    u32 chunkDataSize;      ///< Compressed size of all chunks
+    u32 reserved;
+} SaveStateHeader;
+
+typedef struct SaveStateRegion
+{
+    u32 addr;
+    u32 size;
+    u32 perm;
+    u32 state;
+} SaveStateRegion;
+
+typedef struct SaveStateChunk
+{
+    u64 hash;
+    u32 offset;
+    u32 storedSize;         ///< SAVESTATE_PAGE_SIZE when stored uncompressed
+} SaveStateChunk;
+
+typedef struct SaveStateThread
+{
+    u32 threadId;
+    u32 cpu[17];            ///< r0-r12, sp, lr, pc, cpsr
+    u64 fpu[16];            ///< d0-d15
+    u32 fpscr;
+    u32 fpexc;
+} SaveStateThread;
+
+// Chunk store: deduplicates pages by 64-bit hash (pages with the same hash are assumed identical)
+typedef struct SaveStateStore
+{
+    u64 *hashes;
+    u32 *offsets;
+    u16 *storedSizes;
+    u16 *index;             ///< Open addressing, chunk index + 1 (0: free slot)
+    u32 indexMask;
+    u32 numChunks;
+    u32 maxChunks;
+} SaveStateStore;
+
+/// Memory needed by SaveStateStore_Init, 8-byte aligned.
+u32 SaveStateStore_GetRequiredSize(u32 maxChunks);
+void SaveStateStore_Init(SaveStateStore *store, void *mem, u32 maxChunks);
+
+bool SaveStateStore_IsZeroPage(const void *page);
+/// Never returns SAVESTATE_ZERO_PAGE_HASH for a page that isn't all zeros.
+u64 SaveStateStore_HashPage(const void *page);
+
+/// Returns SAVESTATE_REF_NEW if there is no chunk with that hash.
+u32 SaveStateStore_Find(const SaveStateStore *store, u64 hash);
+
+/**
+ * @brief Decides how a page is stored.
+ * @param baseHash Hash of the page at the same address in the base snapshot, or NULL if there is none.
+ * @param[out] outHash Hash of the page.
+ * @return SAVESTATE_REF_ZERO, SAVESTATE_REF_BASE, the index of an identical chunk, or SAVESTATE_REF_NEW
+ *         if the page has to be written then added with SaveStateStore_AddChunk.
+ */
+u32 SaveStateStore_LookupPage(const SaveStateStore *store, const void *page, const u64 *baseHash, u64 *outHash);
+
+/// Returns the index of the new chunk, or SAVESTATE_REF_NEW if the store is full.
+u32 SaveStateStore_AddChunk(SaveStateStore *store, u64 hash, u32 offset, u32 storedSize);
+
+/**
+ * @brief Finds, for each page of a snapshot, the page at the same address in its base snapshot.
+ * @param[out] basePages One entry per page of regions: index of the page in the base snapshot, or SAVESTATE_NO_BASE_PAGE.
+ * Both region lists must be sorted by address, which is how they are captured.
+ */
+void SaveStateStore_MatchBasePages(u32 *basePages, const SaveStateRegion *regions, u32 numRegions, const SaveStateRegion *baseRegions, u32 numBaseRegions);
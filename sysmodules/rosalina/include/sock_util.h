@@ -9,13 +9,19 @@
 
 #pragma once
 #include <3ds/types.h>
+#include <3ds/synchronization.h>
 #include <poll.h>
 #include <netinet/in.h>
-#include "utils.h"
 
+// Can be overriden by the host build (see host/Makefile)
+#ifndef MAX_PORTS
 #define MAX_PORTS (3+1)
+#endif
 #define MAX_CTXS  (2 * MAX_PORTS)
 
+// socPoll can't be woken up: this is how long closing requests and termination can wait
+#define SERVER_POLL_TIMEOUT_MS  50
+
 struct sock_server;
 struct sock_ctx;
 
@@ -33,6 +39,17 @@ typedef enum socket_type
     SOCK_CLIENT
 } socket_type;
 
+// Per-connection accounting, added to the totals of the server when the connection is closed
+typedef struct sock_ctx_stats
+{
+    u64 bytes_received;
+    u64 bytes_sent;
+    u32 drops; // messages not sent because the send queue was full
+    u32 nb_callbacks;
+    u64 total_latency; // ticks from poll returning to the end of the data callback
+    u64 max_latency;
+} sock_ctx_stats;
+
 typedef struct sock_ctx
 {
     enum socket_type type;
@@ -42,20 +59,47 @@ typedef struct sock_ctx
     struct sock_ctx *serv;
     int n;
     int i;
+
+    // Readiness reported by the last poll, while on the ready list
+    bool ready;
+    short revents;
+
+    // Set by the alloc callback, NULL for blocking sends. See server_send
+    u8 *send_queue;
+    u32 send_queue_size;
+    u32 send_head;
+    u32 send_size;
+    LightLock send_lock;
+
+    sock_ctx_stats stats;
 } sock_ctx;
 
+typedef struct sock_server_stats
+{
+    u32 accepted;
+    u32 rejected; // client limits, allocation failures
+    u32 closed;
+    sock_ctx_stats clients; // closed and current connections
+} sock_server_stats;
+
 typedef struct sock_server
 {
     // params
     u32 host;
     int clients_per_server;
+    int max_clients; // over all ports, 0 for MAX_CTXS
 
     // poll stuff
     struct pollfd poll_fds[MAX_CTXS];
     struct sock_ctx serv_ctxs[MAX_PORTS];
     struct sock_ctx *ctx_ptrs[MAX_CTXS];
 
+    // contexts with events, in poll order
+    struct sock_ctx *ready_list[MAX_CTXS];
+    nfds_t nready;
+
     nfds_t nfds;
+    int nclients;
     bool running;
     Handle started_event;
     bool compact_needed;
@@ -70,6 +114,8 @@ typedef struct sock_server
 
     Handle shall_terminate_event;
     Result init_result;
+
+    sock_server_stats stats; // of the closed connections, see server_get_stats
 } sock_server;
 
 Result server_init(struct sock_server *serv);
@@ -78,4 +124,12 @@ void server_run(struct sock_server *serv);
 void server_kill_connections(struct sock_server *serv);
 void server_set_should_close_all(struct sock_server *serv);
 void server_finalize(struct sock_server *serv);
+
+// Never blocks when the context has a send queue: what the socket doesn't take is queued, and sent when
+// it becomes writable. Messages that don't fit are dropped (-1), a slow client can't stall the server.
+// Thread-safe
+ssize_t server_send(struct sock_ctx *ctx, const void *buf, size_t len);
+// Also does the accounting
+ssize_t server_recv(struct sock_ctx *ctx, void *buf, size_t len, int flags);
+void server_get_stats(struct sock_server *serv, sock_server_stats *out);
 bool Wifi__IsConnected(void);
@@ -2,25 +2,92 @@
 
 #include <3ds/types.h>
 #include <3ds/synchronization.h>
-#include "MyThread.h"
-#include "utils.h"
 
-typedef struct TaskRunner {
-    LightEvent readyEvent;
-    LightEvent parametersSetEvent;
+#define TASK_RUNNER_NUM_WORKERS     2
+#define TASK_RUNNER_QUEUE_SIZE      8
+#define TASK_RUNNER_ARG_SIZE        0x40
+
+#define TASK_HANDLE_INVALID         0u
+
+typedef u32 TaskHandle;
+
+typedef enum TaskPriority {
+    TASK_PRIORITY_HIGH = 0,
+    TASK_PRIORITY_NORMAL,
+    TASK_PRIORITY_LOW,
+
+    TASK_PRIORITY_COUNT,
+} TaskPriority;
+
+typedef enum TaskState {
+    TASK_STATE_FREE = 0,
+    TASK_STATE_PENDING,
+    TASK_STATE_RUNNING,
+} TaskState;
+
+typedef struct TaskSlot {
     void (*task)(void *argdata);
-    u8 argStorage[0x40];
+    u8 argStorage[TASK_RUNNER_ARG_SIZE];
+    TaskState state;
+    TaskPriority priority;
+    bool serial;            ///< Queued by TaskRunner_RunTask
+    u32 generation;
+    u32 sequence;
+    u64 submitTick;
+    u64 startTick;
+    LightEvent doneEvent;
+} TaskSlot;
+
+typedef struct TaskRunnerStats {
+    u32 submitted;
+    u32 completed;
+    u32 rejected;           ///< Non-blocking submissions refused because the queue was full
+    u32 maxQueueDepth;
+    u64 totalWaitTicks;     ///< Time spent between submission and start of execution
+    u64 totalRunTicks;
+    u64 maxWaitTicks;
+    u64 maxRunTicks;
+} TaskRunnerStats;
+
+typedef struct TaskRunner {
+    LightLock lock;
+    LightSemaphore pendingSem;  ///< Counts pending tasks, workers wait on it
+    LightSemaphore freeSem;     ///< Counts free slots, blocking submitters wait on it
+    LightEvent idleEvent;       ///< Signaled while no task is pending or running
+    TaskSlot slots[TASK_RUNNER_QUEUE_SIZE];
+    u32 nextSequence;
+    u32 numActive;
+    bool serialRunning;
+    u32 numDeferredWakeups;     ///< Workers that found only serial tasks waiting for the running one
+    TaskRunnerStats stats;
     bool shouldTerminate;
 } TaskRunner;
 
 extern TaskRunner g_taskRunner;
 
-MyThread *taskRunnerCreateThread(void);
+void taskRunnerCreateThreads(void);
+void TaskRunner_JoinThreads(s64 timeout_ns);
 
 void TaskRunner_Init(void);
+
+/// Queues a task with normal priority, blocking while the queue is full. Doesn't wait for completion.
+/// Tasks queued this way run one at a time in submission order, as with the former single-thread
+/// runner: the callers rely on it (plgloader.c's SetMode3AppMode and WaitForProcessTerminated and the
+/// debugger's next application task all act on the application being launched or terminated, and
+/// WaitForProcessTerminated can block for seconds). Tasks queued with TaskRunner_SubmitTask run concurrently.
 void TaskRunner_RunTask(void (*task)(void *argdata), void *argdata, size_t argsize);
+
+/// Queues a task without blocking. Returns TASK_HANDLE_INVALID if the queue is full.
+TaskHandle TaskRunner_SubmitTask(void (*task)(void *argdata), const void *argdata, size_t argsize, TaskPriority priority);
+
+/// Waits for the completion of a submitted task. Returns false on timeout.
+bool TaskRunner_WaitTask(TaskHandle handle, s64 timeout_ns);
+
+void TaskRunner_GetStats(TaskRunnerStats *out);
 void TaskRunner_Terminate(void);
 
 /// Thread function
 void TaskRunner_HandleTasks(void);
+
+/// Waits until no task is pending or running
 void TaskRunner_WaitReady(void);
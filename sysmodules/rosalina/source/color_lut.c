@@ -0,0 +1,141 @@
+/*
+*   This file is part of Luma3DS
+*   Copyright (C) 2016-2022 Aurora Wright, TuxSH
+*
+*   This program is free software: you can redistribute it and/or modify
+*   it under the terms of the GNU General Public License as published by
+*   the Free Software Foundation, either version 3 of the License, or
+*   (at your option) any later version.
+*
+*   This program is distributed in the hope that it will be useful,
+*   but WITHOUT ANY WARRANTY; without even the implied warranty of
+*   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*   GNU General Public License for more details.
+*
+*   You should have received a copy of the GNU General Public License
+*   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*
+*   Additional Terms 7.b and 7.c of GPLv3 apply to this file:
+*       * Requiring preservation of specified reasonable legal notices or
+*         author attributions in that material or in the Appropriate Legal
+*         Notices displayed by works containing it.
+*       * Prohibiting misrepresentation of the origin of that material,
+*         or requiring that modified versions of such material be marked in
+*         reasonable ways as different from the original version.
+*/
+
+#include <3ds.h>
+#include <math.h>
+#include <string.h>
+#include "color_lut.h"
+#include "menus/screen_filters_srgb_tables.h"
+#include "redshift/colorramp.h"
+
+#define COLOR_LUT_ONE   (1LL << COLOR_LUT_FRAC_BITS)
+
+typedef struct ColorLutCacheEntry
+{
+    ScreenFilter key;
+    u32 lastUse; // 0 if unused
+    u32 lut[256];
+} ColorLutCacheEntry;
+
+static ColorLutCacheEntry g_lutCache[COLOR_LUT_CACHE_SIZE];
+static u32 g_lutUseCounter;
+
+// Output level k (1 to 255) is reached once the clamped level is at least ((k - 0.5) / 255)^(1 / gamma).
+// This replaces the 3x256 powf calls per LUT with 255 per gamma value, usually shared by both screens
+static float g_thresholdsGamma = -1.0f;
+static u32 g_thresholds[255];
+
+static void ColorLut_ComputeThresholds(float gamma)
+{
+    if(gamma == g_thresholdsGamma)
+        return;
+
+    for(u32 k = 1; k <= 255; k++)
+    {
+        u32 threshold = 0; // x^0 is 1, including for x = 0
+
+        if(gamma != 0.0f)
+        {
+            threshold = (u32)(powf((k - 0.5f) / 255.0f, 1.0f / gamma) * COLOR_LUT_ONE + 0.5f);
+            threshold = threshold == 0 ? 1 : threshold; // but 0^gamma is 0
+        }
+
+        g_thresholds[k - 1] = threshold;
+    }
+
+    g_thresholdsGamma = gamma;
+}
+
+// Output levels of clamp(offset + slope * v / 255)^gamma for all 256 input levels v
+static void ColorLut_ComputeChannel(u8 *out, float slope, float offset)
+{
+    s64 slopeFixed = (s64)(slope * COLOR_LUT_ONE + (slope < 0.0f ? -0.5f : 0.5f));
+    s64 offsetFixed = (s64)(offset * COLOR_LUT_ONE + (offset < 0.0f ? -0.5f : 0.5f));
+    u32 k = 0;
+
+    for(u32 v = 0; v < 256; v++)
+    {
+        s64 level = offsetFixed + (slopeFixed * (s64)v + 127) / 255;
+        level = CLAMP(level, 0, COLOR_LUT_ONE);
+
+        // The level is monotonic in v, so the thresholds can be walked instead of searched
+        if(slope < 0.0f)
+            k = 0;
+        while(k < 255 && (s64)g_thresholds[k] <= level)
+            k++;
+
+        out[v] = (u8)k;
+    }
+}
+
+static void ColorLut_Compute(u32 *lut, const ScreenFilter *filter)
+{
+    float wp[3];
+    u8 levels[3][256];
+    const u8 (*tbl)[3] = filter->colorCurveCorrection == 2 ? ctrToSrgbTableBottom : ctrToSrgbTableTop;
+
+    colorramp_get_white_point(wp, filter->cct);
+    ColorLut_ComputeThresholds(filter->gamma);
+
+    // contrast * whitepoint * x + brightness
+    for(u32 c = 0; c < 3; c++)
+        ColorLut_ComputeChannel(levels[c], filter->contrast * wp[c], filter->brightness);
+
+    for(u32 i = 0; i < 256; i++)
+    {
+        u32 inLevel = filter->invert ? 255 - i : i;
+
+        u32 inLevelR = filter->colorCurveCorrection > 0 ? tbl[inLevel][0] : inLevel;
+        u32 inLevelG = filter->colorCurveCorrection > 0 ? tbl[inLevel][1] : inLevel;
+        u32 inLevelB = filter->colorCurveCorrection > 0 ? tbl[inLevel][2] : inLevel;
+
+        lut[i] = levels[0][inLevelR] | (levels[1][inLevelG] << 8) | (levels[2][inLevelB] << 16);
+    }
+}
+
+const u32 *ColorLut_Get(const ScreenFilter *filter)
+{
+    ColorLutCacheEntry *entry = &g_lutCache[0];
+
+    for(u32 i = 0; i < COLOR_LUT_CACHE_SIZE; i++)
+    {
+        if(g_lutCache[i].lastUse != 0 && memcmp(&g_lutCache[i].key, filter, sizeof(ScreenFilter)) == 0)
+        {
+            g_lutCache[i].lastUse = ++g_lutUseCounter;
+            return g_lutCache[i].lut;
+        }
+
+        // Evict the least recently used one
+        if(g_lutCache[i].lastUse < entry->lastUse)
+            entry = &g_lutCache[i];
+    }
+
+    entry->key = *filter;
+    entry->lastUse = ++g_lutUseCounter;
+    ColorLut_Compute(entry->lut, filter);
+
+    return entry->lut;
+}
@@ -0,0 +1,527 @@
+/*
+*   This file is part of Luma3DS
+*   Copyright (C) 2016-2022 Aurora Wright, TuxSH
+*
+*   This program is free software: you can redistribute it and/or modify
+*   it under the terms of the GNU General Public License as published by
+*   the Free Software Foundation, either version 3 of the License, or
+*   (at your option) any later version.
+*
+*   This program is distributed in the hope that it will be useful,
+*   but WITHOUT ANY WARRANTY; without even the implied warranty of
+*   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*   GNU General Public License for more details.
+*
+*   You should have received a copy of the GNU General Public License
+*   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*
+*   Additional Terms 7.b and 7.c of GPLv3 apply to this file:
+*       * Requiring preservation of specified reasonable legal notices or
+*         author attributions in that material or in the Appropriate Legal
+*         Notices displayed by works containing it.
+*       * Prohibiting misrepresentation of the origin of that material,
+*         or requiring that modified versions of such material be marked in
+*         reasonable ways as different from the original version.
+*/
+
+#include <3ds.h>
+#include "core_dump.h"
+#include "csvc.h"
+#include "fmt.h"
+#include "ifile.h"
+#include "lz4.h"
+#include "task_runner.h"
+
+#define ALIGN4(x)               (((x) + 3) & ~3)
+
+#define COREDUMP_HDR_BUF_SIZE   0x4000
+#define COREDUMP_OUT_BUF_SIZE   (8 + LZ4_COMPRESS_BOUND(COREDUMP_LZ4C_BLOCK_SIZE))
+#define COREDUMP_HEAP_SIZE      ((COREDUMP_LZ4C_BLOCK_SIZE + 2 * COREDUMP_OUT_BUF_SIZE + LZ4_HASH_TABLE_SIZE + COREDUMP_HDR_BUF_SIZE + 0xFFF) & ~0xFFF)
+
+#define COREDUMP_ADDRESS_SPACE_END 0x40000000
+
+#define ELF_PT_LOAD             1
+#define ELF_PT_NOTE             4
+#define ELF_NT_PRSTATUS         1
+#define ELF_NT_ARM_VFP          0x400
+
+typedef struct ElfHeader
+{
+    u8 e_ident[16];
+    u16 e_type;
+    u16 e_machine;
+    u32 e_version;
+    u32 e_entry;
+    u32 e_phoff;
+    u32 e_shoff;
+    u32 e_flags;
+    u16 e_ehsize;
+    u16 e_phentsize;
+    u16 e_phnum;
+    u16 e_shentsize;
+    u16 e_shnum;
+    u16 e_shstrndx;
+} ElfHeader;
+
+typedef struct ElfProgramHeader
+{
+    u32 p_type;
+    u32 p_offset;
+    u32 p_vaddr;
+    u32 p_paddr;
+    u32 p_filesz;
+    u32 p_memsz;
+    u32 p_flags;
+    u32 p_align;
+} ElfProgramHeader;
+
+typedef struct ElfNoteHeader
+{
+    u32 n_namesz;
+    u32 n_descsz;
+    u32 n_type;
+} ElfNoteHeader;
+
+// Linux/ARM struct elf_prstatus
+typedef struct ElfPrStatus
+{
+    u32 si_signo, si_code, si_errno;
+    u16 pr_cursig, pad;
+    u32 pr_sigpend, pr_sighold;
+    u32 pr_pid, pr_ppid, pr_pgrp, pr_sid;
+    u32 pr_times[8];
+    u32 pr_reg[18]; // r0-r15, cpsr, orig_r0
+    u32 pr_fpvalid;
+} ElfPrStatus;
+
+typedef struct CoreDumpSegment
+{
+    u32 addr;
+    u32 size;
+    u32 perm;
+} CoreDumpSegment;
+
+typedef struct CoreDumpWriter
+{
+    IFile file;
+    bool compress;
+
+    u8 *stage;          // raw data of the block being filled (out[outIdx] itself when not compressing)
+    u32 stageFill;
+    u8 *out[2];         // one block is written while the other one is being filled
+    u32 outIdx;
+    u8 *hashTable;
+
+    TaskHandle pending;
+    Result pendingRes;
+
+    u64 rawSize;
+    u64 fileSize;
+} CoreDumpWriter;
+
+typedef struct CoreDumpWriteTaskArgs
+{
+    IFile *file;
+    const void *buf;
+    u32 size;
+    Result *res;
+} CoreDumpWriteTaskArgs;
+
+static void CoreDump_WriteTask(void *argdata)
+{
+    CoreDumpWriteTaskArgs *args = (CoreDumpWriteTaskArgs *)argdata;
+    u64 total;
+    *args->res = IFile_Write(args->file, &total, args->buf, args->size, 0);
+}
+
+static Result CoreDump_WaitPending(CoreDumpWriter *w)
+{
+    if (w->pending != TASK_HANDLE_INVALID)
+    {
+        TaskRunner_WaitTask(w->pending, -1LL);
+        w->pending = TASK_HANDLE_INVALID;
+    }
+
+    return w->pendingRes;
+}
+
+static u8 *CoreDump_GetStage(CoreDumpWriter *w)
+{
+    // Uncompressed data is copied straight into the output buffer that isn't in flight
+    return w->compress ? w->stage : w->out[w->outIdx];
+}
+
+static Result CoreDump_FlushBlock(CoreDumpWriter *w)
+{
+    if (w->stageFill == 0)
+        return 0;
+
+    u8 *out = w->out[w->outIdx];
+    u32 writeSize = w->stageFill;
+    if (w->compress)
+    {
+        u32 storedSize = lz4CompressBlock(w->stage, w->stageFill, out + 8, COREDUMP_OUT_BUF_SIZE - 8, w->hashTable);
+        if (storedSize == 0 || storedSize >= w->stageFill)
+        {
+            // Incompressible, store as-is
+            storedSize = w->stageFill;
+            memcpy(out + 8, w->stage, storedSize);
+        }
+
+        ((u32 *)out)[0] = w->stageFill;
+        ((u32 *)out)[1] = storedSize;
+        writeSize = 8 + storedSize;
+    }
+    w->stageFill = 0;
+
+    // The other buffer must not be in flight anymore before it gets reused for the next block
+    Result res = CoreDump_WaitPending(w);
+    if (R_FAILED(res))
+        return res;
+
+    w->fileSize += writeSize;
+    CoreDumpWriteTaskArgs args = { &w->file, out, writeSize, &w->pendingRes };
+    w->outIdx ^= 1;
+    w->pending = TaskRunner_SubmitTask(CoreDump_WriteTask, &args, sizeof(args), TASK_PRIORITY_LOW);
+    if (w->pending != TASK_HANDLE_INVALID)
+        return 0;
+
+    // Queue full, write synchronously
+    CoreDump_WriteTask(&args);
+    return w->pendingRes;
+}
+
+static Result CoreDump_Write(CoreDumpWriter *w, const void *data, u32 size)
+{
+    const u8 *src = (const u8 *)data;
+    Result res = 0;
+
+    w->rawSize += size;
+    while (size > 0 && R_SUCCEEDED(res))
+    {
+        u32 n = COREDUMP_LZ4C_BLOCK_SIZE - w->stageFill;
+        n = n > size ? size : n;
+        memcpy(CoreDump_GetStage(w) + w->stageFill, src, n);
+        w->stageFill += n;
+        src += n;
+        size -= n;
+
+        if (w->stageFill == COREDUMP_LZ4C_BLOCK_SIZE)
+            res = CoreDump_FlushBlock(w);
+    }
+
+    return res;
+}
+
+static Result CoreDump_WriteZeros(CoreDumpWriter *w, u32 size)
+{
+    Result res = 0;
+
+    w->rawSize += size;
+    while (size > 0 && R_SUCCEEDED(res))
+    {
+        u32 n = COREDUMP_LZ4C_BLOCK_SIZE - w->stageFill;
+        n = n > size ? size : n;
+        memset(CoreDump_GetStage(w) + w->stageFill, 0, n);
+        w->stageFill += n;
+        size -= n;
+
+        if (w->stageFill == COREDUMP_LZ4C_BLOCK_SIZE)
+            res = CoreDump_FlushBlock(w);
+    }
+
+    return res;
+}
+
+static Result CoreDump_Finish(CoreDumpWriter *w)
+{
+    Result res = CoreDump_FlushBlock(w);
+    Result res2 = CoreDump_WaitPending(w);
+    u64 total;
+
+    res = R_SUCCEEDED(res) ? res2 : res;
+    if (w->compress)
+    {
+        static const u32 terminator[2] = { 0, 0 };
+
+        if (R_SUCCEEDED(res))
+            res = IFile_Write(&w->file, &total, terminator, sizeof(terminator), 0);
+        w->fileSize += sizeof(terminator);
+    }
+
+    return res;
+}
+
+static bool CoreDump_IsDumpable(const MemInfo *mem)
+{
+    if (!(mem->perm & MEMPERM_READ))
+        return false;
+
+    switch (mem->state)
+    {
+        case MEMSTATE_FREE:
+        case MEMSTATE_RESERVED:
+        case MEMSTATE_IO:
+            return false;
+        default:
+            return true;
+    }
+}
+
+static u32 CoreDump_GetSegments(Handle processHandle, CoreDumpSegment *segments)
+{
+    u32 n = 0;
+    u32 addr = 0;
+
+    while (addr < COREDUMP_ADDRESS_SPACE_END && n < COREDUMP_MAX_SEGMENTS)
+    {
+        MemInfo mem;
+        PageInfo out;
+        if (R_FAILED(svcQueryProcessMemory(&mem, &out, processHandle, addr)) || mem.base_addr + mem.size <= addr)
+            break;
+
+        if (CoreDump_IsDumpable(&mem))
+        {
+            segments[n].addr = mem.base_addr;
+            segments[n].size = mem.size;
+            segments[n].perm = mem.perm;
+            n++;
+        }
+
+        addr = mem.base_addr + mem.size;
+    }
+
+    return n;
+}
+
+// Attaching breaks the process once all the attach events have been handled, giving us a consistent view
+u32 CoreDump_FreezeProcess(Handle debug, u32 *threadIds)
+{
+    DebugEventInfo info;
+    u32 n = 0;
+
+    while (R_SUCCEEDED(svcGetProcessDebugEvent(&info, debug)) &&
+           !(info.type == DBGEVENT_EXCEPTION && info.exception.type == EXCEVENT_ATTACH_BREAK))
+    {
+        if (info.type == DBGEVENT_ATTACH_THREAD && n < COREDUMP_MAX_THREADS)
+            threadIds[n++] = info.thread_id;
+        svcContinueDebugEvent(debug, (DebugFlags)0);
+    }
+
+    return n;
+}
+
+void CoreDump_ResumeProcess(Handle debug)
+{
+    DebugEventInfo dummy;
+
+    while (R_SUCCEEDED(svcGetProcessDebugEvent(&dummy, debug)));
+    while (R_SUCCEEDED(svcContinueDebugEvent(debug, (DebugFlags)0)));
+    svcCloseHandle(debug);
+}
+
+static u8 *CoreDump_AddNote(u8 *p, const char *name, u32 type, const void *desc, u32 descSize)
+{
+    u32 nameSize = strlen(name) + 1;
+    ElfNoteHeader hdr = { nameSize, descSize, type };
+
+    memcpy(p, &hdr, sizeof(hdr));
+    p += sizeof(hdr);
+    memset(p, 0, ALIGN4(nameSize));
+    memcpy(p, name, nameSize);
+    p += ALIGN4(nameSize);
+    memset(p, 0, ALIGN4(descSize));
+    memcpy(p, desc, descSize);
+
+    return p + ALIGN4(descSize);
+}
+
+static u8 *CoreDump_AddThreadNotes(u8 *p, Handle debug, u32 threadId, bool isFirst)
+{
+    ThreadContext regs;
+    ElfPrStatus prstatus = { 0 };
+    u8 vfp[32 * 8 + 4] = { 0 }; // 32 doubles (only 16 exist on VFPv2) followed by fpscr
+
+    if (R_FAILED(svcGetDebugThreadContext(&regs, debug, threadId, THREADCONTEXT_CONTROL_ALL)))
+        return p;
+
+    prstatus.si_signo = prstatus.pr_cursig = isFirst ? 5 : 0; // SIGTRAP
+    prstatus.pr_pid = threadId;
+    memcpy(prstatus.pr_reg, regs.cpu_registers.r, sizeof(regs.cpu_registers.r));
+    prstatus.pr_reg[13] = regs.cpu_registers.sp;
+    prstatus.pr_reg[14] = regs.cpu_registers.lr;
+    prstatus.pr_reg[15] = regs.cpu_registers.pc;
+    prstatus.pr_reg[16] = regs.cpu_registers.cpsr;
+    prstatus.pr_fpvalid = 1;
+
+    memcpy(vfp, regs.fpu_registers.d, sizeof(regs.fpu_registers.d));
+    memcpy(vfp + 32 * 8, &regs.fpu_registers.fpscr, 4);
+
+    p = CoreDump_AddNote(p, "CORE", ELF_NT_PRSTATUS, &prstatus, sizeof(prstatus));
+    return CoreDump_AddNote(p, "LINUX", ELF_NT_ARM_VFP, vfp, sizeof(vfp));
+}
+
+static Result CoreDump_WriteSegment(CoreDumpWriter *w, Handle processHandle, const CoreDumpSegment *seg)
+{
+    Result res = 0;
+
+    for (u32 off = 0; off < seg->size && R_SUCCEEDED(res); off += COREDUMP_MAP_WINDOW_SIZE)
+    {
+        u32 size = seg->size - off < COREDUMP_MAP_WINDOW_SIZE ? seg->size - off : COREDUMP_MAP_WINDOW_SIZE;
+
+        // Keep the file layout intact even if some memory can't be mapped
+        if (R_FAILED(svcMapProcessMemoryEx(CUR_PROCESS_HANDLE, COREDUMP_MAP_ADDR, processHandle, seg->addr + off, size)))
+        {
+            res = CoreDump_WriteZeros(w, size);
+            continue;
+        }
+
+        res = CoreDump_Write(w, (const void *)COREDUMP_MAP_ADDR, size);
+        svcUnmapProcessMemoryEx(CUR_PROCESS_HANDLE, COREDUMP_MAP_ADDR, size);
+    }
+
+    return res;
+}
+
+static Result CoreDump_OpenFile(CoreDumpWriter *w, const char *name)
+{
+    char filename[100];
+    char dateTimeStr[32];
+    FS_Archive archive;
+    FS_ArchiveID archiveId;
+    s64 out;
+    Result res;
+
+    if (R_FAILED(svcGetSystemInfo(&out, 0x10000, 0x203))) svcBreak(USERBREAK_ASSERT);
+    archiveId = (bool)out ? ARCHIVE_SDMC : ARCHIVE_NAND_RW;
+
+    res = FSUSER_OpenArchive(&archive, archiveId, fsMakePath(PATH_EMPTY, ""));
+    if (R_SUCCEEDED(res))
+    {
+        FSUSER_CreateDirectory(archive, fsMakePath(PATH_ASCII, "/luma/dumps"), 0);
+        FSUSER_CreateDirectory(archive, fsMakePath(PATH_ASCII, "/luma/dumps/memory"), 0);
+        FSUSER_CloseArchive(archive);
+    }
+
+    dateTimeToString(dateTimeStr, osGetTime(), true);
+    sprintf(filename, "/luma/dumps/memory/%.8s_%s.core%s", name, dateTimeStr, w->compress ? ".lz4c" : "");
+
+    return IFile_Open(&w->file, archiveId, fsMakePath(PATH_EMPTY, ""), fsMakePath(PATH_ASCII, filename), FS_OPEN_CREATE | FS_OPEN_WRITE);
+}
+
+Result CoreDump_DumpProcess(u32 pid, const char *name, bool compress, CoreDumpStats *stats)
+{
+    CoreDumpSegment segments[COREDUMP_MAX_SEGMENTS];
+    u32 threadIds[COREDUMP_MAX_THREADS];
+    CoreDumpWriter w = { 0 };
+    Handle processHandle = 0, debug = 0;
+    u64 startTick = svcGetSystemTick();
+    u32 numThreads = 0;
+    u32 heap;
+    Result res;
+
+    memset(stats, 0, sizeof(CoreDumpStats));
+
+    res = svcOpenProcess(&processHandle, pid);
+    if (R_FAILED(res))
+        return res;
+
+    res = svcControlMemoryEx(&heap, COREDUMP_HEAP_ADDR, 0, COREDUMP_HEAP_SIZE, MEMOP_ALLOC | MEMOP_REGION_SYSTEM, MEMPERM_READWRITE, true);
+    if (R_FAILED(res))
+    {
+        svcCloseHandle(processHandle);
+        return res;
+    }
+
+    w.compress = compress;
+    w.stage = (u8 *)COREDUMP_HEAP_ADDR;
+    w.out[0] = w.stage + COREDUMP_LZ4C_BLOCK_SIZE;
+    w.out[1] = w.out[0] + COREDUMP_OUT_BUF_SIZE;
+    w.hashTable = w.out[1] + COREDUMP_OUT_BUF_SIZE;
+    u8 *hdrBuf = w.hashTable + LZ4_HASH_TABLE_SIZE;
+
+    // Not fatal: the process may already be debugged (e.g. by GDB), in which case thread contexts are left out
+    if (R_SUCCEEDED(svcDebugActiveProcess(&debug, pid)))
+        numThreads = CoreDump_FreezeProcess(debug, threadIds);
+
+    u32 numSegments = CoreDump_GetSegments(processHandle, segments);
+
+    // Layout: ELF header, program headers, notes, then page-aligned segment data
+    ElfHeader *ehdr = (ElfHeader *)hdrBuf;
+    ElfProgramHeader *phdrs = (ElfProgramHeader *)(ehdr + 1);
+    u8 *notes = (u8 *)(phdrs + 1 + numSegments);
+    u8 *notesEnd = notes;
+
+    for (u32 i = 0; i < numThreads && (u32)(notesEnd - hdrBuf) < COREDUMP_HDR_BUF_SIZE - 0x200; i++)
+        notesEnd = CoreDump_AddThreadNotes(notesEnd, debug, threadIds[i], i == 0);
+
+    u32 hdrSize = notesEnd - hdrBuf;
+    u32 offset = (hdrSize + 0xFFF) & ~0xFFF;
+
+    memset(ehdr, 0, sizeof(ElfHeader));
+    memcpy(ehdr->e_ident, "\x7F" "ELF\x01\x01\x01", 7); // 32-bit, little endian, version 1
+    ehdr->e_type = 4; // ET_CORE
+    ehdr->e_machine = 40; // EM_ARM
+    ehdr->e_version = 1;
+    ehdr->e_phoff = sizeof(ElfHeader);
+    ehdr->e_ehsize = sizeof(ElfHeader);
+    ehdr->e_phentsize = sizeof(ElfProgramHeader);
+    ehdr->e_phnum = 1 + numSegments;
+
+    memset(phdrs, 0, (1 + numSegments) * sizeof(ElfProgramHeader));
+    phdrs[0].p_type = ELF_PT_NOTE;
+    phdrs[0].p_offset = notes - hdrBuf;
+    phdrs[0].p_filesz = notesEnd - notes;
+    phdrs[0].p_align = 4;
+
+    for (u32 i = 0; i < numSegments; i++)
+    {
+        ElfProgramHeader *ph = &phdrs[1 + i];
+        ph->p_type = ELF_PT_LOAD;
+        ph->p_offset = offset;
+        ph->p_vaddr = segments[i].addr;
+        ph->p_filesz = ph->p_memsz = segments[i].size;
+        // MEMPERM_READ/WRITE/EXECUTE are 1/2/4, PF_R/W/X are 4/2/1
+        ph->p_flags = ((segments[i].perm & MEMPERM_READ) ? 4 : 0) | ((segments[i].perm & MEMPERM_WRITE) ? 2 : 0) | ((segments[i].perm & MEMPERM_EXECUTE) ? 1 : 0);
+        ph->p_align = 0x1000;
+        offset += segments[i].size;
+    }
+
+    res = CoreDump_OpenFile(&w, name);
+    if (R_SUCCEEDED(res))
+    {
+        if (compress)
+        {
+            u64 total;
+            const u32 fileHeader[3] = { COREDUMP_LZ4C_MAGIC, 1, COREDUMP_LZ4C_BLOCK_SIZE };
+            res = IFile_Write(&w.file, &total, fileHeader, sizeof(fileHeader), 0);
+            w.fileSize += sizeof(fileHeader);
+        }
+
+        if (R_SUCCEEDED(res))
+            res = CoreDump_Write(&w, hdrBuf, hdrSize);
+        if (R_SUCCEEDED(res))
+            res = CoreDump_WriteZeros(&w, ((hdrSize + 0xFFF) & ~0xFFF) - hdrSize);
+
+        for (u32 i = 0; i < numSegments && R_SUCCEEDED(res); i++)
+            res = CoreDump_WriteSegment(&w, processHandle, &segments[i]);
+
+        Result res2 = CoreDump_Finish(&w);
+        res = R_SUCCEEDED(res) ? res2 : res;
+        IFile_Close(&w.file);
+    }
+
+    if (debug != 0)
+        CoreDump_ResumeProcess(debug);
+
+    svcControlMemory(&heap, COREDUMP_HEAP_ADDR, 0, COREDUMP_HEAP_SIZE, MEMOP_FREE, 0);
+    svcCloseHandle(processHandle);
+
+    stats->numSegments = numSegments;
+    stats->numThreads = numThreads;
+    stats->rawSize = w.rawSize;
+    stats->fileSize = w.fileSize;
+    stats->elapsedMs = (u32)(1000 * (svcGetSystemTick() - startTick) / SYSCLOCK_ARM11);
+
+    return res;
+}
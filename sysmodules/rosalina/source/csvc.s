@@ -58,6 +58,14 @@ SVC_BEGIN svcInvalidateEntireInstructionCache
     bx lr
 SVC_END
 
+SVC_BEGIN svcConvertVARangeToPA
+    str r4, [sp, #-4]!
+    ldr r4, [sp, #4]
+    svc 0x95
+    ldr r4, [sp], #4
+    bx lr
+SVC_END
+
 SVC_BEGIN svcMapProcessMemoryEx
     str r4, [sp, #-4]!
     ldr r4, [sp, #4]
@@ -119,6 +119,72 @@ u32 Draw_DrawFormattedString(u32 posX, u32 posY, u32 color, const char *fmt, ...
     return Draw_DrawString(posX, posY, color, buf);
 }
 
+static inline void Draw_WritePixelToScreen(u8 *dst, u32 color, GSPGPU_FramebufferFormat format)
+{
+    u32 red = (color >> 11) & 0x1F, green = (color >> 5) & 0x3F, blue = color & 0x1F;
+
+    switch(format)
+    {
+        case GSP_RGBA8_OES:
+            *(u32 *)dst = ((red << 3) | (red >> 2)) << 24 | ((green << 2) | (green >> 4)) << 16 | ((blue << 3) | (blue >> 2)) << 8 | 0xFF;
+            break;
+        case GSP_BGR8_OES:
+            dst[0] = (blue << 3) | (blue >> 2);
+            dst[1] = (green << 2) | (green >> 4);
+            dst[2] = (red << 3) | (red >> 2);
+            break;
+        case GSP_RGB565_OES:
+            *(u16 *)dst = color;
+            break;
+        case GSP_RGB5_A1_OES:
+            *(u16 *)dst = red << 11 | (green >> 1) << 6 | blue << 1 | 1;
+            break;
+        case GSP_RGBA4_OES:
+            *(u16 *)dst = (red >> 1) << 12 | (green >> 2) << 8 | (blue >> 1) << 4 | 0xF;
+            break;
+        default: break;
+    }
+}
+
+u32 Draw_DrawStringOnScreen(bool top, u32 posX, u32 posY, u32 color, const char *string)
+{
+    static const u8 formatSizes[] = { 4, 3, 2, 2, 2, 0, 0, 0 };
+
+    // Unlike Draw_GetCurrentFramebufferAddress, use the framebuffer select register of the screen
+    u32 pa;
+    if(top)
+        pa = (GPU_FB_TOP_SEL & 1) ? GPU_FB_TOP_LEFT_ADDR_2 : GPU_FB_TOP_LEFT_ADDR_1;
+    else
+        pa = (GPU_FB_BOTTOM_SEL & 1) ? GPU_FB_BOTTOM_ADDR_2 : GPU_FB_BOTTOM_ADDR_1;
+
+    GSPGPU_FramebufferFormat format = (GSPGPU_FramebufferFormat)((top ? GPU_FB_TOP_FMT : GPU_FB_BOTTOM_FMT) & 7);
+    u32 stride = top ? GPU_FB_TOP_STRIDE : GPU_FB_BOTTOM_STRIDE;
+    u32 pixelSize = formatSizes[format];
+    u32 width;
+    bool is3d;
+
+    Draw_GetCurrentScreenInfo(&width, &is3d, top);
+    if(pa == 0 || pixelSize == 0 || posY + 10 > SCREEN_BOT_HEIGHT)
+        return posY;
+
+    // Physical memory is mapped uncached, no need to flush anything
+    u8 *fb = (u8 *)PA_PTR(pa);
+    for(u32 i = 0; string[i] != '\0' && posX + SPACING_X <= width; i++, posX += SPACING_X)
+    {
+        for(u32 y = 0; y < 10; y++)
+        {
+            char charPos = font[(u8)string[i] * 10 + y];
+            for(u32 x = 0; x < 6; x++)
+            {
+                u8 *dst = fb + (posX + x) * stride + (SCREEN_BOT_HEIGHT - posY - y - 1) * pixelSize;
+                Draw_WritePixelToScreen(dst, ((charPos >> (6 - x)) & 1) ? color : COLOR_BLACK, format);
+            }
+        }
+    }
+
+    return posY;
+}
+
 void Draw_FillFramebuffer(u32 value)
 {
     memset(FB_BOTTOM_VRAM_ADDR, value, FB_BOTTOM_SIZE);
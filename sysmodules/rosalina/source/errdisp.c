@@ -26,6 +26,7 @@
 
 #include <3ds.h>
 #include "errdisp.h"
+#include "minidump.h"
 #include "draw.h"
 #include "menu.h"
 #include "memory.h"
@@ -284,6 +285,11 @@ static Result ERRF_SaveErrorToFile(ERRF_FatalErrInfo *info)
     n += sprintf(buf + n, "-------------------------------------\n\n");
 
     archiveId = isSdMode ? ARCHIVE_SDMC : ARCHIVE_NAND_RW;
+
+    // Log-only errors aren't crashes, they shouldn't push dumps out of the ring
+    if(info->type != ERRF_ERRTYPE_LOG_ONLY && info->type != ERRF_ERRTYPE_NAND_DAMAGED)
+        MiniDump_Write(archiveId, info, userString);
+
     res = IFile_Open(&file, archiveId, fsMakePath(PATH_EMPTY, ""), fsMakePath(PATH_ASCII, "/luma/errdisp.txt"), FS_OPEN_WRITE | FS_OPEN_CREATE);
 
     if(R_FAILED(res))
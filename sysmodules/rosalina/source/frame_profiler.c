@@ -0,0 +1,237 @@
+/*
+*   This file is part of Luma3DS
+*   Copyright (C) 2016-2022 Aurora Wright, TuxSH
+*
+*   This program is free software: you can redistribute it and/or modify
+*   it under the terms of the GNU General Public License as published by
+*   the Free Software Foundation, either version 3 of the License, or
+*   (at your option) any later version.
+*
+*   This program is distributed in the hope that it will be useful,
+*   but WITHOUT ANY WARRANTY; without even the implied warranty of
+*   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*   GNU General Public License for more details.
+*
+*   You should have received a copy of the GNU General Public License
+*   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*
+*   Additional Terms 7.b and 7.c of GPLv3 apply to this file:
+*       * Requiring preservation of specified reasonable legal notices or
+*         author attributions in that material or in the Appropriate Legal
+*         Notices displayed by works containing it.
+*       * Prohibiting misrepresentation of the origin of that material,
+*         or requiring that modified versions of such material be marked in
+*         reasonable ways as different from the original version.
+*/
+
+#include <3ds.h>
+#include "frame_profiler.h"
+#include "MyThread.h"
+#include "draw.h"
+#include "fmt.h"
+#include "ifile.h"
+#include "menu.h"
+#include "pmdbgext.h"
+
+bool frameProfilerEnabled = false;
+bool frameProfilerOverlayEnabled = true;
+
+static MyThread frameProfilerThread;
+static u8 CTR_ALIGN(8) frameProfilerThreadStack[0x1000];
+
+static FrameStats frameStats[FRAME_PROFILER_NUM_SCREENS];
+static char overlayText[FRAME_PROFILER_NUM_SCREENS][64];
+static u64 profiledTitleId;
+static char csvBuf[0x2000];
+
+static u64 FrameProfiler_GetTimeUs(void)
+{
+    u64 tick = svcGetSystemTick();
+    return tick / SYSCLOCK_ARM11 * 1000000 + tick % SYSCLOCK_ARM11 * 1000000 / SYSCLOCK_ARM11;
+}
+
+// Changes whenever GSP swaps the framebuffers of the screen, even if the application keeps reusing the same address
+static u32 FrameProfiler_GetFramebufferKey(FrameProfilerScreen screen)
+{
+    if (screen == FRAME_PROFILER_SCREEN_TOP)
+        return (GPU_FB_TOP_SEL & 1) ? GPU_FB_TOP_LEFT_ADDR_2 | 1 : GPU_FB_TOP_LEFT_ADDR_1;
+    else
+        return (GPU_FB_BOTTOM_SEL & 1) ? GPU_FB_BOTTOM_ADDR_2 | 1 : GPU_FB_BOTTOM_ADDR_1;
+}
+
+static void FrameProfiler_UpdateOverlayText(void)
+{
+    static const char screenNames[] = { 'T', 'B' };
+    FrameStatsSummary summary;
+
+    for (u32 i = 0; i < FRAME_PROFILER_NUM_SCREENS; i++)
+    {
+        FrameStats_GetSummary(&frameStats[i], &summary);
+        sprintf(overlayText[i], "%c %3lu.%lu fps  1%% %3lu.%lu  .1%% %3lu.%lu  max %3lu.%lu ms", screenNames[i],
+            summary.fpsX100 / 100, summary.fpsX100 / 10 % 10, summary.low1FpsX100 / 100, summary.low1FpsX100 / 10 % 10,
+            summary.low01FpsX100 / 100, summary.low01FpsX100 / 10 % 10, summary.maxFrameUs / 1000, summary.maxFrameUs / 100 % 10);
+    }
+}
+
+static void FrameProfiler_ThreadMain(void)
+{
+    u32 lastKeys[FRAME_PROFILER_NUM_SCREENS] = { 0 };
+    u32 numTopFrames = 0;
+    bool keysKnown = false;
+
+    while (frameProfilerEnabled && !preTerminationRequested)
+    {
+        svcSleepThread(FRAME_PROFILER_POLL_PERIOD_US * 1000LL);
+
+        // The menu pauses the application and takes the bottom screen over
+        if (rosalinaOpen)
+        {
+            for (u32 i = 0; i < FRAME_PROFILER_NUM_SCREENS; i++)
+                FrameStats_Break(&frameStats[i]);
+            keysKnown = false;
+            continue;
+        }
+
+        u64 timeUs = FrameProfiler_GetTimeUs();
+        bool topSwapped = false;
+
+        for (u32 i = 0; i < FRAME_PROFILER_NUM_SCREENS; i++)
+        {
+            u32 key = FrameProfiler_GetFramebufferKey((FrameProfilerScreen)i);
+            if (keysKnown && key != lastKeys[i])
+            {
+                FrameStats_AddSwap(&frameStats[i], timeUs);
+                topSwapped = topSwapped || i == FRAME_PROFILER_SCREEN_TOP;
+            }
+            lastKeys[i] = key;
+        }
+        keysKnown = true;
+
+        // Draw over the framebuffer that has just been displayed, the application is now rendering to the other one
+        if (topSwapped && frameProfilerOverlayEnabled)
+        {
+            if (numTopFrames++ % FRAME_PROFILER_SUMMARY_PERIOD == 0)
+                FrameProfiler_UpdateOverlayText();
+
+            for (u32 i = 0; i < FRAME_PROFILER_NUM_SCREENS; i++)
+                Draw_DrawStringOnScreen(true, 2, 2 + i * SPACING_Y, COLOR_WHITE, overlayText[i]);
+        }
+    }
+
+    frameProfilerEnabled = false;
+}
+
+Result FrameProfiler_Start(void)
+{
+    FS_ProgramInfo progInfo;
+    u32 pid, launchFlags;
+    Result res = FrameProfiler_Stop(1000 * 1000 * 1000LL);
+
+    if (R_FAILED(res))
+        return res;
+
+    // Whatever is on screen gets profiled, but name the exports after the running application
+    profiledTitleId = R_SUCCEEDED(PMDBG_GetCurrentAppInfo(&progInfo, &pid, &launchFlags)) ? progInfo.programId : 0;
+
+    for (u32 i = 0; i < FRAME_PROFILER_NUM_SCREENS; i++)
+    {
+        FrameStats_Init(&frameStats[i], FRAME_PROFILER_VBLANK_PERIOD_US);
+        sprintf(overlayText[i], "%c waiting for frames", i == FRAME_PROFILER_SCREEN_TOP ? 'T' : 'B');
+    }
+
+    frameProfilerEnabled = true;
+    if (R_FAILED(MyThread_Create(&frameProfilerThread, FrameProfiler_ThreadMain, frameProfilerThreadStack, sizeof(frameProfilerThreadStack), 0x20, CORE_SYSTEM)))
+        svcBreak(USERBREAK_PANIC);
+
+    return 0;
+}
+
+Result FrameProfiler_Stop(s64 timeout)
+{
+    if (frameProfilerThread.handle == 0)
+        return 0;
+
+    frameProfilerEnabled = false;
+    return MyThread_Join(&frameProfilerThread, timeout);
+}
+
+void FrameProfiler_GetStats(FrameProfilerScreen screen, FrameStats *stats)
+{
+    *stats = frameStats[screen];
+}
+
+static char *FrameProfiler_FormatMs(char *out, u32 us)
+{
+    sprintf(out, "%lu.%03lu", us / 1000, us % 1000);
+    return out;
+}
+
+static char *FrameProfiler_FormatFps(char *out, u32 fpsX100)
+{
+    sprintf(out, "%lu.%02lu", fpsX100 / 100, fpsX100 % 100);
+    return out;
+}
+
+static u32 FrameProfiler_FormatCsv(void)
+{
+    static const char *screenNames[] = { "top", "bottom" };
+    char *p = csvBuf;
+    char a[16], b[16], c[16], d[16], e[16], f[16], g[16];
+
+    p += sprintf(p, "screen,frames,duration_ms,avg_fps,window_frames,window_fps,low_1pct_fps,low_0.1pct_fps,min_frame_ms,max_frame_ms,jitter_ms\n");
+    for (u32 i = 0; i < FRAME_PROFILER_NUM_SCREENS; i++)
+    {
+        const FrameStats *stats = &frameStats[i];
+        FrameStatsSummary summary;
+        u32 avgFpsX100 = stats->totalUs == 0 ? 0 : (u32)(100000000ULL * stats->numFrames / stats->totalUs);
+
+        FrameStats_GetSummary(stats, &summary);
+        p += sprintf(p, "%s,%lu,%llu,%s,%lu,%s,%s,%s,%s,%s,%s\n", screenNames[i], stats->numFrames, stats->totalUs / 1000,
+            FrameProfiler_FormatFps(a, avgFpsX100), summary.numFrames, FrameProfiler_FormatFps(b, summary.fpsX100),
+            FrameProfiler_FormatFps(c, summary.low1FpsX100), FrameProfiler_FormatFps(d, summary.low01FpsX100),
+            FrameProfiler_FormatMs(e, stats->numFrames == 0 ? 0 : stats->minFrameUs), FrameProfiler_FormatMs(f, stats->maxFrameUs),
+            FrameProfiler_FormatMs(g, summary.jitterUs));
+    }
+
+    p += sprintf(p, "\nframe_time_ms,top,bottom\n");
+    for (u32 i = 0; i < FRAMESTATS_HISTOGRAM_BINS; i++)
+        p += sprintf(p, "%lu%s,%lu,%lu\n", i, i == FRAMESTATS_HISTOGRAM_BINS - 1 ? "+" : "", frameStats[0].histogram[i], frameStats[1].histogram[i]);
+
+    p += sprintf(p, "\nvblanks,top,bottom\n");
+    for (u32 i = 0; i <= FRAMESTATS_MAX_VBLANKS; i++)
+        p += sprintf(p, "%lu%s,%lu,%lu\n", i, i == FRAMESTATS_MAX_VBLANKS ? "+" : "", frameStats[0].vblankHistogram[i], frameStats[1].vblankHistogram[i]);
+
+    return (u32)(p - csvBuf);
+}
+
+Result FrameProfiler_ExportCsv(char *path)
+{
+    char dateTimeStr[32];
+    FS_Archive archive;
+    IFile file;
+    u64 total;
+
+    if (frameStats[FRAME_PROFILER_SCREEN_TOP].vblankPeriodUs == 0)
+        return FRAME_PROFILER_ERR_NOT_STARTED;
+
+    if (R_SUCCEEDED(FSUSER_OpenArchive(&archive, ARCHIVE_SDMC, fsMakePath(PATH_EMPTY, ""))))
+    {
+        FSUSER_CreateDirectory(archive, fsMakePath(PATH_ASCII, "/luma/frameprof"), 0);
+        FSUSER_CloseArchive(archive);
+    }
+
+    dateTimeToString(dateTimeStr, osGetTime(), true);
+    sprintf(path, "/luma/frameprof/%016llX_%s.csv", profiledTitleId, dateTimeStr);
+
+    Result res = IFile_Open(&file, ARCHIVE_SDMC, fsMakePath(PATH_EMPTY, ""), fsMakePath(PATH_ASCII, path), FS_OPEN_CREATE | FS_OPEN_WRITE);
+    if (R_FAILED(res))
+        return res;
+
+    u32 size = FrameProfiler_FormatCsv();
+    res = IFile_Write(&file, &total, csvBuf, size, 0);
+    if (R_SUCCEEDED(res))
+        res = IFile_SetSize(&file, size);
+
+    IFile_Close(&file);
+    return res;
+}
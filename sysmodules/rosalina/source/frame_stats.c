@@ -0,0 +1,137 @@
+/*
+*   This file is part of Luma3DS
+*   Copyright (C) 2016-2022 Aurora Wright, TuxSH
+*
+*   This program is free software: you can redistribute it and/or modify
+*   it under the terms of the GNU General Public License as published by
+*   the Free Software Foundation, either version 3 of the License, or
+*   (at your option) any later version.
+*
+*   This program is distributed in the hope that it will be useful,
+*   but WITHOUT ANY WARRANTY; without even the implied warranty of
+*   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*   GNU General Public License for more details.
+*
+*   You should have received a copy of the GNU General Public License
+*   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*
+*   Additional Terms 7.b and 7.c of GPLv3 apply to this file:
+*       * Requiring preservation of specified reasonable legal notices or
+*         author attributions in that material or in the Appropriate Legal
+*         Notices displayed by works containing it.
+*       * Prohibiting misrepresentation of the origin of that material,
+*         or requiring that modified versions of such material be marked in
+*         reasonable ways as different from the original version.
+*/
+
+#include <string.h>
+#include "frame_stats.h"
+
+void FrameStats_Init(FrameStats *stats, u32 vblankPeriodUs)
+{
+    memset(stats, 0, sizeof(FrameStats));
+    stats->vblankPeriodUs = vblankPeriodUs;
+    stats->minFrameUs = 0xFFFFFFFF;
+}
+
+void FrameStats_AddSwap(FrameStats *stats, u64 timeUs)
+{
+    bool hadLastSwap = stats->hasLastSwap;
+    u64 lastSwapUs = stats->lastSwapUs;
+
+    stats->hasLastSwap = true;
+    stats->lastSwapUs = timeUs;
+    if (!hadLastSwap || timeUs <= lastSwapUs)
+        return;
+
+    u32 frameUs = timeUs - lastSwapUs > 0xFFFFFFFF ? 0xFFFFFFFF : (u32)(timeUs - lastSwapUs);
+    u32 *slot = &stats->frameTimes[(stats->windowHead + stats->windowCount) % FRAMESTATS_WINDOW_SIZE];
+
+    if (stats->windowCount == FRAMESTATS_WINDOW_SIZE)
+    {
+        stats->windowSumUs -= *slot;
+        stats->windowHead = (stats->windowHead + 1) % FRAMESTATS_WINDOW_SIZE;
+    }
+    else
+        stats->windowCount++;
+
+    *slot = frameUs;
+    stats->windowSumUs += frameUs;
+
+    stats->numFrames++;
+    stats->totalUs += frameUs;
+    stats->minFrameUs = frameUs < stats->minFrameUs ? frameUs : stats->minFrameUs;
+    stats->maxFrameUs = frameUs > stats->maxFrameUs ? frameUs : stats->maxFrameUs;
+    stats->histogram[frameUs / 1000 < FRAMESTATS_HISTOGRAM_BINS ? frameUs / 1000 : FRAMESTATS_HISTOGRAM_BINS - 1]++;
+
+    u32 vblanks = ((u64)frameUs + stats->vblankPeriodUs / 2) / stats->vblankPeriodUs;
+    stats->vblankHistogram[vblanks < FRAMESTATS_MAX_VBLANKS ? vblanks : FRAMESTATS_MAX_VBLANKS]++;
+}
+
+void FrameStats_Break(FrameStats *stats)
+{
+    stats->hasLastSwap = false;
+}
+
+static inline u32 FrameStats_GetWindowFrame(const FrameStats *stats, u32 i)
+{
+    return stats->frameTimes[(stats->windowHead + i) % FRAMESTATS_WINDOW_SIZE];
+}
+
+// Frame rate of the average of the numLow longest frame times, numLow being at most FRAMESTATS_MAX_LOW_FRAMES
+static u32 FrameStats_GetLowFpsX100(const FrameStats *stats, u32 numLow)
+{
+    u32 longest[FRAMESTATS_MAX_LOW_FRAMES]; // Sorted, longest first
+    u32 n = 0;
+    u64 sum = 0;
+
+    for (u32 i = 0; i < stats->windowCount; i++)
+    {
+        u32 frameUs = FrameStats_GetWindowFrame(stats, i);
+        u32 pos = n < numLow ? n++ : numLow;
+
+        for (; pos > 0 && longest[pos - 1] < frameUs; pos--)
+        {
+            if (pos < numLow)
+                longest[pos] = longest[pos - 1];
+        }
+
+        if (pos < numLow)
+            longest[pos] = frameUs;
+    }
+
+    for (u32 i = 0; i < n; i++)
+        sum += longest[i];
+
+    return sum == 0 ? 0 : (u32)(100000000ULL * n / sum);
+}
+
+void FrameStats_GetSummary(const FrameStats *stats, FrameStatsSummary *summary)
+{
+    u32 n = stats->windowCount;
+    u64 jitterSum = 0;
+
+    memset(summary, 0, sizeof(FrameStatsSummary));
+    if (n == 0)
+        return;
+
+    summary->numFrames = n;
+    summary->avgFrameUs = (u32)(stats->windowSumUs / n);
+    summary->fpsX100 = stats->windowSumUs == 0 ? 0 : (u32)(100000000ULL * n / stats->windowSumUs);
+    summary->low1FpsX100 = FrameStats_GetLowFpsX100(stats, n / 100 > 1 ? n / 100 : 1);
+    summary->low01FpsX100 = FrameStats_GetLowFpsX100(stats, n / 1000 > 1 ? n / 1000 : 1);
+
+    for (u32 i = 0; i < n; i++)
+    {
+        u32 frameUs = FrameStats_GetWindowFrame(stats, i);
+        summary->maxFrameUs = frameUs > summary->maxFrameUs ? frameUs : summary->maxFrameUs;
+
+        if (i != 0)
+        {
+            u32 prevUs = FrameStats_GetWindowFrame(stats, i - 1);
+            jitterSum += frameUs > prevUs ? frameUs - prevUs : prevUs - frameUs;
+        }
+    }
+
+    summary->jitterUs = n > 1 ? (u32)(jitterSum / (n - 1)) : 0;
+}
@@ -14,6 +14,8 @@
 #include "gdb/watchpoints.h"
 #include "gdb/breakpoints.h"
 #include "gdb/stop_point.h"
+#include "gdb/tracepoints.h"
+#include "gdb/non_stop.h"
 
 void GDB_InitializeContext(GDBContext *ctx)
 {
@@ -103,6 +105,9 @@ Result GDB_AttachToProcess(GDBContext *ctx)
 void GDB_DetachFromProcess(GDBContext *ctx)
 {
     DebugEventInfo dummy;
+    GDB_ResumeAllThreads(ctx);
+    GDB_CancelBreakpointStepOver(ctx);
+    GDB_FinalizeTrace(ctx);
     for(u32 i = 0; i < ctx->nbBreakpoints; i++)
     {
         if(!ctx->breakpoints[i].persistent)
@@ -110,6 +115,7 @@ void GDB_DetachFromProcess(GDBContext *ctx)
     }
     memset(&ctx->breakpoints, 0, sizeof(ctx->breakpoints));
     ctx->nbBreakpoints = 0;
+    ctx->breakpointConditionsSize = 0;
 
     for(u32 i = 0; i < ctx->nbWatchpoints; i++)
     {
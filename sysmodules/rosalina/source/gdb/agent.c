@@ -0,0 +1,362 @@
+/*
+*   This file is part of Luma3DS.
+*   Copyright (C) 2016-2020 Aurora Wright, TuxSH
+*
+*   SPDX-License-Identifier: (MIT OR GPL-2.0-or-later)
+*/
+
+
+#include "gdb/agent.h"
+
+#define _REENT_ONLY
+#include <errno.h>
+#include <string.h>
+
+typedef struct GDBAgentOpInfo
+{
+    u8 operandSize;
+    u8 pops;
+    u8 pushes;
+    bool supported;
+} GDBAgentOpInfo;
+
+#define GDB_AGENT_OP(name, operandSize, pops, pushes) [GDB_AGENT_OP_##name] = { operandSize, pops, pushes, true }
+
+// Floating-point and printf opcodes aren't supported
+static const GDBAgentOpInfo opInfos[GDB_AGENT_OP_PRINTF + 1] =
+{
+    GDB_AGENT_OP(ADD, 0, 2, 1),
+    GDB_AGENT_OP(SUB, 0, 2, 1),
+    GDB_AGENT_OP(MUL, 0, 2, 1),
+    GDB_AGENT_OP(DIV_SIGNED, 0, 2, 1),
+    GDB_AGENT_OP(DIV_UNSIGNED, 0, 2, 1),
+    GDB_AGENT_OP(REM_SIGNED, 0, 2, 1),
+    GDB_AGENT_OP(REM_UNSIGNED, 0, 2, 1),
+    GDB_AGENT_OP(LSH, 0, 2, 1),
+    GDB_AGENT_OP(RSH_SIGNED, 0, 2, 1),
+    GDB_AGENT_OP(RSH_UNSIGNED, 0, 2, 1),
+    GDB_AGENT_OP(LOG_NOT, 0, 1, 1),
+    GDB_AGENT_OP(BIT_AND, 0, 2, 1),
+    GDB_AGENT_OP(BIT_OR, 0, 2, 1),
+    GDB_AGENT_OP(BIT_XOR, 0, 2, 1),
+    GDB_AGENT_OP(BIT_NOT, 0, 1, 1),
+    GDB_AGENT_OP(EQUAL, 0, 2, 1),
+    GDB_AGENT_OP(LESS_SIGNED, 0, 2, 1),
+    GDB_AGENT_OP(LESS_UNSIGNED, 0, 2, 1),
+    GDB_AGENT_OP(EXT, 1, 1, 1),
+    GDB_AGENT_OP(REF8, 0, 1, 1),
+    GDB_AGENT_OP(REF16, 0, 1, 1),
+    GDB_AGENT_OP(REF32, 0, 1, 1),
+    GDB_AGENT_OP(REF64, 0, 1, 1),
+    GDB_AGENT_OP(IF_GOTO, 2, 1, 0),
+    GDB_AGENT_OP(GOTO, 2, 0, 0),
+    GDB_AGENT_OP(CONST8, 1, 0, 1),
+    GDB_AGENT_OP(CONST16, 2, 0, 1),
+    GDB_AGENT_OP(CONST32, 4, 0, 1),
+    GDB_AGENT_OP(CONST64, 8, 0, 1),
+    GDB_AGENT_OP(REG, 2, 0, 1),
+    GDB_AGENT_OP(END, 0, 0, 0),
+    GDB_AGENT_OP(DUP, 0, 1, 2),
+    GDB_AGENT_OP(POP, 0, 1, 0),
+    GDB_AGENT_OP(ZERO_EXT, 1, 1, 1),
+    GDB_AGENT_OP(SWAP, 0, 2, 2),
+    GDB_AGENT_OP(PICK, 1, 0, 1),
+    GDB_AGENT_OP(ROT, 0, 3, 3),
+    GDB_AGENT_OP(TRACE, 0, 2, 0),
+    GDB_AGENT_OP(TRACE_QUICK, 1, 1, 1),
+    GDB_AGENT_OP(TRACE16, 2, 1, 1),
+    GDB_AGENT_OP(TRACENZ, 0, 2, 0),
+    GDB_AGENT_OP(GETV, 2, 0, 1),
+    GDB_AGENT_OP(SETV, 2, 1, 1),
+    GDB_AGENT_OP(TRACEV, 2, 0, 0),
+};
+
+// Valid opcodes that are rejected anyway
+static bool GDB_AgentIsUnsupportedOpcode(u8 op)
+{
+    switch(op)
+    {
+        case GDB_AGENT_OP_FLOAT:
+        case GDB_AGENT_OP_REF_FLOAT:
+        case GDB_AGENT_OP_REF_DOUBLE:
+        case GDB_AGENT_OP_REF_LONG_DOUBLE:
+        case GDB_AGENT_OP_L_TO_D:
+        case GDB_AGENT_OP_D_TO_L:
+        case GDB_AGENT_OP_PRINTF:
+            return true;
+        default:
+            return false;
+    }
+}
+
+static inline u64 GDB_AgentReadOperand(const u8 *operand, u32 size)
+{
+    u64 val = 0;
+    for(u32 i = 0; i < size; i++)
+        val = (val << 8) | operand[i]; // big-endian
+
+    return val;
+}
+
+static inline bool GDB_AgentSetHeight(s8 *heights, u8 *worklist, u32 *worklistSize, u32 pc, s32 height)
+{
+    if(heights[pc] == -1)
+    {
+        heights[pc] = (s8)height;
+        worklist[(*worklistSize)++] = (u8)pc;
+        return true;
+    }
+    else
+        return heights[pc] == height;
+}
+
+int GDB_AgentVerify(const u8 *bytecode, u32 size)
+{
+    bool isInstruction[GDB_AGENT_MAX_BYTECODE_SIZE] = { false };
+    s8 heights[GDB_AGENT_MAX_BYTECODE_SIZE];
+    u8 worklist[GDB_AGENT_MAX_BYTECODE_SIZE];
+    u32 worklistSize = 0;
+
+    if(size == 0 || size > GDB_AGENT_MAX_BYTECODE_SIZE)
+        return -EINVAL;
+
+    // Decode the instructions linearly first, jumps must land on one of them
+    for(u32 pc = 0; pc < size; pc += 1 + opInfos[bytecode[pc]].operandSize)
+    {
+        u8 op = bytecode[pc];
+        if(op > GDB_AGENT_OP_PRINTF || !opInfos[op].supported)
+            return GDB_AgentIsUnsupportedOpcode(op) ? -ENOTSUP : -EINVAL;
+        else if(pc + 1 + opInfos[op].operandSize > size)
+            return -EINVAL;
+        else if(op == GDB_AGENT_OP_EXT && bytecode[pc + 1] == 0)
+            return -EINVAL;
+
+        isInstruction[pc] = true;
+    }
+
+    // Then follow all paths, tracking the stack height
+    memset(heights, -1, sizeof(heights));
+    GDB_AgentSetHeight(heights, worklist, &worklistSize, 0, 0);
+
+    while(worklistSize > 0)
+    {
+        u32 pc = worklist[--worklistSize];
+        s32 height = heights[pc];
+
+        for(;;)
+        {
+            u8 op = bytecode[pc];
+            const GDBAgentOpInfo *info = &opInfos[op];
+            // Collection bytecode can end with an empty stack, the result is then 0
+            s32 needed = op == GDB_AGENT_OP_PICK ? bytecode[pc + 1] + 1 : info->pops;
+
+            if(height < needed)
+                return -EINVAL;
+
+            height += info->pushes - info->pops;
+            if(height > GDB_AGENT_MAX_STACK_SIZE)
+                return -EINVAL;
+            else if(op == GDB_AGENT_OP_END)
+                break;
+
+            if(op == GDB_AGENT_OP_GOTO || op == GDB_AGENT_OP_IF_GOTO)
+            {
+                u32 target = (u32)GDB_AgentReadOperand(bytecode + pc + 1, 2);
+                if(target >= size || !isInstruction[target] || !GDB_AgentSetHeight(heights, worklist, &worklistSize, target, height))
+                    return -EINVAL;
+                else if(op == GDB_AGENT_OP_GOTO)
+                    break;
+            }
+
+            u32 next = pc + 1 + info->operandSize;
+            if(next >= size) // falling off the end
+                return -EINVAL;
+            else if(heights[next] == -1)
+            {
+                heights[next] = (s8)height;
+                pc = next;
+            }
+            else if(heights[next] != height)
+                return -EINVAL;
+            else
+                break;
+        }
+    }
+
+    return 0;
+}
+
+int GDB_AgentEvaluate(s64 *result, const u8 *bytecode, u32 size, const GDBAgentOps *ops, void *userdata)
+{
+    u64 stack[GDB_AGENT_MAX_STACK_SIZE];
+    u32 sp = 0, pc = 0;
+
+    (void)size; // the verifier made sure we stay in bounds
+
+    for(u32 steps = 0; steps < GDB_AGENT_MAX_STEPS; steps++)
+    {
+        u8 op = bytecode[pc];
+        u32 operandSize = opInfos[op].operandSize;
+        u64 operand = GDB_AgentReadOperand(bytecode + pc + 1, operandSize);
+        u64 a = sp >= 2 ? stack[sp - 2] : 0, b = sp >= 1 ? stack[sp - 1] : 0;
+
+        pc += 1 + operandSize;
+
+        switch(op)
+        {
+            // Binary operators, "a" being the next-to-top item and "b" the top one
+            case GDB_AGENT_OP_ADD:              stack[--sp - 1] = a + b; break;
+            case GDB_AGENT_OP_SUB:              stack[--sp - 1] = a - b; break;
+            case GDB_AGENT_OP_MUL:              stack[--sp - 1] = a * b; break;
+            case GDB_AGENT_OP_BIT_AND:          stack[--sp - 1] = a & b; break;
+            case GDB_AGENT_OP_BIT_OR:           stack[--sp - 1] = a | b; break;
+            case GDB_AGENT_OP_BIT_XOR:          stack[--sp - 1] = a ^ b; break;
+            case GDB_AGENT_OP_EQUAL:            stack[--sp - 1] = a == b; break;
+            case GDB_AGENT_OP_LESS_SIGNED:      stack[--sp - 1] = (s64)a < (s64)b; break;
+            case GDB_AGENT_OP_LESS_UNSIGNED:    stack[--sp - 1] = a < b; break;
+
+            case GDB_AGENT_OP_DIV_SIGNED:
+            case GDB_AGENT_OP_REM_SIGNED:
+            case GDB_AGENT_OP_DIV_UNSIGNED:
+            case GDB_AGENT_OP_REM_UNSIGNED:
+            {
+                if(b == 0)
+                    return -EDOM;
+
+                if(op == GDB_AGENT_OP_DIV_UNSIGNED)
+                    stack[--sp - 1] = a / b;
+                else if(op == GDB_AGENT_OP_REM_UNSIGNED)
+                    stack[--sp - 1] = a % b;
+                else if((s64)b == -1) // avoid the INT64_MIN / -1 trap
+                    stack[--sp - 1] = op == GDB_AGENT_OP_DIV_SIGNED ? -a : 0;
+                else
+                    stack[--sp - 1] = op == GDB_AGENT_OP_DIV_SIGNED ? (u64)((s64)a / (s64)b) : (u64)((s64)a % (s64)b);
+                break;
+            }
+
+            // Shifting by 64 or more bits shifts everything out
+            case GDB_AGENT_OP_LSH:
+                stack[--sp - 1] = b >= 64 ? 0 : a << b;
+                break;
+            case GDB_AGENT_OP_RSH_UNSIGNED:
+                stack[--sp - 1] = b >= 64 ? 0 : a >> b;
+                break;
+            case GDB_AGENT_OP_RSH_SIGNED:
+                stack[--sp - 1] = (u64)((s64)a >> (b >= 64 ? 63 : b));
+                break;
+
+            case GDB_AGENT_OP_LOG_NOT:  stack[sp - 1] = b == 0; break;
+            case GDB_AGENT_OP_BIT_NOT:  stack[sp - 1] = ~b; break;
+
+            case GDB_AGENT_OP_EXT:
+                if(operand < 64)
+                {
+                    u64 sign = 1ull << (operand - 1);
+                    stack[sp - 1] = ((b & ((1ull << operand) - 1)) ^ sign) - sign;
+                }
+                break;
+            case GDB_AGENT_OP_ZERO_EXT:
+                if(operand < 64)
+                    stack[sp - 1] = b & ((1ull << operand) - 1);
+                break;
+
+            case GDB_AGENT_OP_REF8:
+            case GDB_AGENT_OP_REF16:
+            case GDB_AGENT_OP_REF32:
+            case GDB_AGENT_OP_REF64:
+            {
+                u32 refSize = 1 << (op - GDB_AGENT_OP_REF8);
+                u8 buf[8];
+                u64 val = 0;
+
+                if(b > 0xFFFFFFFF || b + refSize - 1 > 0xFFFFFFFF || !ops->readMemory(userdata, buf, (u32)b, refSize))
+                    return -EFAULT;
+
+                for(u32 i = refSize; i > 0; i--)
+                    val = (val << 8) | buf[i - 1]; // little-endian target
+
+                stack[sp - 1] = val;
+                break;
+            }
+
+            case GDB_AGENT_OP_IF_GOTO:
+                if(stack[--sp] != 0)
+                    pc = (u32)operand;
+                break;
+            case GDB_AGENT_OP_GOTO:
+                pc = (u32)operand;
+                break;
+
+            case GDB_AGENT_OP_CONST8:
+            case GDB_AGENT_OP_CONST16:
+            case GDB_AGENT_OP_CONST32:
+            case GDB_AGENT_OP_CONST64:
+                stack[sp++] = operand;
+                break;
+
+            case GDB_AGENT_OP_REG:
+                if(!ops->readRegister(userdata, &stack[sp], (u32)operand))
+                    return -EFAULT;
+                sp++;
+                break;
+
+            case GDB_AGENT_OP_END:
+                *result = (s64)b;
+                return 0;
+
+            case GDB_AGENT_OP_DUP:  stack[sp++] = b; break;
+            case GDB_AGENT_OP_POP:  sp--; break;
+            case GDB_AGENT_OP_SWAP: stack[sp - 1] = a; stack[sp - 2] = b; break;
+            case GDB_AGENT_OP_PICK: stack[sp] = stack[sp - 1 - operand]; sp++; break;
+
+            // a b c => c a b
+            case GDB_AGENT_OP_ROT:
+                stack[sp - 1] = a;
+                stack[sp - 2] = stack[sp - 3];
+                stack[sp - 3] = b;
+                break;
+
+            // Tracing, "addr size" being popped (or "addr" kept for the quick variants)
+            case GDB_AGENT_OP_TRACE:
+            case GDB_AGENT_OP_TRACENZ:
+                if(ops->collectMemory == NULL)
+                    return -ENOTSUP;
+                else if(a > 0xFFFFFFFF || b > 0xFFFFFFFF || !ops->collectMemory(userdata, (u32)a, (u32)b, op == GDB_AGENT_OP_TRACENZ))
+                    return -EFAULT;
+                sp -= 2;
+                break;
+            case GDB_AGENT_OP_TRACE_QUICK:
+            case GDB_AGENT_OP_TRACE16:
+                if(ops->collectMemory == NULL)
+                    return -ENOTSUP;
+                else if(b > 0xFFFFFFFF || !ops->collectMemory(userdata, (u32)b, (u32)operand, false))
+                    return -EFAULT;
+                break;
+
+            case GDB_AGENT_OP_GETV:
+                if(ops->getVariable == NULL)
+                    return -ENOTSUP;
+                else if(!ops->getVariable(userdata, (s64 *)&stack[sp], (u32)operand))
+                    return -EFAULT;
+                sp++;
+                break;
+            case GDB_AGENT_OP_SETV:
+                if(ops->setVariable == NULL)
+                    return -ENOTSUP;
+                else if(!ops->setVariable(userdata, (u32)operand, (s64)b))
+                    return -EFAULT;
+                break;
+            case GDB_AGENT_OP_TRACEV:
+                if(ops->collectVariable == NULL)
+                    return -ENOTSUP;
+                else if(!ops->collectVariable(userdata, (u32)operand))
+                    return -EFAULT;
+                break;
+
+            default: // rejected by the verifier
+                return -ENOTSUP;
+        }
+    }
+
+    return -ETIMEDOUT;
+}
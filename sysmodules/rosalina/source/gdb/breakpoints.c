@@ -6,6 +6,9 @@
 */
 
 #include "gdb/breakpoints.h"
+#include "gdb/agent.h"
+#include "gdb/regs.h"
+#include "gdb/tracepoints.h"
 
 #define _REENT_ONLY
 #include <errno.h>
@@ -47,7 +50,43 @@ int GDB_GetBreakpointInstruction(u32 *instruction, GDBContext *ctx, u32 address)
     return 0;
 }
 
-int GDB_AddBreakpoint(GDBContext *ctx, u32 address, bool thumb, bool persist)
+static void GDB_RemoveBreakpointConditions(GDBContext *ctx, Breakpoint *bkpt)
+{
+    u32 offset = bkpt->conditionsOffset, size = bkpt->conditionsSize;
+    if(size == 0)
+        return;
+
+    memmove(ctx->breakpointConditions + offset, ctx->breakpointConditions + offset + size, ctx->breakpointConditionsSize - offset - size);
+    ctx->breakpointConditionsSize -= size;
+
+    for(u32 i = 0; i < ctx->nbBreakpoints; i++)
+    {
+        if(ctx->breakpoints[i].conditionsOffset > offset)
+            ctx->breakpoints[i].conditionsOffset -= size;
+    }
+
+    bkpt->conditionsOffset = bkpt->conditionsSize = 0;
+}
+
+// Replaces the conditions of the breakpoint (GDB sends them again whenever they change)
+static int GDB_SetBreakpointConditions(GDBContext *ctx, Breakpoint *bkpt, const u8 *conditions, u32 conditionsSize)
+{
+    GDB_RemoveBreakpointConditions(ctx, bkpt);
+
+    if(conditionsSize == 0)
+        return 0;
+    else if(ctx->breakpointConditionsSize + conditionsSize > sizeof(ctx->breakpointConditions))
+        return -ENOSPC;
+
+    memcpy(ctx->breakpointConditions + ctx->breakpointConditionsSize, conditions, conditionsSize);
+    bkpt->conditionsOffset = ctx->breakpointConditionsSize;
+    bkpt->conditionsSize = conditionsSize;
+    ctx->breakpointConditionsSize += conditionsSize;
+
+    return 0;
+}
+
+static int GDB_InsertBreakpoint(GDBContext *ctx, u32 address, bool thumb, u8 user, u32 *outId)
 {
     if(!thumb && (address & 3) != 0)
         return -EINVAL;
@@ -57,7 +96,11 @@ int GDB_AddBreakpoint(GDBContext *ctx, u32 address, bool thumb, bool persist)
     u32 id = GDB_FindClosestBreakpointSlot(ctx, address);
 
     if(id != ctx->nbBreakpoints && ctx->breakpoints[id].instructionSize != 0 && ctx->breakpoints[id].address == address)
+    {
+        ctx->breakpoints[id].users |= user;
+        *outId = id;
         return 0;
+    }
     else if(ctx->nbBreakpoints == MAX_BREAKPOINT)
         return -EBUSY;
 
@@ -78,29 +121,42 @@ int GDB_AddBreakpoint(GDBContext *ctx, u32 address, bool thumb, bool persist)
         return -EFAULT;
     }
 
+    // Don't save the temporary breakpoint of a step-over in progress
+    if(ctx->stepOver.threadId != 0 && ctx->stepOver.target.instructionSize != 0 && ctx->stepOver.target.address == address)
+        bkpt->savedInstruction = ctx->stepOver.target.savedInstruction;
+
     bkpt->instructionSize = thumb ? 2 : 4;
     bkpt->address = address;
-    bkpt->persistent = persist;
+    bkpt->persistent = false;
+    bkpt->users = user;
+    bkpt->conditionsOffset = bkpt->conditionsSize = 0;
 
+    *outId = id;
     return 0;
 }
 
-int GDB_DisableBreakpointById(GDBContext *ctx, u32 id)
-{
-    Breakpoint *bkpt = &ctx->breakpoints[id];
-    if(R_FAILED(svcWriteProcessMemory(ctx->debug, &bkpt->savedInstruction, bkpt->address, bkpt->instructionSize)))
-        return -EFAULT;
-    else return 0;
-}
-
-int GDB_RemoveBreakpoint(GDBContext *ctx, u32 address)
+static int GDB_RemoveBreakpointUser(GDBContext *ctx, u32 address, u8 user)
 {
     address &= ~1;
 
     u32 id = GDB_FindClosestBreakpointSlot(ctx, address);
-    if(id == ctx->nbBreakpoints || ctx->breakpoints[id].address != address)
+    if(id == ctx->nbBreakpoints || ctx->breakpoints[id].address != address || !(ctx->breakpoints[id].users & user))
         return -EINVAL;
 
+    Breakpoint *bkpt = &ctx->breakpoints[id];
+    if(user == BREAKPOINT_USER_GDB)
+    {
+        GDB_RemoveBreakpointConditions(ctx, bkpt);
+        bkpt->persistent = false;
+    }
+
+    // Still used by something else
+    if(bkpt->users != user)
+    {
+        bkpt->users &= ~user;
+        return 0;
+    }
+
     int r = GDB_DisableBreakpointById(ctx, id);
     if(r != 0)
         return r;
@@ -114,3 +170,431 @@ int GDB_RemoveBreakpoint(GDBContext *ctx, u32 address)
         return 0;
     }
 }
+
+int GDB_AddBreakpoint(GDBContext *ctx, u32 address, bool thumb, bool persist, const u8 *conditions, u32 conditionsSize)
+{
+    u32 id;
+    int res = GDB_InsertBreakpoint(ctx, address, thumb, BREAKPOINT_USER_GDB, &id);
+    if(res != 0)
+        return res;
+
+    ctx->breakpoints[id].persistent = persist;
+
+    res = GDB_SetBreakpointConditions(ctx, &ctx->breakpoints[id], conditions, conditionsSize);
+    if(res != 0)
+        GDB_RemoveBreakpointUser(ctx, address, BREAKPOINT_USER_GDB);
+
+    return res;
+}
+
+int GDB_DisableBreakpointById(GDBContext *ctx, u32 id)
+{
+    Breakpoint *bkpt = &ctx->breakpoints[id];
+    if(R_FAILED(svcWriteProcessMemory(ctx->debug, &bkpt->savedInstruction, bkpt->address, bkpt->instructionSize)))
+        return -EFAULT;
+    else return 0;
+}
+
+int GDB_RemoveBreakpoint(GDBContext *ctx, u32 address)
+{
+    return GDB_RemoveBreakpointUser(ctx, address, BREAKPOINT_USER_GDB);
+}
+
+int GDB_AddTracepointBreakpoint(GDBContext *ctx, u32 address, bool thumb)
+{
+    u32 id;
+    return GDB_InsertBreakpoint(ctx, address, thumb, BREAKPOINT_USER_TRACEPOINT, &id);
+}
+
+int GDB_RemoveTracepointBreakpoint(GDBContext *ctx, u32 address)
+{
+    return GDB_RemoveBreakpointUser(ctx, address, BREAKPOINT_USER_TRACEPOINT);
+}
+
+typedef struct BreakpointConditionContext
+{
+    GDBContext *ctx;
+    const ThreadContext *regs;
+} BreakpointConditionContext;
+
+static bool GDB_ConditionReadRegister(void *userdata, u64 *out, u32 gdbRegNum)
+{
+    BreakpointConditionContext *condCtx = (BreakpointConditionContext *)userdata;
+    return GDB_ReadRegisterFromContext(out, condCtx->regs, gdbRegNum) == 0;
+}
+
+static bool GDB_ConditionReadMemory(void *userdata, void *out, u32 address, u32 size)
+{
+    BreakpointConditionContext *condCtx = (BreakpointConditionContext *)userdata;
+    return R_SUCCEEDED(svcReadProcessMemory(out, condCtx->ctx->debug, address, size));
+}
+
+static bool GDB_ConditionGetVariable(void *userdata, s64 *out, u32 id)
+{
+    BreakpointConditionContext *condCtx = (BreakpointConditionContext *)userdata;
+    return GDB_GetTraceStateVariable(condCtx->ctx, out, id);
+}
+
+static bool GDB_ConditionSetVariable(void *userdata, u32 id, s64 value)
+{
+    BreakpointConditionContext *condCtx = (BreakpointConditionContext *)userdata;
+    return GDB_SetTraceStateVariable(condCtx->ctx, id, value);
+}
+
+// The breakpoint is reported if any of its conditions is true, or can't be evaluated (like gdbserver)
+static bool GDB_EvaluateBreakpointConditions(GDBContext *ctx, const Breakpoint *bkpt, const ThreadContext *regs)
+{
+    static const GDBAgentOps ops = { GDB_ConditionReadRegister, GDB_ConditionReadMemory, GDB_ConditionGetVariable, GDB_ConditionSetVariable, NULL, NULL };
+    BreakpointConditionContext condCtx = { ctx, regs };
+    const u8 *conditions = ctx->breakpointConditions + bkpt->conditionsOffset;
+
+    for(u32 pos = 0; pos < bkpt->conditionsSize;)
+    {
+        u32 size = conditions[pos] | (conditions[pos + 1] << 8);
+        s64 value;
+
+        if(GDB_AgentEvaluate(&value, conditions + pos + 2, size, &ops, &condCtx) != 0 || value != 0)
+            return true;
+
+        pos += 2 + size;
+    }
+
+    return false;
+}
+
+static bool GDB_ConditionPassed(u32 cond, u32 cpsr)
+{
+    bool n = (cpsr >> 31) & 1, z = (cpsr >> 30) & 1, c = (cpsr >> 29) & 1, v = (cpsr >> 28) & 1;
+    bool res;
+
+    switch(cond >> 1)
+    {
+        case 0: res = z; break;                 // EQ, NE
+        case 1: res = c; break;                 // CS, CC
+        case 2: res = n; break;                 // MI, PL
+        case 3: res = v; break;                 // VS, VC
+        case 4: res = c && !z; break;           // HI, LS
+        case 5: res = n == v; break;            // GE, LT
+        case 6: res = !z && n == v; break;      // GT, LE
+        default: return true;                   // AL
+    }
+
+    return (cond & 1) ? !res : res;
+}
+
+static inline u32 GDB_GetRegisterForStep(const ThreadContext *regs, u32 n, u32 pcValue)
+{
+    switch(n)
+    {
+        case 13: return regs->cpu_registers.sp;
+        case 14: return regs->cpu_registers.lr;
+        case 15: return pcValue;
+        default: return regs->cpu_registers.r[n];
+    }
+}
+
+static inline u32 GDB_SignExtend(u32 val, u32 bits)
+{
+    return (u32)((s32)(val << (32 - bits)) >> (32 - bits));
+}
+
+// Reads an instruction of the process, as it was before we put breakpoints on it
+static bool GDB_ReadOriginalInstruction(GDBContext *ctx, u32 *instr, u32 address, u32 size)
+{
+    *instr = 0;
+    if(R_FAILED(svcReadProcessMemory(instr, ctx->debug, address, size)))
+        return false;
+
+    if(*instr == (size == 2 ? BREAKPOINT_INSTRUCTION_THUMB : BREAKPOINT_INSTRUCTION_ARM))
+        GDB_GetBreakpointInstruction(instr, ctx, address);
+
+    return true;
+}
+
+/*
+    Computes the address of the instruction executed after the one at "address" (bit 0 set for Thumb).
+    Only the instructions that can't write PC, the direct branches, BX/BLX, POP/LDM/LDR of PC and
+    MOV/ADD/SUB to PC are handled, false is returned otherwise and the stop is reported instead.
+*/
+static bool GDB_GetNextInstructionAddress(GDBContext *ctx, u32 *next, u32 instr, u32 address, const ThreadContext *regs)
+{
+    const CpuRegisters *cpu = &regs->cpu_registers;
+    u32 val;
+
+    if(cpu->cpsr & 0x20)
+    {
+        u32 pcValue = address + 4;
+        *next = (address + 2) | 1;
+
+        if((instr & 0xF000) == 0xD000 && (instr & 0x0F00) == 0x0E00) // permanently undefined
+            return false;
+        else if((instr & 0xF000) == 0xD000 && (instr & 0x0F00) != 0x0F00) // B<cond>
+        {
+            if(GDB_ConditionPassed((instr >> 8) & 0xF, cpu->cpsr))
+                *next = (pcValue + (GDB_SignExtend(instr & 0xFF, 8) << 1)) | 1;
+        }
+        else if((instr & 0xF800) == 0xE000) // B
+            *next = (pcValue + (GDB_SignExtend(instr & 0x7FF, 11) << 1)) | 1;
+        else if((instr & 0xF800) == 0xF000) // BL, BLX (immediate) pair
+        {
+            u32 suffix;
+            if(!GDB_ReadOriginalInstruction(ctx, &suffix, address + 2, 2))
+                return false;
+
+            u32 offset = (GDB_SignExtend(instr & 0x7FF, 11) << 12) | ((suffix & 0x7FF) << 1);
+            if((suffix & 0xF800) == 0xF800)
+                *next = (pcValue + offset) | 1;
+            else if((suffix & 0xF800) == 0xE800)
+                *next = (pcValue + offset) & ~3;
+            else
+                return false;
+        }
+        else if((instr & 0xFF00) == 0x4700) // BX, BLX (register)
+            *next = GDB_GetRegisterForStep(regs, (instr >> 3) & 0xF, pcValue);
+        else if(((instr & 0xFF00) == 0x4400 || (instr & 0xFF00) == 0x4600) && ((instr & 7) | ((instr >> 4) & 8)) == 15) // ADD, MOV to PC
+        {
+            val = GDB_GetRegisterForStep(regs, (instr >> 3) & 0xF, pcValue);
+            *next = (((instr & 0xFF00) == 0x4400 ? pcValue + val : val) & ~1) | 1;
+        }
+        else if((instr & 0xFF00) == 0xBD00) // POP {..., pc}
+        {
+            if(R_FAILED(svcReadProcessMemory(next, ctx->debug, cpu->sp + 4 * __builtin_popcount(instr & 0xFF), 4)))
+                return false;
+        }
+
+        return true;
+    }
+    else
+    {
+        u32 pcValue = address + 8;
+        u32 cond = instr >> 28;
+        *next = address + 4;
+
+        if(cond == 0xF)
+        {
+            if((instr & 0x0E000000) == 0x0A000000) // BLX (immediate)
+                *next = (pcValue + (GDB_SignExtend(instr & 0xFFFFFF, 24) << 2) + ((instr >> 23) & 2)) | 1;
+
+            return (instr & 0x0E500000) != 0x08100000; // RFE
+        }
+        else if(!GDB_ConditionPassed(cond, cpu->cpsr))
+            return true;
+
+        if((instr & 0x0E000000) == 0x0A000000) // B, BL
+            *next = pcValue + (GDB_SignExtend(instr & 0xFFFFFF, 24) << 2);
+        else if((instr & 0x0FFFFFD0) == 0x012FFF10) // BX, BLX (register)
+            *next = GDB_GetRegisterForStep(regs, instr & 0xF, pcValue);
+        else if((instr & 0x0E108000) == 0x08108000) // LDM with PC in the list
+        {
+            u32 base = GDB_GetRegisterForStep(regs, (instr >> 16) & 0xF, pcValue);
+            u32 nbRegs = __builtin_popcount(instr & 0xFFFF);
+            bool before = (instr >> 24) & 1, up = (instr >> 23) & 1;
+
+            if((instr >> 22) & 1) // exception return
+                return false;
+
+            u32 pcAddress = up ? base + 4 * (nbRegs - 1) + (before ? 4 : 0) : base - (before ? 4 : 0);
+            if(R_FAILED(svcReadProcessMemory(next, ctx->debug, pcAddress, 4)))
+                return false;
+        }
+        else if((instr & 0x0C50F000) == 0x0410F000) // LDR pc
+        {
+            u32 base = GDB_GetRegisterForStep(regs, (instr >> 16) & 0xF, pcValue);
+            u32 offset = instr & 0xFFF;
+
+            if((instr >> 25) & 1)
+            {
+                // Only LSL #imm register offsets (jump tables)
+                if((instr & 0x70) != 0)
+                    return false;
+                offset = GDB_GetRegisterForStep(regs, instr & 0xF, pcValue) << ((instr >> 7) & 0x1F);
+            }
+
+            u32 loadAddress = !((instr >> 24) & 1) ? base : ((instr >> 23) & 1) ? base + offset : base - offset;
+            if(R_FAILED(svcReadProcessMemory(next, ctx->debug, loadAddress, 4)))
+                return false;
+        }
+        else if((instr & 0x0C00F000) == 0x0000F000) // data processing to PC
+        {
+            u32 opcode = (instr >> 21) & 0xF;
+            u32 rn = GDB_GetRegisterForStep(regs, (instr >> 16) & 0xF, pcValue);
+
+            if((instr >> 20) & 1) // exception return
+                return false;
+            else if(!((instr >> 25) & 1) && (instr & 0x90) == 0x90) // multiplies, extra loads/stores
+                return false;
+            else if((instr & 0x01900000) == 0x01000000) // miscellaneous instructions
+                return false;
+
+            if((instr >> 25) & 1)
+            {
+                u32 rot = 2 * ((instr >> 8) & 0xF);
+                val = instr & 0xFF;
+                val = rot == 0 ? val : (val >> rot) | (val << (32 - rot));
+            }
+            else if((instr & 0x70) == 0) // LSL #imm
+                val = GDB_GetRegisterForStep(regs, instr & 0xF, pcValue) << ((instr >> 7) & 0x1F);
+            else
+                return false;
+
+            switch(opcode)
+            {
+                case 0xD: *next = val; break;       // MOV
+                case 0x4: *next = rn + val; break;  // ADD
+                case 0x2: *next = rn - val; break;  // SUB
+                default: return false;
+            }
+
+            *next &= ~3;
+        }
+
+        return true;
+    }
+}
+
+static int GDB_WriteBreakpointInstruction(GDBContext *ctx, u32 address, bool thumb)
+{
+    u32 instr = thumb ? BREAKPOINT_INSTRUCTION_THUMB : BREAKPOINT_INSTRUCTION_ARM;
+    return R_SUCCEEDED(svcWriteProcessMemory(ctx->debug, &instr, address, thumb ? 2 : 4)) ? 0 : -EFAULT;
+}
+
+// Runs the instruction at "address" (whose breakpoint, if any, is removed meanwhile) then stops on a temporary breakpoint.
+// The original instruction is back in the memory of the process, which all of its threads share: until the step-over
+// is done, the other threads go through "address" without stopping, even if a condition would have been true for
+// them (only the temporary breakpoint holds them, see GDB_ShouldIgnoreBreakpointHit). Keeping them from running
+// meanwhile would mean locking them, and the thread being stepped could then wait forever for one of them.
+static int GDB_StartStepOver(GDBContext *ctx, u32 threadId, u32 address, u32 instr, const ThreadContext *regs, bool stepping)
+{
+    Breakpoint *target = &ctx->stepOver.target;
+    u32 next;
+
+    if(!GDB_GetNextInstructionAddress(ctx, &next, instr, address, regs) || (next & ~1) == address)
+        return -EINVAL;
+
+    memset(target, 0, sizeof(Breakpoint));
+    target->address = next & ~1;
+
+    // No need for a temporary breakpoint if there's already one
+    if(GDB_GetBreakpointInstruction(NULL, ctx, target->address) != 0)
+    {
+        target->instructionSize = (next & 1) ? 2 : 4;
+        if(R_FAILED(svcReadProcessMemory(&target->savedInstruction, ctx->debug, target->address, target->instructionSize)) ||
+           GDB_WriteBreakpointInstruction(ctx, target->address, next & 1) != 0)
+            return -EFAULT;
+    }
+
+    u32 id = GDB_FindClosestBreakpointSlot(ctx, address);
+    if(id != ctx->nbBreakpoints && ctx->breakpoints[id].address == address && GDB_DisableBreakpointById(ctx, id) != 0)
+    {
+        if(target->instructionSize != 0)
+            svcWriteProcessMemory(ctx->debug, &target->savedInstruction, target->address, target->instructionSize);
+        return -EFAULT;
+    }
+
+    ctx->stepOver.threadId = threadId;
+    ctx->stepOver.address = address;
+    ctx->stepOver.stepping = stepping;
+
+    return 0;
+}
+
+static int GDB_StepOverBreakpoint(GDBContext *ctx, u32 threadId, u32 id, const ThreadContext *regs)
+{
+    Breakpoint *bkpt = &ctx->breakpoints[id];
+    return GDB_StartStepOver(ctx, threadId, bkpt->address, bkpt->savedInstruction, regs, false);
+}
+
+int GDB_StepThread(GDBContext *ctx, u32 threadId)
+{
+    ThreadContext regs;
+    u32 instr;
+
+    if(ctx->stepOver.threadId != 0)
+        return -EBUSY;
+
+    if(R_FAILED(svcGetDebugThreadContext(&regs, ctx->debug, threadId, THREADCONTEXT_CONTROL_ALL)))
+        return -EINVAL;
+
+    u32 pc = regs.cpu_registers.pc;
+    if(!GDB_ReadOriginalInstruction(ctx, &instr, pc, (regs.cpu_registers.cpsr & 0x20) ? 2 : 4))
+        return -EFAULT;
+
+    return GDB_StartStepOver(ctx, threadId, pc, instr, &regs, true);
+}
+
+void GDB_CancelBreakpointStepOver(GDBContext *ctx)
+{
+    Breakpoint *target = &ctx->stepOver.target;
+
+    if(ctx->stepOver.threadId == 0)
+        return;
+
+    if(target->instructionSize != 0)
+        svcWriteProcessMemory(ctx->debug, &target->savedInstruction, target->address, target->instructionSize);
+
+    // Put the breakpoint back, unless it has been removed in the meantime
+    u32 id = GDB_FindClosestBreakpointSlot(ctx, ctx->stepOver.address);
+    if(id != ctx->nbBreakpoints && ctx->breakpoints[id].address == ctx->stepOver.address)
+        GDB_WriteBreakpointInstruction(ctx, ctx->stepOver.address, ctx->breakpoints[id].instructionSize == 2);
+
+    memset(&ctx->stepOver, 0, sizeof(BreakpointStepOver));
+}
+
+bool GDB_ShouldIgnoreBreakpointHit(GDBContext *ctx, u32 threadId)
+{
+    ThreadContext regs;
+    bool stepOverDone = false;
+
+    if(R_FAILED(svcGetDebugThreadContext(&regs, ctx->debug, threadId, THREADCONTEXT_CONTROL_ALL)))
+        return false;
+
+    u32 pc = regs.cpu_registers.pc;
+
+    if(ctx->stepOver.threadId == threadId)
+    {
+        bool stepping = ctx->stepOver.stepping;
+        GDB_CancelBreakpointStepOver(ctx);
+        if(stepping)
+            return false;
+        stepOverDone = true;
+    }
+    else if(ctx->stepOver.threadId != 0 && ctx->stepOver.target.instructionSize != 0 && pc == ctx->stepOver.target.address)
+        return true; // another thread hit the temporary breakpoint, it will hit it again until the step-over is done
+
+    u32 id = GDB_FindClosestBreakpointSlot(ctx, pc);
+    if(id == ctx->nbBreakpoints || ctx->breakpoints[id].address != pc)
+    {
+        if(stepOverDone)
+            return true;
+
+        // Report hardcoded 'svc 0xFF' instructions, but not the temporary breakpoints removed in the meantime
+        bool thumb = (regs.cpu_registers.cpsr & 0x20) != 0;
+        u32 instr = 0;
+        return R_SUCCEEDED(svcReadProcessMemory(&instr, ctx->debug, pc, thumb ? 2 : 4)) &&
+               instr != (thumb ? BREAKPOINT_INSTRUCTION_THUMB : BREAKPOINT_INSTRUCTION_ARM);
+    }
+
+    // Only one step-over at a time, the thread will hit the breakpoint again until then
+    if(ctx->stepOver.threadId != 0)
+        return true;
+
+    if(ctx->breakpoints[id].users & BREAKPOINT_USER_TRACEPOINT)
+    {
+        // This can stop the trace (and remove the breakpoint)
+        GDB_CollectTraceFrames(ctx, threadId, &regs);
+
+        id = GDB_FindClosestBreakpointSlot(ctx, pc);
+        if(id == ctx->nbBreakpoints || ctx->breakpoints[id].address != pc)
+            return true;
+    }
+
+    Breakpoint *bkpt = &ctx->breakpoints[id];
+    if((bkpt->users & BREAKPOINT_USER_GDB) && (bkpt->conditionsSize == 0 || GDB_EvaluateBreakpointConditions(ctx, bkpt, &regs)))
+    {
+        ctx->trace.lastHitThreadId = threadId;
+        ctx->trace.lastHitAddress = pc;
+        return false;
+    }
+
+    return GDB_StepOverBreakpoint(ctx, threadId, id, &regs) == 0;
+}
@@ -14,6 +14,8 @@
 #include "gdb/mem.h"
 #include "gdb/hio.h"
 #include "gdb/watchpoints.h"
+#include "gdb/breakpoints.h"
+#include "gdb/non_stop.h"
 #include "fmt.h"
 
 #include <stdlib.h>
@@ -101,6 +103,16 @@ GDB_DECLARE_VERBOSE_HANDLER(Run)
         return GDB_ReplyErrno(ctx, EPERM);
     }
 
+    if (ctx->flags & GDB_FLAG_NON_STOP)
+    {
+        // The main thread is reported as stopped, then the process runs
+        GDB_StopAllThreads(ctx);
+        int ret = GDB_SendFirstPendingStop(ctx);
+        GDB_ContinueExecution(ctx);
+        RecursiveLock_Unlock(&ctx->lock);
+        return ret;
+    }
+
     RecursiveLock_Unlock(&ctx->lock);
     return R_SUCCEEDED(r) ? GDB_SendStopReply(ctx, &ctx->latestDebugEvent) : GDB_ReplyErrno(ctx, EPERM);
 }
@@ -142,6 +154,16 @@ GDB_DECLARE_VERBOSE_HANDLER(Attach)
     Result r = GDB_AttachToProcess(ctx);
     if(R_FAILED(r))
         GDB_DetachImmediatelyExtended(ctx);
+    else if(ctx->flags & GDB_FLAG_NON_STOP)
+    {
+        // Stops are sent as notifications
+        GDB_StopAllThreads(ctx);
+        int ret = GDB_ReplyOk(ctx);
+        GDB_NotifyPendingStops(ctx);
+        GDB_ContinueExecution(ctx);
+        RecursiveLock_Unlock(&ctx->lock);
+        return ret;
+    }
     RecursiveLock_Unlock(&ctx->lock);
     return R_SUCCEEDED(r) ? GDB_SendStopReply(ctx, &ctx->latestDebugEvent) : GDB_ReplyErrno(ctx, EPERM);
 }
@@ -205,7 +227,9 @@ GDB_DECLARE_VERBOSE_HANDLER(Kill)
 
 GDB_DECLARE_HANDLER(Break)
 {
-    if(!(ctx->flags & GDB_FLAG_PROCESS_CONTINUING))
+    if(ctx->flags & GDB_FLAG_NON_STOP)
+        return GDB_InterruptNonStopThreads(ctx);
+    else if(!(ctx->flags & GDB_FLAG_PROCESS_CONTINUING))
         return GDB_SendPacket(ctx, "S02", 3);
     else
     {
@@ -265,6 +289,9 @@ GDB_DECLARE_HANDLER(Continue)
 
 GDB_DECLARE_VERBOSE_HANDLER(Continue)
 {
+    if(ctx->flags & GDB_FLAG_NON_STOP)
+        return GDB_ContinueNonStopThreads(ctx);
+
     const char *pos = ctx->commandData;
     bool currentThreadFound = false;
     while(pos != NULL && *pos != 0 && !currentThreadFound)
@@ -317,12 +344,14 @@ GDB_DECLARE_HANDLER(GetStopReason)
         return GDB_SendFormattedPacket(ctx, "X0f%s", pidbuf);
     } else if (ctx->debug == 0) {
         return GDB_SendFormattedPacket(ctx, "W00%s", pidbuf);
+    } else if (ctx->flags & GDB_FLAG_NON_STOP) {
+        return GDB_SendNonStopStopReason(ctx);
     } else {
         return GDB_SendStopReply(ctx, &ctx->latestDebugEvent);
     }
 }
 
-static int GDB_ParseCommonThreadInfo(char *out, GDBContext *ctx, int sig)
+int GDB_ParseCommonThreadInfo(char *out, GDBContext *ctx, int sig)
 {
     u32 threadId = ctx->currentThreadId;
     ThreadContext regs;
@@ -361,7 +390,7 @@ static int GDB_ParseCommonThreadInfo(char *out, GDBContext *ctx, int sig)
     return n;
 }
 
-void GDB_PreprocessDebugEvent(GDBContext *ctx, DebugEventInfo *info)
+bool GDB_PreprocessDebugEvent(GDBContext *ctx, DebugEventInfo *info)
 {
     switch(info->type)
     {
@@ -444,6 +473,14 @@ void GDB_PreprocessDebugEvent(GDBContext *ctx, DebugEventInfo *info)
                     break;
                 }
 
+                case EXCEVENT_STOP_POINT:
+                {
+                    if(info->exception.stop_point.type == STOPPOINT_SVC_FF)
+                        return GDB_ShouldIgnoreBreakpointHit(ctx, info->thread_id);
+
+                    break;
+                }
+
                 default:
                     break;
             }
@@ -451,12 +488,12 @@ void GDB_PreprocessDebugEvent(GDBContext *ctx, DebugEventInfo *info)
         default:
             break;
     }
+
+    return false;
 }
 
-int GDB_SendStopReply(GDBContext *ctx, const DebugEventInfo *info)
+int GDB_FormatStopReply(GDBContext *ctx, char *out, const DebugEventInfo *info)
 {
-    char buffer[GDB_BUF_LEN + 1];
-
     switch(info->type)
     {
         case DBGEVENT_ATTACH_PROCESS:
@@ -468,15 +505,14 @@ int GDB_SendStopReply(GDBContext *ctx, const DebugEventInfo *info)
             {
                 // Main thread created
                 ctx->currentThreadId = info->thread_id;
-                GDB_ParseCommonThreadInfo(buffer, ctx, SIGINT);
-                return GDB_SendFormattedPacket(ctx, "%s", buffer);
+                return GDB_ParseCommonThreadInfo(out, ctx, SIGINT);
             }
             else if(info->attach_thread.creator_thread_id == 0 || !ctx->catchThreadEvents)
                 break; // Dismissed
             else
             {
                 ctx->currentThreadId = info->thread_id;
-                return GDB_SendPacket(ctx, "T05create:;", 10);
+                return sprintf(out, "T05create:;");
             }
         }
 
@@ -486,7 +522,7 @@ int GDB_SendStopReply(GDBContext *ctx, const DebugEventInfo *info)
             {
                 // no signal, SIGTERM, SIGQUIT (process exited), SIGTERM (process terminated)
                 static int threadExitRepliesSigs[] = { 0, SIGTERM, SIGQUIT, SIGTERM };
-                return GDB_SendFormattedPacket(ctx, "w%02x;%lx", threadExitRepliesSigs[(u32)info->exit_thread.reason], info->thread_id);
+                return sprintf(out, "w%02x;%lx", threadExitRepliesSigs[(u32)info->exit_thread.reason], info->thread_id);
             }
             break;
         }
@@ -500,7 +536,7 @@ int GDB_SendStopReply(GDBContext *ctx, const DebugEventInfo *info)
                 sprintf(pidbuf, ";process:%lx", GDB_ConvertFromRealPid(ctx->pid));
             else
                 pidbuf[0] = '\0';
-            return GDB_SendFormattedPacket(ctx, "%s%s", processExitReplies[(u32)info->exit_process.reason], pidbuf);
+            return sprintf(out, "%s%s", processExitReplies[(u32)info->exit_process.reason], pidbuf);
         }
 
         case DBGEVENT_EXCEPTION:
@@ -519,8 +555,7 @@ int GDB_SendStopReply(GDBContext *ctx, const DebugEventInfo *info)
                                 (exc.type == EXCEVENT_UNDEFINED_SYSCALL ? SIGSYS : SIGSEGV);
 
                     ctx->currentThreadId = info->thread_id;
-                    GDB_ParseCommonThreadInfo(buffer, ctx, signum);
-                    return GDB_SendFormattedPacket(ctx, "%s", buffer);
+                    return GDB_ParseCommonThreadInfo(out, ctx, signum);
                 }
 
                 case EXCEVENT_ATTACH_BREAK:
@@ -528,14 +563,11 @@ int GDB_SendStopReply(GDBContext *ctx, const DebugEventInfo *info)
                     // Try to deduce which thread we can consider "current"
                     ctx->currentThreadId = ctx->currentThreadId == 0 ? GDB_GetCurrentThread(ctx) : ctx->currentThreadId;
                     if (ctx->currentThreadId != 0)
-                    {
-                        GDB_ParseCommonThreadInfo(buffer, ctx, 0);
-                        return GDB_SendFormattedPacket(ctx, "%s", buffer);
-                    }
+                        return GDB_ParseCommonThreadInfo(out, ctx, 0);
                     else
                     {
                         // Should not happen
-                        return GDB_SendPacket(ctx, "S00", 3);
+                        return sprintf(out, "S00");
                     }
                 }
 
@@ -551,8 +583,8 @@ int GDB_SendStopReply(GDBContext *ctx, const DebugEventInfo *info)
                             // Note: STOPPOINT_BREAKPOINT includes both "bkpt" and hw breakpoints, but we never use the latter...
                             // Use swbreak as a reason for both 'svc 0xFF' and 'bkpt' too (GDB doc mention we should use 'swbreak'
                             // even if the breakpoint was already present/hardcoded).
-                            GDB_ParseCommonThreadInfo(buffer, ctx, SIGTRAP);
-                            return GDB_SendFormattedPacket(ctx, "%sswbreak:;", buffer);
+                            int n = GDB_ParseCommonThreadInfo(out, ctx, SIGTRAP);
+                            return n + sprintf(out + n, "swbreak:;");
                         }
 
                         case STOPPOINT_WATCHPOINT:
@@ -562,8 +594,8 @@ int GDB_SendStopReply(GDBContext *ctx, const DebugEventInfo *info)
                             if(kind == WATCHPOINT_DISABLED)
                                 GDB_SendDebugString(ctx, "Warning: unknown watchpoint encountered!\n");
 
-                            GDB_ParseCommonThreadInfo(buffer, ctx, SIGTRAP);
-                            return GDB_SendFormattedPacket(ctx, "%s%swatch:%08lx;", buffer, kinds[(u32)kind], exc.stop_point.fault_information);
+                            int n = GDB_ParseCommonThreadInfo(out, ctx, SIGTRAP);
+                            return n + sprintf(out + n, "%swatch:%08lx;", kinds[(u32)kind], exc.stop_point.fault_information);
                         }
 
                         default:
@@ -575,8 +607,7 @@ int GDB_SendStopReply(GDBContext *ctx, const DebugEventInfo *info)
                 case EXCEVENT_USER_BREAK:
                 {
                     ctx->currentThreadId = info->thread_id;
-                    GDB_ParseCommonThreadInfo(buffer, ctx, SIGINT);
-                    return GDB_SendFormattedPacket(ctx, "%s", buffer);
+                    return GDB_ParseCommonThreadInfo(out, ctx, SIGINT);
                     //TODO
                 }
 
@@ -611,13 +642,10 @@ int GDB_SendStopReply(GDBContext *ctx, const DebugEventInfo *info)
                     {
                         // No thread.
                         // This should not be happening.
-                        return GDB_SendPacket(ctx, "S02", 3);
+                        return sprintf(out, "S02");
                     }
                     else
-                    {
-                        GDB_ParseCommonThreadInfo(buffer, ctx, SIGINT);
-                        return GDB_SendFormattedPacket(ctx, "%s", buffer);
-                    }
+                        return GDB_ParseCommonThreadInfo(out, ctx, SIGINT);
                 }
 
                 default:
@@ -630,53 +658,61 @@ int GDB_SendStopReply(GDBContext *ctx, const DebugEventInfo *info)
         case DBGEVENT_SYSCALL_IN:
         {
             ctx->currentThreadId = info->thread_id;
-            GDB_ParseCommonThreadInfo(buffer, ctx, SIGTRAP);
-            return GDB_SendFormattedPacket(ctx, "%ssyscall_entry:%02x;", buffer, info->syscall.syscall);
+            int n = GDB_ParseCommonThreadInfo(out, ctx, SIGTRAP);
+            return n + sprintf(out + n, "syscall_entry:%02x;", info->syscall.syscall);
         }
 
         case DBGEVENT_SYSCALL_OUT:
         {
             ctx->currentThreadId = info->thread_id;
-            GDB_ParseCommonThreadInfo(buffer, ctx, SIGTRAP);
-            return GDB_SendFormattedPacket(ctx, "%ssyscall_return:%02x;", buffer, info->syscall.syscall);
+            int n = GDB_ParseCommonThreadInfo(out, ctx, SIGTRAP);
+            return n + sprintf(out + n, "syscall_return:%02x;", info->syscall.syscall);
         }
 
-        case DBGEVENT_OUTPUT_STRING:
-        {
-            // Regular "output string"
-            if (!GDB_IsHioInProgress(ctx))
-            {
-                u32 addr = info->output_string.string_addr;
-                u32 remaining = info->output_string.string_size;
-                u32 sent = 0;
-                int total = 0;
-                while(remaining > 0)
-                {
-                    u32 pending = (GDB_BUF_LEN - 1) / 2;
-                    pending = pending < remaining ? pending : remaining;
+        default:
+            break;
+    }
 
-                    int res = GDB_SendMemory(ctx, "O", 1, addr + sent, pending);
-                    if(res < 0 || (u32) res != 5 + 2 * pending)
-                        break;
+    return 0;
+}
 
-                    sent += pending;
-                    remaining -= pending;
-                    total += res;
-                }
+int GDB_SendStopReply(GDBContext *ctx, const DebugEventInfo *info)
+{
+    char buffer[GDB_BUF_LEN + 1];
 
-                return total;
-            }
-            else // HIO
+    if(info->type == DBGEVENT_OUTPUT_STRING)
+    {
+        // Regular "output string"
+        if (!GDB_IsHioInProgress(ctx))
+        {
+            u32 addr = info->output_string.string_addr;
+            u32 remaining = info->output_string.string_size;
+            u32 sent = 0;
+            int total = 0;
+            while(remaining > 0)
             {
-                return GDB_SendCurrentHioRequest(ctx);
+                u32 pending = (GDB_BUF_LEN - 1) / 2;
+                pending = pending < remaining ? pending : remaining;
+
+                int res = GDB_SendMemory(ctx, "O", 1, addr + sent, pending);
+                if(res < 0 || (u32) res != 5 + 2 * pending)
+                    break;
+
+                sent += pending;
+                remaining -= pending;
+                total += res;
             }
 
+            return total;
+        }
+        else // HIO
+        {
+            return GDB_SendCurrentHioRequest(ctx);
         }
-        default:
-            break;
     }
 
-    return 0;
+    int n = GDB_FormatStopReply(ctx, buffer, info);
+    return n > 0 ? GDB_SendPacket(ctx, buffer, n) : 0;
 }
 
 /*
@@ -694,7 +730,15 @@ int GDB_HandleDebugEvents(GDBContext *ctx)
     if(R_FAILED(rdbg))
         return -1;
 
-    GDB_PreprocessDebugEvent(ctx, &info);
+    if(ctx->flags & GDB_FLAG_NON_STOP)
+        return GDB_HandleNonStopDebugEvent(ctx, &info);
+
+    if(GDB_PreprocessDebugEvent(ctx, &info))
+    {
+        // Breakpoint whose conditions are all false, or step-over: resume the thread without telling GDB
+        Result r = svcContinueDebugEvent(ctx->debug, ctx->continueFlags);
+        return r == (Result)0xD8A02008 ? -2 : -3;
+    }
 
     int ret = 0;
     bool continueAutomatically = (info.type == DBGEVENT_OUTPUT_STRING  && !GDB_IsHioInProgress(ctx)) ||
@@ -722,6 +766,7 @@ int GDB_HandleDebugEvents(GDBContext *ctx)
         if(ctx->processEnded)
             return -2;
 
+        GDB_CancelBreakpointStepOver(ctx);
         ctx->latestDebugEvent = info;
         ret = GDB_SendStopReply(ctx, &info);
         ctx->flags &= ~GDB_FLAG_PROCESS_CONTINUING;
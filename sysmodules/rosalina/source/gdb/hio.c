@@ -68,6 +68,21 @@ int GDB_SendCurrentHioRequest(GDBContext *ctx)
     return GDB_SendPacket(ctx, buf, strlen(buf));
 }
 
+int GDB_FailCurrentHioRequest(GDBContext *ctx, int gdbErrno)
+{
+    ctx->currentHioRequest.retval = -1ll;
+    ctx->currentHioRequest.gdbErrno = gdbErrno;
+    ctx->currentHioRequest.ctrlC = false;
+    memset(ctx->currentHioRequest.paramFormat, 0, sizeof(ctx->currentHioRequest.paramFormat));
+
+    u32 total = GDB_WriteTargetMemory(ctx, &ctx->currentHioRequest, ctx->currentHioRequestTargetAddr, sizeof(PackedGdbHioRequest));
+
+    memset(&ctx->currentHioRequest, 0, sizeof(PackedGdbHioRequest));
+    ctx->currentHioRequestTargetAddr = 0;
+
+    return total == sizeof(PackedGdbHioRequest) ? 0 : -EFAULT;
+}
+
 GDB_DECLARE_HANDLER(HioReply)
 {
     if (!GDB_IsHioInProgress(ctx))
@@ -7,6 +7,7 @@
 
 #include "gdb/mem.h"
 #include "gdb/net.h"
+#include "gdb/tracepoints.h"
 #include "utils.h"
 
 static void *k_memcpy_no_interrupt(void *dst, const void *src, u32 len)
@@ -247,6 +248,9 @@ GDB_DECLARE_HANDLER(ReadMemory)
     u32 addr = lst[0];
     u32 len = lst[1];
 
+    if(ctx->trace.frameSelected)
+        return GDB_SendTraceFrameMemory(ctx, addr, len);
+
     return GDB_SendMemory(ctx, NULL, 0, addr, len);
 }
 
@@ -177,7 +177,7 @@ int GDB_ReceivePacket(GDBContext *ctx)
     memcpy(backupbuf, ctx->buffer, ctx->latestSentPacketSize);
     memset(ctx->buffer, 0, sizeof(ctx->buffer));
 
-    int r = socRecv(ctx->super.sockfd, ctx->buffer, sizeof(ctx->buffer), MSG_PEEK);
+    int r = server_recv(&ctx->super, ctx->buffer, sizeof(ctx->buffer), MSG_PEEK);
     if(r < 1)
         return -1;
     if(ctx->buffer[0] == '+') // GDB sometimes acknowleges TCP acknowledgment packets (yes...). IDA does it properly
@@ -186,20 +186,20 @@ int GDB_ReceivePacket(GDBContext *ctx)
             return -1;
 
         // Consume it
-        r = socRecv(ctx->super.sockfd, ctx->buffer, 1, 0);
+        r = server_recv(&ctx->super, ctx->buffer, 1, 0);
         if(r != 1)
             return -1;
 
         ctx->buffer[0] = 0;
 
-        r = socRecv(ctx->super.sockfd, ctx->buffer, sizeof(ctx->buffer), MSG_PEEK);
+        r = server_recv(&ctx->super, ctx->buffer, sizeof(ctx->buffer), MSG_PEEK);
 
         if(r == -1)
             goto packet_error;
     }
     else if(ctx->buffer[0] == '-')
     {
-        socSend(ctx->super.sockfd, backupbuf, ctx->latestSentPacketSize, 0);
+        server_send(&ctx->super, backupbuf, ctx->latestSentPacketSize);
         return 0;
     }
     int maxlen = r > (int)sizeof(ctx->buffer) ? (int)sizeof(ctx->buffer) : r;
@@ -215,7 +215,7 @@ int GDB_ReceivePacket(GDBContext *ctx)
         else
         {
             u8 checksum;
-            r = socRecv(ctx->super.sockfd, ctx->buffer, 3 + pos - ctx->buffer, 0);
+            r = server_recv(&ctx->super, ctx->buffer, 3 + pos - ctx->buffer, 0);
             if(r != 3 + pos - ctx->buffer || GDB_DecodeHex(&checksum, pos + 1, 1) != 1)
                 goto packet_error;
             else if(GDB_ComputeChecksum(ctx->buffer + 1, pos - ctx->buffer - 1) != checksum)
@@ -227,7 +227,7 @@ int GDB_ReceivePacket(GDBContext *ctx)
     }
     else if(ctx->buffer[0] == '\x03')
     {
-        r = socRecv(ctx->super.sockfd, ctx->buffer, 1, 0);
+        r = server_recv(&ctx->super, ctx->buffer, 1, 0);
         if(r != 1)
             goto packet_error;
 
@@ -236,7 +236,7 @@ int GDB_ReceivePacket(GDBContext *ctx)
 
     if(!(ctx->flags & GDB_FLAG_NOACK))
     {
-        int r2 = socSend(ctx->super.sockfd, "+", 1, 0);
+        int r2 = server_send(&ctx->super, "+", 1);
         if(r2 != 1)
             return -1;
     }
@@ -252,7 +252,7 @@ int GDB_ReceivePacket(GDBContext *ctx)
 packet_error:
     if(!(ctx->flags & GDB_FLAG_NOACK))
     {
-        r = socSend(ctx->super.sockfd, "-", 1, 0);
+        r = server_send(&ctx->super, "-", 1);
         if(r != 1)
             return -1;
         else
@@ -264,7 +264,7 @@ packet_error:
 
 static int GDB_DoSendPacket(GDBContext *ctx, u32 len)
 {
-    int r = socSend(ctx->super.sockfd, ctx->buffer, len, 0);
+    int r = server_send(&ctx->super, ctx->buffer, len);
 
     if(r > 0)
         ctx->latestSentPacketSize = r;
@@ -358,6 +358,23 @@ int GDB_SendDebugString(GDBContext *ctx, const char *fmt, ...) // unsecure
     return GDB_DoSendPacket(ctx, 5 + 2 * n);
 }
 
+int GDB_SendNotification(GDBContext *ctx, const char *name, const char *data, u32 len)
+{
+    // Notifications aren't acknowledged, so unlike packets they're not kept in ctx->buffer for retransmission
+    char buf[GDB_BUF_LEN + 4];
+    int n = sprintf(buf, "%%%s:", name);
+    if(n + len + 3 > sizeof(buf))
+        return -1;
+
+    memcpy(buf + n, data, len);
+
+    char *checksumLoc = buf + n + len;
+    *checksumLoc++ = '#';
+
+    hexItoa(GDB_ComputeChecksum(buf + 1, n - 1 + len), checksumLoc, 2, false);
+    return server_send(&ctx->super, buf, n + len + 3);
+}
+
 int GDB_ReplyEmpty(GDBContext *ctx)
 {
     return GDB_SendPacket(ctx, "", 0);
@@ -0,0 +1,518 @@
+/*
+*   This file is part of Luma3DS.
+*   Copyright (C) 2016-2020 Aurora Wright, TuxSH
+*
+*   SPDX-License-Identifier: (MIT OR GPL-2.0-or-later)
+*/
+
+#include "gdb/non_stop.h"
+#include "gdb/debug.h"
+#include "gdb/breakpoints.h"
+#include "gdb/thread.h"
+#include "gdb/net.h"
+#include "gdb/hio.h"
+
+#include <signal.h>
+
+#define MAX_VCONT_ACTIONS   16
+
+// The predicate runs in kernel mode (with our address space), it can't take locks itself
+static LightLock scheduledThreadListLock;
+static const u32 *scheduledThreadIds;
+static u32 nbScheduledThreads;
+
+void GDB_InitializeNonStopMode(void)
+{
+    LightLock_Init(&scheduledThreadListLock);
+}
+
+static bool GDB_ScheduledThreadPredicate(u32 *kthread)
+{
+    u32 threadId = kthread[0x22];
+    for(u32 i = 0; i < nbScheduledThreads; i++)
+    {
+        if(scheduledThreadIds[i] == threadId)
+            return true;
+    }
+
+    return false;
+}
+
+static Result GDB_ScheduleThreads(GDBContext *ctx, const u32 *threadIds, u32 nbThreads, bool lock)
+{
+    Handle process;
+
+    if(nbThreads == 0)
+        return 0;
+
+    Result r = svcOpenProcess(&process, ctx->pid);
+    if(R_FAILED(r))
+        return r;
+
+    LightLock_Lock(&scheduledThreadListLock);
+    scheduledThreadIds = threadIds;
+    nbScheduledThreads = nbThreads;
+    r = svcControlProcess(process, PROCESSOP_SCHEDULE_THREADS, lock ? 1 : 0, (u32)GDB_ScheduledThreadPredicate);
+    nbScheduledThreads = 0;
+    LightLock_Unlock(&scheduledThreadListLock);
+
+    svcCloseHandle(process);
+    return r;
+}
+
+static ThreadInfo *GDB_GetThreadInfo(GDBContext *ctx, u32 threadId)
+{
+    for(u32 i = 0; i < ctx->nbThreads; i++)
+    {
+        if(ctx->threadInfos[i].id == threadId)
+            return &ctx->threadInfos[i];
+    }
+
+    return NULL;
+}
+
+static ThreadInfo *GDB_GetOldestPendingStop(GDBContext *ctx)
+{
+    ThreadInfo *oldest = NULL;
+    for(u32 i = 0; i < ctx->nbThreads; i++)
+    {
+        ThreadInfo *thread = &ctx->threadInfos[i];
+        if(thread->stopState == GDB_THREAD_STOP_PENDING && (oldest == NULL || thread->stopOrder < oldest->stopOrder))
+            oldest = thread;
+    }
+
+    return oldest;
+}
+
+// The caller has to lock the thread
+static void GDB_QueueThreadStop(GDBContext *ctx, ThreadInfo *thread, s32 stopSignal, const DebugEventInfo *info)
+{
+    thread->stopState = GDB_THREAD_STOP_PENDING;
+    thread->stopOrder = ++ctx->nonStop.nbStops;
+    thread->stopSignal = stopSignal;
+
+    if(info != NULL)
+        thread->stopEvent = *info;
+    else
+        memset(&thread->stopEvent, 0, sizeof(DebugEventInfo));
+}
+
+static bool GDB_IsThreadStopEvent(const DebugEventInfo *info)
+{
+    switch(info->type)
+    {
+        case DBGEVENT_EXCEPTION:
+            return info->exception.type != EXCEVENT_ATTACH_BREAK && info->exception.type != EXCEVENT_DEBUGGER_BREAK;
+        case DBGEVENT_SYSCALL_IN:
+        case DBGEVENT_SYSCALL_OUT:
+            return true;
+        default:
+            return false;
+    }
+}
+
+static int GDB_FormatThreadStop(GDBContext *ctx, char *out, const ThreadInfo *thread)
+{
+    ctx->currentThreadId = thread->id;
+    if(thread->stopSignal >= 0)
+        return GDB_ParseCommonThreadInfo(out, ctx, thread->stopSignal);
+    else
+        return GDB_FormatStopReply(ctx, out, &thread->stopEvent);
+}
+
+int GDB_NotifyPendingStops(GDBContext *ctx)
+{
+    char buffer[GDB_BUF_LEN + 1];
+
+    if(ctx->nonStop.notifying)
+        return 0;
+
+    ThreadInfo *thread = GDB_GetOldestPendingStop(ctx);
+    if(thread == NULL)
+        return 0;
+
+    int n = GDB_FormatThreadStop(ctx, buffer, thread);
+    ctx->nonStop.notifying = true;
+    ctx->nonStop.reportedThreadId = thread->id;
+
+    return GDB_SendNotification(ctx, "Stop", buffer, n);
+}
+
+int GDB_SendFirstPendingStop(GDBContext *ctx)
+{
+    char buffer[GDB_BUF_LEN + 1];
+
+    ThreadInfo *thread = GDB_GetOldestPendingStop(ctx);
+    if(thread == NULL)
+        return GDB_ReplyOk(ctx);
+
+    int n = GDB_FormatThreadStop(ctx, buffer, thread);
+    thread->stopState = GDB_THREAD_STOPPED;
+
+    return GDB_SendPacket(ctx, buffer, n);
+}
+
+int GDB_HandleNonStopDebugEvent(GDBContext *ctx, DebugEventInfo *info)
+{
+    // Read before the step-over is done
+    bool wasStepping = ctx->stepOver.stepping && ctx->stepOver.threadId == info->thread_id;
+    ThreadInfo *thread = NULL;
+    s32 stopSignal = -1;
+
+    if(!GDB_PreprocessDebugEvent(ctx, info))
+    {
+        switch(info->type)
+        {
+            case DBGEVENT_EXIT_PROCESS:
+            {
+                char buffer[GDB_BUF_LEN + 1];
+
+                // Nothing left to resume
+                for(u32 i = 0; i < ctx->nbThreads; i++)
+                    ctx->threadInfos[i].stopState = GDB_THREAD_RUNNING;
+
+                // GDB has to acknowledge the stops it got already before being told
+                if(ctx->nonStop.notifying)
+                    ctx->nonStop.exitPending = true;
+                else
+                {
+                    int n = GDB_FormatStopReply(ctx, buffer, info);
+                    ctx->nonStop.notifying = true;
+                    ctx->nonStop.reportedThreadId = 0;
+                    GDB_SendNotification(ctx, "Stop", buffer, n);
+                }
+
+                break;
+            }
+
+            case DBGEVENT_OUTPUT_STRING:
+            {
+                // "O" packets can't be sent asynchronously, and File-I/O needs the process to be stopped
+                if(GDB_IsHioInProgress(ctx))
+                    GDB_FailCurrentHioRequest(ctx, EBUSY);
+                break;
+            }
+
+            case DBGEVENT_EXCEPTION:
+            case DBGEVENT_SYSCALL_IN:
+            case DBGEVENT_SYSCALL_OUT:
+            {
+                if(!GDB_IsThreadStopEvent(info))
+                    break; // attach break, or GDB_BreakProcessForNonStop
+
+                if(wasStepping && info->type == DBGEVENT_EXCEPTION && info->exception.type == EXCEVENT_STOP_POINT &&
+                   info->exception.stop_point.type == STOPPOINT_SVC_FF)
+                    stopSignal = SIGTRAP; // step done
+                else if(ctx->stepOver.threadId == info->thread_id)
+                    GDB_CancelBreakpointStepOver(ctx);
+
+                thread = GDB_GetThreadInfo(ctx, info->thread_id);
+                break;
+            }
+
+            default:
+                break;
+        }
+    }
+
+    if(thread != NULL && (info->flags & 1))
+    {
+        GDB_ScheduleThreads(ctx, &thread->id, 1, true);
+        GDB_QueueThreadStop(ctx, thread, stopSignal, info);
+        GDB_NotifyPendingStops(ctx);
+    }
+
+    if(!(info->flags & 1))
+        return ctx->processEnded ? -2 : -3;
+
+    Result r = svcContinueDebugEvent(ctx->debug, ctx->continueFlags);
+    return (r == (Result)0xD8A02008 || info->type == DBGEVENT_EXIT_PROCESS) ? -2 : -3;
+}
+
+void GDB_BreakProcessForNonStop(GDBContext *ctx)
+{
+    if(!(ctx->flags & GDB_FLAG_NON_STOP) || !(ctx->flags & GDB_FLAG_PROCESS_CONTINUING) || ctx->debug == 0 || ctx->processEnded)
+        return;
+
+    // Fails if the process is already broken by an event the monitor thread hasn't handled yet, which is fine
+    svcBreakDebugProcess(ctx->debug);
+}
+
+void GDB_StopAllThreads(GDBContext *ctx)
+{
+    const DebugEventInfo *info = &ctx->latestDebugEvent;
+    u32 threadIds[MAX_DEBUG_THREAD];
+    u32 nbThreads = 0;
+
+    // The thread of the event is reported first
+    ThreadInfo *eventThread = GDB_IsThreadStopEvent(info) ? GDB_GetThreadInfo(ctx, info->thread_id) : NULL;
+    if(eventThread != NULL && eventThread->stopState == GDB_THREAD_RUNNING)
+    {
+        GDB_QueueThreadStop(ctx, eventThread, -1, info);
+        threadIds[nbThreads++] = eventThread->id;
+    }
+
+    for(u32 i = 0; i < ctx->nbThreads; i++)
+    {
+        ThreadInfo *thread = &ctx->threadInfos[i];
+        if(thread->stopState == GDB_THREAD_RUNNING)
+        {
+            GDB_QueueThreadStop(ctx, thread, 0, NULL);
+            threadIds[nbThreads++] = thread->id;
+        }
+    }
+
+    GDB_ScheduleThreads(ctx, threadIds, nbThreads, true);
+}
+
+void GDB_ResumeAllThreads(GDBContext *ctx)
+{
+    u32 threadIds[MAX_DEBUG_THREAD];
+    u32 nbThreads = 0;
+
+    for(u32 i = 0; i < ctx->nbThreads; i++)
+    {
+        ThreadInfo *thread = &ctx->threadInfos[i];
+        if(thread->stopState != GDB_THREAD_RUNNING)
+        {
+            thread->stopState = GDB_THREAD_RUNNING;
+            threadIds[nbThreads++] = thread->id;
+        }
+    }
+
+    if(ctx->debug != 0 && !ctx->processEnded)
+        GDB_ScheduleThreads(ctx, threadIds, nbThreads, false);
+}
+
+int GDB_SendNonStopStopReason(GDBContext *ctx)
+{
+    char buffer[GDB_BUF_LEN + 1];
+
+    // All the stops are reported again, the first one as the reply, then with vStopped
+    for(u32 i = 0; i < ctx->nbThreads; i++)
+    {
+        if(ctx->threadInfos[i].stopState != GDB_THREAD_RUNNING)
+            ctx->threadInfos[i].stopState = GDB_THREAD_STOP_PENDING;
+    }
+
+    ThreadInfo *thread = GDB_GetOldestPendingStop(ctx);
+    if(thread == NULL)
+    {
+        ctx->nonStop.notifying = false;
+        return GDB_ReplyOk(ctx);
+    }
+
+    int n = GDB_FormatThreadStop(ctx, buffer, thread);
+    ctx->nonStop.notifying = true;
+    ctx->nonStop.reportedThreadId = thread->id;
+
+    return GDB_SendPacket(ctx, buffer, n);
+}
+
+// Also stops the step-over of the thread, if any: it would block the breakpoints of the other threads
+static bool GDB_InterruptThread(GDBContext *ctx, ThreadInfo *thread)
+{
+    if(thread->stopState != GDB_THREAD_RUNNING)
+        return false;
+
+    if(ctx->stepOver.threadId == thread->id)
+        GDB_CancelBreakpointStepOver(ctx);
+
+    GDB_QueueThreadStop(ctx, thread, 0, NULL);
+    return true;
+}
+
+int GDB_InterruptNonStopThreads(GDBContext *ctx)
+{
+    u32 threadIds[MAX_DEBUG_THREAD];
+    u32 nbThreads = 0;
+
+    if(ctx->debug == 0 || ctx->processEnded)
+        return 0;
+
+    for(u32 i = 0; i < ctx->nbThreads; i++)
+    {
+        if(GDB_InterruptThread(ctx, &ctx->threadInfos[i]))
+            threadIds[nbThreads++] = ctx->threadInfos[i].id;
+    }
+
+    GDB_ScheduleThreads(ctx, threadIds, nbThreads, true);
+    return GDB_NotifyPendingStops(ctx);
+}
+
+int GDB_ContinueNonStopThreads(GDBContext *ctx)
+{
+    struct
+    {
+        char type;
+        u32 threadId; // 0 for all threads
+    } actions[MAX_VCONT_ACTIONS];
+    u32 nbActions = 0;
+
+    const char *pos = ctx->commandData;
+    if(pos == NULL || *pos == 0)
+        return GDB_ReplyErrno(ctx, EILSEQ);
+
+    while(*pos != 0)
+    {
+        if(nbActions == MAX_VCONT_ACTIONS)
+            return GDB_ReplyErrno(ctx, EINVAL);
+
+        char type = *pos;
+        if(type != 'c' && type != 'C' && type != 's' && type != 'S' && type != 't')
+            return GDB_ReplyErrno(ctx, EPERM);
+
+        // Signals are ignored...
+        if(type == 'C' || type == 'S')
+        {
+            if(pos[1] == 0 || pos[2] == 0)
+                return GDB_ReplyErrno(ctx, EILSEQ);
+            pos += 3;
+        }
+        else
+            pos++;
+
+        u32 pid = ctx->pid, tid = 0;
+        if(*pos == ':')
+        {
+            pos = GDB_ParseThreadId(ctx, &pid, &tid, pos + 1, ';');
+            if(pos == NULL)
+                return GDB_ReplyErrno(ctx, EILSEQ);
+            if(pid != (u32)-1 && pid != ctx->pid)
+                return GDB_ReplyErrno(ctx, EPERM);
+        }
+
+        if(*pos == ';')
+            pos++;
+        else if(*pos != 0)
+            return GDB_ReplyErrno(ctx, EILSEQ);
+
+        actions[nbActions].type = type == 'C' ? 'c' : (type == 'S' ? 's' : type);
+        actions[nbActions++].threadId = tid;
+    }
+
+    // Leftmost action matching the thread
+    char threadActions[MAX_DEBUG_THREAD] = { 0 };
+    u32 steppedThreadId = 0;
+    for(u32 i = 0; i < ctx->nbThreads; i++)
+    {
+        for(u32 j = 0; j < nbActions && threadActions[i] == 0; j++)
+        {
+            if(actions[j].threadId == 0 || actions[j].threadId == ctx->threadInfos[i].id)
+                threadActions[i] = actions[j].type;
+        }
+
+        if(threadActions[i] == 's' && ctx->threadInfos[i].stopState == GDB_THREAD_STOPPED)
+        {
+            // Only one step or step-over at a time
+            if(steppedThreadId != 0)
+                return GDB_ReplyErrno(ctx, EBUSY);
+            steppedThreadId = ctx->threadInfos[i].id;
+        }
+    }
+
+    if(steppedThreadId != 0)
+    {
+        int r = GDB_StepThread(ctx, steppedThreadId);
+        if(r != 0)
+            return GDB_ReplyErrno(ctx, -r);
+    }
+
+    u32 resumedThreadIds[MAX_DEBUG_THREAD], stoppedThreadIds[MAX_DEBUG_THREAD];
+    u32 nbResumedThreads = 0, nbStoppedThreads = 0;
+
+    for(u32 i = 0; i < ctx->nbThreads; i++)
+    {
+        ThreadInfo *thread = &ctx->threadInfos[i];
+
+        // Threads whose stops GDB hasn't seen yet aren't resumed
+        switch(threadActions[i])
+        {
+            case 'c':
+            case 's':
+            {
+                if(thread->stopState != GDB_THREAD_STOPPED)
+                    break;
+
+                thread->stopState = GDB_THREAD_RUNNING;
+                resumedThreadIds[nbResumedThreads++] = thread->id;
+                break;
+            }
+
+            case 't':
+            {
+                if(GDB_InterruptThread(ctx, thread))
+                    stoppedThreadIds[nbStoppedThreads++] = thread->id;
+                break;
+            }
+
+            default:
+                break;
+        }
+    }
+
+    GDB_ScheduleThreads(ctx, stoppedThreadIds, nbStoppedThreads, true);
+    GDB_ScheduleThreads(ctx, resumedThreadIds, nbResumedThreads, false);
+
+    int ret = GDB_ReplyOk(ctx);
+    GDB_NotifyPendingStops(ctx);
+    return ret;
+}
+
+GDB_DECLARE_VERBOSE_HANDLER(Stopped)
+{
+    if(!ctx->nonStop.notifying)
+        return GDB_ReplyOk(ctx);
+
+    // The previous stop reply is acknowledged
+    ThreadInfo *thread = GDB_GetThreadInfo(ctx, ctx->nonStop.reportedThreadId);
+    if(thread != NULL && thread->stopState == GDB_THREAD_STOP_PENDING)
+        thread->stopState = GDB_THREAD_STOPPED;
+
+    thread = GDB_GetOldestPendingStop(ctx);
+    if(thread != NULL)
+    {
+        char buffer[GDB_BUF_LEN + 1];
+        int n = GDB_FormatThreadStop(ctx, buffer, thread);
+        ctx->nonStop.reportedThreadId = thread->id;
+        return GDB_SendPacket(ctx, buffer, n);
+    }
+
+    ctx->nonStop.reportedThreadId = 0;
+    if(ctx->nonStop.exitPending)
+    {
+        ctx->nonStop.exitPending = false;
+        return GDB_HandleGetStopReason(ctx);
+    }
+
+    ctx->nonStop.notifying = false;
+    return GDB_ReplyOk(ctx);
+}
+
+GDB_DECLARE_QUERY_HANDLER(NonStop)
+{
+    u32 enable;
+    if(GDB_ParseHexIntegerList(&enable, ctx->commandData, 1, 0) == NULL || enable > 1)
+        return GDB_ReplyErrno(ctx, EILSEQ);
+
+    if(enable && !(ctx->flags & GDB_FLAG_NON_STOP))
+    {
+        ctx->flags |= GDB_FLAG_NON_STOP;
+        memset(&ctx->nonStop, 0, sizeof(GDBNonStopState));
+
+        // The process is stopped as a whole: stop all threads individually instead (reported by '?')
+        if(ctx->state == GDB_STATE_ATTACHED && ctx->debug != 0 && !ctx->processEnded && !(ctx->flags & GDB_FLAG_PROCESS_CONTINUING))
+        {
+            GDB_StopAllThreads(ctx);
+            GDB_ContinueExecution(ctx);
+        }
+    }
+    else if(!enable && (ctx->flags & GDB_FLAG_NON_STOP))
+    {
+        GDB_ResumeAllThreads(ctx);
+        memset(&ctx->nonStop, 0, sizeof(GDBNonStopState));
+        ctx->flags &= ~GDB_FLAG_NON_STOP;
+    }
+
+    return GDB_ReplyOk(ctx);
+}
@@ -12,6 +12,8 @@
 #include "gdb/mem.h"
 #include "gdb/net.h"
 #include "gdb/remote_command.h"
+#include "gdb/tracepoints.h"
+#include "gdb/non_stop.h"
 
 typedef enum GDBQueryDirection
 {
@@ -45,7 +47,27 @@ static const struct
     GDB_QUERY_HANDLER_LIST_ITEM_3("C", CurrentThreadId, READ),
     GDB_QUERY_HANDLER_LIST_ITEM_3("Search", SearchMemory, READ),
     GDB_QUERY_HANDLER_LIST_ITEM(CatchSyscalls, WRITE),
+    GDB_QUERY_HANDLER_LIST_ITEM(NonStop, WRITE),
     GDB_QUERY_HANDLER_LIST_ITEM(Rcmd, READ),
+    GDB_QUERY_HANDLER_LIST_ITEM_3("Tinit", TraceInit, WRITE),
+    GDB_QUERY_HANDLER_LIST_ITEM_3("TDP", DefineTracepoint, WRITE),
+    GDB_QUERY_HANDLER_LIST_ITEM_3("TDV", DefineTraceStateVariable, WRITE),
+    GDB_QUERY_HANDLER_LIST_ITEM_3("TEnable", EnableTracepoint, WRITE),
+    GDB_QUERY_HANDLER_LIST_ITEM_3("TDisable", DisableTracepoint, WRITE),
+    GDB_QUERY_HANDLER_LIST_ITEM_3("TStart", TraceStart, WRITE),
+    GDB_QUERY_HANDLER_LIST_ITEM_3("TStop", TraceStop, WRITE),
+    GDB_QUERY_HANDLER_LIST_ITEM_3("TFrame", SelectTraceFrame, WRITE),
+    GDB_QUERY_HANDLER_LIST_ITEM_3("TBuffer", SetTraceBufferOption, WRITE),
+    GDB_QUERY_HANDLER_LIST_ITEM_3("Tro", TraceReadOnlyRanges, WRITE),
+    GDB_QUERY_HANDLER_LIST_ITEM_3("TDisconnected", TraceDisconnected, WRITE),
+    GDB_QUERY_HANDLER_LIST_ITEM_3("TStatus", TraceStatus, READ),
+    GDB_QUERY_HANDLER_LIST_ITEM_3("TP", TracepointStatus, READ),
+    GDB_QUERY_HANDLER_LIST_ITEM_3("TV", TraceStateVariableValue, READ),
+    GDB_QUERY_HANDLER_LIST_ITEM_3("TBuffer", ReadTraceBuffer, READ),
+    GDB_QUERY_HANDLER_LIST_ITEM_3("TfP", UploadTraceDefinitions, READ),
+    GDB_QUERY_HANDLER_LIST_ITEM_3("TsP", UploadTraceDefinitions, READ),
+    GDB_QUERY_HANDLER_LIST_ITEM_3("TfV", UploadTraceDefinitions, READ),
+    GDB_QUERY_HANDLER_LIST_ITEM_3("TsV", UploadTraceDefinitions, READ),
 };
 
 static int GDB_HandleQuery(GDBContext *ctx, GDBQueryDirection direction)
@@ -105,8 +127,9 @@ GDB_DECLARE_QUERY_HANDLER(Supported)
     return GDB_SendFormattedPacket(ctx,
         "PacketSize=%x;"
         "qXfer:features:read+;qXfer:osdata:read+;"
-        "QStartNoAckMode+;QThreadEvents+;QCatchSyscalls+;"
-        "vContSupported+;swbreak+;multiprocess+",
+        "QStartNoAckMode+;QThreadEvents+;QCatchSyscalls+;QNonStop+;"
+        "vContSupported+;swbreak+;multiprocess+;ConditionalBreakpoints+;"
+        "ConditionalTracepoints+;TraceStateVariables+;EnableDisableTracepoints+;QTBuffer:size+;tracenz+",
 
         GDB_BUF_LEN // should have been sizeof(ctx->buffer) but GDB memory functions are bugged
     );
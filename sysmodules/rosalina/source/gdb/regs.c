@@ -7,9 +7,13 @@
 
 #include "gdb/regs.h"
 #include "gdb/net.h"
+#include "gdb/tracepoints.h"
 
 GDB_DECLARE_HANDLER(ReadRegisters)
 {
+    if(ctx->trace.frameSelected)
+        return GDB_SendTraceFrameRegisters(ctx);
+
     if(ctx->selectedThreadId == 0)
         ctx->selectedThreadId = ctx->currentThreadId;
 
@@ -68,6 +72,25 @@ static u32 GDB_ConvertRegisterNumber(ThreadContextControlFlags *flags, u32 gdbNu
     }
 }
 
+int GDB_ReadRegisterFromContext(u64 *out, const ThreadContext *regs, u32 gdbRegNum)
+{
+    ThreadContextControlFlags flags;
+    u32 n = GDB_ConvertRegisterNumber(&flags, gdbRegNum);
+
+    if(flags & THREADCONTEXT_CONTROL_CPU_GPRS)
+        *out = regs->cpu_registers.r[n];
+    else if(flags & THREADCONTEXT_CONTROL_CPU_SPRS)
+        *out = (&regs->cpu_registers.sp)[n - 13]; // hacky
+    else if(flags & THREADCONTEXT_CONTROL_FPU_GPRS)
+        memcpy(out, &regs->fpu_registers.d[n], 8);
+    else if(flags)
+        *out = (&regs->fpu_registers.fpscr)[n]; // hacky
+    else
+        return -EINVAL;
+
+    return 0;
+}
+
 GDB_DECLARE_HANDLER(ReadRegister)
 {
     if(ctx->selectedThreadId == 0)
@@ -80,6 +103,9 @@ GDB_DECLARE_HANDLER(ReadRegister)
     if(GDB_ParseHexIntegerList(&gdbRegNum, ctx->commandData, 1, 0) == NULL)
         return GDB_ReplyErrno(ctx, EILSEQ);
 
+    if(ctx->trace.frameSelected)
+        return GDB_SendTraceFrameRegister(ctx, gdbRegNum);
+
     u32 n = GDB_ConvertRegisterNumber(&flags, gdbRegNum);
     if(!flags)
         return GDB_ReplyErrno(ctx, EINVAL);
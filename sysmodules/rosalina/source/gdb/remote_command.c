@@ -39,6 +39,55 @@ static const char *GDB_SkipSpaces(const char *pos)
     return nextpos;
 }
 
+// "convertvatopa va size": lists the physically contiguous runs of a range of the process, in one SVC
+static int GDB_HandleConvertVARangeToPA(GDBContext *ctx, u32 va, const char *sizeStr)
+{
+    bool    ok;
+    int     n = 0;
+    u32     size;
+    char *  end;
+    Handle  process;
+    Result  r;
+    PhysicalRun runs[6]; // what fits in outbuf
+    char    outbuf[GDB_BUF_LEN / 2 + 1];
+
+    size = xstrtoul(sizeStr, &end, 0, true, &ok);
+    if(!ok || *GDB_SkipSpaces(end) != 0)
+        return GDB_ReplyErrno(ctx, EILSEQ);
+
+    r = svcOpenProcess(&process, ctx->pid);
+    if(R_FAILED(r))
+    {
+        n = sprintf(outbuf, "Invalid process (wtf?)\n");
+        goto end;
+    }
+
+    r = svcConvertVARangeToPA(runs, sizeof(runs) / sizeof(runs[0]), process, va, size);
+    svcCloseHandle(process);
+
+    if(R_FAILED(r))
+    {
+        n = sprintf(outbuf, "An error occured: %08lX\n", r);
+        goto end;
+    }
+
+    for(s32 i = 0; i < r; i++)
+    {
+        u32 perm = PHYSRUN_PERM(runs[i].attributes);
+        n += sprintf(outbuf + n, "va: 0x%08lX, pa: 0x%08lX, size: 0x%08lX, %c%c%c, type: 0x%02lX%s\n", runs[i].va, runs[i].pa, runs[i].size,
+                     (perm & MEMPERM_READ) ? 'r' : '-', (perm & MEMPERM_WRITE) ? 'w' : '-', (perm & MEMPERM_EXECUTE) ? 'x' : '-',
+                     PHYSRUN_MEMTYPE(runs[i].attributes), PHYSRUN_SHARED(runs[i].attributes) ? ", shared" : "");
+    }
+
+    if(r == 0)
+        n = sprintf(outbuf, "Nothing is mapped in this range\n");
+    else if((u32)r == sizeof(runs) / sizeof(runs[0]) && runs[r - 1].va + runs[r - 1].size < va + size)
+        n += sprintf(outbuf + n, "(more runs past 0x%08lX)\n", runs[r - 1].va + runs[r - 1].size);
+
+end:
+    return GDB_SendHexPacket(ctx, outbuf, n);
+}
+
 GDB_DECLARE_REMOTE_COMMAND_HANDLER(ConvertVAToPA)
 {
     bool    ok;
@@ -56,6 +105,10 @@ GDB_DECLARE_REMOTE_COMMAND_HANDLER(ConvertVAToPA)
     if(!ok)
         return GDB_ReplyErrno(ctx, EILSEQ);
 
+    end = (char *)GDB_SkipSpaces(end);
+    if(*end != 0)
+        return GDB_HandleConvertVARangeToPA(ctx, val, end);
+
     if (val >= 0x40000000)
         pa = svcConvertVAToPA((const void *)val, false);
     else
@@ -17,6 +17,7 @@
 #include "gdb/watchpoints.h"
 #include "gdb/breakpoints.h"
 #include "gdb/stop_point.h"
+#include "gdb/non_stop.h"
 #include "task_runner.h"
 
 Result GDB_InitializeServer(GDBServer *server)
@@ -35,6 +36,7 @@ Result GDB_InitializeServer(GDBServer *server)
     server->super.free      = (sock_free_func)    GDB_ReleaseClient;
 
     server->super.clients_per_server = 1;
+    server->super.max_clients = MAX_DEBUG;
 
     server->referenceCount = 0;
     svcCreateEvent(&server->statusUpdated, RESET_ONESHOT);
@@ -44,6 +46,7 @@ Result GDB_InitializeServer(GDBServer *server)
         GDB_InitializeContext(server->ctxs + i);
 
     GDB_ResetWatchpoints();
+    GDB_InitializeNonStopMode();
 
     return 0;
 }
@@ -202,6 +205,7 @@ int GDB_CloseClient(GDBContext *ctx)
     ctx->multiprocessExtEnabled = false;
 
     memset(&ctx->latestDebugEvent, 0, sizeof(DebugEventInfo));
+    memset(&ctx->nonStop, 0, sizeof(GDBNonStopState));
     memset(ctx->memoryOsInfoXmlData, 0, sizeof(ctx->memoryOsInfoXmlData));
     memset(ctx->processesOsInfoXmlData, 0, sizeof(ctx->processesOsInfoXmlData));
 
@@ -274,6 +278,12 @@ GDBContext *GDB_GetClient(GDBServer *server, u16 port)
         while (!ok);
     }
 
+    if (ctx != NULL)
+    {
+        ctx->super.send_queue = ctx->sendQueue;
+        ctx->super.send_queue_size = sizeof(ctx->sendQueue);
+    }
+
     return ctx;
 }
 
@@ -340,6 +350,7 @@ int GDB_DoPacket(GDBContext *ctx)
         ret = -1;
     else if(ctx->buffer[0] == '\x03')
     {
+        GDB_BreakProcessForNonStop(ctx);
         GDB_HandleBreak(ctx);
         ret = 0;
     }
@@ -347,6 +358,11 @@ int GDB_DoPacket(GDBContext *ctx)
     {
         GDBCommandHandler handler = GDB_GetCommandHandler(ctx->buffer[1]);
         ctx->commandData = ctx->buffer + 2;
+
+        // In non-stop mode, these need registers (stop replies, steps)
+        if(ctx->buffer[1] != 0 && strchr("?gGpPv", ctx->buffer[1]) != NULL)
+            GDB_BreakProcessForNonStop(ctx);
+
         ret = handler(ctx);
     }
     else
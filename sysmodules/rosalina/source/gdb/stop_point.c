@@ -10,6 +10,45 @@
 #include "gdb/watchpoints.h"
 #include "gdb/breakpoints.h"
 #include "gdb/stop_point.h"
+#include "gdb/agent.h"
+
+#define _REENT_ONLY
+#include <errno.h>
+
+// Parses the ";X<len>,<bytecode>" breakpoint conditions, stored as (u16 size, bytecode) pairs
+static const char *GDB_ParseBreakpointConditions(u8 *conditions, u32 *conditionsSize, const char *pos, int *res)
+{
+    *conditionsSize = 0;
+    *res = 0;
+
+    while(strncmp(pos, ";X", 2) == 0)
+    {
+        u32 len;
+        pos = GDB_ParseHexIntegerList(&len, pos + 2, 1, ',');
+        if(pos == NULL || *pos != ',')
+            return NULL;
+        else if(len > GDB_AGENT_MAX_BYTECODE_SIZE || *conditionsSize + 2 + len > MAX_BREAKPOINT_CONDITIONS_SIZE)
+        {
+            *res = -ENOSPC;
+            return pos;
+        }
+
+        u8 *bytecode = conditions + *conditionsSize + 2;
+        if(GDB_DecodeHex(bytecode, ++pos, len) != len)
+            return NULL;
+        pos += 2 * len;
+
+        *res = GDB_AgentVerify(bytecode, len);
+        if(*res != 0)
+            return pos;
+
+        conditions[*conditionsSize] = len & 0xFF;
+        conditions[*conditionsSize + 1] = len >> 8;
+        *conditionsSize += 2 + len;
+    }
+
+    return pos;
+}
 
 GDB_DECLARE_HANDLER(ToggleStopPoint)
 {
@@ -19,13 +58,23 @@ GDB_DECLARE_HANDLER(ToggleStopPoint)
     const char *pos = GDB_ParseHexIntegerList(lst, ctx->commandData, 3, ';');
     if(pos == NULL)
         return GDB_ReplyErrno(ctx, EILSEQ);
+
+    u8 conditions[MAX_BREAKPOINT_CONDITIONS_SIZE];
+    u32 conditionsSize;
+    int res;
+
+    pos = GDB_ParseBreakpointConditions(conditions, &conditionsSize, pos, &res);
+    if(pos == NULL)
+        return GDB_ReplyErrno(ctx, EILSEQ);
+    else if(res != 0)
+        return GDB_ReplyErrno(ctx, -res);
+
     bool persist = *pos != 0 && strncmp(pos, ";cmds:1", 7) == 0;
 
     u32 kind = lst[0];
     u32 addr = lst[1];
     u32 size = lst[2];
 
-    int res;
     static const WatchpointKind kinds[3] = { WATCHPOINT_WRITE, WATCHPOINT_READ, WATCHPOINT_READWRITE };
     switch(kind)
     {
@@ -34,7 +83,7 @@ GDB_DECLARE_HANDLER(ToggleStopPoint)
                 return GDB_ReplyEmpty(ctx);
             else
             {
-                res = add ? GDB_AddBreakpoint(ctx, addr, size == 2, persist) :
+                res = add ? GDB_AddBreakpoint(ctx, addr, size == 2, persist, conditions, conditionsSize) :
                             GDB_RemoveBreakpoint(ctx, addr);
                 return res == 0 ? GDB_ReplyOk(ctx) : GDB_ReplyErrno(ctx, -res);
             }
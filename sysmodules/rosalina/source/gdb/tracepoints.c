@@ -0,0 +1,1106 @@
+/*
+*   This file is part of Luma3DS.
+*   Copyright (C) 2016-2020 Aurora Wright, TuxSH
+*
+*   SPDX-License-Identifier: (MIT OR GPL-2.0-or-later)
+*/
+
+#include "gdb/tracepoints.h"
+#include "gdb/breakpoints.h"
+#include "gdb/agent.h"
+#include "gdb/regs.h"
+#include "gdb/mem.h"
+#include "gdb/net.h"
+#include "gdb/server.h"
+
+#define _REENT_ONLY
+#include <errno.h>
+
+/*
+    Trace frames: u16 tracepoint number, u32 data size, then blocks:
+        'R' ThreadContext (same layout as 'g')
+        'M' u64 address, u16 size, data
+        'V' u32 variable number, s64 value
+    all little-endian and unaligned.
+
+    Tracepoint actions, in the actions pool:
+        'M' s32 base register (-1 for absolute addresses), u32 offset, u32 size
+        'X' u16 size, bytecode
+*/
+
+#define TRACE_FRAME_HEADER_SIZE     6
+#define TRACE_BLOCK_R_SIZE          (1 + sizeof(ThreadContext))
+#define TRACE_BLOCK_M_HEADER_SIZE   11
+#define TRACE_BLOCK_V_SIZE          13
+
+#define TRACE_ACTION_M_SIZE         13
+#define TRACE_ACTION_X_HEADER_SIZE  3
+
+// Frames are built here, then copied to the ring. Only the debug thread collects frames
+static u8 traceFrameStaging[GDB_TRACE_MAX_FRAME_SIZE];
+
+typedef struct TraceCollector
+{
+    GDBContext *ctx;
+    const ThreadContext *regs;
+    u32 size;
+} TraceCollector;
+
+static inline u16 GDB_TraceRead16(const u8 *p)
+{
+    u16 v;
+    memcpy(&v, p, 2);
+    return v;
+}
+
+static inline u32 GDB_TraceRead32(const u8 *p)
+{
+    u32 v;
+    memcpy(&v, p, 4);
+    return v;
+}
+
+// Parses a hex number, with an optional minus sign. Returns NULL if there are no digits
+static const char *GDB_TraceParseHex(u64 *out, const char *pos)
+{
+    bool negative = *pos == '-';
+    char *end;
+    bool ok;
+
+    if(negative)
+        pos++;
+
+    u64 val = xstrtoull(pos, &end, 16, false, &ok);
+    if(!ok || end == pos)
+        return NULL;
+
+    *out = negative ? -val : val;
+    return end;
+}
+
+static Tracepoint *GDB_FindTracepoint(GDBTraceState *trace, u32 number, u32 address)
+{
+    for(u32 i = 0; i < trace->nbTracepoints; i++)
+    {
+        if(trace->tracepoints[i].number == number && trace->tracepoints[i].address == address)
+            return &trace->tracepoints[i];
+    }
+
+    return NULL;
+}
+
+static TraceStateVariable *GDB_FindTraceStateVariable(GDBTraceState *trace, u32 id)
+{
+    for(u32 i = 0; i < trace->nbVariables; i++)
+    {
+        if(trace->variables[i].number == id)
+            return &trace->variables[i];
+    }
+
+    return NULL;
+}
+
+bool GDB_GetTraceStateVariable(GDBContext *ctx, s64 *out, u32 id)
+{
+    TraceStateVariable *var = GDB_FindTraceStateVariable(&ctx->trace, id);
+    if(var == NULL)
+        return false;
+
+    *out = var->value;
+    return true;
+}
+
+bool GDB_SetTraceStateVariable(GDBContext *ctx, u32 id, s64 value)
+{
+    TraceStateVariable *var = GDB_FindTraceStateVariable(&ctx->trace, id);
+    if(var == NULL)
+        return false;
+
+    var->value = value;
+    return true;
+}
+
+/* Trace frames ring */
+
+static inline u32 GDB_TraceFrameSize(const GDBTraceState *trace, u32 offset)
+{
+    return TRACE_FRAME_HEADER_SIZE + GDB_TraceRead32(trace->buffer + offset + 2);
+}
+
+static inline u32 GDB_TraceNextFrame(const GDBTraceState *trace, u32 offset)
+{
+    offset += GDB_TraceFrameSize(trace, offset);
+    return trace->wrapped && offset == trace->wrapEnd ? 0 : offset;
+}
+
+static u32 GDB_TraceFindFrame(const GDBTraceState *trace, u32 n)
+{
+    u32 offset = trace->head;
+    for(u32 i = 0; i < n; i++)
+        offset = GDB_TraceNextFrame(trace, offset);
+
+    return offset;
+}
+
+static inline u32 GDB_TraceUsedSize(const GDBTraceState *trace)
+{
+    return trace->wrapped ? trace->wrapEnd - trace->head + trace->tail : trace->tail - trace->head;
+}
+
+static void GDB_TraceDropOldestFrame(GDBTraceState *trace)
+{
+    trace->head += GDB_TraceFrameSize(trace, trace->head);
+    trace->nbFrames--;
+
+    if(trace->wrapped && trace->head == trace->wrapEnd)
+    {
+        trace->head = 0;
+        trace->wrapped = false;
+    }
+}
+
+static bool GDB_TraceAllocateFrame(GDBTraceState *trace, u32 size, u32 *offset)
+{
+    if(size > trace->bufferSize)
+        return false;
+
+    for(;;)
+    {
+        if(trace->nbFrames == 0)
+        {
+            trace->head = trace->tail = trace->wrapEnd = 0;
+            trace->wrapped = false;
+        }
+
+        if(!trace->wrapped && trace->tail + size <= trace->bufferSize)
+        {
+            *offset = trace->tail;
+            trace->tail += size;
+            return true;
+        }
+        else if(!trace->wrapped && size <= trace->head)
+        {
+            trace->wrapEnd = trace->tail;
+            trace->wrapped = true;
+            *offset = 0;
+            trace->tail = size;
+            return true;
+        }
+        else if(trace->wrapped && trace->tail + size <= trace->head)
+        {
+            *offset = trace->tail;
+            trace->tail += size;
+            return true;
+        }
+        else if(!trace->circular)
+            return false;
+
+        GDB_TraceDropOldestFrame(trace);
+    }
+}
+
+static Result GDB_TraceAllocateBuffer(GDBContext *ctx, u32 size)
+{
+    GDBTraceState *trace = &ctx->trace;
+    u32 addr = GDB_TRACE_BUFFER_ADDR + (u32)(ctx - ctx->parent->ctxs) * GDB_TRACE_BUFFER_MAX_SIZE;
+    u32 tmp;
+
+    if(trace->buffer != NULL && trace->bufferSize == size)
+        return 0;
+    else if(trace->buffer != NULL)
+        svcControlMemory(&tmp, (u32)trace->buffer, 0, trace->bufferSize, MEMOP_FREE, 0);
+
+    trace->buffer = NULL;
+    trace->bufferSize = 0;
+
+    Result res = svcControlMemoryEx(&tmp, addr, 0, size, MEMOP_ALLOC | MEMOP_REGION_SYSTEM, MEMPERM_READWRITE, true);
+    if(R_SUCCEEDED(res))
+    {
+        trace->buffer = (u8 *)addr;
+        trace->bufferSize = size;
+    }
+
+    return res;
+}
+
+/* Collection */
+
+static bool GDB_TraceCollectorReadRegister(void *userdata, u64 *out, u32 gdbRegNum)
+{
+    TraceCollector *col = (TraceCollector *)userdata;
+    return GDB_ReadRegisterFromContext(out, col->regs, gdbRegNum) == 0;
+}
+
+static bool GDB_TraceCollectorReadMemory(void *userdata, void *out, u32 address, u32 size)
+{
+    TraceCollector *col = (TraceCollector *)userdata;
+    return R_SUCCEEDED(svcReadProcessMemory(out, col->ctx->debug, address, size));
+}
+
+static bool GDB_TraceCollectorGetVariable(void *userdata, s64 *out, u32 id)
+{
+    TraceCollector *col = (TraceCollector *)userdata;
+    return GDB_GetTraceStateVariable(col->ctx, out, id);
+}
+
+static bool GDB_TraceCollectorSetVariable(void *userdata, u32 id, s64 value)
+{
+    TraceCollector *col = (TraceCollector *)userdata;
+    return GDB_SetTraceStateVariable(col->ctx, id, value);
+}
+
+// Memory that doesn't fit in the frame is silently truncated
+static bool GDB_TraceCollectorCollectMemory(void *userdata, u32 address, u32 size, bool stopAtZero)
+{
+    TraceCollector *col = (TraceCollector *)userdata;
+    u8 *block = traceFrameStaging + col->size;
+
+    if(col->size + TRACE_BLOCK_M_HEADER_SIZE >= GDB_TRACE_MAX_FRAME_SIZE)
+        return true;
+    else if(size == 0)
+        return true;
+
+    u32 maxSize = GDB_TRACE_MAX_FRAME_SIZE - col->size - TRACE_BLOCK_M_HEADER_SIZE;
+    size = size > maxSize ? maxSize : size;
+
+    u32 total = GDB_ReadTargetMemory(block + TRACE_BLOCK_M_HEADER_SIZE, col->ctx, address, size);
+    if(total == 0)
+        return false;
+
+    if(stopAtZero)
+    {
+        u8 *zero = memchr(block + TRACE_BLOCK_M_HEADER_SIZE, 0, total);
+        if(zero != NULL)
+            total = zero - (block + TRACE_BLOCK_M_HEADER_SIZE) + 1;
+    }
+
+    u64 address64 = address;
+    u16 size16 = (u16)total;
+    block[0] = 'M';
+    memcpy(block + 1, &address64, 8);
+    memcpy(block + 9, &size16, 2);
+    col->size += TRACE_BLOCK_M_HEADER_SIZE + total;
+
+    return true;
+}
+
+static bool GDB_TraceCollectorCollectVariable(void *userdata, u32 id)
+{
+    TraceCollector *col = (TraceCollector *)userdata;
+    u8 *block = traceFrameStaging + col->size;
+    s64 value;
+
+    if(!GDB_GetTraceStateVariable(col->ctx, &value, id))
+        return false;
+    else if(col->size + TRACE_BLOCK_V_SIZE > GDB_TRACE_MAX_FRAME_SIZE)
+        return true;
+
+    block[0] = 'V';
+    memcpy(block + 1, &id, 4);
+    memcpy(block + 5, &value, 8);
+    col->size += TRACE_BLOCK_V_SIZE;
+
+    return true;
+}
+
+static const GDBAgentOps traceCollectorOps =
+{
+    GDB_TraceCollectorReadRegister,
+    GDB_TraceCollectorReadMemory,
+    GDB_TraceCollectorGetVariable,
+    GDB_TraceCollectorSetVariable,
+    GDB_TraceCollectorCollectMemory,
+    GDB_TraceCollectorCollectVariable,
+};
+
+static void GDB_StopTrace(GDBContext *ctx, TraceStopReason reason, u32 tracepointNumber)
+{
+    GDBTraceState *trace = &ctx->trace;
+
+    if(!trace->running)
+        return;
+
+    for(u32 i = 0; i < trace->nbTracepoints; i++)
+        GDB_RemoveTracepointBreakpoint(ctx, trace->tracepoints[i].address); // fails for duplicates
+
+    trace->running = false;
+    trace->stopReason = reason;
+    trace->stoppingTracepoint = tracepointNumber;
+}
+
+static void GDB_CollectTraceFrame(GDBContext *ctx, Tracepoint *tp, const ThreadContext *regs)
+{
+    GDBTraceState *trace = &ctx->trace;
+    TraceCollector col = { ctx, regs, TRACE_FRAME_HEADER_SIZE };
+    s64 result;
+
+    if(tp->conditionSize != 0)
+    {
+        if(GDB_AgentEvaluate(&result, trace->actions + tp->conditionOffset, tp->conditionSize, &traceCollectorOps, &col) != 0)
+        {
+            GDB_StopTrace(ctx, TRACE_STOP_ERROR, tp->number);
+            return;
+        }
+        else if(result == 0)
+            return;
+    }
+
+    tp->hitCount++;
+
+    if(tp->collectRegisters)
+    {
+        traceFrameStaging[col.size] = 'R';
+        memcpy(traceFrameStaging + col.size + 1, regs, sizeof(ThreadContext));
+        col.size += TRACE_BLOCK_R_SIZE;
+    }
+
+    const u8 *actions = trace->actions + tp->actionsOffset;
+    for(u32 pos = 0; pos < tp->actionsSize;)
+    {
+        if(actions[pos] == 'M')
+        {
+            s32 baseReg = (s32)GDB_TraceRead32(actions + pos + 1);
+            u32 address = GDB_TraceRead32(actions + pos + 5);
+            u64 base = 0;
+
+            // Unreadable memory is just not collected, like gdbserver
+            if(baseReg < 0 || GDB_ReadRegisterFromContext(&base, regs, (u32)baseReg) == 0)
+                GDB_TraceCollectorCollectMemory(&col, (u32)base + address, GDB_TraceRead32(actions + pos + 9), false);
+
+            pos += TRACE_ACTION_M_SIZE;
+        }
+        else
+        {
+            u32 size = GDB_TraceRead16(actions + pos + 1);
+            GDB_AgentEvaluate(&result, actions + pos + TRACE_ACTION_X_HEADER_SIZE, size, &traceCollectorOps, &col);
+            pos += TRACE_ACTION_X_HEADER_SIZE + size;
+        }
+    }
+
+    u16 number = (u16)tp->number;
+    u32 dataSize = col.size - TRACE_FRAME_HEADER_SIZE;
+    u32 offset;
+
+    memcpy(traceFrameStaging, &number, 2);
+    memcpy(traceFrameStaging + 2, &dataSize, 4);
+
+    if(!GDB_TraceAllocateFrame(trace, col.size, &offset))
+    {
+        GDB_StopTrace(ctx, TRACE_STOP_BUFFER_FULL, 0);
+        return;
+    }
+
+    memcpy(trace->buffer + offset, traceFrameStaging, col.size);
+    trace->nbFrames++;
+    trace->nbCreatedFrames++;
+    tp->usage += col.size;
+
+    if(tp->passCount != 0 && tp->hitCount >= tp->passCount)
+        GDB_StopTrace(ctx, TRACE_STOP_PASS_COUNT, tp->number);
+}
+
+void GDB_CollectTraceFrames(GDBContext *ctx, u32 threadId, const ThreadContext *regs)
+{
+    GDBTraceState *trace = &ctx->trace;
+    u32 pc = regs->cpu_registers.pc;
+    bool alreadyCollected = trace->lastHitThreadId == threadId && trace->lastHitAddress == pc;
+
+    trace->lastHitThreadId = trace->lastHitAddress = 0;
+    if(alreadyCollected)
+        return;
+
+    for(u32 i = 0; i < trace->nbTracepoints && trace->running; i++)
+    {
+        Tracepoint *tp = &trace->tracepoints[i];
+        if(tp->enabled && tp->address == pc)
+            GDB_CollectTraceFrame(ctx, tp, regs);
+    }
+}
+
+static void GDB_ResetTrace(GDBContext *ctx)
+{
+    GDBTraceState *trace = &ctx->trace;
+
+    GDB_StopTrace(ctx, TRACE_STOP_COMMAND, 0);
+
+    trace->stopReason = TRACE_STOP_NOT_RUN;
+    trace->stoppingTracepoint = 0;
+    trace->nbTracepoints = 0;
+    trace->actionsSize = 0;
+    trace->nbVariables = 0;
+    trace->nbReadOnlyRanges = 0;
+    trace->head = trace->tail = trace->wrapEnd = 0;
+    trace->wrapped = false;
+    trace->nbFrames = trace->nbCreatedFrames = 0;
+    trace->frameSelected = false;
+}
+
+void GDB_FinalizeTrace(GDBContext *ctx)
+{
+    GDBTraceState *trace = &ctx->trace;
+    u32 tmp;
+
+    GDB_ResetTrace(ctx);
+    if(trace->buffer != NULL)
+        svcControlMemory(&tmp, (u32)trace->buffer, 0, trace->bufferSize, MEMOP_FREE, 0);
+
+    memset(trace, 0, sizeof(GDBTraceState));
+}
+
+/* Looking at trace frames */
+
+// Returns the offset of the block of the selected frame, or 0
+static u32 GDB_FindTraceFrameBlock(const GDBTraceState *trace, char type, u32 *iter)
+{
+    u32 frame = GDB_TraceFindFrame(trace, trace->currentFrame);
+    u32 end = frame + GDB_TraceFrameSize(trace, frame);
+    u32 pos = *iter == 0 ? frame + TRACE_FRAME_HEADER_SIZE : *iter;
+
+    while(pos < end)
+    {
+        u8 blockType = trace->buffer[pos];
+        u32 blockSize;
+
+        if(blockType == 'R')
+            blockSize = TRACE_BLOCK_R_SIZE;
+        else if(blockType == 'M')
+            blockSize = TRACE_BLOCK_M_HEADER_SIZE + GDB_TraceRead16(trace->buffer + pos + 9);
+        else
+            blockSize = TRACE_BLOCK_V_SIZE;
+
+        *iter = pos + blockSize;
+        if(blockType == type)
+            return pos;
+
+        pos += blockSize;
+    }
+
+    return 0;
+}
+
+static const Tracepoint *GDB_GetTraceFrameTracepoint(GDBTraceState *trace, u32 frame)
+{
+    u32 number = GDB_TraceRead16(trace->buffer + frame);
+    for(u32 i = 0; i < trace->nbTracepoints; i++)
+    {
+        if(trace->tracepoints[i].number == number)
+            return &trace->tracepoints[i];
+    }
+
+    return NULL;
+}
+
+static bool GDB_GetTraceFrameRegisters(GDBContext *ctx, ThreadContext *regs)
+{
+    u32 iter = 0;
+    u32 block = GDB_FindTraceFrameBlock(&ctx->trace, 'R', &iter);
+
+    if(block == 0)
+        return false;
+
+    memcpy(regs, ctx->trace.buffer + block + 1, sizeof(ThreadContext));
+    return true;
+}
+
+// Without collected registers, only PC is known
+static u32 GDB_GetTraceFramePc(GDBContext *ctx)
+{
+    const Tracepoint *tp = GDB_GetTraceFrameTracepoint(&ctx->trace, GDB_TraceFindFrame(&ctx->trace, ctx->trace.currentFrame));
+    return tp != NULL ? tp->address : 0;
+}
+
+int GDB_SendTraceFrameRegisters(GDBContext *ctx)
+{
+    ThreadContext regs;
+    char buf[2 * sizeof(ThreadContext)];
+
+    if(GDB_GetTraceFrameRegisters(ctx, &regs))
+        return GDB_SendHexPacket(ctx, &regs, sizeof(ThreadContext));
+
+    u32 pc = GDB_GetTraceFramePc(ctx);
+    memset(buf, 'x', sizeof(buf));
+    GDB_EncodeHex(buf + 2 * offsetof(CpuRegisters, pc), &pc, 4);
+
+    return GDB_SendPacket(ctx, buf, sizeof(buf));
+}
+
+int GDB_SendTraceFrameRegister(GDBContext *ctx, u32 gdbRegNum)
+{
+    ThreadContext regs;
+    u32 size = gdbRegNum >= 26 && gdbRegNum <= 41 ? 8 : 4;
+    u64 value;
+
+    if(GDB_GetTraceFrameRegisters(ctx, &regs))
+    {
+        if(GDB_ReadRegisterFromContext(&value, &regs, gdbRegNum) != 0)
+            return GDB_ReplyErrno(ctx, EINVAL);
+
+        return GDB_SendHexPacket(ctx, &value, size);
+    }
+    else if(gdbRegNum == 15)
+    {
+        u32 pc = GDB_GetTraceFramePc(ctx);
+        return GDB_SendHexPacket(ctx, &pc, 4);
+    }
+    else
+        return GDB_SendPacket(ctx, "xxxxxxxxxxxxxxxx", 2 * size);
+}
+
+int GDB_SendTraceFrameMemory(GDBContext *ctx, u32 addr, u32 len)
+{
+    GDBTraceState *trace = &ctx->trace;
+    u8 data[GDB_BUF_LEN / 2 - 4];
+    u32 total = 0;
+
+    len = len > sizeof(data) ? sizeof(data) : len;
+
+    // Only the part that is available from the start is sent
+    while(total < len)
+    {
+        u32 iter = 0, block, cur = addr + total, n = 0;
+
+        while((block = GDB_FindTraceFrameBlock(trace, 'M', &iter)) != 0)
+        {
+            u32 blockAddr = GDB_TraceRead32(trace->buffer + block + 1);
+            u32 blockSize = GDB_TraceRead16(trace->buffer + block + 9);
+
+            if(cur - blockAddr < blockSize)
+            {
+                n = blockSize - (cur - blockAddr);
+                n = n > len - total ? len - total : n;
+                memcpy(data + total, trace->buffer + block + TRACE_BLOCK_M_HEADER_SIZE + (cur - blockAddr), n);
+                break;
+            }
+        }
+
+        for(u32 i = 0; n == 0 && i < trace->nbReadOnlyRanges; i++)
+        {
+            u32 start = trace->readOnlyRanges[i][0], end = trace->readOnlyRanges[i][1];
+            if(cur >= start && cur < end)
+            {
+                n = end - cur;
+                n = n > len - total ? len - total : n;
+                n = GDB_ReadTargetMemory(data + total, ctx, cur, n);
+            }
+        }
+
+        if(n == 0)
+            break;
+
+        total += n;
+    }
+
+    if(total == 0 && len != 0)
+        return GDB_ReplyErrno(ctx, EFAULT);
+
+    return GDB_SendHexPacket(ctx, data, total);
+}
+
+/* Packets */
+
+GDB_DECLARE_QUERY_HANDLER(TraceInit)
+{
+    GDB_ResetTrace(ctx);
+    return GDB_ReplyOk(ctx);
+}
+
+static int GDB_AppendTracepointBytecode(GDBTraceState *trace, const char **pos, u8 prefix)
+{
+    u64 size;
+    u32 headerSize = prefix != 0 ? TRACE_ACTION_X_HEADER_SIZE : 0;
+    const char *p = GDB_TraceParseHex(&size, *pos);
+
+    if(p == NULL || *p != ',')
+        return -EILSEQ;
+    else if(size > GDB_AGENT_MAX_BYTECODE_SIZE || trace->actionsSize + headerSize + size > sizeof(trace->actions))
+        return -ENOSPC;
+
+    u8 *out = trace->actions + trace->actionsSize;
+    if(GDB_DecodeHex(out + headerSize, p + 1, (u32)size) != size)
+        return -EILSEQ;
+
+    int res = GDB_AgentVerify(out + headerSize, (u32)size);
+    if(res != 0)
+        return res;
+
+    if(prefix != 0)
+    {
+        u16 size16 = (u16)size;
+        out[0] = prefix;
+        memcpy(out + 1, &size16, 2);
+    }
+
+    trace->actionsSize += headerSize + (u32)size;
+    *pos = p + 1 + 2 * size;
+    return 0;
+}
+
+static int GDB_ParseTracepointActions(GDBTraceState *trace, Tracepoint *tp, const char *pos)
+{
+    while(*pos != 0 && *pos != '-')
+    {
+        switch(*pos++)
+        {
+            case 'R':
+            {
+                // Register mask, we always collect all of them
+                for(; (*pos >= '0' && *pos <= '9') || (*pos >= 'a' && *pos <= 'f') || (*pos >= 'A' && *pos <= 'F'); pos++)
+                    tp->collectRegisters |= *pos != '0';
+                break;
+            }
+
+            case 'M':
+            {
+                u64 baseReg, offset, size;
+                if((pos = GDB_TraceParseHex(&baseReg, pos)) == NULL || *pos++ != ',' ||
+                   (pos = GDB_TraceParseHex(&offset, pos)) == NULL || *pos++ != ',' ||
+                   (pos = GDB_TraceParseHex(&size, pos)) == NULL)
+                    return -EILSEQ;
+                else if(trace->actionsSize + TRACE_ACTION_M_SIZE > sizeof(trace->actions))
+                    return -ENOSPC;
+
+                u8 *out = trace->actions + trace->actionsSize;
+                s32 baseReg32 = (u32)baseReg == 0xFFFFFFFF ? -1 : (s32)baseReg;
+                u32 offset32 = (u32)offset, size32 = size > GDB_TRACE_MAX_FRAME_SIZE ? GDB_TRACE_MAX_FRAME_SIZE : (u32)size;
+
+                out[0] = 'M';
+                memcpy(out + 1, &baseReg32, 4);
+                memcpy(out + 5, &offset32, 4);
+                memcpy(out + 9, &size32, 4);
+                trace->actionsSize += TRACE_ACTION_M_SIZE;
+                break;
+            }
+
+            case 'X':
+            {
+                int res = GDB_AppendTracepointBytecode(trace, &pos, 'X');
+                if(res != 0)
+                    return res;
+                break;
+            }
+
+            case 'S': // while-stepping, we can't single-step
+                return -ENOTSUP;
+
+            default:
+                return -EILSEQ;
+        }
+
+        tp->actionsSize = trace->actionsSize - tp->actionsOffset;
+    }
+
+    return 0;
+}
+
+// QTDP:<n>:<addr>:<E|D>:<step>:<pass>[:X<len>,<cond>][-] and QTDP:-<n>:<addr>:<actions>[-]
+GDB_DECLARE_QUERY_HANDLER(DefineTracepoint)
+{
+    GDBTraceState *trace = &ctx->trace;
+    const char *pos = ctx->commandData;
+    u64 number, address, stepCount, passCount;
+    int res;
+
+    if(trace->running)
+        return GDB_ReplyErrno(ctx, EBUSY);
+
+    bool isAction = *pos == '-';
+    if(isAction)
+        pos++;
+
+    if((pos = GDB_TraceParseHex(&number, pos)) == NULL || *pos++ != ':' ||
+       (pos = GDB_TraceParseHex(&address, pos)) == NULL || *pos++ != ':')
+        return GDB_ReplyErrno(ctx, EILSEQ);
+
+    if(isAction)
+    {
+        Tracepoint *tp = GDB_FindTracepoint(trace, (u32)number, (u32)address);
+
+        // The actions follow the definition of the tracepoint
+        if(tp == NULL || tp->actionsOffset + tp->actionsSize != trace->actionsSize)
+            return GDB_ReplyErrno(ctx, EINVAL);
+
+        res = GDB_ParseTracepointActions(trace, tp, pos);
+        return res == 0 ? GDB_ReplyOk(ctx) : GDB_ReplyErrno(ctx, -res);
+    }
+
+    bool enabled = *pos == 'E';
+    if((*pos != 'E' && *pos != 'D') || pos[1] != ':')
+        return GDB_ReplyErrno(ctx, EILSEQ);
+
+    pos += 2;
+    if((pos = GDB_TraceParseHex(&stepCount, pos)) == NULL || *pos++ != ':' ||
+       (pos = GDB_TraceParseHex(&passCount, pos)) == NULL)
+        return GDB_ReplyErrno(ctx, EILSEQ);
+    else if(stepCount != 0 || *pos == 'F' || *pos == 'S') // while-stepping, fast and static tracepoints
+        return GDB_ReplyErrno(ctx, ENOTSUP);
+    else if(GDB_FindTracepoint(trace, (u32)number, (u32)address) != NULL)
+        return GDB_ReplyErrno(ctx, EEXIST);
+    else if(trace->nbTracepoints == MAX_TRACEPOINT)
+        return GDB_ReplyErrno(ctx, ENOSPC);
+
+    Tracepoint *tp = &trace->tracepoints[trace->nbTracepoints];
+    memset(tp, 0, sizeof(Tracepoint));
+    tp->number = (u32)number;
+    tp->address = (u32)address & ~1;
+    tp->thumb = ((u32)address & 3) != 0; // GDB doesn't tell, assume ARM for 4-byte aligned addresses
+    tp->enabled = enabled;
+    tp->passCount = (u32)passCount;
+
+    u32 actionsSize = trace->actionsSize;
+    if(strncmp(pos, ":X", 2) == 0)
+    {
+        pos += 2;
+        res = GDB_AppendTracepointBytecode(trace, &pos, 0);
+        if(res != 0)
+            return GDB_ReplyErrno(ctx, -res);
+
+        tp->conditionOffset = actionsSize;
+        tp->conditionSize = trace->actionsSize - actionsSize;
+    }
+
+    if(*pos != 0 && *pos != '-')
+    {
+        trace->actionsSize = actionsSize;
+        return GDB_ReplyErrno(ctx, EILSEQ);
+    }
+
+    tp->actionsOffset = trace->actionsSize;
+    trace->nbTracepoints++;
+
+    return GDB_ReplyOk(ctx);
+}
+
+// QTDV:<n>:<value>:<builtin>:<name>
+GDB_DECLARE_QUERY_HANDLER(DefineTraceStateVariable)
+{
+    GDBTraceState *trace = &ctx->trace;
+    const char *pos = ctx->commandData;
+    u64 number, value;
+
+    if((pos = GDB_TraceParseHex(&number, pos)) == NULL || *pos++ != ':' ||
+       (pos = GDB_TraceParseHex(&value, pos)) == NULL)
+        return GDB_ReplyErrno(ctx, EILSEQ);
+
+    TraceStateVariable *var = GDB_FindTraceStateVariable(trace, (u32)number);
+    if(var == NULL)
+    {
+        if(trace->nbVariables == MAX_TRACE_STATE_VARIABLE)
+            return GDB_ReplyErrno(ctx, ENOSPC);
+
+        var = &trace->variables[trace->nbVariables++];
+        var->number = (u32)number;
+    }
+
+    var->initialValue = var->value = (s64)value;
+    return GDB_ReplyOk(ctx);
+}
+
+static int GDB_ToggleTracepoint(GDBContext *ctx, bool enable)
+{
+    u64 number, address;
+    const char *pos = ctx->commandData;
+
+    if((pos = GDB_TraceParseHex(&number, pos)) == NULL || *pos++ != ':' ||
+       (pos = GDB_TraceParseHex(&address, pos)) == NULL)
+        return GDB_ReplyErrno(ctx, EILSEQ);
+
+    Tracepoint *tp = GDB_FindTracepoint(&ctx->trace, (u32)number, (u32)address & ~1);
+    if(tp == NULL)
+        return GDB_ReplyErrno(ctx, EINVAL);
+
+    tp->enabled = enable;
+    return GDB_ReplyOk(ctx);
+}
+
+GDB_DECLARE_QUERY_HANDLER(EnableTracepoint)
+{
+    return GDB_ToggleTracepoint(ctx, true);
+}
+
+GDB_DECLARE_QUERY_HANDLER(DisableTracepoint)
+{
+    return GDB_ToggleTracepoint(ctx, false);
+}
+
+GDB_DECLARE_QUERY_HANDLER(TraceStart)
+{
+    GDBTraceState *trace = &ctx->trace;
+
+    GDB_StopTrace(ctx, TRACE_STOP_COMMAND, 0);
+
+    u32 size = trace->requestedBufferSize != 0 ? trace->requestedBufferSize : GDB_TRACE_BUFFER_DEFAULT_SIZE;
+    if(R_FAILED(GDB_TraceAllocateBuffer(ctx, size)))
+        return GDB_ReplyErrno(ctx, ENOMEM);
+
+    trace->head = trace->tail = trace->wrapEnd = 0;
+    trace->wrapped = false;
+    trace->nbFrames = trace->nbCreatedFrames = 0;
+    trace->frameSelected = false;
+    trace->lastHitThreadId = trace->lastHitAddress = 0;
+
+    for(u32 i = 0; i < trace->nbVariables; i++)
+        trace->variables[i].value = trace->variables[i].initialValue;
+
+    // Disabled tracepoints get their breakpoint too, they can be enabled while tracing
+    for(u32 i = 0; i < trace->nbTracepoints; i++)
+    {
+        Tracepoint *tp = &trace->tracepoints[i];
+        tp->hitCount = tp->usage = 0;
+
+        int res = GDB_AddTracepointBreakpoint(ctx, tp->address, tp->thumb);
+        if(res != 0)
+        {
+            for(u32 j = 0; j < i; j++)
+                GDB_RemoveTracepointBreakpoint(ctx, trace->tracepoints[j].address);
+            return GDB_ReplyErrno(ctx, -res);
+        }
+    }
+
+    trace->running = true;
+    return GDB_ReplyOk(ctx);
+}
+
+GDB_DECLARE_QUERY_HANDLER(TraceStop)
+{
+    GDB_StopTrace(ctx, TRACE_STOP_COMMAND, 0);
+    return GDB_ReplyOk(ctx);
+}
+
+static inline u32 GDB_GetTraceFrameAddress(GDBTraceState *trace, u32 frame)
+{
+    const Tracepoint *tp = GDB_GetTraceFrameTracepoint(trace, frame);
+    return tp != NULL ? tp->address : 0;
+}
+
+// QTFrame:<n>, QTFrame:pc:<addr>, QTFrame:tdp:<n>, QTFrame:range:<start>:<end>, QTFrame:outside:<start>:<end>
+GDB_DECLARE_QUERY_HANDLER(SelectTraceFrame)
+{
+    GDBTraceState *trace = &ctx->trace;
+    const char *pos = ctx->commandData;
+    u64 lst[2] = { 0 };
+    u32 mode;
+
+    static const char *modes[] = { "pc:", "tdp:", "range:", "outside:" };
+    for(mode = 0; mode < 4 && strncmp(pos, modes[mode], strlen(modes[mode])) != 0; mode++);
+
+    if(mode < 4)
+        pos += strlen(modes[mode]);
+
+    if((pos = GDB_TraceParseHex(&lst[0], pos)) == NULL)
+        return GDB_ReplyErrno(ctx, EILSEQ);
+    else if((mode == 2 || mode == 3) && (*pos++ != ':' || (pos = GDB_TraceParseHex(&lst[1], pos)) == NULL))
+        return GDB_ReplyErrno(ctx, EILSEQ);
+
+    if(mode == 4 && (u32)lst[0] == 0xFFFFFFFF)
+    {
+        trace->frameSelected = false;
+        return GDB_ReplyOk(ctx);
+    }
+
+    // Searches start after the selected frame
+    u32 n = mode == 4 ? (u32)lst[0] : (trace->frameSelected ? trace->currentFrame + 1 : 0);
+    u32 frame = n < trace->nbFrames ? GDB_TraceFindFrame(trace, n) : 0;
+
+    for(; n < trace->nbFrames; n++, frame = GDB_TraceNextFrame(trace, frame))
+    {
+        u32 address = GDB_GetTraceFrameAddress(trace, frame);
+        bool found;
+
+        switch(mode)
+        {
+            case 0: found = address == (u32)lst[0]; break;
+            case 1: found = GDB_TraceRead16(trace->buffer + frame) == (u32)lst[0]; break;
+            case 2: found = address >= (u32)lst[0] && address <= (u32)lst[1]; break;
+            case 3: found = address < (u32)lst[0] || address > (u32)lst[1]; break;
+            default: found = true; break;
+        }
+
+        if(found)
+        {
+            trace->frameSelected = true;
+            trace->currentFrame = n;
+            return GDB_SendFormattedPacket(ctx, "F%lxT%x", n, GDB_TraceRead16(trace->buffer + frame));
+        }
+    }
+
+    trace->frameSelected = false;
+    return GDB_SendPacket(ctx, "F-1", 3);
+}
+
+// QTBuffer:circular:<0|1>, QTBuffer:size:<size|-1>
+GDB_DECLARE_QUERY_HANDLER(SetTraceBufferOption)
+{
+    GDBTraceState *trace = &ctx->trace;
+    const char *pos = ctx->commandData;
+    u64 value;
+
+    if(strncmp(pos, "circular:", 9) == 0 && GDB_TraceParseHex(&value, pos + 9) != NULL)
+    {
+        trace->circular = value != 0;
+        return GDB_ReplyOk(ctx);
+    }
+    else if(strncmp(pos, "size:", 5) == 0 && GDB_TraceParseHex(&value, pos + 5) != NULL)
+    {
+        if(trace->running)
+            return GDB_ReplyErrno(ctx, EBUSY);
+        else if((s64)value == -1)
+            value = GDB_TRACE_BUFFER_DEFAULT_SIZE;
+        else if(value > GDB_TRACE_BUFFER_MAX_SIZE)
+            return GDB_ReplyErrno(ctx, ENOMEM);
+
+        trace->requestedBufferSize = value < 0x1000 ? 0x1000 : ((u32)value + 0xFFF) & ~0xFFF;
+        return GDB_ReplyOk(ctx);
+    }
+    else
+        return GDB_ReplyErrno(ctx, EILSEQ);
+}
+
+// QTro:<start>,<end>[:<start>,<end>...]
+GDB_DECLARE_QUERY_HANDLER(TraceReadOnlyRanges)
+{
+    GDBTraceState *trace = &ctx->trace;
+    const char *pos = ctx->commandData;
+    u64 start, end;
+
+    trace->nbReadOnlyRanges = 0;
+    while(*pos != 0 && trace->nbReadOnlyRanges < MAX_TRACE_READ_ONLY_RANGE)
+    {
+        if((pos = GDB_TraceParseHex(&start, pos)) == NULL || *pos++ != ',' || (pos = GDB_TraceParseHex(&end, pos)) == NULL)
+            return GDB_ReplyErrno(ctx, EILSEQ);
+
+        trace->readOnlyRanges[trace->nbReadOnlyRanges][0] = (u32)start;
+        trace->readOnlyRanges[trace->nbReadOnlyRanges++][1] = (u32)end;
+
+        if(*pos == ':')
+            pos++;
+    }
+
+    return GDB_ReplyOk(ctx);
+}
+
+GDB_DECLARE_QUERY_HANDLER(TraceDisconnected)
+{
+    // The trace is stopped on detach
+    return strcmp(ctx->commandData, "0") == 0 ? GDB_ReplyOk(ctx) : GDB_ReplyErrno(ctx, ENOTSUP);
+}
+
+GDB_DECLARE_QUERY_HANDLER(TraceStatus)
+{
+    GDBTraceState *trace = &ctx->trace;
+    char reason[64];
+
+    if(trace->running)
+        strcpy(reason, "tunknown:0");
+    else
+    {
+        switch(trace->stopReason)
+        {
+            case TRACE_STOP_COMMAND:
+                strcpy(reason, "tstop::0");
+                break;
+            case TRACE_STOP_BUFFER_FULL:
+                strcpy(reason, "tfull:0");
+                break;
+            case TRACE_STOP_PASS_COUNT:
+                sprintf(reason, "tpasscount:%lx", trace->stoppingTracepoint);
+                break;
+            case TRACE_STOP_ERROR:
+            {
+                static const char msg[] = "condition evaluation failed";
+                strcpy(reason, "terror:");
+                GDB_EncodeHex(reason + 7, msg, sizeof(msg) - 1);
+                sprintf(reason + 7 + 2 * (sizeof(msg) - 1), ":%lx", trace->stoppingTracepoint);
+                break;
+            }
+            default:
+                strcpy(reason, "tnotrun:0");
+                break;
+        }
+    }
+
+    u32 size = trace->buffer != NULL ? trace->bufferSize :
+               (trace->requestedBufferSize != 0 ? trace->requestedBufferSize : GDB_TRACE_BUFFER_DEFAULT_SIZE);
+    u32 used = trace->buffer != NULL ? GDB_TraceUsedSize(trace) : 0;
+
+    return GDB_SendFormattedPacket(ctx, "T%d;%s;tframes:%lx;tcreated:%lx;tfree:%lx;tsize:%lx;circular:%d;disconn:0",
+                                   trace->running ? 1 : 0, reason, trace->nbFrames, trace->nbCreatedFrames, size - used, size,
+                                   trace->circular ? 1 : 0);
+}
+
+// qTP:<n>:<addr>
+GDB_DECLARE_QUERY_HANDLER(TracepointStatus)
+{
+    u64 number, address;
+    const char *pos = ctx->commandData;
+
+    if((pos = GDB_TraceParseHex(&number, pos)) == NULL || *pos++ != ':' ||
+       (pos = GDB_TraceParseHex(&address, pos)) == NULL)
+        return GDB_ReplyErrno(ctx, EILSEQ);
+
+    Tracepoint *tp = GDB_FindTracepoint(&ctx->trace, (u32)number, (u32)address & ~1);
+    if(tp == NULL)
+        return GDB_ReplyErrno(ctx, EINVAL);
+
+    return GDB_SendFormattedPacket(ctx, "V%lx:%lx", tp->hitCount, tp->usage);
+}
+
+// qTV:<n>, from the selected frame if it has been collected there
+GDB_DECLARE_QUERY_HANDLER(TraceStateVariableValue)
+{
+    GDBTraceState *trace = &ctx->trace;
+    u64 number;
+    s64 value;
+
+    if(GDB_TraceParseHex(&number, ctx->commandData) == NULL)
+        return GDB_ReplyErrno(ctx, EILSEQ);
+
+    if(trace->frameSelected)
+    {
+        u32 iter = 0, block;
+        while((block = GDB_FindTraceFrameBlock(trace, 'V', &iter)) != 0)
+        {
+            if(GDB_TraceRead32(trace->buffer + block + 1) == (u32)number)
+            {
+                memcpy(&value, trace->buffer + block + 5, 8);
+                return GDB_SendFormattedPacket(ctx, "V%llx", (u64)value);
+            }
+        }
+
+        return GDB_SendPacket(ctx, "U", 1);
+    }
+    else if(!GDB_GetTraceStateVariable(ctx, &value, (u32)number))
+        return GDB_SendPacket(ctx, "U", 1);
+
+    return GDB_SendFormattedPacket(ctx, "V%llx", (u64)value);
+}
+
+// qTBuffer:<offset>,<len>, the frames from the oldest one
+GDB_DECLARE_QUERY_HANDLER(ReadTraceBuffer)
+{
+    GDBTraceState *trace = &ctx->trace;
+    u32 lst[2];
+
+    if(GDB_ParseHexIntegerList(lst, ctx->commandData, 2, 0) == NULL)
+        return GDB_ReplyErrno(ctx, EILSEQ);
+
+    u32 offset = lst[0], len = lst[1];
+    u32 used = trace->buffer != NULL ? GDB_TraceUsedSize(trace) : 0;
+
+    if(offset >= used)
+        return GDB_SendPacket(ctx, "l", 1);
+
+    u32 firstPart = trace->wrapped ? trace->wrapEnd - trace->head : used;
+    u32 pos = offset < firstPart ? trace->head + offset : offset - firstPart;
+    u32 available = offset < firstPart ? firstPart - offset : used - offset;
+
+    len = len > available ? available : len;
+    len = len > (GDB_BUF_LEN - 4) / 2 ? (GDB_BUF_LEN - 4) / 2 : len;
+
+    return GDB_SendHexPacket(ctx, trace->buffer + pos, len);
+}
+
+// qTfP, qTsP, qTfV, qTsV: nothing is kept across connections
+GDB_DECLARE_QUERY_HANDLER(UploadTraceDefinitions)
+{
+    return GDB_SendPacket(ctx, "l", 1);
+}
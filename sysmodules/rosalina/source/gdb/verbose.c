@@ -8,6 +8,7 @@
 #include "gdb/verbose.h"
 #include "gdb/net.h"
 #include "gdb/debug.h"
+#include "gdb/non_stop.h"
 #include "gdb/tio.h"
 
 static const struct
@@ -22,6 +23,7 @@ static const struct
     { "File", GDB_VERBOSE_HANDLER(File) },
     { "MustReplyEmpty", GDB_HANDLER(Unsupported) },
     { "Run", GDB_VERBOSE_HANDLER(Run) },
+    { "Stopped", GDB_VERBOSE_HANDLER(Stopped) },
     { "Kill", GDB_VERBOSE_HANDLER(Kill) },
 };
 
@@ -55,5 +57,8 @@ GDB_DECLARE_HANDLER(VerboseCommand)
 
 GDB_DECLARE_VERBOSE_HANDLER(ContinueSupported)
 {
-    return GDB_SendPacket(ctx, "vCont;c;C", 9);
+    if(ctx->flags & GDB_FLAG_NON_STOP)
+        return GDB_SendPacket(ctx, "vCont;c;C;s;S;t", 15);
+    else
+        return GDB_SendPacket(ctx, "vCont;c;C", 9);
 }
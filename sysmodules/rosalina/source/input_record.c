@@ -0,0 +1,255 @@
+/*
+*   This file is part of Luma3DS
+*   Copyright (C) 2016-2022 Aurora Wright, TuxSH
+*
+*   This program is free software: you can redistribute it and/or modify
+*   it under the terms of the GNU General Public License as published by
+*   the Free Software Foundation, either version 3 of the License, or
+*   (at your option) any later version.
+*
+*   This program is distributed in the hope that it will be useful,
+*   but WITHOUT ANY WARRANTY; without even the implied warranty of
+*   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*   GNU General Public License for more details.
+*
+*   You should have received a copy of the GNU General Public License
+*   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*
+*   Additional Terms 7.b and 7.c of GPLv3 apply to this file:
+*       * Requiring preservation of specified reasonable legal notices or
+*         author attributions in that material or in the Appropriate Legal
+*         Notices displayed by works containing it.
+*       * Prohibiting misrepresentation of the origin of that material,
+*         or requiring that modified versions of such material be marked in
+*         reasonable ways as different from the original version.
+*/
+
+#include "input_record.h"
+
+static inline u8 *InputRecord_WriteVarint(u8 *p, u32 v)
+{
+    while (v >= 0x80)
+    {
+        *p++ = (u8)v | 0x80;
+        v >>= 7;
+    }
+
+    *p++ = (u8)v;
+    return p;
+}
+
+// Returns NULL past the end of the data, or if the varint doesn't fit in 32 bits
+static inline const u8 *InputRecord_ReadVarint(const u8 *p, const u8 *end, u32 *v)
+{
+    *v = 0;
+    for (u32 shift = 0; shift < 35; shift += 7)
+    {
+        if (p >= end)
+            return NULL;
+
+        u8 b = *p++;
+        *v |= (u32)(b & 0x7F) << shift;
+        if (!(b & 0x80))
+            return shift < 28 || b < 0x10 ? p : NULL;
+    }
+
+    return NULL;
+}
+
+// Deltas of n-bit values, wrapped to [-2^(n-1), 2^(n-1))
+static inline u32 InputRecord_ZigzagDelta(u32 prev, u32 cur, u32 bits)
+{
+    s32 d = (s32)((cur - prev) << (32 - bits)) >> (32 - bits);
+    return (u32)d << 1 ^ (u32)(d >> 31);
+}
+
+static inline u32 InputRecord_UnzigzagDelta(u32 prev, u32 z, u32 bits)
+{
+    u32 d = (z >> 1) ^ -(z & 1);
+    return (prev + d) & ((1u << bits) - 1);
+}
+
+static u8 *InputRecord_WriteRun(u8 *p, u32 n)
+{
+    if (n <= 15)
+        *p++ = (u8)((n - 1) << 4);
+    else
+    {
+        *p++ = 0xF0;
+        p = InputRecord_WriteVarint(p, n - 16);
+    }
+
+    return p;
+}
+
+void InputRecord_InitEncoder(InputRecordEncoder *enc)
+{
+    enc->prev = INPUT_STATE_IDLE;
+    enc->pendingRun = 0;
+}
+
+u32 InputRecord_Flush(InputRecordEncoder *enc, u8 *out)
+{
+    u8 *p = out;
+
+    if (enc->pendingRun != 0)
+        p = InputRecord_WriteRun(p, enc->pendingRun);
+    enc->pendingRun = 0;
+
+    return (u32)(p - out);
+}
+
+u32 InputRecord_Encode(InputRecordEncoder *enc, const InputState *state, u8 *out)
+{
+    const InputState *prev = &enc->prev;
+    u32 fields = (state->pad != prev->pad ? INPUT_FIELD_PAD : 0) |
+                 (state->touch != prev->touch ? INPUT_FIELD_TOUCH : 0) |
+                 (state->circlePad != prev->circlePad ? INPUT_FIELD_CIRCLE_PAD : 0) |
+                 (state->cStick != prev->cStick ? INPUT_FIELD_CSTICK : 0);
+
+    if (fields == 0)
+    {
+        // Runs are unbounded, but keep the varint within 32 bits
+        if (++enc->pendingRun == 0xFFFFFFFF)
+            return InputRecord_Flush(enc, out);
+        return 0;
+    }
+
+    u8 *p = out + InputRecord_Flush(enc, out);
+    u32 extra = ((state->touch ^ prev->touch) >> 24 ? INPUT_EXTRA_TOUCH_HIGH : 0) |
+                ((state->circlePad ^ prev->circlePad) >> 24 ? INPUT_EXTRA_CIRCLE_PAD_HIGH : 0) |
+                ((state->cStick ^ prev->cStick) & 0xFFFF ? INPUT_EXTRA_CSTICK_LOW : 0);
+
+    *p++ = (u8)(fields | extra);
+
+    if (fields & INPUT_FIELD_PAD)
+        p = InputRecord_WriteVarint(p, state->pad ^ prev->pad);
+
+    if (fields & INPUT_FIELD_TOUCH)
+    {
+        p = InputRecord_WriteVarint(p, InputRecord_ZigzagDelta(prev->touch & 0xFFF, state->touch & 0xFFF, 12));
+        p = InputRecord_WriteVarint(p, InputRecord_ZigzagDelta((prev->touch >> 12) & 0xFFF, (state->touch >> 12) & 0xFFF, 12));
+        if (extra & INPUT_EXTRA_TOUCH_HIGH)
+            *p++ = (u8)(state->touch >> 24);
+    }
+
+    if (fields & INPUT_FIELD_CIRCLE_PAD)
+    {
+        p = InputRecord_WriteVarint(p, InputRecord_ZigzagDelta(prev->circlePad & 0xFFF, state->circlePad & 0xFFF, 12));
+        p = InputRecord_WriteVarint(p, InputRecord_ZigzagDelta((prev->circlePad >> 12) & 0xFFF, (state->circlePad >> 12) & 0xFFF, 12));
+        if (extra & INPUT_EXTRA_CIRCLE_PAD_HIGH)
+            *p++ = (u8)(state->circlePad >> 24);
+    }
+
+    if (fields & INPUT_FIELD_CSTICK)
+    {
+        p = InputRecord_WriteVarint(p, InputRecord_ZigzagDelta((prev->cStick >> 16) & 0xFF, (state->cStick >> 16) & 0xFF, 8));
+        p = InputRecord_WriteVarint(p, InputRecord_ZigzagDelta(prev->cStick >> 24, state->cStick >> 24, 8));
+        if (extra & INPUT_EXTRA_CSTICK_LOW)
+        {
+            *p++ = (u8)state->cStick;
+            *p++ = (u8)(state->cStick >> 8);
+        }
+    }
+
+    enc->prev = *state;
+    return (u32)(p - out);
+}
+
+void InputRecord_InitDecoder(InputRecordDecoder *dec)
+{
+    dec->state = INPUT_STATE_IDLE;
+    dec->runLeft = 0;
+}
+
+// Decodes the X and Y deltas of a touch or circle pad register, then bits 24-31 if present
+static const u8 *InputRecord_DecodeXY(const u8 *p, const u8 *end, u32 *reg, bool high)
+{
+    u32 x, y;
+
+    if ((p = InputRecord_ReadVarint(p, end, &x)) == NULL || (p = InputRecord_ReadVarint(p, end, &y)) == NULL)
+        return NULL;
+
+    x = InputRecord_UnzigzagDelta(*reg & 0xFFF, x, 12);
+    y = InputRecord_UnzigzagDelta((*reg >> 12) & 0xFFF, y, 12);
+    *reg = (*reg & 0xFF000000) | y << 12 | x;
+
+    if (high)
+    {
+        if (p >= end)
+            return NULL;
+        *reg = (*reg & 0xFFFFFF) | (u32)*p++ << 24;
+    }
+
+    return p;
+}
+
+s32 InputRecord_Decode(InputRecordDecoder *dec, const u8 *data, u32 size, InputState *out)
+{
+    const u8 *p = data, *end = data + size;
+    InputState *state = &dec->state;
+
+    if (dec->runLeft != 0)
+    {
+        dec->runLeft--;
+        *out = *state;
+        return 0;
+    }
+
+    if (p >= end)
+        return -1;
+
+    u8 tag = *p++;
+    u32 fields = tag & 0xF;
+
+    if (fields == 0)
+    {
+        u32 n = (tag >> 4) + 1;
+        if (n == 16)
+        {
+            u32 extra;
+            if ((p = InputRecord_ReadVarint(p, end, &extra)) == NULL || extra > 0xFFFFFFFF - 16)
+                return -1;
+            n += extra;
+        }
+
+        dec->runLeft = n - 1;
+        *out = *state;
+        return (s32)(p - data);
+    }
+
+    if (fields & INPUT_FIELD_PAD)
+    {
+        u32 x;
+        if ((p = InputRecord_ReadVarint(p, end, &x)) == NULL)
+            return -1;
+        state->pad ^= x;
+    }
+
+    if ((fields & INPUT_FIELD_TOUCH) && (p = InputRecord_DecodeXY(p, end, &state->touch, tag & INPUT_EXTRA_TOUCH_HIGH)) == NULL)
+        return -1;
+    if ((fields & INPUT_FIELD_CIRCLE_PAD) && (p = InputRecord_DecodeXY(p, end, &state->circlePad, tag & INPUT_EXTRA_CIRCLE_PAD_HIGH)) == NULL)
+        return -1;
+
+    if (fields & INPUT_FIELD_CSTICK)
+    {
+        u32 x, y;
+        if ((p = InputRecord_ReadVarint(p, end, &x)) == NULL || (p = InputRecord_ReadVarint(p, end, &y)) == NULL)
+            return -1;
+
+        x = InputRecord_UnzigzagDelta((state->cStick >> 16) & 0xFF, x, 8);
+        y = InputRecord_UnzigzagDelta(state->cStick >> 24, y, 8);
+        state->cStick = y << 24 | x << 16 | (state->cStick & 0xFFFF);
+
+        if (tag & INPUT_EXTRA_CSTICK_LOW)
+        {
+            if (end - p < 2)
+                return -1;
+            state->cStick = (state->cStick & 0xFFFF0000) | p[0] | p[1] << 8;
+            p += 2;
+        }
+    }
+
+    *out = *state;
+    return (s32)(p - data);
+}
@@ -0,0 +1,354 @@
+/*
+*   This file is part of Luma3DS
+*   Copyright (C) 2016-2022 Aurora Wright, TuxSH
+*
+*   This program is free software: you can redistribute it and/or modify
+*   it under the terms of the GNU General Public License as published by
+*   the Free Software Foundation, either version 3 of the License, or
+*   (at your option) any later version.
+*
+*   This program is distributed in the hope that it will be useful,
+*   but WITHOUT ANY WARRANTY; without even the implied warranty of
+*   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*   GNU General Public License for more details.
+*
+*   You should have received a copy of the GNU General Public License
+*   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*
+*   Additional Terms 7.b and 7.c of GPLv3 apply to this file:
+*       * Requiring preservation of specified reasonable legal notices or
+*         author attributions in that material or in the Appropriate Legal
+*         Notices displayed by works containing it.
+*       * Prohibiting misrepresentation of the origin of that material,
+*         or requiring that modified versions of such material be marked in
+*         reasonable ways as different from the original version.
+*/
+
+#include <3ds.h>
+#include <string.h>
+#include "input_recorder.h"
+#include "input_redirection.h"
+#include "MyThread.h"
+#include "menu.h"
+#include "fmt.h"
+#include "ifile.h"
+#include "pmdbgext.h"
+
+// Only the recorder thread writes the file and fills or drains the ring; the menu only starts and stops it.
+// The ring and the control words of hidData are shared with the HID hook, which runs in hid: they are accessed through their PA.
+
+static MyThread inputRecorderThread;
+static u8 CTR_ALIGN(8) inputRecorderThreadStack[0x2000];
+
+static InputState CTR_ALIGN(0x1000) ring[INPUT_RECORDER_RING_SIZE]; // One page, physically contiguous
+static u8 ioBuf[0x1000 + INPUT_RECORD_MAX_UPDATE_SIZE];
+static IFile file;
+static InputRecordHeader header;
+static InputRecorderStatus status;
+static bool started = false;
+static bool stopRequested = false;
+
+static inline volatile u32 *InputRecorder_GetControl(void)
+{
+    return (volatile u32 *)PA_FROM_VA_PTR(hidData);
+}
+
+static Result InputRecorder_OpenFile(u64 titleId, bool write)
+{
+    char path[64];
+    FS_Archive archive;
+
+    if (write && R_SUCCEEDED(FSUSER_OpenArchive(&archive, ARCHIVE_SDMC, fsMakePath(PATH_EMPTY, ""))))
+    {
+        FSUSER_CreateDirectory(archive, fsMakePath(PATH_ASCII, "/luma/inputs"), 0);
+        FSUSER_CloseArchive(archive);
+    }
+
+    sprintf(path, "/luma/inputs/%016llX.lirc", titleId);
+    return IFile_Open(&file, ARCHIVE_SDMC, fsMakePath(PATH_EMPTY, ""), fsMakePath(PATH_ASCII, path), write ? FS_OPEN_CREATE | FS_OPEN_WRITE : FS_OPEN_READ);
+}
+
+static void InputRecorder_SetResult(Result res)
+{
+    if (R_SUCCEEDED(status.result))
+        status.result = res;
+}
+
+static void InputRecorder_Write(u32 *ioFill, bool flush)
+{
+    u64 total;
+
+    if (*ioFill == 0 || (!flush && *ioFill < 0x1000))
+        return;
+
+    Result res = IFile_Write(&file, &total, ioBuf, *ioFill, 0);
+    if (R_FAILED(res))
+        InputRecorder_SetResult(res);
+
+    header.dataSize += *ioFill;
+    *ioFill = 0;
+}
+
+static void InputRecorder_Record(void)
+{
+    volatile u32 *control = InputRecorder_GetControl();
+    const volatile InputState *ringPhys = (const volatile InputState *)PA_FROM_VA_PTR(ring);
+    InputRecordEncoder enc;
+    InputState state = INPUT_STATE_IDLE;
+    u32 consumed = 0, ioFill = 0;
+    u64 startTick = svcGetSystemTick();
+    bool done = false;
+
+    InputRecord_InitEncoder(&enc);
+    control[HIDDATA_RECORDER_MODE] = INPUT_RECORDER_MODE_RECORD;
+
+    while (!done)
+    {
+        svcSleepThread(INPUT_RECORDER_POLL_PERIOD_MS * 1000 * 1000LL);
+
+        if (stopRequested || preTerminationRequested)
+        {
+            // Let the hook finish the update it may be recording, then drain the ring one last time
+            control[HIDDATA_RECORDER_MODE] = INPUT_RECORDER_MODE_OFF;
+            svcSleepThread(INPUT_RECORDER_POLL_PERIOD_MS * 1000 * 1000LL);
+            done = true;
+        }
+
+        u32 count = control[HIDDATA_RECORDER_COUNT];
+        __dmb();
+
+        for (; consumed != count; consumed++)
+        {
+            InputState entry = ringPhys[consumed % INPUT_RECORDER_RING_SIZE];
+
+            // The hook may have wrapped around while we were writing the file or even while copying the entry:
+            // keep the timing by repeating the previous update instead
+            __dmb();
+            if (control[HIDDATA_RECORDER_COUNT] - consumed <= INPUT_RECORDER_RING_SIZE)
+                state = entry;
+            else
+                status.numDroppedUpdates++;
+
+            ioFill += InputRecord_Encode(&enc, &state, ioBuf + ioFill);
+            InputRecorder_Write(&ioFill, false);
+        }
+
+        status.numUpdates = consumed;
+    }
+
+    ioFill += InputRecord_Flush(&enc, ioBuf + ioFill);
+    InputRecorder_Write(&ioFill, true);
+
+    header.numUpdates = consumed;
+    header.numDroppedUpdates = status.numDroppedUpdates;
+    header.durationMs = (u32)(1000 * (svcGetSystemTick() - startTick) / SYSCLOCK_ARM11);
+    status.dataSize = header.dataSize;
+
+    u64 total;
+    file.pos = 0;
+    Result res = IFile_Write(&file, &total, &header, sizeof(InputRecordHeader), 0);
+    if (R_SUCCEEDED(res))
+        res = IFile_SetSize(&file, sizeof(InputRecordHeader) + header.dataSize);
+    InputRecorder_SetResult(res);
+}
+
+// Refills the I/O buffer so that a whole update can be decoded, returns the number of bytes available
+static u32 InputRecorder_Fill(u32 *ioPos, u32 *ioFill, u32 *dataLeft)
+{
+    u64 total;
+    u32 size;
+
+    if (*ioFill - *ioPos >= INPUT_RECORD_MAX_UPDATE_SIZE || *dataLeft == 0)
+        return *ioFill - *ioPos;
+
+    memmove(ioBuf, ioBuf + *ioPos, *ioFill - *ioPos);
+    *ioFill -= *ioPos;
+    *ioPos = 0;
+
+    size = sizeof(ioBuf) - *ioFill < *dataLeft ? sizeof(ioBuf) - *ioFill : *dataLeft;
+    Result res = IFile_Read(&file, &total, ioBuf + *ioFill, size);
+    if (R_FAILED(res) || total != size)
+    {
+        InputRecorder_SetResult(R_FAILED(res) ? res : INPUT_RECORDER_ERR_INVALID_FILE);
+        *dataLeft = 0;
+        return *ioFill;
+    }
+
+    *ioFill += size;
+    *dataLeft -= size;
+    return *ioFill;
+}
+
+// Decodes updates into the ring, up to a full ring ahead of the hook. Returns false on a malformed file.
+static bool InputRecorder_Produce(InputRecordDecoder *dec, u32 *produced, u32 count, u32 *ioPos, u32 *ioFill, u32 *dataLeft)
+{
+    InputState *ringPhys = (InputState *)PA_FROM_VA_PTR(ring);
+
+    while (*produced - count < INPUT_RECORDER_RING_SIZE && *produced < header.numUpdates)
+    {
+        u32 size = InputRecorder_Fill(ioPos, ioFill, dataLeft);
+        s32 n = InputRecord_Decode(dec, ioBuf + *ioPos, size, &ringPhys[*produced % INPUT_RECORDER_RING_SIZE]);
+        if (n < 0)
+        {
+            InputRecorder_SetResult(INPUT_RECORDER_ERR_INVALID_FILE);
+            return false;
+        }
+
+        *ioPos += n;
+        (*produced)++;
+    }
+
+    return true;
+}
+
+static void InputRecorder_Replay(void)
+{
+    volatile u32 *control = InputRecorder_GetControl();
+    volatile u32 *irDataPhys = (volatile u32 *)PA_FROM_VA_PTR(irData);
+    InputRecordDecoder dec;
+    u32 produced = 0, count = 0, ioPos = 0, ioFill = 0, dataLeft = header.dataSize;
+    bool ok;
+
+    InputRecord_InitDecoder(&dec);
+    file.pos = sizeof(InputRecordHeader);
+
+    ok = InputRecorder_Produce(&dec, &produced, 0, &ioPos, &ioFill, &dataLeft);
+    control[HIDDATA_RECORDER_AVAILABLE] = produced;
+    __dmb();
+    control[HIDDATA_RECORDER_MODE] = INPUT_RECORDER_MODE_REPLAY;
+
+    while (ok && count < header.numUpdates && !stopRequested && !preTerminationRequested)
+    {
+        svcSleepThread(INPUT_RECORDER_POLL_PERIOD_MS * 1000 * 1000LL);
+
+        count = control[HIDDATA_RECORDER_COUNT];
+        ok = InputRecorder_Produce(&dec, &produced, count, &ioPos, &ioFill, &dataLeft);
+        __dmb();
+        control[HIDDATA_RECORDER_AVAILABLE] = produced;
+
+        status.numUpdates = count;
+        status.numUnderruns = control[HIDDATA_RECORDER_UNDERRUNS];
+    }
+
+    control[HIDDATA_RECORDER_MODE] = INPUT_RECORDER_MODE_OFF;
+    irDataPhys[0] = 0x80800081; // Release the C-stick
+}
+
+static void InputRecorder_ThreadMain(void)
+{
+    // The menu pauses the application: start along with it once the menu is closed
+    while (rosalinaOpen && !stopRequested && !preTerminationRequested)
+        svcSleepThread(INPUT_RECORDER_POLL_PERIOD_MS * 1000 * 1000LL);
+
+    if (status.mode == INPUT_RECORDER_MODE_RECORD)
+        InputRecorder_Record();
+    else
+        InputRecorder_Replay();
+
+    IFile_Close(&file);
+    status.active = false;
+}
+
+static Result InputRecorder_Start(u32 mode)
+{
+    FS_ProgramInfo progInfo;
+    u32 pid, launchFlags;
+    u64 fileSize;
+    Result res;
+
+    if (started && status.active)
+        return INPUT_RECORDER_ERR_BUSY;
+    else if (started && R_FAILED(res = InputRecorder_Stop(1000 * 1000 * 1000LL))) // Replay done, join the thread
+        return res;
+
+    if (R_FAILED(PMDBG_GetCurrentAppInfo(&progInfo, &pid, &launchFlags)))
+        return INPUT_RECORDER_ERR_NO_APPLICATION;
+
+    memset(&status, 0, sizeof(InputRecorderStatus));
+    status.mode = mode;
+    status.titleId = progInfo.programId;
+
+    res = InputRecorder_OpenFile(progInfo.programId, mode == INPUT_RECORDER_MODE_RECORD);
+    if (R_FAILED(res))
+        return res;
+
+    if (mode == INPUT_RECORDER_MODE_RECORD)
+    {
+        u64 total;
+
+        memset(&header, 0, sizeof(InputRecordHeader));
+        header.magic = INPUT_RECORD_MAGIC;
+        header.version = INPUT_RECORD_VERSION;
+        header.titleId = progInfo.programId;
+        header.creationTime = osGetTime();
+
+        // Rewritten with the totals once done
+        res = IFile_Write(&file, &total, &header, sizeof(InputRecordHeader), 0);
+    }
+    else
+    {
+        u64 total;
+
+        res = IFile_GetSize(&file, &fileSize);
+        if (R_SUCCEEDED(res))
+            res = IFile_Read(&file, &total, &header, sizeof(InputRecordHeader));
+        if (R_SUCCEEDED(res) && (total != sizeof(InputRecordHeader) || header.magic != INPUT_RECORD_MAGIC ||
+            header.version != INPUT_RECORD_VERSION || sizeof(InputRecordHeader) + (u64)header.dataSize > fileSize))
+            res = INPUT_RECORDER_ERR_INVALID_FILE;
+
+        status.totalUpdates = header.numUpdates;
+        status.dataSize = header.dataSize;
+    }
+
+    if (R_SUCCEEDED(res))
+        res = InputRedirection_AcquirePatches();
+    if (R_FAILED(res))
+    {
+        IFile_Close(&file);
+        return res;
+    }
+
+    volatile u32 *control = InputRecorder_GetControl();
+    control[HIDDATA_RECORDER_MODE] = INPUT_RECORDER_MODE_OFF;
+    control[HIDDATA_RECORDER_COUNT] = 0;
+    control[HIDDATA_RECORDER_AVAILABLE] = 0;
+    control[HIDDATA_RECORDER_UNDERRUNS] = 0;
+    control[HIDDATA_RECORDER_RING] = (u32)PA_FROM_VA_PTR(ring);
+
+    stopRequested = false;
+    status.active = true;
+    started = true;
+    if (R_FAILED(MyThread_Create(&inputRecorderThread, InputRecorder_ThreadMain, inputRecorderThreadStack, sizeof(inputRecorderThreadStack), 0x20, CORE_SYSTEM)))
+        svcBreak(USERBREAK_PANIC);
+
+    return 0;
+}
+
+Result InputRecorder_StartRecording(void)
+{
+    return InputRecorder_Start(INPUT_RECORDER_MODE_RECORD);
+}
+
+Result InputRecorder_StartReplay(void)
+{
+    return InputRecorder_Start(INPUT_RECORDER_MODE_REPLAY);
+}
+
+Result InputRecorder_Stop(s64 timeout)
+{
+    if (!started)
+        return 0;
+
+    stopRequested = true;
+    Result res = MyThread_Join(&inputRecorderThread, timeout);
+    if (R_FAILED(res))
+        return res;
+
+    started = false;
+    return InputRedirection_ReleasePatches();
+}
+
+void InputRecorder_GetStatus(InputRecorderStatus *out)
+{
+    *out = status;
+}
@@ -48,10 +48,14 @@ MyThread *inputRedirectionCreateThread(void)
     return &inputRedirectionThread;
 }
 
-//                       local hid,  local tsrd  localcprd,  localtswr,  localcpwr,  remote hid, remote ts,  remote circle
-static u32 hidData[] = { 0x00000FFF, 0x02000000, 0x007FF7FF, 0x00000000, 0x00000000, 0x00000FFF, 0x02000000, 0x007FF7FF };
-//                      remote ir
-static u32 irData[] = { 0x80800081 }; // Default: C-Stick at the center, no buttons.
+//                                local hid,  local tsrd  localcprd,  localtswr,  localcpwr,  remote hid, remote ts,  remote circle
+u32 CTR_ALIGN(64) hidData[16] = { 0x00000FFF, 0x02000000, 0x007FF7FF, 0x00000000, 0x00000000, 0x00000FFF, 0x02000000, 0x007FF7FF };
+// The rest is the input recorder's, see HIDDATA_RECORDER_*. Aligned so that the hooks can access all of it through its PA.
+//                      remote ir   last ir
+u32 CTR_ALIGN(8) irData[2] = { 0x80800081, 0x80800081 }; // Default: C-Stick at the center, no buttons.
+
+static u32 patchUsers = 0; // input redirection, input recorder
+static bool redirectionPatchUser = false;
 
 int inputRedirectionStartResult;
 
@@ -393,6 +397,7 @@ static Result InputRedirection_DoUndoHidPatches(Handle processHandle, bool doPat
         if (doPatches)
         {
             u32 hidDataPhys = (u32)PA_FROM_VA_PTR(hidData);
+            ((u32 *)hidDataPhys)[HIDDATA_RECORDER_IRDATA] = (u32)PA_FROM_VA_PTR(irData);
             u32 hidCodePhys = (u32)PA_FROM_VA_PTR(&hidCodePatchFunc);
             u32 hidHook[] = {
                 0xE59F3004, // ldr r3,  [pc, #4]
@@ -433,7 +438,7 @@ Result InputRedirection_Disable(s64 timeout)
     return res;
 }
 
-Result InputRedirection_DoOrUndoPatches(void)
+static Result InputRedirection_SetPatches(bool doPatches)
 {
     static bool hidPatched = false;
     static bool irPatched = false;
@@ -452,18 +457,18 @@ Result InputRedirection_DoOrUndoPatches(void)
     if (R_FAILED(res))
         goto cleanup;
 
-    if(R_SUCCEEDED(res))
+    if(R_SUCCEEDED(res) && hidPatched != doPatches)
     {
-        res = InputRedirection_DoUndoHidPatches(hidProcHandle, !hidPatched);
+        res = InputRedirection_DoUndoHidPatches(hidProcHandle, doPatches);
         if (R_SUCCEEDED(res))
-            hidPatched = !hidPatched;
+            hidPatched = doPatches;
     }
 
-    if(R_SUCCEEDED(res) && GET_VERSION_MINOR(osGetKernelVersion()) >= 44)
+    if(R_SUCCEEDED(res) && irPatched != doPatches && GET_VERSION_MINOR(osGetKernelVersion()) >= 44)
     {
-        res = InputRedirection_DoUndoIrPatches(irProcHandle, !irPatched);
+        res = InputRedirection_DoUndoIrPatches(irProcHandle, doPatches);
         if (R_SUCCEEDED(res))
-            irPatched = !irPatched;
+            irPatched = doPatches;
         else if (!irPatched)
         {
             InputRedirection_DoUndoHidPatches(hidProcHandle, false);
@@ -478,3 +483,33 @@ cleanup:
     svcCloseHandle(irProcHandle);
     return res;
 }
+
+Result InputRedirection_AcquirePatches(void)
+{
+    Result res = patchUsers == 0 ? InputRedirection_SetPatches(true) : 0;
+    if (R_SUCCEEDED(res))
+        patchUsers++;
+
+    return res;
+}
+
+Result InputRedirection_ReleasePatches(void)
+{
+    if (patchUsers == 0)
+        return 0;
+
+    Result res = patchUsers == 1 ? InputRedirection_SetPatches(false) : 0;
+    if (R_SUCCEEDED(res))
+        patchUsers--;
+
+    return res;
+}
+
+Result InputRedirection_DoOrUndoPatches(void)
+{
+    Result res = redirectionPatchUser ? InputRedirection_ReleasePatches() : InputRedirection_AcquirePatches();
+    if (R_SUCCEEDED(res))
+        redirectionPatchUser = !redirectionPatchUser;
+
+    return res;
+}
@@ -92,6 +92,47 @@ cmp r2, r3          @ Is remote 0x7FF7FF?
 movne r1, r2        @ If not, load remote.
 str r1, [r0, #8]    @ Store.
 
+@ Input recorder. +32: mode (0 off, 1 record, 2 replay), +36: update count, +40: updates available for replay,
+@ +44: irData, +48: replay underruns, +52: ring of 256 {pad, touch, circle pad, C-stick} entries
+ldr r1, [r0, #32]
+cmp r1, #0
+beq skip_recorder
+
+ldr r2, [r0, #36]
+ldr r12, [r0, #52]
+and r3, r2, #0xff
+add r12, r12, r3, lsl #4    @ Ring entry of this update
+ldr r5, [r0, #44]
+
+cmp r1, #1
+bne replay_update
+
+ldmia r0, {r1, r3, r6}      @ Record what hid is about to get...
+stmia r12!, {r1, r3, r6}
+ldr r1, [r5, #4]            @ ...and the C-stick state last let through by the IR hook
+str r1, [r12]
+b recorder_update_done
+
+replay_update:
+ldr r1, [r0, #40]
+subs r1, r1, r2             @ Has the recorder thread filled this entry yet?
+ldrle r1, [r0, #48]
+addle r1, r1, #1
+strle r1, [r0, #48]         @ If not, count an underrun and pass the input through: the entry is used next time
+ble skip_recorder
+
+ldmia r12!, {r1, r3, r6}
+stmia r0, {r1, r3, r6}
+ldr r1, [r12]
+str r1, [r5]                @ The IR hook substitutes it when the C-stick isn't being used
+
+recorder_update_done:
+mov r1, #0
+mcr p15, 0, r1, c7, c10, 5  @ DMB: publish the entry before the count
+add r2, r2, #1
+str r2, [r0, #36]
+
+skip_recorder:
 ldr r0, [r4,#4]
 
 pop {r4-r6, pc}
@@ -137,6 +178,8 @@ movne r2, r1
 cmp r1, r2
 ldreq r0, [r5]              @ Pull the remote input in.
 streq r0, [r4]              @ store it instead of the value read from i2c
+ldr r0, [r4]
+str r0, [r5, #4]            @ What ir gets, for the input recorder
 
 @ Return!
 mov r0, #0                  @ For ir:user.
@@ -0,0 +1,60 @@
+/*
+*   This file is part of Luma3DS
+*   Copyright (C) 2016-2022 Aurora Wright, TuxSH
+*
+*   This program is free software: you can redistribute it and/or modify
+*   it under the terms of the GNU General Public License as published by
+*   the Free Software Foundation, either version 3 of the License, or
+*   (at your option) any later version.
+*
+*   This program is distributed in the hope that it will be useful,
+*   but WITHOUT ANY WARRANTY; without even the implied warranty of
+*   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*   GNU General Public License for more details.
+*
+*   You should have received a copy of the GNU General Public License
+*   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*
+*   Additional Terms 7.b and 7.c of GPLv3 apply to this file:
+*       * Requiring preservation of specified reasonable legal notices or
+*         author attributions in that material or in the Appropriate Legal
+*         Notices displayed by works containing it.
+*       * Prohibiting misrepresentation of the origin of that material,
+*         or requiring that modified versions of such material be marked in
+*         reasonable ways as different from the original version.
+*/
+
+#include "key_repeat.h"
+
+void KeyRepeat_Configure(KeyRepeat *repeat, u64 delay, u64 interval)
+{
+    repeat->delay = delay;
+    repeat->interval = interval != 0 ? interval : delay;
+    repeat->heldKeys = 0;
+}
+
+u32 KeyRepeat_Update(KeyRepeat *repeat, u32 down, u32 held, u64 now)
+{
+    if (repeat->delay == 0 || held == 0)
+    {
+        repeat->heldKeys = 0;
+        return 0;
+    }
+
+    if (held != repeat->heldKeys || down != 0)
+    {
+        repeat->heldKeys = held;
+        repeat->nextTime = now + repeat->delay;
+        return 0;
+    }
+
+    if (now < repeat->nextTime)
+        return 0;
+
+    // On schedule whatever the scan rate, but without a burst of repeats after a long gap between scans
+    repeat->nextTime += repeat->interval;
+    if (repeat->nextTime <= now)
+        repeat->nextTime = now + repeat->interval;
+
+    return held;
+}
@@ -0,0 +1,35 @@
+// License for this file: ctrulib's license
+// Copyright AuroraWright, TuxSH 2019-2020
+
+#include <3ds/types.h>
+#include <3ds/result.h>
+#include <3ds/svc.h>
+#include <3ds/srv.h>
+#include <3ds/ipc.h>
+#include "loaderext.h"
+
+Result LOADEREXT_GetLaunchTraces(LaunchTrace *outTraces, u32 *outCount)
+{
+    Handle loaderHandle;
+    Result ret = srvGetServiceHandle(&loaderHandle, "Loader");
+    if(R_FAILED(ret)) return ret;
+
+    u32 *cmdbuf = getThreadCommandBuffer();
+    u32 *staticbufs = getThreadStaticBuffers();
+    u32 savedStaticbufs[2] = { staticbufs[0], staticbufs[1] };
+
+    cmdbuf[0] = IPC_MakeHeader(0x103, 0, 0);
+    staticbufs[0] = IPC_Desc_StaticBuffer(LAUNCHTRACE_COUNT * sizeof(LaunchTrace), 0);
+    staticbufs[1] = (u32)outTraces;
+
+    ret = svcSendSyncRequest(loaderHandle);
+
+    staticbufs[0] = savedStaticbufs[0];
+    staticbufs[1] = savedStaticbufs[1];
+    svcCloseHandle(loaderHandle);
+
+    if(R_FAILED(ret)) return ret;
+
+    *outCount = cmdbuf[2];
+    return (Result)cmdbuf[1];
+}
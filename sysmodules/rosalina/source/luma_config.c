@@ -202,7 +202,8 @@ static size_t LumaConfig_SaveLumaIniConfigToStr(char *out, const CfgData *cfg)
         cfg->volumeSliderOverride,
         
         (int)CONFIG(SHOWADVANCEDSETTINGS),
-        (int)CONFIG(HARDWAREPATCHING)
+        (int)CONFIG(HARDWAREPATCHING),
+        (int)CONFIG(BOOTTIMELOG)
     );
 
     return n < 0 ? 0 : (size_t)n;
@@ -313,7 +314,8 @@ static size_t LumaConfig_SavePerformanceLumaIniConfigToStr(char *out, const CfgD
         cfg->volumeSliderOverride,
 
         (int)CONFIG(SHOWADVANCEDSETTINGS),
-        (int)CONFIG(HARDWAREPATCHING)
+        (int)CONFIG(HARDWAREPATCHING),
+        (int)CONFIG(BOOTTIMELOG)
     );
 
     return n < 0 ? 0 : (size_t)n;
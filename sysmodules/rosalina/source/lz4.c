@@ -0,0 +1,201 @@
+/*
+*   This file is part of Luma3DS
+*   Copyright (C) 2016-2022 Aurora Wright, TuxSH
+*
+*   This program is free software: you can redistribute it and/or modify
+*   it under the terms of the GNU General Public License as published by
+*   the Free Software Foundation, either version 3 of the License, or
+*   (at your option) any later version.
+*
+*   This program is distributed in the hope that it will be useful,
+*   but WITHOUT ANY WARRANTY; without even the implied warranty of
+*   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*   GNU General Public License for more details.
+*
+*   You should have received a copy of the GNU General Public License
+*   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*
+*   Additional Terms 7.b and 7.c of GPLv3 apply to this file:
+*       * Requiring preservation of specified reasonable legal notices or
+*         author attributions in that material or in the Appropriate Legal
+*         Notices displayed by works containing it.
+*       * Prohibiting misrepresentation of the origin of that material,
+*         or requiring that modified versions of such material be marked in
+*         reasonable ways as different from the original version.
+*/
+
+#include <string.h>
+#include "lz4.h"
+
+#define LZ4_HASH_BITS   12
+#define LZ4_MIN_MATCH   4
+#define LZ4_MFLIMIT     12  // a match can't start within the last 12 bytes
+#define LZ4_LASTLITERALS 5  // the last 5 bytes are always literals
+
+static inline u32 lz4Read32(const u8 *p)
+{
+    u32 v;
+    memcpy(&v, p, 4);
+    return v;
+}
+
+static inline u32 lz4Hash(u32 v)
+{
+    return (v * 2654435761u) >> (32 - LZ4_HASH_BITS);
+}
+
+static inline u8 *lz4WriteLength(u8 *op, u32 len)
+{
+    for (; len >= 255; len -= 255)
+        *op++ = 255;
+    *op++ = (u8)len;
+    return op;
+}
+
+static u8 *lz4WriteSequence(u8 *op, const u8 *oend, const u8 *literals, u32 litLen, u32 offset, u32 matchLen, bool last)
+{
+    if (op + 1 + litLen + litLen / 255 + 1 + (last ? 0 : 2 + matchLen / 255 + 1) > oend)
+        return NULL;
+
+    u8 *token = op++;
+    *token = (litLen >= 15 ? 15 : litLen) << 4;
+    if (litLen >= 15)
+        op = lz4WriteLength(op, litLen - 15);
+
+    memcpy(op, literals, litLen);
+    op += litLen;
+
+    if (!last)
+    {
+        *op++ = offset & 0xFF;
+        *op++ = offset >> 8;
+        *token |= matchLen >= 15 ? 15 : matchLen;
+        if (matchLen >= 15)
+            op = lz4WriteLength(op, matchLen - 15);
+    }
+
+    return op;
+}
+
+u32 lz4CompressBlock(const void *src, u32 srcSize, void *dst, u32 dstCapacity, void *hashTable)
+{
+    const u8 *base = (const u8 *)src;
+    const u8 *ip = base, *anchor = base;
+    const u8 *iend = base + srcSize;
+    u8 *op = (u8 *)dst;
+    const u8 *oend = op + dstCapacity;
+    u16 *table = (u16 *)hashTable;
+
+    if (srcSize > LZ4_MAX_BLOCK_SIZE)
+        return 0;
+
+    memset(table, 0, LZ4_HASH_TABLE_SIZE);
+
+    if (srcSize > LZ4_MFLIMIT)
+    {
+        const u8 *mflimit = iend - LZ4_MFLIMIT;
+        const u8 *matchlimit = iend - LZ4_LASTLITERALS;
+
+        while (ip < mflimit)
+        {
+            u32 seq = lz4Read32(ip);
+            u32 h = lz4Hash(seq);
+            const u8 *ref = base + table[h];
+            table[h] = (u16)(ip - base);
+
+            if (ref >= ip || lz4Read32(ref) != seq)
+            {
+                ip++;
+                continue;
+            }
+
+            while (ip > anchor && ref > base && ip[-1] == ref[-1])
+            {
+                ip--;
+                ref--;
+            }
+
+            const u8 *mp = ip + LZ4_MIN_MATCH, *mr = ref + LZ4_MIN_MATCH;
+            while (mp < matchlimit && *mp == *mr)
+            {
+                mp++;
+                mr++;
+            }
+
+            op = lz4WriteSequence(op, oend, anchor, ip - anchor, ip - ref, mp - ip - LZ4_MIN_MATCH, false);
+            if (op == NULL)
+                return 0;
+
+            ip = anchor = mp;
+        }
+    }
+
+    op = lz4WriteSequence(op, oend, anchor, iend - anchor, 0, 0, true);
+    return op == NULL ? 0 : (u32)(op - (u8 *)dst);
+}
+
+// Reads the extra bytes of a literal or match length, returns NULL past the end of the input
+static inline const u8 *lz4ReadLength(const u8 *ip, const u8 *iend, u32 *len)
+{
+    u8 b;
+
+    do
+    {
+        if (ip >= iend)
+            return NULL;
+        b = *ip++;
+        *len += b;
+    }
+    while (b == 255);
+
+    return ip;
+}
+
+u32 lz4DecompressBlock(const void *src, u32 srcSize, void *dst, u32 dstCapacity)
+{
+    const u8 *ip = (const u8 *)src;
+    const u8 *iend = ip + srcSize;
+    u8 *op = (u8 *)dst;
+    u8 *oend = op + dstCapacity;
+
+    while (ip < iend)
+    {
+        u8 token = *ip++;
+        u32 litLen = token >> 4;
+
+        if (litLen == 15 && (ip = lz4ReadLength(ip, iend, &litLen)) == NULL)
+            return 0;
+        if (litLen > (u32)(iend - ip) || litLen > (u32)(oend - op))
+            return 0;
+
+        memcpy(op, ip, litLen);
+        ip += litLen;
+        op += litLen;
+
+        // The last sequence only has literals
+        if (ip == iend)
+            break;
+
+        if (iend - ip < 2)
+            return 0;
+
+        u32 offset = ip[0] | ip[1] << 8;
+        u32 matchLen = (token & 15) + LZ4_MIN_MATCH;
+        ip += 2;
+
+        if (offset == 0 || offset > (u32)(op - (u8 *)dst))
+            return 0;
+        if ((token & 15) == 15 && (ip = lz4ReadLength(ip, iend, &matchLen)) == NULL)
+            return 0;
+        if (matchLen > (u32)(oend - op))
+            return 0;
+
+        // Matches may overlap their own output
+        const u8 *ref = op - offset;
+        for (u32 i = 0; i < matchLen; i++)
+            op[i] = ref[i];
+        op += matchLen;
+    }
+
+    return (u32)(op - (u8 *)dst);
+}
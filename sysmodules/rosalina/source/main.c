@@ -45,6 +45,8 @@
 #include "menus/config_extra.h"
 #include "menus/n3ds.h"
 #include "input_redirection.h"
+#include "input_recorder.h"
+#include "frame_profiler.h"
 #include "minisoc.h"
 #include "draw.h"
 #include "bootdiag.h"
@@ -246,6 +248,8 @@ static void handlePreTermNotification(u32 notificationId)
 
     // Disable input redirection
     InputRedirection_Disable(100 * 1000 * 1000LL);
+    InputRecorder_Stop(100 * 1000 * 1000LL);
+    FrameProfiler_Stop(100 * 1000 * 1000LL);
 
     // Ask the debugger to terminate in approx 2 * 100ms
     debuggerDisable(100 * 1000 * 1000LL);
@@ -359,7 +363,7 @@ int main(void)
     LoadConfig();
 
     MyThread *menuThread = menuCreateThread();
-    MyThread *taskRunnerThread = taskRunnerCreateThread();
+    taskRunnerCreateThreads();
     MyThread *errDispThread = errDispCreateThread();
     bootdiagCreateThread();
 
@@ -370,7 +374,7 @@ int main(void)
 
     MyThread_Join(menuThread, -1LL);
 
-    MyThread_Join(taskRunnerThread, -1LL);
+    TaskRunner_JoinThreads(-1LL);
     MyThread_Join(errDispThread, -1LL);
 
     return 0;
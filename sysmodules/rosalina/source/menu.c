@@ -48,6 +48,7 @@
 #include "minisoc.h"
 #include "plugin.h"
 #include "menus/screen_filters.h"
+#include "key_repeat.h"
 #include "luminance.h"
 #include "shell.h"
 #include "menus/quick_switchers.h"
@@ -112,40 +113,90 @@ static inline u32 convertHidKeys(u32 keys)
     return keys;
 }
 
-u32 waitInputWithTimeout(s32 msec)
+static Handle hidPadEvent = 0;
+
+// Scans follow HID updates rather than a fixed rate, so hidKeysDownRepeat (which counts scans) doesn't fit
+static KeyRepeat keyRepeat;
+
+static inline u64 msToTicks(u32 msec)
 {
-    s32 n = 0;
-    u32 keys;
+    return (u64)msec * SYSCLOCK_ARM11 / 1000;
+}
 
-    do
+void menuSetKeyRepeat(u32 delayMs, u32 intervalMs)
+{
+    KeyRepeat_Configure(&keyRepeat, msToTicks(delayMs), msToTicks(intervalMs));
+}
+
+// Index of the latest entry of the PAD ring in HID shared memory, which moves on every update
+static inline u32 menuGetHidPadIndex(void)
+{
+    return hidSharedMem[4];
+}
+
+// Blocks until HID has new pad data, the deadline (0 = none) is reached, or 16ms have passed so that menuShouldExit is noticed.
+// The PAD event is the one HID signals for every client (the application included), so it is never cleared here: new data
+// is told apart from a signal left set by someone else by the PAD ring index, and we fall back to polling that index once
+// the event is found to be stale.
+static void menuWaitForHidUpdate(u64 deadline)
+{
+    static u32 lastPadIndex;
+    u64 maxWait = msToTicks(16);
+    u64 now = svcGetSystemTick();
+    u64 end = now + maxWait;
+
+    if (deadline != 0)
     {
-        svcSleepThread(1 * 1000 * 1000LL);
-        Draw_Lock();
-        if (!isHidInitialized || menuShouldExit)
+        if (now >= deadline)
+            return;
+        end = deadline < end ? deadline : end;
+    }
+
+    if (hidPadEvent == 0)
+    {
+        s64 timeout = (s64)((end - now) * 1000 * 1000 * 1000 / SYSCLOCK_ARM11);
+        svcSleepThread(timeout < 1000 * 1000LL ? timeout : 1000 * 1000LL);
+        return;
+    }
+
+    bool stale = false;
+    for (; now < end; now = svcGetSystemTick())
+    {
+        s64 timeout = (s64)((end - now) * 1000 * 1000 * 1000 / SYSCLOCK_ARM11);
+        if (stale)
+            svcSleepThread(timeout < 1000 * 1000LL ? timeout : 1000 * 1000LL);
+        else
         {
-            keys = 0;
-            Draw_Unlock();
-            break;
+            s32 idx;
+            Handle handles[2] = { hidPadEvent, preTerminationEvent };
+            if (R_SUCCEEDED(svcWaitSynchronizationN(&idx, handles, 2, false, timeout)) && idx == 1)
+                return;
         }
-        n++;
-
-        hidScanInput();
-        keys = convertHidKeys(hidKeysDown()) | (convertHidKeys(hidKeysDownRepeat()) & DIRECTIONAL_KEYS);
-        Draw_Unlock();
-    } while (keys == 0 && !menuShouldExit && isHidInitialized && (msec < 0 || n < msec));
 
+        u32 index = menuGetHidPadIndex();
+        if (index != lastPadIndex)
+        {
+            lastPadIndex = index;
+            return;
+        }
+        stale = true;
+    }
+}
 
-    return keys;
+u32 waitInputWithTimeout(s32 msec)
+{
+    u32 heldKeys;
+    return waitInputWithTimeoutEx(&heldKeys, msec);
 }
 
 u32 waitInputWithTimeoutEx(u32 *outHeldKeys, s32 msec)
 {
-    s32 n = 0;
+    u64 deadline = msec < 0 ? 0 : svcGetSystemTick() + msToTicks(msec);
     u32 keys;
 
     do
     {
-        svcSleepThread(1 * 1000 * 1000LL);
+        menuWaitForHidUpdate(deadline);
         Draw_Lock();
         if (!isHidInitialized || menuShouldExit)
         {
@@ -153,13 +204,13 @@ u32 waitInputWithTimeoutEx(u32 *outHeldKeys, s32 msec)
             Draw_Unlock();
             break;
         }
-        n++;
 
         hidScanInput();
-        keys = convertHidKeys(hidKeysDown()) | (convertHidKeys(hidKeysDownRepeat()) & DIRECTIONAL_KEYS);
+        u32 down = convertHidKeys(hidKeysDown());
         *outHeldKeys = convertHidKeys(hidKeysHeld());
+        keys = down | KeyRepeat_Update(&keyRepeat, down & DIRECTIONAL_KEYS, *outHeldKeys & DIRECTIONAL_KEYS, svcGetSystemTick());
         Draw_Unlock();
-    } while (keys == 0 && !menuShouldExit && isHidInitialized && (msec < 0 || n < msec));
+    } while (keys == 0 && !menuShouldExit && isHidInitialized && (deadline == 0 || svcGetSystemTick() < deadline));
 
 
     return keys;
@@ -190,24 +241,20 @@ static u32 scanHeldKeys(void)
 
 u32 waitComboWithTimeout(s32 msec)
 {
-    s32 n = 0;
+    u64 deadline = msec < 0 ? 0 : svcGetSystemTick() + msToTicks(msec);
     u32 keys = 0;
     u32 tempKeys = 0;
 
     // Wait for nothing to be pressed
-    while (scanHeldKeys() != 0 && !menuShouldExit && isHidInitialized && (msec < 0 || n < msec))
-    {
-        svcSleepThread(1 * 1000 * 1000LL);
-        n++;
-    }
+    while (scanHeldKeys() != 0 && !menuShouldExit && isHidInitialized && (deadline == 0 || svcGetSystemTick() < deadline))
+        menuWaitForHidUpdate(deadline);
 
-    if (menuShouldExit || !isHidInitialized || !(msec < 0 || n < msec))
+    if (menuShouldExit || !isHidInitialized || !(deadline == 0 || svcGetSystemTick() < deadline))
         return 0;
 
     do
     {
-        svcSleepThread(1 * 1000 * 1000LL);
-        n++;
+        menuWaitForHidUpdate(deadline);
 
         tempKeys = scanHeldKeys();
 
@@ -217,7 +264,7 @@ u32 waitComboWithTimeout(s32 msec)
             if (i == 1) keys = tempKeys;
         }
     }
-    while((keys == 0 || scanHeldKeys() != 0) && !menuShouldExit && isHidInitialized && (msec < 0 || n < msec));
+    while((keys == 0 || scanHeldKeys() != 0) && !menuShouldExit && isHidInitialized && (deadline == 0 || svcGetSystemTick() < deadline));
 
     return keys;
 }
@@ -387,6 +434,15 @@ void menuThreadMain(void)
 
     hidInit(); // assume this doesn't fail
     isHidInitialized = true;
+
+    // Get our own reference to the PAD update event, so that menus can block on it instead of polling
+    Handle hidMemHandle2, hidOtherEvents[4];
+    if (R_SUCCEEDED(HIDUSER_GetHandles(&hidMemHandle2, &hidPadEvent, &hidOtherEvents[0], &hidOtherEvents[1], &hidOtherEvents[2], &hidOtherEvents[3])))
+    {
+        svcCloseHandle(hidMemHandle2);
+        for (u32 i = 0; i < 4; i++)
+            svcCloseHandle(hidOtherEvents[i]);
+    }
     
     s64 out = 0;
     svcGetSystemInfo(&out, 0x10000, 3);
@@ -608,7 +664,7 @@ void menuShow(Menu *root)
     Draw_Lock();
     Draw_ClearFramebuffer();
     Draw_FlushFramebuffer();
-    hidSetRepeatParameters(0, 0);
+    menuSetKeyRepeat(0, 0);
     menuDraw(currentMenu, selectedItem);
     Draw_Unlock();
 
@@ -623,7 +679,7 @@ void menuShow(Menu *root)
         {
             menuComboReleased = true;
             Draw_Lock();
-            hidSetRepeatParameters(200, 100);
+            menuSetKeyRepeat(200, 100);
             Draw_Unlock();
         }
 
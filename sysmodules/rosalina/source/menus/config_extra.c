@@ -103,6 +103,7 @@ void ConfigExtra_SetTurnLedsOffStandby(void)
 void ConfigExtra_SetPerGamePlugin(void)
 {
     configExtra.perGamePlugin = !configExtra.perGamePlugin;
+    Luma_SharedConfig->per_game_plugin = configExtra.perGamePlugin;
     ConfigExtra_UpdateMenuItem(6, configExtra.perGamePlugin);
     configExtraSaved = false;
     ConfigExtra_UpdateMenuItem(7, configExtraSaved);
@@ -154,6 +155,9 @@ void ConfigExtra_ReadConfigExtra(void)
             configExtraSaved = true;
         }
     }
+
+    // Loader reads it from there instead of opening the file on each launch
+    Luma_SharedConfig->per_game_plugin = configExtra.perGamePlugin;
 }
 
 void ConfigExtra_WriteConfigExtra(void)
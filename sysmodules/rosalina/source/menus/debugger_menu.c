@@ -25,6 +25,7 @@
  */
 
 #include <stdio.h>
+#include <3ds/os.h>
 #include "menus/debugger_menu.h"
 #include "debugger.h"
 #include "draw.h"
@@ -37,6 +38,7 @@ Menu debuggerMenu = {
         {"Enable debugger", METHOD, .method = &DebuggerMenu_EnableDebugger},
         {"Disable debugger", METHOD, .method = &DebuggerMenu_DisableDebugger},
         {"Force-debug next application at launch", METHOD, .method = &DebuggerMenu_DebugNextApplicationByForce},
+        {"Debugger server statistics", METHOD, .method = &DebuggerMenu_ShowServerStatistics},
         {},
     }};
 
@@ -147,3 +149,43 @@ void DebuggerMenu_DebugNextApplicationByForce(void)
         Draw_Unlock();
     } while (!(waitInput() & KEY_B) && !menuShouldExit);
 }
+
+void DebuggerMenu_ShowServerStatistics(void)
+{
+    Draw_Lock();
+    Draw_ClearFramebuffer();
+    Draw_FlushFramebuffer();
+    Draw_Unlock();
+
+    do
+    {
+        bool initialized = gdbServer.referenceCount != 0;
+        sock_server_stats stats;
+
+        if (initialized)
+            server_get_stats(&gdbServer.super, &stats);
+
+        Draw_Lock();
+        Draw_DrawString(10, 10, COLOR_TITLE, "Debugger options menu");
+
+        if (!initialized)
+            Draw_DrawString(10, 30, COLOR_WHITE, "Debugger not enabled.");
+        else
+        {
+            u32 nbCallbacks = stats.clients.nb_callbacks;
+            u32 avgLatencyUs = nbCallbacks == 0 ? 0 : (u32)(1000 * 1000 * (stats.clients.total_latency / nbCallbacks) / SYSCLOCK_ARM11);
+            u32 maxLatencyUs = (u32)(1000 * 1000 * stats.clients.max_latency / SYSCLOCK_ARM11);
+
+            u32 posY = Draw_DrawFormattedString(10, 30, COLOR_WHITE, "Connections:  %lu accepted, %lu rejected", stats.accepted, stats.rejected);
+            posY = Draw_DrawFormattedString(10, posY + SPACING_Y, COLOR_WHITE, "              %lu closed", stats.closed);
+            posY = Draw_DrawFormattedString(10, posY + 2 * SPACING_Y, COLOR_WHITE, "Received:     %llu bytes", stats.clients.bytes_received);
+            posY = Draw_DrawFormattedString(10, posY + SPACING_Y, COLOR_WHITE, "Sent:         %llu bytes", stats.clients.bytes_sent);
+            posY = Draw_DrawFormattedString(10, posY + SPACING_Y, COLOR_WHITE, "Dropped:      %lu messages", stats.clients.drops);
+            posY = Draw_DrawFormattedString(10, posY + 2 * SPACING_Y, COLOR_WHITE, "Requests:     %lu", nbCallbacks);
+            Draw_DrawFormattedString(10, posY + SPACING_Y, COLOR_WHITE, "Latency:      %lu us avg, %lu us max", avgLatencyUs, maxLatencyUs);
+        }
+
+        Draw_FlushFramebuffer();
+        Draw_Unlock();
+    } while (!(waitInputWithTimeout(1000) & KEY_B) && !menuShouldExit);
+}
@@ -29,6 +29,8 @@
 #include "luma_config.h"
 #include "luma_shared_config.h"
 #include "input_redirection.h"
+#include "input_recorder.h"
+#include "frame_profiler.h"
 #include "menu.h"
 #include "menus.h"
 #include "ntp.h"
@@ -39,6 +41,7 @@
 #include "minisoc.h"
 #include "ifile.h"
 #include "pmdbgext.h"
+#include "loaderext.h"
 #include "plugin.h"
 #include "process_patches.h"
 #include "menus/screen_filters.h"
@@ -79,11 +82,15 @@ Menu miscellaneousMenu = {
         { "Switch the hb. title to the current app.", METHOD, .method = &MiscellaneousMenu_SwitchBoot3dsxTargetTitle },
         { "Change the menu combo", METHOD, .method = &MiscellaneousMenu_ChangeMenuCombo },
         { "Start InputRedirection", METHOD, .method = &MiscellaneousMenu_InputRedirection },
+        { "Input recorder", METHOD, .method = &MiscellaneousMenu_InputRecorder },
+        { "Frame pacing profiler", METHOD, .method = &MiscellaneousMenu_FrameProfiler },
         { "Update time and date via NTP", METHOD, .method = &MiscellaneousMenu_UpdateTimeDateNtp },
         { "Nullify user time offset", METHOD, .method = &MiscellaneousMenu_NullifyUserTimeOffset },
         { "Dump DSP firmware", METHOD, .method = &MiscellaneousMenu_DumpDspFirm },
        // { "Chainloader", METHOD, .method = &chainloader },
         { "Set Play Coins to 300", METHOD, .method = &MiscellaneousMenu_MaxPlayCoins },
+        { "Show the last termination trace", METHOD, .method = &MiscellaneousMenu_ShowShutdownTrace },
+        { "Show the last launch timings", METHOD, .method = &MiscellaneousMenu_ShowLaunchTraces },
         {},
     }
 };
@@ -572,3 +579,268 @@ void MiscellaneousMenu_MaxPlayCoins(void)
     }
     while(!(waitInput() & KEY_B) && !menuShouldExit);
 }
+
+#define SHUTDOWN_TRACE_ROWS 12
+
+void MiscellaneousMenu_ShowShutdownTrace(void)
+{
+    static const char *reasons[] = {
+        "none", "application exit", "title termination", "process termination", "reboot", "firmlaunch", "homebrew chainload"
+    };
+    static ShutdownTrace trace; // too big for the stack
+
+    Result res = PMDBG_GetShutdownTrace(&trace);
+    u32 scroll = 0;
+    u32 pressed = 0;
+
+    do
+    {
+        Draw_Lock();
+        Draw_ClearFramebuffer();
+        Draw_DrawString(10, 10, COLOR_TITLE, "Miscellaneous options menu");
+
+        if(R_FAILED(res))
+            Draw_DrawFormattedString(10, 30, COLOR_WHITE, "Failed to get the termination trace (0x%08lx).", (u32)res);
+        else if(trace.reason == SHUTDOWNREASON_NONE || trace.reason >= sizeof(reasons) / sizeof(reasons[0]))
+            Draw_DrawString(10, 30, COLOR_WHITE, "No process has been terminated yet.");
+        else
+        {
+            u32 posY = Draw_DrawFormattedString(10, 30, COLOR_WHITE, "Last termination: %s, %lu.%03lu ms",
+                reasons[trace.reason], trace.totalUs / 1000, trace.totalUs % 1000);
+            posY = Draw_DrawFormattedString(10, posY + SPACING_Y, COLOR_WHITE, "%lu processes in %lu waves, %lu terminated by force",
+                trace.numEntries, trace.numWaves, trace.numForced);
+            posY = Draw_DrawString(10, posY + 2 * SPACING_Y, COLOR_WHITE, "Wave PID   Title ID          Ack (us) Exit (ms)");
+
+            for(u32 i = scroll; i < trace.numEntries && i < scroll + SHUTDOWN_TRACE_ROWS; i++)
+            {
+                const ShutdownTraceEntry *entry = &trace.entries[i];
+                u32 color = (entry->flags & SHUTDOWNTRACE_FLAG_FORCED) ? COLOR_RED : COLOR_WHITE;
+                char exitTime[16];
+
+                if(entry->flags & SHUTDOWNTRACE_FLAG_EXITED)
+                    sprintf(exitTime, "%5lu.%03lu", entry->exitUs / 1000, entry->exitUs % 1000);
+                else
+                    sprintf(exitTime, "  running");
+
+                posY = Draw_DrawFormattedString(10, posY + SPACING_Y, color, "%4u %-5lu %016llX %8lu %s%s", entry->wave, entry->pid,
+                    entry->titleId, entry->ackUs, exitTime, (entry->flags & SHUTDOWNTRACE_FLAG_DEPENDENCY) ? " D" : "");
+            }
+
+            if(trace.numEntries > SHUTDOWN_TRACE_ROWS)
+                Draw_DrawString(10, SCREEN_BOT_HEIGHT - 20, COLOR_TITLE, "Use UP/DOWN to scroll. Red: terminated by force.");
+            else
+                Draw_DrawString(10, SCREEN_BOT_HEIGHT - 20, COLOR_TITLE, "Red: terminated by force.");
+        }
+
+        Draw_FlushFramebuffer();
+        Draw_Unlock();
+
+        pressed = waitInput();
+        if((pressed & KEY_DOWN) && scroll + SHUTDOWN_TRACE_ROWS < trace.numEntries)
+            scroll++;
+        else if((pressed & KEY_UP) && scroll > 0)
+            scroll--;
+    }
+    while(!(pressed & KEY_B) && !menuShouldExit);
+}
+
+static void formatLaunchTime(char *out, u32 us)
+{
+    sprintf(out, "%4lu.%lu", us / 1000, (us % 1000) / 100);
+}
+
+void MiscellaneousMenu_ShowLaunchTraces(void)
+{
+    static LaunchTrace traces[LAUNCHTRACE_COUNT];
+
+    u32 count = 0;
+    Result res = LOADEREXT_GetLaunchTraces(traces, &count);
+    u32 numTraces = count < LAUNCHTRACE_COUNT ? count : LAUNCHTRACE_COUNT;
+
+    do
+    {
+        Draw_Lock();
+        Draw_ClearFramebuffer();
+        Draw_DrawString(10, 10, COLOR_TITLE, "Miscellaneous options menu");
+
+        if(R_FAILED(res))
+            Draw_DrawFormattedString(10, 30, COLOR_WHITE, "Failed to get the launch timings (0x%08lx).", (u32)res);
+        else if(numTraces == 0)
+            Draw_DrawString(10, 30, COLOR_WHITE, "No process has been launched yet.");
+        else
+        {
+            u32 posY = Draw_DrawFormattedString(10, 30, COLOR_WHITE, "Last %lu of %lu launches, newest first (ms):", numTraces, count);
+            posY = Draw_DrawString(10, posY + 2 * SPACING_Y, COLOR_WHITE, "Title ID           Info   Code  Patch  Total FS");
+
+            for(u32 i = 0; i < numTraces; i++)
+            {
+                const LaunchTrace *trace = &traces[(count - 1 - i) % LAUNCHTRACE_COUNT];
+                char programInfo[16], codeLoad[16], patch[16], total[16];
+
+                formatLaunchTime(programInfo, trace->programInfoUs);
+                formatLaunchTime(codeLoad, trace->codeLoadUs);
+                formatLaunchTime(patch, trace->patchUs);
+                formatLaunchTime(total, trace->totalUs);
+                posY = Draw_DrawFormattedString(10, posY + SPACING_Y, COLOR_WHITE, "%016llX %s %s %s %s %2lu%s", trace->titleId,
+                    programInfo, codeLoad, patch, total, trace->fsRequests, trace->overrides != 0 ? " +" : "");
+            }
+
+            Draw_DrawString(10, SCREEN_BOT_HEIGHT - 20, COLOR_TITLE, "+: per-title overrides applied.");
+        }
+
+        Draw_FlushFramebuffer();
+        Draw_Unlock();
+    }
+    while(!(waitInput() & KEY_B) && !menuShouldExit);
+}
+
+void MiscellaneousMenu_InputRecorder(void)
+{
+    static const char *modes[] = { "idle", "recording", "replaying" };
+
+    InputRecorderStatus status;
+    Result res = 0;
+    u32 pressed = 0;
+
+    do
+    {
+        InputRecorder_GetStatus(&status);
+
+        Draw_Lock();
+        Draw_ClearFramebuffer();
+        Draw_DrawString(10, 10, COLOR_TITLE, "Miscellaneous options menu");
+
+        u32 posY = Draw_DrawFormattedString(10, 30, COLOR_WHITE, "Input recorder: %s%s", status.active ? modes[status.mode] : modes[0],
+            status.active && rosalinaOpen ? " (starts when the menu is closed)" : "");
+
+        if(status.mode != INPUT_RECORDER_MODE_OFF)
+        {
+            posY = Draw_DrawFormattedString(10, posY + 2 * SPACING_Y, COLOR_WHITE, "Last %s: %016llX",
+                status.mode == INPUT_RECORDER_MODE_RECORD ? "recording" : "replay", status.titleId);
+            if(status.mode == INPUT_RECORDER_MODE_RECORD)
+            {
+                posY = Draw_DrawFormattedString(10, posY + SPACING_Y, COLOR_WHITE, "%lu updates, %lu dropped", status.numUpdates, status.numDroppedUpdates);
+                if(!status.active)
+                    posY = Draw_DrawFormattedString(10, posY + SPACING_Y, COLOR_WHITE, "%lu bytes", status.dataSize);
+            }
+            else
+                posY = Draw_DrawFormattedString(10, posY + SPACING_Y, COLOR_WHITE, "%lu/%lu updates, %lu underruns", status.numUpdates, status.totalUpdates, status.numUnderruns);
+
+            if(R_FAILED(status.result))
+                posY = Draw_DrawFormattedString(10, posY + SPACING_Y, COLOR_RED, "Failed (0x%08lx).", (u32)status.result);
+        }
+
+        if(R_FAILED(res))
+            posY = Draw_DrawFormattedString(10, posY + 2 * SPACING_Y, COLOR_RED, "Operation failed (0x%08lx).", (u32)res);
+
+        Draw_DrawString(10, SCREEN_BOT_HEIGHT - 30, COLOR_TITLE, "Recordings are stored in /luma/inputs.");
+        Draw_DrawString(10, SCREEN_BOT_HEIGHT - 20, COLOR_TITLE, "A: record, Y: replay, X: stop, B: back.");
+
+        Draw_FlushFramebuffer();
+        Draw_Unlock();
+
+        // Keep the counters updating
+        pressed = waitInputWithTimeout(500);
+        if(pressed & KEY_A)
+            res = InputRecorder_StartRecording();
+        else if(pressed & KEY_Y)
+            res = InputRecorder_StartReplay();
+        else if(pressed & KEY_X)
+            res = InputRecorder_Stop(5 * 1000 * 1000 * 1000LL);
+    }
+    while(!(pressed & KEY_B) && !menuShouldExit);
+}
+
+static void MiscellaneousMenu_FormatFps(char *out, u32 fpsX100)
+{
+    sprintf(out, "%3lu.%02lu", fpsX100 / 100, fpsX100 % 100);
+}
+
+static void MiscellaneousMenu_FormatMs(char *out, u32 us)
+{
+    sprintf(out, "%3lu.%03lu", us / 1000, us % 1000);
+}
+
+void MiscellaneousMenu_FrameProfiler(void)
+{
+    static FrameStats stats[FRAME_PROFILER_NUM_SCREENS]; // too big for the stack
+    FrameStatsSummary summaries[FRAME_PROFILER_NUM_SCREENS];
+    char path[64], a[16], b[16];
+    Result res = 0;
+    bool exported = false;
+    u32 pressed = 0;
+
+    do
+    {
+        for(u32 i = 0; i < FRAME_PROFILER_NUM_SCREENS; i++)
+        {
+            FrameProfiler_GetStats((FrameProfilerScreen)i, &stats[i]);
+            FrameStats_GetSummary(&stats[i], &summaries[i]);
+        }
+
+        Draw_Lock();
+        Draw_ClearFramebuffer();
+        Draw_DrawString(10, 10, COLOR_TITLE, "Miscellaneous options menu");
+
+        u32 posY = Draw_DrawFormattedString(10, 30, COLOR_WHITE, "Frame pacing profiler: %s, overlay %s",
+            frameProfilerEnabled ? "running" : "stopped", frameProfilerOverlayEnabled ? "on" : "off");
+        posY = Draw_DrawString(10, posY + SPACING_Y, COLOR_WHITE, "Paused while this menu is open.");
+
+        posY = Draw_DrawString(10, posY + 2 * SPACING_Y, COLOR_WHITE, "               Top        Bottom");
+        MiscellaneousMenu_FormatFps(a, summaries[0].fpsX100);
+        MiscellaneousMenu_FormatFps(b, summaries[1].fpsX100);
+        posY = Draw_DrawFormattedString(10, posY + SPACING_Y, COLOR_WHITE, "FPS         %9s  %9s", a, b);
+        MiscellaneousMenu_FormatFps(a, summaries[0].low1FpsX100);
+        MiscellaneousMenu_FormatFps(b, summaries[1].low1FpsX100);
+        posY = Draw_DrawFormattedString(10, posY + SPACING_Y, COLOR_WHITE, "1%% low      %9s  %9s", a, b);
+        MiscellaneousMenu_FormatFps(a, summaries[0].low01FpsX100);
+        MiscellaneousMenu_FormatFps(b, summaries[1].low01FpsX100);
+        posY = Draw_DrawFormattedString(10, posY + SPACING_Y, COLOR_WHITE, "0.1%% low    %9s  %9s", a, b);
+        MiscellaneousMenu_FormatMs(a, summaries[0].avgFrameUs);
+        MiscellaneousMenu_FormatMs(b, summaries[1].avgFrameUs);
+        posY = Draw_DrawFormattedString(10, posY + SPACING_Y, COLOR_WHITE, "Avg (ms)    %9s  %9s", a, b);
+        MiscellaneousMenu_FormatMs(a, summaries[0].maxFrameUs);
+        MiscellaneousMenu_FormatMs(b, summaries[1].maxFrameUs);
+        posY = Draw_DrawFormattedString(10, posY + SPACING_Y, COLOR_WHITE, "Max (ms)    %9s  %9s", a, b);
+        MiscellaneousMenu_FormatMs(a, summaries[0].jitterUs);
+        MiscellaneousMenu_FormatMs(b, summaries[1].jitterUs);
+        posY = Draw_DrawFormattedString(10, posY + SPACING_Y, COLOR_WHITE, "Jitter (ms) %9s  %9s", a, b);
+        posY = Draw_DrawFormattedString(10, posY + SPACING_Y, COLOR_WHITE, "Frames      %9lu  %9lu", stats[0].numFrames, stats[1].numFrames);
+
+        // How many VBlanks frames were displayed for, over the whole session
+        for(u32 i = 0; i < FRAME_PROFILER_NUM_SCREENS; i++)
+        {
+            const u32 *h = stats[i].vblankHistogram;
+            u32 total = stats[i].numFrames != 0 ? stats[i].numFrames : 1;
+            u32 longer = 0;
+
+            for(u32 j = 4; j <= FRAMESTATS_MAX_VBLANKS; j++)
+                longer += h[j];
+            posY = Draw_DrawFormattedString(10, posY + SPACING_Y, COLOR_WHITE, "%s VBlanks 1: %2lu%% 2: %2lu%% 3: %2lu%% 4+: %2lu%%",
+                i == 0 ? "Top   " : "Bottom", 100 * h[1] / total, 100 * h[2] / total, 100 * h[3] / total, 100 * longer / total);
+        }
+
+        if(R_FAILED(res))
+            posY = Draw_DrawFormattedString(10, posY + 2 * SPACING_Y, COLOR_RED, "Operation failed (0x%08lx).", (u32)res);
+        else if(exported)
+            posY = Draw_DrawFormattedString(10, posY + 2 * SPACING_Y, COLOR_WHITE, "Exported to %s", path);
+
+        Draw_DrawString(10, SCREEN_BOT_HEIGHT - 20, COLOR_TITLE, "A: start/stop, X: overlay, Y: export CSV, B: back.");
+
+        Draw_FlushFramebuffer();
+        Draw_Unlock();
+
+        pressed = waitInput();
+        exported = false;
+        if(pressed & KEY_A)
+            res = frameProfilerEnabled ? FrameProfiler_Stop(5 * 1000 * 1000 * 1000LL) : FrameProfiler_Start();
+        else if(pressed & KEY_X)
+            frameProfilerOverlayEnabled = !frameProfilerOverlayEnabled;
+        else if(pressed & KEY_Y)
+        {
+            res = FrameProfiler_ExportCsv(path);
+            exported = R_SUCCEEDED(res);
+        }
+    }
+    while(!(pressed & KEY_B) && !menuShouldExit);
+}
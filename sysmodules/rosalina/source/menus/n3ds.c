@@ -34,10 +34,11 @@
 #include "menus.h"
 #include "ifile.h"
 #include "pmdbgext.h"
+#include "title_settings.h"
 #include "config_template_ini.h"
 #include "configExtra_ini.h"
 
-static char clkRateBuf[128 + 1], new3dsMenuBuf[128 + 1], new3dsMenuConfigBuf[128 + 1], fileNameBuf[64];
+static char clkRateBuf[128 + 1], new3dsMenuBuf[128 + 1], new3dsMenuConfigBuf[128 + 1];
 
 Menu N3DSMenu = {
     "New 3DS menu",
@@ -100,84 +101,43 @@ void N3DSMenu_CheckForConfigFile(void)
     FS_ProgramInfo programInfo;
     u32 pid;
     u32 launchFlags;
-    
-    FS_ArchiveID archiveId;
-    s64 out;
-    bool isSdMode;
-    
-    if (R_FAILED(svcGetSystemInfo(&out, 0x10000, 0x203)))
-        svcBreak(USERBREAK_ASSERT);
-
-    isSdMode = (bool)out;
-    
-    archiveId = isSdMode ? ARCHIVE_SDMC : ARCHIVE_NAND_RW;
 
     if(R_SUCCEEDED(PMDBG_GetCurrentAppInfo(&programInfo, &pid, &launchFlags)))
     {
-        programId = programInfo.programId;
-
-        sprintf(fileNameBuf, "%s%016llX%s", "/luma/n3ds/", programId, ".bin");
-        IFile file;
+        LumaTitleSettings settings;
 
-        if(R_SUCCEEDED(IFile_Open(&file, archiveId, fsMakePath(PATH_EMPTY, ""),fsMakePath(PATH_ASCII, fileNameBuf), FS_OPEN_READ)))
-        {
-            IFile_Close(&file);
-            currentTitleUseN3DS = true;
-        }
+        programId = programInfo.programId;
+        currentTitleUseN3DS = TitleSettings_Get(programId, &settings) && (settings.flags & LUMA_TITLE_SETTING_N3DS) != 0;
     }
 
     N3DSMenu_UpdateConfigStatus();
 }
 
-void N3DSMenu_CreateConfigFile(void)
+void N3DSMenu_UpdateConfig(void)
 {
-    IFile file;
-    FS_ArchiveID archiveId;
-    s64 out;
-    bool isSdMode;
-    
-    if (R_FAILED(svcGetSystemInfo(&out, 0x10000, 0x203)))
-        svcBreak(USERBREAK_ASSERT);
+    LumaTitleSettings settings;
 
-    isSdMode = (bool)out;
-    
-    archiveId = isSdMode ? ARCHIVE_SDMC : ARCHIVE_NAND_RW;
-    
-    if(R_SUCCEEDED(IFile_Open(&file, archiveId, fsMakePath(PATH_EMPTY, ""), fsMakePath(PATH_ASCII, fileNameBuf), FS_OPEN_CREATE | FS_OPEN_WRITE)))
+    if(!TitleSettings_Get(programId, &settings))
     {
-         IFile_Close(&file);
-         currentTitleUseN3DS = true;
+        memset(&settings, 0, sizeof(settings));
+        settings.title_id = programId;
     }
-}
-
-void N3DSMenu_DeleteConfigFile(void)
-{
-    FS_Archive archive;
-    FS_ArchiveID archiveId;
-    s64 out;
-    bool isSdMode;
-    
-    if (R_FAILED(svcGetSystemInfo(&out, 0x10000, 0x203)))
-        svcBreak(USERBREAK_ASSERT);
-
-    isSdMode = (bool)out;
-    
-    archiveId = isSdMode ? ARCHIVE_SDMC : ARCHIVE_NAND_RW;
 
-    if(R_SUCCEEDED(FSUSER_OpenArchive(&archive, archiveId, fsMakePath(PATH_EMPTY, ""))))
+    if(currentTitleUseN3DS)
+        settings.flags &= ~LUMA_TITLE_SETTING_N3DS;
+    else
     {
-        if(R_SUCCEEDED(FSUSER_DeleteFile(archive, fsMakePath(PATH_ASCII, fileNameBuf))))
-        {
-            currentTitleUseN3DS = false;
-        }
-    
-        FSUSER_CloseArchive(archive);
+        // Remember the current clock rate and L2 cache state, or just enable the L2 cache like before if both are off
+        N3DSMenu_UpdateStatus();
+        settings.flags |= LUMA_TITLE_SETTING_N3DS;
+        settings.n3ds_mode = (L2CacheEnabled ? LUMA_N3DS_MODE_L2_CACHE : 0) | (clkRate != 268 ? LUMA_N3DS_MODE_CLOCK_804MHZ : 0);
+        if(settings.n3ds_mode == 0)
+            settings.n3ds_mode = LUMA_N3DS_MODE_L2_CACHE;
     }
-}
 
-void N3DSMenu_UpdateConfig(void)
-{
-    currentTitleUseN3DS ? N3DSMenu_DeleteConfigFile() : N3DSMenu_CreateConfigFile();
+    if(R_SUCCEEDED(TitleSettings_Set(&settings)))
+        currentTitleUseN3DS = !currentTitleUseN3DS;
+
     N3DSMenu_UpdateConfigStatus();
 }
 
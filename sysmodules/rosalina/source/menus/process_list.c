@@ -38,6 +38,9 @@
 #include "ifile.h"
 #include "gdb/server.h"
 #include "minisoc.h"
+#include "ram_search.h"
+#include "core_dump.h"
+#include "save_state.h"
 #include <arpa/inet.h>
 #include <sys/socket.h>
 #include "config_template_ini.h"
@@ -624,6 +627,334 @@ static void ProcessListMenu_MemoryViewer(const ProcessInfo *info)
     }
 }
 
+static void ProcessListMenu_DumpProcess(const ProcessInfo *info)
+{
+    CoreDumpStats stats;
+    Result res = 0;
+    bool done = false;
+
+    Draw_Lock();
+    Draw_ClearFramebuffer();
+    Draw_FlushFramebuffer();
+    Draw_Unlock();
+
+    do
+    {
+        Draw_Lock();
+        Draw_DrawString(10, 10, COLOR_TITLE, "Process dump");
+        if(!done)
+        {
+            u32 posY = Draw_DrawFormattedString(10, 30, COLOR_WHITE, "Dump all mapped memory and the thread contexts of %.8s into an ELF core file.", info->name);
+            Draw_DrawString(10, posY + 2 * SPACING_Y, COLOR_WHITE, "Press A to dump, Y to dump with compression\n(use tools/coredump.py to decompress), B to go back.");
+        }
+        else if(R_FAILED(res))
+            Draw_DrawFormattedString(10, 30, COLOR_WHITE, "Operation failed (0x%08lx).", res);
+        else
+        {
+            Draw_DrawString(10, 30, COLOR_WHITE, "Operation succeeded.");
+            Draw_DrawFormattedString(10, 30 + 2 * SPACING_Y, COLOR_WHITE, "%lu segments, %lu threads", stats.numSegments, stats.numThreads);
+            Draw_DrawFormattedString(10, 30 + 3 * SPACING_Y, COLOR_WHITE, "%lu KB written (%lu KB of memory)", (u32)(stats.fileSize >> 10), (u32)(stats.rawSize >> 10));
+            Draw_DrawFormattedString(10, 30 + 4 * SPACING_Y, COLOR_WHITE, "Took %lu ms.", stats.elapsedMs);
+            Draw_DrawString(10, 30 + 6 * SPACING_Y, COLOR_WHITE, "Press B to go back.");
+        }
+        Draw_FlushFramebuffer();
+        Draw_Unlock();
+
+        u32 pressed = waitInputWithTimeout(1000);
+        if(pressed & KEY_B)
+            break;
+        else if(!done && (pressed & (KEY_A | KEY_Y)))
+        {
+            Draw_Lock();
+            Draw_ClearFramebuffer();
+            Draw_DrawString(10, 10, COLOR_TITLE, "Process dump");
+            Draw_DrawString(10, 30, COLOR_WHITE, "Please wait, this may take a while...");
+            Draw_FlushFramebuffer();
+            Draw_Unlock();
+
+            res = CoreDump_DumpProcess(info->pid, info->name, (pressed & KEY_Y) != 0, &stats);
+            done = true;
+
+            Draw_Lock();
+            Draw_ClearFramebuffer();
+            Draw_Unlock();
+        }
+    }
+    while(!menuShouldExit);
+
+    Draw_Lock();
+    Draw_ClearFramebuffer();
+    Draw_FlushFramebuffer();
+    Draw_Unlock();
+}
+
+static void ProcessListMenu_SaveStates(const ProcessInfo *info)
+{
+    SaveStateHeader headers[SAVESTATE_NUM_SLOTS];
+    bool used[SAVESTATE_NUM_SLOTS];
+    SaveStateStats stats;
+    const char *operation = NULL;
+    Result res = 0;
+    u32 selected = 0;
+    bool refresh = true;
+
+    Draw_Lock();
+    Draw_ClearFramebuffer();
+    Draw_FlushFramebuffer();
+    Draw_Unlock();
+
+    do
+    {
+        if(refresh)
+        {
+            for(u32 i = 0; i < SAVESTATE_NUM_SLOTS; i++)
+                used[i] = R_SUCCEEDED(SaveState_GetSlotInfo(info->titleId, i, &headers[i]));
+            refresh = false;
+        }
+
+        Draw_Lock();
+        Draw_DrawString(10, 10, COLOR_TITLE, "Save states");
+        Draw_DrawFormattedString(10, 30, COLOR_WHITE, "%.8s (%016llx)", info->name, info->titleId);
+
+        for(u32 i = 0; i < SAVESTATE_NUM_SLOTS; i++)
+        {
+            u32 posY = 30 + (2 + i) * SPACING_Y;
+            Draw_DrawCharacter(10, posY, COLOR_TITLE, i == selected ? '>' : ' ');
+            if(used[i])
+            {
+                char dateTimeStr[32];
+                dateTimeToString(dateTimeStr, headers[i].creationTime, false);
+                Draw_DrawFormattedString(30, posY, COLOR_WHITE, "Slot %lu  %-5s %s  %6lu pages", i,
+                    (headers[i].flags & SAVESTATE_FLAG_INCREMENTAL) ? "incr." : "full", dateTimeStr, headers[i].numPages);
+            }
+            else
+                Draw_DrawFormattedString(30, posY, COLOR_WHITE, "Slot %lu  (empty)%38s", i, "");
+        }
+
+        u32 posY = Draw_DrawString(10, 30 + (3 + SAVESTATE_NUM_SLOTS) * SPACING_Y, COLOR_WHITE,
+            "Saves the writable memory and the thread contexts.\n"
+            "Snapshots can only be restored into the same run\n"
+            "of the title (handles are not saved).\n\n"
+            "A: save, X: save only what changed since slot 0,\n"
+            "Y: restore, B: go back.");
+
+        if(operation != NULL)
+        {
+            posY += 2 * SPACING_Y;
+            if(R_FAILED(res))
+                Draw_DrawFormattedString(10, posY, COLOR_RED, "%s failed (0x%08lx).%20s", operation, res, "");
+            else
+            {
+                posY = Draw_DrawFormattedString(10, posY, COLOR_GREEN, "%s succeeded in %lu ms.%20s", operation, stats.elapsedMs, "");
+                posY = Draw_DrawFormattedString(10, posY + SPACING_Y, COLOR_WHITE, "%lu pages: %lu zero, %lu unchanged, %lu duplicate      ",
+                    stats.numPages, stats.numZeroPages, stats.numBasePages, stats.numDedupPages);
+                Draw_DrawFormattedString(10, posY + SPACING_Y, COLOR_WHITE, "%lu chunks, %lu KB, %lu threads (%lu missing)      ",
+                    stats.numChunks, (u32)(stats.fileSize >> 10), stats.numThreads, stats.numThreadsMissing);
+            }
+        }
+        Draw_FlushFramebuffer();
+        Draw_Unlock();
+
+        u32 pressed = waitInputWithTimeout(1000);
+        if(pressed & KEY_B)
+            break;
+        else if(pressed & KEY_DOWN)
+            selected = (selected + 1) % SAVESTATE_NUM_SLOTS;
+        else if(pressed & KEY_UP)
+            selected = (selected + SAVESTATE_NUM_SLOTS - 1) % SAVESTATE_NUM_SLOTS;
+        else if(pressed & (KEY_A | KEY_X | KEY_Y))
+        {
+            Draw_Lock();
+            Draw_ClearFramebuffer();
+            Draw_DrawString(10, 10, COLOR_TITLE, "Save states");
+            Draw_DrawString(10, 30, COLOR_WHITE, "Please wait, this may take a while...");
+            Draw_FlushFramebuffer();
+            Draw_Unlock();
+
+            if(pressed & KEY_Y)
+            {
+                operation = "Restore";
+                res = SaveState_Restore(info->pid, info->titleId, selected, &stats);
+            }
+            else
+            {
+                operation = (pressed & KEY_X) ? "Incremental save" : "Save";
+                res = SaveState_Save(info->pid, info->titleId, selected, (pressed & KEY_X) != 0, &stats);
+                refresh = true;
+            }
+
+            Draw_Lock();
+            Draw_ClearFramebuffer();
+            Draw_Unlock();
+        }
+    }
+    while(!menuShouldExit);
+
+    Draw_Lock();
+    Draw_ClearFramebuffer();
+    Draw_FlushFramebuffer();
+    Draw_Unlock();
+}
+
+static void ProcessListMenu_RamSearch(const ProcessInfo *info)
+{
+    #define RAMSEARCH_RESULTS_PER_PAGE 10
+
+    Handle processHandle;
+    RamSearchContext ctx;
+    Result res = svcOpenProcess(&processHandle, info->pid);
+    if(R_FAILED(res))
+        return;
+
+    res = RamSearch_Init(&ctx, processHandle, RAMSEARCH_TYPE_U32);
+
+    RamSearchCompare cmp = RAMSEARCH_CMP_EQUAL;
+    u32 operand = 0;
+    u32 digit = 0; // selected hex digit of the operand, from the right
+    u32 page = 0;
+    char status[64] = {0};
+
+    if(R_FAILED(res))
+        sprintf(status, "Could not allocate memory (0x%08lx).", res);
+
+    Draw_Lock();
+    Draw_ClearFramebuffer();
+    Draw_FlushFramebuffer();
+    Draw_Unlock();
+
+    do
+    {
+        u32 addrs[RAMSEARCH_RESULTS_PER_PAGE], values[RAMSEARCH_RESULTS_PER_PAGE];
+        u32 n = ctx.heap != NULL ? RamSearch_GetCandidates(&ctx, page * RAMSEARCH_RESULTS_PER_PAGE, addrs, values, RAMSEARCH_RESULTS_PER_PAGE) : 0;
+        const u32 statusY = 30 + (RAMSEARCH_RESULTS_PER_PAGE + 7) * SPACING_Y;
+
+        Draw_Lock();
+        Draw_DrawFormattedString(10, 10, COLOR_TITLE, "RAM search (%.8s)", info->name);
+
+        Draw_DrawFormattedString(10, 30, COLOR_WHITE, "Type: %-5s  Pass: %lu  Candidates: %lu", RamSearch_GetTypeName(ctx.type), ctx.numPasses, ctx.numCandidates);
+        Draw_DrawFormattedString(10, 30 + SPACING_Y, COLOR_WHITE, "Value %s", RamSearch_GetCompareName(cmp));
+        if(RamSearch_CompareNeedsOperand(cmp))
+        {
+            char operandStr[9];
+            sprintf(operandStr, "%08lX", operand);
+            Draw_DrawString(10 + SPACING_X * 26, 30 + SPACING_Y, COLOR_WHITE, operandStr);
+            Draw_DrawCharacter(10 + SPACING_X * (26 + 7 - digit), 30 + SPACING_Y, COLOR_GREEN, operandStr[7 - digit]);
+        }
+
+        for(u32 i = 0; i < n; i++)
+            Draw_DrawFormattedString(10, 30 + (i + 3) * SPACING_Y, COLOR_WHITE, "%08lX    %08lX", addrs[i], values[i]);
+
+        Draw_DrawString(10, statusY - 3 * SPACING_Y, COLOR_WHITE, "L/R: comparison, D-PAD: value, SELECT: type");
+        Draw_DrawString(10, statusY - 2 * SPACING_Y, COLOR_WHITE, "A: scan, Y: unknown value snapshot, START: reset");
+        Draw_DrawString(10, statusY - 1 * SPACING_Y, COLOR_WHITE, "X: export as cheats, ZL/ZR: results page");
+        Draw_DrawString(10, statusY, COLOR_WHITE, status);
+
+        Draw_FlushFramebuffer();
+        Draw_Unlock();
+
+        u32 pressed = waitInputWithTimeout(1000);
+        if(pressed != 0)
+        {
+            Draw_Lock();
+            Draw_ClearFramebuffer();
+            Draw_Unlock();
+        }
+
+        if(ctx.heap == NULL)
+        {
+            if(pressed & KEY_B)
+                break;
+            continue;
+        }
+
+        if(pressed & KEY_A)
+        {
+            Draw_Lock();
+            Draw_DrawString(10, statusY, COLOR_WHITE, "Scanning, please wait...                ");
+            Draw_FlushFramebuffer();
+            Draw_Unlock();
+
+            res = RamSearch_Refine(&ctx, cmp, operand);
+            page = 0;
+            if(res == RAMSEARCH_ERR_NO_BASELINE)
+                sprintf(status, "Take a snapshot first.");
+            else if(R_FAILED(res))
+                sprintf(status, "Scan failed (0x%08lx).", res);
+            else
+                sprintf(status, "Pass done in %lu ms.", ctx.lastPassMs);
+        }
+        else if(pressed & KEY_Y)
+        {
+            Draw_Lock();
+            Draw_DrawString(10, statusY, COLOR_WHITE, "Saving snapshot, please wait...         ");
+            Draw_FlushFramebuffer();
+            Draw_Unlock();
+
+            res = RamSearch_Snapshot(&ctx);
+            page = 0;
+            if(R_FAILED(res))
+                sprintf(status, "Snapshot failed (0x%08lx).", res);
+            else
+                sprintf(status, "Snapshot taken in %lu ms.", ctx.lastPassMs);
+        }
+        else if(pressed & KEY_X)
+        {
+            u32 numExported;
+            res = RamSearch_ExportCheats(&ctx, &numExported);
+            if(R_FAILED(res))
+                sprintf(status, "Export failed (0x%08lx).", res);
+            else
+                sprintf(status, "Exported %lu cheat(s).", numExported);
+        }
+        else if(pressed & KEY_START)
+        {
+            RamSearch_Reset(&ctx, ctx.type);
+            page = 0;
+            status[0] = 0;
+        }
+        else if(pressed & KEY_SELECT)
+        {
+            // The candidates are only meaningful for one value type
+            RamSearch_Reset(&ctx, (ctx.type + 1) % RAMSEARCH_TYPE_MAX);
+            page = 0;
+            status[0] = 0;
+        }
+        else if(pressed & KEY_L)
+            cmp = (cmp + RAMSEARCH_CMP_MAX - 1) % RAMSEARCH_CMP_MAX;
+        else if(pressed & KEY_R)
+            cmp = (cmp + 1) % RAMSEARCH_CMP_MAX;
+        else if(pressed & KEY_LEFT)
+            digit = (digit + 1) % 8;
+        else if(pressed & KEY_RIGHT)
+            digit = (digit + 7) % 8;
+        else if(pressed & KEY_UP)
+            operand += 1u << (4 * digit);
+        else if(pressed & KEY_DOWN)
+            operand -= 1u << (4 * digit);
+        else if(pressed & KEY_ZL)
+            page = page > 0 ? page - 1 : 0;
+        else if(pressed & KEY_ZR)
+        {
+            if((page + 1) * RAMSEARCH_RESULTS_PER_PAGE < ctx.numCandidates)
+                page++;
+        }
+        else if(pressed & KEY_B)
+            break;
+    }
+    while(!menuShouldExit);
+
+    if(ctx.heap != NULL)
+        RamSearch_Exit(&ctx);
+    svcCloseHandle(processHandle);
+
+    Draw_Lock();
+    Draw_ClearFramebuffer();
+    Draw_FlushFramebuffer();
+    Draw_Unlock();
+
+    #undef RAMSEARCH_RESULTS_PER_PAGE
+}
+
 static inline void ProcessListMenu_HandleSelected(const ProcessInfo *info)
 {
     if(!gdbServer.super.running || info->isZombie)
@@ -749,6 +1080,12 @@ void RosalinaMenu_ProcessList(void)
             break;
         else if(pressed & KEY_A)
             ProcessListMenu_HandleSelected(&infos[selected]);
+        else if((pressed & KEY_Y) && !infos[selected].isZombie)
+            ProcessListMenu_RamSearch(&infos[selected]);
+        else if((pressed & KEY_X) && !infos[selected].isZombie)
+            ProcessListMenu_DumpProcess(&infos[selected]);
+        else if((pressed & KEY_SELECT) && !infos[selected].isZombie)
+            ProcessListMenu_SaveStates(&infos[selected]);
         else if(pressed & KEY_DOWN)
             selected++;
         else if(pressed & KEY_UP)
@@ -25,7 +25,6 @@
 */
 
 #include <3ds.h>
-#include <math.h>
 #include "memory.h"
 #include "menu.h"
 #include "menus.h"
@@ -35,23 +34,12 @@
 #include "luminance.h"
 #include "menus/miscellaneous.h"
 #include "menus/screen_filters.h"
-#include "menus/screen_filters_srgb_tables.h"
 #include "draw.h"
-#include "redshift/colorramp.h"
+#include "color_lut.h"
 #include "menus/sysconfig.h"
 #include "config_template_ini.h"
 #include "configExtra_ini.h"
 
-typedef union {
-    struct {
-        u8 r;
-        u8 g;
-        u8 b;
-        u8 z;
-    };
-    u32 raw;
-} Pixel;
-
 ScreenFilter topScreenFilter;
 ScreenFilter bottomScreenFilter;
 
@@ -73,85 +61,30 @@ static inline bool ScreenFiltersMenu_IsDefaultSettings(void)
     return ScreenFiltersMenu_IsDefaultSettingsFilter(&topScreenFilter) && ScreenFiltersMenu_IsDefaultSettingsFilter(&bottomScreenFilter);
 }
 
-static inline u8 ScreenFiltersMenu_GetColorLevel(int inLevel, float wp, float a, float b, float g)
-{
-    float level = inLevel / 255.0f;
-    level = a * wp * level + b;
-    level = powf(CLAMP(level, 0.0f, 1.0f), g);
-    s32 levelInt = (s32)(255.0f * level + 0.5f); // round to nearest integer
-    return levelInt <= 0 ? 0 : levelInt >= 255 ? 255 : (u8)levelInt; // clamp
-}
-
-static u8 ScreenFilterMenu_CalculatePolynomialColorLutComponent(const float coeffs[][3], u32 component, float gamma, u32 dim, int inLevel)
+static void ScreenFiltersMenu_ApplyColorSettings(bool top)
 {
-    float x = inLevel / 255.0f;
-    float level = 0.0f;
-    float xN = 1.0f;
-
-    // Compute a_n * x^n + ... a_0, then clamp, then exponentiate by "gamma" and clamp again
-    for (u32 i = 0; i < dim + 1; i++)
-    {
-        level += coeffs[i][component] * xN;
-        xN *= x;
-    }
-
-    level = powf(CLAMP(level, 0.0f, 1.0f), gamma);
-    s32 levelInt = (s32)(255.0f * level + 0.5f); // round up
-    return (u8)CLAMP(levelInt, 0, 255); // clamp again just to be sure
-}
+    const ScreenFilter *filter = top ? &topScreenFilter : &bottomScreenFilter;
+    const u32 *lut = ColorLut_Get(filter);
 
-static void ScreenFilterMenu_WritePolynomialColorLut(bool top, u8 curveCorrection, const float coeffs[][3], bool invert, float gamma, u32 dim)
-{
     if(configExtra.suppressLeds)
     {
         ScreenFilter_SuppressLeds();
     }
-    
+
     if (top)
+    {
         GPU_FB_TOP_COL_LUT_INDEX = 0;
+        for (u32 i = 0; i < 256; i++)
+            GPU_FB_TOP_COL_LUT_ELEM = lut[i];
+    }
     else
+    {
         GPU_FB_BOTTOM_COL_LUT_INDEX = 0;
-
-    for (int i = 0; i <= 255; i++) {
-        Pixel px;
-        int inLevel = invert ? 255 - i : i;
-        const u8 (*tbl)[3] = curveCorrection == 2 ? ctrToSrgbTableBottom : ctrToSrgbTableTop;
-
-        u8 inLevelR = curveCorrection > 0 ? tbl[inLevel][0] : inLevel;
-        u8 inLevelG = curveCorrection > 0 ? tbl[inLevel][1] : inLevel;
-        u8 inLevelB = curveCorrection > 0 ? tbl[inLevel][2] : inLevel;
-
-        px.r = ScreenFilterMenu_CalculatePolynomialColorLutComponent(coeffs, 0, gamma, dim, inLevelR);
-        px.g = ScreenFilterMenu_CalculatePolynomialColorLutComponent(coeffs, 1, gamma, dim, inLevelG);
-        px.b = ScreenFilterMenu_CalculatePolynomialColorLutComponent(coeffs, 2, gamma, dim, inLevelB);
-        px.z = 0;
-
-        if (top)
-            GPU_FB_TOP_COL_LUT_ELEM = px.raw;
-        else
-            GPU_FB_BOTTOM_COL_LUT_ELEM = px.raw;
+        for (u32 i = 0; i < 256; i++)
+            GPU_FB_BOTTOM_COL_LUT_ELEM = lut[i];
     }
 }
 
-static void ScreenFiltersMenu_ApplyColorSettings(bool top)
-{
-    const ScreenFilter *filter = top ? &topScreenFilter : &bottomScreenFilter;
-
-    float wp[3];
-    colorramp_get_white_point(wp, filter->cct);
-    float a = filter->contrast;
-    float b = filter->brightness;
-    float g = filter->gamma;
-    bool inv = filter->invert;
-
-    float poly[][3] = {
-        { b, b, b },                            // x^0
-        { a * wp[0], a * wp[1], a * wp[2] },    // x^1
-    };
-
-    ScreenFilterMenu_WritePolynomialColorLut(top, filter->colorCurveCorrection, poly, inv, g, 1);
-}
-
 static void ScreenFiltersMenu_SetCct(u16 cct)
 {
     topScreenFilter.cct = cct;
@@ -40,6 +40,8 @@
 #include "menus.h"
 #include "volume.h"
 #include "luminance.h"
+#include "pmdbgext.h"
+#include "title_settings.h"
 #include "menus/screen_filters.h"
 #include "config_template_ini.h"
 #include "configExtra_ini.h"
@@ -56,6 +58,7 @@ Menu sysconfigMenu = {
         { "Toggle power to card slot", METHOD, .method=&SysConfigMenu_ToggleCardIfPower},
         { "Permanent Brightness Recalibration", METHOD, .method = &Luminance_RecalibrateBrightnessDefaults },
         { "Software Volume Control", METHOD, .method = &AdjustVolume },
+        { "Change the current title's locale", METHOD, .method = &SysConfigMenu_ChangeTitleLocale },
         { "Extra Config...", MENU, .menu = &configExtraMenu },
         { "Tips", METHOD, .method = &SysConfigMenu_Tip },
         {},
@@ -441,6 +444,100 @@ void SysConfigMenu_UpdateRehidFolderStatus(void)
     }
 }
 
+// Same values as in locale.txt, which Loader moves into the title settings
+static const char *titleLocaleRegions[] = { "JPN", "USA", "EUR", "AUS", "CHN", "KOR", "TWN" };
+static const char *titleLocaleLanguages[] = { "JP", "EN", "FR", "DE", "IT", "ES", "ZH", "KO", "NL", "PT", "RU", "TW" };
+
+void SysConfigMenu_ChangeTitleLocale(void)
+{
+    static const char **names[2] = { titleLocaleRegions, titleLocaleLanguages };
+    static const s32 counts[2] = { sizeof(titleLocaleRegions) / sizeof(titleLocaleRegions[0]), sizeof(titleLocaleLanguages) / sizeof(titleLocaleLanguages[0]) };
+
+    FS_ProgramInfo programInfo;
+    LumaTitleSettings settings;
+    u32 pid, launchFlags;
+    s32 values[2] = { -1, -1 }; // -1: the system setting
+    u32 row = 0;
+    Result res = PMDBG_GetCurrentAppInfo(&programInfo, &pid, &launchFlags);
+    const char *status = "";
+
+    if(R_SUCCEEDED(res))
+    {
+        if(!TitleSettings_Get(programInfo.programId, &settings))
+        {
+            memset(&settings, 0, sizeof(settings));
+            settings.title_id = programInfo.programId;
+        }
+
+        if(!(settings.flags & LUMA_TITLE_SETTING_LOCALE))
+            settings.locale_mask = 0;
+        if(settings.locale_mask & 1)
+            values[0] = settings.region_id;
+        if(settings.locale_mask & 2)
+            values[1] = settings.language_id;
+    }
+
+    Draw_Lock();
+    Draw_ClearFramebuffer();
+    Draw_FlushFramebuffer();
+    Draw_Unlock();
+
+    do
+    {
+        Draw_Lock();
+        Draw_DrawString(10, 10, COLOR_TITLE, "System configuration menu");
+
+        if(R_FAILED(res))
+            Draw_DrawString(10, 30, COLOR_WHITE, "No application is running.");
+        else
+        {
+            u32 posY = Draw_DrawFormattedString(10, 30, COLOR_WHITE, "Locale of %016llX:", settings.title_id);
+            posY += SPACING_Y;
+
+            for(u32 i = 0; i < 2; i++)
+            {
+                Draw_DrawString(10, posY + SPACING_Y * i, COLOR_TITLE, row == i ? ">" : " ");
+                Draw_DrawFormattedString(30, posY + SPACING_Y * i, COLOR_WHITE, "%-9s %-8s", i == 0 ? "Region:" : "Language:",
+                    values[i] < 0 || values[i] >= counts[i] ? "(system)" : names[i][values[i]]);
+            }
+
+            posY = Draw_DrawString(10, posY + 3 * SPACING_Y, COLOR_WHITE, "LEFT/RIGHT to change, A to save, B to go back.\n");
+            posY = Draw_DrawString(10, posY, COLOR_WHITE, "The title must be restarted for it to apply.\n\n");
+            Draw_DrawFormattedString(10, posY, COLOR_WHITE, "%-40s", status);
+        }
+
+        Draw_FlushFramebuffer();
+        Draw_Unlock();
+
+        u32 pressed = waitInputWithTimeout(1000);
+
+        if(pressed & KEY_B)
+            return;
+        else if(R_FAILED(res))
+            continue;
+        else if(pressed & (KEY_UP | KEY_DOWN))
+            row ^= 1;
+        else if(pressed & KEY_LEFT)
+            values[row] = values[row] < 0 ? counts[row] - 1 : values[row] - 1;
+        else if(pressed & KEY_RIGHT)
+            values[row] = values[row] + 1 >= counts[row] ? -1 : values[row] + 1;
+        else if(pressed & KEY_A)
+        {
+            // The country and state, only settable through locale.txt, are kept
+            settings.locale_mask = (settings.locale_mask & ~3) | (values[0] >= 0 ? 1 : 0) | (values[1] >= 0 ? 2 : 0);
+            settings.region_id = values[0] >= 0 ? (u8)values[0] : 0;
+            settings.language_id = values[1] >= 0 ? (u8)values[1] : 0;
+            if(settings.locale_mask != 0)
+                settings.flags |= LUMA_TITLE_SETTING_LOCALE;
+            else
+                settings.flags &= ~LUMA_TITLE_SETTING_LOCALE;
+
+            status = R_SUCCEEDED(TitleSettings_Set(&settings)) ? "Saved." : "Failed to save the settings.";
+        }
+    }
+    while(!menuShouldExit);
+}
+
 void SysConfigMenu_Tip(void)
 {
     Draw_Lock();
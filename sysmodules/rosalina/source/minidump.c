@@ -0,0 +1,316 @@
+/*
+*   This file is part of Luma3DS
+*   Copyright (C) 2016-2022 Aurora Wright, TuxSH
+*
+*   This program is free software: you can redistribute it and/or modify
+*   it under the terms of the GNU General Public License as published by
+*   the Free Software Foundation, either version 3 of the License, or
+*   (at your option) any later version.
+*
+*   This program is distributed in the hope that it will be useful,
+*   but WITHOUT ANY WARRANTY; without even the implied warranty of
+*   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*   GNU General Public License for more details.
+*
+*   You should have received a copy of the GNU General Public License
+*   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*
+*   Additional Terms 7.b and 7.c of GPLv3 apply to this file:
+*       * Requiring preservation of specified reasonable legal notices or
+*         author attributions in that material or in the Appropriate Legal
+*         Notices displayed by works containing it.
+*       * Prohibiting misrepresentation of the origin of that material,
+*         or requiring that modified versions of such material be marked in
+*         reasonable ways as different from the original version.
+*/
+
+
+#include <3ds.h>
+#include <string.h>
+#include "minidump.h"
+#include "csvc.h"
+#include "ifile.h"
+
+typedef struct MiniDumpBuilder
+{
+    u8 *pos;
+    u16 numRecords;
+} MiniDumpBuilder;
+
+// The err:f thread has a small stack
+static u8 CTR_ALIGN(8) miniDumpBuffer[MINIDUMP_MAX_SIZE];
+
+static void *MiniDump_AddRecord(MiniDumpBuilder *b, MiniDumpRecordType type, u32 size)
+{
+    u32 paddedSize = (size + 7) & ~7;
+    MiniDumpRecordHeader *hdr = (MiniDumpRecordHeader *)b->pos;
+
+    if(b->pos + sizeof(MiniDumpRecordHeader) + paddedSize > miniDumpBuffer + sizeof(miniDumpBuffer))
+        return NULL;
+
+    hdr->type = (u32)type;
+    hdr->size = size;
+    memset(hdr + 1, 0, paddedSize);
+
+    b->pos += sizeof(MiniDumpRecordHeader) + paddedSize;
+    b->numRecords++;
+
+    return hdr + 1;
+}
+
+static void MiniDump_RemoveLastRecord(MiniDumpBuilder *b, void *data)
+{
+    b->pos = (u8 *)data - sizeof(MiniDumpRecordHeader);
+    b->numRecords--;
+}
+
+// The range must be within a single readable memory region
+static bool MiniDump_ReadProcessMemory(Handle processHandle, void *out, u32 addr, u32 size)
+{
+    u32 start = addr & ~0xFFF;
+    u32 end = (addr + size + 0xFFF) & ~0xFFF;
+
+    if(R_FAILED(svcMapProcessMemoryEx(CUR_PROCESS_HANDLE, MINIDUMP_MAP_ADDR, processHandle, start, end - start)))
+        return false;
+
+    memcpy(out, (const u8 *)MINIDUMP_MAP_ADDR + (addr - start), size);
+    svcUnmapProcessMemoryEx(CUR_PROCESS_HANDLE, MINIDUMP_MAP_ADDR, end - start);
+
+    return true;
+}
+
+// Clips [start, end) to the memory region containing "anchor"
+static void MiniDump_AddMemory(MiniDumpBuilder *b, Handle processHandle, MiniDumpMemoryKind kind, u32 anchor, u32 start, u32 end)
+{
+    MemInfo mem;
+    PageInfo out;
+
+    if(R_FAILED(svcQueryProcessMemory(&mem, &out, processHandle, anchor)) || (mem.perm & MEMPERM_READ) == 0 ||
+       mem.state == MEMSTATE_FREE || mem.state == MEMSTATE_IO)
+        return;
+
+    start = start < mem.base_addr || start > anchor ? mem.base_addr : start;
+    end = end > mem.base_addr + mem.size || end < anchor ? mem.base_addr + mem.size : end;
+
+    MiniDumpMemory *desc = (MiniDumpMemory *)MiniDump_AddRecord(b, MINIDUMP_RECORD_MEMORY, sizeof(MiniDumpMemory) + (end - start));
+    if(desc == NULL)
+        return;
+
+    desc->address = start;
+    desc->size = end - start;
+    desc->kind = (u32)kind;
+
+    if(!MiniDump_ReadProcessMemory(processHandle, desc + 1, start, end - start))
+        MiniDump_RemoveLastRecord(b, desc);
+}
+
+static void MiniDump_AddMemoryMap(MiniDumpBuilder *b, Handle processHandle)
+{
+    MiniDumpMemoryMapEntry *entries = (MiniDumpMemoryMapEntry *)MiniDump_AddRecord(b, MINIDUMP_RECORD_MEMORY_MAP, MINIDUMP_MAX_MAP_ENTRIES * sizeof(MiniDumpMemoryMapEntry));
+    u32 n = 0;
+    u32 addr = 0;
+
+    if(entries == NULL)
+        return;
+
+    while(addr < 0x40000000 && n < MINIDUMP_MAX_MAP_ENTRIES)
+    {
+        MemInfo mem;
+        PageInfo out;
+        if(R_FAILED(svcQueryProcessMemory(&mem, &out, processHandle, addr)) || mem.base_addr + mem.size <= addr)
+            break;
+
+        if(mem.state != MEMSTATE_FREE)
+        {
+            entries[n].baseAddr = mem.base_addr;
+            entries[n].size = mem.size;
+            entries[n].perm = (u8)mem.perm;
+            entries[n].state = (u8)mem.state;
+            n++;
+        }
+
+        addr = mem.base_addr + mem.size;
+    }
+
+    // Give back the unused entries
+    ((MiniDumpRecordHeader *)entries - 1)->size = n * sizeof(MiniDumpMemoryMapEntry);
+    b->pos = (u8 *)(entries + n);
+}
+
+static void MiniDump_AddProcessInfo(MiniDumpBuilder *b, const ERRF_FatalErrInfo *info, Handle processHandle)
+{
+    MiniDumpProcess *proc = (MiniDumpProcess *)MiniDump_AddRecord(b, MINIDUMP_RECORD_PROCESS, sizeof(MiniDumpProcess));
+    s64 out;
+
+    if(proc == NULL)
+        return;
+
+    proc->pid = info->procId;
+    proc->titleId = info->titleId;
+    proc->appTitleId = info->appTitleId;
+
+    if(processHandle == 0)
+        return;
+
+    svcGetProcessInfo((s64 *)proc->name, processHandle, 0x10000);
+
+    // Code layout, to match the dump against the right ELF
+    svcGetProcessInfo(&out, processHandle, 0x10002);
+    proc->textSize = (u32)out;
+    svcGetProcessInfo(&out, processHandle, 0x10003);
+    proc->rodataSize = (u32)out;
+    svcGetProcessInfo(&out, processHandle, 0x10004);
+    proc->dataSize = (u32)out;
+    svcGetProcessInfo(&out, processHandle, 0x10005);
+    proc->textAddr = (u32)out;
+    svcGetProcessInfo(&out, processHandle, 0x10006);
+    proc->rodataAddr = (u32)out;
+    svcGetProcessInfo(&out, processHandle, 0x10007);
+    proc->dataAddr = (u32)out;
+}
+
+static u32 MiniDump_Build(const ERRF_FatalErrInfo *info, const char *userString, u32 sequence)
+{
+    MiniDumpHeader *header = (MiniDumpHeader *)miniDumpBuffer;
+    MiniDumpBuilder b = { miniDumpBuffer + sizeof(MiniDumpHeader), 0 };
+    bool isException = info->type == ERRF_ERRTYPE_EXCEPTION;
+    const ERRF_ExceptionData *exceptionData = &info->data.exception_data;
+    Handle processHandle = 0;
+
+    MiniDumpCrashReason *reason = (MiniDumpCrashReason *)MiniDump_AddRecord(&b, MINIDUMP_RECORD_CRASH_REASON, sizeof(MiniDumpCrashReason));
+    reason->errorType = (u8)info->type;
+    reason->exceptionType = isException ? (u8)exceptionData->excep.type : 0xFF;
+    reason->revHigh = info->revHigh;
+    reason->revLow = info->revLow;
+    reason->resultCode = (u32)info->resCode;
+    reason->pcAddr = isException ? exceptionData->regs.pc : info->pcAddr;
+    if(isException)
+    {
+        reason->fsr = exceptionData->excep.fsr;
+        reason->far = exceptionData->excep.far;
+        reason->fpexc = exceptionData->excep.fpexc;
+        reason->fpinst = exceptionData->excep.fpinst;
+        reason->fpinst2 = exceptionData->excep.fpinst2;
+    }
+    else if(info->type == ERRF_ERRTYPE_FAILURE)
+        memcpy(reason->message, info->data.failure_mesg, sizeof(reason->message));
+
+    if(R_FAILED(svcOpenProcess(&processHandle, info->procId)))
+        processHandle = 0;
+
+    MiniDump_AddProcessInfo(&b, info, processHandle);
+
+    if(isException)
+    {
+        CpuRegisters *regs = (CpuRegisters *)MiniDump_AddRecord(&b, MINIDUMP_RECORD_REGISTERS, sizeof(CpuRegisters));
+        memcpy(regs, &exceptionData->regs, sizeof(CpuRegisters));
+    }
+
+    if(processHandle != 0)
+    {
+        u32 pc = reason->pcAddr & ~1;
+
+        MiniDump_AddMemory(&b, processHandle, MINIDUMP_MEMORY_PC, pc, pc - MINIDUMP_CODE_SIZE / 2, pc + MINIDUMP_CODE_SIZE / 2);
+        if(isException)
+        {
+            u32 lr = exceptionData->regs.lr & ~1;
+            u32 sp = exceptionData->regs.sp;
+
+            MiniDump_AddMemory(&b, processHandle, MINIDUMP_MEMORY_LR, lr, lr - MINIDUMP_CODE_SIZE / 2, lr + MINIDUMP_CODE_SIZE / 2);
+            MiniDump_AddMemory(&b, processHandle, MINIDUMP_MEMORY_STACK, sp, sp, sp + MINIDUMP_STACK_SIZE);
+        }
+
+        MiniDump_AddMemoryMap(&b, processHandle);
+        svcCloseHandle(processHandle);
+    }
+
+    if(userString[0] != '\0')
+    {
+        u32 len = strnlen(userString, 0x100);
+        char *str = (char *)MiniDump_AddRecord(&b, MINIDUMP_RECORD_USER_STRING, len);
+        if(str != NULL)
+            memcpy(str, userString, len);
+    }
+
+    header->magic = MINIDUMP_MAGIC;
+    header->version = MINIDUMP_VERSION;
+    header->numRecords = b.numRecords;
+    header->sequence = sequence;
+    header->size = b.pos - miniDumpBuffer;
+    header->timestamp = osGetTime();
+    header->systemTick = svcGetSystemTick();
+
+    return header->size;
+}
+
+static inline void MiniDump_GetSlotPath(char *out, u32 slot)
+{
+    sprintf(out, MINIDUMP_DIR_PATH "/minidump_%02lu.dmp", slot);
+}
+
+// Picks the unused or oldest slot
+static u32 MiniDump_FindSlot(FS_Archive archive, u32 *sequence)
+{
+    char path[64];
+    u32 slot = 0, oldest = 0xFFFFFFFF;
+
+    *sequence = 0;
+    for(u32 i = 0; i < MINIDUMP_NUM_SLOTS; i++)
+    {
+        IFile file;
+        MiniDumpHeader header;
+        u64 total;
+        u32 seq = 0;
+
+        MiniDump_GetSlotPath(path, i);
+        if(R_SUCCEEDED(IFile_OpenFromArchive(&file, archive, fsMakePath(PATH_ASCII, path), FS_OPEN_READ)))
+        {
+            if(R_SUCCEEDED(IFile_Read(&file, &total, &header, sizeof(header))) && total == sizeof(header) &&
+               header.magic == MINIDUMP_MAGIC)
+                seq = header.sequence;
+            IFile_Close(&file);
+        }
+
+        *sequence = seq > *sequence ? seq : *sequence;
+        if(seq < oldest)
+        {
+            oldest = seq;
+            slot = i;
+        }
+    }
+
+    (*sequence)++;
+    return slot;
+}
+
+Result MiniDump_Write(FS_ArchiveID archiveId, const ERRF_FatalErrInfo *info, const char *userString)
+{
+    FS_Archive archive;
+    IFile file;
+    char path[64];
+    u32 sequence;
+    u64 total;
+
+    Result res = FSUSER_OpenArchive(&archive, archiveId, fsMakePath(PATH_EMPTY, ""));
+    if(R_FAILED(res))
+        return res;
+
+    FSUSER_CreateDirectory(archive, fsMakePath(PATH_ASCII, "/luma/dumps"), 0);
+    FSUSER_CreateDirectory(archive, fsMakePath(PATH_ASCII, MINIDUMP_DIR_PATH), 0);
+
+    u32 slot = MiniDump_FindSlot(archive, &sequence);
+    u32 size = MiniDump_Build(info, userString, sequence);
+
+    MiniDump_GetSlotPath(path, slot);
+    res = IFile_OpenFromArchive(&file, archive, fsMakePath(PATH_ASCII, path), FS_OPEN_CREATE | FS_OPEN_WRITE);
+    if(R_SUCCEEDED(res))
+    {
+        res = IFile_SetSize(&file, size);
+        if(R_SUCCEEDED(res))
+            res = IFile_Write(&file, &total, miniDumpBuffer, size, FS_WRITE_FLUSH);
+        IFile_Close(&file);
+    }
+
+    FSUSER_CloseArchive(archive);
+    return res;
+}
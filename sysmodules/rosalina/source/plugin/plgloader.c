@@ -13,6 +13,7 @@
 #include "pmdbgext.h"
 #include "draw.h"
 #include "menus/config_extra.h"
+#include "title_settings.h"
 
 #define PLGLDR_VERSION (SYSTEM_VERSION(1, 0, 2))
 
@@ -21,7 +22,7 @@
 #define PERS_USER_FILE_MAGIC 0x53524550 // PERS
 
 static const char *g_title = "Plugin loader";
-static char menuBuf[64], fileNameBuf[64];
+static char menuBuf[64];
 
 static u64 programId = 0;
 static bool currentTitleUsesPlugin = false;
@@ -744,76 +745,25 @@ void PerGamePluginLoader__CheckForConfigFile(void)
 
     if(R_SUCCEEDED(PMDBG_GetCurrentAppInfo(&programInfo, &pid, &launchFlags)))
     {
-        programId = programInfo.programId;
+        LumaTitleSettings settings;
 
-        sprintf(fileNameBuf, "%s%016llX%s", "/luma/plugins/PerGame/", programId, ".bin");
-        IFile file;
-        FS_ArchiveID archiveId;
-        s64 out;
-        bool isSdMode;
-        
-        if (R_FAILED(svcGetSystemInfo(&out, 0x10000, 0x203)))
-            svcBreak(USERBREAK_ASSERT);
-        
-        isSdMode = (bool)out;
-    
-        archiveId = isSdMode ? ARCHIVE_SDMC : ARCHIVE_NAND_RW;
-        
-        if(R_SUCCEEDED(IFile_Open(&file, archiveId, fsMakePath(PATH_EMPTY, ""),fsMakePath(PATH_ASCII, fileNameBuf), FS_OPEN_READ)))
-        {
-            IFile_Close(&file);
-            currentTitleUsesPlugin = true;
-        }
+        programId = programInfo.programId;
+        currentTitleUsesPlugin = TitleSettings_Get(programId, &settings) && (settings.flags & LUMA_TITLE_SETTING_PLUGIN) != 0;
     }
 }
 
-void PerGamePluginLoader__CreateConfigFile(void)
+void PerGamePluginLoader__UpdateConfig(void)
 {
-    IFile file;
-    FS_ArchiveID archiveId;
-    s64 out;
-    bool isSdMode;
-    
-    if (R_FAILED(svcGetSystemInfo(&out, 0x10000, 0x203)))
-        svcBreak(USERBREAK_ASSERT);
-        
-    isSdMode = (bool)out;
-    
-    archiveId = isSdMode ? ARCHIVE_SDMC : ARCHIVE_NAND_RW;
+    LumaTitleSettings settings;
 
-    if(R_SUCCEEDED(IFile_Open(&file, archiveId, fsMakePath(PATH_EMPTY, ""),fsMakePath(PATH_ASCII, fileNameBuf), FS_OPEN_CREATE | FS_OPEN_WRITE)))
+    if(!TitleSettings_Get(programId, &settings))
     {
-        IFile_Close(&file);
-        currentTitleUsesPlugin = true;
+        memset(&settings, 0, sizeof(settings));
+        settings.title_id = programId;
     }
-}
-
-void PerGamePluginLoader__DeleteConfigFile(void)
-{
-    FS_Archive archive;
-    FS_ArchiveID archiveId;
-    s64 out;
-    bool isSdMode;
-    
-    if (R_FAILED(svcGetSystemInfo(&out, 0x10000, 0x203)))
-        svcBreak(USERBREAK_ASSERT);
-        
-    isSdMode = (bool)out;
-    
-    archiveId = isSdMode ? ARCHIVE_SDMC : ARCHIVE_NAND_RW;
-
-    if(R_SUCCEEDED(FSUSER_OpenArchive(&archive, archiveId, fsMakePath(PATH_EMPTY, ""))))
-    {
-        if(R_SUCCEEDED(FSUSER_DeleteFile(archive, fsMakePath(PATH_ASCII, fileNameBuf))))
-        {
-            currentTitleUsesPlugin = false;
-        }
 
-        FSUSER_CloseArchive(archive);
-    }
-}
+    settings.flags ^= LUMA_TITLE_SETTING_PLUGIN;
 
-void PerGamePluginLoader__UpdateConfig(void)
-{
-    currentTitleUsesPlugin ? PerGamePluginLoader__CreateConfigFile() : PerGamePluginLoader__DeleteConfigFile();
+    if(R_SUCCEEDED(TitleSettings_Set(&settings)))
+        currentTitleUsesPlugin = !currentTitleUsesPlugin;
 }
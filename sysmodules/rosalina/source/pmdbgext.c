@@ -49,3 +49,16 @@ Result PMDBG_LaunchTitleDebug(Handle *outDebug, const FS_ProgramInfo *programInf
     *outDebug = cmdbuf[3];
     return (Result)cmdbuf[1];
 }
+
+Result PMDBG_GetShutdownTrace(ShutdownTrace *outTrace)
+{
+    Result ret = 0;
+    u32 *cmdbuf = getThreadCommandBuffer();
+
+    cmdbuf[0] = IPC_MakeHeader(0x104, 0, 2);
+    cmdbuf[1] = IPC_Desc_Buffer(sizeof(ShutdownTrace), IPC_BUFFER_W);
+    cmdbuf[2] = (u32)outTrace;
+
+    if(R_FAILED(ret = svcSendSyncRequest(*pmDbgGetSessionHandle()))) return ret;
+    return (Result)cmdbuf[1];
+}
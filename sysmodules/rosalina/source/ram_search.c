@@ -0,0 +1,601 @@
+/*
+*   This file is part of Luma3DS
+*   Copyright (C) 2016-2022 Aurora Wright, TuxSH
+*
+*   This program is free software: you can redistribute it and/or modify
+*   it under the terms of the GNU General Public License as published by
+*   the Free Software Foundation, either version 3 of the License, or
+*   (at your option) any later version.
+*
+*   This program is distributed in the hope that it will be useful,
+*   but WITHOUT ANY WARRANTY; without even the implied warranty of
+*   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*   GNU General Public License for more details.
+*
+*   You should have received a copy of the GNU General Public License
+*   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*
+*   Additional Terms 7.b and 7.c of GPLv3 apply to this file:
+*       * Requiring preservation of specified reasonable legal notices or
+*         author attributions in that material or in the Appropriate Legal
+*         Notices displayed by works containing it.
+*       * Prohibiting misrepresentation of the origin of that material,
+*         or requiring that modified versions of such material be marked in
+*         reasonable ways as different from the original version.
+*/
+
+#include <3ds.h>
+#include "ram_search.h"
+#include "csvc.h"
+#include "ifile.h"
+
+#define RAMSEARCH_ADDRESS_SPACE_END 0x40000000
+#define ALIGN4(x)                   (((x) + 3) & ~3)
+
+typedef struct RamSearchWriter
+{
+    u32 pos;
+    RamSearchBlock *block;
+    u32 count;
+} RamSearchWriter;
+
+typedef Result (*RamSearchWindowCallback)(RamSearchContext *ctx, u32 base, u32 size, void *userdata);
+
+static const char *typeNames[RAMSEARCH_TYPE_MAX] = { "u8", "u16", "u32", "float" };
+static const u32 typeSizes[RAMSEARCH_TYPE_MAX] = { 1, 2, 4, 4 };
+
+static const char *compareNames[RAMSEARCH_CMP_MAX] = {
+    "equal to",
+    "not equal to",
+    "greater than",
+    "less than",
+    "changed",
+    "unchanged",
+    "increased",
+    "decreased",
+    "increased by",
+    "decreased by",
+};
+
+const char *RamSearch_GetTypeName(RamSearchValueType type)
+{
+    return type < RAMSEARCH_TYPE_MAX ? typeNames[type] : "?";
+}
+
+const char *RamSearch_GetCompareName(RamSearchCompare cmp)
+{
+    return cmp < RAMSEARCH_CMP_MAX ? compareNames[cmp] : "?";
+}
+
+bool RamSearch_CompareNeedsOperand(RamSearchCompare cmp)
+{
+    return cmp <= RAMSEARCH_CMP_LESS || cmp >= RAMSEARCH_CMP_INCREASED_BY;
+}
+
+static inline bool RamSearch_IsRelative(RamSearchCompare cmp)
+{
+    return cmp >= RAMSEARCH_CMP_CHANGED;
+}
+
+static inline u32 RamSearch_LoadValue(const void *p, u32 size)
+{
+    switch (size)
+    {
+        case 1: return *(const u8 *)p;
+        case 2: return *(const u16 *)p;
+        default: return *(const u32 *)p;
+    }
+}
+
+static inline void RamSearch_StoreValue(void *p, u32 value, u32 size)
+{
+    switch (size)
+    {
+        case 1: *(u8 *)p = (u8)value; break;
+        case 2: *(u16 *)p = (u16)value; break;
+        default: *(u32 *)p = value; break;
+    }
+}
+
+static inline float RamSearch_ToFloat(u32 bits)
+{
+    float f;
+    memcpy(&f, &bits, 4);
+    return f;
+}
+
+static bool RamSearch_Matches(const RamSearchContext *ctx, RamSearchCompare cmp, u32 prev, u32 cur, u32 operand)
+{
+    if (ctx->type == RAMSEARCH_TYPE_FLOAT)
+    {
+        float p = RamSearch_ToFloat(prev), c = RamSearch_ToFloat(cur), o = RamSearch_ToFloat(operand);
+        switch (cmp)
+        {
+            case RAMSEARCH_CMP_EQUAL:           return cur == operand;
+            case RAMSEARCH_CMP_NOT_EQUAL:       return cur != operand;
+            case RAMSEARCH_CMP_GREATER:         return c > o;
+            case RAMSEARCH_CMP_LESS:            return c < o;
+            case RAMSEARCH_CMP_CHANGED:         return cur != prev;
+            case RAMSEARCH_CMP_UNCHANGED:       return cur == prev;
+            case RAMSEARCH_CMP_INCREASED:       return c > p;
+            case RAMSEARCH_CMP_DECREASED:       return c < p;
+            // Exact float deltas are rare, allow for some rounding
+            case RAMSEARCH_CMP_INCREASED_BY:    return fabsf((c - p) - o) <= 1e-4f * (fabsf(o) + 1.0f);
+            case RAMSEARCH_CMP_DECREASED_BY:    return fabsf((p - c) - o) <= 1e-4f * (fabsf(o) + 1.0f);
+            default:                            return false;
+        }
+    }
+
+    u32 mask = ctx->valueSize == 4 ? 0xFFFFFFFF : (1u << (8 * ctx->valueSize)) - 1;
+    operand &= mask;
+    switch (cmp)
+    {
+        case RAMSEARCH_CMP_EQUAL:           return cur == operand;
+        case RAMSEARCH_CMP_NOT_EQUAL:       return cur != operand;
+        case RAMSEARCH_CMP_GREATER:         return cur > operand;
+        case RAMSEARCH_CMP_LESS:            return cur < operand;
+        case RAMSEARCH_CMP_CHANGED:         return cur != prev;
+        case RAMSEARCH_CMP_UNCHANGED:       return cur == prev;
+        case RAMSEARCH_CMP_INCREASED:       return cur > prev;
+        case RAMSEARCH_CMP_DECREASED:       return cur < prev;
+        case RAMSEARCH_CMP_INCREASED_BY:    return ((cur - prev) & mask) == operand;
+        case RAMSEARCH_CMP_DECREASED_BY:    return ((prev - cur) & mask) == operand;
+        default:                            return false;
+    }
+}
+
+// Candidates are always emitted in increasing address order. When refining in place, the writer
+// never overtakes the reader, as the output of a block is never larger than its input.
+static Result RamSearch_Emit(RamSearchContext *ctx, RamSearchWriter *w, u32 addr, u32 value)
+{
+    u32 vs = ctx->valueSize;
+    u32 base = addr & ~(RAMSEARCH_SLOTS_PER_BLOCK * vs - 1);
+
+    if (w->block == NULL || w->block->base != base)
+    {
+        w->pos = ALIGN4(w->pos);
+        if (w->pos + sizeof(RamSearchBlock) + vs > ctx->candidatesCapacity)
+            return RAMSEARCH_ERR_HEAP_FULL;
+
+        w->block = (RamSearchBlock *)(ctx->candidates + w->pos);
+        w->block->base = base;
+        w->block->mask = 0;
+        w->pos += sizeof(RamSearchBlock);
+    }
+    else if (w->pos + vs > ctx->candidatesCapacity)
+        return RAMSEARCH_ERR_HEAP_FULL;
+
+    w->block->mask |= 1u << ((addr - base) / vs);
+    RamSearch_StoreValue(ctx->candidates + w->pos, value, vs);
+    w->pos += vs;
+    w->count++;
+
+    return 0;
+}
+
+static void RamSearch_Unmap(RamSearchContext *ctx)
+{
+    if (ctx->windowSize != 0)
+        svcUnmapProcessMemoryEx(CUR_PROCESS_HANDLE, RAMSEARCH_MAP_ADDR, ctx->windowSize);
+    ctx->windowBase = 0;
+    ctx->windowSize = 0;
+}
+
+static Result RamSearch_MapWindow(RamSearchContext *ctx, u32 base, u32 size)
+{
+    if (ctx->windowSize != 0 && ctx->windowBase == base && ctx->windowSize == size)
+        return 0;
+
+    RamSearch_Unmap(ctx);
+    Result res = svcMapProcessMemoryEx(CUR_PROCESS_HANDLE, RAMSEARCH_MAP_ADDR, ctx->processHandle, base, size);
+    if (R_SUCCEEDED(res))
+    {
+        ctx->windowBase = base;
+        ctx->windowSize = size;
+    }
+
+    return res;
+}
+
+static bool RamSearch_IsScannable(const MemInfo *mem)
+{
+    if (!(mem->perm & MEMPERM_WRITE))
+        return false;
+
+    switch (mem->state)
+    {
+        case MEMSTATE_PRIVATE:
+        case MEMSTATE_CONTINUOUS:
+        case MEMSTATE_ALIASED:
+        case MEMSTATE_ALIAS_CODE:
+        case MEMSTATE_LOCKED:
+            return true;
+        default:
+            return false;
+    }
+}
+
+// Makes sure the window containing addr is mapped; windows are aligned relative to the region start
+static Result RamSearch_MapAddress(RamSearchContext *ctx, u32 addr)
+{
+    if (ctx->windowSize != 0 && addr >= ctx->windowBase && addr - ctx->windowBase < ctx->windowSize)
+        return 0;
+
+    MemInfo mem;
+    PageInfo out;
+    Result res = svcQueryProcessMemory(&mem, &out, ctx->processHandle, addr);
+    if (R_FAILED(res))
+        return res;
+    if (!RamSearch_IsScannable(&mem))
+        return RAMSEARCH_ERR_NO_BASELINE;
+
+    u32 base = mem.base_addr + ((addr - mem.base_addr) & ~(RAMSEARCH_MAP_WINDOW_SIZE - 1));
+    u32 end = mem.base_addr + mem.size;
+    u32 size = end - base < RAMSEARCH_MAP_WINDOW_SIZE ? end - base : RAMSEARCH_MAP_WINDOW_SIZE;
+
+    return RamSearch_MapWindow(ctx, base, size);
+}
+
+// Streams every writable region of the process, one mapped window at a time
+static Result RamSearch_ForEachWindow(RamSearchContext *ctx, RamSearchWindowCallback cb, void *userdata)
+{
+    Result res = 0;
+    u32 addr = 0;
+
+    while (addr < RAMSEARCH_ADDRESS_SPACE_END)
+    {
+        MemInfo mem;
+        PageInfo out;
+        if (R_FAILED(svcQueryProcessMemory(&mem, &out, ctx->processHandle, addr)) || mem.base_addr + mem.size <= addr)
+            break;
+
+        if (RamSearch_IsScannable(&mem))
+        {
+            for (u32 off = 0; off < mem.size && R_SUCCEEDED(res); off += RAMSEARCH_MAP_WINDOW_SIZE)
+            {
+                u32 base = mem.base_addr + off;
+                u32 size = mem.size - off < RAMSEARCH_MAP_WINDOW_SIZE ? mem.size - off : RAMSEARCH_MAP_WINDOW_SIZE;
+
+                res = RamSearch_MapWindow(ctx, base, size);
+                if (R_SUCCEEDED(res))
+                    res = cb(ctx, base, size, userdata);
+            }
+
+            if (R_FAILED(res))
+                break;
+        }
+
+        addr = mem.base_addr + mem.size;
+    }
+
+    RamSearch_Unmap(ctx);
+    return res;
+}
+
+Result RamSearch_Init(RamSearchContext *ctx, Handle processHandle, RamSearchValueType type)
+{
+    u32 tmp;
+    u32 size = (u32)osGetMemRegionFree(MEMREGION_SYSTEM) & ~0xFFF;
+    size = size < RAMSEARCH_MAX_HEAP_SIZE ? size : RAMSEARCH_MAX_HEAP_SIZE;
+
+    memset(ctx, 0, sizeof(RamSearchContext));
+    if (size < RAMSEARCH_IO_BUFFER_SIZE + 0x1000)
+        return RAMSEARCH_ERR_HEAP_FULL;
+
+    Result res = svcControlMemoryEx(&tmp, RAMSEARCH_HEAP_ADDR, 0, size, MEMOP_ALLOC | MEMOP_REGION_SYSTEM, MEMPERM_READWRITE, true);
+    if (R_FAILED(res))
+        return res;
+
+    ctx->processHandle = processHandle;
+    svcGetProcessInfo((s64 *)&ctx->titleId, processHandle, 0x10001);
+
+    ctx->heap = (u8 *)RAMSEARCH_HEAP_ADDR;
+    ctx->heapSize = size;
+    ctx->ioBuffer = ctx->heap;
+    ctx->candidates = ctx->heap + RAMSEARCH_IO_BUFFER_SIZE;
+    ctx->candidatesCapacity = size - RAMSEARCH_IO_BUFFER_SIZE;
+
+    RamSearch_Reset(ctx, type);
+    return 0;
+}
+
+void RamSearch_Exit(RamSearchContext *ctx)
+{
+    u32 tmp;
+
+    RamSearch_Unmap(ctx);
+    if (ctx->heap != NULL)
+        svcControlMemory(&tmp, (u32)ctx->heap, 0, ctx->heapSize, MEMOP_FREE, 0);
+    ctx->heap = NULL;
+    ctx->heapSize = 0;
+}
+
+void RamSearch_Reset(RamSearchContext *ctx, RamSearchValueType type)
+{
+    ctx->type = type < RAMSEARCH_TYPE_MAX ? type : RAMSEARCH_TYPE_U32;
+    ctx->valueSize = typeSizes[ctx->type];
+    ctx->candidatesSize = 0;
+    ctx->numCandidates = 0;
+    ctx->numPasses = 0;
+    ctx->hasSnapshot = false;
+    ctx->lastPassMs = 0;
+}
+
+static Result RamSearch_SnapshotWindow(RamSearchContext *ctx, u32 base, u32 size, void *userdata)
+{
+    IFile *file = (IFile *)userdata;
+    u64 total;
+    u32 header[2] = { base, size };
+
+    Result res = IFile_Write(file, &total, header, sizeof(header), 0);
+    if (R_SUCCEEDED(res))
+        res = IFile_Write(file, &total, (const void *)RAMSEARCH_MAP_ADDR, size, 0);
+
+    (void)ctx;
+    return res;
+}
+
+Result RamSearch_Snapshot(RamSearchContext *ctx)
+{
+    IFile file;
+    Result res;
+    u64 startTick = svcGetSystemTick();
+
+    RamSearch_Reset(ctx, ctx->type);
+
+    res = IFile_Open(&file, ARCHIVE_SDMC, fsMakePath(PATH_EMPTY, ""), fsMakePath(PATH_ASCII, RAMSEARCH_SNAPSHOT_PATH), FS_OPEN_CREATE | FS_OPEN_WRITE);
+    if (R_FAILED(res))
+        return res;
+
+    res = IFile_SetSize(&file, 0);
+    if (R_SUCCEEDED(res))
+        res = RamSearch_ForEachWindow(ctx, RamSearch_SnapshotWindow, &file);
+    IFile_Close(&file);
+
+    ctx->hasSnapshot = R_SUCCEEDED(res);
+    ctx->lastPassMs = (u32)(1000 * (svcGetSystemTick() - startTick) / SYSCLOCK_ARM11);
+    return res;
+}
+
+typedef struct RamSearchScanArgs
+{
+    RamSearchWriter *writer;
+    RamSearchCompare cmp;
+    u32 operand;
+} RamSearchScanArgs;
+
+static Result RamSearch_ScanWindow(RamSearchContext *ctx, u32 base, u32 size, void *userdata)
+{
+    RamSearchScanArgs *args = (RamSearchScanArgs *)userdata;
+    u32 vs = ctx->valueSize;
+    const u8 *mapped = (const u8 *)RAMSEARCH_MAP_ADDR;
+
+    for (u32 off = 0; off < size; off += vs)
+    {
+        u32 cur = RamSearch_LoadValue(mapped + off, vs);
+        if (RamSearch_Matches(ctx, args->cmp, cur, cur, args->operand))
+        {
+            Result res = RamSearch_Emit(ctx, args->writer, base + off, cur);
+            if (R_FAILED(res))
+                return res;
+        }
+    }
+
+    return 0;
+}
+
+static Result RamSearch_RefineFromSnapshot(RamSearchContext *ctx, RamSearchWriter *w, RamSearchCompare cmp, u32 operand)
+{
+    IFile file;
+    u64 total;
+    u32 vs = ctx->valueSize;
+    Result res = IFile_Open(&file, ARCHIVE_SDMC, fsMakePath(PATH_EMPTY, ""), fsMakePath(PATH_ASCII, RAMSEARCH_SNAPSHOT_PATH), FS_OPEN_READ);
+    if (R_FAILED(res))
+        return res;
+
+    for (;;)
+    {
+        u32 header[2];
+        res = IFile_Read(&file, &total, header, sizeof(header));
+        if (R_FAILED(res) || total != sizeof(header))
+            break;
+
+        u32 base = header[0], size = header[1];
+        if (R_FAILED(RamSearch_MapAddress(ctx, base)) || ctx->windowBase != base || ctx->windowSize != size)
+        {
+            // Mapping changed since the snapshot was taken, skip the record
+            file.pos += size;
+            continue;
+        }
+
+        const u8 *mapped = (const u8 *)RAMSEARCH_MAP_ADDR;
+        for (u32 off = 0; off < size && R_SUCCEEDED(res); off += RAMSEARCH_IO_BUFFER_SIZE)
+        {
+            u32 chunkSize = size - off < RAMSEARCH_IO_BUFFER_SIZE ? size - off : RAMSEARCH_IO_BUFFER_SIZE;
+            res = IFile_Read(&file, &total, ctx->ioBuffer, chunkSize);
+            if (R_SUCCEEDED(res) && total != chunkSize)
+                res = RAMSEARCH_ERR_NO_BASELINE;
+
+            for (u32 i = 0; i < chunkSize && R_SUCCEEDED(res); i += vs)
+            {
+                u32 prev = RamSearch_LoadValue(ctx->ioBuffer + i, vs);
+                u32 cur = RamSearch_LoadValue(mapped + off + i, vs);
+                if (RamSearch_Matches(ctx, cmp, prev, cur, operand))
+                    res = RamSearch_Emit(ctx, w, base + off + i, cur);
+            }
+        }
+
+        if (R_FAILED(res))
+            break;
+    }
+
+    IFile_Close(&file);
+    RamSearch_Unmap(ctx);
+    return res;
+}
+
+static Result RamSearch_RefineCandidates(RamSearchContext *ctx, RamSearchWriter *w, RamSearchCompare cmp, u32 operand)
+{
+    u32 vs = ctx->valueSize;
+    u32 rpos = 0;
+
+    while (rpos < ctx->candidatesSize)
+    {
+        rpos = ALIGN4(rpos);
+        RamSearchBlock blk = *(const RamSearchBlock *)(ctx->candidates + rpos);
+        rpos += sizeof(RamSearchBlock);
+
+        // Regions that went away (or became read-only) just drop their candidates
+        bool mapped = R_SUCCEEDED(RamSearch_MapAddress(ctx, blk.base));
+
+        for (u32 mask = blk.mask; mask != 0; mask &= mask - 1)
+        {
+            u32 prev = RamSearch_LoadValue(ctx->candidates + rpos, vs);
+            rpos += vs;
+            if (!mapped)
+                continue;
+
+            u32 addr = blk.base + __builtin_ctz(mask) * vs;
+            u32 cur = RamSearch_LoadValue((const u8 *)RAMSEARCH_MAP_ADDR + (addr - ctx->windowBase), vs);
+            if (RamSearch_Matches(ctx, cmp, prev, cur, operand))
+                RamSearch_Emit(ctx, w, addr, cur); // can't fail, see above
+        }
+    }
+
+    RamSearch_Unmap(ctx);
+    return 0;
+}
+
+Result RamSearch_Refine(RamSearchContext *ctx, RamSearchCompare cmp, u32 operand)
+{
+    Result res;
+    RamSearchWriter w = { 0 };
+    u64 startTick = svcGetSystemTick();
+
+    if (cmp >= RAMSEARCH_CMP_MAX)
+        return RAMSEARCH_ERR_NO_BASELINE;
+
+    if (ctx->numPasses != 0)
+        res = RamSearch_RefineCandidates(ctx, &w, cmp, operand);
+    else if (ctx->hasSnapshot)
+        res = RamSearch_RefineFromSnapshot(ctx, &w, cmp, operand);
+    else if (RamSearch_IsRelative(cmp))
+        return RAMSEARCH_ERR_NO_BASELINE;
+    else
+    {
+        RamSearchScanArgs args = { &w, cmp, operand };
+        res = RamSearch_ForEachWindow(ctx, RamSearch_ScanWindow, &args);
+    }
+
+    if (R_FAILED(res))
+    {
+        // Partial first pass results would be misleading. Refining existing candidates can't fail.
+        ctx->candidatesSize = 0;
+        ctx->numCandidates = 0;
+        return res;
+    }
+
+    ctx->candidatesSize = w.pos;
+    ctx->numCandidates = w.count;
+    ctx->numPasses++;
+    ctx->lastPassMs = (u32)(1000 * (svcGetSystemTick() - startTick) / SYSCLOCK_ARM11);
+
+    return 0;
+}
+
+u32 RamSearch_GetCandidates(const RamSearchContext *ctx, u32 startIndex, u32 *addrs, u32 *values, u32 maxCount)
+{
+    u32 vs = ctx->valueSize;
+    u32 rpos = 0, index = 0, n = 0;
+
+    while (rpos < ctx->candidatesSize && n < maxCount)
+    {
+        rpos = ALIGN4(rpos);
+        RamSearchBlock blk = *(const RamSearchBlock *)(ctx->candidates + rpos);
+        rpos += sizeof(RamSearchBlock);
+
+        u32 count = __builtin_popcount(blk.mask);
+        if (index + count <= startIndex)
+        {
+            index += count;
+            rpos += count * vs;
+            continue;
+        }
+
+        for (u32 mask = blk.mask; mask != 0 && n < maxCount; mask &= mask - 1, rpos += vs, index++)
+        {
+            if (index < startIndex)
+                continue;
+            addrs[n] = blk.base + __builtin_ctz(mask) * vs;
+            values[n] = RamSearch_LoadValue(ctx->candidates + rpos, vs);
+            n++;
+        }
+    }
+
+    return n;
+}
+
+static Result RamSearch_OpenCheatFile(RamSearchContext *ctx, IFile *file)
+{
+    char path[64];
+    u64 size;
+    Result res;
+
+    // Same lookup order as the cheat loader, so that exported codes show up in the cheat menu
+    sprintf(path, "/luma/titles/%016llX/cheats.txt", ctx->titleId);
+    res = IFile_Open(file, ARCHIVE_SDMC, fsMakePath(PATH_EMPTY, ""), fsMakePath(PATH_ASCII, path), FS_OPEN_WRITE);
+    if (R_FAILED(res))
+    {
+        FS_Archive archive;
+        if (R_SUCCEEDED(FSUSER_OpenArchive(&archive, ARCHIVE_SDMC, fsMakePath(PATH_EMPTY, ""))))
+        {
+            FSUSER_CreateDirectory(archive, fsMakePath(PATH_ASCII, "/cheats"), 0);
+            FSUSER_CloseArchive(archive);
+        }
+
+        sprintf(path, "/cheats/%016llX.txt", ctx->titleId);
+        res = IFile_Open(file, ARCHIVE_SDMC, fsMakePath(PATH_EMPTY, ""), fsMakePath(PATH_ASCII, path), FS_OPEN_CREATE | FS_OPEN_WRITE);
+    }
+
+    if (R_SUCCEEDED(res))
+        res = IFile_GetSize(file, &size);
+    if (R_SUCCEEDED(res))
+        file->pos = size;
+
+    return res;
+}
+
+Result RamSearch_ExportCheats(RamSearchContext *ctx, u32 *numExported)
+{
+    static const char *writeCodes[] = { NULL, "20000000 000000%02lX", "10000000 0000%04lX", NULL, "00000000 %08lX" };
+
+    u32 addrs[RAMSEARCH_MAX_EXPORTED], values[RAMSEARCH_MAX_EXPORTED];
+    u32 n = RamSearch_GetCandidates(ctx, 0, addrs, values, RAMSEARCH_MAX_EXPORTED);
+    char *buf = (char *)ctx->ioBuffer;
+    u32 len = 0;
+    IFile file;
+    u64 total;
+
+    *numExported = 0;
+    if (n == 0)
+        return 0;
+
+    for (u32 i = 0; i < n; i++)
+    {
+        // Use the offset register so that any address can be written (type 0-2 only take 28 bits)
+        len += sprintf(buf + len, "\r\n[RAM search %08lX %s]\r\nD3000000 %08lX\r\n", addrs[i], RamSearch_GetTypeName(ctx->type), addrs[i]);
+        len += sprintf(buf + len, writeCodes[ctx->valueSize], values[i]);
+        len += sprintf(buf + len, "\r\nD2000000 00000000\r\n");
+    }
+
+    Result res = RamSearch_OpenCheatFile(ctx, &file);
+    if (R_FAILED(res))
+        return res;
+
+    res = IFile_Write(&file, &total, buf, len, FS_WRITE_FLUSH);
+    IFile_Close(&file);
+
+    if (R_SUCCEEDED(res))
+        *numExported = n;
+    return res;
+}
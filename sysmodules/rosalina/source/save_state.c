@@ -0,0 +1,850 @@
+/*
+*   This file is part of Luma3DS
+*   Copyright (C) 2016-2022 Aurora Wright, TuxSH
+*
+*   This program is free software: you can redistribute it and/or modify
+*   it under the terms of the GNU General Public License as published by
+*   the Free Software Foundation, either version 3 of the License, or
+*   (at your option) any later version.
+*
+*   This program is distributed in the hope that it will be useful,
+*   but WITHOUT ANY WARRANTY; without even the implied warranty of
+*   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*   GNU General Public License for more details.
+*
+*   You should have received a copy of the GNU General Public License
+*   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*
+*   Additional Terms 7.b and 7.c of GPLv3 apply to this file:
+*       * Requiring preservation of specified reasonable legal notices or
+*         author attributions in that material or in the Appropriate Legal
+*         Notices displayed by works containing it.
+*       * Prohibiting misrepresentation of the origin of that material,
+*         or requiring that modified versions of such material be marked in
+*         reasonable ways as different from the original version.
+*/
+
+#include <3ds.h>
+#include "save_state.h"
+#include "core_dump.h"
+#include "csvc.h"
+#include "fmt.h"
+#include "ifile.h"
+#include "lz4.h"
+
+#define ALIGN8(x)                   (((x) + 7) & ~7)
+#define SAVESTATE_ADDRESS_SPACE_END 0x40000000
+#define SAVESTATE_COMPRESS_BUF_SIZE LZ4_COMPRESS_BOUND(SAVESTATE_PAGE_SIZE)
+
+typedef struct SaveStateContext
+{
+    Handle processHandle;
+    Handle debug;
+    IFile file;
+    IFile baseFile;
+    SaveStateHeader header;
+    SaveStateHeader baseHeader;
+
+    SaveStateRegion regions[SAVESTATE_MAX_REGIONS];
+    SaveStateRegion baseRegions[SAVESTATE_MAX_REGIONS];
+    u32 threadIds[COREDUMP_MAX_THREADS];
+    u32 numThreadIds;
+
+    u32 heapSize;
+    u32 *pageRefs;
+    u32 *basePages;
+
+    // Save
+    SaveStateStore store;
+    u64 *pageHashes;
+    u64 *baseHashes;        // of every page of the base snapshot
+    u8 *ioBuf;
+    u32 ioFill;
+    u32 offset;             // logical file offset, including what is still in ioBuf
+    u8 *compressBuf;
+    u8 *hashTable;
+
+    // Restore
+    SaveStateChunk *chunks;
+    u32 *baseRefs;
+    SaveStateChunk *baseChunks;
+    u8 *readBuf;
+
+    SaveStateThread *threads;
+} SaveStateContext;
+
+static bool SaveState_IsSaveable(const MemInfo *mem)
+{
+    // Same as what RAM search scans: the memory the process can change by itself
+    if (!(mem->perm & MEMPERM_WRITE))
+        return false;
+
+    switch (mem->state)
+    {
+        case MEMSTATE_PRIVATE:
+        case MEMSTATE_CONTINUOUS:
+        case MEMSTATE_ALIASED:
+        case MEMSTATE_ALIAS_CODE:
+        case MEMSTATE_LOCKED:
+            return true;
+        default:
+            return false;
+    }
+}
+
+static u32 SaveState_GetRegions(Handle processHandle, SaveStateRegion *regions, u32 *numPages)
+{
+    u32 n = 0;
+    u32 addr = 0;
+
+    *numPages = 0;
+    while (addr < SAVESTATE_ADDRESS_SPACE_END && n < SAVESTATE_MAX_REGIONS)
+    {
+        MemInfo mem;
+        PageInfo out;
+        if (R_FAILED(svcQueryProcessMemory(&mem, &out, processHandle, addr)) || mem.base_addr + mem.size <= addr)
+            break;
+
+        if (SaveState_IsSaveable(&mem))
+        {
+            regions[n].addr = mem.base_addr;
+            regions[n].size = mem.size;
+            regions[n].perm = mem.perm;
+            regions[n].state = mem.state;
+            *numPages += mem.size / SAVESTATE_PAGE_SIZE;
+            n++;
+        }
+
+        addr = mem.base_addr + mem.size;
+    }
+
+    return n;
+}
+
+// The regions must still be there, writable, for the pages to go back where they came from
+static Result SaveState_CheckRegions(Handle processHandle, const SaveStateRegion *regions, u32 numRegions)
+{
+    for (u32 i = 0; i < numRegions; i++)
+    {
+        MemInfo mem;
+        PageInfo out;
+        if (R_FAILED(svcQueryProcessMemory(&mem, &out, processHandle, regions[i].addr)) || !SaveState_IsSaveable(&mem) ||
+            regions[i].addr + regions[i].size > mem.base_addr + mem.size)
+            return SAVESTATE_ERR_MISMATCH;
+    }
+
+    return 0;
+}
+
+static FS_ArchiveID SaveState_GetArchiveId(void)
+{
+    s64 out;
+
+    if (R_FAILED(svcGetSystemInfo(&out, 0x10000, 0x203))) svcBreak(USERBREAK_ASSERT);
+    return (bool)out ? ARCHIVE_SDMC : ARCHIVE_NAND_RW;
+}
+
+static Result SaveState_OpenSlot(IFile *file, u64 titleId, u32 slot, bool write)
+{
+    char path[64];
+    FS_ArchiveID archiveId = SaveState_GetArchiveId();
+
+    if (slot >= SAVESTATE_NUM_SLOTS)
+        return SAVESTATE_ERR_INVALID_SLOT;
+
+    if (write)
+    {
+        FS_Archive archive;
+        if (R_SUCCEEDED(FSUSER_OpenArchive(&archive, archiveId, fsMakePath(PATH_EMPTY, ""))))
+        {
+            sprintf(path, "/luma/savestates/%016llX", titleId);
+            FSUSER_CreateDirectory(archive, fsMakePath(PATH_ASCII, "/luma/savestates"), 0);
+            FSUSER_CreateDirectory(archive, fsMakePath(PATH_ASCII, path), 0);
+            FSUSER_CloseArchive(archive);
+        }
+    }
+
+    sprintf(path, "/luma/savestates/%016llX/slot%lu.lss", titleId, slot);
+    return IFile_Open(file, archiveId, fsMakePath(PATH_EMPTY, ""), fsMakePath(PATH_ASCII, path), write ? FS_OPEN_CREATE | FS_OPEN_WRITE : FS_OPEN_READ);
+}
+
+static Result SaveState_ReadAt(IFile *file, u32 offset, void *buf, u32 size)
+{
+    u64 total;
+
+    file->pos = offset;
+    Result res = IFile_Read(file, &total, buf, size);
+    if (R_SUCCEEDED(res) && total != size)
+        res = SAVESTATE_ERR_INVALID_FILE;
+
+    return res;
+}
+
+static bool SaveState_IsTableInFile(u32 offset, u32 count, u32 entrySize, u64 fileSize)
+{
+    return offset >= sizeof(SaveStateHeader) && (offset & 7) == 0 && (u64)offset + (u64)count * entrySize <= fileSize;
+}
+
+// Reads and validates the header, then the region table
+static Result SaveState_ReadHeaderAndRegions(IFile *file, u64 titleId, SaveStateHeader *header, SaveStateRegion *regions)
+{
+    u64 fileSize;
+    Result res = IFile_GetSize(file, &fileSize);
+    if (R_SUCCEEDED(res))
+        res = SaveState_ReadAt(file, 0, header, sizeof(SaveStateHeader));
+    if (R_FAILED(res))
+        return res;
+
+    if (header->magic != SAVESTATE_MAGIC || header->version != SAVESTATE_VERSION ||
+        header->numRegions > SAVESTATE_MAX_REGIONS || header->numThreads > SAVESTATE_MAX_THREADS ||
+        header->numPages > SAVESTATE_MAX_PAGES || header->numChunks > header->numPages ||
+        !SaveState_IsTableInFile(header->regionsOffset, header->numRegions, sizeof(SaveStateRegion), fileSize) ||
+        !SaveState_IsTableInFile(header->pageRefsOffset, header->numPages, sizeof(u32), fileSize) ||
+        !SaveState_IsTableInFile(header->pageHashesOffset, header->numPages, sizeof(u64), fileSize) ||
+        !SaveState_IsTableInFile(header->chunksOffset, header->numChunks, sizeof(SaveStateChunk), fileSize) ||
+        !SaveState_IsTableInFile(header->threadsOffset, header->numThreads, sizeof(SaveStateThread), fileSize))
+        return SAVESTATE_ERR_INVALID_FILE;
+
+    if (header->titleId != titleId)
+        return SAVESTATE_ERR_MISMATCH;
+
+    res = SaveState_ReadAt(file, header->regionsOffset, regions, header->numRegions * sizeof(SaveStateRegion));
+    if (R_FAILED(res))
+        return res;
+
+    u32 numPages = 0;
+    for (u32 i = 0; i < header->numRegions; i++)
+    {
+        if ((regions[i].addr | regions[i].size) & (SAVESTATE_PAGE_SIZE - 1) || (i > 0 && regions[i].addr < regions[i - 1].addr + regions[i - 1].size))
+            return SAVESTATE_ERR_INVALID_FILE;
+        numPages += regions[i].size / SAVESTATE_PAGE_SIZE;
+    }
+
+    return numPages == header->numPages ? 0 : SAVESTATE_ERR_INVALID_FILE;
+}
+
+// The base of an incremental snapshot must be a full snapshot of the same title
+static Result SaveState_OpenBase(SaveStateContext *ctx, u64 titleId)
+{
+    Result res = SaveState_OpenSlot(&ctx->baseFile, titleId, SAVESTATE_BASE_SLOT, false);
+    if (R_FAILED(res))
+        return SAVESTATE_ERR_NO_BASE;
+
+    res = SaveState_ReadHeaderAndRegions(&ctx->baseFile, titleId, &ctx->baseHeader, ctx->baseRegions);
+    if (R_SUCCEEDED(res) && (ctx->baseHeader.flags & SAVESTATE_FLAG_INCREMENTAL))
+        res = SAVESTATE_ERR_NO_BASE;
+
+    if (R_FAILED(res))
+    {
+        IFile_Close(&ctx->baseFile);
+        ctx->baseFile.handle = 0;
+    }
+
+    return res;
+}
+
+static Result SaveState_AllocHeap(SaveStateContext *ctx, u32 size)
+{
+    u32 heap;
+
+    size = (size + 0xFFF) & ~0xFFF;
+    Result res = svcControlMemoryEx(&heap, SAVESTATE_HEAP_ADDR, 0, size, MEMOP_ALLOC | MEMOP_REGION_SYSTEM, MEMPERM_READWRITE, true);
+    ctx->heapSize = R_SUCCEEDED(res) ? size : 0;
+
+    return res;
+}
+
+static void SaveState_Cleanup(SaveStateContext *ctx)
+{
+    u32 heap;
+
+    if (ctx->debug != 0)
+        CoreDump_ResumeProcess(ctx->debug);
+    if (ctx->heapSize != 0)
+        svcControlMemory(&heap, SAVESTATE_HEAP_ADDR, 0, ctx->heapSize, MEMOP_FREE, 0);
+    if (ctx->file.handle != 0)
+        IFile_Close(&ctx->file);
+    if (ctx->baseFile.handle != 0)
+        IFile_Close(&ctx->baseFile);
+    if (ctx->processHandle != 0)
+        svcCloseHandle(ctx->processHandle);
+}
+
+// Unlike core dumps, saving and restoring require the threads to be stopped
+static Result SaveState_Attach(SaveStateContext *ctx, u32 pid)
+{
+    Result res = svcOpenProcess(&ctx->processHandle, pid);
+    if (R_SUCCEEDED(res))
+        res = svcDebugActiveProcess(&ctx->debug, pid);
+    if (R_SUCCEEDED(res))
+        ctx->numThreadIds = CoreDump_FreezeProcess(ctx->debug, ctx->threadIds);
+    else
+        ctx->debug = 0;
+
+    return res;
+}
+
+static Result SaveState_Flush(SaveStateContext *ctx)
+{
+    u64 total;
+    Result res = IFile_Write(&ctx->file, &total, ctx->ioBuf, ctx->ioFill, 0);
+
+    ctx->ioFill = 0;
+    return res;
+}
+
+static Result SaveState_Write(SaveStateContext *ctx, const void *data, u32 size)
+{
+    const u8 *src = (const u8 *)data;
+    Result res = 0;
+
+    ctx->offset += size;
+    while (size > 0 && R_SUCCEEDED(res))
+    {
+        u32 n = SAVESTATE_IO_BUFFER_SIZE - ctx->ioFill;
+        n = n > size ? size : n;
+        memcpy(ctx->ioBuf + ctx->ioFill, src, n);
+        ctx->ioFill += n;
+        src += n;
+        size -= n;
+
+        if (ctx->ioFill == SAVESTATE_IO_BUFFER_SIZE)
+            res = SaveState_Flush(ctx);
+    }
+
+    return res;
+}
+
+static Result SaveState_Align(SaveStateContext *ctx)
+{
+    static const u8 padding[8] = { 0 };
+    return SaveState_Write(ctx, padding, ALIGN8(ctx->offset) - ctx->offset);
+}
+
+static Result SaveState_SavePage(SaveStateContext *ctx, const void *page, u32 pageIdx)
+{
+    SaveStateHeader *header = &ctx->header;
+    u64 baseHash, hash;
+    const u64 *baseHashPtr = NULL;
+
+    if (ctx->basePages != NULL)
+    {
+        // No base page is the same as an all-zero base page: neither matches the hash of a non-zero page
+        u32 basePage = ctx->basePages[pageIdx];
+        baseHash = basePage != SAVESTATE_NO_BASE_PAGE ? ctx->baseHashes[basePage] : SAVESTATE_ZERO_PAGE_HASH;
+        baseHashPtr = &baseHash;
+    }
+
+    u32 ref = SaveStateStore_LookupPage(&ctx->store, page, baseHashPtr, &hash);
+    Result res = 0;
+
+    if (ref == SAVESTATE_REF_NEW)
+    {
+        const void *data = ctx->compressBuf;
+        u32 storedSize = lz4CompressBlock(page, SAVESTATE_PAGE_SIZE, ctx->compressBuf, SAVESTATE_COMPRESS_BUF_SIZE, ctx->hashTable);
+        if (storedSize == 0 || storedSize >= SAVESTATE_PAGE_SIZE)
+        {
+            data = page;
+            storedSize = SAVESTATE_PAGE_SIZE;
+        }
+
+        // Can't fail, there are as many chunks available as pages
+        ref = SaveStateStore_AddChunk(&ctx->store, hash, ctx->offset, storedSize);
+        header->chunkDataSize += storedSize;
+        res = SaveState_Write(ctx, data, storedSize);
+    }
+    else if (ref == SAVESTATE_REF_ZERO)
+        header->numZeroPages++;
+    else if (ref == SAVESTATE_REF_BASE)
+        header->numBasePages++;
+    else
+        header->numDedupPages++;
+
+    ctx->pageRefs[pageIdx] = ref;
+    ctx->pageHashes[pageIdx] = hash;
+
+    return res;
+}
+
+static Result SaveState_SaveRegions(SaveStateContext *ctx)
+{
+    Result res = 0;
+    u32 pageIdx = 0;
+
+    for (u32 i = 0; i < ctx->header.numRegions && R_SUCCEEDED(res); i++)
+    {
+        const SaveStateRegion *region = &ctx->regions[i];
+
+        for (u32 off = 0; off < region->size && R_SUCCEEDED(res); off += SAVESTATE_MAP_WINDOW_SIZE)
+        {
+            u32 size = region->size - off < SAVESTATE_MAP_WINDOW_SIZE ? region->size - off : SAVESTATE_MAP_WINDOW_SIZE;
+
+            res = svcMapProcessMemoryEx(CUR_PROCESS_HANDLE, SAVESTATE_MAP_ADDR, ctx->processHandle, region->addr + off, size);
+            if (R_FAILED(res))
+                break;
+
+            for (u32 pageOff = 0; pageOff < size && R_SUCCEEDED(res); pageOff += SAVESTATE_PAGE_SIZE)
+                res = SaveState_SavePage(ctx, (const void *)(SAVESTATE_MAP_ADDR + pageOff), pageIdx++);
+
+            svcUnmapProcessMemoryEx(CUR_PROCESS_HANDLE, SAVESTATE_MAP_ADDR, size);
+        }
+    }
+
+    return res;
+}
+
+static u32 SaveState_GetThreadContexts(SaveStateContext *ctx)
+{
+    u32 n = 0;
+
+    for (u32 i = 0; i < ctx->numThreadIds && n < SAVESTATE_MAX_THREADS; i++)
+    {
+        ThreadContext regs;
+        SaveStateThread *thread = &ctx->threads[n];
+
+        if (R_FAILED(svcGetDebugThreadContext(&regs, ctx->debug, ctx->threadIds[i], THREADCONTEXT_CONTROL_ALL)))
+            continue;
+
+        thread->threadId = ctx->threadIds[i];
+        memcpy(thread->cpu, regs.cpu_registers.r, sizeof(regs.cpu_registers.r));
+        thread->cpu[13] = regs.cpu_registers.sp;
+        thread->cpu[14] = regs.cpu_registers.lr;
+        thread->cpu[15] = regs.cpu_registers.pc;
+        thread->cpu[16] = regs.cpu_registers.cpsr;
+        memcpy(thread->fpu, regs.fpu_registers.d, sizeof(thread->fpu));
+        thread->fpscr = regs.fpu_registers.fpscr;
+        thread->fpexc = regs.fpu_registers.fpexc;
+        n++;
+    }
+
+    return n;
+}
+
+// Heap layout for saving: chunk store, page refs, page hashes, then I/O buffers, thread contexts and the base tables
+static Result SaveState_SetupSaveHeap(SaveStateContext *ctx, u32 numPages, u32 numBasePages)
+{
+    u32 storeSize = SaveStateStore_GetRequiredSize(numPages);
+    u32 size = storeSize + ALIGN8(numPages * sizeof(u32)) + numPages * sizeof(u64) + SAVESTATE_IO_BUFFER_SIZE +
+               ALIGN8(SAVESTATE_COMPRESS_BUF_SIZE) + LZ4_HASH_TABLE_SIZE + ALIGN8(SAVESTATE_MAX_THREADS * sizeof(SaveStateThread));
+
+    if (numBasePages != 0)
+        size += numBasePages * sizeof(u64) + ALIGN8(numPages * sizeof(u32));
+
+    Result res = SaveState_AllocHeap(ctx, size);
+    if (R_FAILED(res))
+        return res;
+
+    u8 *p = (u8 *)SAVESTATE_HEAP_ADDR;
+    SaveStateStore_Init(&ctx->store, p, numPages);
+    p += storeSize;
+    ctx->pageRefs = (u32 *)p;
+    p += ALIGN8(numPages * sizeof(u32));
+    ctx->pageHashes = (u64 *)p;
+    p += numPages * sizeof(u64);
+    ctx->ioBuf = p;
+    p += SAVESTATE_IO_BUFFER_SIZE;
+    ctx->compressBuf = p;
+    p += ALIGN8(SAVESTATE_COMPRESS_BUF_SIZE);
+    ctx->hashTable = p;
+    p += LZ4_HASH_TABLE_SIZE;
+    ctx->threads = (SaveStateThread *)p;
+    p += ALIGN8(SAVESTATE_MAX_THREADS * sizeof(SaveStateThread));
+
+    if (numBasePages != 0)
+    {
+        ctx->baseHashes = (u64 *)p;
+        p += numBasePages * sizeof(u64);
+        ctx->basePages = (u32 *)p;
+    }
+
+    return 0;
+}
+
+static Result SaveState_WriteTables(SaveStateContext *ctx)
+{
+    SaveStateHeader *header = &ctx->header;
+    Result res = SaveState_Align(ctx);
+
+    header->regionsOffset = ctx->offset;
+    if (R_SUCCEEDED(res))
+        res = SaveState_Write(ctx, ctx->regions, header->numRegions * sizeof(SaveStateRegion));
+
+    header->pageRefsOffset = ctx->offset;
+    if (R_SUCCEEDED(res))
+        res = SaveState_Write(ctx, ctx->pageRefs, header->numPages * sizeof(u32));
+    if (R_SUCCEEDED(res))
+        res = SaveState_Align(ctx);
+
+    header->pageHashesOffset = ctx->offset;
+    if (R_SUCCEEDED(res))
+        res = SaveState_Write(ctx, ctx->pageHashes, header->numPages * sizeof(u64));
+
+    header->chunksOffset = ctx->offset;
+    header->numChunks = ctx->store.numChunks;
+    for (u32 i = 0; i < ctx->store.numChunks && R_SUCCEEDED(res); i++)
+    {
+        SaveStateChunk chunk = { ctx->store.hashes[i], ctx->store.offsets[i], ctx->store.storedSizes[i] };
+        res = SaveState_Write(ctx, &chunk, sizeof(chunk));
+    }
+
+    header->threadsOffset = ctx->offset;
+    if (R_SUCCEEDED(res))
+        res = SaveState_Write(ctx, ctx->threads, header->numThreads * sizeof(SaveStateThread));
+
+    return res;
+}
+
+Result SaveState_Save(u32 pid, u64 titleId, u32 slot, bool incremental, SaveStateStats *stats)
+{
+    SaveStateContext ctx = { 0 };
+    SaveStateHeader *header = &ctx.header;
+    u64 startTick = svcGetSystemTick();
+    u32 numPages;
+    Result res;
+
+    memset(stats, 0, sizeof(SaveStateStats));
+    if (slot >= SAVESTATE_NUM_SLOTS || (incremental && slot == SAVESTATE_BASE_SLOT))
+        return SAVESTATE_ERR_INVALID_SLOT;
+
+    if (incremental)
+    {
+        res = SaveState_OpenBase(&ctx, titleId);
+        if (R_FAILED(res))
+            return res;
+    }
+
+    res = SaveState_Attach(&ctx, pid);
+    if (R_FAILED(res))
+    {
+        SaveState_Cleanup(&ctx);
+        return res;
+    }
+
+    header->numRegions = SaveState_GetRegions(ctx.processHandle, ctx.regions, &numPages);
+    header->numPages = numPages;
+    if (numPages > SAVESTATE_MAX_PAGES)
+        res = SAVESTATE_ERR_TOO_LARGE;
+
+    if (R_SUCCEEDED(res))
+        res = SaveState_SetupSaveHeap(&ctx, numPages, incremental ? ctx.baseHeader.numPages : 0);
+
+    if (R_SUCCEEDED(res) && incremental)
+    {
+        SaveStateStore_MatchBasePages(ctx.basePages, ctx.regions, header->numRegions, ctx.baseRegions, ctx.baseHeader.numRegions);
+        res = SaveState_ReadAt(&ctx.baseFile, ctx.baseHeader.pageHashesOffset, ctx.baseHashes, ctx.baseHeader.numPages * sizeof(u64));
+    }
+
+    if (R_SUCCEEDED(res))
+        res = SaveState_OpenSlot(&ctx.file, titleId, slot, true);
+
+    if (R_SUCCEEDED(res))
+    {
+        header->magic = SAVESTATE_MAGIC;
+        header->version = SAVESTATE_VERSION;
+        header->flags = incremental ? SAVESTATE_FLAG_INCREMENTAL : 0;
+        header->titleId = titleId;
+        header->id = startTick;
+        header->baseId = incremental ? ctx.baseHeader.id : 0;
+        header->creationTime = osGetTime();
+        header->numThreads = SaveState_GetThreadContexts(&ctx);
+
+        // Written again once all the offsets are known
+        res = SaveState_Write(&ctx, header, sizeof(SaveStateHeader));
+        if (R_SUCCEEDED(res))
+            res = SaveState_SaveRegions(&ctx);
+        if (R_SUCCEEDED(res))
+            res = SaveState_WriteTables(&ctx);
+        if (R_SUCCEEDED(res))
+            res = SaveState_Flush(&ctx);
+
+        if (R_SUCCEEDED(res))
+        {
+            u64 total;
+            ctx.file.pos = 0;
+            res = IFile_Write(&ctx.file, &total, header, sizeof(SaveStateHeader), 0);
+        }
+
+        // Don't leave a valid-looking header in front of a truncated or stale file
+        if (R_SUCCEEDED(res))
+            res = IFile_SetSize(&ctx.file, ctx.offset);
+        else
+            IFile_SetSize(&ctx.file, 0);
+    }
+
+    SaveState_Cleanup(&ctx);
+
+    stats->numRegions = header->numRegions;
+    stats->numPages = header->numPages;
+    stats->numChunks = header->numChunks;
+    stats->numZeroPages = header->numZeroPages;
+    stats->numBasePages = header->numBasePages;
+    stats->numDedupPages = header->numDedupPages;
+    stats->numThreads = header->numThreads;
+    stats->fileSize = ctx.offset;
+    stats->elapsedMs = (u32)(1000 * (svcGetSystemTick() - startTick) / SYSCLOCK_ARM11);
+
+    return res;
+}
+
+// Heap layout for restoring: page refs, chunk table, base page indices, base page refs, base chunk table, read buffer, thread contexts
+static Result SaveState_SetupRestoreHeap(SaveStateContext *ctx)
+{
+    const SaveStateHeader *header = &ctx->header, *baseHeader = &ctx->baseHeader;
+    bool incremental = (header->flags & SAVESTATE_FLAG_INCREMENTAL) != 0;
+    u32 size = ALIGN8(header->numPages * sizeof(u32)) + header->numChunks * sizeof(SaveStateChunk) + SAVESTATE_PAGE_SIZE +
+               ALIGN8(SAVESTATE_MAX_THREADS * sizeof(SaveStateThread));
+
+    if (incremental)
+        size += ALIGN8(header->numPages * sizeof(u32)) + ALIGN8(baseHeader->numPages * sizeof(u32)) + baseHeader->numChunks * sizeof(SaveStateChunk);
+
+    Result res = SaveState_AllocHeap(ctx, size);
+    if (R_FAILED(res))
+        return res;
+
+    u8 *p = (u8 *)SAVESTATE_HEAP_ADDR;
+    ctx->pageRefs = (u32 *)p;
+    p += ALIGN8(header->numPages * sizeof(u32));
+    ctx->chunks = (SaveStateChunk *)p;
+    p += header->numChunks * sizeof(SaveStateChunk);
+    ctx->readBuf = p;
+    p += SAVESTATE_PAGE_SIZE;
+    ctx->threads = (SaveStateThread *)p;
+    p += ALIGN8(SAVESTATE_MAX_THREADS * sizeof(SaveStateThread));
+
+    if (incremental)
+    {
+        ctx->basePages = (u32 *)p;
+        p += ALIGN8(header->numPages * sizeof(u32));
+        ctx->baseRefs = (u32 *)p;
+        p += ALIGN8(baseHeader->numPages * sizeof(u32));
+        ctx->baseChunks = (SaveStateChunk *)p;
+    }
+
+    return 0;
+}
+
+static bool SaveState_AreChunksValid(const SaveStateChunk *chunks, u32 numChunks, u32 chunksOffset)
+{
+    for (u32 i = 0; i < numChunks; i++)
+    {
+        if (chunks[i].storedSize == 0 || chunks[i].storedSize > SAVESTATE_PAGE_SIZE || chunks[i].offset < sizeof(SaveStateHeader) ||
+            chunks[i].offset + chunks[i].storedSize > chunksOffset)
+            return false;
+    }
+
+    return true;
+}
+
+// Loads and cross-checks every table, so that nothing gets written if the snapshot can't be restored as a whole
+static Result SaveState_LoadRestoreTables(SaveStateContext *ctx)
+{
+    const SaveStateHeader *header = &ctx->header, *baseHeader = &ctx->baseHeader;
+    bool incremental = (header->flags & SAVESTATE_FLAG_INCREMENTAL) != 0;
+
+    Result res = SaveState_ReadAt(&ctx->file, header->pageRefsOffset, ctx->pageRefs, header->numPages * sizeof(u32));
+    if (R_SUCCEEDED(res))
+        res = SaveState_ReadAt(&ctx->file, header->chunksOffset, ctx->chunks, header->numChunks * sizeof(SaveStateChunk));
+    if (R_SUCCEEDED(res))
+        res = SaveState_ReadAt(&ctx->file, header->threadsOffset, ctx->threads, header->numThreads * sizeof(SaveStateThread));
+    if (R_SUCCEEDED(res) && incremental)
+        res = SaveState_ReadAt(&ctx->baseFile, baseHeader->pageRefsOffset, ctx->baseRefs, baseHeader->numPages * sizeof(u32));
+    if (R_SUCCEEDED(res) && incremental)
+        res = SaveState_ReadAt(&ctx->baseFile, baseHeader->chunksOffset, ctx->baseChunks, baseHeader->numChunks * sizeof(SaveStateChunk));
+    if (R_FAILED(res))
+        return res;
+
+    if (!SaveState_AreChunksValid(ctx->chunks, header->numChunks, header->chunksOffset) ||
+        (incremental && !SaveState_AreChunksValid(ctx->baseChunks, baseHeader->numChunks, baseHeader->chunksOffset)))
+        return SAVESTATE_ERR_INVALID_FILE;
+
+    if (incremental)
+        SaveStateStore_MatchBasePages(ctx->basePages, ctx->regions, header->numRegions, ctx->baseRegions, baseHeader->numRegions);
+
+    for (u32 i = 0; i < header->numPages; i++)
+    {
+        u32 ref = ctx->pageRefs[i];
+
+        if (ref == SAVESTATE_REF_BASE)
+        {
+            if (!incremental || ctx->basePages[i] == SAVESTATE_NO_BASE_PAGE)
+                return SAVESTATE_ERR_INVALID_FILE;
+
+            ref = ctx->baseRefs[ctx->basePages[i]];
+            if (ref != SAVESTATE_REF_ZERO && ref >= baseHeader->numChunks)
+                return SAVESTATE_ERR_INVALID_FILE;
+        }
+        else if (ref != SAVESTATE_REF_ZERO && ref >= header->numChunks)
+            return SAVESTATE_ERR_INVALID_FILE;
+    }
+
+    return 0;
+}
+
+static Result SaveState_ReadChunk(IFile *file, const SaveStateChunk *chunk, void *dst, u8 *readBuf)
+{
+    Result res;
+
+    if (chunk->storedSize == SAVESTATE_PAGE_SIZE)
+        res = SaveState_ReadAt(file, chunk->offset, dst, SAVESTATE_PAGE_SIZE);
+    else
+    {
+        res = SaveState_ReadAt(file, chunk->offset, readBuf, chunk->storedSize);
+        if (R_SUCCEEDED(res) && lz4DecompressBlock(readBuf, chunk->storedSize, dst, SAVESTATE_PAGE_SIZE) != SAVESTATE_PAGE_SIZE)
+            res = SAVESTATE_ERR_INVALID_FILE;
+    }
+
+    if (R_SUCCEEDED(res) && SaveStateStore_HashPage(dst) != chunk->hash)
+        res = SAVESTATE_ERR_INVALID_FILE;
+
+    return res;
+}
+
+static Result SaveState_RestorePage(SaveStateContext *ctx, void *page, u32 pageIdx)
+{
+    u32 ref = ctx->pageRefs[pageIdx];
+
+    if (ref == SAVESTATE_REF_BASE)
+    {
+        ref = ctx->baseRefs[ctx->basePages[pageIdx]];
+        if (ref != SAVESTATE_REF_ZERO)
+            return SaveState_ReadChunk(&ctx->baseFile, &ctx->baseChunks[ref], page, ctx->readBuf);
+    }
+
+    if (ref == SAVESTATE_REF_ZERO)
+    {
+        memset(page, 0, SAVESTATE_PAGE_SIZE);
+        return 0;
+    }
+
+    return SaveState_ReadChunk(&ctx->file, &ctx->chunks[ref], page, ctx->readBuf);
+}
+
+static Result SaveState_RestoreRegions(SaveStateContext *ctx)
+{
+    Result res = 0;
+    u32 pageIdx = 0;
+
+    for (u32 i = 0; i < ctx->header.numRegions && R_SUCCEEDED(res); i++)
+    {
+        const SaveStateRegion *region = &ctx->regions[i];
+
+        for (u32 off = 0; off < region->size && R_SUCCEEDED(res); off += SAVESTATE_MAP_WINDOW_SIZE)
+        {
+            u32 size = region->size - off < SAVESTATE_MAP_WINDOW_SIZE ? region->size - off : SAVESTATE_MAP_WINDOW_SIZE;
+
+            res = svcMapProcessMemoryEx(CUR_PROCESS_HANDLE, SAVESTATE_MAP_ADDR, ctx->processHandle, region->addr + off, size);
+            if (R_FAILED(res))
+                break;
+
+            for (u32 pageOff = 0; pageOff < size && R_SUCCEEDED(res); pageOff += SAVESTATE_PAGE_SIZE)
+                res = SaveState_RestorePage(ctx, (void *)(SAVESTATE_MAP_ADDR + pageOff), pageIdx++);
+
+            svcFlushProcessDataCache(CUR_PROCESS_HANDLE, SAVESTATE_MAP_ADDR, size);
+            svcUnmapProcessMemoryEx(CUR_PROCESS_HANDLE, SAVESTATE_MAP_ADDR, size);
+        }
+    }
+
+    // Some of the regions may be code (CROs)
+    svcInvalidateEntireInstructionCache();
+
+    return res;
+}
+
+static u32 SaveState_SetThreadContexts(SaveStateContext *ctx)
+{
+    u32 n = 0;
+
+    for (u32 i = 0; i < ctx->header.numThreads; i++)
+    {
+        const SaveStateThread *thread = &ctx->threads[i];
+        ThreadContext regs;
+        bool exists = false;
+
+        for (u32 j = 0; j < ctx->numThreadIds && !exists; j++)
+            exists = ctx->threadIds[j] == thread->threadId;
+        if (!exists)
+            continue;
+
+        memcpy(regs.cpu_registers.r, thread->cpu, sizeof(regs.cpu_registers.r));
+        regs.cpu_registers.sp = thread->cpu[13];
+        regs.cpu_registers.lr = thread->cpu[14];
+        regs.cpu_registers.pc = thread->cpu[15];
+        regs.cpu_registers.cpsr = thread->cpu[16];
+        memcpy(regs.fpu_registers.d, thread->fpu, sizeof(thread->fpu));
+        regs.fpu_registers.fpscr = thread->fpscr;
+        regs.fpu_registers.fpexc = thread->fpexc;
+
+        if (R_SUCCEEDED(svcSetDebugThreadContext(ctx->debug, thread->threadId, &regs, THREADCONTEXT_CONTROL_ALL)))
+            n++;
+    }
+
+    return n;
+}
+
+Result SaveState_Restore(u32 pid, u64 titleId, u32 slot, SaveStateStats *stats)
+{
+    SaveStateContext ctx = { 0 };
+    SaveStateHeader *header = &ctx.header;
+    u64 startTick = svcGetSystemTick();
+    u32 numThreads = 0;
+
+    memset(stats, 0, sizeof(SaveStateStats));
+
+    Result res = SaveState_OpenSlot(&ctx.file, titleId, slot, false);
+    if (R_FAILED(res))
+        return res;
+
+    res = SaveState_ReadHeaderAndRegions(&ctx.file, titleId, header, ctx.regions);
+    if (R_SUCCEEDED(res) && (header->flags & SAVESTATE_FLAG_INCREMENTAL))
+    {
+        res = SaveState_OpenBase(&ctx, titleId);
+        if (R_SUCCEEDED(res) && ctx.baseHeader.id != header->baseId)
+            res = SAVESTATE_ERR_NO_BASE;
+    }
+
+    if (R_SUCCEEDED(res))
+        res = SaveState_SetupRestoreHeap(&ctx);
+    if (R_SUCCEEDED(res))
+        res = SaveState_LoadRestoreTables(&ctx);
+    if (R_SUCCEEDED(res))
+        res = SaveState_Attach(&ctx, pid);
+    if (R_SUCCEEDED(res))
+        res = SaveState_CheckRegions(ctx.processHandle, ctx.regions, header->numRegions);
+
+    if (R_SUCCEEDED(res))
+    {
+        res = SaveState_RestoreRegions(&ctx);
+        if (R_SUCCEEDED(res))
+            numThreads = SaveState_SetThreadContexts(&ctx);
+    }
+
+    SaveState_Cleanup(&ctx);
+
+    stats->numRegions = header->numRegions;
+    stats->numPages = header->numPages;
+    stats->numChunks = header->numChunks;
+    stats->numZeroPages = header->numZeroPages;
+    stats->numBasePages = header->numBasePages;
+    stats->numDedupPages = header->numDedupPages;
+    stats->numThreads = numThreads;
+    stats->numThreadsMissing = R_SUCCEEDED(res) ? header->numThreads - numThreads : 0;
+    stats->fileSize = ctx.file.size;
+    stats->elapsedMs = (u32)(1000 * (svcGetSystemTick() - startTick) / SYSCLOCK_ARM11);
+
+    return res;
+}
+
+Result SaveState_GetSlotInfo(u64 titleId, u32 slot, SaveStateHeader *header)
+{
+    IFile file;
+    Result res = SaveState_OpenSlot(&file, titleId, slot, false);
+    if (R_FAILED(res))
+        return res;
+
+    res = SaveState_ReadAt(&file, 0, header, sizeof(SaveStateHeader));
+    if (R_SUCCEEDED(res) && (header->magic != SAVESTATE_MAGIC || header->version != SAVESTATE_VERSION || header->titleId != titleId))
+        res = SAVESTATE_ERR_INVALID_FILE;
+
+    IFile_Close(&file);
+    return res;
+}
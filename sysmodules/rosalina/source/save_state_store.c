@@ -0,0 +1,168 @@
+/*
+*   This file is part of Luma3DS
+*   Copyright (C) 2016-2022 Aurora Wright, TuxSH
+*
+*   This program is free software: you can redistribute it and/or modify
+*   it under the terms of the GNU General Public License as published by
+*   the Free Software Foundation, either version 3 of the License, or
+*   (at your option) any later version.
+*
+*   This program is distributed in the hope that it will be useful,
+*   but WITHOUT ANY WARRANTY; without even the implied warranty of
+*   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*   GNU General Public License for more details.
+*
+*   You should have received a copy of the GNU General Public License
+*   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*
+*   Additional Terms 7.b and 7.c of GPLv3 apply to this file:
+*       * Requiring preservation of specified reasonable legal notices or
+*         author attributions in that material or in the Appropriate Legal
+*         Notices displayed by works containing it.
+*       * Prohibiting misrepresentation of the origin of that material,
+*         or requiring that modified versions of such material be marked in
+*         reasonable ways as different from the original version.
+*/
+
+#include <string.h>
+#include "save_state_store.h"
+
+#define ALIGN8(x)               (((x) + 7) & ~7)
+
+// FNV-1a, a 32-bit word at a time, with a final mix so that the index can use the low bits
+#define FNV64_OFFSET_BASIS      0xCBF29CE484222325ULL
+#define FNV64_PRIME             0x00000100000001B3ULL
+
+static inline u32 SaveStateStore_GetIndexSize(u32 maxChunks)
+{
+    // Power of two, at most half full
+    u32 size = 16;
+    while (size < 2 * maxChunks)
+        size <<= 1;
+    return size;
+}
+
+u32 SaveStateStore_GetRequiredSize(u32 maxChunks)
+{
+    return ALIGN8(maxChunks * sizeof(u64)) + ALIGN8(maxChunks * sizeof(u32)) + ALIGN8(maxChunks * sizeof(u16)) +
+           ALIGN8(SaveStateStore_GetIndexSize(maxChunks) * sizeof(u16));
+}
+
+void SaveStateStore_Init(SaveStateStore *store, void *mem, u32 maxChunks)
+{
+    u8 *p = (u8 *)mem;
+    u32 indexSize = SaveStateStore_GetIndexSize(maxChunks);
+
+    store->hashes = (u64 *)p;
+    p += ALIGN8(maxChunks * sizeof(u64));
+    store->offsets = (u32 *)p;
+    p += ALIGN8(maxChunks * sizeof(u32));
+    store->storedSizes = (u16 *)p;
+    p += ALIGN8(maxChunks * sizeof(u16));
+    store->index = (u16 *)p;
+
+    memset(store->index, 0, indexSize * sizeof(u16));
+    store->indexMask = indexSize - 1;
+    store->numChunks = 0;
+    // Chunk indices + 1 are stored as u16
+    store->maxChunks = maxChunks > 0xFFFF ? 0xFFFF : maxChunks;
+}
+
+bool SaveStateStore_IsZeroPage(const void *page)
+{
+    const u32 *words = (const u32 *)page;
+
+    for (u32 i = 0; i < SAVESTATE_PAGE_SIZE / 4; i += 4)
+    {
+        if ((words[i] | words[i + 1] | words[i + 2] | words[i + 3]) != 0)
+            return false;
+    }
+
+    return true;
+}
+
+u64 SaveStateStore_HashPage(const void *page)
+{
+    const u32 *words = (const u32 *)page;
+    u64 h = FNV64_OFFSET_BASIS;
+
+    for (u32 i = 0; i < SAVESTATE_PAGE_SIZE / 4; i++)
+        h = (h ^ words[i]) * FNV64_PRIME;
+
+    h ^= h >> 33;
+    h *= 0xFF51AFD7ED558CCDULL;
+    h ^= h >> 33;
+
+    // Reserved for zero pages, which are never hashed
+    return h == SAVESTATE_ZERO_PAGE_HASH ? 1 : h;
+}
+
+u32 SaveStateStore_Find(const SaveStateStore *store, u64 hash)
+{
+    for (u32 slot = (u32)hash & store->indexMask; store->index[slot] != 0; slot = (slot + 1) & store->indexMask)
+    {
+        u32 idx = store->index[slot] - 1;
+        if (store->hashes[idx] == hash)
+            return idx;
+    }
+
+    return SAVESTATE_REF_NEW;
+}
+
+u32 SaveStateStore_LookupPage(const SaveStateStore *store, const void *page, const u64 *baseHash, u64 *outHash)
+{
+    if (SaveStateStore_IsZeroPage(page))
+    {
+        *outHash = SAVESTATE_ZERO_PAGE_HASH;
+        return SAVESTATE_REF_ZERO;
+    }
+
+    *outHash = SaveStateStore_HashPage(page);
+    if (baseHash != NULL && *baseHash == *outHash)
+        return SAVESTATE_REF_BASE;
+
+    return SaveStateStore_Find(store, *outHash);
+}
+
+u32 SaveStateStore_AddChunk(SaveStateStore *store, u64 hash, u32 offset, u32 storedSize)
+{
+    if (store->numChunks >= store->maxChunks)
+        return SAVESTATE_REF_NEW;
+
+    u32 idx = store->numChunks++;
+    u32 slot = (u32)hash & store->indexMask;
+
+    while (store->index[slot] != 0)
+        slot = (slot + 1) & store->indexMask;
+
+    store->hashes[idx] = hash;
+    store->offsets[idx] = offset;
+    store->storedSizes[idx] = (u16)storedSize;
+    store->index[slot] = (u16)(idx + 1);
+
+    return idx;
+}
+
+void SaveStateStore_MatchBasePages(u32 *basePages, const SaveStateRegion *regions, u32 numRegions, const SaveStateRegion *baseRegions, u32 numBaseRegions)
+{
+    u32 p = 0, b = 0, baseFirstPage = 0;
+
+    for (u32 i = 0; i < numRegions; i++)
+    {
+        for (u32 off = 0; off < regions[i].size; off += SAVESTATE_PAGE_SIZE, p++)
+        {
+            u32 addr = regions[i].addr + off;
+
+            while (b < numBaseRegions && baseRegions[b].addr + baseRegions[b].size <= addr)
+            {
+                baseFirstPage += baseRegions[b].size / SAVESTATE_PAGE_SIZE;
+                b++;
+            }
+
+            if (b < numBaseRegions && addr >= baseRegions[b].addr)
+                basePages[p] = baseFirstPage + (addr - baseRegions[b].addr) / SAVESTATE_PAGE_SIZE;
+            else
+                basePages[p] = SAVESTATE_NO_BASE_PAGE;
+        }
+    }
+}
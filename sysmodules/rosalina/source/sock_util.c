@@ -41,6 +41,8 @@ static void compact(struct sock_server *serv)
     for(nfds_t i = 0; i < n; i++)
     {
         serv->poll_fds[i].fd = new_fds[i];
+        serv->poll_fds[i].events = POLLIN;
+        serv->poll_fds[i].revents = 0;
         serv->ctx_ptrs[i] = new_ctxs[i];
         serv->ctx_ptrs[i]->i = i;
     }
@@ -59,6 +61,17 @@ static struct sock_ctx *server_alloc_server_ctx(struct sock_server *serv)
     return NULL;
 }
 
+static void server_add_ctx_stats(sock_ctx_stats *dst, const sock_ctx_stats *src)
+{
+    dst->bytes_received += src->bytes_received;
+    dst->bytes_sent += src->bytes_sent;
+    dst->drops += src->drops;
+    dst->nb_callbacks += src->nb_callbacks;
+    dst->total_latency += src->total_latency;
+    if(src->max_latency > dst->max_latency)
+        dst->max_latency = src->max_latency;
+}
+
 static void server_close_ctx(struct sock_server *serv, struct sock_ctx *ctx)
 {
     serv->compact_needed = true;
@@ -67,6 +80,17 @@ static void server_close_ctx(struct sock_server *serv, struct sock_ctx *ctx)
     if(ctx->type == SOCK_CLIENT)
     {
         serv->close_cb(ctx);
+
+        LightLock_Lock(&ctx->send_lock);
+        if(ctx->send_size != 0)
+            ctx->stats.drops++; // whatever was still queued is lost
+        ctx->send_size = 0;
+        LightLock_Unlock(&ctx->send_lock);
+
+        server_add_ctx_stats(&serv->stats.clients, &ctx->stats);
+        serv->stats.closed++;
+        serv->nclients--;
+
         serv->free(serv, ctx);
         ctx->serv->n--;
     }
@@ -82,6 +106,110 @@ static void server_close_ctx(struct sock_server *serv, struct sock_ctx *ctx)
     serv->ctx_ptrs[ctx->i] = NULL;
 }
 
+// send_lock must be held
+static void server_queue_append(struct sock_ctx *ctx, const u8 *buf, u32 len)
+{
+    u32 tail = (ctx->send_head + ctx->send_size) % ctx->send_queue_size;
+    u32 part = ctx->send_queue_size - tail;
+
+    if(part > len)
+        part = len;
+    memcpy(ctx->send_queue + tail, buf, part);
+    memcpy(ctx->send_queue, buf + part, len - part);
+    ctx->send_size += len;
+}
+
+// send_lock must be held. minisoc doesn't report errno, so failures are handled like EWOULDBLOCK: broken
+// connections are reported by poll
+static void server_queue_flush(struct sock_ctx *ctx)
+{
+    while(ctx->send_size != 0)
+    {
+        u32 part = ctx->send_queue_size - ctx->send_head;
+        if(part > ctx->send_size)
+            part = ctx->send_size;
+
+        int r = socSend(ctx->sockfd, ctx->send_queue + ctx->send_head, part, MSG_DONTWAIT);
+        if(r <= 0)
+            break;
+
+        ctx->stats.bytes_sent += r;
+        ctx->send_head = (ctx->send_head + r) % ctx->send_queue_size;
+        ctx->send_size -= r;
+    }
+
+    if(ctx->send_size == 0)
+        ctx->send_head = 0;
+}
+
+ssize_t server_send(struct sock_ctx *ctx, const void *buf, size_t len)
+{
+    if(ctx->send_queue == NULL)
+    {
+        ssize_t r = socSend(ctx->sockfd, buf, len, 0);
+        if(r > 0)
+            ctx->stats.bytes_sent += r;
+        return r;
+    }
+
+    const u8 *data = (const u8 *)buf;
+    ssize_t ret = (ssize_t)len;
+
+    LightLock_Lock(&ctx->send_lock);
+
+    // Don't let the message overtake the queued data
+    u32 sent = 0;
+    if(ctx->send_size == 0)
+    {
+        int r = socSend(ctx->sockfd, data, len, MSG_DONTWAIT);
+        sent = r > 0 ? (u32)r : 0;
+        ctx->stats.bytes_sent += sent;
+    }
+
+    if(sent < len)
+    {
+        // Partial messages are never dropped, the peer would get garbage
+        if(len - sent <= ctx->send_queue_size - ctx->send_size)
+            server_queue_append(ctx, data + sent, len - sent);
+        else if(sent == 0)
+        {
+            ctx->stats.drops++;
+            ret = -1;
+        }
+        else
+        {
+            // Doesn't fit, the stream is broken
+            ctx->stats.drops++;
+            ctx->should_close = true;
+            ret = -1;
+        }
+    }
+
+    LightLock_Unlock(&ctx->send_lock);
+    return ret;
+}
+
+ssize_t server_recv(struct sock_ctx *ctx, void *buf, size_t len, int flags)
+{
+    ssize_t r = socRecv(ctx->sockfd, buf, len, flags);
+    if(r > 0 && !(flags & MSG_PEEK))
+        ctx->stats.bytes_received += r;
+    return r;
+}
+
+void server_get_stats(struct sock_server *serv, sock_server_stats *out)
+{
+    // Not synchronized with the server thread, the figures of the current connections may be slightly off
+    memcpy(out, &serv->stats, sizeof(sock_server_stats));
+
+    for(nfds_t i = 0; i < MAX_CTXS; i++)
+    {
+        struct sock_ctx *ctx = serv->ctx_ptrs[i];
+        if(ctx != NULL && ctx->type == SOCK_CLIENT)
+            server_add_ctx_stats(&out->clients, &ctx->stats);
+    }
+}
+
 Result server_init(struct sock_server *serv)
 {
     Result ret = 0;
@@ -168,6 +296,86 @@ static bool server_should_exit(struct sock_server *serv)
     return svcWaitSynchronization(serv->shall_terminate_event, 0) == 0 || svcWaitSynchronization(preTerminationEvent, 0) == 0;
 }
 
+static void server_accept(struct sock_server *serv, struct sock_ctx *curr_ctx)
+{
+    struct pollfd *fds = serv->poll_fds;
+    struct sockaddr_in saddr;
+    socklen_t len = sizeof(struct sockaddr_in);
+    int client_sockfd = socAccept(curr_ctx->sockfd, (struct sockaddr *)&saddr, &len);
+
+    if(client_sockfd < 0)
+        return;
+
+    int max_clients = serv->max_clients > 0 && serv->max_clients < MAX_CTXS ? serv->max_clients : MAX_CTXS;
+    if(curr_ctx->n == serv->clients_per_server || serv->nclients >= max_clients || serv->nfds == MAX_CTXS)
+    {
+        serv->stats.rejected++;
+        socClose(client_sockfd);
+        return;
+    }
+
+    struct sock_ctx *new_ctx = serv->alloc(serv, ntohs(curr_ctx->addr_in.sin_port));
+    if(new_ctx == NULL)
+    {
+        serv->stats.rejected++;
+        socClose(client_sockfd);
+        return;
+    }
+
+    fds[serv->nfds].fd = client_sockfd;
+    fds[serv->nfds].events = POLLIN;
+    fds[serv->nfds].revents = 0;
+
+    int new_idx = serv->nfds;
+    serv->nfds++;
+    curr_ctx->n++;
+    serv->nclients++;
+    serv->stats.accepted++;
+
+    new_ctx->type = SOCK_CLIENT;
+    new_ctx->sockfd = client_sockfd;
+    new_ctx->serv = curr_ctx;
+    new_ctx->i = new_idx;
+    new_ctx->n = 0;
+    new_ctx->should_close = false;
+    new_ctx->ready = false;
+    new_ctx->revents = 0;
+    new_ctx->send_head = 0;
+    new_ctx->send_size = 0;
+    LightLock_Init(&new_ctx->send_lock);
+    memset(&new_ctx->stats, 0, sizeof(sock_ctx_stats));
+    memcpy(&new_ctx->addr_in, &saddr, sizeof(struct sockaddr_in));
+
+    serv->ctx_ptrs[new_idx] = new_ctx;
+
+    if(serv->accept_cb(new_ctx) == -1)
+        server_close_ctx(serv, new_ctx);
+}
+
+static void server_handle_client(struct sock_server *serv, struct sock_ctx *ctx, u64 pollTick)
+{
+    if(ctx->revents & POLLOUT)
+    {
+        LightLock_Lock(&ctx->send_lock);
+        server_queue_flush(ctx);
+        LightLock_Unlock(&ctx->send_lock);
+    }
+
+    if(ctx->revents & POLLIN)
+    {
+        int r = serv->data_cb(ctx);
+
+        u64 latency = svcGetSystemTick() - pollTick;
+        ctx->stats.nb_callbacks++;
+        ctx->stats.total_latency += latency;
+        if(latency > ctx->stats.max_latency)
+            ctx->stats.max_latency = latency;
+
+        if(r == -1)
+            ctx->should_close = true;
+    }
+}
+
 void server_run(struct sock_server *serv)
 {
     struct pollfd *fds = serv->poll_fds;
@@ -179,6 +387,16 @@ void server_run(struct sock_server *serv)
         if(server_should_exit(serv))
             goto abort_connections;
 
+        // Closing requests from other threads (and from the previous iteration)
+        for(nfds_t i = 0; i < serv->nfds; i++)
+        {
+            if(serv->ctx_ptrs[i] != NULL && serv->ctx_ptrs[i]->should_close)
+                server_close_ctx(serv, serv->ctx_ptrs[i]);
+        }
+
+        if(serv->compact_needed)
+            compact(serv);
+
         if(serv->nfds == 0)
         {
             svcSleepThread(12 * 1000 * 1000LL);
@@ -186,8 +404,21 @@ void server_run(struct sock_server *serv)
         }
 
         for(nfds_t i = 0; i < serv->nfds; i++)
+        {
+            struct sock_ctx *ctx = serv->ctx_ptrs[i];
+            fds[i].events = POLLIN;
             fds[i].revents = 0;
 
+            // Only wait for writability when there's something to write, otherwise poll would always return
+            if(ctx->type == SOCK_CLIENT && ctx->send_queue != NULL)
+            {
+                LightLock_Lock(&ctx->send_lock);
+                if(ctx->send_size != 0)
+                    fds[i].events |= POLLOUT;
+                LightLock_Unlock(&ctx->send_lock);
+            }
+        }
+
         if (Sleep__Status())
         {
             while (!Wifi__IsConnected()
@@ -195,70 +426,49 @@ void server_run(struct sock_server *serv)
                 svcSleepThread(1000000000ULL);
         }
 
-        int pollres = socPoll(fds, serv->nfds, 50);
+        int pollres = socPoll(fds, serv->nfds, SERVER_POLL_TIMEOUT_MS);
+        u64 pollTick = svcGetSystemTick();
 
         if(server_should_exit(serv) || pollres < -10000)
             goto abort_connections;
 
+        // Only the contexts poll reported are visited, each once
+        serv->nready = 0;
         for(nfds_t i = 0; pollres > 0 && i < serv->nfds; i++)
         {
-            struct sock_ctx *curr_ctx = serv->ctx_ptrs[i];
+            struct sock_ctx *ctx = serv->ctx_ptrs[i];
+            if(fds[i].revents == 0)
+                continue;
 
-            if((fds[i].revents & (POLLHUP | POLLERR | POLLNVAL)) || curr_ctx->should_close)
-                server_close_ctx(serv, curr_ctx);
+            ctx->ready = true;
+            ctx->revents = fds[i].revents;
+            serv->ready_list[serv->nready++] = ctx;
+        }
 
-            else if(fds[i].revents & POLLIN)
+        for(nfds_t i = 0; i < serv->nready; i++)
+        {
+            struct sock_ctx *ctx = serv->ready_list[i];
+            ctx->ready = false;
+
+            if(ctx->type == SOCK_NONE) // closed by an earlier callback
+                continue;
+            else if((ctx->revents & (POLLHUP | POLLERR | POLLNVAL)) || ctx->should_close)
+                server_close_ctx(serv, ctx);
+            else if(ctx->type == SOCK_SERVER)
+            {
+                if(ctx->revents & POLLIN)
+                    server_accept(serv, ctx);
+                if(server_should_exit(serv))
+                    goto abort_connections;
+            }
+            else
             {
-                if(curr_ctx->type == SOCK_SERVER) // Listening socket?
-                {
-                    struct sockaddr_in saddr;
-                    socklen_t len = sizeof(struct sockaddr_in);
-                    int client_sockfd = socAccept(fds[i].fd, (struct sockaddr *)&saddr, &len);
-
-                    if(server_should_exit(serv))
-                        goto abort_connections;
-
-                    if(client_sockfd < 0 || curr_ctx->n == serv->clients_per_server || serv->nfds == MAX_CTXS)
-                        socClose(client_sockfd);
-
-                    else
-                    {
-                        struct sock_ctx *new_ctx = serv->alloc(serv, ntohs(curr_ctx->addr_in.sin_port));
-                        if(new_ctx == NULL)
-                            socClose(client_sockfd);
-                        else
-                        {
-                            fds[serv->nfds].fd = client_sockfd;
-                            fds[serv->nfds].events = POLLIN;
-                            fds[serv->nfds].revents = 0;
-
-                            int new_idx = serv->nfds;
-                            serv->nfds++;
-                            curr_ctx->n++;
-
-                            new_ctx->type = SOCK_CLIENT;
-                            new_ctx->sockfd = client_sockfd;
-                            new_ctx->serv = curr_ctx;
-                            new_ctx->i = new_idx;
-                            new_ctx->n = 0;
-                            new_ctx->should_close = false;
-
-                            serv->ctx_ptrs[new_idx] = new_ctx;
-
-                            if(serv->accept_cb(new_ctx) == -1)
-                                server_close_ctx(serv, new_ctx);
-
-                            memcpy(&new_ctx->addr_in, &saddr, sizeof(struct sockaddr_in));
-                        }
-                    }
-                }
-                else
-                {
-                    if(serv->data_cb(curr_ctx) == -1)
-                        server_close_ctx(serv, curr_ctx);
-                }
+                server_handle_client(serv, ctx, pollTick);
+                if(ctx->should_close)
+                    server_close_ctx(serv, ctx);
             }
         }
+        serv->nready = 0;
 
         if(server_should_exit(serv))
             goto abort_connections;
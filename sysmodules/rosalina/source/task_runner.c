@@ -1,56 +1,240 @@
 #include <3ds.h>
 #include <string.h>
 #include "task_runner.h"
+#include "MyThread.h"
 
 TaskRunner g_taskRunner;
 
-static MyThread taskRunnerThread;
-static u8 CTR_ALIGN(8) taskRunnerThreadStack[0x1000];
+static MyThread taskRunnerThreads[TASK_RUNNER_NUM_WORKERS];
+static u8 CTR_ALIGN(8) taskRunnerThreadStacks[TASK_RUNNER_NUM_WORKERS][THREAD_STACK_SIZE];
 
-static void taskRunnerNoOpFunction(void *args)
+// Handles are (generation << 4) | (slot index + 1), 0 being invalid
+#define TASK_HANDLE_GEN_MASK    0x0FFFFFFFu
+
+static inline TaskHandle taskRunnerMakeHandle(u32 idx, u32 generation)
 {
-    (void)args;
+    return ((generation & TASK_HANDLE_GEN_MASK) << 4) | (idx + 1);
 }
 
-MyThread *taskRunnerCreateThread(void)
+void taskRunnerCreateThreads(void)
 {
     TaskRunner_Init();
-    MyThread_Create(&taskRunnerThread, TaskRunner_HandleTasks, taskRunnerThreadStack, THREAD_STACK_SIZE, 58, 1);
-    return &taskRunnerThread;
+    for (u32 i = 0; i < TASK_RUNNER_NUM_WORKERS; i++)
+        MyThread_Create(&taskRunnerThreads[i], TaskRunner_HandleTasks, taskRunnerThreadStacks[i], THREAD_STACK_SIZE, 58, 1);
+}
+
+void TaskRunner_JoinThreads(s64 timeout_ns)
+{
+    for (u32 i = 0; i < TASK_RUNNER_NUM_WORKERS; i++)
+        MyThread_Join(&taskRunnerThreads[i], timeout_ns);
 }
 
 void TaskRunner_Init(void)
 {
     memset(&g_taskRunner, 0, sizeof(TaskRunner));
-    LightEvent_Init(&g_taskRunner.readyEvent, RESET_ONESHOT);
-    LightEvent_Init(&g_taskRunner.parametersSetEvent, RESET_ONESHOT);
+    LightLock_Init(&g_taskRunner.lock);
+    LightSemaphore_Init(&g_taskRunner.pendingSem, 0, TASK_RUNNER_QUEUE_SIZE + TASK_RUNNER_NUM_WORKERS);
+    LightSemaphore_Init(&g_taskRunner.freeSem, TASK_RUNNER_QUEUE_SIZE, TASK_RUNNER_QUEUE_SIZE);
+    LightEvent_Init(&g_taskRunner.idleEvent, RESET_STICKY);
+    LightEvent_Signal(&g_taskRunner.idleEvent);
+
+    for (u32 i = 0; i < TASK_RUNNER_QUEUE_SIZE; i++)
+        LightEvent_Init(&g_taskRunner.slots[i].doneEvent, RESET_STICKY);
+}
+
+// Must be called with a free slot reserved (freeSem acquired)
+static TaskHandle taskRunnerEnqueue(void (*task)(void *argdata), const void *argdata, size_t argsize, TaskPriority priority, bool serial)
+{
+    TaskHandle handle = TASK_HANDLE_INVALID;
+    argsize = argsize > TASK_RUNNER_ARG_SIZE ? TASK_RUNNER_ARG_SIZE : argsize;
+    priority = priority >= TASK_PRIORITY_COUNT ? TASK_PRIORITY_LOW : priority;
+
+    LightLock_Lock(&g_taskRunner.lock);
+    for (u32 i = 0; i < TASK_RUNNER_QUEUE_SIZE; i++)
+    {
+        TaskSlot *slot = &g_taskRunner.slots[i];
+        if (slot->state != TASK_STATE_FREE)
+            continue;
+
+        slot->task = task;
+        if (argsize != 0)
+            memcpy(slot->argStorage, argdata, argsize);
+        slot->state = TASK_STATE_PENDING;
+        slot->priority = priority;
+        slot->serial = serial;
+        slot->generation++;
+        slot->sequence = g_taskRunner.nextSequence++;
+        slot->submitTick = svcGetSystemTick();
+        LightEvent_Clear(&slot->doneEvent);
+
+        if (g_taskRunner.numActive++ == 0)
+            LightEvent_Clear(&g_taskRunner.idleEvent);
+
+        g_taskRunner.stats.submitted++;
+        if (g_taskRunner.numActive > g_taskRunner.stats.maxQueueDepth)
+            g_taskRunner.stats.maxQueueDepth = g_taskRunner.numActive;
+
+        handle = taskRunnerMakeHandle(i, slot->generation);
+        break;
+    }
+    LightLock_Unlock(&g_taskRunner.lock);
+
+    // Can't fail, a slot has been reserved by the caller
+    LightSemaphore_Release(&g_taskRunner.pendingSem, 1);
+    return handle;
 }
 
 void TaskRunner_RunTask(void (*task)(void *argdata), void *argdata, size_t argsize)
 {
-    argsize = argsize > sizeof(g_taskRunner.argStorage) ? sizeof(g_taskRunner.argStorage) : argsize;
-    LightEvent_Wait(&g_taskRunner.readyEvent);
-    g_taskRunner.task = task;
-    memcpy(g_taskRunner.argStorage, argdata, argsize);
-    LightEvent_Signal(&g_taskRunner.parametersSetEvent);
+    LightSemaphore_Acquire(&g_taskRunner.freeSem, 1);
+    taskRunnerEnqueue(task, argdata, argsize, TASK_PRIORITY_NORMAL, true);
+}
+
+TaskHandle TaskRunner_SubmitTask(void (*task)(void *argdata), const void *argdata, size_t argsize, TaskPriority priority)
+{
+    if (LightSemaphore_TryAcquire(&g_taskRunner.freeSem, 1) != 0)
+    {
+        LightLock_Lock(&g_taskRunner.lock);
+        g_taskRunner.stats.rejected++;
+        LightLock_Unlock(&g_taskRunner.lock);
+        return TASK_HANDLE_INVALID;
+    }
+
+    return taskRunnerEnqueue(task, argdata, argsize, priority, false);
+}
+
+bool TaskRunner_WaitTask(TaskHandle handle, s64 timeout_ns)
+{
+    u32 idx = (handle & 0xF) - 1;
+    u32 generation = handle >> 4;
+
+    if (handle == TASK_HANDLE_INVALID || idx >= TASK_RUNNER_QUEUE_SIZE)
+        return true;
+
+    TaskSlot *slot = &g_taskRunner.slots[idx];
+    for (;;)
+    {
+        // The slot is released as soon as the task completes and may already have been reused
+        LightLock_Lock(&g_taskRunner.lock);
+        bool done = (slot->generation & TASK_HANDLE_GEN_MASK) != generation || slot->state == TASK_STATE_FREE;
+        LightLock_Unlock(&g_taskRunner.lock);
+
+        if (done)
+            return true;
+
+        if (timeout_ns < 0)
+            LightEvent_Wait(&slot->doneEvent);
+        else if (LightEvent_WaitTimeout(&slot->doneEvent, timeout_ns) != 0)
+            return false;
+    }
+}
+
+void TaskRunner_GetStats(TaskRunnerStats *out)
+{
+    LightLock_Lock(&g_taskRunner.lock);
+    *out = g_taskRunner.stats;
+    LightLock_Unlock(&g_taskRunner.lock);
 }
 
 void TaskRunner_Terminate(void)
 {
+    LightLock_Lock(&g_taskRunner.lock);
     g_taskRunner.shouldTerminate = true;
-    TaskRunner_RunTask(taskRunnerNoOpFunction, NULL, 0);
+    LightLock_Unlock(&g_taskRunner.lock);
+
+    // Wake up every worker; pending tasks are still run before exiting
+    LightSemaphore_Release(&g_taskRunner.pendingSem, TASK_RUNNER_NUM_WORKERS);
+}
+
+// Sets *serialBlocked if a serial task is waiting for the running one
+static TaskSlot *taskRunnerPickNextTask(bool *serialBlocked)
+{
+    TaskSlot *best = NULL;
+    *serialBlocked = false;
+    for (u32 i = 0; i < TASK_RUNNER_QUEUE_SIZE; i++)
+    {
+        TaskSlot *slot = &g_taskRunner.slots[i];
+        if (slot->state != TASK_STATE_PENDING)
+            continue;
+
+        if (slot->serial && g_taskRunner.serialRunning)
+        {
+            *serialBlocked = true;
+            continue;
+        }
+
+        // Highest priority first, then FIFO (sequence numbers may wrap)
+        if (best == NULL || slot->priority < best->priority ||
+            (slot->priority == best->priority && (s32)(slot->sequence - best->sequence) < 0))
+            best = slot;
+    }
+
+    return best;
 }
 
 void TaskRunner_HandleTasks(void)
 {
-    while (!g_taskRunner.shouldTerminate) {
-        LightEvent_Signal(&g_taskRunner.readyEvent);
-        LightEvent_Wait(&g_taskRunner.parametersSetEvent);
-        g_taskRunner.task(g_taskRunner.argStorage);
+    for (;;)
+    {
+        LightSemaphore_Acquire(&g_taskRunner.pendingSem, 1);
+
+        LightLock_Lock(&g_taskRunner.lock);
+        bool serialBlocked;
+        TaskSlot *slot = taskRunnerPickNextTask(&serialBlocked);
+        if (slot == NULL)
+        {
+            // The wakeup is given back when the running serial task completes
+            if (serialBlocked)
+                g_taskRunner.numDeferredWakeups++;
+            bool terminate = g_taskRunner.shouldTerminate && !serialBlocked;
+            LightLock_Unlock(&g_taskRunner.lock);
+            if (terminate)
+                break;
+            continue;
+        }
+
+        if (slot->serial)
+            g_taskRunner.serialRunning = true;
+        slot->state = TASK_STATE_RUNNING;
+        slot->startTick = svcGetSystemTick();
+        LightLock_Unlock(&g_taskRunner.lock);
+
+        slot->task(slot->argStorage);
+
+        u64 endTick = svcGetSystemTick();
+        u64 waitTicks = slot->startTick - slot->submitTick;
+        u64 runTicks = endTick - slot->startTick;
+
+        LightLock_Lock(&g_taskRunner.lock);
+        TaskRunnerStats *stats = &g_taskRunner.stats;
+        stats->completed++;
+        stats->totalWaitTicks += waitTicks;
+        stats->totalRunTicks += runTicks;
+        stats->maxWaitTicks = waitTicks > stats->maxWaitTicks ? waitTicks : stats->maxWaitTicks;
+        stats->maxRunTicks = runTicks > stats->maxRunTicks ? runTicks : stats->maxRunTicks;
+
+        u32 numWakeups = 0;
+        if (slot->serial)
+        {
+            g_taskRunner.serialRunning = false;
+            numWakeups = g_taskRunner.numDeferredWakeups;
+            g_taskRunner.numDeferredWakeups = 0;
+        }
+
+        // The slot is given back before waiters are woken up, so that they can queue a task right away
+        slot->state = TASK_STATE_FREE;
+        LightSemaphore_Release(&g_taskRunner.freeSem, 1);
+        LightEvent_Signal(&slot->doneEvent);
+        if (--g_taskRunner.numActive == 0)
+            LightEvent_Signal(&g_taskRunner.idleEvent);
+        LightLock_Unlock(&g_taskRunner.lock);
+
+        if (numWakeups != 0)
+            LightSemaphore_Release(&g_taskRunner.pendingSem, numWakeups);
     }
 }
 
 void TaskRunner_WaitReady(void)
 {
-    LightEvent_Wait(&g_taskRunner.readyEvent);
+    LightEvent_Wait(&g_taskRunner.idleEvent);
 }
@@ -0,0 +1,137 @@
+/*
+*   This file is part of Luma3DS
+*   Copyright (C) 2016-2022 Aurora Wright, TuxSH
+*
+*   This program is free software: you can redistribute it and/or modify
+*   it under the terms of the GNU General Public License as published by
+*   the Free Software Foundation, either version 3 of the License, or
+*   (at your option) any later version.
+*
+*   This program is distributed in the hope that it will be useful,
+*   but WITHOUT ANY WARRANTY; without even the implied warranty of
+*   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*   GNU General Public License for more details.
+*
+*   You should have received a copy of the GNU General Public License
+*   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*
+*   Additional Terms 7.b and 7.c of GPLv3 apply to this file:
+*       * Requiring preservation of specified reasonable legal notices or
+*         author attributions in that material or in the Appropriate Legal
+*         Notices displayed by works containing it.
+*       * Prohibiting misrepresentation of the origin of that material,
+*         or requiring that modified versions of such material be marked in
+*         reasonable ways as different from the original version.
+*/
+
+#include <3ds.h>
+#include <string.h>
+#include "title_settings.h"
+#include "ifile.h"
+
+static struct
+{
+    LumaTitleSettingsHeader header;
+    LumaTitleSettings records[LUMA_TITLE_SETTINGS_MAX];
+} titleSettingsFile;
+
+bool TitleSettings_Get(u64 titleId, LumaTitleSettings *out)
+{
+    const volatile LumaTitleSettings *settings = lumaFindTitleSettings(titleId);
+
+    if (settings == NULL)
+        return false;
+
+    memcpy(out, (const void *)settings, sizeof(LumaTitleSettings));
+    return true;
+}
+
+static Result TitleSettings_Write(u32 numRecords)
+{
+    IFile file;
+    FS_Archive archive;
+    FS_ArchiveID archiveId;
+    s64 out;
+    u64 total;
+    Result res;
+    u32 size = sizeof(LumaTitleSettingsHeader) + numRecords * sizeof(LumaTitleSettings);
+
+    if (R_FAILED(svcGetSystemInfo(&out, 0x10000, 0x203)))
+        svcBreak(USERBREAK_ASSERT);
+
+    archiveId = (bool)out ? ARCHIVE_SDMC : ARCHIVE_NAND_RW;
+
+    res = FSUSER_OpenArchive(&archive, archiveId, fsMakePath(PATH_EMPTY, ""));
+    if (R_FAILED(res))
+        return res;
+
+    // Write the new file completely before replacing the old one: Loader falls back to it if the old one is gone
+    FSUSER_DeleteFile(archive, fsMakePath(PATH_ASCII, LUMA_TITLE_SETTINGS_TMP_PATH));
+    res = IFile_OpenFromArchive(&file, archive, fsMakePath(PATH_ASCII, LUMA_TITLE_SETTINGS_TMP_PATH), FS_OPEN_CREATE | FS_OPEN_WRITE);
+    if (R_SUCCEEDED(res))
+    {
+        res = IFile_Write(&file, &total, &titleSettingsFile, size, FS_WRITE_FLUSH);
+        IFile_Close(&file);
+    }
+
+    if (R_SUCCEEDED(res))
+    {
+        FSUSER_DeleteFile(archive, fsMakePath(PATH_ASCII, LUMA_TITLE_SETTINGS_PATH));
+        res = FSUSER_RenameFile(archive, fsMakePath(PATH_ASCII, LUMA_TITLE_SETTINGS_TMP_PATH),
+                                archive, fsMakePath(PATH_ASCII, LUMA_TITLE_SETTINGS_PATH));
+    }
+
+    FSUSER_CloseArchive(archive);
+    return res;
+}
+
+Result TitleSettings_Set(const LumaTitleSettings *settings)
+{
+    // Writing before Loader has read the file (or migrated the legacy ones) would lose records
+    if (!Luma_SharedConfig->title_settings_loaded)
+        return MAKERESULT(RL_PERMANENT, RS_INVALIDSTATE, RM_APPLICATION, RD_NOT_INITIALIZED);
+
+    u32 numRecords = Luma_SharedConfig->num_title_settings;
+    if (numRecords > LUMA_TITLE_SETTINGS_MAX)
+        numRecords = 0;
+
+    LumaTitleSettings *records = titleSettingsFile.records;
+    memcpy(records, (const void *)Luma_SharedConfig->title_settings, numRecords * sizeof(LumaTitleSettings));
+
+    u32 pos;
+    for (pos = 0; pos < numRecords && records[pos].title_id < settings->title_id; pos++);
+    bool found = pos < numRecords && records[pos].title_id == settings->title_id;
+
+    if (settings->flags == 0)
+    {
+        if (!found)
+            return 0;
+
+        memmove(&records[pos], &records[pos + 1], (numRecords - pos - 1) * sizeof(LumaTitleSettings));
+        numRecords--;
+    }
+    else if (found)
+        records[pos] = *settings;
+    else
+    {
+        if (numRecords == LUMA_TITLE_SETTINGS_MAX)
+            return MAKERESULT(RL_PERMANENT, RS_OUTOFRESOURCE, RM_APPLICATION, RD_OUT_OF_RANGE);
+
+        memmove(&records[pos + 1], &records[pos], (numRecords - pos) * sizeof(LumaTitleSettings));
+        records[pos] = *settings;
+        numRecords++;
+    }
+
+    titleSettingsFile.header.magic = LUMA_TITLE_SETTINGS_MAGIC;
+    titleSettingsFile.header.version = LUMA_TITLE_SETTINGS_VERSION;
+    titleSettingsFile.header.num_records = (u16)numRecords;
+
+    Result res = TitleSettings_Write(numRecords);
+    if (R_FAILED(res))
+        return res;
+
+    memcpy((void *)Luma_SharedConfig->title_settings, records, numRecords * sizeof(LumaTitleSettings));
+    Luma_SharedConfig->num_title_settings = numRecords;
+
+    return 0;
+}
@@ -0,0 +1,25 @@
+/*
+3ds.h (host build)
+
+(c) TuxSH, 2017-2020
+This is part of 3ds_sm, which is licensed under the MIT license (see LICENSE for details).
+*/
+
+#pragma once
+
+// Just what the notification code (notifications.c, processes.c, list.c) uses, see stubs.c
+
+#include <3ds/types.h>
+
+#define R_SUCCEEDED(res)            ((res) >= 0)
+#define R_FAILED(res)               ((res) < 0)
+
+#define GET_VERSION_MINOR(version)  (((version) >> 16) & 0xFF)
+
+u32 osGetKernelVersion(void);
+
+Result svcCreateSemaphore(Handle *semaphore, s32 initialCount, s32 maxCount);
+Result svcReleaseSemaphore(s32 *count, Handle semaphore, s32 releaseCount);
+Result svcCloseHandle(Handle handle);
+// Process handles are the process IDs
+Result svcGetProcessId(u32 *out, Handle handle);
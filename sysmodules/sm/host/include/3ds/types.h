@@ -0,0 +1,26 @@
+/*
+3ds/types.h (host build)
+
+(c) TuxSH, 2017-2020
+This is part of 3ds_sm, which is licensed under the MIT license (see LICENSE for details).
+*/
+
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+typedef uint8_t u8;
+typedef uint16_t u16;
+typedef uint32_t u32;
+typedef uint64_t u64;
+typedef int8_t s8;
+typedef int16_t s16;
+typedef int32_t s32;
+typedef int64_t s64;
+
+typedef s32 Result;
+typedef u32 Handle;
+
+#define CTR_ALIGN(m) __attribute__((aligned(m)))
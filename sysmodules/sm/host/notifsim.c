@@ -0,0 +1,252 @@
+/*
+notifsim.c (host build)
+
+(c) TuxSH, 2017-2020
+This is part of 3ds_sm, which is licensed under the MIT license (see LICENSE for details).
+*/
+
+/*
+Runs the notification code of sm (notifications.c, processes.c, list.c) against a scripted set of
+publishers and subscribers, one command per line (from a file or stdin, '#' starts a comment):
+
+    register PID                        unregister PID
+    enable PID                          subscribe PID ID            unsubscribe PID ID
+    publish ID [FLAGS]                  publish-get ID              (PublishToSubscriber, PublishAndGetSubscriber)
+    publish-process PID ID              publish-all ID              (srv:pm)
+    receive PID [COUNT]                 stats [PID]
+    repeat COUNT COMMAND...
+    expect-result RESULT COMMAND...     (the result of the command, e.g. 0xD8606408 for a full queue)
+    expect-receive PID [ID...]          (receives exactly these notifications, in this order)
+    expect-stats PID|all PENDING PUBLISHED COALESCED DROPPED
+
+e.g. a wake-up storm: "repeat 100 publish 0x214 1" then "stats". Failed expectations make the program exit
+with status 1; "make check" runs notifications.txt.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "../source/common.h"
+#include "../source/processes.h"
+#include "../source/notifications.h"
+#include "../source/list.h"
+
+void acquireNotificationSemaphore(Handle semaphore);
+
+static ProcessData processDataPool[64];
+static Handle notificationSemaphores[0x10000];
+static u32 lineNumber;
+static bool expectationFailed;
+
+static u32 parseNumber(char **tokens, u32 nbTokens, u32 idx, u32 defaultValue)
+{
+    if(idx >= nbTokens)
+        return defaultValue;
+
+    char *end;
+    u32 value = (u32)strtoul(tokens[idx], &end, 0);
+    if(*end != 0)
+    {
+        fprintf(stderr, "line %lu: invalid number \"%s\"\n", (unsigned long)lineNumber, tokens[idx]);
+        exit(1);
+    }
+
+    return value;
+}
+
+static void printStats(const char *name, u32 pid)
+{
+    NotificationStats stats;
+    u32 nbPending;
+    Result res = GetNotificationStats(&stats, &nbPending, pid);
+
+    if(R_FAILED(res))
+        printf("stats %s: 0x%08lX\n", name, (unsigned long)(u32)res);
+    else
+    {
+        printf("stats %s: pending %lu (queues of %u), high water %lu, published %lu, coalesced %lu, dropped %lu\n", name,
+            (unsigned long)nbPending, NOTIFICATION_QUEUE_SIZE, (unsigned long)stats.highWater, (unsigned long)stats.nbPublished,
+            (unsigned long)stats.nbCoalesced, (unsigned long)stats.nbDropped);
+    }
+}
+
+static void expect(bool condition, const char *what)
+{
+    if(!condition)
+    {
+        printf("line %lu: FAILED: %s\n", (unsigned long)lineNumber, what);
+        expectationFailed = true;
+    }
+}
+
+static void expectReceive(char **tokens, u32 nbTokens)
+{
+    SessionData session = { .pid = parseNumber(tokens, nbTokens, 1, 0) };
+    char what[64];
+
+    for(u32 i = 2; i <= nbTokens; i++)
+    {
+        u32 notificationId = 0;
+        acquireNotificationSemaphore(notificationSemaphores[session.pid & 0xFFFF]);
+        Result res = ReceiveNotification(&session, &notificationId);
+
+        if(i == nbTokens)
+            expect(R_FAILED(res), "more notifications pending");
+        else
+        {
+            sprintf(what, "received 0x%lX (result 0x%08lX) instead of %s", (unsigned long)notificationId, (unsigned long)(u32)res, tokens[i]);
+            expect(R_SUCCEEDED(res) && notificationId == parseNumber(tokens, nbTokens, i, 0), what);
+        }
+    }
+}
+
+static void expectStats(char **tokens, u32 nbTokens)
+{
+    NotificationStats stats;
+    u32 nbPending;
+    Result res = GetNotificationStats(&stats, &nbPending, strcmp(tokens[1], "all") == 0 ? 0xFFFFFFFF : parseNumber(tokens, nbTokens, 1, 0));
+
+    expect(R_SUCCEEDED(res), "no stats");
+    expect(nbPending == parseNumber(tokens, nbTokens, 2, 0), "pending");
+    expect(stats.nbPublished == parseNumber(tokens, nbTokens, 3, 0), "published");
+    expect(stats.nbCoalesced == parseNumber(tokens, nbTokens, 4, 0), "coalesced");
+    expect(stats.nbDropped == parseNumber(tokens, nbTokens, 5, 0), "dropped");
+}
+
+static Result runCommand(char **tokens, u32 nbTokens, bool quiet)
+{
+    const char *cmd = tokens[0];
+    SessionData session = { .pid = parseNumber(tokens, nbTokens, 1, 0) };
+    Result res = 0;
+
+    if(strcmp(cmd, "repeat") == 0 && nbTokens > 2)
+    {
+        u32 count = parseNumber(tokens, nbTokens, 1, 0);
+        for(u32 i = 0; i < count; i++)
+            res = runCommand(tokens + 2, nbTokens - 2, true);
+        printf("repeat %lu %s: done\n", (unsigned long)count, tokens[2]);
+        return res;
+    }
+    else if(strcmp(cmd, "expect-result") == 0 && nbTokens > 2)
+    {
+        u32 expected = parseNumber(tokens, nbTokens, 1, 0);
+        res = runCommand(tokens + 2, nbTokens - 2, true);
+        char what[64];
+        sprintf(what, "%s returned 0x%08lX, expected 0x%08lX", tokens[2], (unsigned long)(u32)res, (unsigned long)expected);
+        expect((u32)res == expected, what);
+        return res;
+    }
+
+    else if(strcmp(cmd, "register") == 0 && nbTokens == 2)
+        res = RegisterProcess(session.pid, NULL, 0);
+    else if(strcmp(cmd, "unregister") == 0 && nbTokens == 2)
+        res = UnregisterProcess(session.pid);
+    else if(strcmp(cmd, "enable") == 0 && nbTokens == 2)
+        res = EnableNotification(&session, &notificationSemaphores[session.pid & 0xFFFF]);
+    else if(strcmp(cmd, "subscribe") == 0 && nbTokens == 3)
+        res = Subscribe(&session, parseNumber(tokens, nbTokens, 2, 0));
+    else if(strcmp(cmd, "unsubscribe") == 0 && nbTokens == 3)
+        res = Unsubscribe(&session, parseNumber(tokens, nbTokens, 2, 0));
+    else if(strcmp(cmd, "publish") == 0 && (nbTokens == 2 || nbTokens == 3))
+        res = PublishToSubscriber(parseNumber(tokens, nbTokens, 1, 0), parseNumber(tokens, nbTokens, 2, 0));
+    else if(strcmp(cmd, "publish-get") == 0 && nbTokens == 2)
+    {
+        u32 pidCount, pidList[60];
+        res = PublishAndGetSubscriber(&pidCount, pidList, parseNumber(tokens, nbTokens, 1, 0), 0);
+        if(!quiet && R_SUCCEEDED(res))
+        {
+            printf("publish-get %s: subscribers", tokens[1]);
+            for(u32 i = 0; i < pidCount; i++)
+                printf(" %lu", (unsigned long)pidList[i]);
+            printf("\n");
+            return res;
+        }
+    }
+    else if(strcmp(cmd, "publish-process") == 0 && nbTokens == 3)
+        res = PublishToProcess((Handle)session.pid, parseNumber(tokens, nbTokens, 2, 0));
+    else if(strcmp(cmd, "publish-all") == 0 && nbTokens == 2)
+        res = PublishToAll(parseNumber(tokens, nbTokens, 1, 0));
+    else if(strcmp(cmd, "receive") == 0 && (nbTokens == 2 || nbTokens == 3))
+    {
+        u32 count = parseNumber(tokens, nbTokens, 2, 1);
+        if(!quiet)
+            printf("receive %lu:", (unsigned long)session.pid);
+        for(u32 i = 0; i < count; i++)
+        {
+            u32 notificationId = 0;
+            acquireNotificationSemaphore(notificationSemaphores[session.pid & 0xFFFF]);
+            res = ReceiveNotification(&session, &notificationId);
+            if(R_FAILED(res))
+                break;
+            else if(!quiet)
+                printf(" 0x%lX", (unsigned long)notificationId);
+        }
+        if(!quiet)
+            printf(R_FAILED(res) ? " (none pending)\n" : "\n");
+        return res;
+    }
+    else if(strcmp(cmd, "stats") == 0 && nbTokens <= 2)
+    {
+        if(nbTokens == 1)
+            printStats("all", 0xFFFFFFFF);
+        else
+            printStats(tokens[1], session.pid);
+        return 0;
+    }
+    else
+    {
+        fprintf(stderr, "line %lu: invalid command \"%s\"\n", (unsigned long)lineNumber, cmd);
+        exit(1);
+    }
+
+    if(!quiet || R_FAILED(res))
+    {
+        for(u32 i = 0; i < nbTokens; i++)
+            printf("%s%s", tokens[i], i + 1 < nbTokens ? " " : "");
+        printf(": 0x%08lX\n", (unsigned long)(u32)res);
+    }
+
+    return res;
+}
+
+int main(int argc, char *argv[])
+{
+    FILE *script = argc > 1 ? fopen(argv[1], "r") : stdin;
+    if(script == NULL)
+    {
+        perror(argv[1]);
+        return 1;
+    }
+
+    buildList(&freeProcessDataList, processDataPool, sizeof(processDataPool) / sizeof(ProcessData), sizeof(ProcessData));
+    initNotifications();
+
+    char line[256];
+    while(fgets(line, sizeof(line), script) != NULL)
+    {
+        char *tokens[16];
+        u32 nbTokens = 0;
+
+        lineNumber++;
+        char *comment = strchr(line, '#');
+        if(comment != NULL)
+            *comment = 0;
+
+        for(char *tok = strtok(line, " \t\r\n"); tok != NULL && nbTokens < 16; tok = strtok(NULL, " \t\r\n"))
+            tokens[nbTokens++] = tok;
+
+        if(nbTokens == 0)
+            continue;
+        else if(strcmp(tokens[0], "expect-receive") == 0 && nbTokens >= 2)
+            expectReceive(tokens, nbTokens);
+        else if(strcmp(tokens[0], "expect-stats") == 0 && nbTokens == 6)
+            expectStats(tokens, nbTokens);
+        else
+            runCommand(tokens, nbTokens, false);
+    }
+
+    if(script != stdin)
+        fclose(script);
+
+    return expectationFailed ? 1 : 0;
+}
@@ -0,0 +1,81 @@
+/*
+stubs.c (host build)
+
+(c) TuxSH, 2017-2020
+This is part of 3ds_sm, which is licensed under the MIT license (see LICENSE for details).
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include "../source/common.h"
+#include "../source/services.h"
+
+// Semaphores only keep their count: releasing one past its maximum count is an error, like on the console
+#define MAX_SEMAPHORES 256
+
+typedef struct Semaphore
+{
+    bool used;
+    s32 count, maxCount;
+} Semaphore;
+
+static Semaphore semaphores[MAX_SEMAPHORES];
+
+u32 nbSection0Modules = 5;
+ServiceInfo servicesInfo[0xA0];
+u32 nbServices = 0;
+
+u32 osGetKernelVersion(void)
+{
+    return 0x02370000; // 11.x
+}
+
+Result svcCreateSemaphore(Handle *semaphore, s32 initialCount, s32 maxCount)
+{
+    for(u32 i = 0; i < MAX_SEMAPHORES; i++)
+    {
+        if(!semaphores[i].used)
+        {
+            semaphores[i] = (Semaphore){ .used = true, .count = initialCount, .maxCount = maxCount };
+            *semaphore = 0x100 + i;
+            return 0;
+        }
+    }
+
+    return 0xD8600413;
+}
+
+Result svcReleaseSemaphore(s32 *count, Handle semaphore, s32 releaseCount)
+{
+    Semaphore *sem = &semaphores[semaphore - 0x100];
+    if(sem->count + releaseCount > sem->maxCount)
+    {
+        fprintf(stderr, "semaphore 0x%lx released past its maximum count (%ld)\n", (unsigned long)semaphore, (long)sem->maxCount);
+        return 0xD8E007FD;
+    }
+
+    *count = sem->count;
+    sem->count += releaseCount;
+    return 0;
+}
+
+Result svcCloseHandle(Handle handle)
+{
+    if(handle >= 0x100 && handle < 0x100 + MAX_SEMAPHORES)
+        semaphores[handle - 0x100].used = false;
+    return 0;
+}
+
+Result svcGetProcessId(u32 *out, Handle handle)
+{
+    *out = handle;
+    return 0;
+}
+
+// The simulated client takes the semaphore before ReceiveNotification, like real clients
+void acquireNotificationSemaphore(Handle semaphore)
+{
+    Semaphore *sem = &semaphores[semaphore - 0x100];
+    if(sem->count > 0)
+        sem->count--;
+}
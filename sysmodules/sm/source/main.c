@@ -8,6 +8,7 @@ This is part of 3ds_sm, which is licensed under the MIT license (see LICENSE for
 #include "common.h"
 #include "services.h"
 #include "processes.h"
+#include "notifications.h"
 #include "srv.h"
 #include "srv_pm.h"
 #include "list.h"
@@ -55,6 +56,7 @@ void initSystem(void)
 
     buildList(&freeSessionDataList, sessionDataPool, sizeof(sessionDataPool) / sizeof(SessionData), sizeof(SessionData));
     buildList(&freeProcessDataList, processDataPool, sizeof(processDataPool) / sizeof(ProcessData), sizeof(ProcessData));
+    initNotifications();
 }
 
 int main(void)
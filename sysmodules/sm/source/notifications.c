@@ -7,9 +7,68 @@ This is part of 3ds_sm, which is licensed under the MIT license (see LICENSE for
 
 #include "notifications.h"
 #include "processes.h"
+#include "list.h"
 
 #include <stdatomic.h>
 
+// Subscriber index: one list of (process, notification ID) per bucket, so that publishing only walks
+// the subscribers of the notification (and of the few other IDs sharing its bucket)
+struct NotificationSubscriberList;
+
+typedef struct NotificationSubscriber
+{
+    struct NotificationSubscriber *prev, *next;
+    struct NotificationSubscriberList *parent;
+
+    ProcessData *processData;
+    u32 notificationId;
+} NotificationSubscriber;
+
+typedef struct NotificationSubscriberList
+{
+    NotificationSubscriber *first, *last;
+} NotificationSubscriberList;
+
+static NotificationSubscriber notificationSubscriberPool[64 * 17]; // processDataPool size * max. subscriptions
+static NotificationSubscriberList notificationSubscriberBuckets[NOTIFICATION_NB_BUCKETS], freeNotificationSubscriberList;
+
+// Including the processes that have been unregistered since
+static NotificationStats globalNotificationStats;
+
+void initNotifications(void)
+{
+    buildList(&freeNotificationSubscriberList, notificationSubscriberPool, sizeof(notificationSubscriberPool) / sizeof(NotificationSubscriber), sizeof(NotificationSubscriber));
+}
+
+static void addNotificationSubscriber(ProcessData *processData, u32 notificationId)
+{
+    NotificationSubscriberList *bucket = &notificationSubscriberBuckets[NOTIFICATION_BUCKET(notificationId)];
+    NotificationSubscriber *subscriber = (NotificationSubscriber *)allocateNode(bucket, &freeNotificationSubscriberList, sizeof(NotificationSubscriber), true);
+
+    subscriber->processData = processData;
+    subscriber->notificationId = notificationId;
+}
+
+static void removeNotificationSubscriber(ProcessData *processData, u32 notificationId)
+{
+    NotificationSubscriberList *bucket = &notificationSubscriberBuckets[NOTIFICATION_BUCKET(notificationId)];
+    for(NotificationSubscriber *node = bucket->first; node != NULL; node = node->next)
+    {
+        if(node->processData == processData && node->notificationId == notificationId)
+        {
+            moveNode(node, &freeNotificationSubscriberList, false);
+            return;
+        }
+    }
+}
+
+void removeNotificationSubscriptions(ProcessData *processData)
+{
+    for(u16 i = 0; i < processData->nbSubscribed; i++)
+        removeNotificationSubscriber(processData, processData->subscribedNotifications[i]);
+    processData->nbSubscribed = 0;
+}
+
 static bool isNotificationInhibited(const ProcessData *processData, u32 notificationId)
 {
     (void)processData;
@@ -22,28 +81,47 @@ static bool isNotificationInhibited(const ProcessData *processData, u32 notifica
 
 static bool doPublishNotification(ProcessData *processData, u32 notificationId, u32 flags)
 {
-    if((flags & 1) && processData->nbPendingNotifications != 0) // only send if not already pending
+    u32 bucket = NOTIFICATION_BUCKET(notificationId);
+    NotificationStats *stats = &processData->notificationStats;
+
+    if((flags & 1) && processData->nbPendingNotificationsPerBucket[bucket] != 0) // only send if not already pending
     {
         for(u16 i = 0; i < processData->nbPendingNotifications; i++)
         {
-            if(processData->pendingNotifications[(processData->receivedNotificationIndex + i) % 16] == notificationId)
+            if(processData->pendingNotifications[(processData->receivedNotificationIndex + i) % NOTIFICATION_QUEUE_SIZE] == notificationId)
+            {
+                ++stats->nbCoalesced;
+                ++globalNotificationStats.nbCoalesced;
                 return true;
+            }
         }
     }
 
-    if(processData->nbPendingNotifications < 0x10)
+    if(processData->nbPendingNotifications < NOTIFICATION_QUEUE_SIZE)
     {
         s32 count;
 
         processData->pendingNotifications[processData->pendingNotificationIndex] = notificationId;
-        processData->pendingNotificationIndex = (processData->pendingNotificationIndex + 1) % 16;
+        processData->pendingNotificationIndex = (processData->pendingNotificationIndex + 1) % NOTIFICATION_QUEUE_SIZE;
         ++processData->nbPendingNotifications;
+        ++processData->nbPendingNotificationsPerBucket[bucket];
         assertSuccess(svcReleaseSemaphore(&count, processData->notificationSemaphore, 1));
 
+        ++stats->nbPublished;
+        ++globalNotificationStats.nbPublished;
+        if(processData->nbPendingNotifications > stats->highWater)
+            stats->highWater = processData->nbPendingNotifications;
+        if(processData->nbPendingNotifications > globalNotificationStats.highWater)
+            globalNotificationStats.highWater = processData->nbPendingNotifications;
+
         return true;
     }
     else
+    {
+        ++stats->nbDropped;
+        ++globalNotificationStats.nbDropped;
         return (flags & 2) != 0;
+    }
 }
 
 Result EnableNotification(SessionData *sessionData, Handle *notificationSemaphore)
@@ -82,6 +160,7 @@ Result Subscribe(SessionData *sessionData, u32 notificationId)
     if(processData->nbSubscribed < 0x11)
     {
         processData->subscribedNotifications[processData->nbSubscribed++] = notificationId;
+        addNotificationSubscriber(processData, notificationId);
         return 0;
     }
     else
@@ -103,6 +182,7 @@ Result Unsubscribe(SessionData *sessionData, u32 notificationId)
     else
     {
         processData->subscribedNotifications[i] = processData->subscribedNotifications[--processData->nbSubscribed];
+        removeNotificationSubscriber(processData, notificationId);
         return 0;
     }
 }
@@ -121,21 +201,19 @@ Result ReceiveNotification(SessionData *sessionData, u32 *notificationId)
     {
         --processData->nbPendingNotifications;
         *notificationId = processData->pendingNotifications[processData->receivedNotificationIndex];
-        processData->receivedNotificationIndex = (processData->receivedNotificationIndex + 1) % 16;
+        processData->receivedNotificationIndex = (processData->receivedNotificationIndex + 1) % NOTIFICATION_QUEUE_SIZE;
+        --processData->nbPendingNotificationsPerBucket[NOTIFICATION_BUCKET(*notificationId)];
         return 0;
     }
 }
 
 Result PublishToSubscriber(u32 notificationId, u32 flags)
 {
-    for(ProcessData *node = processDataInUseList.first; node != NULL; node = node->next)
+    NotificationSubscriberList *bucket = &notificationSubscriberBuckets[NOTIFICATION_BUCKET(notificationId)];
+    for(NotificationSubscriber *subscriber = bucket->first; subscriber != NULL; subscriber = subscriber->next)
     {
-        if(!node->notificationEnabled || isNotificationInhibited(node, notificationId))
-            continue;
-
-        u16 i;
-        for(i = 0; i < node->nbSubscribed && node->subscribedNotifications[i] != notificationId; i++);
-        if(i >= node->nbSubscribed)
+        ProcessData *node = subscriber->processData;
+        if(subscriber->notificationId != notificationId || !node->notificationEnabled || isNotificationInhibited(node, notificationId))
             continue;
 
         if(!doPublishNotification(node, notificationId, flags))
@@ -148,14 +226,11 @@ Result PublishToSubscriber(u32 notificationId, u32 flags)
 Result PublishAndGetSubscriber(u32 *pidCount, u32 *pidList, u32 notificationId, u32 flags)
 {
     u32 nb = 0;
-    for(ProcessData *node = processDataInUseList.first; node != NULL; node = node->next)
+    NotificationSubscriberList *bucket = &notificationSubscriberBuckets[NOTIFICATION_BUCKET(notificationId)];
+    for(NotificationSubscriber *subscriber = bucket->first; subscriber != NULL; subscriber = subscriber->next)
     {
-        if(!node->notificationEnabled || isNotificationInhibited(node, notificationId))
-            continue;
-
-        u16 i;
-        for(i = 0; i < node->nbSubscribed && node->subscribedNotifications[i] != notificationId; i++);
-        if(i >= node->nbSubscribed)
+        ProcessData *node = subscriber->processData;
+        if(subscriber->notificationId != notificationId || !node->notificationEnabled || isNotificationInhibited(node, notificationId))
             continue;
 
         if(!doPublishNotification(node, notificationId, flags))
@@ -201,3 +276,24 @@ Result PublishToAll(u32 notificationId)
 
     return 0;
 }
+
+Result GetNotificationStats(NotificationStats *stats, u32 *nbPending, u32 pid)
+{
+    if(pid == 0xFFFFFFFF)
+    {
+        *stats = globalNotificationStats;
+        *nbPending = 0;
+        for(ProcessData *node = processDataInUseList.first; node != NULL; node = node->next)
+            *nbPending += node->nbPendingNotifications;
+
+        return 0;
+    }
+
+    ProcessData *processData = findProcessData(pid);
+    if(processData == NULL)
+        return 0xD8806404;
+
+    *stats = processData->notificationStats;
+    *nbPending = processData->nbPendingNotifications;
+    return 0;
+}
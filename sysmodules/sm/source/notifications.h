@@ -8,6 +8,10 @@ This is part of 3ds_sm, which is licensed under the MIT license (see LICENSE for
 #pragma once
 
 #include "common.h"
+#include "processes.h"
+
+void initNotifications(void);
+void removeNotificationSubscriptions(ProcessData *processData);
 
 Result EnableNotification(SessionData *sessionData, Handle *notificationSemaphore);
 Result Subscribe(SessionData *sessionData, u32 notificationId);
@@ -17,5 +21,6 @@ Result PublishToSubscriber(u32 notificationId, u32 flags);
 Result PublishAndGetSubscriber(u32 *pidCount, u32 *pidList, u32 notificationId, u32 flags);
 Result PublishToProcess(Handle process, u32 notificationId);
 Result PublishToAll(u32 notificationId);
+Result GetNotificationStats(NotificationStats *stats, u32 *nbPending, u32 pid);
 
 Result AddToNdmuWorkaroundCount(s32 count);
@@ -8,6 +8,7 @@ This is part of 3ds_sm, which is licensed under the MIT license (see LICENSE for
 #include "list.h"
 #include "processes.h"
 #include "services.h"
+#include "notifications.h"
 
 ProcessDataList processDataInUseList = { NULL, NULL }, freeProcessDataList = { NULL, NULL };
 
@@ -29,7 +30,7 @@ ProcessData *doRegisterProcess(u32 pid, char (*serviceAccessList)[8], u32 servic
 
     ProcessData *processData = (ProcessData *)allocateNode(&processDataInUseList, &freeProcessDataList, sizeof(ProcessData), false);
 
-    assertSuccess(svcCreateSemaphore(&processData->notificationSemaphore, 0, 0x10));
+    assertSuccess(svcCreateSemaphore(&processData->notificationSemaphore, 0, NOTIFICATION_QUEUE_SIZE));
     processData->pid = pid;
 
     return processData;
@@ -56,6 +57,7 @@ Result UnregisterProcess(u32 pid)
         return 0xD8806404;
 
     svcCloseHandle(processData->notificationSemaphore);
+    removeNotificationSubscriptions(processData);
 
     // Unregister the services registered by the process
     u32 i = 0;
@@ -9,6 +9,24 @@ This is part of 3ds_sm, which is licensed under the MIT license (see LICENSE for
 
 #include "common.h"
 
+// Pending notifications per process (was 16). Also the maximum count of the notification semaphore
+#ifndef NOTIFICATION_QUEUE_SIZE
+#define NOTIFICATION_QUEUE_SIZE     64
+#endif
+
+#define NOTIFICATION_NB_BUCKETS     64
+#define NOTIFICATION_BUCKET(id)     (((id) ^ ((id) >> 6) ^ ((id) >> 12)) % NOTIFICATION_NB_BUCKETS)
+
+_Static_assert(NOTIFICATION_QUEUE_SIZE <= 0xFF, "pending notification counts are 8-bit");
+
+typedef struct NotificationStats
+{
+    u32 nbPublished; // queued
+    u32 nbCoalesced; // already pending (flag 1)
+    u32 nbDropped;   // queue full
+    u32 highWater;
+} NotificationStats;
+
 struct ProcessDataList;
 
 typedef struct ProcessData
@@ -29,7 +47,11 @@ typedef struct ProcessData
     u16 pendingNotificationIndex;
 
     u16 nbPendingNotifications;
-    u32 pendingNotifications[16];
+    u32 pendingNotifications[NOTIFICATION_QUEUE_SIZE];
+    // Number of pending notifications in each bucket, so that coalescing only has to look for duplicates on collisions
+    u8 nbPendingNotificationsPerBucket[NOTIFICATION_NB_BUCKETS];
+    NotificationStats notificationStats;
+
     u16 nbSubscribed;
     u32 subscribedNotifications[17];
 } ProcessData;
@@ -167,6 +167,22 @@ Result srvHandleCommands(SessionData *sessionData)
             break;
         }
 
+        case 0x400: // GetNotificationStats (Luma3DS extension), pid 0xFFFFFFFF for the totals of all processes
+        {
+            NotificationStats stats;
+            u32 nbPending;
+            res = GetNotificationStats(&stats, &nbPending, cmdbuf[1]);
+            cmdbuf[0] = IPC_MakeHeader(0x400, 7, 0);
+            cmdbuf[1] = (u32)res;
+            cmdbuf[2] = nbPending;
+            cmdbuf[3] = NOTIFICATION_QUEUE_SIZE;
+            cmdbuf[4] = stats.highWater;
+            cmdbuf[5] = stats.nbPublished;
+            cmdbuf[6] = stats.nbCoalesced;
+            cmdbuf[7] = stats.nbDropped;
+            break;
+        }
+
         default:
             goto invalid_command;
             break;
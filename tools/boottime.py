@@ -0,0 +1,168 @@
+#!/usr/bin/env python3
+"""
+Decoder for the boot timeline log written by the Arm9 side of Luma3DS
+(/luma/boottime.bin, see arm9/source/boottime.h).
+
+The file is a 32-byte header followed by a fixed ring of per-boot slots, each
+holding up to 48 timestamped phase records. Prints per-phase statistics and
+histograms across all the recorded boots, or the timeline of individual boots
+with --boots.
+"""
+
+import argparse
+import json
+import struct
+import sys
+
+BOOTTIME_MAGIC = 0x454D4954
+BOOTTIME_VERSION = 1
+BOOTTIME_UNKNOWN = 0xFFFFFFFF
+
+HEADER_FMT = "<IHHIII12x"
+SLOT_HEADER_FMT = "<IBBBBII"
+RECORD_FMT = "<B3xII20s"
+MAX_RECORDS = 48
+
+HEADER_SIZE = struct.calcsize(HEADER_FMT)
+SLOT_HEADER_SIZE = struct.calcsize(SLOT_HEADER_FMT)
+RECORD_SIZE = struct.calcsize(RECORD_FMT)
+SLOT_SIZE = SLOT_HEADER_SIZE + MAX_RECORDS * RECORD_SIZE
+
+PHASES = ["storage mount", "config read", "emunand locate", "splash", "firm read", "exefs decrypt",
+          "firm check", "arm9bin decrypt", "patch", "modules", "section copy"]
+FIRM_TYPES = ["NATIVE_FIRM", "TWL_FIRM", "AGB_FIRM", "SAFE_FIRM", "SYSUPDATER_FIRM", "NATIVE_FIRM1X2X"]
+BOOT_TYPES = ["B9S", "B9SNTR", "FIRM0", "FIRM1", "FIRMLAUNCH", "NTR"]
+FIRM_PAYLOAD = 0xFF
+
+
+def parse(data):
+    if len(data) < HEADER_SIZE:
+        raise ValueError("file too small")
+    magic, version, num_slots, ticks_per_sec, sequence, next_slot = struct.unpack_from(HEADER_FMT, data, 0)
+    if magic != BOOTTIME_MAGIC or version != BOOTTIME_VERSION:
+        raise ValueError("not a boot timeline log (or unsupported version)")
+
+    boots = []
+    for i in range(num_slots):
+        pos = HEADER_SIZE + i * SLOT_SIZE
+        if pos + SLOT_SIZE > len(data):
+            break
+        seq, firm_type, nand_type, boot_type, num_records, total, dropped = struct.unpack_from(SLOT_HEADER_FMT, data, pos)
+        if seq == 0:
+            continue
+
+        records = []
+        for j in range(min(num_records, MAX_RECORDS)):
+            phase, start, duration, name = struct.unpack_from(RECORD_FMT, data, pos + SLOT_HEADER_SIZE + j * RECORD_SIZE)
+            records.append({
+                "phase": PHASES[phase] if phase < len(PHASES) else "phase %d" % phase,
+                "name": name.split(b"\0")[0].decode("ascii", "replace"),
+                "start": start / ticks_per_sec * 1000.0,
+                "duration": None if duration == BOOTTIME_UNKNOWN else duration / ticks_per_sec * 1000.0,
+            })
+
+        boots.append({
+            "sequence": seq,
+            "firm": "payload" if firm_type == FIRM_PAYLOAD else
+                    FIRM_TYPES[firm_type] if firm_type < len(FIRM_TYPES) else str(firm_type),
+            "nand": "-" if firm_type == FIRM_PAYLOAD else "emunand" if nand_type else "sysnand",
+            "boot": BOOT_TYPES[boot_type] if boot_type < len(BOOT_TYPES) else str(boot_type),
+            "total": total / ticks_per_sec * 1000.0,
+            "dropped": dropped,
+            "records": records,
+        })
+
+    boots.sort(key=lambda b: b["sequence"])
+    return boots
+
+
+def percentile(values, p):
+    values = sorted(values)
+    k = (len(values) - 1) * p / 100.0
+    lo = int(k)
+    hi = min(lo + 1, len(values) - 1)
+    return values[lo] + (values[hi] - values[lo]) * (k - lo)
+
+
+def histogram(values, bins, width):
+    lo, hi = min(values), max(values)
+    step = (hi - lo) / bins or 1.0
+    counts = [0] * bins
+    for v in values:
+        counts[min(int((v - lo) / step), bins - 1)] += 1
+    peak = max(counts)
+    lines = []
+    for i, c in enumerate(counts):
+        bar = "#" * (c * width // peak) if c else ""
+        lines.append("    %9.2f - %9.2f ms | %-*s %d" % (lo + i * step, lo + (i + 1) * step, width, bar, c))
+    return lines
+
+
+def phase_durations(boots, split_patches):
+    """Sums the durations of each phase (or patch) per boot"""
+    per_phase = {}
+    for boot in boots:
+        totals = {}
+        for r in boot["records"]:
+            if r["duration"] is None:
+                continue
+            key = r["phase"]
+            if split_patches and r["phase"] == "patch" and r["name"]:
+                key = "patch " + r["name"]
+            totals[key] = totals.get(key, 0.0) + r["duration"]
+        totals["total"] = boot["total"]
+        for key, value in totals.items():
+            per_phase.setdefault(key, []).append(value)
+    return per_phase
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Decode Luma3DS boot timeline logs (boottime.bin)")
+    parser.add_argument("files", nargs="+", help="boottime.bin files (e.g. collected from several consoles)")
+    parser.add_argument("--boots", action="store_true", help="print the timeline of each boot")
+    parser.add_argument("--patches", action="store_true", help="report each patch function separately")
+    parser.add_argument("--firm", help="only consider boots of this FIRM (e.g. NATIVE_FIRM)")
+    parser.add_argument("--bins", type=int, default=10, help="histogram bins (default: 10)")
+    parser.add_argument("--json", action="store_true", help="dump the decoded boots as JSON")
+    args = parser.parse_args()
+
+    boots = []
+    for path in args.files:
+        with open(path, "rb") as f:
+            try:
+                boots += parse(f.read())
+            except ValueError as e:
+                sys.exit("%s: %s" % (path, e))
+
+    if args.firm:
+        boots = [b for b in boots if b["firm"] == args.firm]
+    if not boots:
+        sys.exit("no boots recorded")
+
+    if args.json:
+        json.dump(boots, sys.stdout, indent=2)
+        print()
+        return
+
+    if args.boots:
+        for boot in boots:
+            print("boot #%d: %s from %s (%s), %.2f ms%s" % (boot["sequence"], boot["firm"], boot["nand"], boot["boot"], boot["total"],
+                                                        ", %d records dropped" % boot["dropped"] if boot["dropped"] else ""))
+            for r in boot["records"]:
+                duration = "?" if r["duration"] is None else "%.3f" % r["duration"]
+                print("  %9.3f ms  %-16s %-20s %9s ms" % (r["start"], r["phase"], r["name"], duration))
+        print()
+
+    per_phase = phase_durations(boots, args.patches)
+    print("%d boots" % len(boots))
+    print("%-28s %5s %9s %9s %9s %9s" % ("phase", "boots", "min", "median", "p90", "max"))
+    for key in sorted(per_phase, key=lambda k: -percentile(per_phase[k], 50)):
+        values = per_phase[key]
+        print("%-28s %5d %9.2f %9.2f %9.2f %9.2f" % (key, len(values), min(values), percentile(values, 50),
+                                                     percentile(values, 90), max(values)))
+        if len(values) > 1 and max(values) > min(values):
+            print("\n".join(histogram(values, args.bins, 40)))
+
+
+if __name__ == "__main__":
+    main()
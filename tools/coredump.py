@@ -0,0 +1,176 @@
+#!/usr/bin/env python3
+"""
+Reader/validator for the process core dumps written by Rosalina's process list
+(/luma/dumps/memory/*.core and *.core.lz4c).
+
+Compressed dumps are a 12-byte header (magic 'LZ4C', version, block size) followed
+by blocks of (raw size, stored size, data), with stored size == raw size meaning
+an uncompressed block, terminated by a (0, 0) block. Decompressing one yields
+a plain ELF core file that can be loaded with `gdb <elf> <core>`.
+"""
+
+import argparse
+import struct
+import sys
+
+LZ4C_MAGIC = 0x43345A4C
+
+PT_LOAD = 1
+PT_NOTE = 4
+NT_PRSTATUS = 1
+NT_ARM_VFP = 0x400
+
+REG_NAMES = ["r0", "r1", "r2", "r3", "r4", "r5", "r6", "r7", "r8", "r9", "r10",
+             "r11", "r12", "sp", "lr", "pc", "cpsr"]
+
+
+def lz4_decompress_block(src, raw_size):
+    """Decompresses a single LZ4 block (no frame)"""
+    dst = bytearray()
+    i = 0
+    while i < len(src):
+        token = src[i]
+        i += 1
+
+        lit_len = token >> 4
+        if lit_len == 15:
+            while True:
+                b = src[i]
+                i += 1
+                lit_len += b
+                if b != 255:
+                    break
+        dst += src[i:i + lit_len]
+        i += lit_len
+        if i >= len(src):
+            break
+
+        offset = src[i] | (src[i + 1] << 8)
+        i += 2
+        if offset == 0 or offset > len(dst):
+            raise ValueError("invalid match offset")
+
+        match_len = token & 15
+        if match_len == 15:
+            while True:
+                b = src[i]
+                i += 1
+                match_len += b
+                if b != 255:
+                    break
+        match_len += 4
+
+        start = len(dst) - offset
+        for k in range(match_len):  # matches may overlap their own output
+            dst.append(dst[start + k])
+
+    if len(dst) != raw_size:
+        raise ValueError("block decompressed to %d bytes, expected %d" % (len(dst), raw_size))
+    return bytes(dst)
+
+
+def lz4c_decompress(data):
+    magic, version, block_size = struct.unpack_from("<III", data, 0)
+    if magic != LZ4C_MAGIC or version != 1:
+        raise ValueError("not a compressed core dump")
+
+    out = bytearray()
+    pos = 12
+    while True:
+        raw_size, stored_size = struct.unpack_from("<II", data, pos)
+        pos += 8
+        if raw_size == 0:
+            break
+        if raw_size > block_size or stored_size > raw_size:
+            raise ValueError("corrupted block at offset 0x%x" % (pos - 8))
+        block = data[pos:pos + stored_size]
+        pos += stored_size
+        out += block if stored_size == raw_size else lz4_decompress_block(block, raw_size)
+
+    return bytes(out)
+
+
+def parse_notes(data):
+    notes = []
+    pos = 0
+    while pos + 12 <= len(data):
+        namesz, descsz, ntype = struct.unpack_from("<III", data, pos)
+        pos += 12
+        name = data[pos:pos + namesz].rstrip(b"\0").decode("ascii", "replace")
+        pos += (namesz + 3) & ~3
+        desc = data[pos:pos + descsz]
+        pos += (descsz + 3) & ~3
+        notes.append((name, ntype, desc))
+    return notes
+
+
+def validate(core, verbose):
+    """Checks the ELF structure, returns a list of problems"""
+    problems = []
+    if core[:4] != b"\x7fELF" or core[4] != 1 or core[5] != 1:
+        return ["not a 32-bit little endian ELF file"]
+
+    (e_type, e_machine, _, _, e_phoff, _, _, _, e_phentsize, e_phnum) = struct.unpack_from("<HHIIIIIHHH", core, 16)
+    if e_type != 4 or e_machine != 40:
+        problems.append("not an ARM core file (type %d, machine %d)" % (e_type, e_machine))
+    if e_phentsize != 32 or e_phoff + e_phnum * 32 > len(core):
+        return problems + ["program header table out of bounds"]
+
+    prev_end = 0
+    threads = 0
+    for i in range(e_phnum):
+        p_type, p_offset, p_vaddr, _, p_filesz, p_memsz, p_flags, _ = struct.unpack_from("<IIIIIIII", core, e_phoff + 32 * i)
+        if p_offset + p_filesz > len(core):
+            problems.append("segment %d is truncated" % i)
+            continue
+
+        if p_type == PT_NOTE:
+            for name, ntype, desc in parse_notes(core[p_offset:p_offset + p_filesz]):
+                if name == "CORE" and ntype == NT_PRSTATUS:
+                    if len(desc) != 148:
+                        problems.append("bad NT_PRSTATUS size %d" % len(desc))
+                        continue
+                    threads += 1
+                    tid = struct.unpack_from("<I", desc, 24)[0]
+                    regs = struct.unpack_from("<17I", desc, 72)
+                    if verbose:
+                        print("thread %d: %s" % (tid, " ".join("%s=%08x" % r for r in zip(REG_NAMES, regs))))
+                elif name == "LINUX" and ntype == NT_ARM_VFP and len(desc) != 260:
+                    problems.append("bad NT_ARM_VFP size %d" % len(desc))
+        elif p_type == PT_LOAD:
+            if p_filesz != p_memsz:
+                problems.append("segment %d: file size differs from memory size" % i)
+            if p_vaddr < prev_end:
+                problems.append("segment %d overlaps the previous one" % i)
+            prev_end = p_vaddr + p_memsz
+            if verbose:
+                print("%08x-%08x %s%s%s" % (p_vaddr, p_vaddr + p_memsz, "r" if p_flags & 4 else "-",
+                                          "w" if p_flags & 2 else "-", "x" if p_flags & 1 else "-"))
+
+    print("%d segments, %d threads, %d bytes" % (e_phnum - 1, threads, len(core)))
+    return problems
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Validate and decompress Rosalina process core dumps")
+    parser.add_argument("input", help="core dump (.core or .core.lz4c)")
+    parser.add_argument("-o", "--output", help="write the decompressed ELF core file here")
+    parser.add_argument("-v", "--verbose", action="store_true", help="list segments and thread registers")
+    args = parser.parse_args()
+
+    with open(args.input, "rb") as f:
+        data = f.read()
+
+    core = lz4c_decompress(data) if struct.unpack_from("<I", data, 0)[0] == LZ4C_MAGIC else data
+    if args.output:
+        with open(args.output, "wb") as f:
+            f.write(core)
+
+    problems = validate(core, args.verbose)
+    for p in problems:
+        print("error: " + p)
+    sys.exit(1 if problems else 0)
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,324 @@
+#!/usr/bin/env python3
+"""
+Reader for the ErrDisp minidumps written by Rosalina on fatal errors
+(/luma/dumps/errdisp/minidump_XX.dmp, see sysmodules/rosalina/include/minidump.h).
+
+A dump is a 32-byte header followed by (type, size) records: crash reason,
+process (title ID and code layout), registers, memory around PC/LR, the top
+of the stack, the memory map and the user string of the error, if any.
+
+Dumps are grouped by fault signature (process, error type, PC relative to
+the code region it's in) so that the same crash reported by several consoles
+ends up in the same bucket. With --elf, addresses are resolved against the
+symbol table of the crashing program, and return addresses found on the
+stack give a rough backtrace.
+"""
+
+import argparse
+import datetime
+import os
+import shutil
+import struct
+import subprocess
+import sys
+
+MINIDUMP_MAGIC = 0x504D444C
+MINIDUMP_VERSION = 1
+
+HEADER_FMT = "<IHHIIQQ"
+RECORD_HEADER_FMT = "<II"
+CRASH_REASON_FMT = "<BBBBHHII5I96s"
+PROCESS_FMT = "<QQI8s6I"
+MEMORY_FMT = "<III"
+MAP_ENTRY_FMT = "<IIBBH"
+
+HEADER_SIZE = struct.calcsize(HEADER_FMT)
+MAP_ENTRY_SIZE = struct.calcsize(MAP_ENTRY_FMT)
+
+RECORD_CRASH_REASON, RECORD_PROCESS, RECORD_REGISTERS, RECORD_MEMORY, RECORD_MEMORY_MAP, RECORD_USER_STRING = range(1, 7)
+MEMORY_KINDS = ["stack", "pc", "lr"]
+
+ERROR_TYPES = ["generic", "NAND damaged", "card removed", "exception", "failure", "log only"]
+EXCEPTION_TYPES = ["prefetch abort", "data abort", "undefined instruction", "VFP"]
+REG_NAMES = ["r0", "r1", "r2", "r3", "r4", "r5", "r6", "r7", "r8", "r9", "r10",
+             "r11", "r12", "sp", "lr", "pc", "cpsr"]
+MEMSTATES = {0: "free", 1: "reserved", 2: "io", 3: "static", 4: "code", 5: "private", 6: "shared", 7: "continuous",
+             8: "aliased", 9: "alias", 10: "aliascode", 11: "locked"}
+
+
+def parse(data):
+    if len(data) < HEADER_SIZE:
+        raise ValueError("file too small")
+    magic, version, num_records, sequence, size, timestamp, tick = struct.unpack_from(HEADER_FMT, data, 0)
+    if magic != MINIDUMP_MAGIC or version != MINIDUMP_VERSION:
+        raise ValueError("not a minidump (or unsupported version)")
+    if size > len(data):
+        raise ValueError("truncated dump")
+
+    dump = {"sequence": sequence, "timestamp": timestamp, "tick": tick, "memory": [], "map": [], "registers": None,
+            "process": None, "reason": None, "user_string": None}
+    pos = HEADER_SIZE
+    for _ in range(num_records):
+        rtype, rsize = struct.unpack_from(RECORD_HEADER_FMT, data, pos)
+        pos += 8
+        body = data[pos:pos + rsize]
+        if len(body) != rsize:
+            raise ValueError("truncated record at offset 0x%x" % (pos - 8))
+        pos += (rsize + 7) & ~7
+
+        if rtype == RECORD_CRASH_REASON:
+            (err_type, exc_type, rev_high, _, rev_low, _, res_code, pc,
+             fsr, far, fpexc, fpinst, fpinst2, message) = struct.unpack_from(CRASH_REASON_FMT, body)
+            dump["reason"] = {"type": err_type, "exception": None if exc_type == 0xFF else exc_type,
+                              "revision": (rev_high, rev_low), "result": res_code, "pc": pc, "fsr": fsr, "far": far,
+                              "fpexc": fpexc, "fpinst": fpinst, "fpinst2": fpinst2,
+                              "message": message.split(b"\0")[0].decode("ascii", "replace")}
+        elif rtype == RECORD_PROCESS:
+            title_id, app_title_id, pid, name, text, text_size, ro, ro_size, rw, rw_size = struct.unpack_from(PROCESS_FMT, body)
+            dump["process"] = {"pid": pid, "name": name.split(b"\0")[0].decode("ascii", "replace"),
+                               "title_id": title_id, "app_title_id": app_title_id,
+                               "text": (text, text_size), "rodata": (ro, ro_size), "data": (rw, rw_size)}
+        elif rtype == RECORD_REGISTERS:
+            dump["registers"] = dict(zip(REG_NAMES, struct.unpack_from("<17I", body)))
+        elif rtype == RECORD_MEMORY:
+            address, size, kind = struct.unpack_from(MEMORY_FMT, body)
+            dump["memory"].append({"address": address, "kind": MEMORY_KINDS[kind] if kind < len(MEMORY_KINDS) else str(kind),
+                                   "data": body[12:12 + size]})
+        elif rtype == RECORD_MEMORY_MAP:
+            for i in range(rsize // MAP_ENTRY_SIZE):
+                base, size, perm, state, _ = struct.unpack_from(MAP_ENTRY_FMT, body, i * MAP_ENTRY_SIZE)
+                dump["map"].append((base, size, perm, state))
+        elif rtype == RECORD_USER_STRING:
+            dump["user_string"] = body.decode("ascii", "replace")
+
+    if dump["reason"] is None:
+        raise ValueError("no crash reason record")
+    return dump
+
+
+def describe_reason(reason):
+    err = ERROR_TYPES[reason["type"]] if reason["type"] < len(ERROR_TYPES) else "type %d" % reason["type"]
+    if reason["exception"] is not None:
+        exc = reason["exception"]
+        err += " (%s)" % (EXCEPTION_TYPES[exc] if exc < len(EXCEPTION_TYPES) else "type %d" % exc)
+    return err
+
+
+def find_region(dump, addr):
+    for base, size, perm, state in dump["map"]:
+        if base <= addr < base + size:
+            return base, size, perm, state
+    return None
+
+
+def signature(dump):
+    """Fault signature: same process, same kind of error, same place in the code"""
+    reason = dump["reason"]
+    proc = dump["process"] or {}
+    pc = reason["pc"]
+    text, text_size = proc.get("text", (0, 0))
+    if text_size and text <= pc < text + text_size:
+        where = "text+0x%x" % (pc - text)
+    else:
+        region = find_region(dump, pc)
+        where = "%s+0x%x" % (MEMSTATES.get(region[3], "?"), pc - region[0]) if region else "0x%08x" % pc
+    what = describe_reason(reason)
+    if reason["exception"] is None:
+        what += " 0x%08x" % reason["result"]
+    return "%s (%016x) %s at %s" % (proc.get("name", "?"), proc.get("title_id", 0), what, where)
+
+
+class Symbolizer:
+    """Resolves addresses with the symbol table of an ELF file, and optionally addr2line"""
+
+    def __init__(self, path, addr2line=None):
+        self.path = path
+        self.addr2line = addr2line
+        self.symbols = []
+        with open(path, "rb") as f:
+            elf = f.read()
+        if elf[:4] != b"\x7fELF" or elf[4] != 1 or elf[5] != 1:
+            raise ValueError("%s: not a 32-bit little endian ELF file" % path)
+
+        e_shoff, = struct.unpack_from("<I", elf, 32)
+        e_shentsize, e_shnum = struct.unpack_from("<HH", elf, 46)
+        sections = [struct.unpack_from("<IIIIIIIIII", elf, e_shoff + i * e_shentsize) for i in range(e_shnum)]
+        for _, sh_type, _, _, sh_offset, sh_size, sh_link, _, _, sh_entsize in sections:
+            if sh_type != 2:  # SHT_SYMTAB
+                continue
+            strtab = sections[sh_link]
+            for off in range(sh_offset, sh_offset + sh_size, sh_entsize or 16):
+                st_name, st_value, st_size, st_info, _, st_shndx = struct.unpack_from("<IIIBBH", elf, off)
+                if st_info & 0xF not in (1, 2) or st_shndx == 0:  # STT_OBJECT, STT_FUNC
+                    continue
+                name_off = strtab[4] + st_name
+                name = elf[name_off:elf.index(b"\0", name_off)].decode("ascii", "replace")
+                self.symbols.append((st_value & ~1, st_size, name))
+        self.symbols.sort()
+
+    def lookup(self, addr):
+        lo, hi = 0, len(self.symbols)
+        while lo < hi:
+            mid = (lo + hi) // 2
+            if self.symbols[mid][0] <= addr:
+                lo = mid + 1
+            else:
+                hi = mid
+        if lo == 0:
+            return None
+        start, size, name = self.symbols[lo - 1]
+        if size and addr >= start + size:
+            return None
+        return "%s+0x%x" % (name, addr - start)
+
+    def lines(self, addrs):
+        if not self.addr2line or not addrs:
+            return {}
+        out = subprocess.run([self.addr2line, "-e", self.path] + ["0x%x" % a for a in addrs],
+                             capture_output=True, text=True, check=False).stdout.splitlines()
+        return {a: l for a, l in zip(addrs, out) if not l.startswith("??")}
+
+    def describe(self, addr, line=None):
+        sym = self.lookup(addr)
+        s = "%08x" % addr
+        if sym:
+            s += " %s" % sym
+        if line:
+            s += " (%s)" % line
+        return s
+
+
+def stack_return_addresses(dump):
+    """Words on the stack that point into the code region, most recent first"""
+    proc = dump["process"]
+    if proc is None:
+        return []
+    text, text_size = proc["text"]
+    addrs = []
+    for mem in dump["memory"]:
+        if mem["kind"] != "stack":
+            continue
+        data = mem["data"]
+        for off in range(0, len(data) - 3, 4):
+            word, = struct.unpack_from("<I", data, off)
+            if text <= word < text + text_size and word & 1 == 0 or text <= word - 1 < text + text_size and word & 1:
+                addrs.append((mem["address"] + off, word))
+    return addrs
+
+
+def hexdump(data, address, width=16):
+    lines = []
+    for off in range(0, len(data), width):
+        chunk = data[off:off + width]
+        lines.append("    %08x  %-*s %s" % (address + off, width * 3, " ".join("%02x" % b for b in chunk),
+                                          "".join(chr(b) if 32 <= b < 127 else "." for b in chunk)))
+    return lines
+
+
+def print_dump(path, dump, sym, show_memory, max_frames):
+    reason = dump["reason"]
+    proc = dump["process"]
+    when = datetime.datetime(1900, 1, 1) + datetime.timedelta(milliseconds=dump["timestamp"])
+    print("%s: #%d, %s" % (path, dump["sequence"], when.strftime("%Y-%m-%d %H:%M:%S")))
+    if proc:
+        print("  process:  %s (pid %d), title %016x, application %016x" % (proc["name"], proc["pid"], proc["title_id"],
+                                                                         proc["app_title_id"]))
+        print("  code:     text %08x+%x, rodata %08x+%x, data %08x+%x" % (proc["text"] + proc["rodata"] + proc["data"]))
+    print("  error:    %s, result 0x%08x" % (describe_reason(reason), reason["result"]))
+    if reason["message"]:
+        print("  message:  %s" % reason["message"])
+    if reason["exception"] in (0, 1):
+        print("  far:      %08x, fsr %08x" % (reason["far"], reason["fsr"]))
+    elif reason["exception"] == 3:
+        print("  fpexc:    %08x, fpinst %08x, fpinst2 %08x" % (reason["fpexc"], reason["fpinst"], reason["fpinst2"]))
+
+    regs = dump["registers"]
+    lines = sym.lines([reason["pc"] & ~1] + ([regs["lr"] & ~1] if regs else [])) if sym else {}
+    pc = reason["pc"] & ~1
+    print("  pc:       %s" % (sym.describe(pc, lines.get(pc)) if sym else "%08x" % pc))
+    if regs:
+        lr = regs["lr"] & ~1
+        print("  lr:       %s" % (sym.describe(lr, lines.get(lr)) if sym else "%08x" % lr))
+        for i in range(0, 17, 4):
+            print("  " + "  ".join("%-4s %08x" % (n, regs[n]) for n in REG_NAMES[i:i + 4]))
+
+    frames = stack_return_addresses(dump)[:max_frames]
+    if frames:
+        lines = sym.lines([w & ~1 for _, w in frames]) if sym else {}
+        print("  possible return addresses on the stack:")
+        for where, word in frames:
+            print("    [%08x] %s" % (where, sym.describe(word & ~1, lines.get(word & ~1)) if sym else "%08x" % word))
+
+    if show_memory:
+        for base, size, perm, state in dump["map"]:
+            print("  map:      %08x-%08x %s%s%s %s" % (base, base + size, "r" if perm & 1 else "-", "w" if perm & 2 else "-",
+                                                   "x" if perm & 4 else "-", MEMSTATES.get(state, str(state))))
+        for mem in dump["memory"]:
+            print("  %s memory:" % mem["kind"])
+            print("\n".join(hexdump(mem["data"], mem["address"])))
+
+    if dump["user_string"]:
+        print("  user string: %s" % dump["user_string"])
+    print()
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Decode, group and symbolize Rosalina ErrDisp minidumps")
+    parser.add_argument("inputs", nargs="+", help="minidump files, or directories containing them")
+    parser.add_argument("--elf", help="ELF file of the crashing program, to resolve addresses")
+    parser.add_argument("--addr2line", nargs="?", const="arm-none-eabi-addr2line",
+                        help="also resolve source lines with this addr2line (default: arm-none-eabi-addr2line)")
+    parser.add_argument("--title", help="only consider dumps of this title ID (hex)")
+    parser.add_argument("--memory", action="store_true", help="print the memory map and the captured memory")
+    parser.add_argument("--frames", type=int, default=16, help="maximum number of stack return addresses (default: 16)")
+    parser.add_argument("--buckets", action="store_true", help="only print the fault signatures and their counts")
+    args = parser.parse_args()
+
+    paths = []
+    for p in args.inputs:
+        if os.path.isdir(p):
+            paths += sorted(os.path.join(p, f) for f in os.listdir(p) if f.endswith(".dmp"))
+        else:
+            paths.append(p)
+
+    dumps = []
+    for path in paths:
+        with open(path, "rb") as f:
+            try:
+                dumps.append((path, parse(f.read())))
+            except ValueError as e:
+                print("%s: %s" % (path, e), file=sys.stderr)
+
+    if args.title:
+        title = int(args.title, 16)
+        dumps = [(p, d) for p, d in dumps if d["process"] and d["process"]["title_id"] == title]
+    if not dumps:
+        sys.exit("no dumps")
+    dumps.sort(key=lambda pd: pd[1]["timestamp"])
+
+    addr2line = args.addr2line
+    if addr2line and shutil.which(addr2line) is None:
+        print("warning: %s not found, not resolving source lines" % addr2line, file=sys.stderr)
+        addr2line = None
+    sym = Symbolizer(args.elf, addr2line) if args.elf else None
+
+    buckets = {}
+    for path, dump in dumps:
+        buckets.setdefault(signature(dump), []).append((path, dump))
+
+    if not args.buckets:
+        for path, dump in dumps:
+            print_dump(path, dump, sym, args.memory, args.frames)
+
+    print("%d dumps, %d distinct faults" % (len(dumps), len(buckets)))
+    for sig, members in sorted(buckets.items(), key=lambda kv: -len(kv[1])):
+        first = min(d["timestamp"] for _, d in members)
+        last = max(d["timestamp"] for _, d in members)
+        fmt = lambda ms: (datetime.datetime(1900, 1, 1) + datetime.timedelta(milliseconds=ms)).strftime("%Y-%m-%d")
+        pc = members[0][1]["reason"]["pc"] & ~1
+        where = " in %s" % sym.lookup(pc) if sym and sym.lookup(pc) else ""
+        print("%5d  %s%s  [%s .. %s]" % (len(members), sig, where, fmt(first), fmt(last)))
+
+
+if __name__ == "__main__":
+    main()